@@ -21,10 +21,42 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <setjmp.h>
+
+#ifndef WIN32
+# include <fcntl.h>
+# include <netdb.h>
+# include <poll.h>
+# include <signal.h>
+# include <sys/socket.h>
+#endif	/* !WIN32 */
 
 #include "cgilib.h"
 #include "parseconf.h"
 
+/* daemon mode, see cgi_serve() */
+static int	cgi_daemon = 0;
+static char	*cgi_query = NULL;
+static jmp_buf	cgi_request_env;
+
+#ifndef WIN32
+/* Requests being received: they are read as they come in, so a client
+ * sending its request slowly (or not at all) only holds its own slot */
+#define CGI_PENDING_MAX		32
+#define CGI_REQUEST_TIMEOUT	5	/* sec to send the whole request */
+#define CGI_REPLY_TIMEOUT	1	/* sec a client may block the reply */
+
+typedef struct {
+	int	fd;
+	time_t	deadline;
+	size_t	len;
+	char	buf[LARGEBUF];
+} cgi_pending_t;
+
+static cgi_pending_t	cgi_pending[CGI_PENDING_MAX];
+static size_t	cgi_pending_num = 0;
+#endif	/* !WIN32 */
+
 static char *unescape(char *buf)
 {
 	size_t	i, buflen;
@@ -46,14 +78,18 @@ static char *unescape(char *buf)
 
 		if (ch == '%') {
 			long l;
-			if (i + 2 > buflen)
-				fatalx(EXIT_FAILURE, "string too short for escaped char");
+			if (i + 2 > buflen) {
+				upslogx(LOG_ERR, "string too short for escaped char");
+				cgi_finish(EXIT_FAILURE);
+			}
 			hex[0] = buf[++i];
 			hex[1] = buf[++i];
 			hex[2] = '\0';
 			if (!isxdigit((unsigned char) hex[0])
-				|| !isxdigit((unsigned char) hex[1]))
-				fatalx(EXIT_FAILURE, "bad escape char");
+				|| !isxdigit((unsigned char) hex[1])) {
+				upslogx(LOG_ERR, "bad escape char");
+				cgi_finish(EXIT_FAILURE);
+			}
 			l = strtol(hex, NULL, 16);
 			assert(l>=0);
 			assert(l<=255);
@@ -74,7 +110,7 @@ void extractcgiargs(void)
 	char	*query, *ptr, *eq, *varname, *value, *amp;
 	char	*cleanval, *cleanvar;
 
-	query = getenv("QUERY_STRING");
+	query = cgi_daemon ? cgi_query : getenv("QUERY_STRING");
 	if (query == NULL)
 		return;		/* not run as a cgi script! */
 	if (strlen(query) == 0)
@@ -298,3 +334,341 @@ int checkhost(const char *host, char **desc)
 
 	return 0;	/* not found: access denied */
 }
+
+int cgi_serving(void)
+{
+	return cgi_daemon;
+}
+
+void cgi_finish(int status)
+{
+	if (cgi_daemon)
+		longjmp(cgi_request_env, 1);
+
+	exit(status);
+}
+
+#ifndef WIN32
+/* Read what arrived of a pending request; returns 1 once the request
+ * head is complete, 0 if more is expected, -1 if the client is gone */
+static int cgi_read_request(cgi_pending_t *req)
+{
+	ssize_t	ret;
+
+	ret = read(req->fd, req->buf + req->len, sizeof(req->buf) - 1 - req->len);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return 0;
+	if (ret <= 0)
+		return -1;
+
+	req->len += (size_t)ret;
+	req->buf[req->len] = '\0';
+
+	if (strstr(req->buf, "\r\n\r\n") || strstr(req->buf, "\n\n"))
+		return 1;
+
+	/* only the request line is used, take what fits */
+	return (req->len >= sizeof(req->buf) - 1) ? 1 : 0;
+}
+
+/* Parse the request head; returns the query string of a GET request
+ * (empty if there is none), or NULL after replying with an error */
+static char *cgi_parse_request(int fd, char *buf)
+{
+	char	*target, *end;
+
+	end = strpbrk(buf, "\r\n");
+	if (end)
+		*end = '\0';
+
+	if (strncmp(buf, "GET ", 4)) {
+		static const char	reply[] = "HTTP/1.0 405 Method Not Allowed\r\n"
+			"Allow: GET\r\nConnection: close\r\n\r\n";
+
+		upsdebugx(1, "%s: unsupported request: %s", __func__, buf);
+		if (write(fd, reply, sizeof(reply) - 1) < 0)
+			upsdebug_with_errno(1, "%s: write", __func__);
+		return NULL;
+	}
+
+	target = buf + 4;
+	end = strchr(target, ' ');
+	if (end)
+		*end = '\0';
+
+	upsdebugx(2, "%s: GET %s", __func__, target);
+
+	end = strchr(target, '?');
+	return end ? end + 1 : target + strlen(target);
+}
+
+/* run one request, cgi_finish() gets back here */
+static void cgi_run(cgi_handler_t handler)
+{
+	cgi_daemon = 1;
+	if (setjmp(cgi_request_env) == 0)
+		handler();
+	cgi_daemon = 0;
+}
+
+/* Open the listening socket for [addr:]port */
+static int cgi_listen(const char *spec)
+{
+	char	*addr = xstrdup(spec), *port, *host = NULL;
+	struct addrinfo	hints, *res, *ai;
+	int	sock = -1, one = 1, v;
+
+	port = strrchr(addr, ':');
+	if (port) {
+		*port++ = '\0';
+		host = addr;
+		/* [ipv6]:port */
+		if (*host == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = '\0';
+			host++;
+		}
+	} else {
+		port = addr;
+	}
+
+	/* only the local reverse proxy should get here, unless told otherwise */
+	if (!host || !*host)
+		host = "127.0.0.1";
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	if ((v = getaddrinfo(host, port, &hints, &res)) != 0) {
+		upslogx(LOG_ERR, "NUT_CGI_LISTEN=%s: %s", spec, gai_strerror(v));
+		free(addr);
+		return -1;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock < 0)
+			continue;
+
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (void *)&one, sizeof(one));
+
+		if (bind(sock, ai->ai_addr, ai->ai_addrlen) == 0
+		 && listen(sock, 16) == 0
+		) {
+			break;
+		}
+
+		close(sock);
+		sock = -1;
+	}
+
+	if (sock < 0)
+		upslog_with_errno(LOG_ERR, "NUT_CGI_LISTEN=%s: can't listen", spec);
+	else
+		upslogx(LOG_INFO, "Serving HTTP requests at %s port %s", host, port);
+
+	freeaddrinfo(res);
+	free(addr);
+	return sock;
+}
+
+/* Run the handler for a received request, with stdout going to
+ * the client, then close the connection */
+static void cgi_reply(cgi_handler_t handler, int fd, char *buf, int saved_stdout)
+{
+	struct timeval	tv;
+
+	cgi_query = cgi_parse_request(fd, buf);
+	if (!cgi_query) {
+		close(fd);
+		return;
+	}
+
+	/* The reply is written while the others wait: a client which does not
+	 * read it (once the socket buffer is full) only gets a short while */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	tv.tv_sec = CGI_REPLY_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (void *)&tv, sizeof(tv));
+
+	fflush(stdout);
+	dup2(fd, STDOUT_FILENO);
+	printf("HTTP/1.0 200 OK\r\nConnection: close\r\n");
+
+	cgi_run(handler);
+
+	fflush(stdout);
+	clearerr(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(fd);
+}
+
+/* forget the pending request in slot i (the last one takes its place) */
+static void cgi_pending_drop(size_t i)
+{
+	cgi_pending[i] = cgi_pending[--cgi_pending_num];
+}
+#endif	/* !WIN32 */
+
+int cgi_serve(cgi_handler_t handler)
+{
+#ifndef WIN32
+	const char	*spec = getenv("NUT_CGI_LISTEN");
+	struct pollfd	fds[CGI_PENDING_MAX + 1];
+	int	sock, saved_stdout;
+
+	if (!spec || !*spec)
+		return 0;
+
+	sock = cgi_listen(spec);
+	if (sock < 0)
+		exit(EXIT_FAILURE);
+
+	saved_stdout = dup(STDOUT_FILENO);
+	if (saved_stdout < 0)
+		fatal_with_errno(EXIT_FAILURE, "dup");
+
+	/* clients going away mid-reply are not our problem */
+	signal(SIGPIPE, SIG_IGN);
+
+	for (;;) {
+		time_t	now = time(NULL);
+		int	timeout = -1, ret;
+		size_t	i;
+
+		/* give up on the requests which take too long to arrive,
+		 * and wake up in time for the next one to expire */
+		for (i = cgi_pending_num; i-- > 0; ) {
+			if (cgi_pending[i].deadline <= now) {
+				upsdebugx(1, "%s: request not received in time", __func__);
+				close(cgi_pending[i].fd);
+				cgi_pending_drop(i);
+				continue;
+			}
+
+			if (timeout < 0 || (cgi_pending[i].deadline - now) * 1000 < timeout)
+				timeout = (int)(cgi_pending[i].deadline - now) * 1000;
+		}
+
+		/* when all slots are taken, new clients wait in the backlog */
+		fds[0].fd = (cgi_pending_num < CGI_PENDING_MAX) ? sock : -1;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		for (i = 0; i < cgi_pending_num; i++) {
+			fds[i + 1].fd = cgi_pending[i].fd;
+			fds[i + 1].events = POLLIN;
+			fds[i + 1].revents = 0;
+		}
+
+		ret = poll(fds, (nfds_t)(cgi_pending_num + 1), timeout);
+		if (ret < 0) {
+			if (errno != EINTR)
+				upslog_with_errno(LOG_ERR, "poll");
+			continue;
+		}
+
+		/* downwards, so that dropping a slot does not move unchecked ones */
+		for (i = cgi_pending_num; i-- > 0; ) {
+			if (!fds[i + 1].revents)
+				continue;
+
+			ret = cgi_read_request(&cgi_pending[i]);
+			if (ret == 0)
+				continue;
+
+			if (ret > 0)
+				cgi_reply(handler, cgi_pending[i].fd, cgi_pending[i].buf, saved_stdout);
+			else
+				close(cgi_pending[i].fd);
+
+			cgi_pending_drop(i);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int	fd = accept(sock, NULL, NULL);
+
+			if (fd < 0) {
+				if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN)
+					upslog_with_errno(LOG_ERR, "accept");
+				continue;
+			}
+
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+			cgi_pending[cgi_pending_num].fd = fd;
+			cgi_pending[cgi_pending_num].deadline = time(NULL) + CGI_REQUEST_TIMEOUT;
+			cgi_pending[cgi_pending_num].len = 0;
+			cgi_pending[cgi_pending_num].buf[0] = '\0';
+			cgi_pending_num++;
+		}
+	}
+#else	/* WIN32 */
+	NUT_UNUSED_VARIABLE(handler);
+	return 0;
+#endif	/* WIN32 */
+}
+
+/* Handles from upscli_pool_connect() held by cgi_upsconn(), one for
+ * each data server, so that the connections are kept between requests */
+typedef struct cgi_upsconn_s {
+	char	*host;
+	uint16_t	port;
+	int	flags;
+	UPSCONN_t	*ups;
+	struct cgi_upsconn_s	*next;
+} cgi_upsconn_t;
+
+static cgi_upsconn_t	*cgi_upsconns = NULL;
+
+UPSCONN_t *cgi_upsconn(const char *host, uint16_t port)
+{
+	cgi_upsconn_t	*entry;
+	UPSCONN_t	*ups;
+
+	for (entry = cgi_upsconns; entry; entry = entry->next) {
+		if (entry->port == port && !strcmp(entry->host, host))
+			break;
+	}
+
+	if (!entry)
+		return NULL;
+
+	/* have the pool check the connection (re-opening it if the server
+	 * closed it since), and keep holding one handle */
+	ups = upscli_pool_connect(host, port, entry->flags, NULL, NULL);
+	upscli_pool_release(ups);
+
+	upsdebugx(2, "%s: reusing connection to %s:%" PRIu16, __func__, host, port);
+	return ups;
+}
+
+UPSCONN_t *cgi_upsconn_hold(const char *host, uint16_t port, int flags)
+{
+	cgi_upsconn_t	*entry;
+
+	entry = (cgi_upsconn_t *)xcalloc(1, sizeof(*entry));
+	entry->host = xstrdup(host);
+	entry->port = port;
+	entry->flags = flags;
+	entry->ups = upscli_pool_connect(host, port, flags, NULL, NULL);
+
+	entry->next = cgi_upsconns;
+	cgi_upsconns = entry;
+
+	return entry->ups;
+}
+
+void cgi_upsconn_free(void)
+{
+	cgi_upsconn_t	*entry, *next;
+
+	for (entry = cgi_upsconns; entry; entry = next) {
+		next = entry->next;
+		upscli_pool_release(entry->ups);
+		free(entry->host);
+		free(entry);
+	}
+
+	cgi_upsconns = NULL;
+}
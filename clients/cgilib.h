@@ -20,6 +20,8 @@
 #ifndef NUT_CGILIB_H_SEEN
 #define NUT_CGILIB_H_SEEN 1
 
+#include "upsclient.h"
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 extern "C" {
@@ -38,6 +40,34 @@ void extractpostargs(void);
 /* see if a host is allowed per the hosts.conf */
 int checkhost(const char *host, char **desc);
 
+/* Daemon mode: if NUT_CGI_LISTEN is set to [addr:]port in the environment
+ * (addr defaults to 127.0.0.1), accept plain HTTP/1.0 GET requests there
+ * (e.g. from a reverse proxy), receiving them from several clients at once,
+ * and run the handler for each in turn with stdout going to the client and
+ * the query string available to extractcgiargs(). Never returns in that case;
+ * returns 0 if daemon mode was not requested (or is not supported here),
+ * so the program should serve its single CGI request as usual. */
+typedef void (*cgi_handler_t)(void);
+int cgi_serve(cgi_handler_t handler);
+
+/* non-zero while running a request in daemon mode */
+int cgi_serving(void);
+
+/* end the current request: back to cgi_serve() in daemon mode,
+ * or exit() with the given status when running as a plain CGI program */
+void cgi_finish(int status)
+	__attribute__((noreturn));
+
+/* Pooled connection (see upscli_pool_connect()) to the data server at
+ * host:port, if this program holds one, or NULL: the caller then sets up
+ * SSL for that server and gets one with cgi_upsconn_hold(). Held handles
+ * are kept for the next requests in daemon mode. */
+UPSCONN_t *cgi_upsconn(const char *host, uint16_t port);
+UPSCONN_t *cgi_upsconn_hold(const char *host, uint16_t port, int flags);
+
+/* release all held connections */
+void cgi_upsconn_free(void);
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
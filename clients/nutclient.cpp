@@ -4216,8 +4216,10 @@ bool TcpClient::isValidProtocolVersion(const std::string& version_re)
 	}
 
 	if (version_re.empty()) {
-		// Basic check for 1.0 through 1.3, as of NUT v2.8.2
-		if (version == "1.0" || version == "1.1" || version == "1.2" || version == "1.3") {
+		// Basic check for 1.0 through 1.4, as of NUT v2.8.6
+		if (version == "1.0" || version == "1.1" || version == "1.2" || version == "1.3"
+		 || version == "1.4"
+		) {
 			return true;
 		}
 	} else {
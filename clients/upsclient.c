@@ -42,6 +42,7 @@
 
 #ifndef WIN32
 # include <sys/select.h>	/* fd_set and select(); (or sys/time.h on older BSDs) */
+# include <poll.h>
 # include <netdb.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
@@ -95,6 +96,9 @@
 
 #define UPSCLIENT_MAGIC	0x19980308
 
+/* internal: set in UPSCONN_t.flags of handles from upscli_pool_connect() */
+#define UPSCLI_CONN_POOLED	0x8000
+
 #define SMALLBUF	512
 
 #ifdef SHUT_RDWR
@@ -156,6 +160,33 @@ static struct {
 	{ 0, "Protocol error",			},	/* 42: UPSCLI_ERR_PROTOCOL */
 };
 
+/* Connections shared by upscli_pool_connect() handles, one for each
+ * host, port, flags and credentials */
+typedef struct upscli_pool_s {
+	UPSCONN_t	conn;	/* must be first: handles point here */
+	char	*host;
+	uint16_t	port;
+	int	flags;
+	char	*username;
+	char	*password;
+	struct timeval	timeout;	/* for upscli_tryconnect() */
+	int	has_timeout;
+	size_t	refs;	/* handles given out */
+	int	busy;	/* being (re)connected */
+	time_t	retry_after;	/* after a failed (re)connection */
+
+	struct upscli_pool_s	*next;
+}	upscli_pool_t;
+
+/* Do not retry a server which could not be reached for each request
+ * (e.g. for each of its devices) but only after this many seconds */
+#define UPSCLI_POOL_RETRY_DELAY	5
+
+static upscli_pool_t	*upscli_pool = NULL;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t	upscli_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif	/* HAVE_PTHREAD */
+
 
 typedef struct HOST_CERT_s {
 	const char	*host;
@@ -1663,6 +1694,38 @@ void upscli_free_host_cert_list(void)
 #endif /* ! SSL */
 }
 
+static void upscli_pool_free_entry(upscli_pool_t *entry)
+{
+	upscli_disconnect(&entry->conn);
+
+	free(entry->host);
+	free(entry->username);
+	if (entry->password) {
+		memset(entry->password, 0, strlen(entry->password));
+		free(entry->password);
+	}
+
+	free(entry);
+}
+
+static void upscli_pool_free_all(void)
+{
+	upscli_pool_t	*entry, *next;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+	for (entry = upscli_pool; entry; entry = next) {
+		next = entry->next;
+		upscli_pool_free_entry(entry);
+	}
+
+	upscli_pool = NULL;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+}
+
 int upscli_cleanup(void)
 {
 #ifdef WITH_OPENSSL
@@ -1686,6 +1749,7 @@ int upscli_cleanup(void)
 	PL_ArenaFinish();
 #endif /* WITH_NSS */
 
+	upscli_pool_free_all();
 	upscli_free_host_cert_list();
 	upscli_free_authconf_list();
 	upscli_initialized = 0;
@@ -3052,6 +3116,227 @@ int upscli_list_next(UPSCONN_t *ups, size_t numq, const char **query,
 	return 1;
 }
 
+/* A connection is alive unless the server closed it: an idle one which
+ * is readable should have data pending (e.g. lines pushed after WATCH),
+ * which is left to the caller. Uses poll(), as a process with many
+ * handles may well have descriptors past FD_SETSIZE (WIN32 fd_set is a
+ * list of sockets without that limit). */
+static int upscli_pool_alive(UPSCONN_t *ups)
+{
+#ifndef WIN32
+	struct pollfd	pfd;
+#else	/* WIN32 */
+	fd_set	fds;
+	struct timeval	tv;
+#endif	/* WIN32 */
+	char	c;
+	int	ret;
+
+	if (ups->fd < 0) {
+		return 0;
+	}
+
+	/* some of the last reply is still buffered, leave it to the caller */
+	if (ups->readidx < ups->readlen) {
+		return 1;
+	}
+
+#ifndef WIN32
+	pfd.fd = ups->fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	ret = poll(&pfd, 1, 0);
+#else	/* WIN32 */
+	FD_ZERO(&fds);
+	FD_SET(ups->fd, &fds);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+
+	ret = select(ups->fd + 1, &fds, NULL, NULL, &tv);
+#endif	/* WIN32 */
+
+	if (ret == 0) {
+		return 1;
+	}
+	if (ret < 0) {
+		return 0;
+	}
+
+	/* readable: end of file (or an error), or data to be read */
+	return (recv(ups->fd, &c, 1, MSG_PEEK) > 0);
+}
+
+/* (re)open the shared connection and authenticate if asked to */
+static int upscli_pool_open(upscli_pool_t *entry)
+{
+	int	ret = 0;
+
+	entry->busy = 1;
+
+	if (entry->conn.fd >= 0) {
+		upscli_disconnect(&entry->conn);
+	}
+
+	if ((entry->has_timeout
+		? upscli_tryconnect(&entry->conn, entry->host, entry->port, entry->flags, &entry->timeout)
+		: upscli_connect(&entry->conn, entry->host, entry->port, entry->flags)) < 0
+	) {
+		upsdebugx(2, "%s: can not connect to %s:%" PRIu16 ": %s",
+			__func__, entry->host, entry->port, upscli_strerror(&entry->conn));
+		ret = -1;
+	} else if (entry->username && entry->password
+	 && upscli_authenticate(&entry->conn, entry->username, entry->password, 0, 0) != 0
+	) {
+		upsdebugx(2, "%s: can not authenticate to %s:%" PRIu16 " as %s: %s",
+			__func__, entry->host, entry->port, entry->username,
+			upscli_strerror(&entry->conn));
+		upscli_disconnect(&entry->conn);
+		ret = -1;
+	} else {
+		upsdebugx(3, "%s: connected to %s:%" PRIu16,
+			__func__, entry->host, entry->port);
+	}
+
+	/* upscli_connect() starts from a clean structure */
+	entry->conn.flags |= UPSCLI_CONN_POOLED;
+	entry->busy = 0;
+	entry->retry_after = (ret < 0) ? time(NULL) + UPSCLI_POOL_RETRY_DELAY : 0;
+
+	return ret;
+}
+
+/* Before a request on a pooled handle: re-open the connection if the
+ * server dropped it (or any of its handles disconnected it) */
+static int upscli_pool_check(UPSCONN_t *ups)
+{
+	upscli_pool_t	*entry = (upscli_pool_t *)ups;
+
+	if (entry->busy || upscli_pool_alive(ups)) {
+		return 0;
+	}
+
+	if (entry->retry_after && time(NULL) < entry->retry_after) {
+		upsdebugx(3, "%s: %s:%" PRIu16 " could not be reached lately, not retrying yet",
+			__func__, entry->host, entry->port);
+		return -1;
+	}
+
+	upsdebugx(2, "%s: connection to %s:%" PRIu16 " was lost, reconnecting",
+		__func__, entry->host, entry->port);
+
+	return upscli_pool_open(entry);
+}
+
+static int upscli_pool_strsame(const char *a, const char *b)
+{
+	if (!a || !b) {
+		return (a == b);
+	}
+
+	return !strcmp(a, b);
+}
+
+UPSCONN_t *upscli_pool_tryconnect(const char *host, uint16_t port, int flags,
+	const char *username, const char *password, struct timeval *timeout)
+{
+	upscli_pool_t	*entry;
+
+	if (!host) {
+		return NULL;
+	}
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+	for (entry = upscli_pool; entry; entry = entry->next) {
+		if (entry->port == port
+		 && entry->flags == flags
+		 && !strcmp(entry->host, host)
+		 && upscli_pool_strsame(entry->username, username)
+		 && upscli_pool_strsame(entry->password, password)
+		) {
+			break;
+		}
+	}
+
+	if (entry) {
+		entry->refs++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+		upsdebugx(3, "%s: sharing the connection to %s:%" PRIu16
+			" (%" PRIuSIZE " handles)",
+			__func__, host, port, entry->refs);
+
+		upscli_pool_check(&entry->conn);
+		return &entry->conn;
+	}
+
+	entry = (upscli_pool_t *)xcalloc(1, sizeof(*entry));
+	entry->host = xstrdup(host);
+	entry->port = port;
+	entry->flags = flags;
+	entry->username = username ? xstrdup(username) : NULL;
+	entry->password = password ? xstrdup(password) : NULL;
+	if (timeout) {
+		entry->timeout = *timeout;
+		entry->has_timeout = 1;
+	}
+	entry->refs = 1;
+	entry->conn.fd = -1;
+
+	entry->next = upscli_pool;
+	upscli_pool = entry;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+
+	/* even if this fails, the handle is usable: the next request retries */
+	upscli_pool_open(entry);
+
+	return &entry->conn;
+}
+
+UPSCONN_t *upscli_pool_connect(const char *host, uint16_t port, int flags,
+	const char *username, const char *password)
+{
+	return upscli_pool_tryconnect(host, port, flags, username, password, NULL);
+}
+
+int upscli_pool_release(UPSCONN_t *ups)
+{
+	upscli_pool_t	**pptr, *entry;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+	for (pptr = &upscli_pool; *pptr; pptr = &(*pptr)->next) {
+		if (&(*pptr)->conn == ups) {
+			break;
+		}
+	}
+
+	entry = *pptr;
+	if (entry && --entry->refs == 0) {
+		/* that was the last handle */
+		*pptr = entry->next;
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&upscli_pool_mutex);
+#endif	/* HAVE_PTHREAD */
+
+	if (!entry) {
+		return -1;
+	}
+
+	if (entry->refs == 0) {
+		upscli_pool_free_entry(entry);
+	}
+
+	return 0;
+}
+
 ssize_t upscli_sendline_timeout_may_disconnect(UPSCONN_t *ups, const char *buf, size_t buflen, const time_t timeout, int may_disconnect)
 {
 	ssize_t	ret;
@@ -3060,6 +3345,12 @@ ssize_t upscli_sendline_timeout_may_disconnect(UPSCONN_t *ups, const char *buf,
 		return -1;
 	}
 
+	if (ups->upsclient_magic == UPSCLIENT_MAGIC
+	 && (ups->flags & UPSCLI_CONN_POOLED)
+	) {
+		upscli_pool_check(ups);
+	}
+
 	if (ups->fd < 0) {
 		ups->upserror = UPSCLI_ERR_DRVNOTCONN;
 		return -1;
@@ -3355,10 +3646,11 @@ int upscli_is_valid_protocol_version(UPSCONN_t *ups, const char *version_re)
 		__func__, version, NUT_STRARG(version_re));
 
 	if (!version_re) {
-		/* Basic check for 1.0 through 1.3, as of NUT v2.8.2 */
+		/* Basic check for 1.0 through 1.4, as of NUT v2.8.6 */
 		return (
 			!strcmp(version, "1.0") || !strcmp(version, "1.1") ||
-			!strcmp(version, "1.2") || !strcmp(version, "1.3")
+			!strcmp(version, "1.2") || !strcmp(version, "1.3") ||
+			!strcmp(version, "1.4")
 			);
 	}
 
@@ -3457,6 +3749,19 @@ int upscli_fd(UPSCONN_t *ups)
 	return ups->fd;
 }
 
+int upscli_pending(UPSCONN_t *ups)
+{
+	if (!ups) {
+		return -1;
+	}
+
+	if (ups->upsclient_magic != UPSCLIENT_MAGIC) {
+		return -1;
+	}
+
+	return (ups->readidx < ups->readlen);
+}
+
 int upscli_upserror(UPSCONN_t *ups)
 {
 	if (!ups) {
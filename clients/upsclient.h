@@ -201,9 +201,32 @@ int upscli_splitaddr(const char *buf, char **hostname, uint16_t *port);
 
 int upscli_disconnect(UPSCONN_t *ups);
 
+/* Pooled connections: handles for the same host, port, flags and
+ * credentials (username and password, may be NULL) share one connection
+ * which is opened and authenticated once. All upscli_*() calls work on
+ * pooled handles; if the server dropped the connection, it is opened
+ * (and authenticated) again before the next request, but a server which
+ * could not be reached is only retried after a few seconds. Lists must
+ * be read to their end before the next request through any handle
+ * sharing the connection, and a connection used for WATCH should not be
+ * shared at all. Handles may be taken and released from several threads,
+ * but each connection should be used by one thread at a time. Release
+ * each handle with upscli_pool_release() rather than upscli_disconnect();
+ * the connection is closed with the last handle.
+ * Returns NULL only for invalid arguments: if the server could not be
+ * reached, the handle is still returned with upscli_fd() < 0.
+ * upscli_pool_tryconnect() (re)connects with upscli_tryconnect() and the
+ * given timeout, as set by whichever call opened the connection first. */
+UPSCONN_t *upscli_pool_connect(const char *host, uint16_t port, int flags,
+	const char *username, const char *password);
+UPSCONN_t *upscli_pool_tryconnect(const char *host, uint16_t port, int flags,
+	const char *username, const char *password, struct timeval *timeout);
+int upscli_pool_release(UPSCONN_t *ups);
+
 /* these functions return elements from UPSCONN_t to avoid direct references */
 
 int upscli_fd(UPSCONN_t *ups);
+int upscli_pending(UPSCONN_t *ups);
 int upscli_upserror(UPSCONN_t *ups);
 
 /** Query the (already established) connection to UPSD for its version
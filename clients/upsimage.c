@@ -61,7 +61,27 @@ static	char	*monhost = NULL, *cmd = NULL;
 
 static	uint16_t	port;
 static	char	*upsname, *hostname;
-static	UPSCONN_t	ups;
+
+/* the connection for this request, see cgi_upsconn() */
+static	UPSCONN_t	ups_none, *ups = &ups_none;
+
+/* imgarg values before the query string changed them */
+static	int	*imgarg_defaults = NULL;
+
+/* Recently drawn images, served again without drawing if the same
+ * request finds the same values (only used in daemon mode) */
+#define PNG_CACHE_SIZE	64
+
+typedef struct {
+	char	*key;
+	void	*png;
+	int	size;
+} png_cache_t;
+
+static	png_cache_t	png_cache[PNG_CACHE_SIZE];
+static	size_t	png_cache_next = 0;
+/* key of the image being drawn, NULL if it should not be cached */
+static	char	*png_key = NULL;
 
 #define RED(x)		((x >> 16) & 0xff)
 #define GREEN(x)	((x >> 8)  & 0xff)
@@ -129,15 +149,55 @@ static void drawimage(gdImagePtr im)
 
 static void drawimage(gdImagePtr im)
 {
+	void	*png;
+	int	size = 0;
+
 	printf("Pragma: no-cache\n");
 	printf("Content-type: image/png\n\n");
 
-	gdImagePng(im, stdout);
+	png = gdImagePngPtr(im, &size);
 	gdImageDestroy(im);
 
-	upscli_disconnect(&ups);
+	if (png && size > 0)
+		fwrite(png, 1, (size_t)size, stdout);
+
+	if (png_key && png && size > 0) {
+		png_cache_t	*entry = &png_cache[png_cache_next];
+
+		png_cache_next = (png_cache_next + 1) % PNG_CACHE_SIZE;
 
-	exit(EXIT_SUCCESS);
+		free(entry->key);
+		if (entry->png)
+			gdFree(entry->png);
+
+		entry->key = png_key;
+		entry->png = png;
+		entry->size = size;
+		png_key = NULL;
+	} else if (png) {
+		gdFree(png);
+	}
+
+	cgi_finish(EXIT_SUCCESS);
+}
+
+/* send a cached image for this key, if there is one */
+static void png_cache_send(const char *key)
+{
+	size_t	i;
+
+	for (i = 0; i < PNG_CACHE_SIZE; i++) {
+		if (!png_cache[i].key || strcmp(png_cache[i].key, key))
+			continue;
+
+		upsdebugx(2, "%s: %s", __func__, key);
+
+		printf("Pragma: no-cache\n");
+		printf("Content-type: image/png\n\n");
+		fwrite(png_cache[i].png, 1, (size_t)png_cache[i].size, stdout);
+
+		cgi_finish(EXIT_SUCCESS);
+	}
 }
 
 /* helper function to allocate color in the image */
@@ -356,6 +416,10 @@ static void noimage(const char *fmt, ...)
 #endif
 	va_end(ap);
 
+	/* errors may go away, do not keep them */
+	free(png_key);
+	png_key = NULL;
+
 	width = get_imgarg("width");
 	height = get_imgarg("height");
 
@@ -642,7 +706,7 @@ static int get_var(const char *var, char *buf, size_t buflen)
 
 	numq = 3;
 
-	ret = upscli_get(&ups, numq, query, &numa, &answer);
+	ret = upscli_get(ups, numq, query, &numa, &answer);
 
 	if (ret < 0)
 		return 0;
@@ -654,65 +718,57 @@ static int get_var(const char *var, char *buf, size_t buflen)
 	return 1;
 }
 
+/* free what one request allocated, and get back to the defaults */
+static void request_free(void)
+{
+	int	i;
+
+	free(monhost);
+	free(cmd);
+	free(upsname);
+	free(hostname);
+	free(png_key);
+	monhost = cmd = upsname = hostname = png_key = NULL;
+	ups = &ups_none;
+
+	for (i = 0; imgarg_defaults && imgarg[i].name != NULL; i++)
+		imgarg[i].val = imgarg_defaults[i];
+}
+
 static void clean_exit(void)
 {
+	size_t	i;
+
 	/* Flush *our* output before possibly failing in third-party code
 	 * (e.g. SSL libs), so client consumers have a chance to see it */
 	fflush(stdout);
 	fflush(stderr);
 
+	request_free();
+	free(imgarg_defaults);
+	for (i = 0; i < PNG_CACHE_SIZE; i++) {
+		free(png_cache[i].key);
+		if (png_cache[i].png)
+			gdFree(png_cache[i].png);
+	}
+	cgi_upsconn_free();
+
 	upscli_cleanup();
 
 	upsdebugx(1, "%s: finished, exiting", __func__);
 }
 
-int main(int argc, char **argv)
+/* serve one image: the CGI request, or each one in daemon mode */
+static void upsimage_request(void)
 {
-	char	str[SMALLBUF], *s, str_port[16];
-	int	flags_ssl = UPSCLI_CONN_TRYSSL, i;
+	char	str[SMALLBUF], key[LARGEBUF], str_port[16];
+	int	flags_ssl = UPSCLI_CONN_TRYSSL, i, j;
 	upscli_authconf_t	*ac_conn = NULL;
 	double	min, nom, max;
 	double	var = 0;
 
-#ifdef WIN32
-	/* Required ritual before calling any socket functions */
-	static WSADATA	WSAdata;
-	static int	WSA_Started = 0;
-	if (!WSA_Started) {
-		WSAStartup(2, &WSAdata);
-		atexit((void(*)(void))WSACleanup);
-		WSA_Started = 1;
-	}
-
-	/* Avoid binary output conversions, e.g.
-	 * mangling what looks like CRLF on WIN32 */
-	setmode(STDOUT_FILENO, O_BINARY);
-#endif
-
-	upscli_upslog_start_sync(upslog_start_sync(NULL), nut_common_cookie());
-	upscli_upslog_setprocname(xstrdup(getmyprocname()), nut_common_cookie());
-	getprogname_argv0_default(argc > 0 ? argv[0] : NULL, "upsimage(CGI)");
-
-	/* NOTE: Caller must `export NUT_DEBUG_LEVEL` to see debugs for upsc
-	 * and NUT methods called from it. This line aims to just initialize
-	 * the subsystem, and set initial timestamp. Debugging the client is
-	 * primarily of use to developers, so is not exposed via `-D` args.
-	 */
-	s = getenv("NUT_DEBUG_LEVEL");
-	if (s && str_to_int(s, &i, 10) && i > 0) {
-		nut_debug_level = i;
-		upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
-	}
-
-#ifdef NUT_CGI_DEBUG_UPSIMAGE
-# if (NUT_CGI_DEBUG_UPSIMAGE - 0 < 1)
-#  undef NUT_CGI_DEBUG_UPSIMAGE
-#  define NUT_CGI_DEBUG_UPSIMAGE 6
-# endif
-	/* Un-comment via make flags when developer-troubleshooting: */
-	nut_debug_level = NUT_CGI_DEBUG_UPSIMAGE;
-	upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
-#endif
+	/* leftovers if the previous request ended early */
+	request_free();
 
 	if (nut_debug_level > 0) {
 		cgilogbit_set();
@@ -724,21 +780,6 @@ int main(int argc, char **argv)
 
 	extractcgiargs();
 
-	upsdebugx(1, "Using best-effort auth config detection");
-	upscli_read_authconf_file(NULL, 0, 1);
-
-	upscli_init_default_connect_timeout(NULL, NULL, UPSCLI_DEFAULT_CONNECT_TIMEOUT);
-	atexit(clean_exit);
-
-	ac_conn = upscli_get_authconf_item(NULL, hostname, snprintf(str_port, sizeof(str_port), "%" PRIu16, port) > 0 ? str_port : NULL, 1);
-	if (ac_conn) {
-		if (upscli_init_authconf(ac_conn) > 0) {
-			upscli_authconf_t	*ac_default = upscli_find_authconf_item(NULL, NULL, NULL);
-			upscli_authconf_update_conn_flags(ac_default, &flags_ssl);
-		}
-		upscli_authconf_update_conn_flags(ac_conn, &flags_ssl);
-	}
-
 	/* no 'host=' or 'display=' given */
 	if ((!monhost) || (!cmd))
 		noimage("No host or display");
@@ -746,20 +787,34 @@ int main(int argc, char **argv)
 	if (!checkhost(monhost, NULL))
 		noimage("Access denied");
 
-	upsname = hostname = NULL;
-
 	if (upscli_splitname(monhost, &upsname, &hostname, &port) != 0) {
 		noimage("Invalid UPS definition (upsname[@hostname[:port]])\n");
 #ifndef HAVE___ATTRIBUTE__NORETURN
-		exit(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
+		cgi_finish(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
 #endif
 	}
 
-	if (upscli_connect(&ups, hostname, port, flags_ssl) < 0) {
+	/* pooled, and kept for the next requests in daemon mode */
+	ups = cgi_upsconn(hostname, port);
+
+	if (!ups) {
+		ac_conn = upscli_get_authconf_item(NULL, hostname, snprintf(str_port, sizeof(str_port), "%" PRIu16, port) > 0 ? str_port : NULL, 1);
+		if (ac_conn) {
+			if (upscli_init_authconf(ac_conn) > 0) {
+				upscli_authconf_t	*ac_default = upscli_find_authconf_item(NULL, NULL, NULL);
+				upscli_authconf_update_conn_flags(ac_default, &flags_ssl);
+			}
+			upscli_authconf_update_conn_flags(ac_conn, &flags_ssl);
+		}
+
+		ups = cgi_upsconn_hold(hostname, port, flags_ssl);
+	}
+
+	if (upscli_fd(ups) < 0) {
 		noimage("Can't connect to server:\n%s\n",
-			upscli_strerror(&ups));
+			upscli_strerror(ups));
 #ifndef HAVE___ATTRIBUTE__NORETURN
-		exit(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
+		cgi_finish(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
 #endif
 	}
 
@@ -768,7 +823,7 @@ int main(int argc, char **argv)
 	 *  This one is for a read-only listing, but could something be abused?
 	 *  If it comes to that, better fall back to requiring query/form args
 	 *  like in upsset.c
-	 *  //upscli_authenticate_authconf(&ups, ac_conn);
+	 *  //upscli_authenticate_authconf(ups, ac_conn);
 	 */
 
 	for (i = 0; imgvar[i].name; i++)
@@ -779,7 +834,7 @@ int main(int argc, char **argv)
 			if (!imgvar[i].drawfunc) {
 				noimage("Draw function N/A");
 #ifndef HAVE___ATTRIBUTE__NORETURN
-				exit(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
+				cgi_finish(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
 #endif
 			}
 
@@ -792,7 +847,7 @@ int main(int argc, char **argv)
 					imgvar[i].name);
 				noimage(str);
 #ifndef HAVE___ATTRIBUTE__NORETURN
-				exit(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
+				cgi_finish(EXIT_FAILURE);	/* Should not get here in practice, but compiler is afraid we can fall through */
 #endif
 			}
 
@@ -844,17 +899,93 @@ int main(int argc, char **argv)
 				max = -1;
 			}
 
+			/* the image only depends on these */
+			if (cgi_serving()) {
+				snprintf(key, sizeof(key), "%s %a %a %a %a",
+					cmd, var, min, nom, max);
+				for (j = 0; imgarg[j].name != NULL; j++)
+					snprintfcat(key, sizeof(key), " %d", imgarg[j].val);
+
+				png_cache_send(key);
+				png_key = xstrdup(key);
+			}
+
 			imgvar[i].drawfunc(var, min, nom, max,
 				imgvar[i].deviation, imgvar[i].format);
 #ifndef HAVE___ATTRIBUTE__NORETURN
-			exit(EXIT_SUCCESS);
+			cgi_finish(EXIT_SUCCESS);
 #endif
 		}
 
 	noimage("Unknown display");
 #ifndef HAVE___ATTRIBUTE__NORETURN
-	exit(EXIT_FAILURE);
+	cgi_finish(EXIT_FAILURE);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	char	*s;
+	int	i;
+
+#ifdef WIN32
+	/* Required ritual before calling any socket functions */
+	static WSADATA	WSAdata;
+	static int	WSA_Started = 0;
+	if (!WSA_Started) {
+		WSAStartup(2, &WSAdata);
+		atexit((void(*)(void))WSACleanup);
+		WSA_Started = 1;
+	}
+
+	/* Avoid binary output conversions, e.g.
+	 * mangling what looks like CRLF on WIN32 */
+	setmode(STDOUT_FILENO, O_BINARY);
 #endif
+
+	upscli_upslog_start_sync(upslog_start_sync(NULL), nut_common_cookie());
+	upscli_upslog_setprocname(xstrdup(getmyprocname()), nut_common_cookie());
+	getprogname_argv0_default(argc > 0 ? argv[0] : NULL, "upsimage(CGI)");
+
+	/* NOTE: Caller must `export NUT_DEBUG_LEVEL` to see debugs for upsc
+	 * and NUT methods called from it. This line aims to just initialize
+	 * the subsystem, and set initial timestamp. Debugging the client is
+	 * primarily of use to developers, so is not exposed via `-D` args.
+	 */
+	s = getenv("NUT_DEBUG_LEVEL");
+	if (s && str_to_int(s, &i, 10) && i > 0) {
+		nut_debug_level = i;
+		upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
+	}
+
+#ifdef NUT_CGI_DEBUG_UPSIMAGE
+# if (NUT_CGI_DEBUG_UPSIMAGE - 0 < 1)
+#  undef NUT_CGI_DEBUG_UPSIMAGE
+#  define NUT_CGI_DEBUG_UPSIMAGE 6
+# endif
+	/* Un-comment via make flags when developer-troubleshooting: */
+	nut_debug_level = NUT_CGI_DEBUG_UPSIMAGE;
+	upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
+#endif
+
+	/* remember the defaults, the query string of each request changes them */
+	for (i = 0; imgarg[i].name != NULL; i++)
+		;
+	imgarg_defaults = (int *)xcalloc((size_t)i, sizeof(*imgarg_defaults));
+	for (i = 0; imgarg[i].name != NULL; i++)
+		imgarg_defaults[i] = imgarg[i].val;
+
+	upsdebugx(1, "Using best-effort auth config detection");
+	upscli_read_authconf_file(NULL, 0, 1);
+
+	upscli_init_default_connect_timeout(NULL, NULL, UPSCLI_DEFAULT_CONNECT_TIMEOUT);
+	atexit(clean_exit);
+
+	/* daemon mode does not return */
+	if (!cgi_serve(upsimage_request))
+		upsimage_request();
+
+	return 0;
 }
 
 imgvar_t imgvar[] = {
@@ -1001,9 +1001,10 @@ int main(int argc, char **argv)
 			fatalx(EXIT_FAILURE, "Error: invalid UPS definition.  Required format: upsname[@hostname[:port]]\n");
 		}
 
-		monhost_ups_current->ups = (UPSCONN_t *)xmalloc(sizeof(UPSCONN_t));
+		/* devices on the same data server share one connection */
+		monhost_ups_current->ups = upscli_pool_connect(monhost_ups_current->hostname, monhost_ups_current->port, flags_ssl, NULL, NULL);
 
-		if (upscli_connect(monhost_ups_current->ups, monhost_ups_current->hostname, monhost_ups_current->port, flags_ssl) < 0)
+		if (upscli_fd(monhost_ups_current->ups) < 0)
 			fprintf(stderr, "Warning: initial connect failed: %s\n",
 				upscli_strerror(monhost_ups_current->ups));
 
@@ -1081,21 +1082,19 @@ int main(int argc, char **argv)
 			monhost_ups_current != NULL;
 			monhost_ups_current = monhost_ups_current->next
 		) {
-			/* reconnect if necessary */
-			if (upscli_fd(monhost_ups_current->ups) < 0) {
-
-				upscli_connect(
-					monhost_ups_current->ups,
-					monhost_ups_current->hostname,
-					monhost_ups_current->port,
-					flags_ssl);
-			}
-
+			/* a pooled connection is re-opened when needed */
 			run_flist(monhost_ups_current);
+		}
 
-			/* don't keep connection open if we don't intend to use it shortly */
-			if (interval > 30) {
-				upscli_disconnect(monhost_ups_current->ups);
+		/* don't keep connections open if we don't intend to use them shortly */
+		if (interval > 30) {
+			for (
+				monhost_ups_current = monhost_ups_anchor;
+				monhost_ups_current != NULL;
+				monhost_ups_current = monhost_ups_current->next
+			) {
+				if (upscli_fd(monhost_ups_current->ups) >= 0)
+					upscli_disconnect(monhost_ups_current->ups);
 			}
 		}
 
@@ -1133,7 +1132,8 @@ int main(int argc, char **argv)
 			monhost_ups_current->logtarget->logfile = NULL;
 		}
 
-		upscli_disconnect(monhost_ups_current->ups);
+		upscli_pool_release(monhost_ups_current->ups);
+		monhost_ups_current->ups = NULL;
 	}
 
 	if (logformat_allocated) {
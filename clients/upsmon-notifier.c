@@ -0,0 +1,932 @@
+/* upsmon-notifier.c - persistent notification worker for upsmon
+
+   Copyright (C) 2026  Network UPS Tools contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "common.h"
+
+#include <sys/types.h>
+#ifndef WIN32
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <limits.h>
+# include <signal.h>
+#else	/* WIN32 */
+# include "wincompat.h"
+#endif	/* WIN32 */
+
+#include "nut_stdint.h"
+#include "parseconf.h"
+#include "timehead.h"
+#include "upsmon-notifier.h"
+
+/* the largest batch handed to one "wall" or NOTIFYCMD call */
+#define NOTIFIER_BATCH_MAX	64
+
+/* delivery processes the worker may have running at the same time */
+#define NOTIFIER_CHILDREN_MAX	8
+
+/* how long to wait for the upssched daemon to acknowledge a command */
+#define NOTIFIER_UPSSCHED_TIMEOUT	1000	/* msec */
+
+/* --- framing --- */
+
+static size_t frame_str(unsigned char *buf, size_t pos, size_t end, const char *s)
+{
+	size_t	len = s ? strlen(s) : 0;
+
+	/* truncate to keep room for the NUL */
+	if (pos + len + 1 > end)
+		len = end - pos - 1;
+
+	if (len)
+		memcpy(buf + pos, s, len);
+	buf[pos + len] = '\0';
+
+	return pos + len + 1;
+}
+
+size_t notifier_frame(unsigned char *buf, size_t bufsize, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice)
+{
+	size_t	end = bufsize, pos;
+	uint32_t	u32;
+
+	if (end > NOTIFIER_FRAME_MAX)
+		end = NOTIFIER_FRAME_MAX;
+
+	/* the header and three (possibly empty) strings */
+	if (end < NOTIFIER_FRAME_HDR + 3)
+		return 0;
+
+	/* keep at least one byte for each of the following strings */
+	pos = frame_str(buf, NOTIFIER_FRAME_HDR, end - 2, ntype);
+	pos = frame_str(buf, pos, end - 1, upsname);
+	pos = frame_str(buf, pos, end, notice);
+
+	u32 = (uint32_t)pos;
+	memcpy(buf, &u32, sizeof(u32));
+	u32 = (uint32_t)flags;
+	memcpy(buf + 4, &u32, sizeof(u32));
+
+	return pos;
+}
+
+int notifier_unframe(const unsigned char *buf, size_t len, unsigned int *flags,
+	const char **ntype, const char **upsname, const char **notice)
+{
+	uint32_t	size, u32;
+	const	char	*str[3];
+	const	unsigned char	*p, *nul;
+	size_t	i;
+
+	if (len < NOTIFIER_FRAME_HDR)
+		return 0;
+
+	memcpy(&size, buf, sizeof(size));
+	if (size < NOTIFIER_FRAME_HDR + 3 || size > NOTIFIER_FRAME_MAX)
+		return -1;
+
+	if (len < size)
+		return 0;
+
+	p = buf + NOTIFIER_FRAME_HDR;
+	for (i = 0; i < 3; i++) {
+		nul = (const unsigned char *)memchr(p, '\0', (size_t)(buf + size - p));
+		if (!nul)
+			return -1;
+		str[i] = (const char *)p;
+		p = nul + 1;
+	}
+
+	/* nothing may follow the last string */
+	if (p != buf + size)
+		return -1;
+
+	memcpy(&u32, buf + 4, sizeof(u32));
+	*flags = (unsigned int)u32;
+	*ntype = str[0];
+	*upsname = str[1];
+	*notice = str[2];
+
+	return (int)size;
+}
+
+/* --- the queue --- */
+
+int notifier_queue_add(notifier_queue_t *q, uint64_t now, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice)
+{
+	notifier_batch_t	*b = q->tail;
+	notifier_event_t	*ev;
+
+	if (q->max && q->events >= q->max) {
+		q->dropped++;
+		return 0;
+	}
+
+	ev = (notifier_event_t *)xcalloc(1, sizeof(*ev));
+	ev->upsname = xstrdup(upsname ? upsname : "");
+	ev->notice = xstrdup(notice ? notice : "");
+	q->events++;
+
+	/* only the newest batch takes more events, so that an event is
+	 * never delivered before another one which arrived earlier */
+	if (b && q->coalesce && now < b->deadline
+	 && !(flags & NOTIFIER_ALONE)
+	 && b->count < NOTIFIER_BATCH_MAX
+	 && b->flags == flags && !strcmp(b->ntype, ntype)
+	) {
+		b->last->next = ev;
+		b->last = ev;
+		b->count++;
+		return 2;
+	}
+
+	b = (notifier_batch_t *)xcalloc(1, sizeof(*b));
+	b->flags = flags;
+	b->ntype = xstrdup(ntype);
+	b->count = 1;
+	b->first = b->last = ev;
+	b->deadline = (flags & NOTIFIER_ALONE) ? now : now + q->coalesce;
+
+	if (q->tail)
+		q->tail->next = b;
+	else
+		q->head = b;
+	q->tail = b;
+
+	return 1;
+}
+
+notifier_batch_t *notifier_queue_due(notifier_queue_t *q, uint64_t now, int flush)
+{
+	notifier_batch_t	*b = q->head;
+
+	if (!b || (!flush && now < b->deadline))
+		return NULL;
+
+	q->head = b->next;
+	if (!q->head)
+		q->tail = NULL;
+	b->next = NULL;
+	q->events -= b->count;
+
+	return b;
+}
+
+int notifier_queue_wait(const notifier_queue_t *q, uint64_t now)
+{
+	if (!q->head)
+		return -1;
+
+	if (q->head->deadline <= now)
+		return 0;
+
+	if (q->head->deadline - now > INT_MAX)
+		return INT_MAX;
+
+	return (int)(q->head->deadline - now);
+}
+
+void notifier_batch_free(notifier_batch_t *b)
+{
+	notifier_event_t	*ev, *next;
+
+	if (!b)
+		return;
+
+	for (ev = b->first; ev; ev = next) {
+		next = ev->next;
+		free(ev->upsname);
+		free(ev->notice);
+		free(ev);
+	}
+
+	free(b->ntype);
+	free(b);
+}
+
+void notifier_wall(const char *text)
+{
+#ifndef WIN32
+	FILE	*wf;
+
+	wf = popen("wall", "w");
+
+	if (!wf) {
+		upslog_with_errno(LOG_NOTICE, "Can't invoke wall");
+		return;
+	}
+
+	fprintf(wf, "%s\n", text);
+	pclose(wf);
+#else	/* WIN32 */
+#	define MESSAGE_CMD "message.exe"
+	char	*argv[3];
+	int	ret;
+
+	argv[0] = MESSAGE_CMD;
+	argv[1] = (char *)text;
+	argv[2] = NULL;
+
+	upsdebugx(6, "%s: executing %s with message: %s", __func__, MESSAGE_CMD, NUT_STRARG(text));
+	ret = _spawnvp(_P_WAIT, MESSAGE_CMD, (const char * const *)argv);
+	if (ret != 0) {
+		upslog_with_errno(LOG_NOTICE, "Can't invoke wall (status: %d)", ret);
+	}
+#endif	/* WIN32 */
+}
+
+#ifndef WIN32
+
+/* --- the worker --- */
+
+/* a frame must be written in one go, see notifier_send() */
+#if defined(PIPE_BUF) && (PIPE_BUF < NOTIFIER_FRAME_MAX)
+# define NOTIFIER_SEND_MAX	PIPE_BUF
+#else
+# define NOTIFIER_SEND_MAX	NOTIFIER_FRAME_MAX
+#endif
+
+typedef struct upssched_at_s {
+	char	*ntype;
+	char	*upsname;
+	char	*cmd;
+	char	*arg1;
+	char	*arg2;
+	struct upssched_at_s	*next;
+} upssched_at_t;
+
+static const	notifier_conf_t	*wconf = NULL;
+static upssched_at_t	*at_rules = NULL;
+static char	*upssched_pipefn = NULL;
+static unsigned int	children = 0;
+static volatile sig_atomic_t	worker_flush = 0;
+
+static uint64_t now_msec(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(HAVE_CLOCK_MONOTONIC) && HAVE_CLOCK_GETTIME && HAVE_CLOCK_MONOTONIC
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+#else
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + (uint64_t)(tv.tv_usec / 1000);
+#endif
+}
+
+static void worker_sigterm(int sig)
+{
+	NUT_UNUSED_VARIABLE(sig);
+
+	worker_flush = 1;
+}
+
+static void upssched_err(const char *errmsg)
+{
+	upslogx(LOG_ERR, "Fatal error in parseconf(upssched.conf): %s", errmsg);
+}
+
+/* Only the PIPEFN and the AT lines matter here: timers are still run by
+ * the upssched daemon, and EXECUTE lines by upssched itself */
+static int upssched_load(void)
+{
+	char	fn[NUT_PATH_MAX + 1];
+	PCONF_CTX_t	ctx;
+	upssched_at_t	*at, **tail = &at_rules;
+
+	snprintf(fn, sizeof(fn), "%s/upssched.conf", confpath());
+
+	pconf_init(&ctx, upssched_err);
+
+	if (!pconf_file_begin(&ctx, fn)) {
+		upslogx(LOG_WARNING, "NOTIFYUPSSCHED: %s, calling NOTIFYCMD instead", ctx.errmsg);
+		pconf_finish(&ctx);
+		return 0;
+	}
+
+	while (pconf_file_next(&ctx)) {
+		if (pconf_parse_error(&ctx) || ctx.numargs < 2)
+			continue;
+
+		if (!strcmp(ctx.arglist[0], "PIPEFN")) {
+			free(upssched_pipefn);
+			upssched_pipefn = xstrdup(ctx.arglist[1]);
+			continue;
+		}
+
+		/* AT <notifytype> <upsname> <command> <cmdarg1> [<cmdarg2>] */
+		if (strcmp(ctx.arglist[0], "AT") || ctx.numargs < 5)
+			continue;
+
+		at = (upssched_at_t *)xcalloc(1, sizeof(*at));
+		at->ntype = xstrdup(ctx.arglist[1]);
+		at->upsname = xstrdup(ctx.arglist[2]);
+		at->cmd = xstrdup(ctx.arglist[3]);
+		at->arg1 = xstrdup(ctx.arglist[4]);
+		if (ctx.numargs > 5)
+			at->arg2 = xstrdup(ctx.arglist[5]);
+
+		*tail = at;
+		tail = &at->next;
+	}
+
+	pconf_finish(&ctx);
+
+	if (!upssched_pipefn) {
+		upslogx(LOG_WARNING, "NOTIFYUPSSCHED: no PIPEFN in %s, calling NOTIFYCMD instead", fn);
+		return 0;
+	}
+
+	upsdebugx(1, "%s: talking to the upssched daemon at %s", __func__, upssched_pipefn);
+	return 1;
+}
+
+static int upssched_connect(void)
+{
+	struct	sockaddr_un	saddr;
+	int	fd;
+
+	memset(&saddr, '\0', sizeof(saddr));
+	saddr.sun_family = AF_UNIX;
+	if (snprintf(saddr.sun_path, sizeof(saddr.sun_path), "%s", upssched_pipefn)
+		>= (int)sizeof(saddr.sun_path))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (const struct sockaddr *)&saddr, sizeof(saddr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* the same request as upssched sends; returns 0 when the daemon said OK */
+static int upssched_send(int fd, const char *cmd, const upssched_at_t *at,
+	const char *ntype, const char *upsname, const char *notice)
+{
+	char	buf[LARGEBUF], enc[LARGEBUF + 8];
+	struct	pollfd	pfd;
+	ssize_t	ret;
+	size_t	len;
+
+	snprintf(buf, sizeof(buf), "%s \"%s\"", cmd,
+		pconf_encode(at->arg1, enc, sizeof(enc)));
+	snprintfcat(buf, sizeof(buf), " \"%s\"",
+		at->arg2 ? pconf_encode(at->arg2, enc, sizeof(enc)) : "");
+	snprintfcat(buf, sizeof(buf), " \"%s\"", pconf_encode(ntype, enc, sizeof(enc)));
+	snprintfcat(buf, sizeof(buf), " \"%s\"", pconf_encode(upsname, enc, sizeof(enc)));
+	snprintfcat(buf, sizeof(buf), " \"%s\"\n", pconf_encode(notice, enc, sizeof(enc)));
+
+	upsdebugx(3, "%s: %s", __func__, buf);
+
+	len = strlen(buf);
+	if (write(fd, buf, len) != (ssize_t)len)
+		return -1;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, NOTIFIER_UPSSCHED_TIMEOUT) != 1)
+		return -1;
+
+	ret = read(fd, buf, sizeof(buf) - 1);
+	if (ret < 2 || strncmp(buf, "OK", 2))
+		return -1;
+
+	return 0;
+}
+
+/* Do what "upssched" would do for this event without starting it: send
+ * timer commands to its daemon. Returns 0 if handled, or -1 if upssched
+ * has to be called after all (EXECUTE lines, daemon to be started) */
+static int upssched_event(const char *ntype, const char *upsname, const char *notice)
+{
+	const	upssched_at_t	*at;
+	const	char	*cmd;
+	size_t	matched = 0, needed = 0;
+	int	fd;
+
+	for (at = at_rules; at; at = at->next) {
+		if (strcmp(at->upsname, upsname) && strcmp(at->upsname, "*"))
+			continue;
+		if (strcasecmp(at->ntype, ntype))
+			continue;
+
+		if (strcmp(at->cmd, "START-TIMER")
+		 && strcmp(at->cmd, "START-TIMER-SHARED")
+		 && strcmp(at->cmd, "CANCEL-TIMER"))
+			return -1;
+
+		matched++;
+
+		/* a plain CANCEL does nothing if the daemon is not running */
+		if (strcmp(at->cmd, "CANCEL-TIMER") || at->arg2)
+			needed++;
+	}
+
+	if (matched == 0)
+		return 0;
+
+	fd = upssched_connect();
+	if (fd < 0) {
+		upsdebugx(2, "%s: upssched daemon is not running (%s)", __func__,
+			needed ? "calling upssched to start it" : "nothing to cancel");
+		return needed ? -1 : 0;
+	}
+
+	for (at = at_rules; at; at = at->next) {
+		if (strcmp(at->upsname, upsname) && strcmp(at->upsname, "*"))
+			continue;
+		if (strcasecmp(at->ntype, ntype))
+			continue;
+
+		if (!strcmp(at->cmd, "START-TIMER"))
+			cmd = "START";
+		else if (!strcmp(at->cmd, "START-TIMER-SHARED"))
+			cmd = "START-SHARED";
+		else
+			cmd = "CANCEL";
+
+		if (upssched_send(fd, cmd, at, ntype, upsname, notice) < 0) {
+			upslogx(LOG_WARNING, "NOTIFYUPSSCHED: failed to send %s %s to the upssched daemon, calling NOTIFYCMD instead",
+				cmd, at->arg1);
+			close(fd);
+			return -1;
+		}
+	}
+
+	close(fd);
+	return 0;
+}
+
+/* the messages of a batch, one per line (without the last newline) */
+static char *batch_notices(const notifier_batch_t *b)
+{
+	const	notifier_event_t	*ev;
+	char	*notices;
+	size_t	noticeslen = 1;
+
+	for (ev = b->first; ev; ev = ev->next)
+		noticeslen += strlen(ev->notice) + 1;
+
+	notices = (char *)xcalloc(noticeslen, sizeof(char));
+
+	for (ev = b->first; ev; ev = ev->next)
+		snprintfcat(notices, noticeslen, "%s%s", ev == b->first ? "" : "\n", ev->notice);
+
+	return notices;
+}
+
+static void deliver_wall(const notifier_batch_t *b)
+{
+	char	*notices = batch_notices(b);
+
+	notifier_wall(notices);
+	free(notices);
+}
+
+static void deliver_exec(const notifier_batch_t *b)
+{
+	const	notifier_event_t	*ev, *prev;
+	char	**argv, *names, *notices, count[16];
+	size_t	nameslen = 1;
+
+	/* one event: exactly as the notify() children do it; more events:
+	 * the distinct UPS names in UPSNAME and the messages one per line */
+	for (ev = b->first; ev; ev = ev->next)
+		nameslen += strlen(ev->upsname) + 1;
+
+	names = (char *)xcalloc(nameslen, sizeof(char));
+	notices = batch_notices(b);
+
+	for (ev = b->first; ev; ev = ev->next) {
+		for (prev = b->first; prev != ev; prev = prev->next) {
+			if (!strcmp(prev->upsname, ev->upsname))
+				break;
+		}
+		if (prev == ev)
+			snprintfcat(names, nameslen, "%s%s", *names ? " " : "", ev->upsname);
+	}
+
+	snprintf(count, sizeof(count), "%" PRIuSIZE, b->count);
+
+	setenv("UPSNAME", names, 1);
+	setenv("NOTIFYTYPE", b->ntype, 1);
+	setenv("NOTIFYCOUNT", count, 1);
+
+	argv = (char **)xcalloc(wconf->cmd_argc + 2, sizeof(char *));
+	memcpy(argv, wconf->cmd_argv, wconf->cmd_argc * sizeof(char *));
+	argv[wconf->cmd_argc] = notices;
+	argv[wconf->cmd_argc + 1] = NULL;
+
+	upsdebugx(6, "%s: calling NOTIFYCMD as %s for %" PRIuSIZE " %s event(s)",
+		__func__, NUT_STRARG(wconf->cmd_concat), b->count, b->ntype);
+
+	execvp(argv[0], argv);
+	/* execvp() only returns on error */
+	upslog_with_errno(LOG_ERR, "%s: execvp(%s) failed",
+		__func__, NUT_STRARG(wconf->cmd_concat));
+	exit(EXIT_FAILURE);
+}
+
+/* fork so a slow "wall" or NOTIFYCMD only delays its own batch */
+static void deliver(notifier_batch_t *b)
+{
+	pid_t	pid;
+
+	if ((b->flags & NOTIFIER_EXEC) && wconf->cmd_argc == 0) {
+		upsdebugx(6, "%s: NOTIFIER_EXEC: no NOTIFYCMD was configured", __func__);
+		b->flags &= ~(unsigned int)NOTIFIER_EXEC;
+	}
+
+	if (!(b->flags & NOTIFIER_WALL) && !(b->flags & NOTIFIER_EXEC))
+		return;
+
+	pid = fork();
+
+	if (pid < 0) {
+		upslog_with_errno(LOG_ERR, "Can't fork to notify (%" PRIuSIZE " %s event(s) lost)",
+			b->count, b->ntype);
+		return;
+	}
+
+	if (pid > 0) {
+		children++;
+		return;
+	}
+
+	if (b->flags & NOTIFIER_WALL)
+		deliver_wall(b);
+
+	if (b->flags & NOTIFIER_EXEC)
+		deliver_exec(b);
+
+	exit(EXIT_SUCCESS);
+}
+
+static void worker_queue(notifier_queue_t *q, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice)
+{
+	static	time_t	lastwarn = 0;
+	time_t	now;
+
+	if (notifier_queue_add(q, now_msec(), flags, ntype, upsname, notice))
+		return;
+
+	time(&now);
+	if (difftime(now, lastwarn) < 60)
+		return;
+	lastwarn = now;
+
+	upslogx(LOG_WARNING, "Notification queue is full (%" PRIuSIZE
+		" events), %" PRIuSIZE " notification(s) dropped so far",
+		q->events, q->dropped);
+}
+
+static void worker_event(notifier_queue_t *q, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice)
+{
+	upsdebugx(6, "%s: [%s] %s with flags 0x%04x: %s",
+		__func__, upsname, ntype, flags, notice);
+
+	/* upssched takes one event per call: the EXEC part is sent to the
+	 * upssched daemon straight away, or queued on its own, so that a
+	 * storm of events still forks no more than NOTIFIER_CHILDREN_MAX
+	 * NOTIFYCMD calls at once */
+	if (wconf->cmd_upssched && (flags & NOTIFIER_EXEC)) {
+		if (!at_rules || upssched_event(ntype, upsname, notice) < 0)
+			worker_queue(q, NOTIFIER_EXEC | NOTIFIER_ALONE, ntype, upsname, notice);
+
+		flags &= ~(unsigned int)NOTIFIER_EXEC;
+		if (!(flags & NOTIFIER_WALL))
+			return;
+	}
+
+	worker_queue(q, flags, ntype, upsname, notice);
+}
+
+static void worker_main(int fd)
+{
+	static	unsigned char	buf[NOTIFIER_FRAME_MAX * 8];
+	notifier_queue_t	q;
+	notifier_batch_t	*b;
+	struct	sigaction	sa;
+	struct	pollfd	pfd;
+	size_t	len = 0, done;
+	ssize_t	ret;
+	int	eof = 0, timeout, used;
+	unsigned int	flags;
+	const	char	*ntype, *upsname, *notice;
+
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+
+	/* deliver what is queued before going away */
+	sa.sa_handler = worker_sigterm;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGQUIT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	sa.sa_handler = SIG_DFL;
+	sigaction(SIGCHLD, &sa, NULL);
+
+	if (wconf->cmd_upssched && wconf->upssched && !upssched_load()) {
+		while (at_rules) {
+			upssched_at_t	*next = at_rules->next;
+
+			free(at_rules->ntype);
+			free(at_rules->upsname);
+			free(at_rules->cmd);
+			free(at_rules->arg1);
+			free(at_rules->arg2);
+			free(at_rules);
+			at_rules = next;
+		}
+	}
+
+	memset(&q, 0, sizeof(q));
+	q.max = wconf->queuemax ? wconf->queuemax : NOTIFIER_QUEUE_DEFAULT;
+	q.coalesce = wconf->coalesce;
+
+	upsdebugx(1, "%s: started (coalesce %u msec, queue %" PRIuSIZE " events)",
+		__func__, q.coalesce, q.max);
+
+	for (;;) {
+		if (worker_flush)
+			eof = 1;
+
+		while (children > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+			children--;
+
+		while (children < NOTIFIER_CHILDREN_MAX
+		 && (b = notifier_queue_due(&q, now_msec(), eof)) != NULL
+		) {
+			deliver(b);
+			notifier_batch_free(b);
+		}
+
+		if (eof && !q.head)
+			break;
+
+		timeout = notifier_queue_wait(&q, now_msec());
+		if (q.head && children >= NOTIFIER_CHILDREN_MAX)
+			timeout = 100;
+
+		if (eof) {
+			/* only waiting for a delivery slot now */
+			usleep(100000);
+			continue;
+		}
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, timeout) <= 0)
+			continue;
+
+		ret = read(fd, buf + len, sizeof(buf) - len);
+
+		if (ret < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			upslog_with_errno(LOG_ERR, "%s: read", __func__);
+			eof = 1;
+			continue;
+		}
+
+		if (ret == 0) {
+			upsdebugx(1, "%s: upsmon closed the pipe", __func__);
+			eof = 1;
+			continue;
+		}
+
+		len += (size_t)ret;
+		done = 0;
+
+		while ((used = notifier_unframe(buf + done, len - done,
+			&flags, &ntype, &upsname, &notice)) > 0
+		) {
+			worker_event(&q, flags, ntype, upsname, notice);
+			done += (size_t)used;
+		}
+
+		if (used < 0) {
+			upslogx(LOG_ERR, "%s: bad notification frame, discarding %" PRIuSIZE " bytes",
+				__func__, len - done);
+			done = len;
+		}
+
+		memmove(buf, buf + done, len - done);
+		len -= done;
+	}
+
+	upsdebugx(1, "%s: exiting, %" PRIuSIZE " notification(s) were dropped",
+		__func__, q.dropped);
+
+	exit(EXIT_SUCCESS);
+}
+
+/* --- upsmon side --- */
+
+static pid_t	notifier_pid = -1;
+static int	notifier_fd = -1;
+static size_t	send_dropped = 0;
+
+int notifier_start(const notifier_conf_t *conf)
+{
+	int	fds[2];
+	pid_t	pid;
+
+	if (notifier_running())
+		return (int)notifier_pid;
+
+	if (pipe(fds) < 0) {
+		upslog_with_errno(LOG_ERR, "Can't create the notification worker pipe");
+		return -1;
+	}
+
+	/* neither end should survive in what the processes exec */
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	/* do not let the worker repeat what is buffered on exit() */
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+
+	if (pid < 0) {
+		upslog_with_errno(LOG_ERR, "Can't fork the notification worker");
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (pid == 0) {
+		close(fds[1]);
+		if (conf->child_init)
+			conf->child_init();
+		wconf = conf;
+		worker_main(fds[0]);
+	}
+
+	close(fds[0]);
+
+	/* a stuck worker must never block upsmon */
+	if (fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK) < 0)
+		upslog_with_errno(LOG_WARNING, "%s: fcntl(O_NONBLOCK)", __func__);
+
+	notifier_pid = pid;
+	notifier_fd = fds[1];
+
+	upsdebugx(1, "%s: notification worker started with PID %" PRIiMAX,
+		__func__, (intmax_t)pid);
+
+	return (int)pid;
+}
+
+int notifier_send(unsigned int flags, const char *ntype,
+	const char *upsname, const char *notice)
+{
+	static	time_t	lastwarn = 0;
+	unsigned char	buf[NOTIFIER_SEND_MAX];
+	size_t	len;
+	ssize_t	ret;
+	time_t	now;
+
+	if (notifier_fd < 0)
+		return -1;
+
+	/* nothing for the worker to do */
+	if (!(flags & (NOTIFIER_WALL | NOTIFIER_EXEC)))
+		return 1;
+
+	len = notifier_frame(buf, sizeof(buf), flags, ntype, upsname, notice);
+
+	do {
+		ret = write(notifier_fd, buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret == (ssize_t)len)
+		return 1;
+
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		send_dropped++;
+
+		time(&now);
+		if (difftime(now, lastwarn) >= 60) {
+			lastwarn = now;
+			upslogx(LOG_WARNING, "Notification worker is not keeping up, "
+				"%" PRIuSIZE " notification(s) dropped so far", send_dropped);
+		}
+		return 0;
+	}
+
+	upslog_with_errno(LOG_WARNING, "Can't pass notification to the worker");
+
+	close(notifier_fd);
+	notifier_fd = -1;
+
+	return -1;
+}
+
+int notifier_running(void)
+{
+	pid_t	ret;
+
+	if (notifier_pid <= 0)
+		return 0;
+
+	ret = waitpid(notifier_pid, NULL, WNOHANG);
+
+	/* ECHILD: someone else reaped it already */
+	if (ret == notifier_pid || (ret < 0 && errno == ECHILD)) {
+		upslogx(LOG_WARNING, "Notification worker (PID %" PRIiMAX ") has exited",
+			(intmax_t)notifier_pid);
+		notifier_pid = -1;
+		if (notifier_fd >= 0) {
+			close(notifier_fd);
+			notifier_fd = -1;
+		}
+		return 0;
+	}
+
+	return notifier_fd >= 0;
+}
+
+void notifier_stop(void)
+{
+	if (notifier_fd >= 0) {
+		close(notifier_fd);
+		notifier_fd = -1;
+	}
+
+	/* it goes away on its own after delivering the rest,
+	 * to be reaped by the main loop or by init */
+	if (notifier_pid > 0)
+		upsdebugx(1, "%s: stopping notification worker with PID %" PRIiMAX,
+			__func__, (intmax_t)notifier_pid);
+
+	notifier_pid = -1;
+}
+
+#else	/* WIN32 */
+
+/* notifications are already delivered by a thread on this platform */
+
+int notifier_start(const notifier_conf_t *conf)
+{
+	NUT_UNUSED_VARIABLE(conf);
+	return -1;
+}
+
+int notifier_send(unsigned int flags, const char *ntype,
+	const char *upsname, const char *notice)
+{
+	NUT_UNUSED_VARIABLE(flags);
+	NUT_UNUSED_VARIABLE(ntype);
+	NUT_UNUSED_VARIABLE(upsname);
+	NUT_UNUSED_VARIABLE(notice);
+	return -1;
+}
+
+int notifier_running(void)
+{
+	return 0;
+}
+
+void notifier_stop(void)
+{
+}
+
+#endif	/* WIN32 */
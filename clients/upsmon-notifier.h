@@ -0,0 +1,150 @@
+/* upsmon-notifier.h - persistent notification worker for upsmon
+
+   Copyright (C) 2026  Network UPS Tools contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef NUT_UPSMON_NOTIFIER_H_SEEN
+#define NUT_UPSMON_NOTIFIER_H_SEEN 1
+
+#include <stddef.h>
+#include "nut_stdint.h"
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/* Instead of forking once per event, upsmon can hand the WALL and EXEC
+ * parts of its notifications to a long-lived child over a pipe. Each
+ * event is written as one frame: a header with the frame size and the
+ * NOTIFIER_* flags, followed by the NUL-terminated notify type, UPS name
+ * and message. Frames never exceed NOTIFIER_FRAME_MAX, which is kept at
+ * or below PIPE_BUF so that a non-blocking write is all-or-nothing.
+ *
+ * The worker keeps the events in a bounded queue. Events of the same
+ * type and flags that arrive within the coalescing window of the first
+ * one are merged into a batch, which is then delivered with one "wall"
+ * and one NOTIFYCMD call. Only the newest batch accepts new events, so
+ * the delivery order is the order of arrival. The EXEC part of an event
+ * is never coalesced when NOTIFYCMD is upssched, which takes one event
+ * per call: unless it goes to the upssched daemon, it is queued as a
+ * batch of its own, and waits for a delivery slot like the others.
+ */
+
+/* what to do with an event, as the upsmon NOTIFY_WALL and NOTIFY_EXEC */
+#define NOTIFIER_WALL	(1 << 0)
+#define NOTIFIER_EXEC	(1 << 1)
+/* queue flag of the worker: a batch of one event, due at once */
+#define NOTIFIER_ALONE	(1 << 2)
+
+#define NOTIFIER_FRAME_HDR	8
+#define NOTIFIER_FRAME_MAX	1024
+
+/* defaults for the upsmon.conf NOTIFYCOALESCE and NOTIFYQUEUE settings */
+#define NOTIFIER_COALESCE_DEFAULT	0	/* msec */
+#define NOTIFIER_QUEUE_DEFAULT	256	/* events */
+
+typedef struct notifier_conf_s {
+	unsigned int	coalesce;	/* msec, 0 to deliver each event */
+	size_t	queuemax;		/* pending events before dropping */
+	int	cmd_upssched;		/* NOTIFYCMD is upssched: EXEC is never coalesced */
+	int	upssched;		/* NOTIFYUPSSCHED: talk to the upssched daemon */
+
+	char	**cmd_argv;		/* NOTIFYCMD, NULL-terminated */
+	size_t	cmd_argc;
+	const char	*cmd_concat;	/* for logging */
+
+	/* called in the worker right after fork(), to drop what it
+	 * should not hold (connections, pipes to other processes) */
+	void	(*child_init)(void);
+} notifier_conf_t;
+
+/* fork the worker; returns its PID or -1 (then notify the old way) */
+int notifier_start(const notifier_conf_t *conf);
+
+/* Pass an event to the worker. Returns 1 if it was queued, 0 if it was
+ * dropped because the pipe is full (counted and logged), and -1 if no
+ * worker is running, so the caller should deliver the event itself */
+int notifier_send(unsigned int flags, const char *ntype,
+	const char *upsname, const char *notice);
+
+/* is the worker still there? reaps it if it has exited */
+int notifier_running(void);
+
+/* close our end of the pipe: the worker delivers what it has and exits */
+void notifier_stop(void);
+
+/* send <text> to the logged in users with "wall" (or "message.exe" on
+ * Windows); used by upsmon for NOTIFY_WALL and by the worker */
+void notifier_wall(const char *text);
+
+/* --- internals, exposed for the unit tests --- */
+
+/* encode an event into buf; returns the frame size (strings which do
+ * not fit are truncated) or 0 if bufsize is too small for a header */
+size_t notifier_frame(unsigned char *buf, size_t bufsize, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice);
+
+/* decode the frame at the start of buf; returns its size, 0 if more
+ * data is needed, or -1 if the data is not a valid frame */
+int notifier_unframe(const unsigned char *buf, size_t len, unsigned int *flags,
+	const char **ntype, const char **upsname, const char **notice);
+
+typedef struct notifier_event_s {
+	char	*upsname;
+	char	*notice;
+	struct notifier_event_s	*next;
+} notifier_event_t;
+
+typedef struct notifier_batch_s {
+	unsigned int	flags;
+	char	*ntype;
+	size_t	count;
+	notifier_event_t	*first, *last;
+	uint64_t	deadline;	/* msec, when the batch is due */
+	struct notifier_batch_s	*next;
+} notifier_batch_t;
+
+typedef struct notifier_queue_s {
+	notifier_batch_t	*head, *tail;
+	size_t	events;		/* pending, all batches together */
+	size_t	max;
+	size_t	dropped;
+	unsigned int	coalesce;
+} notifier_queue_t;
+
+/* queue an event that arrived at <now> (msec); returns 1 if it was added
+ * to a new batch, 2 if merged into the newest one, 0 if dropped */
+int notifier_queue_add(notifier_queue_t *q, uint64_t now, unsigned int flags,
+	const char *ntype, const char *upsname, const char *notice);
+
+/* detach the oldest batch if it is due at <now> (or at all, if <flush>) */
+notifier_batch_t *notifier_queue_due(notifier_queue_t *q, uint64_t now, int flush);
+
+/* msec until the oldest batch is due, or -1 if the queue is empty */
+int notifier_queue_wait(const notifier_queue_t *q, uint64_t now);
+
+void notifier_batch_free(notifier_batch_t *batch);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+
+#endif /* NUT_UPSMON_NOTIFIER_H_SEEN */
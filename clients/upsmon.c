@@ -36,6 +36,7 @@
 #include "nut_stdint.h"
 #include "upsclient.h"
 #include "upsmon.h"
+#include "upsmon-notifier.h"
 #include "parseconf.h"
 #include "timehead.h"
 
@@ -58,6 +59,13 @@ static	char	**shutdowncmd_argv = NULL, **notifycmd_argv = NULL, *shutdowncmd_con
 static	size_t	shutdowncmd_argc = 0, notifycmd_argc = 0;
 static	char	*powerdownflag = NULL, *configfile = NULL;
 
+	/* NOTIFYWORKER: deliver WALL and EXEC notifications through one
+	 * long-lived child instead of forking for each event; the other
+	 * settings are passed to it, see upsmon-notifier.h */
+static	int	notifyworker = 0, notifyupssched = 0;
+static	unsigned int	notifycoalesce = NOTIFIER_COALESCE_DEFAULT;
+static	size_t	notifyqueue = NOTIFIER_QUEUE_DEFAULT;
+
 static	unsigned int	minsupplies = 1, sleepval = 5;
 
 	/* sum of all power values from config file */
@@ -230,37 +238,6 @@ static int try_restore_pollfreq(utype_t *ups) {
 	return 0;
 }
 
-static void wall(const char *text)
-{
-#ifndef WIN32
-	FILE	*wf;
-
-	wf = popen("wall", "w");
-
-	if (!wf) {
-		upslog_with_errno(LOG_NOTICE, "Can't invoke wall");
-		return;
-	}
-
-	fprintf(wf, "%s\n", text);
-	pclose(wf);
-#else	/* WIN32 */
-#	define MESSAGE_CMD "message.exe"
-	char	*argv[3];
-	int	ret;
-
-	argv[0] = MESSAGE_CMD;
-	argv[1] = (char *)text;
-	argv[2] = NULL;
-
-	upsdebugx(6, "%s: executing %s with message: %s", __func__, MESSAGE_CMD, NUT_STRARG(text));
-	ret = _spawnvp(_P_WAIT, MESSAGE_CMD, (const char * const *)argv);
-	if (ret != 0) {
-		upslog_with_errno(LOG_NOTICE, "Can't invoke wall (status: %d)", ret);
-	}
-#endif	/* WIN32 */
-}
-
 #ifdef WIN32
 typedef struct async_notify_s {
 	char *notice;
@@ -283,7 +260,7 @@ static unsigned __stdcall async_notify(LPVOID param)
 		char	notice[LARGEBUF];
 
 		snprintf(notice, sizeof(notice), "%s: %s", data->date, data->notice);
-		wall(notice);
+		notifier_wall(notice);
 	}
 
 	if (flag_isset(data->flags, NOTIFY_EXEC)) {
@@ -342,6 +319,16 @@ static void notify(const char *notice, unsigned int flags, const char *ntype,
 	}
 
 #ifndef WIN32
+	/* the notification worker, if any, takes it from here */
+	if (notifier_send(
+		(flag_isset(flags, NOTIFY_WALL) ? NOTIFIER_WALL : 0)
+		| (flag_isset(flags, NOTIFY_EXEC) ? NOTIFIER_EXEC : 0),
+		ntype, upsname, notice) >= 0
+	) {
+		upsdebugx(6, "%s: passed to the notification worker", __func__);
+		return;
+	}
+
 	/* fork here so upsmon doesn't get wedged if the notifier is slow */
 	ret = fork();
 
@@ -363,7 +350,7 @@ static void notify(const char *notice, unsigned int flags, const char *ntype,
 	if (flag_isset(flags, NOTIFY_WALL)) {
 		upsdebugx(6, "%s (%schild): NOTIFY_WALL",
 			__func__, use_pipe ? "grand" : "");
-		wall(notice);
+		notifier_wall(notice);
 	}
 
 	if (flag_isset(flags, NOTIFY_EXEC)) {
@@ -425,6 +412,84 @@ static void notify(const char *notice, unsigned int flags, const char *ntype,
 #endif	/* WIN32 */
 }
 
+#ifndef WIN32
+/* the notification worker must not keep our other descriptors open */
+static void notifier_child_init(void)
+{
+	struct	sigaction	sa;
+	utype_t	*ups;
+	int	fd;
+
+	setproctag("notifier");
+
+	for (ups = firstups; ups != NULL; ups = (utype_t *)ups->next) {
+		fd = upscli_fd(&ups->conn);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	if (use_pipe)
+		close(pipefd[1]);
+
+	if (VALID_FD(sleep_inhibitor_fd))
+		close(sleep_inhibitor_fd);
+
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGCMD_FSD, &sa, NULL);
+	sigaction(SIGCMD_RELOAD, &sa, NULL);
+}
+#endif	/* !WIN32 */
+
+#ifndef WIN32
+/* is NOTIFYCMD the upssched tool itself (not a script calling it)? */
+static int notifycmd_is_upssched(void)
+{
+	char	*name;
+	int	ret;
+
+	if (notifycmd_argc < 1 || !notifycmd_argv || !notifycmd_argv[0])
+		return 0;
+
+	name = xbasename_no_ext(notifycmd_argv[0]);
+	ret = (name && !strcmp(name, "upssched"));
+	free(name);
+
+	return ret;
+}
+#endif	/* !WIN32 */
+
+/* (re)start the notification worker with the current settings */
+static void start_notifier(void)
+{
+#ifndef WIN32
+	static	notifier_conf_t	conf;
+
+	notifier_stop();
+
+	if (!notifyworker)
+		return;
+
+	memset(&conf, 0, sizeof(conf));
+	conf.coalesce = notifycoalesce;
+	conf.queuemax = notifyqueue;
+	conf.cmd_upssched = notifycmd_is_upssched();
+	if (notifyupssched && !conf.cmd_upssched) {
+		upslogx(LOG_WARNING, "NOTIFYUPSSCHED is set, but NOTIFYCMD is not upssched: ignored");
+	} else {
+		conf.upssched = notifyupssched;
+	}
+	conf.cmd_argv = notifycmd_argv;
+	conf.cmd_argc = notifycmd_argc;
+	conf.cmd_concat = notifycmd_concat;
+	conf.child_init = notifier_child_init;
+
+	if (notifier_start(&conf) < 0)
+		upslogx(LOG_WARNING, "Notification worker not started, forking for each notification");
+#endif	/* !WIN32 */
+}
+
 static void do_notify(const utype_t *ups, unsigned int ntype, const char *extra)
 {
 	int	i;
@@ -955,7 +1020,7 @@ static void doshutdown(void)
 
 	/* this should probably go away at some point */
 	upslogx(LOG_CRIT, "Executing automatic power-fail shutdown");
-	wall("Executing automatic power-fail shutdown\n");
+	notifier_wall("Executing automatic power-fail shutdown\n");
 
 	do_notify(NULL, NOTIFY_SHUTDOWN, NULL);
 
@@ -2442,6 +2507,40 @@ static int parse_conf_arg(size_t numargs, char **arg)
 		return 1;
 	}
 
+	/* NOTIFYWORKER (0|1) */
+	if (!strcmp(arg[0], "NOTIFYWORKER")) {
+		notifyworker = atoi(arg[1]);
+		return 1;
+	}
+
+	/* NOTIFYCOALESCE <msec> */
+	if (!strcmp(arg[0], "NOTIFYCOALESCE")) {
+		int inotifycoalesce = atoi(arg[1]);
+		if (inotifycoalesce < 0) {
+			upsdebugx(0, "Ignoring invalid NOTIFYCOALESCE value: %d", inotifycoalesce);
+		} else {
+			notifycoalesce = (unsigned int)inotifycoalesce;
+		}
+		return 1;
+	}
+
+	/* NOTIFYQUEUE <num> */
+	if (!strcmp(arg[0], "NOTIFYQUEUE")) {
+		int inotifyqueue = atoi(arg[1]);
+		if (inotifyqueue < 1) {
+			upsdebugx(0, "Ignoring invalid NOTIFYQUEUE value: %d", inotifyqueue);
+		} else {
+			notifyqueue = (size_t)inotifyqueue;
+		}
+		return 1;
+	}
+
+	/* NOTIFYUPSSCHED (0|1) */
+	if (!strcmp(arg[0], "NOTIFYUPSSCHED")) {
+		notifyupssched = atoi(arg[1]);
+		return 1;
+	}
+
 	/* POLLFREQ <num> */
 	if (!strcmp(arg[0], "POLLFREQ")) {
 		int ipollfreq = atoi(arg[1]);
@@ -2865,6 +2964,9 @@ static void upsmon_cleanup(void)
 		utmp = unext;
 	}
 
+	/* let the worker deliver what it has queued, and go away */
+	notifier_stop();
+
 	free(run_as_user);
 	run_as_user = NULL;
 	free(shutdowncmd_concat);
@@ -3863,6 +3965,9 @@ static void reload_conf(void)
 		fatalx(EXIT_FAILURE, "Impossible power configuration, unable to continue");
 	}
 
+	/* pick up the new NOTIFYCMD and worker settings */
+	start_notifier();
+
 	/* finally clear the flag */
 	reload_flag = 0;
 }
@@ -4315,6 +4420,8 @@ int main(int argc, char *argv[])
 	closelog();
 	open_syslog(prog);
 
+	start_notifier();
+
 	upsnotify(NOTIFY_STATE_READY_WITH_PID, NULL);
 	gettimeofday(&prevstart, NULL);
 
@@ -4466,6 +4573,10 @@ int main(int argc, char *argv[])
 #ifndef WIN32
 		/* reap children that have exited */
 		waitpid(-1, NULL, WNOHANG);
+
+		/* bring the notification worker back if it died */
+		if (notifyworker && !notifier_running())
+			start_notifier();
 #endif
 
 		if (userfsd) {
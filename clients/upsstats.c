@@ -70,17 +70,48 @@ static char	*monhostdesc = NULL;
 
 static uint16_t	port;
 static char	*upsname, *hostname;
-static char	*upsimgpath = "upsimage.cgi" EXEEXT, *upsstatpath = "upsstats.cgi" EXEEXT,
+/* defaults, or copies of the UPSIMGPATH and UPSSTATPATH template arguments */
+static char	default_upsimgpath[] = "upsimage.cgi" EXEEXT,
+	default_upsstatpath[] = "upsstats.cgi" EXEEXT;
+static char	*upsimgpath = default_upsimgpath, *upsstatpath = default_upsstatpath,
 	*template_single = NULL, *template_list = NULL;
-static UPSCONN_t	ups;
+
+/* the connection used for currups, see cgi_upsconn() */
+static UPSCONN_t	ups_none, *ups = &ups_none;
 
 #define DEFAULT_TEMPLATE_SINGLE	"upsstats-single.html"
 #define DEFAULT_TEMPLATE_LIST	"upsstats.html"
 
-static FILE	*tf;
-static long	forofs = 0;
-
-static ulist_t	*ulhead = NULL, *currups = NULL,
+/* Templates read from disk, kept while unchanged for the next requests
+ * in daemon mode. Lines are split like fgets() into a LARGEBUF did. */
+typedef struct template_s {
+	char	*fn;
+	time_t	mtime;
+	off_t	size;
+	char	**lines;
+	size_t	numlines;
+	struct template_s	*next;
+} template_t;
+
+static template_t	*templates = NULL;
+
+/* next line of the template to process, and first line of the FOREACHUPS
+ * loop body (0 when not in a loop: the first line holds the magic) */
+static size_t	tline = 0, forline = 0;
+
+/* Values of all variables of one device, read with a single LIST VAR
+ * instead of a GET VAR for each use in the template */
+typedef struct {
+	char	*name;
+	char	*value;
+} upsvar_t;
+
+static upsvar_t	*upsvars = NULL;
+static size_t	upsvars_num = 0, upsvars_alloc = 0;
+static const void	*upsvars_ups = NULL;	/* whose values these are */
+static int	upsvars_ok = 0;
+
+static ulist_t	*ulhead = NULL, *currups = NULL, *lastups = NULL,
 	/* hijack the linked-list structure to store
 	 * just filenames (as "sys") so far */
 	*allowed_template_single_lhead = NULL,
@@ -134,10 +165,10 @@ static void report_error(void)
 {
 	upsdebug_call_starting0();
 
-	if (upscli_upserror(&ups) == UPSCLI_ERR_VARNOTSUPP)
+	if (upscli_upserror(ups) == UPSCLI_ERR_VARNOTSUPP)
 		printf("Not supported\n");
 	else
-		printf("[error: %s]\n", upscli_strerror(&ups));
+		printf("[error: %s]\n", upscli_strerror(ups));
 
 	upsdebug_call_finished0();
 }
@@ -147,7 +178,7 @@ static int check_ups_fd(int do_report)
 {
 	upsdebug_call_starting0();
 
-	if (upscli_fd(&ups) == -1) {
+	if (upscli_fd(ups) == -1) {
 		if (do_report)
 			report_error();
 
@@ -170,6 +201,69 @@ static int check_ups_fd(int do_report)
 	return 1;
 }
 
+static void upsvars_free(void)
+{
+	size_t	i;
+
+	for (i = 0; i < upsvars_num; i++) {
+		free(upsvars[i].name);
+		free(upsvars[i].value);
+	}
+
+	upsvars_num = 0;
+	upsvars_ups = NULL;
+	upsvars_ok = 0;
+}
+
+static int upsvar_cmp(const void *a, const void *b)
+{
+	return strcasecmp(((const upsvar_t *)a)->name, ((const upsvar_t *)b)->name);
+}
+
+/* read all variables of currups at once */
+static void upsvars_load(void)
+{
+	int	ret;
+	size_t	numq, numa;
+	const	char	*query[4];
+	char	**answer;
+
+	upsdebug_call_starting_for_str1(upsname);
+
+	upsvars_free();
+	upsvars_ups = currups;
+
+	query[0] = "VAR";
+	query[1] = upsname;
+	numq = 2;
+
+	if (upscli_list_start(ups, numq, query) < 0) {
+		upsdebug_call_finished1(": upscli_list_start() failed");
+		return;
+	}
+
+	while ((ret = upscli_list_next(ups, numq, query, &numa, &answer)) == 1) {
+		if (numa < 4)
+			continue;
+
+		if (upsvars_num == upsvars_alloc) {
+			upsvars_alloc = upsvars_alloc ? upsvars_alloc * 2 : 64;
+			upsvars = (upsvar_t *)xrealloc(upsvars,
+				upsvars_alloc * sizeof(*upsvars));
+		}
+
+		upsvars[upsvars_num].name = xstrdup(answer[2]);
+		upsvars[upsvars_num].value = xstrdup(answer[3]);
+		upsvars_num++;
+	}
+
+	qsort(upsvars, upsvars_num, sizeof(*upsvars), upsvar_cmp);
+
+	/* on errors, ask for each variable to report them as before */
+	upsvars_ok = (ret == 0);
+	upsdebug_call_finished2(": %" PRIuSIZE " variables", upsvars_num);
+}
+
 static int get_var(const char *var, char *buf, size_t buflen, int verbose)
 {
 	int	ret;
@@ -193,13 +287,32 @@ static int get_var(const char *var, char *buf, size_t buflen, int verbose)
 		return 0;
 	}
 
+	if (upsvars_ups != currups)
+		upsvars_load();
+
+	if (upsvars_ok) {
+		upsvar_t	key, *found;
+
+		key.name = (char *)var;
+		found = (upsvar_t *)bsearch(&key, upsvars, upsvars_num,
+			sizeof(*upsvars), upsvar_cmp);
+
+		if (found) {
+			snprintf(buf, buflen, "%s", found->value);
+			upsdebug_call_finished0();
+			return 1;
+		}
+
+		/* not listed: the server tells why below */
+	}
+
 	query[0] = "VAR";
 	query[1] = upsname;
 	query[2] = var;
 
 	numq = 3;
 
-	ret = upscli_get(&ups, numq, query, &numa, &answer);
+	ret = upscli_get(ups, numq, query, &numa, &answer);
 
 	if (ret < 0) {
 		if (verbose)
@@ -477,57 +590,18 @@ finish:
 
 static void ups_connect(void)
 {
-	static ulist_t	*lastups = NULL;
-	char	*newups, *newhost;
-	uint16_t	newport = 0;
 	char	str_port[16];
 	upscli_authconf_t	*ac_current = NULL;
 
 	upsdebug_call_starting0();
 
-	/* try to minimize reconnects */
-	if (lastups) {
-
-		/* don't reconnect if these are both the same UPS */
-		if (currups && !strcmp(lastups->sys, currups->sys)) {
-			lastups = currups;
-			upsdebug_call_finished1(": skip: lastups same as currups");
-			return;
-		}
-
-		/* see if it's just on the same host */
-		newups = newhost = NULL;
-
-		if (currups
-		 && upscli_splitname(currups->sys, &newups, &newhost, &newport) != 0
-		) {
-			printf("Unusable UPS definition [%s]\n", currups->sys);
-			fprintf(stderr, "Unusable UPS definition [%s]\n",
-				currups->sys);
-			upsdebug_call_finished1(": Unusable UPS definition");
-			exit(EXIT_FAILURE);
-		}
-
-		if (currups && hostname && (!strcmp(newhost, hostname)) && (port == newport)) {
-			free(upsname);
-			upsname = newups;
-
-			free(newhost);
-			lastups = currups;
-
-			upsdebug_call_finished2(": pick next device on already connected data server [%s]", NUT_STRARG(currups->sys));
-			return;
-		}
-
-		/* not the same upsd, so disconnect */
-		free(newups);
-		free(newhost);
-
-		upsdebugx(2, "%s: not same data server as used by lastups: will connect to another", __func__);
+	/* don't reconnect if these are both the same UPS */
+	if (lastups && currups && !strcmp(lastups->sys, currups->sys)) {
+		lastups = currups;
+		upsdebug_call_finished1(": skip: lastups same as currups");
+		return;
 	}
 
-	upscli_disconnect(&ups);
-
 	free(upsname);
 	free(hostname);
 	upsname = NULL;
@@ -537,7 +611,23 @@ static void ups_connect(void)
 		printf("Unusable UPS definition [%s]\n", currups->sys);
 		fprintf(stderr, "Unusable UPS definition [%s]\n", currups->sys);
 		upsdebug_call_finished1(": Unusable UPS definition");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
+	}
+
+	lastups = currups;
+
+	if (!currups) {
+		ups = &ups_none;
+		upsdebug_call_finished1(": no currups");
+		return;
+	}
+
+	/* try to minimize reconnects: pooled connections to each data server
+	 * are shared by its devices, and kept for next requests in daemon mode */
+	ups = cgi_upsconn(hostname, port);
+	if (ups) {
+		upsdebug_call_finished2(": pick next device on already connected data server [%s]", NUT_STRARG(currups->sys));
+		return;
 	}
 
 	/* FIXME: Currently libupsclient allows for one SSL context shared
@@ -561,23 +651,22 @@ static void ups_connect(void)
 
 	flags_ssl = flags_ssl_default;
 	upscli_authconf_update_conn_flags(ac_current, &flags_ssl);
-	if (currups && upscli_connect(&ups, hostname, port, flags_ssl) < 0) {
+	ups = cgi_upsconn_hold(hostname, port, flags_ssl);
+	if (upscli_fd(ups) < 0) {
 		fprintf(stderr, "UPS [%s]: can't connect to server: %s\n",
-			currups ? NUT_STRARG(currups->sys) : "<currups=null>",
-			upscli_strerror(&ups));
+			NUT_STRARG(currups->sys), upscli_strerror(ups));
 	} else {
 		/* TOTHINK #3411: Consider autologin via ac_conn->user/pass fields?
 		 *  Probably no, not for a web client anyone can interact with...
 		 *  This one is for a read-only listing, but could something be abused?
 		 *  If it comes to that, better fall back to requiring query/form args
 		 *  like in upsset.c
-		 *  //upscli_authenticate_authconf(&ups, ac_current);
+		 *  //upscli_authenticate_authconf(ups, ac_current);
 		 */
 	}
 
-	lastups = currups;
 	upsdebug_call_finished2(": pick first device on newly connected data server [%s]",
-		currups ? NUT_STRARG(currups->sys) : "<currups=null>");
+		NUT_STRARG(currups->sys));
 }
 
 static void do_hostlink(void)
@@ -824,7 +913,9 @@ static void do_upsstatpath(const char *s) {
 	upsdebug_call_starting_for_str1(s);
 
 	if(strlen(s)) {
-		upsstatpath = strdup(s);
+		if (upsstatpath != default_upsstatpath)
+			free(upsstatpath);
+		upsstatpath = xstrdup(s);
 	}
 
 	upsdebug_call_finished0();
@@ -834,7 +925,9 @@ static void do_upsimgpath(const char *s) {
 	upsdebug_call_starting_for_str1(s);
 
 	if(strlen(s)) {
-		upsimgpath = strdup(s);
+		if (upsimgpath != default_upsimgpath)
+			free(upsimgpath);
+		upsimgpath = xstrdup(s);
 	}
 
 	upsdebug_call_finished0();
@@ -1035,7 +1128,7 @@ static int do_command(char *cmd)
 	}
 
 	if (!strcmp(cmd, "FOREACHUPS")) {
-		forofs = ftell(tf);
+		forline = tline;
 
 		currups = ulhead;
 		upsdebugx(2, "%s: FOREACHUPS: begin with UPS [%s] [%s]", __func__, NUT_STRARG(currups->sys), NUT_STRARG(currups->desc));
@@ -1047,7 +1140,7 @@ static int do_command(char *cmd)
 
 	if (!strcmp(cmd, "ENDFOR")) {
 		/* if not in a for, ignore this */
-		if (forofs == 0) {
+		if (forline == 0) {
 			upsdebug_call_finished1(": not in FOR");
 			return 1;
 		}
@@ -1058,7 +1151,7 @@ static int do_command(char *cmd)
 
 		if (currups) {
 			upsdebugx(2, "%s: ENDFOR: proceed with next UPS [%s]", __func__, NUT_STRARG(currups->desc));
-			fseek(tf, forofs, SEEK_SET);
+			tline = forline;
 			ups_connect();
 		}
 
@@ -1201,10 +1294,82 @@ static void parse_line(const char *buf)
 	upsdebug_call_finished0();
 }
 
+/* Get the template from the cache, (re-)reading it if it changed on disk;
+ * NULL with errno set if it can not be read */
+static const template_t *template_read(const char *fn)
+{
+	struct stat	st;
+	template_t	*tpl;
+	FILE	*f;
+	char	buf[LARGEBUF];
+	size_t	alloc = 0;
+
+	if (stat(fn, &st) != 0)
+		return NULL;
+
+	for (tpl = templates; tpl; tpl = tpl->next) {
+		if (!strcmp(tpl->fn, fn))
+			break;
+	}
+
+	if (tpl && tpl->mtime == st.st_mtime && tpl->size == st.st_size) {
+		upsdebugx(2, "%s: using cached %s", __func__, fn);
+		return tpl;
+	}
+
+	f = fopen(fn, "rb");
+	if (!f)
+		return NULL;
+
+	if (!tpl) {
+		tpl = (template_t *)xcalloc(1, sizeof(*tpl));
+		tpl->fn = xstrdup(fn);
+		tpl->next = templates;
+		templates = tpl;
+	}
+
+	while (tpl->numlines)
+		free(tpl->lines[--tpl->numlines]);
+	free(tpl->lines);
+	tpl->lines = NULL;
+
+	tpl->mtime = st.st_mtime;
+	tpl->size = st.st_size;
+
+	while (fgets(buf, sizeof(buf), f)) {
+		if (tpl->numlines == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			tpl->lines = (char **)xrealloc(tpl->lines,
+				alloc * sizeof(*tpl->lines));
+		}
+		tpl->lines[tpl->numlines++] = xstrdup(buf);
+	}
+
+	fclose(f);
+	upsdebugx(2, "%s: read %" PRIuSIZE " lines from %s", __func__, tpl->numlines, fn);
+	return tpl;
+}
+
+static void templates_free(void)
+{
+	template_t	*tpl;
+
+	while (templates) {
+		tpl = templates->next;
+		while (templates->numlines)
+			free(templates->lines[--templates->numlines]);
+		free(templates->lines);
+		free(templates->fn);
+		free(templates);
+		templates = tpl;
+	}
+}
+
 /* type = 1 for upsstats-single.html (or custom copy), 2 for upsstats.html (list) */
 static void display_template(const char *tfn, int type)
 {
-	char	fn[NUT_PATH_MAX + 1], buf[LARGEBUF];
+	char	fn[NUT_PATH_MAX + 1];
+	const template_t	*tpl;
 	ulist_t	*tmp = NULL;
 
 	upsdebug_call_starting_for_str1(tfn);
@@ -1217,7 +1382,7 @@ static void display_template(const char *tfn, int type)
 		printf("Error: can't open template file (%s): Not authorized<br/>\n", tfn);
 
 		upsdebug_call_finished1(": subdir in template");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	if (!strstr(tfn, ".htm")) {
@@ -1228,7 +1393,7 @@ static void display_template(const char *tfn, int type)
 		printf("Error: can't open template file (%s): Not authorized<br/>\n", tfn);
 
 		upsdebug_call_finished1(": not a *.htm* file");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	if (type == 1) {
@@ -1260,48 +1425,48 @@ static void display_template(const char *tfn, int type)
 		printf("Error: can't open template file (%s): Not authorized<br/>\n", tfn);
 
 		upsdebug_call_finished1(": template not permitted via hosts.conf");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	snprintf(fn, sizeof(fn), "%s/%s", confpath(), tfn);
 
-	tf = fopen(fn, "rb");
+	tpl = template_read(fn);
 
-	if (!tf) {
+	if (!tpl) {
 		fprintf(stderr, "upsstats: Can't open %s: %s<BR/>\n", fn, strerror(errno));
 
 		printf("Error: can't open template file (%s)<BR/>\n", tfn);
 
 		upsdebug_call_finished1(": no template");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
-	if (!fgets(buf, sizeof(buf), tf)) {
-		fprintf(stderr, "upsstats: template file %s seems to be empty (fgets failed): %s<BR/>\n", fn, strerror(errno));
+	if (!tpl->numlines) {
+		fprintf(stderr, "upsstats: template file %s seems to be empty<BR/>\n", fn);
 
 		printf("Error: template file %s seems to be empty<BR/>\n", tfn);
 
 		upsdebug_call_finished1(": empty template");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	/* Test first line for a bit of expected magic */
-	if (!strncmp(buf, "@NUT_UPSSTATS_TEMPLATE", 22)) {
-		parse_line(buf);
+	tline = 1;
+	if (!strncmp(tpl->lines[0], "@NUT_UPSSTATS_TEMPLATE", 22)) {
+		parse_line(tpl->lines[0]);
 	} else {
 		fprintf(stderr, "upsstats: template file %s does not start with NUT_UPSSTATS_TEMPLATE command<BR/>\n", fn);
 
 		printf("Error: template file %s does not start with NUT_UPSSTATS_TEMPLATE command<BR/>\n", tfn);
 
 		upsdebug_call_finished1(": not a valid template");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
-	while (fgets(buf, sizeof(buf), tf)) {
-		parse_line(buf);
+	while (tline < tpl->numlines) {
+		parse_line(tpl->lines[tline++]);
 	}
 
-	fclose(tf);
 	upsdebug_call_finished0();
 }
 
@@ -1324,7 +1489,7 @@ static void display_tree(int verbose)
 	query[1] = upsname;
 	numq = 2;
 
-	if (upscli_list_start(&ups, numq, query) < 0) {
+	if (upscli_list_start(ups, numq, query) < 0) {
 		if (verbose)
 			report_error();
 		upsdebug_call_finished1(": upscli_list_start() failed");
@@ -1350,7 +1515,7 @@ static void display_tree(int verbose)
 
 	printf("<TR><TH COLSPAN=3 BGCOLOR=\"#60B0B0\"></TH></TR>\n");
 
-	while (upscli_list_next(&ups, numq, query, &numa, &answer) == 1) {
+	while (upscli_list_next(ups, numq, query, &numa, &answer) == 1) {
 
 		/* VAR <upsname> <varname> <val> */
 		if (numa < 4) {
@@ -1491,7 +1656,7 @@ static void load_hosts_conf(int handle_MONITOR)
 
 		/* leave something for the admin */
 		fprintf(stderr, "upsstats: %s\n", ctx.errmsg);
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	while (pconf_file_next(&ctx)) {
@@ -1539,7 +1704,7 @@ static void load_hosts_conf(int handle_MONITOR)
 
 		/* leave something for the admin */
 		fprintf(stderr, "upsstats: no hosts to monitor\n");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 }
 
@@ -1551,7 +1716,7 @@ static void display_single(void)
 		printf("Access to that host [%s] is not authorized.\n",
 			monhost);
 		upsdebug_call_finished1(": not auth");
-		exit(EXIT_FAILURE);
+		cgi_finish(EXIT_FAILURE);
 	}
 
 	add_ups(monhost, monhostdesc);
@@ -1565,7 +1730,6 @@ static void display_single(void)
 	else
 		display_template(template_single, 1);
 
-	upscli_disconnect(&ups);
 	upsdebug_call_finished0();
 }
 
@@ -1580,9 +1744,7 @@ static void display_single(void)
  */
 static void display_json(void)
 {
-	size_t	numq, numa;
-	const	char	*query[4];
-	char	**answer;
+	size_t	j;
 	char	status_buf[SMALLBUF], status_copy[SMALLBUF];
 	int i;
 	int is_first_status;
@@ -1629,12 +1791,12 @@ static void display_json(void)
 
 		if (!is_first_ups) printf(",\n");
 
-		if (upscli_fd(&ups) == -1) {
+		if (upscli_fd(ups) == -1) {
 			printf("  {\"host\": \"");
 			json_print_esc(currups->sys);
 			printf("\", \"desc\": \"");
 			json_print_esc(currups->desc);
-			printf("\", \"error\": \"Connection failed: %s\"}", upscli_strerror(&ups));
+			printf("\", \"error\": \"Connection failed: %s\"}", upscli_strerror(ups));
 			is_first_ups = 0;
 			continue;
 		}
@@ -1676,23 +1838,20 @@ static void display_json(void)
 		printf("    \"vars\": {\n"); /* Start vars object */
 		is_first_var = 1;
 
-		/* Full tree mode: list all variables */
-		query[0] = "VAR";
-		query[1] = upsname;
-		numq = 2;
+		/* Full tree mode: list all variables (already read for the status) */
+		if (upsvars_ups != currups)
+			upsvars_load();
 
-		if (upscli_list_start(&ups, numq, query) < 0) {
-			printf("      \"error\": \"Failed to list variables: %s\"", upscli_strerror(&ups));
+		if (!upsvars_ok) {
+			printf("      \"error\": \"Failed to list variables: %s\"", upscli_strerror(ups));
 		} else {
-			while (upscli_list_next(&ups, numq, query, &numa, &answer) == 1) {
-				if (numa < 4) continue; /* Invalid response */
-
+			for (j = 0; j < upsvars_num; j++) {
 				if (!is_first_var) printf(",\n");
 
 				printf("      \"");
-				json_print_esc(answer[2]); /* var name */
+				json_print_esc(upsvars[j].name);
 				printf("\": \"");
-				json_print_esc(answer[3]); /* var value */
+				json_print_esc(upsvars[j].value);
 				printf("\"");
 
 				is_first_var = 0;
@@ -1703,7 +1862,6 @@ static void display_json(void)
 		printf("  }"); /* End UPS object */
 
 		is_first_ups = 0;
-		upscli_disconnect(&ups); /* Disconnect after each UPS */
 	}
 
 	/* Close the root object in multi-host mode */
@@ -1719,6 +1877,67 @@ static void display_json(void)
 /* --- END: NEW JSON FUNCTION ---------------------------------- */
 /* ------------------------------------------------------------- */
 
+/* free what one request allocated, and get back to the defaults */
+static void request_free(void)
+{
+	ulist_t	*tmp;
+
+	free(monhost);
+	free(monhostdesc);
+	monhost = monhostdesc = NULL;
+
+	free(upsname);
+	free(hostname);
+	upsname = hostname = NULL;
+
+	while (ulhead) {
+		tmp = (ulist_t *)ulhead->next;
+		free(ulhead->sys);
+		free(ulhead->desc);
+		free(ulhead);
+		ulhead = tmp;
+	}
+	currups = lastups = NULL;
+	ups = &ups_none;
+	upsvars_free();
+
+	free(template_single);
+	free(template_list);
+	template_single = template_list = NULL;
+
+	/* Free storage of allowed template names (reusing same kind of structure as UPSes) */
+	while (allowed_template_single_lhead) {
+		tmp = (ulist_t *)allowed_template_single_lhead->next;
+		free(allowed_template_single_lhead->sys);
+		free(allowed_template_single_lhead->desc);
+		free(allowed_template_single_lhead);
+		allowed_template_single_lhead = tmp;
+	}
+
+	while (allowed_template_list_lhead) {
+		tmp = (ulist_t *)allowed_template_list_lhead->next;
+		free(allowed_template_list_lhead->sys);
+		free(allowed_template_list_lhead->desc);
+		free(allowed_template_list_lhead);
+		allowed_template_list_lhead = tmp;
+	}
+
+	if (upsimgpath != default_upsimgpath)
+		free(upsimgpath);
+	if (upsstatpath != default_upsstatpath)
+		free(upsstatpath);
+	upsimgpath = default_upsimgpath;
+	upsstatpath = default_upsstatpath;
+
+	use_celsius = 1;
+	refreshdelay = -1;
+	treemode = 0;
+	output_json = 0;
+	skip_clause = skip_block = 0;
+	tline = forline = 0;
+	call_depth = 0;
+}
+
 static void clean_exit(void)
 {
 	/* Flush *our* output before possibly failing in third-party code
@@ -1726,10 +1945,72 @@ static void clean_exit(void)
 	fflush(stdout);
 	fflush(stderr);
 
+	request_free();
+	templates_free();
+	free(upsvars);
+	cgi_upsconn_free();
+
 	upscli_cleanup();
 	upsdebugx(1, "%s: finished, exiting", __func__);
 }
 
+/* serve one page: the CGI request, or each one in daemon mode */
+static void upsstats_request(void)
+{
+	/* leftovers if the previous request ended early */
+	request_free();
+
+	if (nut_debug_level > 0) {
+		cgilogbit_set();
+		printf("Content-type: text/html\n");
+		printf("Pragma: no-cache\n");
+		printf("\n");
+		printf("<p>NUT CGI Debugging enabled, level: %d</p>\n\n", nut_debug_level);
+	}
+
+	/* Built-in defaults */
+	template_single = xstrdup(DEFAULT_TEMPLATE_SINGLE);
+	template_list = xstrdup(DEFAULT_TEMPLATE_LIST);
+
+	extractcgiargs();
+
+	/*
+	 * If json is in the query, bypass all HTML and call display_json()
+	 */
+	if (output_json) {
+		printf("Content-type: application/json; charset=utf-8\n");
+		printf("Pragma: no-cache\n");
+		printf("\n");
+
+		display_json();
+
+		request_free();
+		return;
+	}
+
+	/* --- Original HTML logic continues below --- */
+
+	printf("Content-type: text/html\n");
+	printf("Pragma: no-cache\n");
+	printf("\n");
+
+	/* if a host is specified, use upsstats-single.html instead
+	 * of listing whatever we know about with upsstats.html */
+	add_allowed_template_single(DEFAULT_TEMPLATE_SINGLE);
+	add_allowed_template_list(DEFAULT_TEMPLATE_LIST);
+	if (monhost) {
+		load_hosts_conf(0);
+		display_single();
+	} else {
+		/* default: multimon replacement mode */
+		load_hosts_conf(1);
+		currups = ulhead;
+		display_template(template_list, 2);
+	}
+
+	request_free();
+}
+
 int main(int argc, char **argv)
 {
 	char *s;
@@ -1776,20 +2057,6 @@ int main(int argc, char **argv)
 	upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
 #endif
 
-	if (nut_debug_level > 0) {
-		cgilogbit_set();
-		printf("Content-type: text/html\n");
-		printf("Pragma: no-cache\n");
-		printf("\n");
-		printf("<p>NUT CGI Debugging enabled, level: %d</p>\n\n", nut_debug_level);
-	}
-
-	/* Built-in defaults */
-	template_single = xstrdup(DEFAULT_TEMPLATE_SINGLE);
-	template_list = xstrdup(DEFAULT_TEMPLATE_LIST);
-
-	extractcgiargs();
-
 	upsdebugx(1, "Using best-effort auth config detection");
 	upscli_read_authconf_file(NULL, 0, 1);
 
@@ -1799,84 +2066,9 @@ int main(int argc, char **argv)
 	/* Prepare for handling in first loop through ups_connect() */
 	ac_default = upscli_find_authconf_item(NULL, NULL, NULL);
 
-	/*
-	 * If json is in the query, bypass all HTML and call display_json()
-	 */
-	if (output_json) {
-		printf("Content-type: application/json; charset=utf-8\n");
-		printf("Pragma: no-cache\n");
-		printf("\n");
-
-		display_json();
-
-		/* Clean up memory */
-		free(monhost);
-		while (ulhead) {
-			currups = (ulist_t *)ulhead->next;
-			free(ulhead->sys);
-			free(ulhead->desc);
-			free(ulhead);
-			ulhead = currups;
-		}
-		free(upsname);
-		free(hostname);
-		free(template_single);
-		free(template_list);
-
-		exit(EXIT_SUCCESS);
-	}
-
-	/* --- Original HTML logic continues below --- */
-
-	printf("Content-type: text/html\n");
-	printf("Pragma: no-cache\n");
-	printf("\n");
-
-	/* if a host is specified, use upsstats-single.html instead
-	 * of listing whatever we know about with upsstats.html */
-	add_allowed_template_single(DEFAULT_TEMPLATE_SINGLE);
-	add_allowed_template_list(DEFAULT_TEMPLATE_LIST);
-	if (monhost) {
-		load_hosts_conf(0);
-		display_single();
-	} else {
-		/* default: multimon replacement mode */
-		load_hosts_conf(1);
-		currups = ulhead;
-		display_template(template_list, 2);
-	}
-
-	/* Clean up memory */
-	free(monhost);
-	upscli_disconnect(&ups);
-	free(upsname);
-	free(hostname);
-	while (ulhead) {
-		currups = (ulist_t *)ulhead->next;
-		free(ulhead->sys);
-		free(ulhead->desc);
-		free(ulhead);
-		ulhead = currups;
-	}
-	free(template_single);
-	free(template_list);
-
-	/* Free storage of allowed template names (reusing same kind of structure as UPSes) */
-	while (allowed_template_single_lhead) {
-		currups = (ulist_t *)allowed_template_single_lhead->next;
-		free(allowed_template_single_lhead->sys);
-		free(allowed_template_single_lhead->desc);
-		free(allowed_template_single_lhead);
-		allowed_template_single_lhead = currups;
-	}
-
-	while (allowed_template_list_lhead) {
-		currups = (ulist_t *)allowed_template_list_lhead->next;
-		free(allowed_template_list_lhead->sys);
-		free(allowed_template_list_lhead->desc);
-		free(allowed_template_list_lhead);
-		allowed_template_list_lhead = currups;
-	}
+	/* daemon mode does not return */
+	if (!cgi_serve(upsstats_request))
+		upsstats_request();
 
 	return 0;
 }
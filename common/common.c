@@ -574,6 +574,10 @@ uint64_t	upsnotify_extend_timeout_usec_default = 600 * 1000000,
 #include <limits.h>
 #include <stdlib.h>
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 #if defined(HAVE_LIB_BSD_KVM_PROC) && HAVE_LIB_BSD_KVM_PROC
 # include <kvm.h>
 # include <sys/param.h>
@@ -4177,21 +4181,403 @@ char * mkstr_dynamic(const char *fmt_dynamic, const char *fmt_reference, ...)
 	return buf;
 }
 
+static void	(*upslog_sink)(int priority, const char *msg) = NULL;
+
+void upslog_set_sink(void (*sink)(int priority, const char *msg))
+{
+	upslog_sink = sink;
+}
+
+/* Write out a formatted message to the currently enabled destinations */
+static void upslog_emit(int priority, const char *buf)
+{
+	if (xbit_test(upslog_flags, UPSLOG_STDERR) || xbit_test(upslog_flags, UPSLOG_STDOUT)) {
+		if (nut_debug_level > 0) {
+			struct timeval		now;
+
+			gettimeofday(&now, NULL);
+
+			if (upslog_start.tv_usec > now.tv_usec) {
+				now.tv_usec += 1000000;
+				now.tv_sec -= 1;
+			}
+
+			/* Print all in one shot, to better avoid
+			 * mixed lines in parallel threads */
+			if (xbit_test(upslog_flags, UPSLOG_STDERR)) {
+#ifdef WIN32
+				fflush(stderr);
+#endif	/* WIN32 */
+				fprintf(stderr, "%s%4.0f.%06ld\t%s%s\n",
+					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "<pre>" : "",
+					difftime(now.tv_sec, upslog_start.tv_sec),
+					(long)(now.tv_usec - upslog_start.tv_usec),
+					buf,
+					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "</pre>" : ""
+				);
+			}
+
+			if (xbit_test(upslog_flags, UPSLOG_STDOUT)) {
+#ifdef WIN32
+				fflush(stdout);
+#endif	/* WIN32 */
+				fprintf(stdout, "%s%4.0f.%06ld\t%s%s\n",
+					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "<pre>" : "",
+					difftime(now.tv_sec, upslog_start.tv_sec),
+					(long)(now.tv_usec - upslog_start.tv_usec),
+					buf,
+					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "</pre>" : ""
+				);
+			}
+		} else {
+			if (xbit_test(upslog_flags, UPSLOG_STDERR))
+				fprintf(stderr, "%s\n", buf);
+			if (xbit_test(upslog_flags, UPSLOG_STDOUT))
+				fprintf(stdout, "%s\n", buf);
+		}
+#ifdef WIN32
+		if (xbit_test(upslog_flags, UPSLOG_STDERR))
+			fflush(stderr);
+		if (xbit_test(upslog_flags, UPSLOG_STDOUT))
+			fflush(stdout);
+#endif	/* WIN32 */
+	}
+	if (xbit_test(upslog_flags, UPSLOG_SYSLOG)) {
+		if (upslog_sink)
+			upslog_sink(priority, buf);
+		else
+			syslog(priority, "%s", buf);
+	}
+}
+
+/* Optional deferred delivery of log messages: daemons can enable it, so
+ * that messages are only formatted into preallocated slots of a ring
+ * buffer by the threads which log them, and are passed to syslog by a
+ * separate writer thread, so a slow syslog does not stall the caller.
+ * Only used while we are not printing to stderr/stdout (backgrounded
+ * daemons), so interactive debugging output is not delayed or reordered.
+ * The ring is guarded by a mutex, so any thread may log. Builds without
+ * pthreads keep logging synchronously.
+ */
+#ifdef HAVE_PTHREAD
+#define UPSLOG_ASYNC_SLOT_SIZE	SMALLBUF
+#define UPSLOG_ASYNC_SLOTS_DEFAULT	64
+
+typedef struct upslog_async_slot_s {
+	int	priority;
+	char	msg[UPSLOG_ASYNC_SLOT_SIZE];
+} upslog_async_slot_t;
+
+static pthread_mutex_t	upslog_async_lock = PTHREAD_MUTEX_INITIALIZER;
+/* "work" wakes up the writer, "done" the threads waiting for it */
+static pthread_cond_t	upslog_async_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	upslog_async_done = PTHREAD_COND_INITIALIZER;
+static pthread_t	upslog_async_writer;
+static int	upslog_async_writer_running = 0, upslog_async_stopping = 0;
+/* the writer has a message out of the ring, being delivered */
+static int	upslog_async_busy = 0;
+
+static upslog_async_slot_t	*upslog_async_ring = NULL;
+static size_t	upslog_async_slots = 0, upslog_async_first = 0, upslog_async_used = 0;
+static uintmax_t	upslog_async_dropped_count = 0, upslog_async_dropped_reported = 0;
+static int	upslog_async_atexit = 0, upslog_async_atfork = 0;
+
+static void upslog_async_atexit_flush(void)
+{
+	upslog_async_enable(0);
+}
+
+/* Keep the lock usable in a forked child, which gets no writer thread
+ * and leaves delivery of the queued messages to the parent */
+static void upslog_async_fork_prepare(void)
+{
+	pthread_mutex_lock(&upslog_async_lock);
+}
+
+static void upslog_async_fork_parent(void)
+{
+	pthread_mutex_unlock(&upslog_async_lock);
+}
+
+static void upslog_async_fork_child(void)
+{
+	upslog_async_writer_running = 0;
+	upslog_async_stopping = 0;
+	upslog_async_busy = 0;
+	upslog_async_first = 0;
+	upslog_async_used = 0;
+	upslog_async_dropped_reported = upslog_async_dropped_count;
+	pthread_mutex_unlock(&upslog_async_lock);
+}
+
+static void *upslog_async_writer_main(void *arg)
+{
+	upslog_async_slot_t	slot;
+	char	msg[SMALLBUF];
+
+	NUT_UNUSED_VARIABLE(arg);
+
+	pthread_mutex_lock(&upslog_async_lock);
+	for (;;) {
+		if (upslog_async_used > 0) {
+			slot = upslog_async_ring[upslog_async_first];
+			upslog_async_first = (upslog_async_first + 1) % upslog_async_slots;
+			upslog_async_used--;
+			upslog_async_busy = 1;
+			pthread_mutex_unlock(&upslog_async_lock);
+
+			upslog_emit(slot.priority, slot.msg);
+
+			pthread_mutex_lock(&upslog_async_lock);
+			upslog_async_busy = 0;
+			pthread_cond_broadcast(&upslog_async_done);
+			continue;
+		}
+
+		if (upslog_async_dropped_count != upslog_async_dropped_reported) {
+			snprintf(msg, sizeof(msg), "Log buffer overflow: %" PRIuMAX
+				" message(s) dropped (%" PRIuMAX " since start)",
+				upslog_async_dropped_count - upslog_async_dropped_reported,
+				upslog_async_dropped_count);
+			upslog_async_dropped_reported = upslog_async_dropped_count;
+			/* flushers must wait for this one too */
+			upslog_async_busy = 1;
+			pthread_mutex_unlock(&upslog_async_lock);
+
+			upslog_emit(LOG_WARNING, msg);
+
+			pthread_mutex_lock(&upslog_async_lock);
+			upslog_async_busy = 0;
+			pthread_cond_broadcast(&upslog_async_done);
+			continue;
+		}
+
+		if (upslog_async_stopping)
+			break;
+
+		pthread_cond_wait(&upslog_async_work, &upslog_async_lock);
+	}
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	return NULL;
+}
+
+/* Wait until the writer has nothing queued or in hand; call locked */
+static size_t upslog_async_drain_locked(void)
+{
+	size_t	pending = upslog_async_used;
+
+	if (!upslog_async_writer_running) {
+		/* e.g. could not start it: deliver ourselves, in order */
+		while (upslog_async_used > 0) {
+			upslog_async_slot_t	*slot = &upslog_async_ring[upslog_async_first];
+
+			upslog_emit(slot->priority, slot->msg);
+			upslog_async_first = (upslog_async_first + 1) % upslog_async_slots;
+			upslog_async_used--;
+		}
+		return pending;
+	}
+
+	while (upslog_async_used > 0 || upslog_async_busy
+	|| upslog_async_dropped_count != upslog_async_dropped_reported
+	) {
+		pthread_cond_signal(&upslog_async_work);
+		pthread_cond_wait(&upslog_async_done, &upslog_async_lock);
+	}
+
+	return pending;
+}
+
+size_t upslog_async_flush(void)
+{
+	size_t	flushed;
+
+	pthread_mutex_lock(&upslog_async_lock);
+	flushed = upslog_async_ring ? upslog_async_drain_locked() : 0;
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	return flushed;
+}
+
+void upslog_async_enable(size_t slots)
+{
+	char	*s;
+	int	ret;
+
+	pthread_mutex_lock(&upslog_async_lock);
+
+	/* Deliver what we have with the current setup */
+	if (upslog_async_ring) {
+		upslog_async_drain_locked();
+
+		if (upslog_async_writer_running) {
+			upslog_async_stopping = 1;
+			pthread_cond_signal(&upslog_async_work);
+			pthread_mutex_unlock(&upslog_async_lock);
+			pthread_join(upslog_async_writer, NULL);
+			pthread_mutex_lock(&upslog_async_lock);
+			upslog_async_writer_running = 0;
+			upslog_async_stopping = 0;
+		}
+
+		free(upslog_async_ring);
+		upslog_async_ring = NULL;
+		upslog_async_slots = 0;
+		upslog_async_first = 0;
+	}
+
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	if (slots == 0)
+		return;
+
+	/* Allow to fall back to synchronous logging for troubleshooting */
+	if ((s = getenv("NUT_LOG_ASYNC")) != NULL
+	&& (!strcasecmp(s, "false") || !strcasecmp(s, "no") || !strcmp(s, "0"))
+	) {
+		upsdebugx(1, "%s: disabled by NUT_LOG_ASYNC", __func__);
+		return;
+	}
+
+	if (slots == SIZE_MAX)
+		slots = UPSLOG_ASYNC_SLOTS_DEFAULT;
+
+	if (!upslog_async_atfork) {
+		pthread_atfork(upslog_async_fork_prepare,
+			upslog_async_fork_parent, upslog_async_fork_child);
+		upslog_async_atfork = 1;
+	}
+
+	pthread_mutex_lock(&upslog_async_lock);
+	upslog_async_ring = (upslog_async_slot_t *)xcalloc(slots, sizeof(upslog_async_slot_t));
+	upslog_async_slots = slots;
+
+	ret = pthread_create(&upslog_async_writer, NULL, upslog_async_writer_main, NULL);
+	if (ret == 0) {
+		upslog_async_writer_running = 1;
+	} else {
+		free(upslog_async_ring);
+		upslog_async_ring = NULL;
+		upslog_async_slots = 0;
+	}
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	if (ret != 0) {
+		upsdebugx(1, "%s: can't start the writer thread (%d), logging synchronously",
+			__func__, ret);
+		return;
+	}
+
+	if (!upslog_async_atexit) {
+		atexit(upslog_async_atexit_flush);
+		upslog_async_atexit = 1;
+	}
+}
+
+uintmax_t upslog_async_dropped(void)
+{
+	uintmax_t	ret;
+
+	pthread_mutex_lock(&upslog_async_lock);
+	ret = upslog_async_dropped_count;
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	return ret;
+}
+
+/* Returns 1 if the message was consumed (queued or dropped),
+ * or 0 if the caller should emit it right away */
+static int upslog_async_queue(int priority, const char *buf)
+{
+	upslog_async_slot_t	*slot;
+	size_t	len;
+
+	/* Unlocked peek: the ring only appears and goes away in
+	 * upslog_async_enable(), called by the main thread */
+	if (!upslog_async_ring
+	|| xbit_test(upslog_flags, UPSLOG_STDERR)
+	|| xbit_test(upslog_flags, UPSLOG_STDOUT)
+	) {
+		return 0;
+	}
+
+	len = strlen(buf);
+
+	pthread_mutex_lock(&upslog_async_lock);
+
+	if (!upslog_async_ring || !upslog_async_writer_running) {
+		pthread_mutex_unlock(&upslog_async_lock);
+		return 0;
+	}
+
+	if (len >= UPSLOG_ASYNC_SLOT_SIZE) {
+		/* Keep the order of messages */
+		upslog_async_drain_locked();
+		pthread_mutex_unlock(&upslog_async_lock);
+		return 0;
+	}
+
+	if (upslog_async_used == upslog_async_slots) {
+		if (priority >= LOG_INFO) {
+			/* Debug and informational noise can be dropped */
+			upslog_async_dropped_count++;
+			pthread_mutex_unlock(&upslog_async_lock);
+			return 1;
+		}
+
+		/* ...but notices (e.g. status changes), warnings and
+		 * errors must not be lost: wait for a free slot */
+		while (upslog_async_used == upslog_async_slots) {
+			pthread_cond_signal(&upslog_async_work);
+			pthread_cond_wait(&upslog_async_done, &upslog_async_lock);
+		}
+	}
+
+	slot = &upslog_async_ring[(upslog_async_first + upslog_async_used) % upslog_async_slots];
+	slot->priority = priority;
+	memcpy(slot->msg, buf, len + 1);
+	upslog_async_used++;
+	pthread_cond_signal(&upslog_async_work);
+
+	pthread_mutex_unlock(&upslog_async_lock);
+
+	return 1;
+}
+#else	/* !HAVE_PTHREAD */
+
+size_t upslog_async_flush(void)
+{
+	return 0;
+}
+
+void upslog_async_enable(size_t slots)
+{
+	if (slots)
+		upsdebugx(1, "%s: not available without pthreads, logging synchronously", __func__);
+}
+
+uintmax_t upslog_async_dropped(void)
+{
+	return 0;
+}
+
+static int upslog_async_queue(int priority, const char *buf)
+{
+	NUT_UNUSED_VARIABLE(priority);
+	NUT_UNUSED_VARIABLE(buf);
+	return 0;
+}
+#endif	/* !HAVE_PTHREAD */
+
 static void vupslog(int priority, const char *fmt, va_list va, int use_strerror)
 {
 	int	ret, errno_orig = errno;
-#ifdef HAVE_VA_COPY_VARIANT
-	/* Most our debug messages fit into this */
-	size_t	bufsize = 256;
-#else
-	/* err on the safe(r) side, as re-runs can truncate
-	 * the output when varargs are re-used */
-	size_t	bufsize = LARGEBUF;
-#endif
-	char	*buf = (char *)xcalloc(bufsize, sizeof(char));
-
-	/* Be pedantic about our limitations */
-	bufsize *= sizeof(char);
+	/* Most our messages fit into this, so we only go
+	 * for the heap for exceptionally long ones */
+	char	stackbuf[LARGEBUF];
+	size_t	bufsize = sizeof(stackbuf);
+	char	*buf = stackbuf;
 
 #ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
 #pragma GCC diagnostic push
@@ -4287,7 +4673,11 @@ static void vupslog(int priority, const char *fmt, va_list va, int use_strerror)
 						newbufsize);
 				}
 				bufsize = newbufsize;
-				buf = (char *)xrealloc(buf, bufsize);
+				if (buf == stackbuf) {
+					buf = (char *)xcalloc(bufsize, sizeof(char));
+				} else {
+					buf = (char *)xrealloc(buf, bufsize);
+				}
 				continue;
 			}
 		} else {
@@ -4357,60 +4747,11 @@ vupslog_too_long:
 	 * first try to log */
 	upslog_start_sync(NULL);
 
-	if (xbit_test(upslog_flags, UPSLOG_STDERR) || xbit_test(upslog_flags, UPSLOG_STDOUT)) {
-		if (nut_debug_level > 0) {
-			struct timeval		now;
-
-			gettimeofday(&now, NULL);
-
-			if (upslog_start.tv_usec > now.tv_usec) {
-				now.tv_usec += 1000000;
-				now.tv_sec -= 1;
-			}
-
-			/* Print all in one shot, to better avoid
-			 * mixed lines in parallel threads */
-			if (xbit_test(upslog_flags, UPSLOG_STDERR)) {
-#ifdef WIN32
-				fflush(stderr);
-#endif	/* WIN32 */
-				fprintf(stderr, "%s%4.0f.%06ld\t%s%s\n",
-					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "<pre>" : "",
-					difftime(now.tv_sec, upslog_start.tv_sec),
-					(long)(now.tv_usec - upslog_start.tv_usec),
-					buf,
-					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "</pre>" : ""
-				);
-			}
+	if (!upslog_async_queue(priority, buf))
+		upslog_emit(priority, buf);
 
-			if (xbit_test(upslog_flags, UPSLOG_STDOUT)) {
-#ifdef WIN32
-				fflush(stdout);
-#endif	/* WIN32 */
-				fprintf(stdout, "%s%4.0f.%06ld\t%s%s\n",
-					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "<pre>" : "",
-					difftime(now.tv_sec, upslog_start.tv_sec),
-					(long)(now.tv_usec - upslog_start.tv_usec),
-					buf,
-					xbit_test(upslog_flags, UPSLOG_CGI_BR) ? "</pre>" : ""
-				);
-			}
-		} else {
-			if (xbit_test(upslog_flags, UPSLOG_STDERR))
-				fprintf(stderr, "%s\n", buf);
-			if (xbit_test(upslog_flags, UPSLOG_STDOUT))
-				fprintf(stdout, "%s\n", buf);
-		}
-#ifdef WIN32
-		if (xbit_test(upslog_flags, UPSLOG_STDERR))
-			fflush(stderr);
-		if (xbit_test(upslog_flags, UPSLOG_STDOUT))
-			fflush(stdout);
-#endif	/* WIN32 */
-	}
-	if (xbit_test(upslog_flags, UPSLOG_SYSLOG))
-		syslog(priority, "%s", buf);
-	free(buf);
+	if (buf != stackbuf)
+		free(buf);
 }
 
 
@@ -5112,6 +5453,9 @@ static void vfatal(const char *fmt, va_list va, int use_strerror)
 	int	syslog_disabled = syslog_is_disabled(),
 		stderr_disabled = (syslog_disabled == 0 || syslog_disabled == 2);
 
+	/* Deliver any deferred messages, and the fatal one synchronously */
+	upslog_async_enable(0);
+
 	if (xbit_test(upslog_flags, UPSLOG_STDERR_ON_FATAL))
 		xbit_set(&upslog_flags, UPSLOG_STDERR);
 	if (xbit_test(upslog_flags, UPSLOG_SYSLOG_ON_FATAL)) {
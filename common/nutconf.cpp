@@ -35,6 +35,7 @@
 
 #include <sstream>
 #include <iostream>
+#include <iterator>
 #include <utility>
 #include <cassert>
 
@@ -95,7 +96,7 @@ Settable<T> StringToSettableNumber(const std::string & src)
 
 NutParser::NutParser(const char* buffer, unsigned int options) :
 _options(options),
-_buffer(buffer),
+_buffer(buffer ? buffer : ""),
 _pos(0) {
 }
 
@@ -105,6 +106,12 @@ _buffer(buffer),
 _pos(0) {
 }
 
+NutParser::NutParser(std::string&& buffer, unsigned int options) :
+_options(options),
+_buffer(std::move(buffer)),
+_pos(0) {
+}
+
 void NutParser::setOptions(unsigned int options, bool set)
 {
 	if(set)
@@ -242,6 +249,50 @@ std::string NutParser::parseSTRCHARS()
 	return str;
 }
 
+/* Length of the run of characters starting at pos, which a STRING token
+ * takes as they are (not escaped, not ending the token) */
+static size_t plainStringLength(const std::string& buffer, size_t pos, bool colon)
+{
+	size_t len = 0;
+
+	for (; pos + len < buffer.size(); ++len) {
+		char c = buffer[pos + len];
+
+		if (!isgraph(c) || c == '\\' || c == '"' || c == '#'
+		||  c == '[' || c == ']' || c == '=' || (c == ':' && colon)
+		) {
+			break;
+		}
+	}
+
+	return len;
+}
+
+/* Same for a QUOTED_STRING token */
+static size_t plainQuotedLength(const std::string& buffer, size_t pos)
+{
+	size_t len = 0;
+
+	for (; pos + len < buffer.size(); ++len) {
+		char c = buffer[pos + len];
+
+		if (c == '\\' || c == '"' || !(c == ' ' || c == '\t' || isgraph(c)))
+			break;
+	}
+
+	return len;
+}
+
+/* Same for a COMMENT token (ends at EOL or a null character) */
+static size_t plainCommentLength(const std::string& buffer, size_t pos)
+{
+	static const std::string eol("\r\n\0", 3);
+
+	size_t end = buffer.find_first_of(eol, pos);
+
+	return (end == std::string::npos ? buffer.size() : end) - pos;
+}
+
 /** Parse a string source for getting the next token, ignoring spaces.
  * \return Token type.
  */
@@ -259,8 +310,10 @@ NutParser::Token NutParser::parseToken()
 
 	Token token;
 	bool escaped = false;
+	bool colon = !hasOptions(OPTION_IGNORE_COLON);
 
-	pushPos();
+	// Where to get back to if there is no valid token
+	size_t start = _pos;
 
 	for (char c = get(); c != 0 /*EOF*/; c = get()) {
 		switch (state) {
@@ -269,25 +322,15 @@ NutParser::Token NutParser::parseToken()
 				if (c == ' ' || c == '\t') {
 					/* Space : do nothing */
 				} else if (c == '[') {
-					token = Token(Token::TOKEN_BRACKET_OPEN, c);
-					popPos();
-					return Token(std::move(token));
+					return Token(Token::TOKEN_BRACKET_OPEN, c);
 				} else if (c == ']') {
-					token = Token(Token::TOKEN_BRACKET_CLOSE, c);
-					popPos();
-					return Token(std::move(token));
-				} else if (c == ':' && !hasOptions(OPTION_IGNORE_COLON)) {
-					token = Token(Token::TOKEN_COLON, c);
-					popPos();
-					return Token(std::move(token));
+					return Token(Token::TOKEN_BRACKET_CLOSE, c);
+				} else if (c == ':' && colon) {
+					return Token(Token::TOKEN_COLON, c);
 				} else if (c == '=') {
-					token = Token(Token::TOKEN_EQUAL, c);
-					popPos();
-					return Token(std::move(token));
+					return Token(Token::TOKEN_EQUAL, c);
 				} else if (c == '\r' || c == '\n') {
-					token = Token(Token::TOKEN_EOL, c);
-					popPos();
-					return Token(std::move(token));
+					return Token(Token::TOKEN_EOL, c);
 				} else if (c == '#') {
 					token.type = Token::TOKEN_COMMENT;
 					state = LEXPARSING_STATE_COMMENT;
@@ -306,7 +349,7 @@ NutParser::Token NutParser::parseToken()
 					state = LEXPARSING_STATE_STRING;
 					token.str += c;
 				} else {
-					rewind();
+					_pos = start;
 					return Token(Token::TOKEN_UNKNOWN);
 				}
 				break;
@@ -318,8 +361,7 @@ NutParser::Token NutParser::parseToken()
 						escaped = false;
 						token.str += '"';
 					} else {
-						popPos();
-						return Token(std::move(token));
+						return token;
 					}
 				} else if (c == '\\') {
 					if (escaped) {
@@ -329,15 +371,17 @@ NutParser::Token NutParser::parseToken()
 						escaped = true;
 					}
 				} else if (c == ' ' || c == '\t' || isgraph(c)) {
-					token.str += c;
+					/* Take the whole run of such characters at once */
+					size_t len = 1 + plainQuotedLength(_buffer, _pos);
+
+					token.str.append(_buffer, _pos - 1, len);
+					_pos += len - 1;
 				} else if (c == '\r' || c == '\n') /* EOL */{
 					/* WTF ? consider it as correct ? */
 					back();
-					popPos();
-					return Token(std::move(token));
+					return token;
 				} else if (c == 0) /* EOF */ {
-					popPos();
-					return Token(std::move(token));
+					return token;
 				} else /* Bad character ?? */ {
 					/* WTF ? Keep, Ignore ? */
 				}
@@ -347,7 +391,7 @@ NutParser::Token NutParser::parseToken()
 			case LEXPARSING_STATE_STRING:
 			{
 				if (c == ' ' || c == '\t' || c == '"' || c == '#' || c == '[' || c == ']'
-				||  (c == ':' && !hasOptions(OPTION_IGNORE_COLON))
+				||  (c == ':' && colon)
 				||  c == '='
 				) {
 					if (escaped) {
@@ -355,8 +399,7 @@ NutParser::Token NutParser::parseToken()
 						token.str += c;
 					} else {
 						back();
-						popPos();
-						return Token(std::move(token));
+						return token;
 					}
 				} else if (c == '\\') {
 					if (escaped) {
@@ -367,13 +410,15 @@ NutParser::Token NutParser::parseToken()
 					}
 				} else if (c == '\r' || c == '\n') /* EOL */{
 					back();
-					popPos();
-					return Token(std::move(token));
+					return token;
 				} else if (c == 0) /* EOF */ {
-					popPos();
-					return Token(std::move(token));
-				}else if (isgraph(c)) {
-					token.str += c;
+					return token;
+				} else if (isgraph(c)) {
+					/* Take the whole run of such characters at once */
+					size_t len = 1 + plainStringLength(_buffer, _pos, colon);
+
+					token.str.append(_buffer, _pos - 1, len);
+					_pos += len - 1;
 				} else /* Bad character ?? */ {
 					/* WTF ? Keep, Ignore ? */
 				}
@@ -383,9 +428,13 @@ NutParser::Token NutParser::parseToken()
 			case LEXPARSING_STATE_COMMENT:
 			{
 				if (c == '\r' || c == '\n') {
-					return Token(std::move(token));
+					return token;
 				} else {
-					token.str += c;
+					/* Take the rest of the line at once */
+					size_t len = 1 + plainCommentLength(_buffer, _pos);
+
+					token.str.append(_buffer, _pos - 1, len);
+					_pos += len - 1;
 				}
 				break;
 			}
@@ -416,13 +465,25 @@ NutParser::Token NutParser::parseToken()
 #endif
 		}
 	}
-	popPos();
-	return Token(std::move(token));
+	return token;
 }
 
 std::list<NutParser::Token> NutParser::parseLine()
 {
-	std::list<NutParser::Token> res;
+	std::vector<Token> tokens;
+
+	parseLine(tokens);
+
+	return std::list<Token>(
+		std::make_move_iterator(tokens.begin()),
+		std::make_move_iterator(tokens.end()));
+}
+
+bool NutParser::parseLine(std::vector<Token>& tokens)
+{
+	size_t start = _pos;
+
+	tokens.clear();
 
 	while (true) {
 		NutParser::Token token = parseToken();
@@ -434,16 +495,17 @@ std::list<NutParser::Token> NutParser::parseLine()
 			case Token::TOKEN_BRACKET_CLOSE:
 			case Token::TOKEN_EQUAL:
 			case Token::TOKEN_COLON:
-				res.push_back(token);
+				tokens.push_back(std::move(token));
 				break;
 			case Token::TOKEN_COMMENT:
-				res.push_back(token);
+				tokens.push_back(std::move(token));
 				// Should return (EOL)Token::TOKEN_COMMENT:
-				return res;
+				return true;
 			case Token::TOKEN_UNKNOWN:
 			case Token::TOKEN_NONE:
 			case Token::TOKEN_EOL:
-				return res;
+				// Nothing was consumed at end of buffer or bad char.
+				return _pos != start;
 #if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && ( (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_COVERED_SWITCH_DEFAULT) || (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_UNREACHABLE_CODE) )
 # pragma GCC diagnostic push
 #endif
@@ -541,7 +603,7 @@ void NutConfigParser::parseConfig()
 						break;
 					case Token::TOKEN_STRING:
 					case Token::TOKEN_QUOTED_STRING:
-						name = tok.str;
+						name = std::move(tok.str);
 						state = CPS_DIRECTIVE_HAVE_NAME;
 						break;
 
@@ -561,7 +623,7 @@ void NutConfigParser::parseConfig()
 					case Token::TOKEN_STRING:
 					case Token::TOKEN_QUOTED_STRING:
 						/* Should occur ! */
-						name = tok.str;
+						name = std::move(tok.str);
 						state = CPS_SECTION_HAVE_NAME;
 						break;
 					case Token::TOKEN_BRACKET_CLOSE:
@@ -681,7 +743,7 @@ void NutConfigParser::parseConfig()
 					case Token::TOKEN_STRING:
 					case Token::TOKEN_QUOTED_STRING:
 						/* Could occur ! */
-						values.push_back(tok.str);
+						values.push_back(std::move(tok.str));
 						state = CPS_DIRECTIVE_VALUES;
 						break;
 
@@ -717,7 +779,7 @@ void NutConfigParser::parseConfig()
 					case Token::TOKEN_STRING:
 					case Token::TOKEN_QUOTED_STRING:
 						/* Could occur ! */
-						values.push_back(tok.str);
+						values.push_back(std::move(tok.str));
 						state = CPS_DIRECTIVE_VALUES;
 						break;
 
@@ -827,10 +889,10 @@ void DefaultConfigParser::onParseDirective(
 	// Separator has no specific semantic in this context
 
 	// Save values
-	_section.entries[directiveName].name = directiveName;
-	_section.entries[directiveName].values = values;
+	GenericConfigSectionEntry& entry = _section.entries[directiveName];
 
-	// TODO Can probably be optimized.
+	entry.name = directiveName;
+	entry.values = values;
 }
 
 void DefaultConfigParser::onParseEnd()
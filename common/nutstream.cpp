@@ -147,6 +147,31 @@ namespace nut {
  */
 NutStream::~NutStream() {}
 
+
+NutStream::status_t NutStream::getData(std::string & data, size_t max_size) {
+	size_t count = 0;
+
+	for (; count < max_size; ++count) {
+		char ch;
+
+		status_t status = getChar(ch);
+
+		if (NUTS_OK != status) {
+			// Report the error (or EoF) next time
+			if (count > 0)
+				break;
+
+			return status;
+		}
+
+		data += ch;
+
+		readChar();
+	}
+
+	return NUTS_OK;
+}
+
 NutStream::status_t NutMemory::getChar(char & ch) {
 	if (m_pos == m_impl.size())
 		return NUTS_EOF;
@@ -175,6 +200,23 @@ NutStream::status_t NutMemory::getString(std::string & str) {
 }
 
 
+NutStream::status_t NutMemory::getData(std::string & data, size_t max_size) {
+	if (m_pos >= m_impl.size())
+		return max_size ? NUTS_EOF : NUTS_OK;
+
+	size_t count = m_impl.size() - m_pos;
+
+	if (count > max_size)
+		count = max_size;
+
+	data.append(m_impl, m_pos, count);
+
+	m_pos += count;
+
+	return NUTS_OK;
+}
+
+
 NutStream::status_t NutMemory::putChar(char ch) {
 	m_impl += ch;
 
@@ -710,21 +752,62 @@ NutStream::status_t NutFile::getString(std::string & str)
 	if (nullptr == m_impl)
 		return NUTS_ERROR;
 
-	// Note that ::fgetc is used instead of ::fgets
+	// Allocate the rest of a regular file at once
+	struct stat st;
+
+	if (0 == ::fstat(::fileno(m_impl), &st) && S_ISREG(st.st_mode)) {
+		long pos = ::ftell(m_impl);
+
+		if (pos >= 0 && st.st_size > pos)
+			str.reserve(str.size() + static_cast<size_t>(st.st_size - pos));
+	}
+
+	// Note that ::fread is used instead of ::fgets
 	// That's because of \0 char. support
 	for (;;) {
-		char ch;
-
-		status_t status = fgetcWrapper(m_impl, ch);
+		status_t status = getData(str, 65536);
 
 		if (NUTS_ERROR == status)
 			return status;
 
 		if (NUTS_EOF == status)
 			return NUTS_OK;
+	}
+}
+
+
+NutStream::status_t NutFile::getData(std::string & data, size_t max_size)
+#if (defined __cplusplus) && (__cplusplus < 201100)
+		throw()
+#endif
+{
+	if (0 == max_size)
+		return NUTS_OK;
+
+	if (m_current_ch_valid) {
+		data += m_current_ch;
+		m_current_ch_valid = false;
+
+		return NUTS_OK;
+	}
+
+	if (nullptr == m_impl)
+		return NUTS_ERROR;
+
+	char buffer[4096];
 
-		str += ch;
+	if (max_size > sizeof(buffer))
+		max_size = sizeof(buffer);
+
+	size_t read_cnt = ::fread(buffer, 1, max_size, m_impl);
+
+	if (read_cnt > 0) {
+		data.append(buffer, read_cnt);
+
+		return NUTS_OK;
 	}
+
+	return ::ferror(m_impl) ? NUTS_ERROR : NUTS_EOF;
 }
 
 
@@ -765,14 +848,12 @@ NutStream::status_t NutFile::putData(const std::string & data)
 		throw()
 #endif
 {
-	// Unfortunately, C FILE interface doesn't have non C-string
-	// put function (i.e. function for raw data output with size specifier
-	for (size_t i = 0; i < data.size(); ++i) {
-		status_t st = putChar(data.at(i));
+	if (nullptr == m_impl)
+		return NUTS_ERROR;
 
-		if (NUTS_ERROR == st)
-			return NUTS_ERROR;
-	}
+	// Unlike ::fputs, ::fwrite also copes with null characters
+	if (data.size() != ::fwrite(data.data(), 1, data.size(), m_impl))
+		return NUTS_ERROR;
 
 	return NUTS_OK;
 }
@@ -1131,8 +1212,8 @@ NutSocket::NutSocket(domain_t dom, type_t type, proto_t proto):
 	m_impl(-1),
 	m_domain(dom),
 	m_type(type),
-	m_current_ch('\0'),
-	m_current_ch_valid(false)
+	m_rbuf_pos(0),
+	m_rbuf_len(0)
 {
 	int cdom   = static_cast<int>(dom);
 	int ctype  = static_cast<int>(type);
@@ -1282,6 +1363,10 @@ bool NutSocket::close(int & err_code, std::string & err_msg)
 	if (0 == err_code) {
 		m_impl = -1;
 
+		// Forget data which were not consumed
+		m_rbuf_pos = 0;
+		m_rbuf_len = 0;
+
 		return true;
 	}
 
@@ -1303,22 +1388,20 @@ NutStream::status_t NutSocket::getChar(char & ch)
 		throw()
 #endif
 {
-	if (m_current_ch_valid) {
-		ch = m_current_ch;
+	if (m_rbuf_pos < m_rbuf_len) {
+		ch = m_rbuf[m_rbuf_pos];
 
 		return NUTS_OK;
 	}
 
-	// TBD: Perhaps we should buffer more bytes at once
-	// However, buffering is already done in kernel space,
-	// so unless we need greater reading efficiency, char-by-char
-	// reading should be sufficient
+	// Fill the buffer with whatever is available (at least one char.)
+	ssize_t read_cnt = sktread(m_impl, m_rbuf, sizeof(m_rbuf));
 
-	ssize_t read_cnt = ::read(m_impl, &ch, 1);
+	if (read_cnt > 0) {
+		m_rbuf_pos = 0;
+		m_rbuf_len = static_cast<size_t>(read_cnt);
 
-	if (1 == read_cnt) {
-		m_current_ch       = ch;
-		m_current_ch_valid = true;
+		ch = m_rbuf[0];
 
 		return NUTS_OK;
 	}
@@ -1339,7 +1422,8 @@ void NutSocket::readChar()
 		throw()
 #endif
 {
-	m_current_ch_valid = false;
+	if (m_rbuf_pos < m_rbuf_len)
+		++m_rbuf_pos;
 }
 
 
@@ -1348,24 +1432,57 @@ NutStream::status_t NutSocket::getString(std::string & str)
 		throw()
 #endif
 {
-	if (m_current_ch_valid)
-		str += m_current_ch;
+	for (;;) {
+		status_t status = getData(str, 65536);
 
-	m_current_ch_valid = false;
+		if (NUTS_ERROR == status)
+			return status;
+
+		if (NUTS_EOF == status)
+			return NUTS_OK;
+	}
+}
 
-	char buffer[512];
 
-	for (;;) {
-		ssize_t read_cnt = sktread(m_impl, buffer, sizeof(buffer) / sizeof(buffer[0]));
+NutStream::status_t NutSocket::getData(std::string & data, size_t max_size)
+#if (defined __cplusplus) && (__cplusplus < 201100)
+		throw()
+#endif
+{
+	if (0 == max_size)
+		return NUTS_OK;
 
-		if (read_cnt < 0)
-			return NUTS_ERROR;
+	// Buffered characters first
+	if (m_rbuf_pos < m_rbuf_len) {
+		size_t count = m_rbuf_len - m_rbuf_pos;
 
-		if (0 == read_cnt)
-			return NUTS_OK;
+		if (count > max_size)
+			count = max_size;
+
+		data.append(m_rbuf + m_rbuf_pos, count);
+
+		m_rbuf_pos += count;
+
+		return NUTS_OK;
+	}
+
+	char buffer[4096];
+
+	if (max_size > sizeof(buffer))
+		max_size = sizeof(buffer);
+
+	ssize_t read_cnt = sktread(m_impl, buffer, max_size);
+
+	if (read_cnt > 0) {
+		data.append(buffer, static_cast<size_t>(read_cnt));
 
-		str.append(buffer, static_cast<size_t>(read_cnt));
+		return NUTS_OK;
 	}
+
+	if (0 == read_cnt)
+		return NUTS_EOF;
+
+	return NUTS_ERROR;
 }
 
 
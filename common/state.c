@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <ctype.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #ifndef WIN32
@@ -33,11 +34,102 @@
 #endif	/* !WIN32 */
 
 #include "common.h"
+#include "nut_stdint.h"
 #include "state.h"
 #include "parseconf.h"
 
+/* Interned names: one entry per distinct (case-insensitively) name,
+ * with the name and its lower-case form stored right after it */
+typedef struct st_intern_s {
+	struct st_intern_s	*next;	/* in the same bucket */
+	size_t	hash;		/* of the lower-case form */
+	const char	*folded;
+} st_intern_t;
+
+#define ST_INTERN_MIN_BUCKETS	256
+
+/* Arena of the nodes of one tree: chunks of nodes (each chunk twice
+ * the size of the previous one, up to a limit) and a list of released
+ * nodes to reuse. Once its last node is released, e.g. when the tree
+ * of a device is freed, the whole arena goes away at once. */
+typedef struct st_arena_chunk_s {
+	struct st_arena_chunk_s	*next;
+	size_t	count;		/* nodes follow the header */
+} st_arena_chunk_t;
+
+struct st_arena_s {
+	st_arena_chunk_t	*chunks;	/* newest first */
+	size_t	used;		/* nodes handed out from the newest chunk */
+	st_tree_t	*released;	/* linked by "right" */
+	size_t	live;
+};
+
+#define ST_ARENA_MIN_CHUNK	8
+#define ST_ARENA_MAX_CHUNK	256
+
+static st_intern_t	**intern_hash = NULL;
+static size_t	intern_hash_size = 0;
+static size_t	intern_count = 0, intern_bytes = 0;
+
 /* internal helpers */
 
+static const char *st_intern_name(const st_intern_t *entry)
+{
+	return (const char *)(entry + 1);
+}
+
+static const st_intern_t *st_intern_entry(const char *interned)
+{
+	return ((const st_intern_t *)(const void *)interned) - 1;
+}
+
+static st_intern_t *st_intern_lookup(const char *name, size_t hash)
+{
+	st_intern_t	*entry;
+
+	if (!intern_hash)
+		return NULL;
+
+	for (entry = intern_hash[hash & (intern_hash_size - 1)]; entry; entry = entry->next) {
+		const char	*ename = st_intern_name(entry);
+
+		if (entry->hash == hash && (ename == name || !strcasecmp(ename, name)))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void st_intern_grow(void)
+{
+	st_intern_t	**old = intern_hash, *entry, *next;
+	size_t	old_size = intern_hash_size, i;
+
+	intern_hash_size = old_size ? old_size * 2 : ST_INTERN_MIN_BUCKETS;
+	intern_hash = (st_intern_t **)xcalloc(intern_hash_size, sizeof(*intern_hash));
+
+	for (i = 0; i < old_size; i++) {
+		for (entry = old[i]; entry; entry = next) {
+			size_t	bucket = entry->hash & (intern_hash_size - 1);
+
+			next = entry->next;
+			entry->next = intern_hash[bucket];
+			intern_hash[bucket] = entry;
+		}
+	}
+
+	free(old);
+}
+
+/* Order two interned names like strcasecmp() would */
+static int st_tree_var_cmp(const char *a, const char *b)
+{
+	if (a == b)
+		return 0;
+
+	return strcmp(st_intern_entry(a)->folded, st_intern_entry(b)->folded);
+}
+
 static void val_escape(st_tree_t *node)
 {
 	char	etmp[ST_MAX_VALUE_LEN];
@@ -61,46 +153,191 @@ static void val_escape(st_tree_t *node)
 	node->val = node->safe;
 }
 
-static void st_tree_enum_free(enum_t *list)
+static st_tree_t *st_arena_chunk_nodes(st_arena_chunk_t *chunk)
 {
-	if (!list) {
-		return;
+	return (st_tree_t *)(void *)(chunk + 1);
+}
+
+static st_tree_t *st_arena_node_new(struct st_arena_s *arena)
+{
+	st_tree_t	*node;
+
+	if (!arena)
+		arena = (struct st_arena_s *)xcalloc(1, sizeof(*arena));
+
+	if (arena->released) {
+		node = arena->released;
+		arena->released = node->right;
+	} else {
+		if (!arena->chunks || arena->used == arena->chunks->count) {
+			size_t	count = arena->chunks ? arena->chunks->count * 2 : ST_ARENA_MIN_CHUNK;
+			st_arena_chunk_t	*chunk;
+
+			if (count > ST_ARENA_MAX_CHUNK)
+				count = ST_ARENA_MAX_CHUNK;
+
+			chunk = (st_arena_chunk_t *)xcalloc(1, sizeof(*chunk) + count * sizeof(st_tree_t));
+			chunk->count = count;
+			chunk->next = arena->chunks;
+			arena->chunks = chunk;
+			arena->used = 0;
+		}
+
+		node = st_arena_chunk_nodes(arena->chunks) + arena->used++;
 	}
 
-	st_tree_enum_free(list->next);
+	memset(node, 0, sizeof(*node));
+	node->arena = arena;
+	arena->live++;
 
-	free(list->val);
-	free(list);
+	return node;
 }
 
-static void st_tree_range_free(range_t *list)
+static void st_arena_node_release(st_tree_t *node)
 {
-	if (!list) {
+	struct st_arena_s	*arena = node->arena;
+	st_arena_chunk_t	*chunk, *next;
+
+	if (--arena->live > 0) {
+		node->right = arena->released;
+		arena->released = node;
 		return;
 	}
 
-	st_tree_range_free(list->next);
+	/* that was the last one, drop all chunks at once */
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
 
-	free(list);
+	free(arena);
+}
+
+/* Rebuild the enum list of a node as one block, without the "drop"
+ * item and with "add" appended (each may be NULL), keeping the order */
+static enum_t *st_tree_enum_pack(const enum_t *list, const enum_t *drop, const char *add)
+{
+	const enum_t	*item;
+	enum_t	*block;
+	size_t	count = 0, textlen = 0, i = 0;
+	char	*text;
+
+	for (item = list; item; item = item->next) {
+		if (item != drop) {
+			count++;
+			textlen += strlen(item->val) + 1;
+		}
+	}
+
+	if (add) {
+		count++;
+		textlen += strlen(add) + 1;
+	}
+
+	if (!count)
+		return NULL;
+
+	block = (enum_t *)xcalloc(1, count * sizeof(*block) + textlen);
+	text = (char *)(block + count);
+
+	for (item = list; item || add; item = item ? item->next : NULL) {
+		const char	*val;
+		size_t	len;
+
+		if (item) {
+			if (item == drop)
+				continue;
+			val = item->val;
+		} else {
+			val = add;
+			add = NULL;
+		}
+
+		len = strlen(val) + 1;
+		memcpy(text, val, len);
+		block[i].val = text;
+		block[i].next = (i + 1 < count) ? &block[i + 1] : NULL;
+		text += len;
+		i++;
+	}
+
+	return block;
+}
+
+/* Same for the range list */
+static range_t *st_tree_range_pack(const range_t *list, const range_t *drop, const range_t *add)
+{
+	const range_t	*item;
+	range_t	*block;
+	size_t	count = 0, i = 0;
+
+	for (item = list; item; item = item->next) {
+		if (item != drop)
+			count++;
+	}
+
+	if (add)
+		count++;
+
+	if (!count)
+		return NULL;
+
+	block = (range_t *)xcalloc(count, sizeof(*block));
+
+	for (item = list; item || add; item = item ? item->next : NULL) {
+		const range_t	*src = item;
+
+		if (item) {
+			if (item == drop)
+				continue;
+		} else {
+			src = add;
+			add = NULL;
+		}
+
+		block[i].min = src->min;
+		block[i].max = src->max;
+		block[i].next = (i + 1 < count) ? &block[i + 1] : NULL;
+		i++;
+	}
+
+	return block;
+}
+
+/* store the literal value, inline if it fits */
+static void st_tree_node_setraw(st_tree_t *node, const char *val)
+{
+	size_t	len = strlen(val) + 1;
+
+	if (!node->raw && len <= sizeof(node->inl)) {
+		node->raw = node->inl;
+		node->rawsize = sizeof(node->inl);
+	}
+
+	if (node->rawsize < len) {
+		node->raw = (char *)xrealloc((node->raw == node->inl) ? NULL : node->raw, len);
+		node->rawsize = len;
+	}
+
+	memcpy(node->raw, val, len);
 }
 
 /* free all memory associated with a node */
 static void st_tree_node_free(st_tree_t *node)
 {
-	free(node->var);
-	free(node->raw);
+	/* never free node->var, it is interned */
+	if (node->raw != node->inl)
+		free(node->raw);
 	free(node->safe);
 
 	/* never free node->val, since it's just a pointer to raw or safe */
 
-	/* blow away the list of enums */
-	st_tree_enum_free(node->enum_list);
-
-	/* and the list of ranges */
-	st_tree_range_free(node->range_list);
+	/* the enums and ranges are one block each */
+	free(node->enum_list);
+	free(node->range_list);
 
-	/* now finally kill the node itself */
-	free(node);
+	/* now finally give the node back to its arena */
+	st_arena_node_release(node);
 }
 
 /* add a subtree to another subtree */
@@ -113,13 +350,14 @@ static void st_tree_node_add(st_tree_t **nptr, st_tree_t *sptr)
 	while (*nptr) {
 
 		st_tree_t	*node = *nptr;
+		int	cmp = st_tree_var_cmp(node->var, sptr->var);
 
-		if (strcasecmp(node->var, sptr->var) > 0) {
+		if (cmp > 0) {
 			nptr = &node->left;
 			continue;
 		}
 
-		if (strcasecmp(node->var, sptr->var) < 0) {
+		if (cmp < 0) {
 			nptr = &node->right;
 			continue;
 		}
@@ -141,6 +379,68 @@ static int st_tree_node_refresh_timestamp(const st_tree_t *node)
 
 /* interface */
 
+const char *state_intern(const char *name)
+{
+	st_intern_t	*entry;
+	size_t	hash, len, bucket, i;
+	char	*dst;
+
+	if (!name)
+		return NULL;
+
+	hash = str_hash_fnv1a(name, 1);
+	entry = st_intern_lookup(name, hash);
+	if (entry)
+		return st_intern_name(entry);
+
+	if (intern_count >= intern_hash_size)
+		st_intern_grow();
+
+	len = strlen(name);
+	entry = (st_intern_t *)xcalloc(1, sizeof(*entry) + 2 * (len + 1));
+	entry->hash = hash;
+
+	dst = (char *)(entry + 1);
+	memcpy(dst, name, len + 1);
+	for (i = 0; i <= len; i++)
+		dst[len + 1 + i] = (char)tolower((unsigned char)name[i]);
+	entry->folded = dst + len + 1;
+
+	bucket = hash & (intern_hash_size - 1);
+	entry->next = intern_hash[bucket];
+	intern_hash[bucket] = entry;
+
+	intern_count++;
+	intern_bytes += sizeof(*entry) + 2 * (len + 1);
+
+	return dst;
+}
+
+const char *state_intern_find(const char *name)
+{
+	st_intern_t	*entry;
+
+	if (!name)
+		return NULL;
+
+	entry = st_intern_lookup(name, str_hash_fnv1a(name, 1));
+
+	return entry ? st_intern_name(entry) : NULL;
+}
+
+size_t state_intern_hash(const char *interned)
+{
+	return st_intern_entry(interned)->hash;
+}
+
+void state_intern_stats(size_t *count, size_t *bytes)
+{
+	if (count)
+		*count = intern_count;
+	if (bytes)
+		*bytes = intern_bytes + intern_hash_size * sizeof(*intern_hash);
+}
+
 /* As underlying system methods:
  * return 0 on success, -1 and errno on error
  */
@@ -203,16 +503,23 @@ int st_tree_node_compare_timestamp(
  */
 int state_delinfo(st_tree_t **nptr, const char *var)
 {
+	/* a name never seen can not be in the tree */
+	const char	*key = state_intern_find(var);
+
+	if (!key)
+		return 0;
+
 	while (*nptr) {
 
 		st_tree_t	*node = *nptr;
+		int	cmp = st_tree_var_cmp(node->var, key);
 
-		if (strcasecmp(node->var, var) > 0) {
+		if (cmp > 0) {
 			nptr = &node->left;
 			continue;
 		}
 
-		if (strcasecmp(node->var, var) < 0) {
+		if (cmp < 0) {
 			nptr = &node->right;
 			continue;
 		}
@@ -238,16 +545,22 @@ int state_delinfo(st_tree_t **nptr, const char *var)
 
 int state_delinfo_olderthan(st_tree_t **nptr, const char *var, const st_tree_timespec_t *cutoff)
 {
+	const char	*key = state_intern_find(var);
+
+	if (!key)
+		return 0;
+
 	while (*nptr) {
 
 		st_tree_t	*node = *nptr;
+		int	cmp = st_tree_var_cmp(node->var, key);
 
-		if (strcasecmp(node->var, var) > 0) {
+		if (cmp > 0) {
 			nptr = &node->left;
 			continue;
 		}
 
-		if (strcasecmp(node->var, var) < 0) {
+		if (cmp < 0) {
 			nptr = &node->right;
 			continue;
 		}
@@ -279,16 +592,20 @@ int state_delinfo_olderthan(st_tree_t **nptr, const char *var, const st_tree_tim
 
 int state_setinfo(st_tree_t **nptr, const char *var, const char *val)
 {
+	const char	*key = state_intern(var);
+	struct st_arena_s	*arena = *nptr ? (*nptr)->arena : NULL;
+
 	while (*nptr) {
 
 		st_tree_t	*node = *nptr;
+		int	cmp = st_tree_var_cmp(node->var, key);
 
-		if (strcasecmp(node->var, var) > 0) {
+		if (cmp > 0) {
 			nptr = &node->left;
 			continue;
 		}
 
-		if (strcasecmp(node->var, var) < 0) {
+		if (cmp < 0) {
 			nptr = &node->right;
 			continue;
 		}
@@ -307,25 +624,21 @@ int state_setinfo(st_tree_t **nptr, const char *var, const char *val)
 			return 0;	/* no change */
 		}
 
-		/* expand the buffer if the value grows */
-		if (node->rawsize < (strlen(val) + 1)) {
-			node->rawsize = strlen(val) + 1;
-			node->raw = (char *)xrealloc(node->raw, node->rawsize);
-		}
-
 		/* store the literal value for later comparisons */
-		snprintf(node->raw, node->rawsize, "%s", val);
+		st_tree_node_setraw(node, val);
+
+		/* whoever set it, a numeric shadow no longer applies */
+		node->numfmt = NULL;
 
 		val_escape(node);
 
 		return 1;	/* changed */
 	}
 
-	*nptr = (st_tree_t *)xcalloc(1, sizeof(**nptr));
+	*nptr = st_arena_node_new(arena);
 
-	(*nptr)->var = xstrdup(var);
-	(*nptr)->raw = xstrdup(val);
-	(*nptr)->rawsize = strlen(val) + 1;
+	(*nptr)->var = key;
+	st_tree_node_setraw(*nptr, val);
 	st_tree_node_refresh_timestamp(*nptr);
 
 	val_escape(*nptr);
@@ -335,24 +648,16 @@ int state_setinfo(st_tree_t **nptr, const char *var, const char *val)
 
 static int st_tree_enum_add(enum_t **list, const char *enc)
 {
-	enum_t	*item;
-
-	while (*list) {
-
-		if (strcmp((*list)->val, enc)) {
-			list = &(*list)->next;
-			continue;
-		}
+	enum_t	*item, *block;
 
-		return 0;	/* duplicate */
+	for (item = *list; item; item = item->next) {
+		if (!strcmp(item->val, enc))
+			return 0;	/* duplicate */
 	}
 
-	item = (enum_t *)xcalloc(1, sizeof(*item));
-	item->val = xstrdup(enc);
-	item->next = *list;
-
-	/* now we're done creating it, add it to the list */
-	*list = item;
+	block = st_tree_enum_pack(*list, NULL, enc);
+	free(*list);
+	*list = block;
 
 	return 1;	/* added */
 }
@@ -380,25 +685,20 @@ int state_addenum(st_tree_t *root, const char *var, const char *val)
 
 static int st_tree_range_add(range_t **list, const int min, const int max)
 {
-	range_t	*item;
-
-	while (*list) {
-
-		if (((*list)->min != min) && ((*list)->max != max)) {
-			list = &(*list)->next;
-			continue;
-		}
+	range_t	*item, *block, add;
 
-		return 0;	/* duplicate */
+	for (item = *list; item; item = item->next) {
+		if ((item->min == min) || (item->max == max))
+			return 0;	/* duplicate */
 	}
 
-	item = (range_t *)xcalloc(1, sizeof(*item));
-	item->min = min;
-	item->max = max;
-	item->next = *list;
+	add.min = min;
+	add.max = max;
+	add.next = NULL;
 
-	/* now we're done creating it, add it to the list */
-	*list = item;
+	block = st_tree_range_pack(*list, NULL, &add);
+	free(*list);
+	*list = block;
 
 	return 1;	/* added */
 }
@@ -646,21 +946,18 @@ int state_delcmd(cmdlist_t **list, const char *cmd)
 
 static int st_tree_del_enum(enum_t **list, const char *val)
 {
-	while (*list) {
+	enum_t	*item, *block;
 
-		enum_t	*item = *list;
+	for (item = *list; item; item = item->next) {
 
 		/* if this is not the right value, go on to the next */
-		if (strcasecmp(item->val, val)) {
-			list = &item->next;
+		if (strcasecmp(item->val, val))
 			continue;
-		}
 
 		/* we found it! */
-		*list = item->next;
-
-		free(item->val);
-		free(item);
+		block = st_tree_enum_pack(*list, item, NULL);
+		free(*list);
+		*list = block;
 
 		return 1;	/* deleted */
 	}
@@ -685,20 +982,18 @@ int state_delenum(st_tree_t *root, const char *var, const char *val)
 
 static int st_tree_del_range(range_t **list, const int min, const int max)
 {
-	while (*list) {
+	range_t	*item, *block;
 
-		range_t	*item = *list;
+	for (item = *list; item; item = item->next) {
 
 		/* if this is not the right value, go on to the next */
-		if (((*list)->min != min) && ((*list)->max != max)) {
-			list = &item->next;
+		if ((item->min != min) && (item->max != max))
 			continue;
-		}
 
 		/* we found it! */
-		*list = item->next;
-
-		free(item);
+		block = st_tree_range_pack(*list, item, NULL);
+		free(*list);
+		*list = block;
 
 		return 1;	/* deleted */
 	}
@@ -723,14 +1018,20 @@ int state_delrange(st_tree_t *root, const char *var, const int min, const int ma
 
 st_tree_t *state_tree_find(st_tree_t *node, const char *var)
 {
+	const char	*key = state_intern_find(var);
+
+	if (!key)
+		return NULL;
+
 	while (node) {
+		int	cmp = st_tree_var_cmp(node->var, key);
 
-		if (strcasecmp(node->var, var) > 0) {
+		if (cmp > 0) {
 			node = node->left;
 			continue;
 		}
 
-		if (strcasecmp(node->var, var) < 0) {
+		if (cmp < 0) {
 			node = node->right;
 			continue;
 		}
@@ -669,6 +669,20 @@ char *	str_concat(size_t count, ...)
 	return merged;
 }
 
+size_t	str_hash_fnv1a(const char *string, int nocase)
+{
+	uint32_t	hash = 2166136261U;
+
+	for (; *string; string++) {
+		hash ^= (uint32_t)(nocase
+			? tolower((unsigned char)*string)
+			: (unsigned char)*string);
+		hash *= 16777619U;
+	}
+
+	return (size_t)hash;
+}
+
 #ifndef HAVE_STRTOF
 # include <errno.h>
 # include <stdio.h>
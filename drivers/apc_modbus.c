@@ -26,6 +26,7 @@
 
 #include "nut_stdint.h"
 #include "apc_modbus.h"
+#include "modbus-plan.h"
 
 #include <ctype.h>
 #include <stdio.h>
@@ -43,7 +44,7 @@
 #endif
 
 #define DRIVER_NAME	"NUT APC Modbus driver " DRIVER_NAME_NUT_MODBUS_HAS_USB_WITH_STR " USB support (libmodbus link type: " NUT_MODBUS_LINKTYPE_STR ")"
-#define DRIVER_VERSION	"0.22"
+#define DRIVER_VERSION	"0.23"
 
 #if defined NUT_MODBUS_HAS_USB
 
@@ -97,6 +98,11 @@ static double realpower_nominal;
 static int64_t last_send_time = 0;
 static int modbus_retries = 3;
 
+/* The status, dynamic and static data blocks read by every update, fetched
+ * at its start as the "mod_max_registers" and "mod_max_gap" settings allow
+ * (e.g. split for gateways which limit the size of a request) */
+static modbus_plan_t *readplan = NULL;
+
 /* Function declarations */
 static int _apc_modbus_read_inventory(void);
 
@@ -975,6 +981,9 @@ static int _apc_modbus_reopen(void)
 
 	is_open = 1;
 
+	/* failures before may have been the link, not the register map */
+	modbus_plan_retry(readplan);
+
 	reconnect_trying(RECONNECT_UPDATEINFO);
 	_apc_modbus_read_inventory();
 
@@ -1016,6 +1025,27 @@ interframe_delay_exit:
 	last_send_time = current_time;
 }
 
+static int _apc_modbus_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+
+static int _apc_modbus_plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	NUT_UNUSED_VARIABLE(arg);
+
+	if (type != MODBUS_PLAN_HOLDING_REGISTER)
+		return -1;
+
+	return _apc_modbus_read_registers(modbus_ctx, addr, nb, (uint16_t *)dest) ? nb : -1;
+}
+
+/* Like _apc_modbus_read_registers(), served from the planned reads if possible */
+static int _apc_modbus_read_planned(int addr, int nb, uint16_t *dest)
+{
+	if (modbus_plan_fetch(readplan, MODBUS_PLAN_HOLDING_REGISTER, addr, nb, dest) == 0)
+		return 1;
+
+	return _apc_modbus_read_registers(modbus_ctx, addr, nb, dest);
+}
+
 static int _apc_modbus_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest)
 {
 	int res;
@@ -1666,8 +1696,20 @@ void upsdrv_updateinfo(void)
 	status_init();
 	buzzmode_init();
 
+	if (!readplan) {
+		readplan = modbus_plan_new(_apc_modbus_plan_read, NULL);
+		modbus_plan_configure(readplan, getval(MODBUS_PLAN_VAR_MAX_REGISTERS),
+			NULL, getval(MODBUS_PLAN_VAR_MAX_GAP));
+		modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 0, 27);
+		modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 128, 44);
+		modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 1026, 22);
+		upsdebugx(2, "update data is read with %" PRIuSIZE " requests",
+			modbus_plan_blocks(readplan));
+	}
+	modbus_plan_refresh(readplan);
+
 	/* Status Data */
-	if (_apc_modbus_read_registers(modbus_ctx, 0, 27, regbuf)) {
+	if (_apc_modbus_read_planned(0, 27, regbuf)) {
 		/* UPSStatus_BF, 2 registers */
 		_apc_modbus_to_uint64(&regbuf[0], 2, &value);
 		if (value & (1 << 1)) {
@@ -1799,7 +1841,7 @@ void upsdrv_updateinfo(void)
 	}
 
 	/* Dynamic Data */
-	if (_apc_modbus_read_registers(modbus_ctx, 128, 44, regbuf)) {
+	if (_apc_modbus_read_planned(128, 44, regbuf)) {
 		/* InputStatus_BF, 1 register */
 		_apc_modbus_to_uint64(&regbuf[22], 1, &value);
 		if (value & (1 << 5)) {
@@ -1816,7 +1858,7 @@ void upsdrv_updateinfo(void)
 	}
 
 	/* Static Data */
-	if (_apc_modbus_read_registers(modbus_ctx, 1026, 22, regbuf)) {
+	if (_apc_modbus_read_planned(1026, 22, regbuf)) {
 		_apc_modbus_process_registers(apc_modbus_register_map_static, regbuf, 22, 1026);
 	} else {
 		dstate_datastale();
@@ -1880,6 +1922,8 @@ void upsdrv_makevartable(void)
 	addvar(VAR_VALUE, "slaveid", "Modbus slave id (default=1)");
 	addvar(VAR_VALUE, "response_timeout_ms", "Modbus response timeout in milliseconds (default=500, 2000 for TCP)");
 	addvar(VAR_VALUE, "modbus_retries", "Number of retries for Modbus register reads on timeout errors (default=3)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_REGISTERS, "Modbus registers read with one request at most (1-125, default=125)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_GAP, "Unused Modbus registers read to merge two requests (default=8)");
 
 	/* Serial RTU parameters */
 	addvar(VAR_VALUE, "baudrate", "Modbus serial RTU communication speed in baud (default=9600)");
@@ -2270,6 +2314,9 @@ void upsdrv_cleanup(void)
 {
 	_apc_modbus_close(1);
 
+	modbus_plan_free(readplan);
+	readplan = NULL;
+
 #if defined NUT_MODBUS_HAS_USB
 	USBFreeExactMatcher(reopen_matcher);
 	USBFreeExactMatcher(regex_matcher);
@@ -32,6 +32,14 @@
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <sys/un.h>
+# if (defined HAVE_SYS_EPOLL_H) && HAVE_SYS_EPOLL_H && (defined HAVE_EPOLL_CREATE1) && HAVE_EPOLL_CREATE1
+#  include <sys/epoll.h>
+#  define DSTATE_USE_EPOLL 1
+# endif
+# if (defined HAVE_POLL_H) && HAVE_POLL_H
+#  include <poll.h>
+#  define DSTATE_USE_POLL 1
+# endif
 #else	/* WIN32 */
 # include <strings.h>
 # include "wincompat.h"
@@ -45,26 +53,127 @@
 #include "nut_stdint.h"
 #include "nut_float.h"
 
-	static TYPE_FD	sockfd = ERROR_FD;
 #ifndef WIN32
-	static char	*sockfn = NULL;
+	/* What a descriptor we wait on is about, so that its events are
+	 * dispatched without looking it up (epoll keeps a pointer to it) */
+	typedef enum {
+		DSTATE_FD_LISTEN,	/* the driver socket */
+		DSTATE_FD_EXTRAFD,	/* the extrafd of dstate_poll_fds() */
+		DSTATE_FD_REGISTERED,	/* added with dstate_register_fd() */
+		DSTATE_FD_CONN		/* a connection to the driver socket */
+	} dstate_fd_kind_t;
+
+	typedef struct dstate_fd_s {
+		dstate_fd_kind_t	kind;
+		TYPE_FD	fd;	/* ERROR_FD once unregistered while dispatching */
+		dstate_fd_handler_t	handler;
+		void	*arg;
+		conn_t	*conn;
+		dstate_ctx_t	*ctx;	/* the instance it belongs to */
+		struct dstate_fd_s	*next;
+	} dstate_fd_t;
+
+# ifdef DSTATE_USE_EPOLL
+#  define DSTATE_EPOLL_EVENTS	16
+#  ifdef DSTATE_USE_POLL
+#   define DSTATE_EPOLL_FALLBACK	"poll()"
+#  else
+#   define DSTATE_EPOLL_FALLBACK	"select()"
+#  endif
+# endif
+#endif	/* !WIN32 */
+
+/* Everything that one device instance publishes: its socket with the
+ * connections of upsd and other readers, its data tree and the status
+ * being built. A driver process has one, the default below; a process
+ * hosting several devices makes one per device and selects it around
+ * the calls for that device (see dstate_ctx_select()). */
+struct dstate_ctx_s {
+	/* fields with non-zero defaults come first, see dstate_default */
+	TYPE_FD	sockfd;
+	int	stale;
+
+	/* battery.charge before the current update and when it was set,
+	 * to tell if the battery is charging; -1 if not known yet */
+	double	prev_battery_charge;
+	st_tree_timespec_t	prev_battery_charge_ts;
+
+#ifdef DSTATE_USE_EPOLL
+	/* -1 if not available, then poll() or select() is used */
+	int	epfd;
+	int	in_master;	/* epfd is in the set of dstate_poll_all() */
+	/* the extrafd in the epoll set, re-added after each timeout in case
+	 * it was closed and reopened under the same number meanwhile */
+	TYPE_FD	epoll_extrafd;
+	int	epoll_extrafd_check;
+#endif
+
+#ifndef WIN32
+	char	*sockfn;
 #else	/* WIN32 */
-	static OVERLAPPED	connect_overlapped;
-	static char	*pipename = NULL;
+	OVERLAPPED	connect_overlapped;
+	char	*pipename;
 #endif	/* WIN32 */
-	static int	stale = 1, alarm_active = 0, alarm_status = 0, ignorelb = 0,
-				alarm_legacy_status = 0;
-	static char	status_buf[ST_MAX_VALUE_LEN], alarm_buf[ST_MAX_VALUE_LEN],
-			buzzmode_buf[ST_MAX_VALUE_LEN];
-	static conn_t	*connhead = NULL;
-	static st_tree_t	*dtree_root = NULL;
-	static cmdlist_t	*cmdhead = NULL;
+	int	alarm_active, alarm_status, ignorelb, alarm_legacy_status;
+	char	status_buf[ST_MAX_VALUE_LEN], alarm_buf[ST_MAX_VALUE_LEN],
+		buzzmode_buf[ST_MAX_VALUE_LEN];
+	conn_t	*connhead;
+	st_tree_t	*dtree_root;
+	cmdlist_t	*cmdhead;
+
+	/* How many dstate_setinfo*() calls did (not) change a value */
+	uintmax_t	setinfo_changed, setinfo_suppressed;
+
+	/* instances made with dstate_ctx_new(), see dstate_poll_all() */
+	struct dstate_ctx_s	*all_next;
+
+#ifndef WIN32
+	dstate_fd_t	listen_fd, extrafd, *extra_fds;
+
+	/* While dstate_poll_fds() handles the ready descriptors, closing
+	 * connections and unregistered descriptors are only marked as such
+	 * (and dealt with after that), so that none of them is freed with
+	 * events pending for it */
+	int	dispatching;
+
+#endif	/* !WIN32 */
+};
+
+#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP_BESIDEFUNC) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_MISSING_FIELD_INITIALIZERS_BESIDEFUNC)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+	/* the rest of the fields is zeroed, as with dstate_ctx_new() */
+	static dstate_ctx_t	dstate_default = {
+		ERROR_FD, 1, -1.0, { 0, 0 }
+#ifdef DSTATE_USE_EPOLL
+		, -1, 0, ERROR_FD
+#endif
+	};
+#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP_BESIDEFUNC) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_MISSING_FIELD_INITIALIZERS_BESIDEFUNC)
+#pragma GCC diagnostic pop
+#endif
+
+	/* the instance all dstate functions work on */
+	static dstate_ctx_t	*dctx = &dstate_default;
+
+	/* those made with dstate_ctx_new() */
+	static dstate_ctx_t	*dstate_all = NULL;
 
 	struct ups_handler	upsh;
 
-	/* Globally track if we are charging or losing power, and how fast */
-	double			previous_battery_charge_value = -1.0;
-	st_tree_timespec_t	previous_battery_charge_timestamp;
+#ifndef WIN32
+	/* What dstate_poll_fds() and dstate_poll_all() wait on when epoll
+	 * is not available (a single thread waits at a time) */
+	static dstate_fd_t	**dstate_waitlist = NULL;
+# ifdef DSTATE_USE_POLL
+	static struct pollfd	*dstate_pollfds = NULL;
+# endif
+	static size_t	dstate_waitlist_alloc = 0;
+
+	/* the extrafd of these calls, for the waits above */
+	static dstate_fd_t	dstate_extrafd_watch = { DSTATE_FD_EXTRAFD, ERROR_FD, NULL, NULL, NULL, NULL, NULL };
+#endif	/* !WIN32 */
 
 #ifndef WIN32
 /* this may be a frequent stumbling point for new users, so be verbose here */
@@ -161,12 +270,12 @@ static TYPE_FD sock_open(const char *fn)
 	}
 
 	/* keep this around for the unlink() when exiting */
-	sockfn = xstrdup(fn);
+	dctx->sockfn = xstrdup(fn);
 
 	ssaddr.sun_family = AF_UNIX;
-	snprintf(ssaddr.sun_path, sizeof(ssaddr.sun_path), "%s", sockfn);
+	snprintf(ssaddr.sun_path, sizeof(ssaddr.sun_path), "%s", dctx->sockfn);
 
-	unlink(sockfn);
+	unlink(dctx->sockfn);
 
 	/* group gets access so upsd can be a different user but same group */
 	umask(0007);
@@ -174,13 +283,13 @@ static TYPE_FD sock_open(const char *fn)
 	ret = bind(fd, (struct sockaddr *) &ssaddr, sizeof ssaddr);
 
 	if (ret < 0) {
-		sock_fail(sockfn);
+		sock_fail(dctx->sockfn);
 	}
 
-	ret = chmod(sockfn, 0660);
+	ret = chmod(dctx->sockfn, 0660);
 
 	if (ret < 0) {
-		fatal_with_errno(EXIT_FAILURE, "chmod(%s, 0660) failed", sockfn);
+		fatal_with_errno(EXIT_FAILURE, "chmod(%s, 0660) failed", dctx->sockfn);
 	}
 
 	ret = listen(fd, DS_LISTEN_BACKLOG);
@@ -190,7 +299,7 @@ static TYPE_FD sock_open(const char *fn)
 	}
 
 	if (!getenv("NUT_QUIET_INIT_LISTENER"))
-		upslogx(LOG_INFO, "Listening on socket %s", sockfn);
+		upslogx(LOG_INFO, "Listening on socket %s", dctx->sockfn);
 
 #else /* WIN32 */
 	SECURITY_ATTRIBUTES	pipe_sa;
@@ -217,25 +326,25 @@ static TYPE_FD sock_open(const char *fn)
 	if (INVALID_FD(fd)) {
 		upsdebugx(1, "%s: Can't create a state socket "
 			"(windows named pipe) for listening: %s",
-			__func__, pipename);
+			__func__, dctx->pipename);
 		fatal_with_errno(EXIT_FAILURE,
 			"Can't create a state socket (windows named pipe)");
 	}
 
 	/* Prepare an async wait on a connection on the pipe */
-	memset(&connect_overlapped, 0, sizeof(connect_overlapped));
-	connect_overlapped.hEvent = CreateEvent(
+	memset(&dctx->connect_overlapped, 0, sizeof(dctx->connect_overlapped));
+	dctx->connect_overlapped.hEvent = CreateEvent(
 		NULL,	/* Security */
 		FALSE,	/* auto-reset */
 		FALSE,	/* initial state = non signaled */
 		NULL	/* no name */
 	);
-	if (connect_overlapped.hEvent == NULL) {
+	if (dctx->connect_overlapped.hEvent == NULL) {
 		fatal_with_errno(EXIT_FAILURE, "Can't create event");
 	}
 
 	/* Wait for a connection */
-	ConnectNamedPipe(fd, &connect_overlapped);
+	ConnectNamedPipe(fd, &dctx->connect_overlapped);
 
 	if (!getenv("NUT_QUIET_INIT_LISTENER"))
 		upslogx(LOG_INFO, "Listening on named pipe %s", fn);
@@ -245,6 +354,289 @@ static TYPE_FD sock_open(const char *fn)
 	return fd;
 }
 
+#ifdef DSTATE_USE_EPOLL
+/* Stop using epoll (e.g. for a descriptor it does not support) */
+static void dstate_epoll_fail(int fd)
+{
+	upslog_with_errno(LOG_WARNING, "%s: can't watch fd %d with epoll, "
+		"falling back to " DSTATE_EPOLL_FALLBACK, __func__, fd);
+	close(dctx->epfd);
+	dctx->epfd = -1;
+	dctx->in_master = 0;
+}
+
+static void dstate_epoll_add(dstate_fd_t *watch)
+{
+	struct epoll_event	ev;
+
+	if (dctx->epfd < 0 || INVALID_FD(watch->fd))
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = watch;
+
+	if (epoll_ctl(dctx->epfd, EPOLL_CTL_ADD, watch->fd, &ev) < 0 && errno != EEXIST)
+		dstate_epoll_fail(watch->fd);
+}
+
+/* Also wait for the connection socket to become writable, or stop that */
+static void dstate_epoll_mod(dstate_fd_t *watch, int want_write)
+{
+	struct epoll_event	ev;
+
+	if (dctx->epfd < 0 || INVALID_FD(watch->fd))
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+	ev.data.ptr = watch;
+
+	if (epoll_ctl(dctx->epfd, EPOLL_CTL_MOD, watch->fd, &ev) < 0)
+		dstate_epoll_fail(watch->fd);
+}
+
+static void dstate_epoll_del(TYPE_FD fd)
+{
+	struct epoll_event	ev;	/* ignored, but needed by old kernels */
+
+	if (dctx->epfd < 0 || INVALID_FD(fd))
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	/* may fail if already closed (and so removed), that is fine */
+	epoll_ctl(dctx->epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+#endif	/* DSTATE_USE_EPOLL */
+
+#ifndef WIN32
+/* A SETINFO line queued for a lagging reader, replaced by any newer
+ * value of the same variable until it goes into the output buffer */
+typedef struct dstate_pending_s {
+	const char	*var;	/* interned */
+	char	*line;
+	size_t	len;
+	struct dstate_pending_s	*next;		/* in the order of queueing */
+	struct dstate_pending_s	*hash_next;	/* in the same pending_hash bucket */
+} dstate_pending_t;
+
+/* buckets of conn->pending_hash, a power of 2 */
+#define DSTATE_PENDING_BUCKETS	256
+
+static size_t conn_queued(const conn_t *conn)
+{
+	return conn->outlen - conn->outoff + conn->pending_len;
+}
+
+static void conn_want_write(conn_t *conn, int want_write)
+{
+	if (conn->want_write == want_write)
+		return;
+
+	conn->want_write = want_write;
+# ifdef DSTATE_USE_EPOLL
+	dstate_epoll_mod(conn->watch, want_write);
+# endif
+}
+
+static void conn_outbuf_append(conn_t *conn, const char *buf, size_t len)
+{
+	if (conn->outlen + len > conn->outalloc && conn->outoff > 0) {
+		memmove(conn->outbuf, conn->outbuf + conn->outoff,
+			conn->outlen - conn->outoff);
+		conn->outlen -= conn->outoff;
+		conn->outoff = 0;
+	}
+
+	if (conn->outlen + len > conn->outalloc) {
+		conn->outalloc = conn->outalloc ? conn->outalloc * 2 : ST_SOCK_BUF_LEN;
+		if (conn->outalloc < conn->outlen + len)
+			conn->outalloc = conn->outlen + len;
+		conn->outbuf = (char *)xrealloc(conn->outbuf, conn->outalloc);
+	}
+
+	memcpy(conn->outbuf + conn->outlen, buf, len);
+	conn->outlen += len;
+}
+
+/* Move the coalesced SETINFO lines (in the order the variables were
+ * first queued) into the output buffer, or just forget them */
+static void conn_pending_drop(conn_t *conn, int keep)
+{
+	dstate_pending_t	*p;
+
+	while ((p = conn->pending) != NULL) {
+		conn->pending = p->next;
+		if (keep)
+			conn_outbuf_append(conn, p->line, p->len);
+		free(p->line);
+		free(p);
+	}
+
+	conn->pending_tail = NULL;
+	conn->pending_len = 0;
+
+	if (keep && conn->pending_hash) {
+		memset(conn->pending_hash, 0,
+			DSTATE_PENDING_BUCKETS * sizeof(*conn->pending_hash));
+	} else {
+		free(conn->pending_hash);
+		conn->pending_hash = NULL;
+	}
+}
+
+static void conn_pending_setinfo(conn_t *conn, const char *var, const char *buf, size_t len)
+{
+	dstate_pending_t	*p;
+	const char	*key = state_intern(var);
+	size_t	bucket = state_intern_hash(key) & (DSTATE_PENDING_BUCKETS - 1);
+
+	if (!conn->pending_hash) {
+		conn->pending_hash = (dstate_pending_t **)xcalloc(
+			DSTATE_PENDING_BUCKETS, sizeof(*conn->pending_hash));
+	}
+
+	for (p = conn->pending_hash[bucket]; p; p = p->hash_next) {
+		if (p->var == key) {
+			upsdebugx(6, "%s: socket %d: %s superseded before it was sent",
+				__func__, (int)conn->fd, var);
+			conn->pending_len -= p->len;
+			free(p->line);
+			break;
+		}
+	}
+
+	if (!p) {
+		p = (dstate_pending_t *)xcalloc(1, sizeof(*p));
+		p->var = key;
+		p->hash_next = conn->pending_hash[bucket];
+		conn->pending_hash[bucket] = p;
+
+		if (conn->pending_tail)
+			conn->pending_tail->next = p;
+		else
+			conn->pending = p;
+		conn->pending_tail = p;
+	}
+
+	p->line = (char *)xcalloc(1, len);
+	memcpy(p->line, buf, len);
+	p->len = len;
+	conn->pending_len += len;
+}
+
+/* Write out what the socket takes of the queued output.
+ * Returns 0 if all was written, 1 if some remains queued,
+ * or -1 on errors (the connection is marked as closing then). */
+static int conn_flush(conn_t *conn)
+{
+	ssize_t	ret;
+
+	for (;;) {
+		if (conn->outoff == conn->outlen) {
+			conn->outoff = conn->outlen = 0;
+			if (!conn->pending)
+				break;
+			conn_pending_drop(conn, 1);
+		}
+
+		ret = write(conn->fd, conn->outbuf + conn->outoff,
+			conn->outlen - conn->outoff);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0 && errno != EAGAIN) {
+			upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
+				"socket %d failed, disconnecting",
+				__func__, conn->outlen - conn->outoff, (int)conn->fd);
+			conn->closing = 1;
+			return -1;
+		}
+
+		if (ret <= 0) {
+			/* the reader lags behind, come back when it is writable */
+			conn_want_write(conn, 1);
+			return 1;
+		}
+
+		conn->outoff += (size_t)ret;
+	}
+
+	if (conn->want_write)
+		upsdebugx(5, "%s: socket %d caught up", __func__, (int)conn->fd);
+	conn_want_write(conn, 0);
+	return 0;
+}
+
+/* Send one or more complete protocol lines to a reader, or queue them
+ * if it can not take them now. A SETINFO line passes its variable name
+ * so that it can be replaced by a newer value while still queued.
+ * Returns 1 if sent or queued, -1 if the connection should be closed
+ * (it is marked as closing then). */
+static int conn_send(conn_t *conn, const char *buf, size_t buflen, const char *setinfo_var)
+{
+	ssize_t	ret;
+
+	if (conn->closing)
+		return -1;
+
+	if (conn->outoff == conn->outlen && !conn->pending) {
+		/* nothing queued, the usual case */
+		do {
+			ret = write(conn->fd, buf, buflen);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret == (ssize_t)buflen) {
+			upsdebugx(6, "%s: write %" PRIuSIZE " bytes to socket %d succeeded",
+				__func__, buflen, (int)conn->fd);
+			upsdebug_ascii_compact(6, "conn_send: buffer content: ", buf, buflen);
+			return 1;
+		}
+
+		if (ret < 0 && errno != EAGAIN) {
+			upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
+				"socket %d failed (ret=%" PRIiSIZE "), disconnecting",
+				__func__, buflen, (int)conn->fd, ret);
+			upsdebug_ascii_compact(6, "conn_send: failed to write buffer content: ", buf, buflen);
+			conn->closing = 1;
+			return -1;
+		}
+
+		if (ret < 0)
+			ret = 0;
+
+		upsdebugx(3, "%s: socket %d lags behind, queueing %" PRIuSIZE " bytes",
+			__func__, (int)conn->fd, buflen - (size_t)ret);
+
+		/* a partially written line must be completed as is */
+		conn_outbuf_append(conn, buf + ret, buflen - (size_t)ret);
+		conn_want_write(conn, 1);
+		return 1;
+	}
+
+	if (setinfo_var) {
+		conn_pending_setinfo(conn, setinfo_var, buf, buflen);
+	} else {
+		/* keep the order of anything else relative to the values */
+		conn_pending_drop(conn, 1);
+		conn_outbuf_append(conn, buf, buflen);
+	}
+
+	/* coalesced values take at most one line per variable,
+	 * but nothing limits the rest of the backlog otherwise */
+	if (conn->outlen - conn->outoff > DSTATE_CONN_QUEUE_MAX) {
+		upslogx(LOG_WARNING, "%s: reader on socket %d is too slow "
+			"(%" PRIuSIZE " bytes queued), disconnecting",
+			__func__, (int)conn->fd, conn_queued(conn));
+		conn->closing = 1;
+		return -1;
+	}
+
+	return 1;
+}
+#endif	/* !WIN32 */
+
 static void sock_disconnect(conn_t *conn)
 {
 	if (!conn) {
@@ -255,6 +647,21 @@ static void sock_disconnect(conn_t *conn)
 	conn->closing = 1;
 
 #ifndef WIN32
+	if (dctx->dispatching) {
+		upsdebugx(5, "%s: socket %d will be closed after handling other events",
+			__func__, (int)conn->fd);
+		return;
+	}
+
+	/* best effort, e.g. for "OK Goodbye" after a LOGOUT */
+	if (conn_queued(conn) > 0 && !conn_flush(conn)) {
+		upsdebugx(5, "%s: socket %d: queued output was flushed",
+			__func__, (int)conn->fd);
+	}
+
+# ifdef DSTATE_USE_EPOLL
+	dstate_epoll_del(conn->fd);
+# endif
 # if 0
 	if (VALID_FD(conn->fd)) {
 		FILE	*f = fdopen(conn->fd, 600);
@@ -305,7 +712,7 @@ static void sock_disconnect(conn_t *conn)
 	if (conn->prev) {
 		conn->prev->next = conn->next;
 	} else {
-		connhead = conn->next;
+		dctx->connhead = conn->next;
 	}
 
 	if (conn->next) {
@@ -314,64 +721,40 @@ static void sock_disconnect(conn_t *conn)
 		/* conntail = conn->prev; */
 	}
 
+#ifndef WIN32
+	conn_pending_drop(conn, 0);
+	free(conn->outbuf);
+	free(conn->watch);
+#endif	/* !WIN32 */
+
 	upsdebugx(5, "%s: freeing the conn object", __func__);
 	free(conn);
 }
 
-/** Iterate all connections to post a formatted string on them.
+/** Iterate all connections to post a prepared buffer on them.
+ *  SETINFO lines pass the variable name, so that a newer value may
+ *  replace this one for readers which lag behind.
  *  Clean up any connections found to be aborted during this cycle.
  *  No return code.
  */
-static void send_to_all(const char *fmt, ...)
+static void send_buf_to_all(const char *buf, size_t buflen, const char *setinfo_var)
 {
-	ssize_t	ret;
-	char	buf[ST_SOCK_BUF_LEN];
-	size_t	buflen;
-	va_list	ap;
 	conn_t	*conn, *cnext;
+#ifdef WIN32
+	ssize_t	ret;
 
-	va_start(ap, fmt);
-#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
-#pragma GCC diagnostic push
-#endif
-#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-#endif
-#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_SECURITY
-#pragma GCC diagnostic ignored "-Wformat-security"
-#endif
-	/* Note: this code intentionally uses a caller-provided
-	 * format string (we should not get it from configs etc.
-	 * or the calling methods should check it against their
-	 * "fmt_dynamic" expectations). */
-	ret = vsnprintf(buf, sizeof(buf), fmt, ap);
-#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
-#pragma GCC diagnostic pop
-#endif
-	va_end(ap);
-
-	if (ret < 1) {
-		upsdebugx(2, "%s: nothing to write", __func__);
-		return;
-	}
-
-	if (ret <= INT_MAX)
-		upsdebugx(5, "%s: %.*s", __func__, (int)(ret-1), buf);
-
-	buflen = strlen(buf);
-	if (buflen >= SSIZE_MAX) {
-		/* Can't compare buflen to ret... though should not happen with ST_SOCK_BUF_LEN */
-		upslog_with_errno(LOG_NOTICE, "%s failed: buffered message too large", __func__);
-		return;
-	}
+	NUT_UNUSED_VARIABLE(setinfo_var);
+#endif	/* WIN32 */
 
-	for (conn = connhead; conn; conn = cnext) {
+	for (conn = dctx->connhead; conn; conn = cnext) {
 		cnext = conn->next;
 		if (conn->nobroadcast)
 			continue;
 
 #ifndef WIN32
-		ret = write(conn->fd, buf, buflen);
+		/* slow readers get a queue, and are only disconnected
+		 * if it grows too long (or on socket errors) */
+		conn_send(conn, buf, buflen, setinfo_var);
 #else	/* WIN32 */
 		DWORD bytesWritten = 0;
 		BOOL  result = FALSE;
@@ -385,18 +768,11 @@ static void send_to_all(const char *fmt, ...)
 		else {
 			ret = (ssize_t)bytesWritten;
 		}
-#endif	/* WIN32 */
 
 		if ((ret < 1) || (ret != (ssize_t)buflen)) {
-#ifndef WIN32
-			upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
-				"socket %d failed (ret=%" PRIiSIZE "), disconnecting.",
-				__func__, buflen, (int)conn->fd, ret);
-#else	/* WIN32 */
 			upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
 				"handle %p failed (ret=%" PRIiSIZE "), disconnecting.",
 				__func__, buflen, conn->fd, ret);
-#endif	/* WIN32 */
 			upsdebug_ascii_compact(6, "send_to_all: failed to write buffer content: ", buf, buflen);
 
 			conn->closing = 1;
@@ -420,9 +796,10 @@ static void send_to_all(const char *fmt, ...)
 				__func__, buflen, conn->fd, ret);
 			upsdebug_ascii_compact(6, "send_to_all: buffer content: ", buf, buflen);
 		}
+#endif	/* WIN32 */
 	}
 
-	for (conn = connhead; conn; conn = cnext) {
+	for (conn = dctx->connhead; conn; conn = cnext) {
 		cnext = conn->next;
 
 		if (conn->closing) {
@@ -434,6 +811,72 @@ static void send_to_all(const char *fmt, ...)
 	errno = 0;
 }
 
+/** Iterate all connections to post a formatted string on them.
+ *  No return code.
+ */
+static void send_to_all(const char *fmt, ...)
+{
+	ssize_t	ret;
+	char	buf[ST_SOCK_BUF_LEN];
+	size_t	buflen;
+	va_list	ap;
+
+	va_start(ap, fmt);
+#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic push
+#endif
+#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_SECURITY
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif
+	/* Note: this code intentionally uses a caller-provided
+	 * format string (we should not get it from configs etc.
+	 * or the calling methods should check it against their
+	 * "fmt_dynamic" expectations). */
+	ret = vsnprintf(buf, sizeof(buf), fmt, ap);
+#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic pop
+#endif
+	va_end(ap);
+
+	if (ret < 1) {
+		upsdebugx(2, "%s: nothing to write", __func__);
+		return;
+	}
+
+	if (ret <= INT_MAX)
+		upsdebugx(5, "%s: %.*s", __func__, (int)(ret-1), buf);
+
+	buflen = strlen(buf);
+	if (buflen >= SSIZE_MAX) {
+		/* Can't compare buflen to ret... though should not happen with ST_SOCK_BUF_LEN */
+		upslog_with_errno(LOG_NOTICE, "%s failed: buffered message too large", __func__);
+		return;
+	}
+
+	send_buf_to_all(buf, buflen, NULL);
+}
+
+/** Post a new value of a variable on all connections */
+static void send_setinfo_to_all(const char *var, const char *value)
+{
+	int	ret;
+	char	buf[ST_SOCK_BUF_LEN];
+
+	ret = snprintf(buf, sizeof(buf), "SETINFO %s \"%s\"\n", var, value);
+
+	if (ret < 1) {
+		upsdebugx(2, "%s: nothing to write", __func__);
+		return;
+	}
+
+	upsdebugx(5, "%s: %.*s", __func__, ret - 1, buf);
+
+	send_buf_to_all(buf, strlen(buf), var);
+}
+
 /**
  * Send a formatted string to one given connection.
  *
@@ -506,7 +949,14 @@ static int send_to_one(conn_t *conn, const char *fmt, ...)
 */
 
 #ifndef WIN32
-	ret = write(conn->fd, buf, buflen);
+	if (conn_send(conn, buf, buflen, NULL) < 0) {
+		/* details were logged by conn_send() */
+		sock_disconnect(conn);
+		conn = NULL;
+
+		errno = ENOTCONN;
+		return -2;	/* failed and freed */
+	}
 #else	/* WIN32 */
 	result = WriteFile(conn->fd, buf, buflen, &bytesWritten, NULL);
 	if (result == 0) {
@@ -515,26 +965,16 @@ static int send_to_one(conn_t *conn, const char *fmt, ...)
 	else {
 		ret = (ssize_t)bytesWritten;
 	}
-#endif	/* WIN32 */
 
 	if (ret < 0) {
 		/* Hacky bugfix: throttle down for upsd to read that */
-#ifndef WIN32
-		upsdebug_with_errno(1, "%s: had to throttle down to retry "
-			"writing %" PRIuSIZE " bytes to socket %d (ret=%" PRIiSIZE "):",
-			__func__, buflen, (int)conn->fd, ret);
-#else	/* WIN32 */
 		upsdebug_with_errno(1, "%s: had to throttle down to retry "
 			"writing %" PRIuSIZE " bytes to handle %p (ret=%" PRIiSIZE "):",
 			__func__, buflen, conn->fd, ret);
-#endif	/* WIN32 */
 		upsdebug_ascii_compact(1, "send_to_one: buffer content: ", buf, buflen);
 
 		usleep(200);
 
-#ifndef WIN32
-		ret = write(conn->fd, buf, buflen);
-#else	/* WIN32 */
 		result = WriteFile(conn->fd, buf, buflen, &bytesWritten, NULL);
 		if (result == 0) {
 			ret = 0;	/* signal error */
@@ -542,22 +982,15 @@ static int send_to_one(conn_t *conn, const char *fmt, ...)
 		else {
 			ret = (ssize_t)bytesWritten;
 		}
-#endif	/* WIN32 */
 		if (ret == (ssize_t)buflen) {
 			upsdebugx(1, "%s: throttling down helped", __func__);
 		}
 	}
 
 	if ((ret < 1) || (ret != (ssize_t)buflen)) {
-#ifndef WIN32
-		upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
-			"socket %d failed (ret=%" PRIiSIZE "), disconnecting",
-			__func__, buflen, (int)conn->fd, ret);
-#else	/* WIN32 */
 		upsdebug_with_errno(0, "WARNING: %s: write %" PRIuSIZE " bytes to "
 			"handle %p failed (ret=%" PRIiSIZE "), disconnecting",
 			__func__, buflen, conn->fd, ret);
-#endif	/* WIN32 */
 		upsdebug_ascii_compact(6, "send_to_one: failed to write buffer content: ", buf, buflen);
 
 		sock_disconnect(conn);
@@ -580,17 +1013,12 @@ static int send_to_one(conn_t *conn, const char *fmt, ...)
 		errno = ENOTCONN;
 		return -2;	/* failed and freed */
 	} else {
-#ifndef WIN32
-		upsdebugx(6, "%s: write %" PRIuSIZE " bytes to socket %d succeeded "
-			"(ret=%" PRIiSIZE "):",
-			__func__, buflen, conn->fd, ret);
-#else	/* WIN32 */
 		upsdebugx(6, "%s: write %" PRIuSIZE " bytes to handle %p succeeded "
 			"(ret=%" PRIiSIZE "):",
 			__func__, buflen, conn->fd, ret);
-#endif	/* WIN32 */
 		upsdebug_ascii_compact(6, "send_to_one: buffer content: ", buf, buflen);
 	}
+#endif	/* WIN32 */
 
 	return 1;	/* OK */
 }
@@ -663,9 +1091,9 @@ static void sock_connect(TYPE_FD sock)
 
 	/* sockfd is the handle of the connection pending pipe */
 	upsdebugx(6, "%s: opening NAMED_PIPE for incoming data: '%s'",
-		__func__, pipename);
-	sockfd = CreateNamedPipe(
-		pipename,		/* pipe name */
+		__func__, dctx->pipename);
+	dctx->sockfd = CreateNamedPipe(
+		dctx->pipename,		/* pipe name */
 		PIPE_ACCESS_DUPLEX	/* read/write access */
 		| FILE_FLAG_OVERLAPPED,	/* async IO */
 		PIPE_TYPE_BYTE
@@ -678,29 +1106,29 @@ static void sock_connect(TYPE_FD sock)
 		0,			/* client time-out */
 		&pipe_sa);
 
-	if (INVALID_FD(sockfd)) {
+	if (INVALID_FD(dctx->sockfd)) {
 		upsdebugx(1, "%s: Can't open state socket "
 			"(windows named pipe) for incoming data: %s",
-			__func__, pipename);
+			__func__, dctx->pipename);
 		fatal_with_errno(EXIT_FAILURE,
 			"Can't create a state socket (windows named pipe)");
 	}
 
 	/* Prepare a new async wait for a connection on the pipe */
-	CloseHandle(connect_overlapped.hEvent);
-	memset(&connect_overlapped, 0, sizeof(connect_overlapped));
-	connect_overlapped.hEvent = CreateEvent(
+	CloseHandle(dctx->connect_overlapped.hEvent);
+	memset(&dctx->connect_overlapped, 0, sizeof(dctx->connect_overlapped));
+	dctx->connect_overlapped.hEvent = CreateEvent(
 		NULL,	/* Security */
 		FALSE,	/* auto-reset */
 		FALSE,	/* initial state = non signaled */
 		NULL	/* no name */
 	);
-	if (connect_overlapped.hEvent == NULL) {
+	if (dctx->connect_overlapped.hEvent == NULL) {
 		fatal_with_errno(EXIT_FAILURE, "Can't create event");
 	}
 
 	/* Wait for a connection */
-	ConnectNamedPipe(sockfd, &connect_overlapped);
+	ConnectNamedPipe(dctx->sockfd, &dctx->connect_overlapped);
 
 	/* A new pipe waiting for new client connection has been created. We could manage the current connection now */
 	/* Start a read operation on the newly connected pipe so we could wait on the event associated to this IO */
@@ -726,14 +1154,22 @@ static void sock_connect(TYPE_FD sock)
 	conn->closing = 0;
 	pconf_init(&conn->ctx, NULL);
 
-	if (connhead) {
-		conn->next = connhead;
-		connhead->prev = conn;
+	if (dctx->connhead) {
+		conn->next = dctx->connhead;
+		dctx->connhead->prev = conn;
 	}
 
-	connhead = conn;
+	dctx->connhead = conn;
 
 #ifndef WIN32
+	conn->watch = (dstate_fd_t *)xcalloc(1, sizeof(*conn->watch));
+	conn->watch->kind = DSTATE_FD_CONN;
+	conn->watch->fd = fd;
+	conn->watch->conn = conn;
+	conn->watch->ctx = dctx;
+# ifdef DSTATE_USE_EPOLL
+	dstate_epoll_add(conn->watch);
+# endif
 	upsdebugx(3, "%s: new connection on fd %d", __func__, fd);
 #else	/* WIN32 */
 	upsdebugx(3, "%s: new connection on handle %p", __func__, sock);
@@ -891,7 +1327,7 @@ static int cmd_dump_conn(conn_t *conn)
 		return -2;
 	}
 
-	for (cmd = cmdhead; cmd; cmd = cmd->next) {
+	for (cmd = dctx->cmdhead; cmd; cmd = cmd->next) {
 		send_ret = send_to_one(conn, "ADDCMD %s\n", cmd->name);
 		if (errno == ENOTCONN)
 			return -2;
@@ -935,8 +1371,10 @@ static int send_tracking(conn_t *conn, const char *id, int value)
  */
 static int sock_arg(conn_t *conn, size_t numarg, char **arg)
 {
-#ifdef WIN32
-	char *sockfn = pipename;	/* Just for the report below; not a global var in WIN32 builds */
+#ifndef WIN32
+	const char	*sockfn = dctx->sockfn;	/* Just for the report below */
+#else	/* WIN32 */
+	const char	*sockfn = dctx->pipename;	/* Just for the report below; no socket file in WIN32 builds */
 #endif	/* WIN32 */
 	int	send_ret, send_errno;
 
@@ -995,7 +1433,7 @@ static int sock_arg(conn_t *conn, size_t numarg, char **arg)
 
 	if (!strcasecmp(arg[0], "DUMPALL") || !strcasecmp(arg[0], "DUMPSTATUS") || (!strcasecmp(arg[0], "DUMPVALUE") && numarg > 1)) {
 		/* first thing: the staleness flag (see also below) */
-		if (stale == 1) {
+		if (dctx->stale == 1) {
 			send_ret = send_to_one(conn, "DATASTALE\n");
 			send_errno = errno;
 			upsdebugx(6, "%s: %s: send_to_one(DATASTALE) returned %d",
@@ -1007,7 +1445,7 @@ static int sock_arg(conn_t *conn, size_t numarg, char **arg)
 		}
 
 		if (!strcasecmp(arg[0], "DUMPALL")) {
-			send_ret = st_tree_dump_conn(dtree_root, conn);
+			send_ret = st_tree_dump_conn(dctx->dtree_root, conn);
 			send_errno = errno;
 			upsdebugx(6, "%s: %s: st_tree_dump_conn() returned %d",
 				__func__, arg[0], send_ret);
@@ -1027,7 +1465,7 @@ static int sock_arg(conn_t *conn, size_t numarg, char **arg)
 		} else {
 			/* A cheaper version of the dump */
 			char	*varname = (!strcasecmp(arg[0], "DUMPSTATUS") ? "ups.status" : (numarg > 1 ? arg[1] : NULL));
-			st_tree_t	*sttmp = (varname ? state_tree_find(dtree_root, varname) : NULL);
+			st_tree_t	*sttmp = (varname ? state_tree_find(dctx->dtree_root, varname) : NULL);
 
 			if (!sttmp) {
 				upsdebugx(1, "%s: %s was requested but currently no %s is known",
@@ -1044,7 +1482,7 @@ static int sock_arg(conn_t *conn, size_t numarg, char **arg)
 			}
 		}
 
-		if (stale == 0) {
+		if (dctx->stale == 0) {
 			send_ret = send_to_one(conn, "DATAOK\n");
 			send_errno = errno;
 			upsdebugx(6, "%s: %s: send_to_one(DATAOK) returned %d",
@@ -1469,127 +1907,445 @@ static void sock_close(void)
 
 	upsdebugx(1, "%s: starting...", __func__);
 
-	if (VALID_FD(sockfd)) {
+	if (VALID_FD(dctx->sockfd)) {
 #ifndef WIN32
-		close(sockfd);
+# ifdef DSTATE_USE_EPOLL
+		if (dctx->epfd >= 0) {
+			close(dctx->epfd);
+			dctx->epfd = -1;
+		}
+		dctx->in_master = 0;
+		dctx->epoll_extrafd = ERROR_FD;
+		dctx->epoll_extrafd_check = 0;
+# endif
+		close(dctx->sockfd);
 
-		if (sockfn) {
-			unlink(sockfn);
-			free(sockfn);
-			sockfn = NULL;
+		if (dctx->sockfn) {
+			unlink(dctx->sockfn);
+			free(dctx->sockfn);
+			dctx->sockfn = NULL;
 		}
 #else	/* WIN32 */
-		FlushFileBuffers(sockfd);
-		CloseHandle(sockfd);
+		FlushFileBuffers(dctx->sockfd);
+		CloseHandle(dctx->sockfd);
 #endif	/* WIN32 */
 
-		sockfd = ERROR_FD;
-	}
+		dctx->sockfd = ERROR_FD;
+	}
+
+	for (conn = dctx->connhead; conn; conn = cnext) {
+		cnext = conn->next;
+		sock_disconnect(conn);
+		conn = NULL;
+	}
+
+	dctx->connhead = NULL;
+	/* conntail = NULL; */
+
+	upsdebugx(1, "%s: finished", __func__);
+}
+
+/* interface */
+
+char * dstate_init(const char *prog, const char *devname)
+{
+	char	sockname[NUT_PATH_MAX + 1];
+
+#ifndef WIN32
+	/* do this here for now */
+#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_STRICT_PROTOTYPES)
+# pragma GCC diagnostic push
+# pragma GCC diagnostic ignored "-Wstrict-prototypes"
+#endif
+	signal(SIGPIPE, SIG_IGN);
+#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_STRICT_PROTOTYPES)
+# pragma GCC diagnostic pop
+#endif
+
+	if (devname) {
+		snprintf(sockname, sizeof(sockname), "%s/%s-%s", dflt_statepath(), prog, devname);
+	} else {
+		snprintf(sockname, sizeof(sockname), "%s/%s", dflt_statepath(), prog);
+	}
+#else	/* WIN32 */
+	/* upsname (and so devname) is now mandatory so no need to test it */
+	snprintf(sockname, sizeof(sockname), "\\\\.\\pipe\\%s-%s", prog, devname);
+	dctx->pipename = xstrdup(sockname);
+#endif	/* WIN32 */
+
+	dctx->sockfd = sock_open(sockname);
+
+#ifndef WIN32
+	upsdebugx(2, "%s: sock %s open on fd %d", __func__, sockname, dctx->sockfd);
+
+	dctx->listen_fd.kind = DSTATE_FD_LISTEN;
+	dctx->listen_fd.fd = dctx->sockfd;
+	dctx->listen_fd.ctx = dctx;
+	dctx->extrafd.kind = DSTATE_FD_EXTRAFD;
+	dctx->extrafd.fd = ERROR_FD;
+	dctx->extrafd.ctx = dctx;
+
+# ifdef DSTATE_USE_EPOLL
+	if ((dctx->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		upsdebug_with_errno(1, "%s: epoll_create1 failed, using "
+			DSTATE_EPOLL_FALLBACK, __func__);
+	} else {
+		dstate_fd_t	*reg;
+
+		dstate_epoll_add(&dctx->listen_fd);
+		for (reg = dctx->extra_fds; reg; reg = reg->next)
+			dstate_epoll_add(reg);
+	}
+# endif
+#else	/* WIN32 */
+	upsdebugx(2, "%s: sock %s open on handle %p", __func__, sockname, dctx->sockfd);
+#endif	/* WIN32 */
+
+	/* NOTE: Caller must free this string */
+	return xstrdup(sockname);
+}
+
+#ifndef WIN32
+int dstate_register_fd(TYPE_FD fd, dstate_fd_handler_t handler, void *arg)
+{
+	dstate_fd_t	*reg;
+
+	if (INVALID_FD(fd))
+		return -1;
+
+	for (reg = dctx->extra_fds; reg; reg = reg->next) {
+		if (reg->fd == fd)
+			break;
+	}
+
+	if (!reg) {
+		reg = (dstate_fd_t *)xcalloc(1, sizeof(*reg));
+		reg->kind = DSTATE_FD_REGISTERED;
+		reg->fd = fd;
+		reg->ctx = dctx;
+		reg->next = dctx->extra_fds;
+		dctx->extra_fds = reg;
+	}
+
+	reg->handler = handler;
+	reg->arg = arg;
+
+# ifdef DSTATE_USE_EPOLL
+	dstate_epoll_add(reg);
+# endif
+
+	upsdebugx(3, "%s: waiting for fd %d too", __func__, (int)fd);
+	return 0;
+}
+
+void dstate_unregister_fd(TYPE_FD fd)
+{
+	dstate_fd_t	**regp, *reg;
+
+	if (INVALID_FD(fd))
+		return;
+
+	for (regp = &dctx->extra_fds; (reg = *regp) != NULL; regp = &reg->next) {
+		if (reg->fd != fd)
+			continue;
+
+# ifdef DSTATE_USE_EPOLL
+		dstate_epoll_del(fd);
+# endif
+		if (dctx->dispatching) {
+			/* events may be pending for it, forget it later */
+			reg->fd = ERROR_FD;
+		} else {
+			*regp = reg->next;
+			free(reg);
+		}
+
+		upsdebugx(3, "%s: not waiting for fd %d anymore", __func__, (int)fd);
+		return;
+	}
+}
+
+/* Forget the descriptors unregistered while dispatching their events */
+static void dstate_fds_sweep(void)
+{
+	dstate_fd_t	**regp, *reg;
+
+	for (regp = &dctx->extra_fds; (reg = *regp) != NULL; ) {
+		if (INVALID_FD(reg->fd)) {
+			*regp = reg->next;
+			free(reg);
+		} else {
+			regp = &reg->next;
+		}
+	}
+}
+
+/* Handle the events of a descriptor of the selected instance;
+ * returns 1 if the caller of dstate_poll_fds() should be told */
+static int dstate_fd_event(dstate_fd_t *watch, int readable, int writable)
+{
+	conn_t	*conn = watch->conn;
+
+	if (watch->kind == DSTATE_FD_LISTEN) {
+		if (readable)
+			sock_connect(dctx->sockfd);
+		return 0;
+	}
+
+	if (watch->kind == DSTATE_FD_EXTRAFD)
+		return readable;
+
+	if (watch->kind == DSTATE_FD_REGISTERED) {
+		/* may have been unregistered by an earlier handler */
+		if (!readable || INVALID_FD(watch->fd))
+			return 0;
+		return watch->handler ? (watch->handler(watch->fd, watch->arg) != 0) : 1;
+	}
+
+	/* a connection: write out what a lagging reader has queued,
+	 * then see what it says */
+	if (writable && !conn->closing)
+		conn_flush(conn);
+	if (readable && !conn->closing)
+		sock_read(conn);
+
+	return 0;
+}
+
+/* The same, for a descriptor of any instance */
+static int dstate_fd_event_any(dstate_fd_t *watch, int readable, int writable)
+{
+	dstate_ctx_t	*prev;
+	int	ret;
+
+	if (!watch->ctx || watch->ctx == dctx)
+		return dstate_fd_event(watch, readable, writable);
+
+	prev = dstate_ctx_select(watch->ctx);
+	ret = dstate_fd_event(watch, readable, writable);
+	dstate_ctx_select(prev);
+
+	return ret;
+}
+
+/* Deal with what was left for after dispatching the events */
+static void dstate_dispatch_done(void)
+{
+	conn_t	*conn, *cnext;
+
+	dctx->dispatching = 0;
+	dstate_fds_sweep();
+
+	for (conn = dctx->connhead; conn; conn = cnext) {
+		cnext = conn->next;
+
+		if (conn->closing) {
+			sock_disconnect(conn);
+			conn = NULL;
+		}
+	}
+}
+
+# if (defined DSTATE_USE_EPOLL) || (defined DSTATE_USE_POLL)
+/* Remaining time as milliseconds, rounded up to not wake up early */
+static int dstate_timeout_ms(const struct timeval *tv)
+{
+	if (tv->tv_sec >= INT_MAX / 1000 - 1)
+		return INT_MAX;
+
+	return (int)(tv->tv_sec * 1000 + (tv->tv_usec + 999) / 1000);
+}
+# endif
+
+# ifdef DSTATE_USE_EPOLL
+/* Track the extrafd of the caller in the epoll set */
+static void dstate_epoll_extrafd(TYPE_FD arg_extrafd)
+{
+	conn_t	*conn;
+
+	if (dctx->epoll_extrafd == arg_extrafd && !dctx->epoll_extrafd_check)
+		return;
 
-	for (conn = connhead; conn; conn = cnext) {
-		cnext = conn->next;
-		sock_disconnect(conn);
-		conn = NULL;
+	if (dctx->epoll_extrafd != arg_extrafd && VALID_FD(dctx->epoll_extrafd)) {
+		/* The caller replaced it; the old one is usually closed
+		 * (so gone from the set) by now, and its number may have
+		 * been reused by a connection which must stay there */
+		for (conn = dctx->connhead; conn; conn = conn->next) {
+			if (conn->fd == dctx->epoll_extrafd)
+				break;
+		}
+		if (!conn && dctx->epoll_extrafd != dctx->sockfd)
+			dstate_epoll_del(dctx->epoll_extrafd);
 	}
 
-	connhead = NULL;
-	/* conntail = NULL; */
-
-	upsdebugx(1, "%s: finished", __func__);
+	dctx->epoll_extrafd = arg_extrafd;
+	dctx->epoll_extrafd_check = 0;
+	dstate_epoll_add(&dctx->extrafd);
 }
 
-/* interface */
-
-char * dstate_init(const char *prog, const char *devname)
+static int dstate_wait_epoll(const struct timeval *timeout, TYPE_FD arg_extrafd, int *wake)
 {
-	char	sockname[NUT_PATH_MAX + 1];
+	struct epoll_event	events[DSTATE_EPOLL_EVENTS];
+	int	ret, i;
 
-#ifndef WIN32
-	/* do this here for now */
-#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_STRICT_PROTOTYPES)
-# pragma GCC diagnostic push
-# pragma GCC diagnostic ignored "-Wstrict-prototypes"
-#endif
-	signal(SIGPIPE, SIG_IGN);
-#if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_STRICT_PROTOTYPES)
-# pragma GCC diagnostic pop
-#endif
+	dstate_epoll_extrafd(arg_extrafd);
+	if (dctx->epfd < 0)
+		return -2;	/* fall back right away */
 
-	if (devname) {
-		snprintf(sockname, sizeof(sockname), "%s/%s-%s", dflt_statepath(), prog, devname);
-	} else {
-		snprintf(sockname, sizeof(sockname), "%s/%s", dflt_statepath(), prog);
-	}
-#else	/* WIN32 */
-	/* upsname (and so devname) is now mandatory so no need to test it */
-	snprintf(sockname, sizeof(sockname), "\\\\.\\pipe\\%s-%s", prog, devname);
-	pipename = xstrdup(sockname);
-#endif	/* WIN32 */
+	ret = epoll_wait(dctx->epfd, events, DSTATE_EPOLL_EVENTS, dstate_timeout_ms(timeout));
 
-	sockfd = sock_open(sockname);
+	/* The caller may close and reopen its extrafd under the same
+	 * number, which removes it from the set: check it again next
+	 * time, but not on each of the frequent wake-ups by readers */
+	if (ret == 0)
+		dctx->epoll_extrafd_check = 1;
 
-#ifndef WIN32
-	upsdebugx(2, "%s: sock %s open on fd %d", __func__, sockname, sockfd);
-#else	/* WIN32 */
-	upsdebugx(2, "%s: sock %s open on handle %p", __func__, sockname, sockfd);
-#endif	/* WIN32 */
+	for (i = 0; i < ret; i++) {
+		*wake |= dstate_fd_event((dstate_fd_t *)events[i].data.ptr,
+			(events[i].events & ~(uint32_t)EPOLLOUT) != 0,
+			(events[i].events & EPOLLOUT) != 0);
+	}
 
-	/* NOTE: Caller must free this string */
-	return xstrdup(sockname);
+	return ret;
 }
+# endif	/* DSTATE_USE_EPOLL */
 
-/* returns 1 if timeout expired or data is available on UPS fd, 0 otherwise */
-int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
+# ifndef DSTATE_USE_POLL
+static void dstate_fdset_add(fd_set *fds, TYPE_FD fd, int *maxfd)
 {
-	int	maxfd = 0; /* Unidiomatic use vs. "sockfd" below, which is "int" on non-WIN32 */
-	int	overrun = 0;
-	conn_t	*conn, *cnext;
-	struct timeval	now;
+	if (fd >= FD_SETSIZE) {
+		upslogx(LOG_WARNING, "%s: fd %d is beyond FD_SETSIZE, not waiting for it",
+			__func__, (int)fd);
+		return;
+	}
 
-#ifndef WIN32
+	FD_SET(fd, fds);
+	if (fd > *maxfd)
+		*maxfd = fd;
+}
+
+static int dstate_fdset_ready(fd_set *fds, TYPE_FD fd)
+{
+	return (VALID_FD(fd) && fd < FD_SETSIZE && FD_ISSET(fd, fds));
+}
+# endif	/* !DSTATE_USE_POLL */
+
+/* Wait with poll() (or select()) for the descriptors of the instances in
+ * <ctxs> and for <arg_extrafd>, then dispatch their events. Descriptors
+ * unregistered and connections closed by the handlers are only marked
+ * while dispatching, new ones are not in the list, so it stays valid. */
+static int dstate_wait_fallback(dstate_ctx_t **ctxs, size_t nctx,
+	const struct timeval *timeout, TYPE_FD arg_extrafd, int *wake)
+{
+	dstate_fd_t	*reg;
+	conn_t	*conn;
+	size_t	n = 1, i;
 	int	ret;
-	fd_set	rfds;
+# ifndef DSTATE_USE_POLL
+	struct timeval	tv = *timeout;
+	fd_set	rfds, wfds;
+	int	maxfd = 0;
+# endif
 
-	FD_ZERO(&rfds);
-	FD_SET(sockfd, &rfds);
+	/* listening sockets, registered descriptors and connections */
+	for (i = 0; i < nctx; i++) {
+		n++;
+		for (reg = ctxs[i]->extra_fds; reg; reg = reg->next)
+			n++;
+		for (conn = ctxs[i]->connhead; conn; conn = conn->next)
+			n++;
+	}
+	if (n > dstate_waitlist_alloc) {
+		dstate_waitlist_alloc = n + 16;
+		dstate_waitlist = (dstate_fd_t **)xrealloc(dstate_waitlist,
+			dstate_waitlist_alloc * sizeof(*dstate_waitlist));
+# ifdef DSTATE_USE_POLL
+		dstate_pollfds = (struct pollfd *)xrealloc(dstate_pollfds,
+			dstate_waitlist_alloc * sizeof(*dstate_pollfds));
+# endif
+	}
 
-	maxfd = sockfd;
+	n = 0;
+	dstate_extrafd_watch.fd = arg_extrafd;
+	if (VALID_FD(arg_extrafd))
+		dstate_waitlist[n++] = &dstate_extrafd_watch;
+	for (i = 0; i < nctx; i++) {
+		if (VALID_FD(ctxs[i]->sockfd))
+			dstate_waitlist[n++] = &ctxs[i]->listen_fd;
+		for (reg = ctxs[i]->extra_fds; reg; reg = reg->next)
+			dstate_waitlist[n++] = reg;
+		for (conn = ctxs[i]->connhead; conn; conn = conn->next)
+			dstate_waitlist[n++] = conn->watch;
+	}
 
-	if (VALID_FD(arg_extrafd)) {
-		FD_SET(arg_extrafd, &rfds);
+# ifdef DSTATE_USE_POLL
+	for (i = 0; i < n; i++) {
+		conn = dstate_waitlist[i]->conn;
+		dstate_pollfds[i].fd = dstate_waitlist[i]->fd;
+		dstate_pollfds[i].events = POLLIN | ((conn && conn->want_write) ? POLLOUT : 0);
+		dstate_pollfds[i].revents = 0;
+	}
 
-		if (arg_extrafd > maxfd) {
-			maxfd = arg_extrafd;
-		}
+	ret = poll(dstate_pollfds, (nfds_t)n, dstate_timeout_ms(timeout));
+
+	for (i = 0; ret > 0 && i < n; i++) {
+		if (dstate_pollfds[i].revents == 0)
+			continue;
+		*wake |= dstate_fd_event_any(dstate_waitlist[i],
+			(dstate_pollfds[i].revents & ~POLLOUT) != 0,
+			(dstate_pollfds[i].revents & POLLOUT) != 0);
+	}
+# else	/* !DSTATE_USE_POLL */
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	for (i = 0; i < n; i++) {
+		conn = dstate_waitlist[i]->conn;
+		dstate_fdset_add(&rfds, dstate_waitlist[i]->fd, &maxfd);
+		if (conn && conn->want_write)
+			dstate_fdset_add(&wfds, dstate_waitlist[i]->fd, &maxfd);
 	}
 
-	for (conn = connhead; conn; conn = conn->next) {
-		FD_SET(conn->fd, &rfds);
+	ret = select(maxfd + 1, &rfds, &wfds, NULL, &tv);
 
-		if (conn->fd > maxfd) {
-			maxfd = conn->fd;
-		}
+	for (i = 0; ret > 0 && i < n; i++) {
+		int	readable = dstate_fdset_ready(&rfds, dstate_waitlist[i]->fd),
+			writable = dstate_fdset_ready(&wfds, dstate_waitlist[i]->fd);
+
+		if (readable || writable)
+			*wake |= dstate_fd_event_any(dstate_waitlist[i], readable, writable);
 	}
+# endif	/* !DSTATE_USE_POLL */
+
+	return ret;
+}
+
+/* Turn the deadline into the time left; returns 1 if none is */
+static int dstate_timeout_left(struct timeval *timeout)
+{
+	struct timeval	now;
 
 	gettimeofday(&now, NULL);
 
 	/* number of microseconds should always be positive */
-	if (timeout.tv_usec < now.tv_usec) {
-		timeout.tv_sec -= 1;
-		timeout.tv_usec += 1000000;
+	if (timeout->tv_usec < now.tv_usec) {
+		timeout->tv_sec -= 1;
+		timeout->tv_usec += 1000000;
 	}
 
-	if (timeout.tv_sec < now.tv_sec) {
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 0;
-		overrun = 1;	/* no time left */
-	} else {
-		timeout.tv_sec -= now.tv_sec;
-		timeout.tv_usec -= now.tv_usec;
+	if (timeout->tv_sec < now.tv_sec) {
+		timeout->tv_sec = 0;
+		timeout->tv_usec = 0;
+		return 1;	/* no time left */
 	}
 
-	ret = select(maxfd + 1, &rfds, NULL, NULL, &timeout);
+	timeout->tv_sec -= now.tv_sec;
+	timeout->tv_usec -= now.tv_usec;
+	return 0;
+}
 
+/* What dstate_poll_fds() and dstate_poll_all() tell their caller */
+static int dstate_wait_result(int ret, int overrun, int wake)
+{
 	if (ret == 0) {
 		return 1;	/* timer expired */
 	}
@@ -1603,40 +2359,143 @@ int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
 			break;
 
 		default:
-			upslog_with_errno(LOG_ERR, "%s: select unix sockets failed", __func__);
+			upslog_with_errno(LOG_ERR, "%s: waiting for unix sockets failed", __func__);
 		}
 
 		return overrun;
 	}
 
-	if (FD_ISSET(sockfd, &rfds)) {
-		sock_connect(sockfd);
+	/* tell the caller if that fd (or a registered one) woke up */
+	if (wake) {
+		return 1;
 	}
 
-	for (conn = connhead; conn; conn = cnext) {
-		cnext = conn->next;
+	return overrun;
+}
 
-		if (FD_ISSET(conn->fd, &rfds)) {
-			sock_read(conn);
+# ifdef DSTATE_USE_EPOLL
+/* The epoll set of dstate_poll_all(), with those of the instances
+ * (each readable when the instance has events) and its extrafd */
+static int	dstate_master_epfd = -1;
+static TYPE_FD	dstate_master_extrafd = ERROR_FD;
+
+static int dstate_wait_master(dstate_ctx_t **ctxs, size_t nctx,
+	const struct timeval *timeout, TYPE_FD arg_extrafd, int *wake)
+{
+	struct epoll_event	ev, events[DSTATE_EPOLL_EVENTS];
+	struct timeval	zero = { 0, 0 };
+	dstate_ctx_t	*prev;
+	size_t	i;
+	int	ret, j;
+
+	if (dstate_master_epfd < 0
+	&& (dstate_master_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0
+	) {
+		upsdebug_with_errno(1, "%s: epoll_create1 failed, using "
+			DSTATE_EPOLL_FALLBACK, __func__);
+		return -2;
+	}
+
+	for (i = 0; i < nctx; i++) {
+		if (ctxs[i]->in_master)
+			continue;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = ctxs[i];
+		if (epoll_ctl(dstate_master_epfd, EPOLL_CTL_ADD, ctxs[i]->epfd, &ev) < 0
+		&& errno != EEXIST
+		) {
+			upsdebug_with_errno(1, "%s: can't watch the epoll set of "
+				"an instance, using " DSTATE_EPOLL_FALLBACK, __func__);
+			return -2;
 		}
+		ctxs[i]->in_master = 1;
 	}
 
-	for (conn = connhead; conn; conn = cnext) {
-		cnext = conn->next;
+	if (dstate_master_extrafd != arg_extrafd) {
+		memset(&ev, 0, sizeof(ev));
+		if (VALID_FD(dstate_master_extrafd))
+			epoll_ctl(dstate_master_epfd, EPOLL_CTL_DEL, dstate_master_extrafd, &ev);
+		dstate_master_extrafd = ERROR_FD;
 
-		if (conn->closing) {
-			sock_disconnect(conn);
-			conn = NULL;
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (VALID_FD(arg_extrafd)) {
+			if (epoll_ctl(dstate_master_epfd, EPOLL_CTL_ADD, arg_extrafd, &ev) < 0
+			&& errno != EEXIST
+			) {
+				return -2;
+			}
+			dstate_master_extrafd = arg_extrafd;
 		}
 	}
 
-	/* tell the caller if that fd woke up */
-	if (VALID_FD(arg_extrafd) && (FD_ISSET(arg_extrafd, &rfds))) {
-		return 1;
+	ret = epoll_wait(dstate_master_epfd, events, DSTATE_EPOLL_EVENTS, dstate_timeout_ms(timeout));
+
+	/* as in dstate_wait_epoll(), in case it was closed and reopened */
+	if (ret == 0)
+		dstate_master_extrafd = ERROR_FD;
+
+	for (j = 0; j < ret; j++) {
+		dstate_ctx_t	*ctx = (dstate_ctx_t *)events[j].data.ptr;
+
+		if (!ctx) {
+			*wake = 1;
+			continue;
+		}
+
+		/* handle what is ready in that instance */
+		prev = dstate_ctx_select(ctx);
+		if (ctx->epfd >= 0)
+			dstate_wait_epoll(&zero, ERROR_FD, wake);
+		dstate_ctx_select(prev);
 	}
 
-#else /* WIN32 */
+	return ret;
+}
+# endif	/* DSTATE_USE_EPOLL */
+#else	/* WIN32 */
+int dstate_register_fd(TYPE_FD fd, dstate_fd_handler_t handler, void *arg)
+{
+	NUT_UNUSED_VARIABLE(fd);
+	NUT_UNUSED_VARIABLE(handler);
+	NUT_UNUSED_VARIABLE(arg);
+	NUT_WIN32_INCOMPLETE();
+	return -1;
+}
+
+void dstate_unregister_fd(TYPE_FD fd)
+{
+	NUT_UNUSED_VARIABLE(fd);
+}
+#endif	/* WIN32 */
 
+/* returns 1 if timeout expired or data is available on UPS fd, 0 otherwise */
+int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
+{
+	int	overrun = 0;
+#ifndef WIN32
+	dstate_ctx_t	*self = dctx;
+	int	ret = -2, wake = 0;
+
+	overrun = dstate_timeout_left(&timeout);
+
+	dctx->extrafd.fd = arg_extrafd;
+	dctx->dispatching = 1;
+# ifdef DSTATE_USE_EPOLL
+	if (dctx->epfd >= 0)
+		ret = dstate_wait_epoll(&timeout, arg_extrafd, &wake);
+# endif
+	if (ret == -2)
+		ret = dstate_wait_fallback(&self, 1, &timeout, arg_extrafd, &wake);
+	dstate_dispatch_done();
+
+	return dstate_wait_result(ret, overrun, wake);
+#else /* WIN32 */
+	conn_t	*conn, *cnext;
+	struct timeval	now;
+	int	maxfd = 0; /* Unidiomatic use vs. "sockfd" below, which is "int" on non-WIN32 */
 	DWORD	ret;
 	HANDLE	rfds[32];
 	DWORD	timeout_ms;
@@ -1670,12 +2529,12 @@ int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
 	timeout_ms = (timeout.tv_sec * 1000) + (timeout.tv_usec / 1000);
 
 	/* Wait on the read IO of each connections */
-	for (conn = connhead; conn; conn = conn->next) {
+	for (conn = dctx->connhead; conn; conn = conn->next) {
 		rfds[maxfd] = conn->read_overlapped.hEvent;
 		maxfd++;
 	}
 	/* Add the connect event */
-	rfds[maxfd] = connect_overlapped.hEvent;
+	rfds[maxfd] = dctx->connect_overlapped.hEvent;
 	maxfd++;
 
 	ret = WaitForMultipleObjects(
@@ -1694,15 +2553,15 @@ int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
 	}
 
 	/* Retrieve the signaled connection */
-	for (conn = connhead; conn != NULL; conn = conn->next) {
+	for (conn = dctx->connhead; conn != NULL; conn = conn->next) {
 		if (conn->read_overlapped.hEvent == rfds[ret-WAIT_OBJECT_0]) {
 			break;
 		}
 	}
 
 	/* the connection event handle has been signaled */
-	if (rfds[ret] == connect_overlapped.hEvent) {
-		sock_connect(sockfd);
+	if (rfds[ret] == dctx->connect_overlapped.hEvent) {
+		sock_connect(dctx->sockfd);
 	}
 	/* one of the read event handle has been signaled */
 	else {
@@ -1711,7 +2570,7 @@ int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
 		}
 	}
 
-	for (conn = connhead; conn; conn = cnext) {
+	for (conn = dctx->connhead; conn; conn = cnext) {
 		cnext = conn->next;
 
 		if (conn->closing) {
@@ -1726,9 +2585,66 @@ int dstate_poll_fds(struct timeval timeout, TYPE_FD arg_extrafd)
 		return 1;
 	}
 */
-#endif	/* WIN32 */
 
 	return overrun;
+#endif	/* WIN32 */
+}
+
+int dstate_poll_all(struct timeval timeout, TYPE_FD arg_extrafd)
+{
+#ifndef WIN32
+	static dstate_ctx_t	**ctxs = NULL;
+	static size_t	ctxs_alloc = 0;
+	dstate_ctx_t	*ctx, *prev;
+	size_t	nctx = 0, i;
+	int	ret = -2, wake = 0, overrun;
+# ifdef DSTATE_USE_EPOLL
+	int	all_epoll = 1;
+# endif
+
+	/* the instances with a socket */
+	for (i = 0, ctx = dstate_all; ctx; ctx = ctx->all_next)
+		i++;
+	if (i + 1 > ctxs_alloc) {
+		ctxs_alloc = i + 16;
+		ctxs = (dstate_ctx_t **)xrealloc(ctxs, ctxs_alloc * sizeof(*ctxs));
+	}
+	if (VALID_FD(dstate_default.sockfd))
+		ctxs[nctx++] = &dstate_default;
+	for (ctx = dstate_all; ctx; ctx = ctx->all_next) {
+		if (VALID_FD(ctx->sockfd))
+			ctxs[nctx++] = ctx;
+	}
+
+	overrun = dstate_timeout_left(&timeout);
+
+	for (i = 0; i < nctx; i++) {
+		ctxs[i]->dispatching = 1;
+# ifdef DSTATE_USE_EPOLL
+		if (ctxs[i]->epfd < 0)
+			all_epoll = 0;
+# endif
+	}
+
+# ifdef DSTATE_USE_EPOLL
+	if (all_epoll)
+		ret = dstate_wait_master(ctxs, nctx, &timeout, arg_extrafd, &wake);
+# endif
+	if (ret == -2)
+		ret = dstate_wait_fallback(ctxs, nctx, &timeout, arg_extrafd, &wake);
+
+	prev = dctx;
+	for (i = 0; i < nctx; i++) {
+		dstate_ctx_select(ctxs[i]);
+		dstate_dispatch_done();
+	}
+	dstate_ctx_select(prev);
+
+	return dstate_wait_result(ret, overrun, wake);
+#else	/* WIN32 */
+	/* FIXME NUT_WIN32_INCOMPLETE: only the selected instance */
+	return dstate_poll_fds(timeout, arg_extrafd);
+#endif	/* WIN32 */
 }
 
 /******************************************************************
@@ -1759,10 +2675,13 @@ int vdstate_setinfo(const char *var, const char *fmt, va_list ap)
 #pragma GCC diagnostic pop
 #endif
 
-	ret = state_setinfo(&dtree_root, var, value);
+	ret = state_setinfo(&dctx->dtree_root, var, value);
 
 	if (ret == 1) {
-		send_to_all("SETINFO %s \"%s\"\n", var, value);
+		dctx->setinfo_changed++;
+		send_setinfo_to_all(var, value);
+	} else {
+		dctx->setinfo_suppressed++;
 	}
 
 	return ret;
@@ -1826,6 +2745,119 @@ int dstate_setinfo_dynamic(const char *var, const char *fmt_dynamic, const char
 	}
 }
 
+/* Common code of the typed setters below: "val" points to a double or
+ * a long (as told by "fmt"), which is compared to the numeric shadow of
+ * the existing entry (if any) so that unchanged readings are only fully
+ * formatted, compared as strings and escaped when they actually change.
+ * The "fmt" must be a static string (its pointer is cached as the key),
+ * and for doubles it should be validated by caller against "%f" -- or
+ * be "%.*f" used with "prec".
+ */
+static int dstate_setinfo_numeric(const char *var, const char *fmt, int prec, int is_long, const void *val)
+{
+	int	ret;
+	char	value[ST_MAX_VALUE_LEN];
+	st_tree_t	*node = state_tree_find(dctx->dtree_root, var);
+	size_t	valsize = (is_long ? sizeof(long) : sizeof(double));
+
+	if (node && node->numfmt == fmt && node->numprec == prec
+	 && !memcmp(&node->numval, val, valsize)
+	) {
+		/* Same as state_setinfo() would do for an unchanged value */
+		state_get_timestamp(&node->lastset);
+		dctx->setinfo_suppressed++;
+		return 0;
+	}
+
+#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic push
+#endif
+#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+#ifdef HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_FORMAT_SECURITY
+#pragma GCC diagnostic ignored "-Wformat-security"
+#endif
+	/* Formatting strings here are either our own, or were
+	 * validated by the caller against expected data type */
+	if (is_long) {
+		snprintf(value, sizeof(value), fmt, *(const long *)val);
+	} else if (prec >= 0) {
+		snprintf(value, sizeof(value), fmt, prec, *(const double *)val);
+	} else {
+		snprintf(value, sizeof(value), fmt, *(const double *)val);
+	}
+#ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_FORMAT_NONLITERAL
+#pragma GCC diagnostic pop
+#endif
+
+	ret = state_setinfo(&dctx->dtree_root, var, value);
+
+	if (ret == 1) {
+		dctx->setinfo_changed++;
+		send_setinfo_to_all(var, value);
+	} else {
+		dctx->setinfo_suppressed++;
+	}
+
+	/* Remember the numeric value behind the string we now have
+	 * (e.g. an ST_FLAG_IMMUTABLE entry may keep another value) */
+	if (!node)
+		node = state_tree_find(dctx->dtree_root, var);
+
+	if (node) {
+		if (!strcmp(node->raw, value)) {
+			node->numfmt = fmt;
+			node->numprec = prec;
+			memcpy(&node->numval, val, valsize);
+		} else {
+			node->numfmt = NULL;
+		}
+	}
+
+	return ret;
+}
+
+int dstate_setinfo_int(const char *var, long value)
+{
+	return dstate_setinfo_numeric(var, "%ld", -1, 1, &value);
+}
+
+int dstate_setinfo_double(const char *var, int precision, double value)
+{
+	if (precision < 0)
+		precision = 0;
+
+	return dstate_setinfo_numeric(var, "%.*f", precision, 0, &value);
+}
+
+int dstate_setinfo_double_dynamic(const char *var, const char *fmt_dynamic, double value)
+{
+	st_tree_t	*node;
+
+	if (!var)
+		return -1;
+
+	/* A formatting string we have already used for this entry is
+	 * known to be valid, only check new ones (e.g. first time) */
+	node = state_tree_find(dctx->dtree_root, var);
+	if (!node || node->numfmt != fmt_dynamic) {
+		if (validate_formatting_string(fmt_dynamic, "%f", NUT_DYNAMICFORMATTING_DEBUG_LEVEL) < 0)
+			return -1;
+	}
+
+	return dstate_setinfo_numeric(var, fmt_dynamic, -1, 0, &value);
+}
+
+void dstate_get_setinfo_counters(uintmax_t *changed, uintmax_t *suppressed)
+{
+	if (changed)
+		*changed = dctx->setinfo_changed;
+
+	if (suppressed)
+		*suppressed = dctx->setinfo_suppressed;
+}
+
 int vdstate_addenum(const char *var, const char *fmt, va_list ap)
 {
 	int	ret;
@@ -1850,7 +2882,7 @@ int vdstate_addenum(const char *var, const char *fmt, va_list ap)
 #pragma GCC diagnostic pop
 #endif
 
-	ret = state_addenum(dtree_root, var, value);
+	ret = state_addenum(dctx->dtree_root, var, value);
 
 	if (ret == 1) {
 		send_to_all("ADDENUM %s \"%s\"\n", var, value);
@@ -1921,7 +2953,7 @@ int dstate_addrange(const char *var, const int min, const int max)
 {
 	int	ret;
 
-	ret = state_addrange(dtree_root, var, min, max);
+	ret = state_addrange(dctx->dtree_root, var, min, max);
 
 	if (ret == 1) {
 		send_to_all("ADDRANGE %s %i %i\n", var, min, max);
@@ -1938,7 +2970,7 @@ void dstate_setflags(const char *var, int flags)
 	char	flist[SMALLBUF];
 
 	/* find the dtree node for var */
-	sttmp = state_tree_find(dtree_root, var);
+	sttmp = state_tree_find(dctx->dtree_root, var);
 
 	if (!sttmp) {
 		upslogx(LOG_ERR, "%s: base variable (%s) does not exist", __func__, var);
@@ -1977,7 +3009,7 @@ void dstate_setflags(const char *var, int flags)
 
 void dstate_addflags(const char *var, const int addflags)
 {
-	int	flags = state_getflags(dtree_root, var);
+	int	flags = state_getflags(dctx->dtree_root, var);
 
 	if (flags == -1) {
 		upslogx(LOG_ERR, "%s: cannot get flags of '%s'", __func__, var);
@@ -1995,7 +3027,7 @@ void dstate_addflags(const char *var, const int addflags)
 
 void dstate_delflags(const char *var, const int delflags)
 {
-	int	flags = state_getflags(dtree_root, var);
+	int	flags = state_getflags(dctx->dtree_root, var);
 
 	if (flags == -1) {
 		upslogx(LOG_ERR, "%s: cannot get flags of '%s'", __func__, var);
@@ -2016,7 +3048,7 @@ void dstate_setaux(const char *var, long aux)
 	st_tree_t	*sttmp;
 
 	/* find the dtree node for var */
-	sttmp = state_tree_find(dtree_root, var);
+	sttmp = state_tree_find(dctx->dtree_root, var);
 
 	if (!sttmp) {
 		upslogx(LOG_ERR, "%s: base variable (%s) does not exist", __func__, var);
@@ -2035,7 +3067,7 @@ void dstate_setaux(const char *var, long aux)
 
 const char *dstate_getinfo(const char *var)
 {
-	return state_getinfo(dtree_root, var);
+	return state_getinfo(dctx->dtree_root, var);
 }
 
 const st_tree_t *dstate_tree_find(const char *var)
@@ -2043,14 +3075,14 @@ const st_tree_t *dstate_tree_find(const char *var)
 	if (!var)
 		return NULL;
 
-	return state_tree_find(dtree_root, var);
+	return state_tree_find(dctx->dtree_root, var);
 }
 
 void dstate_addcmd(const char *cmdname)
 {
 	int	ret;
 
-	ret = state_addcmd(&cmdhead, cmdname);
+	ret = state_addcmd(&dctx->cmdhead, cmdname);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2062,7 +3094,7 @@ int dstate_delinfo(const char *var)
 {
 	int	ret;
 
-	ret = state_delinfo(&dtree_root, var);
+	ret = state_delinfo(&dctx->dtree_root, var);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2076,7 +3108,7 @@ int dstate_delinfo_olderthan(const char *var, const st_tree_timespec_t *cutoff)
 {
 	int	ret;
 
-	ret = state_delinfo_olderthan(&dtree_root, var, cutoff);
+	ret = state_delinfo_olderthan(&dctx->dtree_root, var, cutoff);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2090,7 +3122,7 @@ int dstate_delenum(const char *var, const char *val)
 {
 	int	ret;
 
-	ret = state_delenum(dtree_root, var, val);
+	ret = state_delenum(dctx->dtree_root, var, val);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2104,7 +3136,7 @@ int dstate_delrange(const char *var, const int min, const int max)
 {
 	int	ret;
 
-	ret = state_delrange(dtree_root, var, min, max);
+	ret = state_delrange(dctx->dtree_root, var, min, max);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2118,7 +3150,7 @@ int dstate_delcmd(const char *cmd)
 {
 	int	ret;
 
-	ret = state_delcmd(&cmdhead, cmd);
+	ret = state_delcmd(&dctx->cmdhead, cmd);
 
 	/* update listeners */
 	if (ret == 1) {
@@ -2130,44 +3162,123 @@ int dstate_delcmd(const char *cmd)
 
 void dstate_free(void)
 {
-	state_infofree(dtree_root);
-	dtree_root = NULL;
+	upsdebugx(1, "%s: value updates over driver lifetime: %" PRIuMAX
+		" changed, %" PRIuMAX " suppressed as unchanged",
+		__func__, dctx->setinfo_changed, dctx->setinfo_suppressed);
+
+	state_infofree(dctx->dtree_root);
+	dctx->dtree_root = NULL;
 
-	state_cmdfree(cmdhead);
-	cmdhead = NULL;
+	state_cmdfree(dctx->cmdhead);
+	dctx->cmdhead = NULL;
 
 	sock_close();
+
+#ifndef WIN32
+	while (dctx->extra_fds) {
+		dstate_fd_t	*reg = dctx->extra_fds;
+
+		dctx->extra_fds = reg->next;
+		free(reg);
+	}
+#endif	/* !WIN32 */
+}
+
+dstate_ctx_t *dstate_ctx_new(void)
+{
+	dstate_ctx_t	*ctx = (dstate_ctx_t *)xcalloc(1, sizeof(*ctx));
+
+	ctx->sockfd = ERROR_FD;
+	ctx->stale = 1;
+	ctx->prev_battery_charge = -1.0;
+#ifdef DSTATE_USE_EPOLL
+	ctx->epfd = -1;
+	ctx->epoll_extrafd = ERROR_FD;
+#endif
+
+	ctx->all_next = dstate_all;
+	dstate_all = ctx;
+
+	return ctx;
+}
+
+dstate_ctx_t *dstate_ctx_select(dstate_ctx_t *ctx)
+{
+	dstate_ctx_t	*prev = dctx;
+
+	dctx = ctx ? ctx : &dstate_default;
+
+	return prev;
+}
+
+dstate_ctx_t *dstate_ctx_get(void)
+{
+	return dctx;
+}
+
+void dstate_ctx_free(dstate_ctx_t *ctx)
+{
+	dstate_ctx_t	*prev, **ctxp;
+
+	if (!ctx || ctx == &dstate_default)
+		return;
+
+	for (ctxp = &dstate_all; *ctxp; ctxp = &(*ctxp)->all_next) {
+		if (*ctxp == ctx) {
+			*ctxp = ctx->all_next;
+			break;
+		}
+	}
+
+	prev = dstate_ctx_select(ctx);
+	dstate_free();
+	dstate_ctx_select(prev == ctx ? NULL : prev);
+
+	free(ctx);
+}
+
+void dstate_remember_battery_charge(void)
+{
+	const st_tree_t	*node = state_tree_find(dctx->dtree_root, "battery.charge");
+	double	d = -1.0;
+
+	if (node && node->val && str_to_double(node->val, &d, 10) && d >= 0.0
+	&& !d_equal(dctx->prev_battery_charge, d)
+	) {
+		dctx->prev_battery_charge = d;
+		dctx->prev_battery_charge_ts = node->lastset;
+	}
 }
 
 const st_tree_t *dstate_getroot(void)
 {
-	return dtree_root;
+	return dctx->dtree_root;
 }
 
 const cmdlist_t *dstate_getcmdlist(void)
 {
-	return cmdhead;
+	return dctx->cmdhead;
 }
 
 void dstate_dataok(void)
 {
-	if (stale == 1) {
-		stale = 0;
+	if (dctx->stale == 1) {
+		dctx->stale = 0;
 		send_to_all("DATAOK\n");
 	}
 }
 
 void dstate_datastale(void)
 {
-	if (stale == 0) {
-		stale = 1;
+	if (dctx->stale == 0) {
+		dctx->stale = 1;
 		send_to_all("DATASTALE\n");
 	}
 }
 
 int dstate_is_stale(void)
 {
-	return stale;
+	return dctx->stale;
 }
 
 /* ups.status management functions - reducing duplication in the drivers */
@@ -2176,29 +3287,29 @@ int dstate_is_stale(void)
 void status_init(void)
 {
 	/* This does not normally change in driver run-time, but can in tests */
-	ignorelb = (dstate_getinfo("driver.flag.ignorelb") ? 1 : 0);
+	dctx->ignorelb = (dstate_getinfo("driver.flag.ignorelb") ? 1 : 0);
 
-	memset(status_buf, 0, sizeof(status_buf));
-	alarm_status = 0;
-	alarm_legacy_status = 0;
+	memset(dctx->status_buf, 0, sizeof(dctx->status_buf));
+	dctx->alarm_status = 0;
+	dctx->alarm_legacy_status = 0;
 }
 
 /* check if a status element has been set, return 0 if not, 1 if yes
  * (considering a whole-word token in temporary status_buf) */
 int status_get(const char *buf)
 {
-	return str_contains_token(status_buf, buf);
+	return str_contains_token(dctx->status_buf, buf);
 }
 
 /* add a status element */
 static int status_set_callback(char *tgt, size_t tgtsize, const char *token)
 {
-	if (tgt != status_buf || tgtsize != sizeof(status_buf)) {
+	if (tgt != dctx->status_buf || tgtsize != sizeof(dctx->status_buf)) {
 		upsdebugx(2, "%s: called for wrong use-case", __func__);
 		return 0;
 	}
 
-	if (ignorelb && !strcasecmp(token, "LB")) {
+	if (dctx->ignorelb && !strcasecmp(token, "LB")) {
 		upsdebugx(2, "%s: ignoring LB flag from device", __func__);
 		return 0;
 	}
@@ -2219,7 +3330,7 @@ static int status_set_callback(char *tgt, size_t tgtsize, const char *token)
 		 * https://github.com/networkupstools/nut/pull/2931#issuecomment-2841705269
 		 */
 		upsdebugx(6, "%s: caller set ALARM as a status, this is deprecated - please fix the NUT driver code", __func__);
-		alarm_legacy_status = 1;
+		dctx->alarm_legacy_status = 1;
 		return 0; /* ignore it */
 	}
 
@@ -2232,7 +3343,7 @@ void status_set(const char *buf)
 #ifdef DEBUG
 	upsdebugx(3, "%s: '%s'\n", __func__, buf);
 #endif
-	str_add_unique_token(status_buf, sizeof(status_buf), buf, status_set_callback, NULL);
+	str_add_unique_token(dctx->status_buf, sizeof(dctx->status_buf), buf, status_set_callback, NULL);
 }
 
 /* write the status_buf into the externally visible dstate storage */
@@ -2241,14 +3352,14 @@ void status_commit(void)
 	/* FIXME: Further unify two accesses to, and parses of, "battery.charge" */
 	const st_tree_t	*dstate_battery_charge_entry = dstate_tree_find("battery.charge");
 
-	while (ignorelb) {
+	while (dctx->ignorelb) {
 		const char	*val, *low;
 
 		val = dstate_battery_charge_entry ? dstate_battery_charge_entry->val : NULL;
 		low = dstate_getinfo("battery.charge.low");
 
 		if (val && low && (strtol(val, NULL, 10) < strtol(low, NULL, 10))) {
-			snprintfcat(status_buf, sizeof(status_buf), " LB");
+			snprintfcat(dctx->status_buf, sizeof(dctx->status_buf), " LB");
 			upsdebugx(2, "%s: appending LB flag [charge '%s' below '%s']", __func__, val, low);
 			break;
 		}
@@ -2257,7 +3368,7 @@ void status_commit(void)
 		low = dstate_getinfo("battery.runtime.low");
 
 		if (val && low && (strtol(val, NULL, 10) < strtol(low, NULL, 10))) {
-			snprintfcat(status_buf, sizeof(status_buf), " LB");
+			snprintfcat(dctx->status_buf, sizeof(dctx->status_buf), " LB");
 			upsdebugx(2, "%s: appending LB flag [runtime '%s' below '%s']", __func__, val, low);
 			break;
 		}
@@ -2269,6 +3380,9 @@ void status_commit(void)
 	if (dstate_battery_charge_entry && dstate_battery_charge_entry->val) {
 		double	current_battery_charge_value = -1.0;
 
+		double	previous_battery_charge_value = dctx->prev_battery_charge;
+		st_tree_timespec_t	previous_battery_charge_timestamp = dctx->prev_battery_charge_ts;
+
 		if (previous_battery_charge_value >= 0.0
 		 && str_to_double(dstate_battery_charge_entry->val, &current_battery_charge_value, 10)
 		 && current_battery_charge_value >= 0
@@ -2312,15 +3426,15 @@ void status_commit(void)
 		}
 	}
 
-	if (alarm_active || alarm_legacy_status) {
-		if (*status_buf != '\0') {
-			dstate_setinfo("ups.status", "ALARM %s", status_buf);
+	if (dctx->alarm_active || dctx->alarm_legacy_status) {
+		if (*dctx->status_buf != '\0') {
+			dstate_setinfo("ups.status", "ALARM %s", dctx->status_buf);
 		} else {
 			dstate_setinfo("ups.status", "ALARM");
 		}
 	} else {
-		dstate_setinfo("ups.status", "%s", status_buf);
-		alarm_legacy_status = 0; /* just to be sure */
+		dstate_setinfo("ups.status", "%s", dctx->status_buf);
+		dctx->alarm_legacy_status = 0; /* just to be sure */
 	}
 }
 
@@ -2328,27 +3442,27 @@ void status_commit(void)
  * dynamically (e.g. due to ECO/ESS/HE/Smart modes supported by the device) */
 void buzzmode_init(void)
 {
-	memset(buzzmode_buf, 0, sizeof(buzzmode_buf));
+	memset(dctx->buzzmode_buf, 0, sizeof(dctx->buzzmode_buf));
 }
 
 int  buzzmode_get(const char *buf)
 {
-	return str_contains_token(buzzmode_buf, buf);
+	return str_contains_token(dctx->buzzmode_buf, buf);
 }
 
 void buzzmode_set(const char *buf)
 {
-	str_add_unique_token(buzzmode_buf, sizeof(buzzmode_buf), buf, NULL, NULL);
+	str_add_unique_token(dctx->buzzmode_buf, sizeof(dctx->buzzmode_buf), buf, NULL, NULL);
 }
 
 void buzzmode_commit(void)
 {
-	if (!*buzzmode_buf) {
+	if (!*dctx->buzzmode_buf) {
 		dstate_delinfo("experimental.ups.mode.buzzwords");
 		return;
 	}
 
-	dstate_setinfo("experimental.ups.mode.buzzwords", "%s", buzzmode_buf);
+	dstate_setinfo("experimental.ups.mode.buzzwords", "%s", dctx->buzzmode_buf);
 }
 
 /* similar handlers for ups.alarm */
@@ -2356,7 +3470,7 @@ void buzzmode_commit(void)
 void alarm_init(void)
 {
 	/* reinit global counter */
-	alarm_active = 0;
+	dctx->alarm_active = 0;
 
 	device_alarm_init();
 }
@@ -2375,10 +3489,10 @@ void alarm_set(const char *buf)
 	 *  are anticipated, for readability.
 	 */
 	int ret;
-	if (strlen(alarm_buf) < 1 || (alarm_status && !strcmp(alarm_buf, "[N/A]"))) {
-		ret = snprintf(alarm_buf, sizeof(alarm_buf), "%s", buf);
+	if (strlen(dctx->alarm_buf) < 1 || (dctx->alarm_status && !strcmp(dctx->alarm_buf, "[N/A]"))) {
+		ret = snprintf(dctx->alarm_buf, sizeof(dctx->alarm_buf), "%s", buf);
 	} else {
-		ret = snprintfcat(alarm_buf, sizeof(alarm_buf), " %s", buf);
+		ret = snprintfcat(dctx->alarm_buf, sizeof(dctx->alarm_buf), " %s", buf);
 	}
 
 	if (ret < 0) {
@@ -2430,7 +3544,7 @@ void alarm_set(const char *buf)
 			__func__, alarm_tmp,
 			( (buflen < sizeof(alarm_tmp)) ? "" : "...<truncated>" )
 			);
-	} else if ((size_t)ret > sizeof(alarm_buf)) {
+	} else if ((size_t)ret > sizeof(dctx->alarm_buf)) {
 		char	alarm_tmp[LARGEBUF];
 		int	ibuflen;
 		size_t	buflen;
@@ -2464,7 +3578,7 @@ void alarm_set(const char *buf)
 		}
 		upslogx(LOG_WARNING, "%s: result was truncated while setting or appending "
 			"alarm_buf (limited to %" PRIuSIZE " bytes), with message: %s%s",
-			__func__, sizeof(alarm_buf), alarm_tmp,
+			__func__, sizeof(dctx->alarm_buf), alarm_tmp,
 			( (buflen < sizeof(alarm_tmp)) ? "" : "...<also truncated>" )
 			);
 	}
@@ -2482,19 +3596,19 @@ void alarm_commit(void)
 	 * would be equivalent, but too intimate for later maintenance.
 	 */
 
-	if (strlen(alarm_buf) > 0) {
-		dstate_setinfo("ups.alarm", "%s", alarm_buf);
-		alarm_active = 1;
+	if (strlen(dctx->alarm_buf) > 0) {
+		dstate_setinfo("ups.alarm", "%s", dctx->alarm_buf);
+		dctx->alarm_active = 1;
 	} else {
 		dstate_delinfo("ups.alarm");
-		alarm_active = 0;
+		dctx->alarm_active = 0;
 	}
 }
 
 void device_alarm_init(void)
 {
 	/* only clear the buffer, don't touch the alarms counter */
-	memset(alarm_buf, 0, sizeof(alarm_buf));
+	memset(dctx->alarm_buf, 0, sizeof(dctx->alarm_buf));
 }
 
 /* same as above, but writes to "device.X.ups.alarm" or "ups.alarm" */
@@ -2515,9 +3629,9 @@ void device_alarm_commit(const int device_number)
 	 * increase the counter when alarms are present on a subdevice, but
 	 * don't decrease the count. Otherwise, we may not get the ALARM flag
 	 * in ups.status, while there are some alarms present on device.X */
-	if (strlen(alarm_buf) > 0) {
-		dstate_setinfo(info_name, "%s", alarm_buf);
-		alarm_active++;
+	if (strlen(dctx->alarm_buf) > 0) {
+		dstate_setinfo(info_name, "%s", dctx->alarm_buf);
+		dctx->alarm_active++;
 	} else {
 		dstate_delinfo(info_name);
 	}
@@ -55,6 +55,19 @@ typedef struct conn_s {
 	int	nobroadcast;	/* connections can request to ignore send_to_all() updates */
 	int	readzero;	/* how many times in a row we had zero bytes read; see DSTATE_CONN_READZERO_THROTTLE_USEC and DSTATE_CONN_READZERO_THROTTLE_MAX */
 	int	closing;	/* raised during LOGOUT processing, to close the socket when time is right */
+#ifndef WIN32
+	/* Output the socket did not take yet, written out when it becomes
+	 * writable; SETINFO lines for the same variable are coalesced in
+	 * the "pending" list while the reader lags behind. The reader is
+	 * disconnected if more than DSTATE_CONN_QUEUE_MAX bytes of other
+	 * output pile up. */
+	char	*outbuf;
+	size_t	outoff, outlen, outalloc;
+	struct dstate_pending_s	*pending, *pending_tail, **pending_hash;
+	size_t	pending_len;
+	int	want_write;
+	struct dstate_fd_s	*watch;	/* what the wait loop knows it by */
+#endif	/* !WIN32 */
 } conn_t;
 
 /* sleep after read()ing zero bytes */
@@ -63,6 +76,10 @@ typedef struct conn_s {
 /* close socket after read()ing zero bytes this many times in a row */
 #define DSTATE_CONN_READZERO_THROTTLE_MAX	5
 
+/* disconnect a reader which lets this many bytes of output (besides the
+ * coalesced SETINFO values) queue up */
+#define DSTATE_CONN_QUEUE_MAX	(1024 * 1024)
+
 #include "main.h"	/* for set_exit_flag(); uses conn_t itself */
 
 	extern	struct	ups_handler	upsh;
@@ -71,17 +88,49 @@ typedef struct conn_s {
 	 * Defaults to nonblocking, for backward compatibility */
 	extern	int	do_synchronous;
 
-	/* Globally track if we are charging or losing power, and how fast */
-	extern double	previous_battery_charge_value;
-	extern st_tree_timespec_t	previous_battery_charge_timestamp;
+/* The state of one device instance (socket, connections, data tree).
+ * All dstate functions work on the selected one, which is a built-in
+ * default unless a process hosting several devices selects another;
+ * dstate_ctx_select() returns the previous one (NULL selects the
+ * default) and dstate_ctx_get() the selected one. dstate_ctx_free()
+ * releases what dstate_free() would, then the instance itself. */
+typedef struct dstate_ctx_s dstate_ctx_t;
+dstate_ctx_t *dstate_ctx_new(void);
+dstate_ctx_t *dstate_ctx_select(dstate_ctx_t *ctx);
+dstate_ctx_t *dstate_ctx_get(void);
+void dstate_ctx_free(dstate_ctx_t *ctx);
 
 char * dstate_init(const char *prog, const char *devname);
 int dstate_poll_fds(struct timeval timeout, TYPE_FD extrafd);
+/* The same for all instances with a socket at once, e.g. for a process
+ * hosting several devices: their readers and registered descriptors are
+ * handled each with its instance selected; the caller's one stays. With
+ * epoll the instances are waited for through one set holding theirs. */
+int dstate_poll_all(struct timeval timeout, TYPE_FD extrafd);
+/* Extra descriptors for dstate_poll_fds() to wait on, besides the driver
+ * socket, its connections and the single extrafd (e.g. the sockets of
+ * several upstream devices). When one is readable, its handler is called
+ * from dstate_poll_fds(), which returns 1 (as if extrafd was readable) if
+ * the handler returns non-zero or is NULL. A descriptor must be removed
+ * before it is closed. Returns 0 on success, -1 on error (not available
+ * on Windows). */
+typedef int (*dstate_fd_handler_t)(TYPE_FD fd, void *arg);
+int dstate_register_fd(TYPE_FD fd, dstate_fd_handler_t handler, void *arg);
+void dstate_unregister_fd(TYPE_FD fd);
 int vdstate_setinfo(const char *var, const char *fmt, va_list ap);
 int dstate_setinfo(const char *var, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
 int dstate_setinfo_dynamic(const char *var, const char *fmt_dynamic, const char *fmt_reference, ...)
 	__attribute__ ((__format__ (__printf__, 3, 4)));
+/* Typed setters for numeric values: they remember the number behind
+ * the current string value, and only format, compare and broadcast it
+ * when the number (or formatting) changes. The _dynamic() variant
+ * expects a static formatting string compatible with "%f". */
+int dstate_setinfo_int(const char *var, long value);
+int dstate_setinfo_double(const char *var, int precision, double value);
+int dstate_setinfo_double_dynamic(const char *var, const char *fmt_dynamic, double value);
+/* How many dstate_setinfo*() calls did or did not change a value */
+void dstate_get_setinfo_counters(uintmax_t *changed, uintmax_t *suppressed);
 int vdstate_addenum(const char *var, const char *fmt, va_list ap);
 int dstate_addenum(const char *var, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
@@ -92,6 +141,9 @@ void dstate_setflags(const char *var, int flags);
 void dstate_addflags(const char *var, const int addflags);
 void dstate_delflags(const char *var, const int delflags);
 void dstate_setaux(const char *var, long aux);
+/* Remember battery.charge before an update, so status_commit() can tell
+ * if the battery is charging or discharging by how it changes */
+void dstate_remember_battery_charge(void);
 const char *dstate_getinfo(const char *var);
 const st_tree_t *dstate_tree_find(const char *var);	/* Return the whole entry, or NULL */
 void dstate_addcmd(const char *cmdname);
@@ -48,7 +48,7 @@
 #include "dummy-ups.h"
 
 #define DRIVER_NAME	"Device simulation and repeater driver"
-#define DRIVER_VERSION	"0.26"
+#define DRIVER_VERSION	"0.28"
 
 /* driver description structure */
 upsdrv_info_t upsdrv_info =
@@ -105,15 +105,46 @@ static int is_valid_data(const char* varname);
 static int is_valid_value(const char* varname, const char *value);
 /* libupsclient update */
 static int upsclient_update_vars(void);
+static void repeater_setvar(const char *varname, const char *val);
+static void repeater_unwatch(void);
+static void repeater_disconnect(void);
+static void repeater_update(void);
 
 /* connection information */
 static char		*client_upsname = NULL, *hostname = NULL;
-static UPSCONN_t	*ups = NULL;
+static UPSCONN_t	*ups = NULL;	/* from upscli_pool_connect() */
 static uint16_t	port;
+static int		repeater_flags = UPSCLI_CONN_TRYSSL;
 
 /* repeater mode parameters */
 static int repeater_disable_strict_start = 0;
 
+/* The repeater asks upsd to push the changes of the repeated device as
+ * they happen (WATCH), and only polls it with LIST VAR on every update
+ * cycle if this server can not do that */
+typedef enum {
+	WATCH_NONE = 0,		/* not asked yet, e.g. after a reconnection */
+	WATCH_ASKED,		/* WATCH sent, waiting for its answer */
+	WATCH_ACTIVE,		/* changes are pushed */
+	WATCH_UNSUPPORTED	/* older upsd: keep polling */
+} watch_state_t;
+
+static watch_state_t	watch_state = WATCH_NONE;
+static TYPE_FD		watch_fd = ERROR_FD;
+static PCONF_CTX_t	watch_ctx;
+static time_t		watch_last_list = 0, watch_last_heard = 0;
+static int		watch_in_list = 0;
+
+/* variables changed by the last poll, for adaptive polling */
+static int		repeater_changed = 0;
+
+/* A full LIST VAR on the watched connection now and then catches up
+ * with anything missed, and keeps upsd from shedding the otherwise
+ * idle client (after a minute). Not hearing from upsd for several of
+ * these intervals means the connection is lost. */
+#define WATCH_RESYNC_INTERVAL	30
+#define WATCH_LOST_INTERVAL	(3 * WATCH_RESYNC_INTERVAL)
+
 /* Driver functions */
 
 void upsdrv_initinfo(void)
@@ -158,18 +189,27 @@ void upsdrv_initinfo(void)
 				fatalx(EXIT_FAILURE, "Error: invalid UPS definition.\nRequired format: upsname[@hostname[:port]]");
 			}
 			/* Connect to the target */
-			ups = (UPSCONN_t *)xmalloc(sizeof(*ups));
 			{	/* scoping */
-				upscli_authconf_t	*ac_conn = NULL;
-				int	flags_ssl = UPSCLI_CONN_TRYSSL;
 				char	str_port[16];
+				const char	*user = NULL, *pass = NULL;
+				upscli_authconf_t	*repeater_ac;
 
-				ac_conn = upscli_get_authconf_item(NULL, hostname, snprintf(str_port, sizeof(str_port), "%" PRIu16, port) > 0 ? str_port : NULL, 1);
-				if (ac_conn && upscli_init_authconf(ac_conn) > 0) {
+				repeater_ac = upscli_get_authconf_item(NULL, hostname, snprintf(str_port, sizeof(str_port), "%" PRIu16, port) > 0 ? str_port : NULL, 1);
+				if (repeater_ac && upscli_init_authconf(repeater_ac) > 0) {
 					upscli_authconf_t	*ac_default = upscli_find_authconf_item(NULL, NULL, NULL);
-					upscli_authconf_update_conn_flags(ac_default, &flags_ssl);
+					upscli_authconf_update_conn_flags(ac_default, &repeater_flags);
+				}
+				if (repeater_ac && repeater_ac->user && repeater_ac->pass) {
+					upsdebugx(1, "%s: Using authentication from configuration file", __func__);
+					user = repeater_ac->user;
+					pass = repeater_ac->pass;
 				}
-				if (upscli_connect(ups, hostname, port, flags_ssl) < 0)
+
+				/* The pool (re)connects and authenticates the same way
+				 * whenever the connection was lost. It is the only one
+				 * to this server in this process, as it gets WATCHed. */
+				ups = upscli_pool_connect(hostname, port, repeater_flags, user, pass);
+				if (upscli_fd(ups) < 0)
 				{
 					if (repeater_disable_strict_start == 1)
 					{
@@ -187,12 +227,6 @@ void upsdrv_initinfo(void)
 				{
 					upsdebugx(1, "Connected to %s@%s", client_upsname, hostname);
 				}
-				if (ac_conn && ac_conn->user && ac_conn->pass) {
-					upsdebugx(1, "%s: Using authentication from configuration file", __func__);
-					if (upscli_authenticate_authconf(ups, ac_conn) < 0) {
-						fatalx(EXIT_FAILURE, "Error: %s", upscli_strerror(ups));
-					}
-				}
 			}
 			if (upsclient_update_vars() < 0)
 			{
@@ -287,11 +321,12 @@ void upsdrv_updateinfo(void)
 
 	upscli_upslog_set_debug_level(nut_debug_level, nut_common_cookie());
 
-	sleep(1);
-
 	switch (mode)
 	{
 		case MODE_DUMMY_LOOP:
+			/* less stress on the sys */
+			sleep(1);
+
 			/* Now get user's defined variables */
 			if (parse_data_file(upsfd) >= 0)
 				dstate_dataok();
@@ -299,6 +334,8 @@ void upsdrv_updateinfo(void)
 
 		case MODE_DUMMY_ONCE:
 			/* less stress on the sys */
+			sleep(1);
+
 			if (ctx == NULL && next_update == -1) {
 				struct stat	fs;
 				char fn[NUT_PATH_MAX + 1];
@@ -351,23 +388,7 @@ void upsdrv_updateinfo(void)
 
 		case MODE_META:
 		case MODE_REPEATER:
-			if (upsclient_update_vars() > 0)
-			{
-				dstate_dataok();
-			}
-			else
-			{
-				/* try to reconnect */
-				upscli_disconnect(ups);
-				if (upscli_connect(ups, hostname, port, UPSCLI_CONN_TRYSSL) < 0)
-				{
-					upsdebugx(1, "Error reconnecting: %s", upscli_strerror(ups));
-				}
-				else
-				{
-					upsdebugx(1, "Reconnected");
-				}
-			}
+			repeater_update();
 			break;
 
 		case MODE_NONE:
@@ -641,8 +662,8 @@ void upsdrv_initups(void)
 void upsdrv_cleanup(void)
 {
 	if (ups) {
-		upscli_disconnect(ups);
-		free(ups);
+		repeater_unwatch();
+		upscli_pool_release(ups);
 		ups = NULL;
 	}
 
@@ -662,6 +683,9 @@ void upsdrv_cleanup(void)
 		ctx = NULL;
 	}
 
+	if (watch_ctx.magic == PCONF_CTX_t_MAGIC)
+		pconf_finish(&watch_ctx);
+
 	upscli_cleanup();
 	upsdrv_callback_setproctag = NULL;
 }
@@ -766,13 +790,241 @@ static int upsclient_update_vars(void)
 		upsdebugx(5, "Received: %s %s %s %s",
 				answer[0], answer[1], answer[2], answer[3]);
 
-		/* do not override the driver collection */
-		if (strncmp(answer[2], "driver.", 7))
-			setvar(answer[2], answer[3]);
+		repeater_setvar(answer[2], answer[3]);
 	}
 	return 1;
 }
 
+/* apply a value of the repeated device, if it changed */
+static void repeater_setvar(const char *varname, const char *val)
+{
+	const char	*current;
+
+	/* do not override the driver collection */
+	if (!strncmp(varname, "driver.", 7))
+		return;
+
+	current = dstate_getinfo(varname);
+	if (current && !strcmp(current, val))
+		return;
+
+	upsdebugx(3, "%s: %s = %s", __func__, varname, val);
+	setvar(varname, val);
+	repeater_changed++;
+}
+
+/* the watched descriptor must be dropped before it is closed */
+static void repeater_unwatch(void)
+{
+	if (VALID_FD(watch_fd))
+		dstate_unregister_fd(watch_fd);
+
+	watch_fd = ERROR_FD;
+}
+
+/* the pool re-opens the connection with the next request */
+static void repeater_disconnect(void)
+{
+	repeater_unwatch();
+	watch_state = WATCH_NONE;
+	watch_in_list = 0;
+	upscli_disconnect(ups);
+}
+
+/* ask for a full list, the reply is handled as it comes */
+static void repeater_list(void)
+{
+	char	buf[UPSCLI_NETBUF_LEN];
+
+	snprintf(buf, sizeof(buf), "LIST VAR %s\n", client_upsname);
+	time(&watch_last_list);
+
+	if (upscli_sendline(ups, buf, strlen(buf)) < 0) {
+		upsdebugx(1, "%s: %s", __func__, upscli_strerror(ups));
+		repeater_disconnect();
+		dstate_datastale();
+	}
+}
+
+/* one line from a watched connection: a pushed change, or a part of
+ * the answer to WATCH or LIST VAR */
+static void repeater_watch_line(const char *line)
+{
+	size_t	numargs;
+	char	**arg;
+
+	upsdebugx(5, "%s: %s", __func__, line);
+
+	if (!pconf_line(&watch_ctx, line) || pconf_parse_error(&watch_ctx)) {
+		upsdebugx(1, "%s: parse error: %s", __func__, watch_ctx.errmsg);
+		return;
+	}
+
+	numargs = watch_ctx.numargs;
+	arg = watch_ctx.arglist;
+
+	if (numargs < 1)
+		return;
+
+	if (watch_state == WATCH_ASKED) {
+		if (!strcmp(arg[0], "OK")) {
+			upsdebugx(1, "Watching %s@%s", client_upsname, hostname);
+			watch_state = WATCH_ACTIVE;
+			/* what changed before the WATCH is not pushed */
+			repeater_list();
+			return;
+		}
+
+		if (!strcmp(arg[0], "ERR")) {
+			upslogx(LOG_INFO, "%s does not push changes (%s), polling it instead",
+				hostname, numargs > 1 ? arg[1] : "?");
+			repeater_unwatch();
+			watch_state = WATCH_UNSUPPORTED;
+			return;
+		}
+	}
+
+	/* NOTIFY VAR <upsname> <varname> <value> (etc.) */
+	if (!strcmp(arg[0], "NOTIFY")) {
+		if (numargs < 3 || strcasecmp(arg[2], client_upsname))
+			return;
+
+		if (!strcmp(arg[1], "VAR") && numargs >= 5) {
+			repeater_setvar(arg[3], arg[4]);
+		} else if (!strcmp(arg[1], "DELVAR") && numargs >= 4) {
+			if (strncmp(arg[3], "driver.", 7))
+				dstate_delinfo(arg[3]);
+		} else if (!strcmp(arg[1], "DATASTALE")) {
+			dstate_datastale();
+		} else if (!strcmp(arg[1], "DATAOK")) {
+			/* the driver there may have been restarted */
+			repeater_list();
+		}
+		return;
+	}
+
+	/* the answer to LIST VAR, interleaved with the above */
+	if (!strcmp(arg[0], "BEGIN")) {
+		watch_in_list = 1;
+		return;
+	}
+
+	if (!strcmp(arg[0], "VAR") && numargs >= 4) {
+		if (!strcasecmp(arg[1], client_upsname))
+			repeater_setvar(arg[2], arg[3]);
+		return;
+	}
+
+	if (!strcmp(arg[0], "END")) {
+		watch_in_list = 0;
+		dstate_dataok();
+		return;
+	}
+
+	if (!strcmp(arg[0], "ERR")) {
+		upsdebugx(1, "%s: %s@%s: %s", __func__, client_upsname, hostname,
+			numargs > 1 ? arg[1] : "?");
+		watch_in_list = 0;
+		dstate_datastale();
+	}
+}
+
+/* called from the driver main loop as soon as upsd pushed something */
+static int repeater_watch_fd(TYPE_FD fd, void *arg)
+{
+	char	buf[UPSCLI_NETBUF_LEN];
+
+	NUT_UNUSED_VARIABLE(fd);
+	NUT_UNUSED_VARIABLE(arg);
+
+	/* Lines are read whole (upsd writes them so), and until none is
+	 * left in the buffer of libupsclient, which the main loop does
+	 * not know about */
+	do {
+		if (upscli_readline_timeout_may_disconnect(ups, buf, sizeof(buf),
+			DEFAULT_NETWORK_TIMEOUT, 0) < 0
+		) {
+			upslogx(LOG_WARNING, "Lost connection to %s@%s: %s",
+				client_upsname, hostname, upscli_strerror(ups));
+			repeater_disconnect();
+			dstate_datastale();
+			/* wake the main loop, which reconnects */
+			return 1;
+		}
+
+		time(&watch_last_heard);
+		repeater_watch_line(buf);
+	} while (watch_state != WATCH_NONE && upscli_pending(ups) > 0);
+
+	return 0;
+}
+
+static void repeater_watch(void)
+{
+	char	buf[UPSCLI_NETBUF_LEN];
+
+	if (watch_state != WATCH_NONE)
+		return;
+
+#ifndef WIN32
+	watch_fd = upscli_fd(ups);
+#endif	/* !WIN32 */
+
+	/* not on Windows yet */
+	if (dstate_register_fd(watch_fd, repeater_watch_fd, NULL) < 0) {
+		watch_fd = ERROR_FD;
+		watch_state = WATCH_UNSUPPORTED;
+		return;
+	}
+
+	if (watch_ctx.magic != PCONF_CTX_t_MAGIC)
+		pconf_init(&watch_ctx, NULL);
+
+	snprintf(buf, sizeof(buf), "WATCH %s\n", client_upsname);
+	time(&watch_last_heard);
+	watch_last_list = watch_last_heard;
+	watch_state = WATCH_ASKED;
+
+	if (upscli_sendline(ups, buf, strlen(buf)) < 0) {
+		upsdebugx(1, "%s: %s", __func__, upscli_strerror(ups));
+		repeater_disconnect();
+	}
+}
+
+static void repeater_update(void)
+{
+	time_t	now;
+
+	if (watch_state == WATCH_ASKED || watch_state == WATCH_ACTIVE) {
+		/* changes are applied as they come */
+		time(&now);
+		if (difftime(now, watch_last_heard) > WATCH_LOST_INTERVAL) {
+			upslogx(LOG_WARNING, "No news from %s@%s, reconnecting",
+				client_upsname, hostname);
+			repeater_disconnect();
+			dstate_datastale();
+		} else if (!watch_in_list && difftime(now, watch_last_list) >= WATCH_RESYNC_INTERVAL) {
+			repeater_list();
+		}
+		poll_report_changes(0);
+		return;
+	}
+
+	repeater_changed = 0;
+	if (upsclient_update_vars() > 0) {
+		dstate_dataok();
+		poll_report_changes(repeater_changed > 0);
+		repeater_watch();
+		return;
+	}
+
+	/* reconnect with the next update */
+	upsdebugx(1, "Error updating from %s@%s: %s",
+		client_upsname, hostname, upscli_strerror(ups));
+	repeater_disconnect();
+	dstate_datastale();
+}
+
 /* find info element definition in info array */
 static dummy_info_t *find_info(const char *varname)
 {
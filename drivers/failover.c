@@ -27,7 +27,7 @@
 #include "upsdrvquery.h"
 
 #define DRIVER_NAME      "UPS Failover Driver"
-#define DRIVER_VERSION   "0.02"
+#define DRIVER_VERSION   "0.03"
 
 upsdrv_info_t upsdrv_info = {
 	DRIVER_NAME,
@@ -95,11 +95,19 @@ static void ups_demote_primary(ups_device_t *ups);
 static void ups_export_dstate(ups_device_t *ups);
 static void ups_clean_dstate(const ups_device_t *ups);
 
-static int ups_get_cmd_pos(const ups_device_t *ups, const char *cmd);
+static ups_cmd_t *ups_find_cmd(const ups_device_t *ups, const char *cmd);
+static void ups_index_cmd(ups_device_t *ups, ups_cmd_t *cmd);
+static void ups_unindex_cmd(ups_device_t *ups, const ups_cmd_t *cmd);
+static void ups_cmd_needs_export(ups_device_t *ups, ups_cmd_t *cmd);
+static void ups_export_cmd(const ups_device_t *ups, const ups_cmd_t *cmd);
 static int ups_add_cmd(ups_device_t *ups, const char *val);
 static int ups_del_cmd(ups_device_t *ups, const char *val);
 
-static int ups_get_var_pos(const ups_device_t *ups, const char *key);
+static ups_var_t *ups_find_var(const ups_device_t *ups, const char *key);
+static void ups_index_var(ups_device_t *ups, ups_var_t *var);
+static void ups_unindex_var(ups_device_t *ups, const ups_var_t *var);
+static void ups_var_needs_export(ups_device_t *ups, ups_var_t *var);
+static void ups_export_var(const ups_device_t *ups, const ups_var_t *var);
 static int ups_set_var(ups_device_t *ups, const char *key, const char *value);
 static int ups_del_var(ups_device_t *ups, const char *key);
 static int ups_set_var_flags(ups_device_t *ups, const char *key, const int flag);
@@ -419,7 +427,7 @@ static int instcmd(const char *cmdname, const char *extra)
 		return STAT_INSTCMD_FAILED;
 	}
 
-	if(ups_get_cmd_pos(primary_ups, cmdname) >= 0) {
+	if(ups_find_cmd(primary_ups, cmdname)) {
 		const char *cmd = NULL;
 		char msgbuf[SMALLBUF];
 		struct timeval tv;
@@ -486,7 +494,7 @@ static int setvar(const char *varname, const char *val)
 		return STAT_SET_FAILED;
 	}
 
-	if(ups_get_var_pos(primary_ups, varname) >= 0) {
+	if(ups_find_var(primary_ups, varname)) {
 		const char *var = NULL;
 		char msgbuf[SMALLBUF];
 		struct timeval tv;
@@ -1580,86 +1588,104 @@ static void ups_demote_primary(ups_device_t *ups)
 static void ups_export_dstate(ups_device_t *ups)
 {
 	size_t i = 0;
+	ups_cmd_t *cmd = NULL;
+	ups_var_t *var = NULL;
 
 	if (ups->force_dstate_export) {
 		status_init();
 		alarm_init();
-	}
-
-	for (i = 0; i < ups->cmd_count; ++i) {
-		ups_cmd_t *cmd = ups->cmd_list[i];
 
-		if (cmd->needs_export || ups->force_dstate_export) {
-			dstate_addcmd(cmd->value);
+		for (i = 0; i < ups->cmd_count; ++i) {
+			ups_export_cmd(ups, ups->cmd_list[i]);
+		}
 
-			upsdebugx(5, "%s: [%s]: exported command to dstate: [%s]",
-				__func__, ups->socketname, cmd->value);
+		for (i = 0; i < ups->var_count; ++i) {
+			ups_export_var(ups, ups->var_list[i]);
+		}
+	} else {
+		for (cmd = ups->cmd_export; cmd; cmd = cmd->export_next) {
+			ups_export_cmd(ups, cmd);
+		}
 
-			cmd->needs_export = 0;
+		for (var = ups->var_export; var; var = var->export_next) {
+			ups_export_var(ups, var);
 		}
 	}
 
-	for (i = 0; i < ups->var_count; ++i) {
-		ups_var_t *var = ups->var_list[i];
-
-		if (var->needs_export || ups->force_dstate_export) {
-			size_t j = 0;
+	for (cmd = ups->cmd_export; cmd; cmd = cmd->export_next) {
+		cmd->needs_export = 0;
+	}
+	ups->cmd_export = NULL;
 
-			if (!strcmp(var->key, "ups.alarm")) {
-				alarm_init();
-				alarm_set(var->value);
-				alarm_commit();
-				status_commit(); /* publish ALARM */
-				upsdebugx(5, "%s: [%s]: exported UPS alarm to dstate: [%s] : [%s]",
-					__func__, ups->socketname, var->key, var->value);
-			}
-			else if (!strcmp(var->key, "ups.status")) {
-				status_init();
-				status_set(var->value);
-				status_commit();
-				upsdebugx(5, "%s: [%s]: exported UPS status to dstate: [%s] : [%s]",
-					__func__, ups->socketname, var->key, var->value);
-			}
-			else {
-				dstate_setinfo(var->key, "%s", var->value);
-				upsdebugx(5, "%s: [%s]: exported variable to dstate: [%s] : [%s]",
-					__func__, ups->socketname, var->key, var->value);
-			}
+	for (var = ups->var_export; var; var = var->export_next) {
+		var->needs_export = 0;
+	}
+	ups->var_export = NULL;
 
-			if (var->flags) {
-				dstate_setflags(var->key, var->flags);
-				upsdebugx(5, "%s: [%s]: exported variable flags to dstate: [%s] : [%d]",
-					__func__, ups->socketname, var->key, var->flags);
-			}
+	if (ups->force_dstate_export) {
+		alarm_commit();
+		status_commit();
+	}
 
-			if (var->aux) {
-				dstate_setaux(var->key, var->aux);
-				upsdebugx(5, "%s: [%s]: exported variable aux to dstate: [%s] : [%ld]",
-					__func__, ups->socketname, var->key, var->aux);
-			}
+	ups->force_dstate_export = 0;
+}
 
-			for (j = 0; j < var->enum_count; ++j) {
-				dstate_addenum(var->key, "%s", var->enum_list[j]);
-				upsdebugx(5, "%s: [%s]: exported variable enum to dstate: [%s] : [%s]",
-					__func__, ups->socketname, var->key, var->enum_list[j]);
-			}
+static void ups_export_cmd(const ups_device_t *ups, const ups_cmd_t *cmd)
+{
+	dstate_addcmd(cmd->value);
 
-			for (j = 0; j < var->range_count; ++j) {
-				dstate_addrange(var->key, var->range_list[j]->min, var->range_list[j]->max);
-				upsdebugx(5, "%s: [%s]: exported variable range to dstate: [%s] : min=[%d] : max=[%d]",
-					__func__, ups->socketname, var->key, var->range_list[j]->min, var->range_list[j]->max);
-			}
+	upsdebugx(5, "%s: [%s]: exported command to dstate: [%s]",
+		__func__, ups->socketname, cmd->value);
+}
 
-			var->needs_export = 0;
-		}
-	}
+static void ups_export_var(const ups_device_t *ups, const ups_var_t *var)
+{
+	size_t j = 0;
 
-	if (ups->force_dstate_export) {
+	if (!strcmp(var->key, "ups.alarm")) {
+		alarm_init();
+		alarm_set(var->value);
 		alarm_commit();
+		status_commit(); /* publish ALARM */
+		upsdebugx(5, "%s: [%s]: exported UPS alarm to dstate: [%s] : [%s]",
+			__func__, ups->socketname, var->key, var->value);
+	}
+	else if (!strcmp(var->key, "ups.status")) {
+		status_init();
+		status_set(var->value);
 		status_commit();
+		upsdebugx(5, "%s: [%s]: exported UPS status to dstate: [%s] : [%s]",
+			__func__, ups->socketname, var->key, var->value);
+	}
+	else {
+		dstate_setinfo(var->key, "%s", var->value);
+		upsdebugx(5, "%s: [%s]: exported variable to dstate: [%s] : [%s]",
+			__func__, ups->socketname, var->key, var->value);
 	}
 
-	ups->force_dstate_export = 0;
+	if (var->flags) {
+		dstate_setflags(var->key, var->flags);
+		upsdebugx(5, "%s: [%s]: exported variable flags to dstate: [%s] : [%d]",
+			__func__, ups->socketname, var->key, var->flags);
+	}
+
+	if (var->aux) {
+		dstate_setaux(var->key, var->aux);
+		upsdebugx(5, "%s: [%s]: exported variable aux to dstate: [%s] : [%ld]",
+			__func__, ups->socketname, var->key, var->aux);
+	}
+
+	for (j = 0; j < var->enum_count; ++j) {
+		dstate_addenum(var->key, "%s", var->enum_list[j]);
+		upsdebugx(5, "%s: [%s]: exported variable enum to dstate: [%s] : [%s]",
+			__func__, ups->socketname, var->key, var->enum_list[j]);
+	}
+
+	for (j = 0; j < var->range_count; ++j) {
+		dstate_addrange(var->key, var->range_list[j]->min, var->range_list[j]->max);
+		upsdebugx(5, "%s: [%s]: exported variable range to dstate: [%s] : min=[%d] : max=[%d]",
+			__func__, ups->socketname, var->key, var->range_list[j]->min, var->range_list[j]->max);
+	}
 }
 
 static void ups_clean_dstate(const ups_device_t *ups)
@@ -1685,24 +1711,97 @@ static void ups_clean_dstate(const ups_device_t *ups)
 	status_commit();
 }
 
-static int ups_get_cmd_pos(const ups_device_t *ups, const char *cmd)
+/* Bucket of the var_hash and cmd_hash indexes */
+static size_t ups_index_hash(const char *key, size_t size)
 {
-	size_t i = 0;
+	return str_hash_fnv1a(key, 0) & (size - 1);
+}
+
+static ups_cmd_t *ups_find_cmd(const ups_device_t *ups, const char *cmd)
+{
+	ups_cmd_t *entry = NULL;
+
+	if (!ups->cmd_hash) {
+		return NULL;
+	}
+
+	for (entry = ups->cmd_hash[ups_index_hash(cmd, ups->cmd_hash_size)]; entry; entry = entry->hash_next) {
+		if (!strcmp(entry->value, cmd)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* Add a command (already in cmd_list) to cmd_hash, growing it as needed */
+static void ups_index_cmd(ups_device_t *ups, ups_cmd_t *cmd)
+{
+	size_t i = 0, bucket = 0;
+
+	if (ups->cmd_hash && ups->cmd_count <= ups->cmd_hash_size) {
+		bucket = ups_index_hash(cmd->value, ups->cmd_hash_size);
+		cmd->hash_next = ups->cmd_hash[bucket];
+		ups->cmd_hash[bucket] = cmd;
+
+		return;
+	}
+
+	if (!ups->cmd_hash_size) {
+		ups->cmd_hash_size = INDEX_MIN_BUCKETS;
+	}
+	while (ups->cmd_hash_size < ups->cmd_count) {
+		ups->cmd_hash_size *= 2;
+	}
+
+	free(ups->cmd_hash);
+	ups->cmd_hash = (ups_cmd_t **)xcalloc(ups->cmd_hash_size, sizeof(*ups->cmd_hash));
 
 	for (i = 0; i < ups->cmd_count; ++i) {
-		if (!strcmp(ups->cmd_list[i]->value, cmd)) {
-			return i;
+		bucket = ups_index_hash(ups->cmd_list[i]->value, ups->cmd_hash_size);
+		ups->cmd_list[i]->hash_next = ups->cmd_hash[bucket];
+		ups->cmd_hash[bucket] = ups->cmd_list[i];
+	}
+}
+
+static void ups_unindex_cmd(ups_device_t *ups, const ups_cmd_t *cmd)
+{
+	ups_cmd_t **link = &ups->cmd_hash[ups_index_hash(cmd->value, ups->cmd_hash_size)];
+
+	while (*link && *link != cmd) {
+		link = &(*link)->hash_next;
+	}
+
+	if (*link) {
+		*link = cmd->hash_next;
+	}
+
+	if (cmd->needs_export) {
+		link = &ups->cmd_export;
+		while (*link && *link != cmd) {
+			link = &(*link)->export_next;
+		}
+
+		if (*link) {
+			*link = cmd->export_next;
 		}
 	}
+}
 
-	return -1;
+static void ups_cmd_needs_export(ups_device_t *ups, ups_cmd_t *cmd)
+{
+	if (!cmd->needs_export) {
+		cmd->needs_export = 1;
+		cmd->export_next = ups->cmd_export;
+		ups->cmd_export = cmd;
+	}
 }
 
 static int ups_add_cmd(ups_device_t *ups, const char *val)
 {
 	ups_cmd_t *new_cmd = NULL;
 
-	if (ups_get_cmd_pos(ups, val) >= 0) {
+	if (ups_find_cmd(ups, val)) {
 		return 0;
 	}
 
@@ -1714,11 +1813,14 @@ static int ups_add_cmd(ups_device_t *ups, const char *val)
 
 	new_cmd = (ups_cmd_t *)xcalloc(1, sizeof(**ups->cmd_list));
 	new_cmd->value = xstrdup(val);
-	new_cmd->needs_export = 1;
+	new_cmd->pos = ups->cmd_count;
 
 	ups->cmd_list[ups->cmd_count] = new_cmd;
 	ups->cmd_count++;
 
+	ups_index_cmd(ups, new_cmd);
+	ups_cmd_needs_export(ups, new_cmd);
+
 	upsdebugx(5, "%s: [%s]: added to ups->cmd_list: [%s]",
 		__func__, ups->socketname, val);
 
@@ -1727,11 +1829,10 @@ static int ups_add_cmd(ups_device_t *ups, const char *val)
 
 static int ups_del_cmd(ups_device_t *ups, const char *val)
 {
-	int cmd_pos = ups_get_cmd_pos(ups, val);
+	ups_cmd_t *cmd = ups_find_cmd(ups, val);
 
-	if (cmd_pos >= 0) {
-		ups_cmd_t *cmd = ups->cmd_list[cmd_pos];
-		size_t i = 0;
+	if (cmd) {
+		size_t cmd_pos = cmd->pos;
 
 		if (primary_ups == ups) {
 			dstate_delcmd(val);
@@ -1740,15 +1841,18 @@ static int ups_del_cmd(ups_device_t *ups, const char *val)
 				__func__, ups->socketname, val);
 		}
 
+		ups_unindex_cmd(ups, cmd);
 		free(cmd->value);
 		free(cmd);
 
-		for (i = cmd_pos; i < ups->cmd_count - 1; ++i) {
-			ups->cmd_list[i] = ups->cmd_list[i + 1];
+		/* Order does not matter, fill the gap with the last one */
+		ups->cmd_count--;
+		if (cmd_pos < ups->cmd_count) {
+			ups->cmd_list[cmd_pos] = ups->cmd_list[ups->cmd_count];
+			ups->cmd_list[cmd_pos]->pos = cmd_pos;
 		}
 
-		ups->cmd_list[ups->cmd_count - 1] = NULL;
-		ups->cmd_count--;
+		ups->cmd_list[ups->cmd_count] = NULL;
 
 		if (ups->cmd_count == 0) {
 			free(ups->cmd_list);
@@ -1772,31 +1876,97 @@ static int ups_del_cmd(ups_device_t *ups, const char *val)
 	return 0;
 }
 
-static int ups_get_var_pos(const ups_device_t *ups, const char *key)
+static ups_var_t *ups_find_var(const ups_device_t *ups, const char *key)
 {
-	size_t i = 0;
+	ups_var_t *entry = NULL;
+
+	if (!ups->var_hash) {
+		return NULL;
+	}
+
+	for (entry = ups->var_hash[ups_index_hash(key, ups->var_hash_size)]; entry; entry = entry->hash_next) {
+		if (!strcmp(entry->key, key)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* Add a variable (already in var_list) to var_hash, growing it as needed */
+static void ups_index_var(ups_device_t *ups, ups_var_t *var)
+{
+	size_t i = 0, bucket = 0;
+
+	if (ups->var_hash && ups->var_count <= ups->var_hash_size) {
+		bucket = ups_index_hash(var->key, ups->var_hash_size);
+		var->hash_next = ups->var_hash[bucket];
+		ups->var_hash[bucket] = var;
+
+		return;
+	}
+
+	if (!ups->var_hash_size) {
+		ups->var_hash_size = INDEX_MIN_BUCKETS;
+	}
+	while (ups->var_hash_size < ups->var_count) {
+		ups->var_hash_size *= 2;
+	}
+
+	free(ups->var_hash);
+	ups->var_hash = (ups_var_t **)xcalloc(ups->var_hash_size, sizeof(*ups->var_hash));
 
 	for (i = 0; i < ups->var_count; ++i) {
-		if (!strcmp(ups->var_list[i]->key, key)) {
-			return i;
+		bucket = ups_index_hash(ups->var_list[i]->key, ups->var_hash_size);
+		ups->var_list[i]->hash_next = ups->var_hash[bucket];
+		ups->var_hash[bucket] = ups->var_list[i];
+	}
+}
+
+static void ups_unindex_var(ups_device_t *ups, const ups_var_t *var)
+{
+	ups_var_t **link = &ups->var_hash[ups_index_hash(var->key, ups->var_hash_size)];
+
+	while (*link && *link != var) {
+		link = &(*link)->hash_next;
+	}
+
+	if (*link) {
+		*link = var->hash_next;
+	}
+
+	if (var->needs_export) {
+		link = &ups->var_export;
+		while (*link && *link != var) {
+			link = &(*link)->export_next;
+		}
+
+		if (*link) {
+			*link = var->export_next;
 		}
 	}
+}
 
-	return -1;
+static void ups_var_needs_export(ups_device_t *ups, ups_var_t *var)
+{
+	if (!var->needs_export) {
+		var->needs_export = 1;
+		var->export_next = ups->var_export;
+		ups->var_export = var;
+	}
 }
 
 static int ups_set_var(ups_device_t *ups, const char *key, const char *value)
 {
 	ups_var_t *new_var = NULL;
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 
 		if (strcmp(var->value, value)) {
 			free(var->value);
 			var->value = xstrdup(value);
-			var->needs_export = 1;
+			ups_var_needs_export(ups, var);
 
 			upsdebugx(5, "%s: [%s]: updated in ups->var_list: [%s] : [%s]",
 				__func__, ups->socketname, key, value);
@@ -1819,11 +1989,14 @@ static int ups_set_var(ups_device_t *ups, const char *key, const char *value)
 	new_var = (ups_var_t *)xcalloc(1, sizeof(**ups->var_list));
 	new_var->key = xstrdup(key);
 	new_var->value = xstrdup(value);
-	new_var->needs_export = 1;
+	new_var->pos = ups->var_count;
 
 	ups->var_list[ups->var_count] = new_var;
 	ups->var_count++;
 
+	ups_index_var(ups, new_var);
+	ups_var_needs_export(ups, new_var);
+
 	upsdebugx(5, "%s: [%s]: stored in ups->var_list: [%s] : [%s]",
 		__func__, ups->socketname, key, value);
 
@@ -1832,11 +2005,10 @@ static int ups_set_var(ups_device_t *ups, const char *key, const char *value)
 
 static int ups_del_var(ups_device_t *ups, const char *key)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
-		size_t i = 0;
+	if (var) {
+		size_t var_pos = var->pos;
 
 		if (primary_ups == ups) {
 			if (!strcmp(key, "ups.alarm")) {
@@ -1861,15 +2033,18 @@ static int ups_del_var(ups_device_t *ups, const char *key)
 				__func__, ups->socketname, key);
 		}
 
+		ups_unindex_var(ups, var);
 		ups_free_var_state(var);
 		free(var);
 
-		for (i = var_pos; i < ups->var_count - 1; ++i) {
-			ups->var_list[i] = ups->var_list[i + 1];
+		/* Order does not matter, fill the gap with the last one */
+		ups->var_count--;
+		if (var_pos < ups->var_count) {
+			ups->var_list[var_pos] = ups->var_list[ups->var_count];
+			ups->var_list[var_pos]->pos = var_pos;
 		}
 
-		ups->var_list[ups->var_count - 1] = NULL;
-		ups->var_count--;
+		ups->var_list[ups->var_count] = NULL;
 
 		if (ups->var_count == 0) {
 			free(ups->var_list);
@@ -1895,10 +2070,9 @@ static int ups_del_var(ups_device_t *ups, const char *key)
 
 static int ups_set_var_flags(ups_device_t *ups, const char *key, const int flags)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 
 		if (var->flags == flags) {
 			upsdebugx(6, "%s: [%s]: unchanged flags in ups->var_list: [%s] : [%d]",
@@ -1908,7 +2082,7 @@ static int ups_set_var_flags(ups_device_t *ups, const char *key, const int flags
 		}
 
 		var->flags = flags;
-		var->needs_export = 1;
+		ups_var_needs_export(ups, var);
 
 		upsdebugx(5, "%s: [%s]: stored flags in ups->var_list: [%s] : [%d]",
 			__func__, ups->socketname, key, flags);
@@ -1924,10 +2098,9 @@ static int ups_set_var_flags(ups_device_t *ups, const char *key, const int flags
 
 static int ups_set_var_aux(ups_device_t *ups, const char *key, const long aux)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 
 		if (var->aux == aux) {
 			upsdebugx(6, "%s: [%s]: unchanged aux in ups->var_list: [%s] : [%ld]",
@@ -1937,7 +2110,7 @@ static int ups_set_var_aux(ups_device_t *ups, const char *key, const long aux)
 		}
 
 		var->aux = aux;
-		var->needs_export = 1;
+		ups_var_needs_export(ups, var);
 
 		upsdebugx(5, "%s: [%s]: stored aux in ups->var_list: [%s] : [%ld]",
 			__func__, ups->socketname, key, aux);
@@ -1953,11 +2126,10 @@ static int ups_set_var_aux(ups_device_t *ups, const char *key, const long aux)
 
 static int ups_add_range(ups_device_t *ups, const char *key, const int min, const int max)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
+	if (var) {
 		var_range_t *new_range = NULL;
-		ups_var_t *var = ups->var_list[var_pos];
 		size_t i = 0;
 
 		for (i = 0; i < var->range_count; ++i) {
@@ -1981,7 +2153,7 @@ static int ups_add_range(ups_device_t *ups, const char *key, const int min, cons
 
 		var->range_list[var->range_count] = new_range;
 		var->range_count++;
-		var->needs_export = 1;
+		ups_var_needs_export(ups, var);
 
 		upsdebugx(5, "%s: [%s]: added to ups->var_list->range_list: [%s] : min=[%d] : max=[%d]",
 			__func__, ups->socketname, key, min, max);
@@ -1997,10 +2169,9 @@ static int ups_add_range(ups_device_t *ups, const char *key, const int min, cons
 
 static int ups_del_range(ups_device_t *ups, const char *key, const int min, const int max)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 		size_t i = 0;
 
 		for (i = 0; i < var->range_count; ++i) {
@@ -2049,10 +2220,9 @@ static int ups_del_range(ups_device_t *ups, const char *key, const int min, cons
 
 static int ups_add_enum(ups_device_t *ups, const char *key, const char *val)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 		size_t i = 0;
 
 		for (i = 0; i < var->enum_count; ++i) {
@@ -2070,7 +2240,7 @@ static int ups_add_enum(ups_device_t *ups, const char *key, const char *val)
 		var->enum_list[var->enum_count] = xstrdup(val);
 
 		var->enum_count++;
-		var->needs_export = 1;
+		ups_var_needs_export(ups, var);
 
 		upsdebugx(5, "%s: [%s]: added to ups->var_list->enum_list: [%s] : [%s]",
 			__func__, ups->socketname, key, val);
@@ -2086,10 +2256,9 @@ static int ups_add_enum(ups_device_t *ups, const char *key, const char *val)
 
 static int ups_del_enum(ups_device_t *ups, const char *key, const char *val)
 {
-	int var_pos = ups_get_var_pos(ups, key);
+	ups_var_t *var = ups_find_var(ups, key);
 
-	if (var_pos >= 0) {
-		ups_var_t *var = ups->var_list[var_pos];
+	if (var) {
 		size_t i = 0;
 
 		for (i = 0; i < var->enum_count; ++i) {
@@ -2201,6 +2370,11 @@ static void ups_free_ups_state(ups_device_t *ups)
 		ups->var_allocs = 0;
 	}
 
+	free(ups->var_hash);
+	ups->var_hash = NULL;
+	ups->var_hash_size = 0;
+	ups->var_export = NULL;
+
 	if (ups->cmd_list) {
 		for (i = 0; i < ups->cmd_count; ++i) {
 			if (ups->cmd_list[i]) {
@@ -2219,6 +2393,11 @@ static void ups_free_ups_state(ups_device_t *ups)
 		ups->cmd_allocs = 0;
 	}
 
+	free(ups->cmd_hash);
+	ups->cmd_hash = NULL;
+	ups->cmd_hash_size = 0;
+	ups->cmd_export = NULL;
+
 	if (ups->status) {
 		free(ups->status);
 		ups->status = NULL;
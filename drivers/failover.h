@@ -30,6 +30,7 @@
 #define VAR_ALLOC_BATCH      50
 #define SUBVAR_ALLOC_BATCH   10
 #define CMD_ALLOC_BATCH      20
+#define INDEX_MIN_BUCKETS    64
 #define CONN_READ_TIMEOUT     3
 #define CONN_CMD_TIMEOUT      3
 #define ALARM_PROPAG_TIME    15
@@ -67,7 +68,7 @@ typedef struct {
 	int max;
 } var_range_t;
 
-typedef struct {
+typedef struct ups_var_s {
 	char *key;
 	char *value;
 
@@ -83,11 +84,19 @@ typedef struct {
 
 	int flags;
 	int needs_export;
+
+	size_t pos;                       /* index in var_list */
+	struct ups_var_s *hash_next;      /* next in the same var_hash bucket */
+	struct ups_var_s *export_next;    /* next in var_export */
 } ups_var_t;
 
-typedef struct {
+typedef struct ups_cmd_s {
 	char *value;
 	int needs_export;
+
+	size_t pos;                       /* index in cmd_list */
+	struct ups_cmd_s *hash_next;      /* next in the same cmd_hash bucket */
+	struct ups_cmd_s *export_next;    /* next in cmd_export */
 } ups_cmd_t;
 
 typedef struct {
@@ -118,6 +127,16 @@ typedef struct {
 	size_t cmd_count;
 	size_t cmd_allocs;
 
+	/* var_list and cmd_list indexed by name */
+	ups_var_t **var_hash;
+	ups_cmd_t **cmd_hash;
+	size_t var_hash_size;
+	size_t cmd_hash_size;
+
+	/* entries with needs_export set, i.e. changed since the last export */
+	ups_var_t *var_export;
+	ups_cmd_t *cmd_export;
+
 	char *status;
 
 	time_t last_heard_time;
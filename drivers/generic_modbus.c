@@ -22,6 +22,7 @@
 
 #include "main.h"
 #include "generic_modbus.h"
+#include "modbus-plan.h"
 #include <modbus.h>
 #include "timehead.h"
 #include "nut_stdint.h"
@@ -31,12 +32,13 @@
 #endif
 
 #define DRIVER_NAME	"NUT Generic Modbus driver (libmodbus link type: " NUT_MODBUS_LINKTYPE_STR ")"
-#define DRIVER_VERSION	"0.11"
+#define DRIVER_VERSION	"0.12"
 
 /* variables */
 static modbus_t *mbctx = NULL;                             /* modbus memory context */
 static sigattr_t sigar[NUMOF_SIG_STATES];                  /* array of ups signal attributes */
 static int errcnt = 0;                                     /* modbus access error counter */
+static modbus_plan_t *readplan = NULL;                     /* block reads of all signals per update */
 
 static char *device_mfr = DEVICE_MFR;                      /* device manufacturer */
 static char *device_model = DEVICE_MODEL;                  /* device model */
@@ -60,6 +62,9 @@ modbus_t *modbus_new(const char *port);
 /* reconnect upon communication error */
 void modbus_reconnect(void);
 
+/* raw block read for the read planner */
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest);
+
 /* modbus register read function */
 int register_read(modbus_t *mb, int addr, regtype_t type, void *data);
 
@@ -177,6 +182,25 @@ void upsdrv_initups(void)
 	}
 /* #elif (defined NUT_MODBUS_TIMEOUT_ARG_timeval) // some un-castable type in fields */
 #endif /* NUT_MODBUS_TIMEOUT_ARG_* */
+
+	/* read all mapped status signals with as few requests as possible
+	 * (regtype_t values are in the same order as modbus_plan_type_t) */
+	readplan = modbus_plan_new(plan_read, NULL);
+	modbus_plan_configure(readplan, getval(MODBUS_PLAN_VAR_MAX_REGISTERS),
+		getval(MODBUS_PLAN_VAR_MAX_BITS), getval(MODBUS_PLAN_VAR_MAX_GAP));
+	{ /* scoping */
+		int i;
+
+		for (i = OL_T; i <= DISCHRG_T; i++) {
+			if (sigar[i].addr != NOTUSED
+			 && modbus_plan_add(readplan, (modbus_plan_type_t)sigar[i].type, sigar[i].addr, 1) < 0
+			) {
+				upsdebugx(1, "signal %d register 0x%x is not coalesced", i, (unsigned int)sigar[i].addr);
+			}
+		}
+	}
+	upsdebugx(2, "status signals are read with %" PRIuSIZE " requests",
+		modbus_plan_blocks(readplan));
 }
 
 /* update UPS signal state */
@@ -187,6 +211,11 @@ void upsdrv_updateinfo(void)
 	errcnt = 0;
 
 	upsdebugx(2, "upsdrv_updateinfo");
+
+	/* fetch all signals in bulk, get_signal_state() reads from there
+	 * (and falls back to single reads for anything that failed) */
+	modbus_plan_refresh(readplan);
+
 	status_init();      /* initialize ups.status update */
 	alarm_init();       /* initialize ups.alarm update */
 
@@ -366,6 +395,9 @@ void upsdrv_makevartable(void)
 	addvar(VAR_VALUE, "mod_resp_to_us", "modbus response timeout (us)");
 	addvar(VAR_VALUE, "mod_byte_to_s", "modbus byte timeout (s)");
 	addvar(VAR_VALUE, "mod_byte_to_us", "modbus byte timeout (us)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_REGISTERS, "modbus registers read with one request at most (1-125)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_BITS, "modbus coils or inputs read with one request at most (1-2000)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_GAP, "unused modbus addresses read to merge two requests");
 	addvar(VAR_VALUE, "OL_addr", "modbus address for OL state");
 	addvar(VAR_VALUE, "OB_addr", "modbus address for OB state");
 	addvar(VAR_VALUE, "LB_addr", "modbus address for LB state");
@@ -396,6 +428,9 @@ void upsdrv_makevartable(void)
 /* close modbus connection and free modbus context allocated memory */
 void upsdrv_cleanup(void)
 {
+	modbus_plan_free(readplan);
+	readplan = NULL;
+
 	if (mbctx != NULL) {
 		modbus_close(mbctx);
 		modbus_free(mbctx);
@@ -406,6 +441,35 @@ void upsdrv_cleanup(void)
  * driver support functions
  */
 
+/* Read a block of registers or bits for the read planner */
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	int rval = -1;
+
+	NUT_UNUSED_VARIABLE(arg);
+
+	if (type == MODBUS_PLAN_COIL) {
+		rval = modbus_read_bits(mbctx, addr, nb, (uint8_t *)dest);
+	} else if (type == MODBUS_PLAN_INPUT_BIT) {
+		rval = modbus_read_input_bits(mbctx, addr, nb, (uint8_t *)dest);
+	} else if (type == MODBUS_PLAN_INPUT_REGISTER) {
+		rval = modbus_read_input_registers(mbctx, addr, nb, (uint16_t *)dest);
+	} else if (type == MODBUS_PLAN_HOLDING_REGISTER) {
+		rval = modbus_read_registers(mbctx, addr, nb, (uint16_t *)dest);
+	}
+
+	if (rval == -1) {
+		upsdebugx(2, "plan_read: addr:0x%x, count:%d, type:%d: error(%s)",
+			(unsigned int)addr, nb, (int)type, modbus_strerror(errno));
+
+		/* on BROKEN PIPE error try to reconnect */
+		if (errno == EPIPE) {
+			modbus_reconnect();
+		}
+	}
+	return rval;
+}
+
 /* Read a modbus register */
 int register_read(modbus_t *mb, int addr, regtype_t type, void *data)
 {
@@ -415,6 +479,16 @@ int register_read(modbus_t *mb, int addr, regtype_t type, void *data)
 	uint16_t mask8 = 0x000F;
 	uint16_t mask16 = 0x00FF;
 
+	/* served from the block reads done at the start of the update? */
+	if (modbus_plan_fetch(readplan, (modbus_plan_type_t)type, addr, 1, data) == 0) {
+		rval = 1;
+		*(uint16_t *)data = *(uint16_t *)data
+			& ((type == COIL || type == INPUT_B) ? mask8 : mask16);
+		upsdebugx(3, "register addr: 0x%x, register type: %u read: %u (cached)",
+			(unsigned int)addr, type, *(unsigned int *)data);
+		return rval;
+	}
+
 	switch (type) {
 		case COIL:
 			rval = modbus_read_bits(mb, addr, 1, (uint8_t *)data);
@@ -519,6 +593,9 @@ int register_write(modbus_t *mb, int addr, regtype_t type, void *data)
 			upsdebugx(2, "ERROR: register_write: invalid register type %u", type);
 			break;
 	}
+	/* values read in bulk earlier may be outdated now */
+	modbus_plan_invalidate(readplan);
+
 	if (rval == -1) {
 		upslogx(LOG_ERR, "ERROR:(%s) modbus_read: addr:0x%x, type:%8s, path:%s",
 			modbus_strerror(errno),
@@ -1124,5 +1201,8 @@ void modbus_reconnect(void)
 /* #elif (defined NUT_MODBUS_TIMEOUT_ARG_timeval) // some un-castable type in fields */
 #endif /* NUT_MODBUS_TIMEOUT_ARG_* */
 
+	/* failures before may have been the link, not the register map */
+	modbus_plan_retry(readplan);
+
 	reconnect_trying(RECONNECT_SUCCESS);
 }
@@ -563,12 +563,12 @@ HIDData_t *FindObject_with_ID_Node(HIDDesc_t *pDesc_arg, uint8_t ReportID, HIDNo
 }
 
 /*
- * GetValue
- * Extract data from a report stored in Buf.
- * Use Offset, Size, LogMin, and LogMax of pData.
- * Return response in *pValue.
+ * PrepareField
+ * Work out once from pData what GetValue() needs to decode its data:
+ * position and size in the report, and how to make the logical value
+ * out of the raw bits. Return it in *pField, for use with GetValues().
  * -------------------------------------------------------------------------- */
-void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue)
+void PrepareField(const HIDData_t *pData, HIDField_t *pField)
 {
 	/* Note:  https://github.com/networkupstools/nut/issues/1023
 	 * This conversion code can easily be sensitive to 32- vs. 64- bit
@@ -578,19 +578,12 @@ void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue)
 	 * Test carefully in both environments if changing any declarations.
 	 */
 
-	int	Weight, Bit;
-	unsigned long mask, signbit, magMax, magMin;
-	long	value = 0;
+	unsigned long	magMax, magMin;
 
-	Bit = pData->Offset + 8;	/* First byte of report is report ID */
-
-	for (Weight = 0; Weight < pData->Size; Weight++, Bit++) {
-		int	State = Buf[Bit >> 3] & (1 << (Bit & 7));
-
-		if(State) {
-			value += (1L << Weight);
-		}
-	}
+	pField->Bit = pData->Offset + 8U;	/* First byte of report is report ID */
+	pField->Size = pData->Size;
+	pField->LogMin = pData->LogMin;
+	pField->LogMax = pData->LogMax;
 
 	/* translate Value into a signed/unsigned value in the range
 	LogMin..LogMax, as appropriate. See HID spec, p.38: "If both the
@@ -619,28 +612,103 @@ void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue)
 	magMin = pData->LogMin >= 0 ? (unsigned long)(pData->LogMin) : (unsigned long)(-(pData->LogMin + 1));
 
 	/* calculate where the sign bit will be if needed */
-	signbit = 1L << hibit(magMax > magMin ? magMax : magMin);
+	pField->signbit = 1L << hibit(magMax > magMin ? magMax : magMin);
 
 	/* but only include sign bit in mask if negative numbers are involved */
-	mask = (signbit - 1) | ((pData->LogMin < 0) ? signbit : 0);
+	pField->mask = (pField->signbit - 1) | ((pData->LogMin < 0) ? pField->signbit : 0);
+}
 
+/* Raw bits of a field, least significant first. The (at most 8) bytes
+ * it spans are assembled into one word, HID reports being little-endian,
+ * and shifted into place; only the bytes of the field are read, so
+ * this is safe at the end of a report buffer. Bits beyond what fits
+ * into an unsigned long are dropped (GetValue() masks them anyway). */
+static inline unsigned long GetBits(const unsigned char *Buf, unsigned int Bit, uint8_t Size)
+{
+	const unsigned char	*p = Buf + (Bit >> 3);
+	unsigned int	shift = Bit & 7;
+	unsigned long	value = 0;
+	unsigned int	Weight;
+
+	if (Size == 0) {
+		return 0;
+	}
+
+	if (shift + Size <= 64) {
+		uint64_t	word = 0;
+		size_t	n = (shift + Size + 7) >> 3;
+
+		while (n-- > 0) {
+			word = (word << 8) | p[n];
+		}
+
+		word >>= shift;
+		if (Size < 64) {
+			word &= ((uint64_t)1 << Size) - 1;
+		}
+
+		return (unsigned long)word;
+	}
+
+	/* wider than any integer we have: bit by bit, for the low ones */
+	for (Weight = 0; Weight < Size && Weight < sizeof(value) * 8; Weight++, Bit++) {
+		if (Buf[Bit >> 3] & (1 << (Bit & 7))) {
+			value |= (1UL << Weight);
+		}
+	}
+
+	return value;
+}
+
+/* logical value of a field from its raw bits, see PrepareField() */
+static inline long FieldValue(const HIDField_t *pField, unsigned long raw)
+{
 	/* throw away excess high order bits (which may contain garbage) */
-	value = (long)((unsigned long)(value) & mask);
+	long	value = (long)(raw & pField->mask);
 
 	/* sign-extend it, if appropriate */
-	if (pData->LogMin < 0 && ((unsigned long)(value) & signbit) != 0) {
-		value |= ~mask;
+	if (pField->LogMin < 0 && (raw & pField->signbit) != 0) {
+		value = (long)((unsigned long)(value) | ~pField->mask);
 	}
 
 	/* clamp returned value to range [LogMin..LogMax] */
-	if (value < pData->LogMin) {
-		value = pData->LogMin;
-	} else if (value > pData->LogMax) {
-		value = pData->LogMax;
+	if (value < pField->LogMin) {
+		value = pField->LogMin;
+	} else if (value > pField->LogMax) {
+		value = pField->LogMax;
 	}
 
-	*pValue = value;
-	return;
+	return value;
+}
+
+/*
+ * GetValue
+ * Extract data from a report stored in Buf.
+ * Use Offset, Size, LogMin, and LogMax of pData.
+ * Return response in *pValue.
+ * -------------------------------------------------------------------------- */
+void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue)
+{
+	HIDField_t	field;
+
+	PrepareField(pData, &field);
+
+	*pValue = FieldValue(&field, GetBits(Buf, field.Bit, field.Size));
+}
+
+/*
+ * GetValues
+ * Extract data of nfields items of one report stored in Buf, as
+ * prepared in pField[] with PrepareField(), in a single pass.
+ * Return responses in pValues[], in the same order.
+ * -------------------------------------------------------------------------- */
+void GetValues(const unsigned char *Buf, const HIDField_t *pField, size_t nfields, long *pValues)
+{
+	size_t	i;
+
+	for (i = 0; i < nfields; i++) {
+		pValues[i] = FieldValue(&pField[i], GetBits(Buf, pField[i].Bit, pField[i].Size));
+	}
 }
 
 /*
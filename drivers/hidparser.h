@@ -76,6 +76,16 @@ HIDData_t *FindObject_with_ID_Node(HIDDesc_t *pDesc_arg, uint8_t ReportID, HIDNo
  * -------------------------------------------------------------------------- */
 void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue);
 
+/*
+ * PrepareField
+ * -------------------------------------------------------------------------- */
+void PrepareField(const HIDData_t *pData, HIDField_t *pField);
+
+/*
+ * GetValues
+ * -------------------------------------------------------------------------- */
+void GetValues(const unsigned char *Buf, const HIDField_t *pField, size_t nfields, long *pValues);
+
 /*
  * SetValue
  * -------------------------------------------------------------------------- */
@@ -320,6 +320,21 @@ typedef struct {
 	bool		mapping_handled;		/* Did any (sub)driver handling loop care about this report? If not, may be a point for improvement... */
 } HIDData_t;
 
+/*
+ * HIDField struct
+ *
+ * What GetValue() works out from a HIDData to decode it, computed once
+ * with PrepareField() to decode the items of a whole report at a time
+ * -------------------------------------------------------------------------- */
+typedef struct {
+	unsigned int	Bit;				/* First bit, after report ID byte	*/
+	uint8_t		Size;				/* Size of data in bit		*/
+	unsigned long	mask;				/* Bits making the value		*/
+	unsigned long	signbit;			/* Sign bit, if LogMin < 0		*/
+	long		LogMin;				/* Logical Min			*/
+	long		LogMax;				/* Logical Max			*/
+} HIDField_t;
+
 /*
  * HIDDesc struct
  *
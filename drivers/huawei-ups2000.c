@@ -48,6 +48,7 @@
 #include "main.h"
 #include "serial.h"
 #include "nut_stdint.h"
+#include "modbus-plan.h"
 #include "timehead.h"   /* fallback gmtime_r() variants if needed (e.g. some WIN32) */
 
 #if !(defined NUT_MODBUS_LINKTYPE_STR)
@@ -55,7 +56,7 @@
 #endif
 
 #define DRIVER_NAME	"NUT Huawei UPS2000 (1kVA-3kVA) RS-232 Modbus driver (libmodbus link type: " NUT_MODBUS_LINKTYPE_STR ")"
-#define DRIVER_VERSION	"0.13"
+#define DRIVER_VERSION	"0.14"
 
 #define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
 #define MODBUS_SLAVE_ID 1
@@ -161,6 +162,8 @@ static int ups2000_update_timers(void);
 static void ups2000_device_identification(void);
 static size_t ups2000_read_serial(uint8_t *buf, size_t buf_len);
 static int ups2000_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *dest);
+static int ups2000_read_planned(int addr, int nb, uint16_t *dest);
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest);
 static int ups2000_write_register(modbus_t *ctx, int addr, uint16_t val);
 static int ups2000_write_registers(modbus_t *ctx, int addr, int nb, uint16_t *src);
 static uint16_t crc16(uint8_t *buffer, size_t buffer_length);
@@ -596,15 +599,15 @@ static int ups2000_update_info(void)
 	 * We only support 1 UPS, thus it's always 10000. Register
 	 * 1000 becomes 11000.
 	 */
-	r = ups2000_read_registers(modbus_ctx, 11000, 28, reg[0]);
+	r = ups2000_read_planned(11000, 28, reg[0]);
 	if (r != 28)
 		return 1;
 
-	r = ups2000_read_registers(modbus_ctx, 12000, 34, reg[1]);
+	r = ups2000_read_planned(12000, 34, reg[1]);
 	if (r != 34)
 		return 1;
 
-	r = ups2000_read_registers(modbus_ctx, 19009, 1, &reg[2][9]);
+	r = ups2000_read_planned(19009, 1, &reg[2][9]);
 	if (r != 1)
 		return 1;
 
@@ -733,7 +736,7 @@ static int ups2000_update_status(void)
 		int flag_count = 0;
 
 		reg = ups2000_status_reg[i].reg;
-		r = ups2000_read_registers(modbus_ctx, reg + 10000, 1, &val);
+		r = ups2000_read_planned(reg + 10000, 1, &val);
 		if (r != 1)
 			return 1;
 
@@ -959,7 +962,7 @@ static int ups2000_update_alarm(void)
 	 * All alarm registers have an offset of 1024 * ups_number.
 	 * We only support 1 UPS, it's always 1024.
 	 */
-	r = ups2000_read_registers(modbus_ctx, ups2000_alarm[0].reg + 1024, 27, val);
+	r = ups2000_read_planned(ups2000_alarm[0].reg + 1024, 27, val);
 	if (r != 27)
 		return 1;
 
@@ -1115,6 +1118,37 @@ static int ups2000_update_alarm(void)
 }
 
 
+/*
+ * Registers read by every update, fetched at its start with as few
+ * requests as the "mod_max_registers" and "mod_max_gap" settings allow.
+ * The status registers 1024, 1043 and 2002 are covered by the blocks
+ * of ups2000_update_info() or close to them.
+ */
+static modbus_plan_t *readplan = NULL;
+
+static void ups2000_plan_init(void)
+{
+	int i;
+
+	readplan = modbus_plan_new(plan_read, NULL);
+	if (modbus_plan_configure(readplan, getval(MODBUS_PLAN_VAR_MAX_REGISTERS),
+		NULL, getval(MODBUS_PLAN_VAR_MAX_GAP)) < 0
+	) {
+		fatalx(EXIT_FAILURE, "Invalid Modbus request limits, see above");
+	}
+
+	modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, ups2000_alarm[0].reg + 1024, 27);
+	modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 11000, 28);
+	modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 12000, 34);
+	modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, 19009, 1);
+	for (i = 0; ups2000_status_reg[i].reg != 0; i++)
+		modbus_plan_add(readplan, MODBUS_PLAN_HOLDING_REGISTER, ups2000_status_reg[i].reg + 10000, 1);
+
+	upsdebugx(2, "update registers are read with %" PRIuSIZE " requests",
+		modbus_plan_blocks(readplan));
+}
+
+
 void upsdrv_updateinfo(void)
 {
 	int err = 0;
@@ -1123,12 +1157,19 @@ void upsdrv_updateinfo(void)
 	status_init();
 	alarm_init();
 
+	if (!readplan)
+		ups2000_plan_init();
+	modbus_plan_refresh(readplan);
+
 	err += ups2000_update_timers();
 	err += ups2000_update_alarm();
 	err += ups2000_update_info();
 	err += ups2000_update_status();
 	err += ups2000_update_rw_var();
 
+	/* instant commands and setvars read the device directly */
+	modbus_plan_invalidate(readplan);
+
 	if (err > 0) {
 		upsdebugx(2, "upsdrv_updateinfo failed, data stale.");
 		dstate_datastale();
@@ -1860,6 +1901,11 @@ void upsdrv_makevartable(void)
 {
 	char msg[64];
 
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_REGISTERS,
+		"Modbus registers read with one request at most (1-125)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_GAP,
+		"Unused Modbus registers read to merge two requests");
+
 	snprintf(msg, 64, "Set shutdown delay, in seconds, 6-second step"
 		" (default=%d)", ups2000_rw_delay[SHUTDOWN].dfault);
 	addvar(VAR_VALUE, "offdelay", msg);
@@ -1876,6 +1922,9 @@ void upsdrv_makevartable(void)
 
 void upsdrv_cleanup(void)
 {
+	modbus_plan_free(readplan);
+	readplan = NULL;
+
 	if (modbus_ctx != NULL) {
 		modbus_close(modbus_ctx);
 		modbus_free(modbus_ctx);
@@ -2046,6 +2095,34 @@ static int ups2000_read_registers(modbus_t *ctx, int addr, int nb, uint16_t *des
 }
 
 
+/*
+ * Serve a read from the data fetched at the start of the update,
+ * or read the device if it is not there.
+ */
+static int ups2000_read_planned(int addr, int nb, uint16_t *dest)
+{
+	if (modbus_plan_fetch(readplan, MODBUS_PLAN_HOLDING_REGISTER, addr, nb, dest) == 0) {
+		/* battery status gets re-read with retries, see below */
+		if (addr != 12002 || (dest[0] >= 2 && dest[0] <= 5))
+			return nb;
+	}
+
+	return ups2000_read_registers(modbus_ctx, addr, nb, dest);
+}
+
+
+/* Block reads for the read planner, with the usual retries */
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	NUT_UNUSED_VARIABLE(arg);
+
+	if (type != MODBUS_PLAN_HOLDING_REGISTER)
+		return -1;
+
+	return ups2000_read_registers(modbus_ctx, addr, nb, (uint16_t *)dest);
+}
+
+
 static int ups2000_write_registers(modbus_t *ctx, int addr, int nb, uint16_t *src)
 {
 	int i;
@@ -84,6 +84,44 @@ size_t interrupt_size = 0;
    structure called a "report buffer". The functions in this group
    operate on entire *reports*, not individual data items. */
 
+/* conversion of the logical value of an item to the physical one, as
+   logical_to_physical() and the unit exponent in HIDGetDataValue() do
+   it, with the factors computed once */
+typedef struct {
+	int	linear;		/* physical range differs from logical one */
+	double	Factor;
+	long	LogMin, PhyMin, PhyMax;
+	double	Scale;		/* 10^unit exponent */
+} hidconv_t;
+
+/* all items of the report descriptor, grouped by report id, to decode
+   every item of a report in one pass when the report is refreshed;
+   later reads of its items just pick the value. */
+typedef struct reportplan_s {
+	HIDDesc_t	*desc;		/* items are desc->item[] */
+	size_t	*index;			/* position of each item within its report */
+	size_t	first[256];		/* position of the first item of each report */
+	size_t	nfields[256];		/* number of items of each report */
+	HIDField_t	*field;
+	hidconv_t	*conv;
+	long	*logical;		/* GetValues() output */
+	double	*value;			/* physical values */
+	int	decoded[256];		/* value[] is up to date with the report */
+} reportplan_t;
+
+static void free_report_plan(reportplan_t *plan)
+{
+	if (!plan)
+		return;
+
+	free(plan->index);
+	free(plan->field);
+	free(plan->conv);
+	free(plan->logical);
+	free(plan->value);
+	free(plan);
+}
+
 void free_report_buffer(reportbuf_t *rbuf)
 {
 	int i;
@@ -95,6 +133,7 @@ void free_report_buffer(reportbuf_t *rbuf)
 		free(rbuf->data[i]);
 	}
 
+	free_report_plan(rbuf->plan);
 	free(rbuf);
 }
 
@@ -147,6 +186,120 @@ reportbuf_t *new_report_buffer(HIDDesc_t *arg_pDesc)
 	return rbuf;
 }
 
+static void prepare_conv(HIDData_t *Data, hidconv_t *conv)
+{
+	conv->LogMin = Data->LogMin;
+	conv->PhyMin = Data->PhyMin;
+	conv->PhyMax = Data->PhyMax;
+
+	/* same cases as in logical_to_physical() */
+	conv->linear = Data->have_PhyMax && Data->have_PhyMin
+		&& !(Data->PhyMax == 0 && Data->PhyMin == 0)
+		&& Data->PhyMax > Data->PhyMin && Data->LogMax > Data->LogMin;
+
+	conv->Factor = conv->linear
+		? (double)(Data->PhyMax - Data->PhyMin) / (Data->LogMax - Data->LogMin)
+		: 1;
+
+	conv->Scale = exponent(10, get_unit_expo(Data));
+}
+
+static double conv_to_physical(const hidconv_t *conv, long logical)
+{
+	double	physical;
+
+	if (!conv->linear)
+		return (double)logical * conv->Scale;
+
+	physical = (double)((logical - conv->LogMin) * conv->Factor) + conv->PhyMin;
+
+	if (physical > conv->PhyMax) {
+		physical = conv->PhyMax;
+	} else if (physical < conv->PhyMin) {
+		physical = conv->PhyMin;
+	}
+
+	return physical * conv->Scale;
+}
+
+/* lay out the items of arg_pDesc by report. This is done when the first
+   value is read rather than with the report buffer, so that fix-ups of
+   the report descriptor by subdrivers are taken into account. Return
+   NULL on failure, and values are then decoded one by one. */
+static reportplan_t *new_report_plan(HIDDesc_t *arg_pDesc)
+{
+	reportplan_t	*plan;
+	size_t	i, n = arg_pDesc->nitems, pos;
+	size_t	fill[256];
+	int	id;
+
+	plan = (reportplan_t *)calloc(1, sizeof(*plan));
+	if (!plan)
+		return NULL;
+
+	plan->desc = arg_pDesc;
+	plan->index = (size_t *)calloc(n, sizeof(*plan->index));
+	plan->field = (HIDField_t *)calloc(n, sizeof(*plan->field));
+	plan->conv = (hidconv_t *)calloc(n, sizeof(*plan->conv));
+	plan->logical = (long *)calloc(n, sizeof(*plan->logical));
+	plan->value = (double *)calloc(n, sizeof(*plan->value));
+	if (!plan->index || !plan->field || !plan->conv
+	 || !plan->logical || !plan->value
+	) {
+		free_report_plan(plan);
+		return NULL;
+	}
+
+	for (i = 0; i < n; i++) {
+		plan->nfields[arg_pDesc->item[i].ReportID]++;
+	}
+
+	for (id = 0, pos = 0; id < 256; id++) {
+		plan->first[id] = pos;
+		pos += plan->nfields[id];
+		fill[id] = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		HIDData_t	*pData = &arg_pDesc->item[i];
+
+		id = pData->ReportID;
+		plan->index[i] = fill[id]++;
+		pos = plan->first[id] + plan->index[i];
+
+		PrepareField(pData, &plan->field[pos]);
+		prepare_conv(pData, &plan->conv[pos]);
+	}
+
+	upsdebugx(2, "%s: prepared %" PRIuSIZE " items for decoding by report",
+		__func__, n);
+
+	return plan;
+}
+
+/* decode all items of report id in the buffer at once */
+static void decode_report(reportbuf_t *rbuf, int id)
+{
+	reportplan_t	*plan = rbuf->plan;
+	size_t	i, first = plan->first[id];
+
+	GetValues(rbuf->data[id], &plan->field[first], plan->nfields[id],
+		&plan->logical[first]);
+
+	for (i = first; i < first + plan->nfields[id]; i++) {
+		plan->value[i] = conv_to_physical(&plan->conv[i], plan->logical[i]);
+	}
+
+	plan->decoded[id] = 1;
+}
+
+/* the buffered report id changed, its decoded values are outdated */
+static inline void expire_decoded(reportbuf_t *rbuf, int id)
+{
+	if (rbuf->plan)
+		rbuf->plan->decoded[id] = 0;
+}
+
 /* ---------------------------------------------------------------------- */
 /* the functions in this next group operate on buffered reports, but
    operate on individual items, not whole reports. */
@@ -254,25 +407,53 @@ static int refresh_report_buffer(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDDa
 
 	/* have (valid) report */
 	time(&rbuf->ts[id]);
+	expire_decoded(rbuf, id);
 
 	return 0;
 }
 
-/* read the logical value for the given pData. No logical to physical
-   conversion is performed. If age>0, the read operation is buffered
-   if the item's age is less than "age". On success, return 0 and
-   store the answer in *value. On failure, return -1 and set errno. */
-static int get_item_buffered(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDData_t *pData, long *Value, time_t age)
+/* read the physical value for the given pData. If age>0, the read
+   operation is buffered if the item's age is less than "age". All
+   items of a report get decoded together when it is first read after
+   a refresh, later reads only pick their value. On success, return 0
+   and store the answer in *Value. On failure, return -1 and set errno. */
+static int get_value_buffered(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDData_t *pData, double *Value, time_t age)
 {
 	int id = pData->ReportID;
 	int r;
+	long	hValue;
 
 	r = refresh_report_buffer(rbuf, udev, pData, age);
 	if (r<0) {
 		return -1;
 	}
 
-	GetValue(rbuf->data[id], pData, Value);
+	if (!rbuf->plan && pDesc) {
+		rbuf->plan = new_report_plan(pDesc);
+	}
+
+	/* items not from the descriptor the plan was made for get decoded
+	 * on their own, as well as all of them if it could not be made */
+	if (rbuf->plan && rbuf->plan->desc == pDesc
+	 && pData >= pDesc->item && pData < pDesc->item + pDesc->nitems
+	) {
+		reportplan_t	*plan = rbuf->plan;
+
+		if (!plan->decoded[id]) {
+			decode_report(rbuf, id);
+		}
+
+		*Value = plan->value[plan->first[id] + plan->index[(size_t)(pData - pDesc->item)]];
+		return 0;
+	}
+
+	GetValue(rbuf->data[id], pData, &hValue);
+
+	/* Convert Logical Min, Max and Value into Physical */
+	*Value = logical_to_physical(pData, hValue);
+
+	/* Process exponents and units */
+	*Value *= exponent(10, get_unit_expo(pData));
 
 	return 0;
 }
@@ -287,6 +468,7 @@ static int set_item_buffered(reportbuf_t *rbuf, hid_dev_handle_t udev, HIDData_t
 	size_t	r = rbuf->len[id];
 
 	SetValue(pData, rbuf->data[id], Value);
+	expire_decoded(rbuf, id);
 
 #if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && ( (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_TYPE_LIMITS) || (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_TAUTOLOGICAL_CONSTANT_OUT_OF_RANGE_COMPARE) || (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_TAUTOLOGICAL_UNSIGNED_ZERO_COMPARE) || (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_UNREACHABLE_CODE) || (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_TAUTOLOGICAL_TYPE_LIMIT_COMPARE) )
 # pragma GCC diagnostic push
@@ -375,6 +557,7 @@ static int file_report_buffer(reportbuf_t *rbuf, unsigned char *buf, size_t bufl
 
 	/* have (valid) report */
 	time(&rbuf->ts[id]);
+	expire_decoded(rbuf, id);
 
 	return 0;
 }
@@ -523,26 +706,17 @@ char *HIDGetDataItem(const HIDData_t *hiddata, usage_tables_t *utab)
 int HIDGetDataValue(hid_dev_handle_t udev, HIDData_t *hiddata, double *Value, time_t age)
 {
 	int	r;
-	long	hValue;
 
 	if (hiddata == NULL) {
 		return 0;
 	}
 
-	r = get_item_buffered(reportbuf, udev, hiddata, &hValue, age);
+	r = get_value_buffered(reportbuf, udev, hiddata, Value, age);
 	if (r<0) {
 		upsdebug_with_errno(1, "Can't retrieve Report %02x", hiddata->ReportID);
 		return -errno;
 	}
 
-	*Value = hValue;
-
-	/* Convert Logical Min, Max and Value into Physical */
-	*Value = logical_to_physical(hiddata, hValue);
-
-	/* Process exponents and units */
-	*Value *= exponent(10, get_unit_expo(hiddata));
-
 	return 1;
 }
 
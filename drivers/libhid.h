@@ -95,6 +95,7 @@ typedef struct reportbuf_s {
 	time_t	ts[256];			/* timestamp when report was retrieved */
 	size_t	len[256];			/* size of report data */
 	unsigned char	*data[256];		/* report data (allocated) */
+	struct reportplan_s	*plan;		/* to decode whole reports at once */
 } reportbuf_t;
 
 extern reportbuf_t	*reportbuf;	/* buffer for most recent reports */
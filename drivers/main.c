@@ -91,6 +91,9 @@ int	do_synchronous = -1;
 /* for detecting -a values that don't match anything */
 static	int	upsname_found = 0;
 
+/* set if started with -s (so without ups.conf sections to host) */
+static	int	upsconf_skipped = 0;
+
 # ifndef DRIVERS_MAIN_WITHOUT_MAIN
 static
 # endif /* DRIVERS_MAIN_WITHOUT_MAIN */
@@ -104,6 +107,17 @@ static char	*chroot_path = NULL, *user = NULL, *group = NULL;
 static int	user_from_cmdline = 0, group_from_cmdline = 0,
 		reconnect_max_tries = -1, reconnect_count = 0, reconnect_report_freq = -1;
 
+/* adaptive polling: the interval doubles up to poll_interval_max seconds
+ * while updates change nothing and the device is quietly on-line
+ * (0 or not above poll_interval: fixed interval) */
+time_t	poll_interval_max = 0;
+static int	poll_changes_reported = -1;
+
+void poll_report_changes(int changed)
+{
+	poll_changes_reported = (changed != 0);
+}
+
 /* signal handling */
 int	exit_flag = 0;
 /* reload_flag is 0 most of the time (including initial config reading),
@@ -1232,6 +1246,33 @@ invalid:
 	return STAT_SET_INVALID;
 }
 
+/* pollinterval_max may be set globally or per driver, and reloaded */
+static void set_poll_interval_max(const char *var, const char *val)
+{
+	char buf[SMALLBUF];
+	int do_handle = 1;
+
+	/* log a message if value changed; skip if no good buf */
+	if (snprintf(buf, sizeof(buf), "%" PRIdMAX, (intmax_t)poll_interval_max)) {
+		if ((do_handle = testval_reloadable(var, buf, val, 1)) == 0) {
+			/* Should not happen, but... */
+			fatalx(EXIT_FAILURE, "Error: failed to check "
+				"testval_reloadable() for %s: "
+				"old %s vs. new %s", var, buf, NUT_STRARG(val));
+		}
+	}
+
+	if (do_handle > 0) {
+		int ipv = atoi(val);
+		if (ipv >= 0) {
+			poll_interval_max = (time_t)ipv;
+		} else {
+			fatalx(EXIT_FAILURE, "Error: UPS [%s]: invalid %s: %d",
+				NUT_STRARG(upsname), var, ipv);
+		}
+	}	/* else: no-op */
+}
+
 /* handle -x / ups.conf config details that are for this part of the code */
 static int main_arg(char *var, char *val)
 {
@@ -1375,6 +1416,11 @@ static int main_arg(char *var, char *val)
 		return 1;	/* handled */
 	}
 
+	if (!strcmp(var, "pollinterval_max")) {
+		set_poll_interval_max(var, val);
+		return 1;	/* handled */
+	}
+
 	/* Allow per-driver overrides of the global setting
 	 * and allow to reload this, why not.
 	 * Note: this may cause "spurious" redefinitions of the
@@ -1521,6 +1567,11 @@ static void do_global_args(const char *var, const char *val)
 		return;
 	}
 
+	if (!strcmp(var, "pollinterval_max")) {
+		set_poll_interval_max(var, val);
+		return;
+	}
+
 	/* In checks below, testinfo_reloadable(..., 0) should forbid
 	 * re-population of the setting with a new value, but emit a
 	 * warning if it did change (so driver restart is needed to apply)
@@ -1695,6 +1746,11 @@ void do_upsconf_args(char *confupsname, char *var, char *val)
 
 	upsname_found = 1;
 
+	if (!strcmp(var, "hosted_by")) {
+		fatalx(EXIT_FAILURE, "UPS [%s] is served by the driver of [%s], "
+			"start that one instead", upsname, NUT_STRARG(val));
+	}
+
 	upsdebugx(5, "%s: call main_arg()", __func__);
 	if (main_arg(var, val))
 		return;
@@ -1988,14 +2044,9 @@ static void listxarg(void)
 }
 #endif /* DRIVERS_MAIN_WITHOUT_MAIN */
 
-# ifndef DRIVERS_MAIN_WITHOUT_MAIN
-static
-# endif /* DRIVERS_MAIN_WITHOUT_MAIN */
-void vartab_free(void)
+static void vartab_free_list(vartab_t *tmp)
 {
-	vartab_t	*tmp, *next;
-
-	tmp = vartab_h;
+	vartab_t	*next;
 
 	while (tmp) {
 		next = tmp->next;
@@ -2009,6 +2060,224 @@ void vartab_free(void)
 	}
 }
 
+# ifndef DRIVERS_MAIN_WITHOUT_MAIN
+static
+# endif /* DRIVERS_MAIN_WITHOUT_MAIN */
+void vartab_free(void)
+{
+	vartab_free_list(vartab_h);
+}
+
+/* devices of the sections hosted by ours, and the selected one */
+static upsdrv_hosted_t	*hosted_h = NULL, *hosted_cur = NULL;
+
+/* read_upsconf() callback of upsdrv_hosted_load(): find the sections
+ * hosted by ours */
+static void hosted_find_args(char *confupsname, char *var, char *val)
+{
+	upsdrv_hosted_t	*dev, **last;
+
+	if (!confupsname || !val || strcmp(var, "hosted_by") || strcmp(val, upsname))
+		return;
+
+	for (last = &hosted_h; *last; last = &(*last)->next) {
+		if (!strcmp((*last)->name, confupsname))
+			return;
+	}
+
+	dev = (upsdrv_hosted_t *)xcalloc(1, sizeof(*dev));
+	dev->name = xstrdup(confupsname);
+	*last = dev;
+}
+
+/* read_upsconf() callback of upsdrv_hosted_load(): store the settings
+ * of a hosted section, as do_upsconf_args() does for ours */
+static void hosted_store_args(char *confupsname, char *var, char *val)
+{
+	upsdrv_hosted_t	*dev, *prev;
+	vartab_t	*tmp;
+	const char	**pprogname;
+	char	flag[SMALLBUF];
+
+	if (!confupsname)
+		return;
+
+	for (dev = hosted_h; dev && strcmp(dev->name, confupsname); dev = dev->next)
+		;
+	if (!dev)
+		return;
+
+	if (!strcmp(var, "driver")) {
+		for (pprogname = prognames; *pprogname != NULL; pprogname++) {
+			if (val && !strcmp(val, *pprogname))
+				return;
+		}
+		fatalx(EXIT_FAILURE, "UPS [%s] is hosted by [%s], so its driver "
+			"must be %s too, not %s", dev->name, upsname,
+			progname, NUT_STRARG(val));
+	}
+
+	/* upsdrvctl settings, or ours to take care of */
+	if (!strcmp(var, "hosted_by")
+	||  !strcmp(var, "desc")
+	||  !strcmp(var, "sdorder")
+	||  !strcmp(var, "maxstartdelay")
+	||  !strcmp(var, "maxretry")
+	||  !strcmp(var, "retrydelay")
+	)
+		return;
+
+	prev = upsdrv_hosted_select(dev);
+
+	if (!strcmp(var, "port")) {
+		free(dev->port);
+		dev->port = xstrdup(NUT_STRARG(val));
+		device_path = dev->port;
+		dparam_setinfo(var, val);
+		upsdrv_hosted_select(prev);
+		return;
+	}
+
+	for (tmp = vartab_h; tmp && strcasecmp(tmp->var, var); tmp = tmp->next)
+		;
+
+	if (tmp || !strncasecmp(var, "override.", 9) || !strncasecmp(var, "default.", 8)) {
+		if (!val) {
+			snprintf(flag, sizeof(flag), "driver.flag.%s", var);
+			dstate_setinfo(flag, "enabled");
+		}
+		storeval(var, val);
+		upsdrv_hosted_select(prev);
+		return;
+	}
+
+	upsdrv_hosted_select(prev);
+	upslogx(LOG_WARNING, "UPS [%s]: '%s' is not a setting this driver "
+		"takes for a hosted device (those of the process are taken "
+		"from [%s]), ignored", dev->name, var, upsname);
+}
+
+upsdrv_hosted_t *upsdrv_hosted_load(void)
+{
+	void	(*prev_callback)(char *, char *, char *) = callback_upsconf_args;
+	upsdrv_hosted_t	*dev, *prev;
+	vartab_t	*tmp, **last;
+	const char	*host = upsname;
+
+	if (hosted_h || upsconf_skipped)
+		return hosted_h;
+
+	callback_upsconf_args = hosted_find_args;
+	read_upsconf(1);
+
+	for (dev = hosted_h; dev; dev = dev->next) {
+		/* the settings this driver takes, none given yet */
+		for (tmp = vartab_h, last = &dev->vartab; tmp; tmp = tmp->next) {
+			*last = (vartab_t *)xcalloc(1, sizeof(**last));
+			(*last)->vartype = tmp->vartype;
+			(*last)->var = xstrdup(tmp->var);
+			(*last)->desc = tmp->desc ? xstrdup(tmp->desc) : NULL;
+			(*last)->reloadable = tmp->reloadable;
+			last = &(*last)->next;
+		}
+
+		dev->ctx = dstate_ctx_new();
+
+		prev = upsdrv_hosted_select(dev);
+		if (upsdrv_callbacks.UPS_VERSION)
+			dstate_setinfo("driver.version", "%s", upsdrv_callbacks.UPS_VERSION);
+		if (upsdrv_callbacks.upsdrv_info)
+			dstate_setinfo("driver.version.internal", "%s", upsdrv_callbacks.upsdrv_info->version);
+		dstate_setinfo("driver.name", "%s", progname);
+		dparam_setinfo("hosted_by", host);
+		upsdrv_hosted_select(prev);
+
+		upsdebugx(1, "%s: serving [%s] as well", __func__, dev->name);
+	}
+
+	callback_upsconf_args = hosted_store_args;
+	read_upsconf(1);
+	callback_upsconf_args = prev_callback;
+
+	for (dev = hosted_h; dev; dev = dev->next) {
+		if (!dev->port || !*dev->port)
+			fatalx(EXIT_FAILURE, "UPS [%s] hosted by [%s] has no port",
+				dev->name, upsname);
+	}
+
+	return hosted_h;
+}
+
+upsdrv_hosted_t *upsdrv_hosted_select(upsdrv_hosted_t *dev)
+{
+	/* our own settings while a hosted device is selected */
+	static const char	*own_upsname = NULL;
+	static char	*own_device_path = NULL;
+	static vartab_t	*own_vartab = NULL;
+	static dstate_ctx_t	*own_ctx = NULL;
+	upsdrv_hosted_t	*prev = hosted_cur;
+
+	if (dev == hosted_cur)
+		return prev;
+
+	if (hosted_cur) {
+		hosted_cur->vartab = vartab_h;
+	} else {
+		own_upsname = upsname;
+		own_device_path = device_path;
+		own_vartab = vartab_h;
+		own_ctx = dstate_ctx_select(NULL);
+	}
+
+	if (dev) {
+		upsname = dev->name;
+		device_path = dev->port;
+		vartab_h = dev->vartab;
+		dstate_ctx_select(dev->ctx);
+	} else {
+		upsname = own_upsname;
+		device_path = own_device_path;
+		vartab_h = own_vartab;
+		dstate_ctx_select(own_ctx);
+	}
+
+	hosted_cur = dev;
+
+	return prev;
+}
+
+upsdrv_hosted_t *upsdrv_hosted_find_ctx(const dstate_ctx_t *ctx)
+{
+	upsdrv_hosted_t	*dev;
+
+	for (dev = hosted_h; dev && dev->ctx != ctx; dev = dev->next)
+		;
+
+	return dev;
+}
+
+# ifndef DRIVERS_MAIN_WITHOUT_MAIN
+static
+# endif /* DRIVERS_MAIN_WITHOUT_MAIN */
+void upsdrv_hosted_free(void)
+{
+	upsdrv_hosted_t	*dev, *next;
+
+	upsdrv_hosted_select(NULL);
+
+	for (dev = hosted_h; dev; dev = next) {
+		next = dev->next;
+
+		dstate_ctx_free(dev->ctx);
+		vartab_free_list(dev->vartab);
+		free(dev->name);
+		free(dev->port);
+		free(dev);
+	}
+
+	hosted_h = NULL;
+}
+
 #ifndef DRIVERS_MAIN_WITHOUT_MAIN
 static void upsdrv_setproctag(const char *tag)
 {
@@ -2018,6 +2287,120 @@ static void upsdrv_setproctag(const char *tag)
 	}
 }
 
+/* Let the group we run as (if customized) use a driver socket */
+static void sockname_access(const char *sockname)
+{
+	/* Normally we stick to the built-in account info,
+	 * so if they were not over-ridden - no-op here:
+	 */
+	if (strcmp(group, RUN_AS_GROUP)
+	||  strcmp(user,  RUN_AS_USER)
+	) {
+# ifndef WIN32
+		int allOk = 1;
+		/* Use file descriptor, not name, to first check and then manipulate permissions:
+		 *   https://cwe.mitre.org/data/definitions/367.html
+		 *   https://wiki.sei.cmu.edu/confluence/display/c/FIO01-C.+Be+careful+using+functions+that+use+file+names+for+identification
+		 * Alas, Unix sockets on most systems can not be open()ed
+		 * so there is no file descriptor to manipulate.
+		 * Fall back to name-based "les secure" operations then.
+		 */
+		TYPE_FD fd = ERROR_FD;
+
+		/* Tune group access permission to the pipe,
+		 * so that upsd can access it (using the
+		 * specified or retained default group):
+		 */
+		struct group *grp = getgrnam(group);
+		upsdebugx(1, "Group and/or user account for this driver "
+			"was customized ('%s:%s') compared to built-in "
+			"defaults. Fixing socket '%s' ownership/access.",
+			user, group, sockname);
+
+		if (grp == NULL) {
+			upsdebug_with_errno(1, "WARNING: could not resolve group name '%s'", group);
+			allOk = 0;
+			goto sockname_ownership_finished;
+		} else {
+			struct stat statbuf;
+			mode_t mode;
+
+			if (INVALID_FD((fd = open(sockname, O_RDWR | O_APPEND)))) {
+				upsdebug_with_errno(1, "WARNING: opening socket file for stat/chown failed,"
+					" which is rather typical for Unix socket handling");
+				allOk = 0;
+			}
+
+			if ((VALID_FD(fd) && fstat(fd, &statbuf))
+			||  (INVALID_FD(fd) && stat(sockname, &statbuf))
+			) {
+				upsdebug_with_errno(1, "WARNING: stat for chown of socket file failed");
+				allOk = 0;
+				if (INVALID_FD(fd)) {
+					/* Can not proceed with ops below */
+					goto sockname_ownership_finished;
+				}
+			} else {
+				/* Maybe open() and some stat() succeeed so far */
+				allOk = 1;
+				/* Here we do a portable chgrp() essentially: */
+				if ((VALID_FD(fd) && fchown(fd, statbuf.st_uid, grp->gr_gid))
+				||  (INVALID_FD(fd) && chown(sockname, statbuf.st_uid, grp->gr_gid))
+				) {
+					upsdebug_with_errno(1, "WARNING: chown of socket file failed");
+					allOk = 0;
+				}
+			}
+
+			/* Refresh file info */
+			if ((VALID_FD(fd) && fstat(fd, &statbuf))
+			||  (INVALID_FD(fd) && stat(sockname, &statbuf))
+			) {
+				/* Logically we'd fail chown above if file
+				 * does not exist or is not accessible */
+				upsdebug_with_errno(1, "WARNING: stat for chmod of socket file failed");
+				allOk = 0;
+			} else {
+				/* chmod g+rw sockname */
+				mode = statbuf.st_mode;
+				mode |= S_IWGRP;
+				mode |= S_IRGRP;
+				if ((VALID_FD(fd) && fchmod(fd, mode))
+				|| (INVALID_FD(fd) && chmod(sockname, mode))
+				) {
+					upsdebug_with_errno(1, "WARNING: chmod of socket file failed");
+					allOk = 0;
+				}
+			}
+		}
+
+sockname_ownership_finished:
+		if (allOk) {
+			upsdebugx(1, "Group access for this driver successfully fixed "
+				"(using file %s based methods)",
+				VALID_FD(fd) ? "descriptor" : "name");
+		} else {
+			upsdebugx(0, "WARNING: Needed to fix group access "
+				"to filesystem socket of this driver, but failed; "
+				"run the driver with more debugging to see how exactly.\n"
+				"Consumers of the socket, such as upsd data server, "
+				"can fail to interact with the driver and represent "
+				"the device: %s",
+				sockname);
+		}
+
+		if (VALID_FD(fd)) {
+			close(fd);
+			fd = ERROR_FD;
+		}
+# else	/* WIN32 */
+		/* NUT_WIN32_INCOMPLETE(); */
+		NUT_UNUSED_VARIABLE(sockname);
+		upsdebugx(1, "Options for alternate user/group are not implemented on this platform");
+# endif	/* WIN32 */
+	}
+}
+
 static void exit_upsdrv_cleanup(void)
 {
 	dstate_setinfo("driver.state", "cleanup.upsdrv");
@@ -2053,6 +2436,7 @@ static void exit_cleanup(void)
 		free(pidfn);
 	}
 
+	upsdrv_hosted_free();
 	dstate_free();
 	vartab_free();
 
@@ -2366,6 +2750,123 @@ int reconnect_trying(reconnect_state_t trying) {
 	}
 }
 
+#ifndef DRIVERS_MAIN_WITHOUT_MAIN
+/* Main loop instrumentation, published as read-only "driver.stats.*"
+ * variables. The counters are updated every cycle, but the dstate is
+ * only refreshed once in DRIVER_STATS_INTERVAL seconds so that these
+ * values do not themselves cause a constant stream of SETINFO updates.
+ */
+#define DRIVER_STATS_INTERVAL	60
+
+static struct {
+	uintmax_t	updateinfo_count;	/* upsdrv_updateinfo() calls */
+	uintmax_t	updateinfo_usec;	/* total time spent in them */
+	uintmax_t	updateinfo_usec_last;
+	uintmax_t	updateinfo_usec_max;
+	uintmax_t	poll_wakeups;		/* dstate_poll_fds() returns */
+	time_t	published;
+} driver_stats;
+
+/* the current adaptive polling interval */
+static time_t	poll_interval_cur = 0;
+
+/* Is the device in a state where polling it less often is fine? */
+static int poll_device_quiet(void)
+{
+	const char	*val;
+	char	buf[SMALLBUF], *tok, *last = NULL;
+
+	if (dstate_is_stale())
+		return 0;
+
+	if ((val = dstate_getinfo("ups.alarm")) != NULL && *val)
+		return 0;
+
+	/* devices without a status (e.g. some PDUs) can not leave OL */
+	if ((val = dstate_getinfo("ups.status")) == NULL)
+		return 1;
+
+	snprintf(buf, sizeof(buf), "%s", val);
+	for (tok = strtok_r(buf, " ", &last); tok; tok = strtok_r(NULL, " ", &last)) {
+		if (strcmp(tok, "OL") && strcmp(tok, "CHRG"))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Pick the delay till the next update cycle: back to pollinterval when
+ * anything happened (data changed, the driver was woken up by its extra
+ * fd, the device left the on-line state or raised an alarm), otherwise
+ * twice the previous one, up to pollinterval_max */
+static time_t poll_interval_next(int changed, int woken)
+{
+	time_t	prev = poll_interval_cur;
+
+	if (poll_changes_reported >= 0)
+		changed = poll_changes_reported;
+	poll_changes_reported = -1;
+
+	if (poll_interval_max <= poll_interval
+	|| changed || woken || !poll_device_quiet()
+	|| poll_interval_cur < poll_interval
+	) {
+		poll_interval_cur = poll_interval;
+	} else {
+		poll_interval_cur *= 2;
+		if (poll_interval_cur > poll_interval_max)
+			poll_interval_cur = poll_interval_max;
+	}
+
+	if (poll_interval_cur != prev)
+		upsdebugx(2, "%s: next update in %" PRIdMAX " sec",
+			__func__, (intmax_t)poll_interval_cur);
+
+	return poll_interval_cur;
+}
+
+static void driver_stats_updateinfo(const st_tree_timespec_t *start)
+{
+	st_tree_timespec_t	now;
+	double	d;
+	uintmax_t	usec = 0;
+	uintmax_t	changed, suppressed;
+
+	if (state_get_timestamp(&now) == 0) {
+		d = difftime_st_tree_timespec(now, *start);
+		if (d > 0)
+			usec = (uintmax_t)(d * 1000000.0);
+	}
+
+	driver_stats.updateinfo_count++;
+	driver_stats.updateinfo_usec += usec;
+	driver_stats.updateinfo_usec_last = usec;
+	if (usec > driver_stats.updateinfo_usec_max)
+		driver_stats.updateinfo_usec_max = usec;
+
+	/* do not clutter the data dump with our own bookkeeping */
+	if (dump_data)
+		return;
+
+	if (driver_stats.published
+	&& difftime(time(NULL), driver_stats.published) < DRIVER_STATS_INTERVAL)
+		return;
+	time(&driver_stats.published);
+
+	dstate_get_setinfo_counters(&changed, &suppressed);
+
+	dstate_setinfo("driver.stats.updateinfo.count", "%" PRIuMAX, driver_stats.updateinfo_count);
+	dstate_setinfo("driver.stats.updateinfo.usec.last", "%" PRIuMAX, driver_stats.updateinfo_usec_last);
+	dstate_setinfo("driver.stats.updateinfo.usec.max", "%" PRIuMAX, driver_stats.updateinfo_usec_max);
+	dstate_setinfo("driver.stats.updateinfo.usec.avg", "%" PRIuMAX,
+		driver_stats.updateinfo_usec / driver_stats.updateinfo_count);
+	dstate_setinfo("driver.stats.poll.wakeups", "%" PRIuMAX, driver_stats.poll_wakeups);
+	dstate_setinfo("driver.stats.poll.interval", "%" PRIdMAX, (intmax_t)poll_interval_cur);
+	dstate_setinfo("driver.stats.setinfo.changed", "%" PRIuMAX, changed);
+	dstate_setinfo("driver.stats.setinfo.suppressed", "%" PRIuMAX, suppressed);
+}
+#endif /* DRIVERS_MAIN_WITHOUT_MAIN */
+
 /* This source file is used in some unit tests to mock realistic driver
  * behavior - using a production driver skeleton, but their own main().
  * It is called from main-stub.c in shared-mode builds.
@@ -2380,7 +2881,7 @@ int main(int argc, char **argv)
 {
 	struct	passwd	*new_uid = NULL;
 	int	opt_ret = 0, do_forceshutdown = 0, i;
-	int	update_count = 0;
+	int	update_count = 0, woken = 0;
 
 # ifndef WIN32
 	int	cmd = 0;
@@ -2532,6 +3033,7 @@ int main(int argc, char **argv)
 
 				upsname = optarg;
 				upsname_found = 1;
+				upsconf_skipped = 1;
 				break;
 			case 'F':
 				if (foreground > 0) {
@@ -3289,120 +3791,26 @@ int main(int argc, char **argv)
 	/* now we can start servicing requests */
 	/* Only write pid if we're not just dumping data, for discovery */
 	if (!dump_data) {
+		upsdrv_hosted_t	*dev, *prev;
 		char * sockname = dstate_init(progname, upsname);
-		/* Normally we stick to the built-in account info,
-		 * so if they were not over-ridden - no-op here:
-		 */
-		if (strcmp(group, RUN_AS_GROUP)
-		||  strcmp(user,  RUN_AS_USER)
-		) {
-# ifndef WIN32
-			int allOk = 1;
-			/* Use file descriptor, not name, to first check and then manipulate permissions:
-			 *   https://cwe.mitre.org/data/definitions/367.html
-			 *   https://wiki.sei.cmu.edu/confluence/display/c/FIO01-C.+Be+careful+using+functions+that+use+file+names+for+identification
-			 * Alas, Unix sockets on most systems can not be open()ed
-			 * so there is no file descriptor to manipulate.
-			 * Fall back to name-based "les secure" operations then.
-			 */
-			TYPE_FD fd = ERROR_FD;
-
-			/* Tune group access permission to the pipe,
-			 * so that upsd can access it (using the
-			 * specified or retained default group):
-			 */
-			struct group *grp = getgrnam(group);
-			upsdebugx(1, "Group and/or user account for this driver "
-				"was customized ('%s:%s') compared to built-in "
-				"defaults. Fixing socket '%s' ownership/access.",
-				user, group, sockname);
-
-			if (grp == NULL) {
-				upsdebug_with_errno(1, "WARNING: could not resolve group name '%s'", group);
-				allOk = 0;
-				goto sockname_ownership_finished;
-			} else {
-				struct stat statbuf;
-				mode_t mode;
-
-				if (INVALID_FD((fd = open(sockname, O_RDWR | O_APPEND)))) {
-					upsdebug_with_errno(1, "WARNING: opening socket file for stat/chown failed,"
-						" which is rather typical for Unix socket handling");
-					allOk = 0;
-				}
 
-				if ((VALID_FD(fd) && fstat(fd, &statbuf))
-				||  (INVALID_FD(fd) && stat(sockname, &statbuf))
-				) {
-					upsdebug_with_errno(1, "WARNING: stat for chown of socket file failed");
-					allOk = 0;
-					if (INVALID_FD(fd)) {
-						/* Can not proceed with ops below */
-						goto sockname_ownership_finished;
-					}
-				} else {
-					/* Maybe open() and some stat() succeeed so far */
-					allOk = 1;
-					/* Here we do a portable chgrp() essentially: */
-					if ((VALID_FD(fd) && fchown(fd, statbuf.st_uid, grp->gr_gid))
-					||  (INVALID_FD(fd) && chown(sockname, statbuf.st_uid, grp->gr_gid))
-					) {
-						upsdebug_with_errno(1, "WARNING: chown of socket file failed");
-						allOk = 0;
-					}
-				}
-
-				/* Refresh file info */
-				if ((VALID_FD(fd) && fstat(fd, &statbuf))
-				||  (INVALID_FD(fd) && stat(sockname, &statbuf))
-				) {
-					/* Logically we'd fail chown above if file
-					 * does not exist or is not accessible */
-					upsdebug_with_errno(1, "WARNING: stat for chmod of socket file failed");
-					allOk = 0;
-				} else {
-					/* chmod g+rw sockname */
-					mode = statbuf.st_mode;
-					mode |= S_IWGRP;
-					mode |= S_IRGRP;
-					if ((VALID_FD(fd) && fchmod(fd, mode))
-					|| (INVALID_FD(fd) && chmod(sockname, mode))
-					) {
-						upsdebug_with_errno(1, "WARNING: chmod of socket file failed");
-						allOk = 0;
-					}
-				}
-			}
-
-sockname_ownership_finished:
-			if (allOk) {
-				upsdebugx(1, "Group access for this driver successfully fixed "
-					"(using file %s based methods)",
-					VALID_FD(fd) ? "descriptor" : "name");
-			} else {
-				upsdebugx(0, "WARNING: Needed to fix group access "
-					"to filesystem socket of this driver, but failed; "
-					"run the driver with more debugging to see how exactly.\n"
-					"Consumers of the socket, such as upsd data server, "
-					"can fail to interact with the driver and represent "
-					"the device: %s",
-					sockname);
-			}
+		sockname_access(sockname);
+		free(sockname);
 
-			if (VALID_FD(fd)) {
-				close(fd);
-				fd = ERROR_FD;
-			}
-# else	/* WIN32 */
-			/* NUT_WIN32_INCOMPLETE(); */
-			upsdebugx(1, "Options for alternate user/group are not implemented on this platform");
-# endif	/* WIN32 */
+		/* and those of the devices hosted by this driver */
+		for (dev = hosted_h; dev; dev = dev->next) {
+			prev = upsdrv_hosted_select(dev);
+			sockname = dstate_init(progname, dev->name);
+			sockname_access(sockname);
+			free(sockname);
+			upsdrv_hosted_select(prev);
 		}
-		free(sockname);
 	}
 
 	/* The poll_interval may have been changed from the default */
 	dstate_setinfo("driver.parameter.pollinterval", "%" PRIdMAX, (intmax_t)poll_interval);
+	if (poll_interval_max > 0)
+		dstate_setinfo("driver.parameter.pollinterval_max", "%" PRIdMAX, (intmax_t)poll_interval_max);
 
 	/* The synchronous option may have been changed from the default */
 	dstate_setinfo("driver.parameter.synchronous", "%s",
@@ -3486,17 +3894,22 @@ sockname_ownership_finished:
 		upsnotify(NOTIFY_STATE_READY_WITH_PID, NULL);
 	}
 
-	memset(&previous_battery_charge_timestamp, 0, sizeof(previous_battery_charge_timestamp));
+	/* keep syslog writes out of the device update cycle */
+	if (!dump_data)
+		upslog_async_enable(SIZE_MAX);
+
+	poll_interval_cur = poll_interval;
 	while (!exit_flag) {
-		struct timeval	timeout;
-		const st_tree_t	*dstate_entry = NULL;
+		struct timeval	timeout, now;
+		st_tree_timespec_t	updateinfo_start;
+		upsdrv_hosted_t	*dev;
+		uintmax_t	changes_before, changes_after;
 
 		if (!dump_data) {
 			upsnotify(NOTIFY_STATE_WATCHDOG, NULL);
 		}
 
 		gettimeofday(&timeout, NULL);
-		timeout.tv_sec += poll_interval;
 
 		if (reconnect_count > 0) {
 			dstate_setinfo("driver.reconnect_count", "%d", reconnect_count);
@@ -3507,21 +3920,24 @@ sockname_ownership_finished:
 		 * charge vs. its previous value to e.g. report "CHRG" status.
 		 * TODO: Eventually provide a common `runtimecal` fallback to all?
 		 */
-		if ((dstate_entry = dstate_tree_find("battery.charge")) && dstate_entry->val) {
-			double	d = -1.0;
-
-			if (str_to_double(dstate_entry->val, &d, 10) && d >= 0.0) {
-				if (!d_equal(previous_battery_charge_value, d)) {
-					previous_battery_charge_value = d;
-					previous_battery_charge_timestamp = dstate_entry->lastset;
-				}
-			}
+		dstate_remember_battery_charge();
+		for (dev = hosted_h; dev; dev = dev->next) {
+			upsdrv_hosted_t	*prev = upsdrv_hosted_select(dev);
+			dstate_remember_battery_charge();
+			upsdrv_hosted_select(prev);
 		}
 
 		dstate_setinfo("driver.state", "updateinfo");
+		state_get_timestamp(&updateinfo_start);
+		dstate_get_setinfo_counters(&changes_before, NULL);
 		upsdrv_callbacks.upsdrv_updateinfo();
+		dstate_get_setinfo_counters(&changes_after, NULL);
+		driver_stats_updateinfo(&updateinfo_start);
 		dstate_setinfo("driver.state", "quiet");
 
+		timeout.tv_sec += poll_interval_next(changes_after != changes_before, woken);
+		woken = 0;
+
 		/* Dump the data tree (in upsc-like format) to stdout and exit */
 		if (dump_data) {
 			/* Wait for 'dump_data' update loops to ensure data completion */
@@ -3534,10 +3950,20 @@ sockname_ownership_finished:
 				update_count++;
 		}
 		else {
-			while (!dstate_poll_fds(timeout, extrafd) && !exit_flag) {
+			/* with hosted devices, their readers are served too */
+			while (!(hosted_h ? dstate_poll_all(timeout, extrafd)
+				: dstate_poll_fds(timeout, extrafd)) && !exit_flag
+			) {
 				/* repeat until time is up or extrafd has data */
+				driver_stats.poll_wakeups++;
 				handle_reload_flag();
 			}
+			driver_stats.poll_wakeups++;
+
+			/* returned early: the driver has something to read */
+			gettimeofday(&now, NULL);
+			woken = (now.tv_sec < timeout.tv_sec
+				|| (now.tv_sec == timeout.tv_sec && now.tv_usec < timeout.tv_usec));
 		}
 
 		handle_reload_flag();
@@ -16,7 +16,7 @@ extern char		*device_path, *device_sdcommands;
 extern int		broken_driver, experimental_driver,
 			do_lock_port, exit_flag, handling_upsdrv_shutdown;
 extern TYPE_FD		upsfd, extrafd;
-extern time_t		poll_interval;
+extern time_t		poll_interval, poll_interval_max;
 
 /* We allow for aliases to certain program names (e.g. when renaming a driver
  * between "old" and "new" and default implementations, it should accept both
@@ -112,6 +112,32 @@ typedef struct vartab_s {
 void addvar(int vartype, const char *name, const char *desc);
 void addvar_reloadable(int vartype, const char *name, const char *desc);
 
+/* A device of another ups.conf section ("hosted_by = <our section>",
+ * same driver) which this driver process serves as well: it has its
+ * own settings, port and dstate instance (so its own socket). */
+typedef struct upsdrv_hosted_s {
+	char	*name;		/* its ups.conf section */
+	char	*port;
+	vartab_t	*vartab;	/* its settings, same names as ours */
+	struct dstate_ctx_s	*ctx;	/* a dstate_ctx_t */
+	void	*priv;		/* for the driver */
+	struct upsdrv_hosted_s	*next;
+} upsdrv_hosted_t;
+
+/* Find and read the sections hosted by ours (once, e.g. from
+ * upsdrv_initups()); returns the list, NULL if there are none.
+ * Their sockets are created along with ours, and the main loop
+ * then waits for the readers of all instances at once. */
+upsdrv_hosted_t *upsdrv_hosted_load(void);
+
+/* Make getval(), testvar(), upsname, device_path and dstate calls
+ * refer to a hosted device (NULL: our own); returns the previous one */
+upsdrv_hosted_t *upsdrv_hosted_select(upsdrv_hosted_t *dev);
+
+/* The hosted device of a dstate instance, NULL if it is none of them
+ * (e.g. to tell whose reader sent an INSTCMD or SET) */
+upsdrv_hosted_t *upsdrv_hosted_find_ctx(const struct dstate_ctx_s *ctx);
+
 typedef enum reconnect_state {
 	RECONNECT_SUCCESS = 0,
 	RECONNECT_TRYING,
@@ -196,12 +222,20 @@ typedef struct upsdrv_info_s {
  */
 extern upsdrv_info_t	upsdrv_info;
 
+/* With adaptive polling (pollinterval_max), the main loop guesses from
+ * dstate whether an update cycle changed anything. A driver which knows
+ * better (e.g. it skipped reading the device, or a change does not show
+ * in dstate yet) may tell from upsdrv_updateinfo(): 0 = nothing changed,
+ * 1 = something did (poll fast again). The hint applies to one cycle. */
+void poll_report_changes(int changed);
+
 /* functions and data possibly used via libdummy_mockdrv.la for unit-tests */
 #ifdef DRIVERS_MAIN_WITHOUT_MAIN
 extern vartab_t *vartab_h;
 void dparam_setinfo(const char *var, const char *val);
 void storeval(const char *var, char *val);
 void vartab_free(void);
+void upsdrv_hosted_free(void);
 void setup_signals(void);
 #endif /* DRIVERS_MAIN_WITHOUT_MAIN */
 
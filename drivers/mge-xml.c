@@ -39,7 +39,7 @@
 #include "wincompat.h"
 #endif	/* WIN32 */
 
-#define MGE_XML_VERSION		"MGEXML/0.36"
+#define MGE_XML_VERSION		"MGEXML/0.37"
 
 #define MGE_XML_INITUPS		"/"
 #define MGE_XML_INITINFO	"/mgeups/product.xml /product.xml /ws/product.xml"
@@ -1147,6 +1147,15 @@ static xml_info_t mge_xml2nut[] = {
 	{ NULL, 0, 0, NULL, 0, 0, NULL }
 };
 
+/* Raw XML value last seen for each mge_xml2nut[] entry, and what it was
+ * converted to; repeated values (most of them, from one poll to the next)
+ * are neither converted nor set in dstate again as long as the variable
+ * still holds what we set */
+static struct mge_xml2nut_last_s {
+	char	*raw;
+	char	*value;
+} mge_xml2nut_last[sizeof(mge_xml2nut) / sizeof(xml_info_t)];
+
 /* A start-element callback for element with given namespace/name. */
 static int mge_xml_startelm_cb(void *userdata, int parent, const char *nspace, const char *name, const char **atts)
 {
@@ -1469,6 +1478,7 @@ static int mge_xml_cdata_cb(void *userdata, int state, const char *cdata, size_t
 static int mge_xml_endelm_cb(void *userdata, int state, const char *nspace, const char *name)
 {
 	xml_info_t	*info;
+	struct mge_xml2nut_last_s	*last;
 	const char	*value;
 	NUT_UNUSED_VARIABLE(userdata);
 	NUT_UNUSED_VARIABLE(nspace);
@@ -1497,6 +1507,15 @@ static int mge_xml_endelm_cb(void *userdata, int state, const char *nspace, cons
 				return 0;
 			}
 
+			last = &mge_xml2nut_last[info - mge_xml2nut];
+			if (last->raw && last->value && !strcmp(last->raw, val)
+			&&  (value = dstate_getinfo(info->nutname)) != NULL
+			&&  !strcmp(value, last->value)
+			) {
+				upsdebugx(4, "-> XML variable %s [%s] unchanged", var, val);
+				return 0;
+			}
+
 			if (info->convert) {
 				value = info->convert(val);
 				upsdebugx(4, "-> XML variable %s [%s] which maps to NUT variable %s was converted to value %s for the NUT driver state", var, val, info->nutname, value);
@@ -1504,8 +1523,14 @@ static int mge_xml_endelm_cb(void *userdata, int state, const char *nspace, cons
 				value = val;
 			}
 
+			free(last->raw);
+			free(last->value);
+			last->raw = xstrdup(val);
+			last->value = NULL;
+
 			if (value != NULL) {
 				dstate_setinfo(info->nutname, "%s", value);
+				last->value = xstrdup(value);
 			}
 
 			return 0;
@@ -0,0 +1,545 @@
+/* modbus-plan.c - coalescing read planner for Modbus drivers
+ *
+ * Copyright (C) 2026 Network UPS Tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "config.h"	/* must be the first header */
+
+#include "common.h"
+#include "modbus-plan.h"
+
+#include <string.h>
+
+/* Refresh cycles after which ranges which failed are planned as usual
+ * again, doubled for each failure in a row up to the maximum: a device
+ * which was only busy or rebooting gets its block reads back soon, one
+ * with a real hole in the register map is not probed often */
+#define MODBUS_PLAN_RETRY_CYCLES	16
+#define MODBUS_PLAN_RETRY_CYCLES_MAX	1024
+
+/* A range requested by the driver */
+typedef struct {
+	modbus_plan_type_t	type;
+	int	addr;
+	int	nb;
+	int	nomerge;	/* its merged block failed, read it alone */
+	int	skip;		/* failed even alone, the driver reads it */
+	int	retry_in;	/* refreshes until the flags above are cleared */
+	int	strikes;	/* failures in a row */
+} modbus_plan_point_t;
+
+/* A single read request covering one or more points */
+typedef struct {
+	modbus_plan_type_t	type;
+	int	addr;
+	int	nb;
+	size_t	first_point, num_points;
+	size_t	data_off;	/* in plan->data */
+	int	valid;		/* read OK by the last refresh */
+} modbus_plan_block_t;
+
+struct modbus_plan_s {
+	modbus_plan_reader_t	reader;
+	void	*reader_arg;
+
+	int	max_registers, max_bits, max_gap;
+
+	/* kept sorted by type and address */
+	modbus_plan_point_t	*points;
+	size_t	num_points, alloc_points;
+
+	modbus_plan_block_t	*blocks;
+	size_t	num_blocks, alloc_blocks;
+	int	planned;
+
+	/* values of all blocks, bits are stored one per item too */
+	uint16_t	*data;
+	size_t	alloc_data;
+
+	uint8_t	bits[MODBUS_PLAN_MAX_BITS];
+};
+
+static int plan_is_bits(modbus_plan_type_t type)
+{
+	return (type == MODBUS_PLAN_COIL || type == MODBUS_PLAN_INPUT_BIT);
+}
+
+static int plan_limit(const modbus_plan_t *plan, modbus_plan_type_t type)
+{
+	return plan_is_bits(type) ? plan->max_bits : plan->max_registers;
+}
+
+static int point_cmp(const modbus_plan_point_t *a, modbus_plan_type_t type, int addr, int nb)
+{
+	if (a->type != type)
+		return (a->type < type) ? -1 : 1;
+	if (a->addr != addr)
+		return (a->addr < addr) ? -1 : 1;
+	if (a->nb != nb)
+		return (a->nb < nb) ? -1 : 1;
+	return 0;
+}
+
+modbus_plan_t *modbus_plan_new(modbus_plan_reader_t reader, void *arg)
+{
+	modbus_plan_t	*plan = (modbus_plan_t *)xcalloc(1, sizeof(*plan));
+
+	plan->reader = reader;
+	plan->reader_arg = arg;
+	plan->max_registers = MODBUS_PLAN_MAX_REGISTERS;
+	plan->max_bits = MODBUS_PLAN_MAX_BITS;
+	plan->max_gap = MODBUS_PLAN_MAX_GAP;
+
+	return plan;
+}
+
+void modbus_plan_free(modbus_plan_t *plan)
+{
+	if (!plan)
+		return;
+
+	free(plan->points);
+	free(plan->blocks);
+	free(plan->data);
+	free(plan);
+}
+
+int modbus_plan_configure(modbus_plan_t *plan, const char *max_registers,
+	const char *max_bits, const char *max_gap)
+{
+	int	regs = 0, bits = 0, gap = -1, ret = 0;
+
+	if (max_registers && (!str_to_int(max_registers, &regs, 10)
+	|| regs < 1 || regs > MODBUS_PLAN_MAX_REGISTERS)
+	) {
+		upslogx(LOG_ERR, "Invalid maximum of registers per request: %s (must be 1..%d)",
+			max_registers, MODBUS_PLAN_MAX_REGISTERS);
+		regs = 0;
+		ret = -1;
+	}
+
+	if (max_bits && (!str_to_int(max_bits, &bits, 10)
+	|| bits < 1 || bits > MODBUS_PLAN_MAX_BITS)
+	) {
+		upslogx(LOG_ERR, "Invalid maximum of bits per request: %s (must be 1..%d)",
+			max_bits, MODBUS_PLAN_MAX_BITS);
+		bits = 0;
+		ret = -1;
+	}
+
+	if (max_gap && (!str_to_int(max_gap, &gap, 10) || gap < 0)) {
+		upslogx(LOG_ERR, "Invalid gap to merge read requests over: %s", max_gap);
+		gap = -1;
+		ret = -1;
+	}
+
+	modbus_plan_set_limits(plan, regs, bits, gap);
+
+	return ret;
+}
+
+void modbus_plan_set_limits(modbus_plan_t *plan, int max_registers, int max_bits, int max_gap)
+{
+	if (!plan)
+		return;
+
+	if (max_registers > 0)
+		plan->max_registers = (max_registers < MODBUS_PLAN_MAX_REGISTERS)
+			? max_registers : MODBUS_PLAN_MAX_REGISTERS;
+	if (max_bits > 0)
+		plan->max_bits = (max_bits < MODBUS_PLAN_MAX_BITS)
+			? max_bits : MODBUS_PLAN_MAX_BITS;
+	if (max_gap >= 0)
+		plan->max_gap = max_gap;
+
+	plan->planned = 0;
+}
+
+int modbus_plan_add(modbus_plan_t *plan, modbus_plan_type_t type, int addr, int nb)
+{
+	size_t	i;
+
+	if (!plan || (int)type < 0 || type >= MODBUS_PLAN_NUM_TYPES
+	|| addr < 0 || addr > 0xFFFF || nb < 1 || addr + nb > 0x10000
+	|| nb > (plan_is_bits(type) ? MODBUS_PLAN_MAX_BITS : MODBUS_PLAN_MAX_REGISTERS)
+	) {
+		return -1;
+	}
+
+	/* find the insertion point, the list is short */
+	for (i = 0; i < plan->num_points; i++) {
+		int	c = point_cmp(&plan->points[i], type, addr, nb);
+
+		if (c == 0)
+			return 0;	/* already known */
+		if (c > 0)
+			break;
+	}
+
+	if (plan->num_points == plan->alloc_points) {
+		plan->alloc_points = plan->alloc_points ? plan->alloc_points * 2 : 16;
+		plan->points = (modbus_plan_point_t *)xrealloc(plan->points,
+			plan->alloc_points * sizeof(*plan->points));
+	}
+
+	memmove(&plan->points[i + 1], &plan->points[i],
+		(plan->num_points - i) * sizeof(*plan->points));
+	plan->points[i].type = type;
+	plan->points[i].addr = addr;
+	plan->points[i].nb = nb;
+	plan->points[i].nomerge = 0;
+	plan->points[i].skip = 0;
+	plan->points[i].retry_in = 0;
+	plan->points[i].strikes = 0;
+	plan->num_points++;
+
+	plan->planned = 0;
+	return 0;
+}
+
+void modbus_plan_clear(modbus_plan_t *plan)
+{
+	if (!plan)
+		return;
+
+	plan->num_points = 0;
+	plan->num_blocks = 0;
+	plan->planned = 0;
+}
+
+static modbus_plan_block_t *plan_new_block(modbus_plan_t *plan, size_t point)
+{
+	modbus_plan_block_t	*block;
+
+	if (plan->num_blocks == plan->alloc_blocks) {
+		plan->alloc_blocks = plan->alloc_blocks ? plan->alloc_blocks * 2 : 8;
+		plan->blocks = (modbus_plan_block_t *)xrealloc(plan->blocks,
+			plan->alloc_blocks * sizeof(*plan->blocks));
+	}
+
+	block = &plan->blocks[plan->num_blocks++];
+	block->type = plan->points[point].type;
+	block->addr = plan->points[point].addr;
+	block->nb = plan->points[point].nb;
+	block->first_point = point;
+	block->num_points = 1;
+	block->data_off = 0;
+	block->valid = 0;
+
+	return block;
+}
+
+/* Walk the sorted points and extend the current block while the next
+ * range is close enough and the result still fits into one request;
+ * a range larger than one request is split over several blocks */
+static void plan_build(modbus_plan_t *plan)
+{
+	modbus_plan_block_t	*block = NULL;
+	size_t	i, data_len = 0;
+	int	limit;
+
+	plan->num_blocks = 0;
+
+	for (i = 0; i < plan->num_points; i++) {
+		const modbus_plan_point_t	*p = &plan->points[i];
+		int	block_end, end;
+
+		if (p->skip) {
+			/* blocks cover consecutive points only */
+			block = NULL;
+			continue;
+		}
+
+		if (block && block->type == p->type && !p->nomerge
+		&& !plan->points[i - 1].nomerge
+		) {
+			block_end = block->addr + block->nb;
+			end = p->addr + p->nb;
+			if (end < block_end)
+				end = block_end;
+
+			if (p->addr - block_end <= plan->max_gap
+			&& end - block->addr <= plan_limit(plan, p->type)
+			) {
+				block->nb = end - block->addr;
+				block->num_points++;
+				continue;
+			}
+		}
+
+		block = plan_new_block(plan, i);
+		limit = plan_limit(plan, p->type);
+		while (block->nb > limit) {
+			int	rest_addr = block->addr + limit, rest_nb = block->nb - limit;
+
+			block->nb = limit;
+			block = plan_new_block(plan, i);
+			block->addr = rest_addr;
+			block->nb = rest_nb;
+		}
+	}
+
+	for (i = 0; i < plan->num_blocks; i++) {
+		plan->blocks[i].data_off = data_len;
+		data_len += (size_t)plan->blocks[i].nb;
+	}
+
+	if (data_len > plan->alloc_data) {
+		plan->alloc_data = data_len;
+		plan->data = (uint16_t *)xrealloc(plan->data,
+			plan->alloc_data * sizeof(*plan->data));
+	}
+
+	plan->planned = 1;
+
+	upsdebugx(3, "%s: %" PRIuSIZE " ranges are read with %" PRIuSIZE " requests",
+		__func__, plan->num_points, plan->num_blocks);
+}
+
+size_t modbus_plan_blocks(modbus_plan_t *plan)
+{
+	if (!plan)
+		return 0;
+
+	if (!plan->planned)
+		plan_build(plan);
+
+	return plan->num_blocks;
+}
+
+void modbus_plan_retry(modbus_plan_t *plan)
+{
+	size_t	i;
+
+	if (!plan)
+		return;
+
+	for (i = 0; i < plan->num_points; i++) {
+		modbus_plan_point_t	*p = &plan->points[i];
+
+		if (p->nomerge || p->skip)
+			plan->planned = 0;
+
+		p->nomerge = 0;
+		p->skip = 0;
+		p->retry_in = 0;
+		p->strikes = 0;
+	}
+}
+
+/* Count a failure of the point, set when to try it as planned again */
+static void plan_penalize(modbus_plan_point_t *p)
+{
+	int	cycles = MODBUS_PLAN_RETRY_CYCLES, i;
+
+	if (p->strikes < 30)
+		p->strikes++;
+
+	for (i = 1; i < p->strikes && cycles < MODBUS_PLAN_RETRY_CYCLES_MAX; i++)
+		cycles *= 2;
+	if (cycles > MODBUS_PLAN_RETRY_CYCLES_MAX)
+		cycles = MODBUS_PLAN_RETRY_CYCLES_MAX;
+
+	p->retry_in = cycles;
+}
+
+size_t modbus_plan_refresh(modbus_plan_t *plan)
+{
+	size_t	i, failed = 0;
+
+	if (!plan || !plan->reader)
+		return 0;
+
+	for (i = 0; i < plan->num_points; i++) {
+		modbus_plan_point_t	*p = &plan->points[i];
+
+		if ((p->nomerge || p->skip) && --p->retry_in <= 0) {
+			upsdebugx(2, "%s: planning %d items of type %d at %d as usual again",
+				__func__, p->nb, (int)p->type, p->addr);
+			p->nomerge = 0;
+			p->skip = 0;
+			plan->planned = 0;
+		}
+	}
+
+	if (!plan->planned)
+		plan_build(plan);
+
+	for (i = 0; i < plan->num_blocks; i++) {
+		modbus_plan_block_t	*block = &plan->blocks[i];
+		uint16_t	*dest = &plan->data[block->data_off];
+		int	r;
+
+		if (plan_is_bits(block->type)) {
+			r = plan->reader(plan->reader_arg, block->type,
+				block->addr, block->nb, plan->bits);
+			if (r == block->nb) {
+				int	j;
+
+				for (j = 0; j < block->nb; j++)
+					dest[j] = plan->bits[j];
+			}
+		} else {
+			r = plan->reader(plan->reader_arg, block->type,
+				block->addr, block->nb, dest);
+		}
+
+		block->valid = (r == block->nb);
+		if (!block->valid) {
+			failed++;
+		} else {
+			size_t	j;
+
+			/* a success as planned ends a row of failures */
+			for (j = 0; j < block->num_points; j++) {
+				modbus_plan_point_t	*p = &plan->points[block->first_point + j];
+
+				if (!p->nomerge && !p->skip)
+					p->strikes = 0;
+			}
+		}
+	}
+
+	if (failed == 0)
+		return 0;
+
+	for (i = 0; i < plan->num_blocks; i++) {
+		modbus_plan_block_t	*block = &plan->blocks[i];
+		size_t	j;
+
+		if (block->valid)
+			continue;
+
+		if (block->num_points > 1) {
+			/* Probably bridged a hole in the register map:
+			 * read these ranges one by one from now on */
+			upsdebugx(2, "%s: reading %d items of type %d at %d failed, "
+				"will not merge its %" PRIuSIZE " ranges anymore",
+				__func__, block->nb, (int)block->type, block->addr,
+				block->num_points);
+
+			for (j = 0; j < block->num_points; j++) {
+				plan->points[block->first_point + j].nomerge = 1;
+				plan_penalize(&plan->points[block->first_point + j]);
+			}
+		} else if (failed < plan->num_blocks) {
+			/* A range which fails alone: leave it to the driver,
+			 * rather than have it read (and fail) twice per cycle.
+			 * Unless nothing could be read at all: the device (or
+			 * link) is probably down then, not the range missing */
+			upsdebugx(2, "%s: reading %d items of type %d at %d failed, "
+				"will not plan it anymore",
+				__func__, block->nb, (int)block->type, block->addr);
+
+			plan->points[block->first_point].skip = 1;
+			plan_penalize(&plan->points[block->first_point]);
+		} else {
+			continue;
+		}
+
+		/* Keep what was read, the new layout applies next time */
+		plan->planned = 0;
+	}
+
+	return failed;
+}
+
+void modbus_plan_invalidate(modbus_plan_t *plan)
+{
+	size_t	i;
+
+	if (!plan)
+		return;
+
+	for (i = 0; i < plan->num_blocks; i++)
+		plan->blocks[i].valid = 0;
+}
+
+/* A block with valid data containing <addr>, or NULL */
+static const modbus_plan_block_t *plan_find(const modbus_plan_t *plan,
+	modbus_plan_type_t type, int addr)
+{
+	size_t	lo, hi;
+
+	/* blocks are sorted by type and address: find the first one past
+	 * <addr>, then look back at those which may contain it (blocks of
+	 * ranges which are not merged anymore may overlap others) */
+	lo = 0;
+	hi = plan->num_blocks;
+	while (lo < hi) {
+		size_t	mid = lo + (hi - lo) / 2;
+		const modbus_plan_block_t	*block = &plan->blocks[mid];
+
+		if (block->type < type
+		|| (block->type == type && block->addr <= addr)
+		) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	while (lo-- > 0) {
+		const modbus_plan_block_t	*block = &plan->blocks[lo];
+
+		if (block->type != type)
+			break;
+
+		if (block->valid && addr < block->addr + block->nb)
+			return block;
+	}
+
+	return NULL;
+}
+
+int modbus_plan_fetch(const modbus_plan_t *plan, modbus_plan_type_t type,
+	int addr, int nb, void *dest)
+{
+	int	done = 0;
+
+	if (!plan || !dest || nb < 1)
+		return -1;
+
+	/* a range may be served from several blocks, e.g. when it was
+	 * split by the request size limit */
+	while (done < nb) {
+		const modbus_plan_block_t	*block = plan_find(plan, type, addr + done);
+		const uint16_t	*src;
+		int	j, count;
+
+		if (!block)
+			return -1;
+
+		count = block->addr + block->nb - (addr + done);
+		if (count > nb - done)
+			count = nb - done;
+
+		src = &plan->data[block->data_off + (size_t)(addr + done - block->addr)];
+		if (plan_is_bits(type)) {
+			uint8_t	*bits = (uint8_t *)dest + done;
+
+			for (j = 0; j < count; j++)
+				bits[j] = (uint8_t)src[j];
+		} else {
+			memcpy((uint16_t *)dest + done, src, (size_t)count * sizeof(uint16_t));
+		}
+
+		done += count;
+	}
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+/* modbus-plan.h - coalescing read planner for Modbus drivers
+ *
+ * Copyright (C) 2026 Network UPS Tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef NUT_MODBUS_PLAN_H_SEEN
+#define NUT_MODBUS_PLAN_H_SEEN 1
+
+#include <stddef.h>
+#include "nut_stdint.h"
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+/* A driver registers the (type, address, count) ranges it needs during
+ * an update cycle. The planner merges adjacent or nearby ranges of the
+ * same type into as few block reads as the per-request limits allow,
+ * reads them all at the start of the cycle with modbus_plan_refresh(),
+ * and then serves individual values from those blocks with
+ * modbus_plan_fetch(). Ranges whose merged block failed to read (e.g.
+ * a hole in the device register map bridged by the merge) are not
+ * merged with their neighbours anymore, and ranges which fail to read
+ * on their own are dropped from the plan (the driver reads them itself
+ * then), unless all requests of that refresh failed, as when the device
+ * is not answering. Such ranges are planned as usual again after some
+ * refresh cycles (more of them for each failure in a row), or when the
+ * driver calls modbus_plan_retry(), e.g. after it reconnected.
+ *
+ * The planner does not depend on libmodbus itself: the driver provides
+ * the function which does the actual reads.
+ */
+
+typedef enum {
+	MODBUS_PLAN_COIL = 0,
+	MODBUS_PLAN_INPUT_BIT,
+	MODBUS_PLAN_INPUT_REGISTER,
+	MODBUS_PLAN_HOLDING_REGISTER,
+	MODBUS_PLAN_NUM_TYPES
+} modbus_plan_type_t;
+
+/* Protocol limits for one read request (Modbus Application Protocol
+ * v1.1b3, same as MODBUS_MAX_READ_REGISTERS/BITS in libmodbus) */
+#define MODBUS_PLAN_MAX_REGISTERS	125
+#define MODBUS_PLAN_MAX_BITS		2000
+/* Default count of unneeded registers or bits read to join two ranges */
+#define MODBUS_PLAN_MAX_GAP		8
+
+/* Read <nb> bits (one uint8_t each) or registers (uint16_t each) of the
+ * given type starting at <addr> into <dest>. Should return the count of
+ * items read (<nb>) on success or -1 on error, like libmodbus does. */
+typedef int (*modbus_plan_reader_t)(void *arg, modbus_plan_type_t type,
+	int addr, int nb, void *dest);
+
+typedef struct modbus_plan_s	modbus_plan_t;
+
+modbus_plan_t *modbus_plan_new(modbus_plan_reader_t reader, void *arg);
+void modbus_plan_free(modbus_plan_t *plan);
+
+/* Per-device limits: maximum registers and bits in one request (values
+ * <= 0 keep the current setting), and how many unneeded items may be
+ * read to merge two ranges (negative value keeps the current setting) */
+void modbus_plan_set_limits(modbus_plan_t *plan, int max_registers,
+	int max_bits, int max_gap);
+
+/* The same, from the values of the driver options (as by getval(), so
+ * NULL keeps the current setting); invalid values are logged and
+ * ignored, then -1 is returned */
+int modbus_plan_configure(modbus_plan_t *plan, const char *max_registers,
+	const char *max_bits, const char *max_gap);
+
+/* Names of the ups.conf options for the per-device limits above */
+#define MODBUS_PLAN_VAR_MAX_REGISTERS	"mod_max_registers"
+#define MODBUS_PLAN_VAR_MAX_BITS	"mod_max_bits"
+#define MODBUS_PLAN_VAR_MAX_GAP	"mod_max_gap"
+
+/* Add a range to the plan; repeated additions of the same range are
+ * ignored. Returns 0 on success, -1 on invalid arguments. */
+int modbus_plan_add(modbus_plan_t *plan, modbus_plan_type_t type, int addr, int nb);
+/* Forget all ranges (and the data read for them) */
+void modbus_plan_clear(modbus_plan_t *plan);
+
+/* Number of read requests a refresh takes with the current plan */
+size_t modbus_plan_blocks(modbus_plan_t *plan);
+
+/* Read all planned blocks; returns the count of blocks which failed */
+size_t modbus_plan_refresh(modbus_plan_t *plan);
+/* Drop the data read by the last refresh, e.g. after a write */
+void modbus_plan_invalidate(modbus_plan_t *plan);
+/* Forget which ranges failed to read, e.g. after a reconnection */
+void modbus_plan_retry(modbus_plan_t *plan);
+
+/* Copy a range from the data read by the last refresh into <dest>
+ * (same layout as for the reader). Returns 0 on success, or -1 if this
+ * range was not read (caller should read it from the device then). */
+int modbus_plan_fetch(const modbus_plan_t *plan, modbus_plan_type_t type,
+	int addr, int nb, void *dest);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+
+#endif	/* NUT_MODBUS_PLAN_H_SEEN */
@@ -42,7 +42,7 @@
 #include "nut_stdint.h"
 
 #define DRIVER_NAME	"network XML UPS"
-#define DRIVER_VERSION	"0.49"
+#define DRIVER_VERSION	"0.50"
 
 /** *_OBJECT query multi-part body boundary */
 #define FORM_POST_BOUNDARY "NUT-NETXML-UPS-OBJECTS"
@@ -243,13 +243,34 @@ static ne_session	*session = NULL;
 static ne_socket	*sock = NULL;
 static ne_uri		uri;
 static char	*product_page = NULL;
+static int		pollfreq = 0;
+static time_t		lastpoll = 0;
+static unsigned long	connections = 0;
+
+/* Cache validators the card sent for the pages we GET, to fetch and
+ * parse them again only when they changed (RFC 9110 conditional
+ * requests); after NETXML_MAX_NOT_MODIFIED answers "not modified" in a
+ * row, a plain GET is done anyway, in case the card gets them wrong */
+#define NETXML_MAX_NOT_MODIFIED	10
+
+typedef struct {
+	char	*page;
+	char	*etag;
+	char	*last_modified;
+	int	not_modified;	/* consecutive "304 Not Modified" answers */
+} netxml_page_t;
+
+static netxml_page_t	*pages = NULL;
+static size_t		num_pages = 0;
 
 /* Support functions */
 static void netxml_alarm_set(void);
 static void netxml_status_set(void);
 static int netxml_authenticate(void *userdata, const char *realm, int try_num, char *username, char *password);
-static int netxml_dispatch_request(ne_request *request, ne_xml_parser *parser);
+static int netxml_dispatch_request(ne_request *request, ne_xml_parser *parser, netxml_page_t *cache);
 static int netxml_get_page(const char *page);
+static netxml_page_t *netxml_page_cache(const char *page);
+static void netxml_notifier(void *userdata, ne_session_status status, const ne_session_status_info *info);
 
 static int instcmd(const char *cmdname, const char *extra);
 static int setvar(const char *varname, const char *val);
@@ -364,26 +385,36 @@ void upsdrv_updateinfo(void)
 		}
 	}
 
-	/* get additional data */
-	ret = netxml_get_page(subdriver->getobject);
-	if (ret != NE_OK) {
-		errors++;
-	}
+	/* While subscribed, status changes are pushed to us (and wake us
+	 * up through extrafd), so the pages may be polled less often */
+	if (pollfreq > 0 && VALID_FD(extrafd) && lastpoll > 0
+	&&  difftime(time(NULL), lastpoll) < pollfreq
+	) {
+		upsdebugx(3, "%s: subscribed, full poll not due yet", __func__);
+	} else {
+		/* get additional data */
+		ret = netxml_get_page(subdriver->getobject);
+		if (ret != NE_OK) {
+			errors++;
+		}
 
-	ret = netxml_get_page(subdriver->summary);
-	if (ret != NE_OK) {
-		errors++;
-	}
+		ret = netxml_get_page(subdriver->summary);
+		if (ret != NE_OK) {
+			errors++;
+		}
 
-	/* also refresh the product information, at least for firmware information */
-	ret = netxml_get_page(product_page);
-	if (ret != NE_OK) {
-		errors++;
-	}
+		/* also refresh the product information, at least for firmware information */
+		ret = netxml_get_page(product_page);
+		if (ret != NE_OK) {
+			errors++;
+		}
 
-	if (errors > 1) {
-		dstate_datastale();
-		return;
+		if (errors > 1) {
+			dstate_datastale();
+			return;
+		}
+
+		time(&lastpoll);
 	}
 
 	status_init();
@@ -571,6 +602,8 @@ void upsdrv_makevartable(void)
 	addvar(VAR_VALUE, "timeout", buf);
 
 	addvar(VAR_FLAG, "subscribe", "authenticated subscription on NMC");
+	addvar(VAR_VALUE, "pollfreq", "interval between full polls while subscribed (default: each update)");
+	addvar(VAR_FLAG, "noconditional", "always fetch complete pages, even if the NMC reports them unchanged");
 
 	addvar(VAR_VALUE | VAR_SENSITIVE, "login", "login value for authenticated mode");
 	addvar(VAR_VALUE | VAR_SENSITIVE, "password", "password value for authenticated mode");
@@ -617,6 +650,11 @@ void upsdrv_initups(void)
 		}
 	}
 
+	val = getval("pollfreq");
+	if (val && (!str_to_int(val, &pollfreq, 10) || pollfreq < 1)) {
+		fatalx(EXIT_FAILURE, "pollfreq must be a number of seconds greater than 0");
+	}
+
 	val = getval("shutdown_duration");
 	if (val) {
 		shutdown_duration = atoi(val);
@@ -673,6 +711,11 @@ void upsdrv_initups(void)
 
 	ne_set_useragent(session, subdriver->version);
 
+	/* keep the connection open between requests (this is the default
+	 * with neon, but say it); the notifier tells whether it is reused */
+	ne_set_session_flag(session, NE_SESSFLAG_PERSIST, 1);
+	ne_set_notifier(session, netxml_notifier, NULL);
+
 	if (strcasecmp(uri.scheme, "https") == 0) {
 		ne_ssl_trust_default_ca(session);
 	}
@@ -719,6 +762,14 @@ void upsdrv_cleanup(void)
 	free(subdriver->setobject);
 	free(product_page);
 
+	while (num_pages > 0) {
+		num_pages--;
+		free(pages[num_pages].page);
+		free(pages[num_pages].etag);
+		free(pages[num_pages].last_modified);
+	}
+	free(pages);
+
 	if (sock) {
 		ne_sock_close(sock);
 	}
@@ -734,22 +785,69 @@ void upsdrv_cleanup(void)
  * Support functions
  *********************************************************************/
 
+/* Return the validators cache entry for a page, adding it if needed;
+ * NULL if conditional requests are disabled */
+static netxml_page_t *netxml_page_cache(const char *page)
+{
+	size_t	i;
+
+	if (testvar("noconditional")) {
+		return NULL;
+	}
+
+	for (i = 0; i < num_pages; i++) {
+		if (!strcmp(pages[i].page, page)) {
+			return &pages[i];
+		}
+	}
+
+	pages = xrealloc(pages, (num_pages + 1) * sizeof(*pages));
+	memset(&pages[num_pages], 0, sizeof(*pages));
+	pages[num_pages].page = xstrdup(page);
+
+	return &pages[num_pages++];
+}
+
+/* Log connections to the card, so that one can see they are reused */
+static void netxml_notifier(void *userdata, ne_session_status status, const ne_session_status_info *info)
+{
+	NUT_UNUSED_VARIABLE(userdata);
+
+	if (status == ne_status_connected) {
+		connections++;
+		upsdebugx(2, "%s: connected to %s (connection #%lu)", __func__,
+			info->ci.hostname, connections);
+	} else if (status == ne_status_disconnected) {
+		upsdebugx(2, "%s: disconnected from %s", __func__, info->ci.hostname);
+	}
+}
+
 static int netxml_get_page(const char *page)
 {
 	int		ret = NE_ERROR;
 	ne_request	*request;
 	ne_xml_parser	*parser;
+	netxml_page_t	*cache;
 
 	upsdebugx(2, "%s: %s", __func__, (page != NULL)?page:"(null)");
 
 	if (page != NULL) {
 		request = ne_request_create(session, "GET", page);
 
+		cache = netxml_page_cache(page);
+		if (cache && cache->not_modified < NETXML_MAX_NOT_MODIFIED) {
+			if (cache->etag) {
+				ne_add_request_header(request, "If-None-Match", cache->etag);
+			} else if (cache->last_modified) {
+				ne_add_request_header(request, "If-Modified-Since", cache->last_modified);
+			}
+		}
+
 		parser = ne_xml_create();
 
 		ne_xml_push_handler(parser, subdriver->startelm_cb, subdriver->cdata_cb, subdriver->endelm_cb, NULL);
 
-		ret = netxml_dispatch_request(request, parser);
+		ret = netxml_dispatch_request(request, parser, cache);
 
 		if (ret) {
 			upsdebugx(2, "%s: %s", __func__, ne_get_error(session));
@@ -845,31 +943,25 @@ static int netxml_alarm_subscribe(const char *page)
 		long long int	tmp_port = -1, tmp_secret = -1;
 		upsdebugx(2, "%s: parsing %s", __func__, s);
 
-		if (!strncasecmp(s, "<Port>", 6) && (sscanf(s+6, "%lli", &tmp_port) != 1)) {
-			return NE_RETRY;
-		}
-
-		/* FIXME? Does a port==0 make sense here? Or should the test below be for port<1?
-		 * Legacy code until a fix here used sscanf() above to get a '%u' value...
-		 */
-		if (tmp_port < 0 || tmp_port > UINT_MAX) {
-			upsdebugx(2, "%s: parsing initial subcription failed, bad port value", __func__);
-			return NE_RETRY;
-		}
-
-		if (!strncasecmp(s, "<Secret>", 8) && (sscanf(s+8, "%lli", &tmp_secret) != 1)) {
-			return NE_RETRY;
-		}
-
-		if (tmp_secret < 0 || tmp_secret > UINT_MAX) {
-			upsdebugx(2, "%s: parsing initial subcription failed, bad secret value", __func__);
-			return NE_RETRY;
+		/* Each value comes on a line of its own, other lines
+		 * (XML declaration, enclosing element) are skipped */
+		if (!strncasecmp(s, "<Port>", 6)) {
+			if (sscanf(s+6, "%lli", &tmp_port) != 1
+			||  tmp_port < 1 || tmp_port > 65535
+			) {
+				upsdebugx(2, "%s: parsing initial subcription failed, bad port value", __func__);
+				return NE_RETRY;
+			}
+			port = (unsigned int)tmp_port;
+		} else if (!strncasecmp(s, "<Secret>", 8)) {
+			if (sscanf(s+8, "%lli", &tmp_secret) != 1
+			||  tmp_secret < 0 || tmp_secret > UINT_MAX
+			) {
+				upsdebugx(2, "%s: parsing initial subcription failed, bad secret value", __func__);
+				return NE_RETRY;
+			}
+			secret = (int)tmp_secret;
 		}
-
-		/* Range of valid values constrained above */
-		port = (unsigned int)tmp_port;
-		secret = (int)tmp_secret;
-
 	}
 
 	if ((port < 1) || (secret == -1)) {
@@ -939,9 +1031,10 @@ static int netxml_alarm_subscribe(const char *page)
 	return NE_OK;
 }
 
-static int netxml_dispatch_request(ne_request *request, ne_xml_parser *parser)
+static int netxml_dispatch_request(ne_request *request, ne_xml_parser *parser, netxml_page_t *cache)
 {
 	int ret;
+	const char	*etag, *last_modified;
 
 	/*
 	 * Starting with neon-0.27.0 the ne_xml_dispatch_request() function will check
@@ -962,6 +1055,32 @@ static int netxml_dispatch_request(ne_request *request, ne_xml_parser *parser)
 			break;
 		}
 
+		/* Nothing changed since the last time, so there is nothing to
+		 * parse and the values we have in dstate are still current */
+		if (cache && ne_get_status(request)->code == 304) {
+			cache->not_modified++;
+			upsdebugx(3, "%s: not modified (%d)", __func__, cache->not_modified);
+
+			ret = ne_discard_response(request);
+
+			if (ret == NE_OK) {
+				ret = ne_end_request(request);
+			}
+
+			continue;
+		}
+
+		if (cache && ne_get_status(request)->klass == 2) {
+			etag = ne_get_response_header(request, "ETag");
+			last_modified = ne_get_response_header(request, "Last-Modified");
+
+			free(cache->etag);
+			free(cache->last_modified);
+			cache->etag = etag ? xstrdup(etag) : NULL;
+			cache->last_modified = last_modified ? xstrdup(last_modified) : NULL;
+			cache->not_modified = 0;
+		}
+
 		ret = ne_xml_parse_response(request, parser);
 
 		if (ret == NE_OK) {
@@ -58,7 +58,7 @@
 #	define DRIVER_NAME	"Generic Q* Serial driver"
 #endif	/* QX_USB */
 
-#define DRIVER_VERSION	"0.55"
+#define DRIVER_VERSION	"0.57"
 
 #ifdef QX_SERIAL
 #	include "serial.h"
@@ -164,17 +164,36 @@ static int	hunnox_step = 0;
 static int	is_usb = 0;	/* Whether the device is connected through USB (1) or serial (0) */
 #endif	/* QX_USB && QX_SERIAL */
 
-static struct {
-	char	command[SMALLBUF];	/* Command sent to the UPS to get answer/to execute an instant command */
-	char	answer[SMALLBUF];	/* Answer from the UPS, filled at runtime */
-} previous_item = { "", "" };	/* Hold the values of the item processed just before the actual one */
+/* Answers to the commands of the qx2nut table: valid for one walk, so that
+ * each command is sent at most once per walk, and the poll schedule of
+ * the items using them in full updates. Answers are kept as got from
+ * the UPS (before any preprocess_answer), since the items sharing
+ * a command may preprocess it differently. */
+typedef struct {
+	const char	*command;	/* Command as found in the qx2nut table */
+	char	answer[SMALLBUF];	/* Answer from the UPS in this walk, if any */
+	size_t	answer_len;	/* Its length (it may be binary), 0 if none */
+	char	last[SMALLBUF];	/* Answer from the UPS in the last full update it was polled in */
+	size_t	last_len;	/* Its length */
+	bool_t	pinned;		/* Poll at each full update (status, alarms, battery charge/runtime) */
+	time_t	period;		/* Current interval between full updates polling it */
+	time_t	next_poll;	/* Skip it in full updates until then */
+} qx_command_t;
+
+static qx_command_t	*qx_commands = NULL;
+static size_t	qx_commands_count = 0;
+static long	slowpollfreq = 0;	/* Max back-off interval for unchanged answers (0: same as pollfreq) */
 
 
 /* == Support functions == */
 static int	subdriver_matcher(void);
 static ssize_t	qx_command(const char *cmd, size_t cmdlen, char *buf, size_t buflen);
 static int	qx_process_answer(item_t *item, const size_t len); /* returns just 0 or -1 */
+static ssize_t	qx_send(item_t *item, const char *command, char *buf, size_t buflen);
+static int	qx_process_reply(item_t *item, const char *buf, ssize_t len);
 static bool_t	qx_ups_walk(walkmode_t mode);
+static qx_command_t	*qx_command_find(const char *command);
+static void	qx_command_polled(qx_command_t *cmd, time_t now);
 static void	ups_status_set(void);
 static void	ups_alarm_set(void);
 static void	qx_set_var(item_t *item);
@@ -469,7 +488,7 @@ static int	qx_battery(void)
 			batt.chrg.act = 100;
 		}
 
-		dstate_setinfo("battery.charge", "%.0f", batt.chrg.act);
+		dstate_setinfo_double("battery.charge", 0, batt.chrg.act);
 
 	}
 
@@ -541,8 +560,8 @@ static void	qx_initbattery(void)
 		batt.volt.high = 130 * batt.volt.nom / 120;
 
 		/* Publish these data too */
-		dstate_setinfo("battery.voltage.low", "%.2f", batt.volt.low);
-		dstate_setinfo("battery.voltage.high", "%.2f", batt.volt.high);
+		dstate_setinfo_double("battery.voltage.low", 2, batt.volt.low);
+		dstate_setinfo_double("battery.voltage.high", 2, batt.volt.high);
 
 		upslogx(LOG_INFO, "Using 'guesstimation' (low: %f, high: %f)!",
 			batt.volt.low, batt.volt.high);
@@ -576,7 +595,7 @@ static void	qx_initbattery(void)
 			val = dstate_getinfo("battery.voltage");
 			if (val && batt_packs_known && batt.packs > 1) {
 				batt.volt.act = strtod(val, NULL) * batt.packs;
-				dstate_setinfo("battery.voltage", "%.2f", batt.volt.act);
+				dstate_setinfo_double("battery.voltage", 2, batt.volt.act);
 			}
 		}
 	}
@@ -3636,6 +3655,9 @@ void	upsdrv_makevartable(void)
 		DEFAULT_POLLFREQ);
 	addvar(VAR_VALUE, QX_VAR_POLLFREQ, temp);
 
+	addvar(VAR_VALUE, QX_VAR_SLOWPOLLFREQ,
+		"Poll items whose answers do not change at most every this many seconds (default=pollfreq)");
+
 	addvar(VAR_VALUE, "protocol",
 		"Preselect communication protocol (skip autodetection)");
 
@@ -3822,6 +3844,19 @@ void	upsdrv_initinfo(void)
 
 	dstate_setinfo("driver.parameter.pollfreq", "%ld", pollfreq);
 
+	val = getval(QX_VAR_SLOWPOLLFREQ);
+	if (val) {
+		if (!str_to_long(val, &slowpollfreq, 10) || slowpollfreq < 0) {
+			fatalx(EXIT_FAILURE, "Invalid %s value: %s",
+				QX_VAR_SLOWPOLLFREQ, val);
+		}
+		if (slowpollfreq < pollfreq) {
+			upslogx(LOG_WARNING, "%s is lower than %s, ignoring it",
+				QX_VAR_SLOWPOLLFREQ, QX_VAR_POLLFREQ);
+			slowpollfreq = 0;
+		}
+	}
+
 	time(&lastpoll);
 
 	/* Install handlers */
@@ -4199,6 +4234,10 @@ void	upsdrv_cleanup(void)
 
 #endif	/* TESTING */
 
+	free(qx_commands);
+	qx_commands = NULL;
+	qx_commands_count = 0;
+
 	upsdebugx(1, "%s finished", __func__);
 }
 
@@ -4666,11 +4705,107 @@ static void	qx_set_var(item_t *item)
 	}
 }
 
+/* Return the entry of qx_commands[] for this command, adding it
+ * (together with all the other commands in the qx2nut table)
+ * if not known yet */
+static qx_command_t	*qx_command_find(const char *command)
+{
+	item_t	*item;
+	size_t	i;
+
+	if (command == NULL || *command == '\0')
+		return NULL;
+
+	if (qx_commands == NULL) {
+
+		/* Room for one entry per item at most */
+		for (item = subdriver->qx2nut; item->info_type != NULL; item++)
+			qx_commands_count++;
+
+		qx_commands = (qx_command_t *)xcalloc(qx_commands_count + 1, sizeof(*qx_commands));
+		qx_commands_count = 0;
+
+		for (item = subdriver->qx2nut; item->info_type != NULL; item++) {
+
+			qx_command_t	*cmd = NULL;
+
+			if (item->command == NULL || *item->command == '\0'
+			||  (item->qxflags & (QX_FLAG_ABSENT | QX_FLAG_CMD | QX_FLAG_SETVAR))
+			) {
+				continue;
+			}
+
+			for (i = 0; i < qx_commands_count; i++) {
+				if (!strcasecmp(qx_commands[i].command, item->command)) {
+					cmd = &qx_commands[i];
+					break;
+				}
+			}
+
+			if (cmd == NULL) {
+				cmd = &qx_commands[qx_commands_count++];
+				cmd->command = item->command;
+				cmd->period = pollfreq;
+			}
+
+			/* Items we always need fresh values of
+			 * (also to decide upon battery guesstimation) */
+			if ((item->qxflags & QX_FLAG_QUICK_POLL)
+			||  !strncmp(item->info_type, "ups.status", 10)
+			||  !strncmp(item->info_type, "ups.alarm", 9)
+			||  !strcmp(item->info_type, "battery.charge")
+			||  !strcmp(item->info_type, "battery.runtime")
+			) {
+				cmd->pinned = TRUE;
+			}
+		}
+
+		upsdebugx(3, "%s: %" PRIuSIZE " distinct commands in the qx2nut table",
+			__func__, qx_commands_count);
+	}
+
+	for (i = 0; i < qx_commands_count; i++) {
+		if (!strcasecmp(qx_commands[i].command, command))
+			return &qx_commands[i];
+	}
+
+	return NULL;
+}
+
+/* Schedule the next full update polling of a command just sent:
+ * answers which did not change since the last time back off
+ * (doubling their interval) up to slowpollfreq, others are
+ * polled again at the next full update */
+static void	qx_command_polled(qx_command_t *cmd, time_t now)
+{
+	if (cmd->pinned || slowpollfreq <= pollfreq
+	||  cmd->answer_len == 0 || cmd->answer_len != cmd->last_len
+	||  memcmp(cmd->answer, cmd->last, cmd->answer_len)
+	) {
+		cmd->period = pollfreq;
+	} else if (cmd->period < slowpollfreq) {
+		cmd->period = (cmd->period * 2 < slowpollfreq) ? cmd->period * 2 : slowpollfreq;
+		upsdebugx(4, "%s: answer to %s unchanged, polling it every %ld seconds",
+			__func__, cmd->command, (long)cmd->period);
+	}
+
+	memcpy(cmd->last, cmd->answer, cmd->answer_len);
+	cmd->last_len = cmd->answer_len;
+
+	/* The earliest full update after this period will poll it */
+	cmd->next_poll = now + cmd->period;
+}
+
 /* Walk UPS variables and set elements of the qx2nut array. */
 static bool_t	qx_ups_walk(walkmode_t mode)
 {
 	item_t	*item;
+	qx_command_t	*cmd;
 	int	retcode;
+	size_t	i;
+	time_t	now;
+
+	time(&now);
 
 	/* Clear batt.{chrg,runt}.act for guesstimation */
 	if (mode == QX_WALKMODE_FULL_UPDATE) {
@@ -4679,9 +4814,11 @@ static bool_t	qx_ups_walk(walkmode_t mode)
 		battery_voltage_reports_one_pack_considered = 0;
 	}
 
-	/* Clear data from previous_item */
-	memset(previous_item.command, 0, sizeof(previous_item.command));
-	memset(previous_item.answer, 0, sizeof(previous_item.answer));
+	/* Clear answers got in the previous walk */
+	for (i = 0; i < qx_commands_count; i++) {
+		memset(qx_commands[i].answer, 0, sizeof(qx_commands[i].answer));
+		qx_commands[i].answer_len = 0;
+	}
 
 	/* 3 modes: QX_WALKMODE_INIT, QX_WALKMODE_QUICK_UPDATE
 	 *      and QX_WALKMODE_FULL_UPDATE */
@@ -4800,32 +4937,54 @@ static bool_t	qx_ups_walk(walkmode_t mode)
 
 		}
 
-		/* Check whether the previous item uses the same command
-		 * and then use its answer, if available.. */
-		if (strlen(previous_item.command) > 0
-		&&  strlen(previous_item.answer) > 0
-		&&  !strcasecmp(previous_item.command, item->command)
-		) {
+		cmd = qx_command_find(item->command);
 
-			snprintf(item->answer, sizeof(item->answer), "%s",
-				previous_item.answer);
+		/* Check whether an item already sent the same command
+		 * in this walk and then use its answer, if available.. */
+		if (cmd && cmd->answer_len > 0) {
 
-			/* Process the answer */
+			/* Preprocess and process the answer */
 			errno = 0;
-			retcode = qx_process_answer(item, strlen(item->answer));
+			retcode = qx_process_reply(item, cmd->answer, (ssize_t)cmd->answer_len);
+
+		/* ..skip items whose answers have not changed lately,
+		 * until they are due.. */
+		} else if (cmd
+		&&  mode == QX_WALKMODE_FULL_UPDATE
+		&&  data_has_changed == FALSE
+		&&  now < cmd->next_poll
+		) {
+
+			upsdebugx(5, "%s: %s not due yet, skipping %s",
+				__func__, cmd->command, item->info_type);
+			continue;
 
 		/* ..otherwise: execute command to get answer from the UPS */
 		} else {
 
-			retcode = qx_process(item, NULL);
+			char	buf[sizeof(item->answer) - 1] = "";
+			ssize_t	len = qx_send(item, NULL, buf, sizeof(buf));
 
-		}
+			if (len < 0) {
+				memset(item->answer, 0, sizeof(item->answer));
+				retcode = -1;
+			} else {
+				retcode = qx_process_reply(item, buf, len);
+			}
 
-		/* Record item as previous_item */
-		snprintf(previous_item.command, sizeof(previous_item.command), "%s",
-			item->command);
-		snprintf(previous_item.answer, sizeof(previous_item.answer), "%s",
-			item->answer);
+			if (cmd) {
+				/* Keep the raw answer for the next items,
+				 * unless the UPS did not answer properly */
+				if (retcode == 0 && len > 0) {
+					memcpy(cmd->answer, buf, (size_t)len);
+					cmd->answer_len = (size_t)len;
+				}
+
+				if (mode == QX_WALKMODE_FULL_UPDATE)
+					qx_command_polled(cmd, now);
+			}
+
+		}
 
 		if (retcode) {
 
@@ -4944,11 +5103,11 @@ static bool_t	qx_ups_walk(walkmode_t mode)
 			}
 
 			if (d_equal(batt.chrg.act, -1))
-				dstate_setinfo("battery.charge", "%.0f",
+				dstate_setinfo_double("battery.charge", 0,
 					100 * batt.runt.est / batt.runt.nom);
 
 			if (d_equal(batt.runt.act, -1) && !qx_load())
-				dstate_setinfo("battery.runtime", "%.0f",
+				dstate_setinfo_double("battery.runtime", 0,
 					batt.runt.est / load.eff);
 
 			battery_lastpoll = battery_now;
@@ -5107,10 +5266,12 @@ static int	qx_process_answer(item_t *item, const size_t len)
 	return 0;
 }
 
-/* See header file for details. */
-int	qx_process(item_t *item, const char *command)
+/* Preprocess the command of an item (or <command>, if not NULL),
+ * send it to the UPS and return the length of the answer stored
+ * in <buf>, or -1 on errors */
+static ssize_t	qx_send(item_t *item, const char *command, char *buf, size_t buflen)
 {
-	char	buf[sizeof(item->answer) - 1] = "", *cmd;
+	char	*cmd;
 	ssize_t	len;
 	size_t	cmdlen = command ?
 		(strlen(command) >= SMALLBUF ? strlen(command) + 1 : SMALLBUF) :
@@ -5143,18 +5304,25 @@ int	qx_process(item_t *item, const char *command)
 	}
 
 	/* Send the command */
-	len = qx_command(cmd, cmd_len, buf, sizeof(buf));
+	len = qx_command(cmd, cmd_len, buf, buflen);
 
-	memset(item->answer, 0, sizeof(item->answer));
+	free (cmd);
 
 	if (len < 0 || len > INT_MAX) {
 		upsdebugx(4, "%s: failed to preprocess answer [%s]",
 			__func__, item->info_type);
-		free (cmd);
 		return -1;
 	}
 
-	memcpy(item->answer, buf, sizeof(buf));
+	return len;
+}
+
+/* Store the answer <buf> of <len> bytes in the item, preprocess it
+ * (if needed) and process it to get the value */
+static int	qx_process_reply(item_t *item, const char *buf, ssize_t len)
+{
+	memset(item->answer, 0, sizeof(item->answer));
+	memcpy(item->answer, buf, (size_t)len < sizeof(item->answer) - 1 ? (size_t)len : sizeof(item->answer) - 1);
 
 	/* Preprocess the answer */
 	if (item->preprocess_answer != NULL) {
@@ -5162,20 +5330,30 @@ int	qx_process(item_t *item, const char *command)
 		if (len < 0 || len > INT_MAX) {
 			upsdebugx(4, "%s: failed to preprocess answer [%s]",
 				__func__, item->info_type);
-			/* Clear the failed answer, preventing it from
-			 * being reused by next items with same command */
+			/* Clear the failed answer */
 			memset(item->answer, 0, sizeof(item->answer));
-			free (cmd);
 			return -1;
 		}
 	}
 
-	free (cmd);
-
 	/* Process the answer to get the value */
 	return qx_process_answer(item, (size_t)len);
 }
 
+/* See header file for details. */
+int	qx_process(item_t *item, const char *command)
+{
+	char	buf[sizeof(item->answer) - 1] = "";
+	ssize_t	len = qx_send(item, command, buf, sizeof(buf));
+
+	if (len < 0) {
+		memset(item->answer, 0, sizeof(item->answer));
+		return -1;
+	}
+
+	return qx_process_reply(item, buf, len);
+}
+
 /* See header file for details. */
 int	ups_infoval_set(item_t *item)
 {
@@ -46,6 +46,7 @@
 #define QX_VAR_ONDELAY	"ondelay"
 #define QX_VAR_OFFDELAY	"offdelay"
 #define QX_VAR_POLLFREQ	"pollfreq"
+#define QX_VAR_SLOWPOLLFREQ	"slowpollfreq"
 
 /* Parameters default values */
 #define DEFAULT_ONDELAY		"180"	/* Delay between return of utility power and powering up of load, in seconds */
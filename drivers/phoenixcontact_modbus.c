@@ -23,6 +23,7 @@
  */
 
 #include "main.h"
+#include "modbus-plan.h"
 #include <modbus.h>
 #include "nut_stdint.h"
 #include <stdbool.h>
@@ -32,7 +33,7 @@
 #endif
 
 #define DRIVER_NAME	"NUT PhoenixContact Modbus driver (libmodbus link type: " NUT_MODBUS_LINKTYPE_STR ")"
-#define DRIVER_VERSION	"0.11"
+#define DRIVER_VERSION	"0.12"
 
 #define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
 #define MODBUS_SLAVE_ID 192
@@ -115,7 +116,14 @@ typedef enum
 static modbus_t *modbus_ctx = NULL;
 static int errcount = 0;
 
+/* Input register ranges read by upsdrv_updateinfo() are remembered
+ * on the first pass, and later fetched at the start of each update
+ * with as few block reads as possible; mrir() serves them from there */
+static modbus_plan_t *readplan = NULL;
+static int readplan_learn = 0;
+
 static int mrir(modbus_t * arg_ctx, int addr, int nb, uint16_t * dest);
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest);
 
 static models UPSModel = NONE;
 
@@ -355,6 +363,14 @@ void upsdrv_updateinfo(void)
 
 	upsdebugx(2, "upsdrv_updateinfo");
 
+	if (!readplan) {
+		readplan = modbus_plan_new(plan_read, NULL);
+		modbus_plan_configure(readplan, getval(MODBUS_PLAN_VAR_MAX_REGISTERS),
+			NULL, getval(MODBUS_PLAN_VAR_MAX_GAP));
+	}
+	modbus_plan_refresh(readplan);
+	readplan_learn = 1;
+
 	switch (UPSModel)
 	{
 	case QUINT4_UPS:
@@ -758,6 +774,10 @@ void upsdrv_updateinfo(void)
 #endif
 	}
 
+	/* do not serve stale values to reads done outside of updates */
+	readplan_learn = 0;
+	modbus_plan_invalidate(readplan);
+
 	if (errcount == 0) {
 		alarm_commit();
 		status_commit();
@@ -814,6 +834,8 @@ void upsdrv_tweak_prognames(void)
 /* list flags and values that you want to receive via -x */
 void upsdrv_makevartable(void)
 {
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_REGISTERS, "Modbus registers read with one request at most (1-125)");
+	addvar(VAR_VALUE, MODBUS_PLAN_VAR_MAX_GAP, "Unused Modbus registers read to merge two requests");
 }
 
 void upsdrv_initups(void)
@@ -878,6 +900,9 @@ void upsdrv_initups(void)
 
 void upsdrv_cleanup(void)
 {
+	modbus_plan_free(readplan);
+	readplan = NULL;
+
 	if (modbus_ctx != NULL) {
 		modbus_close(modbus_ctx);
 		modbus_free(modbus_ctx);
@@ -888,6 +913,12 @@ void upsdrv_cleanup(void)
 static int mrir(modbus_t * arg_ctx, int addr, int nb, uint16_t * dest)
 {
 	int r;
+
+	if (modbus_plan_fetch(readplan, MODBUS_PLAN_INPUT_REGISTER, addr, nb, dest) == 0)
+		return nb;
+	if (readplan_learn)
+		modbus_plan_add(readplan, MODBUS_PLAN_INPUT_REGISTER, addr, nb);
+
 	r = modbus_read_input_registers(arg_ctx, addr, nb, dest);
 	if (r == -1) {
 		upslogx(LOG_ERR, "mrir: modbus_read_input_registers(addr:%d, count:%d): %s (%s)", addr, nb, modbus_strerror(errno), device_path);
@@ -895,3 +926,23 @@ static int mrir(modbus_t * arg_ctx, int addr, int nb, uint16_t * dest)
 	}
 	return r;
 }
+
+/* Block reads for the read planner; failures are not counted as errors
+ * here, mrir() reads such ranges itself (and the planner stops reading
+ * those which fail on their own, so they are not read twice a cycle) */
+static int plan_read(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	int r;
+
+	NUT_UNUSED_VARIABLE(arg);
+
+	if (type != MODBUS_PLAN_INPUT_REGISTER)
+		return -1;
+
+	r = modbus_read_input_registers(modbus_ctx, addr, nb, (uint16_t *)dest);
+	if (r == -1) {
+		upsdebugx(2, "plan_read: modbus_read_input_registers(addr:%d, count:%d): %s",
+			addr, nb, modbus_strerror(errno));
+	}
+	return r;
+}
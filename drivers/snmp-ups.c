@@ -40,6 +40,9 @@
 #include "parseconf.h"
 
 #include <ctype.h> /* for isprint() */
+#ifdef HAVE_FLOCK
+# include <sys/file.h> /* for flock() on the MIB cache */
+#endif
 
 /* include all known mib2nut lookup tables */
 #include "apc-mib.h"
@@ -181,7 +184,7 @@ static const char *mibname;
 static const char *mibvers;
 
 #define DRIVER_NAME	"Generic SNMP UPS driver"
-#define DRIVER_VERSION	"1.41"
+#define DRIVER_VERSION	"1.44"
 
 /* driver description structure */
 upsdrv_info_t	upsdrv_info = {
@@ -219,13 +222,239 @@ static int device_template_offset = -1;
 
 /* sysOID location */
 #define SYSOID_OID	".1.3.6.1.2.1.1.2.0"
+/* sysDescr location (usually includes the firmware revision) */
+#define SYSDESCR_OID	".1.3.6.1.2.1.1.1.0"
+
+/* sysOID index of mib2nut[]: the parsed OIDs sorted, with entries of
+ * the same sysOID kept in mib2nut[] order (which is the preference) */
+typedef struct {
+	oid	*sysOID;
+	size_t	sysOID_len;
+	int	mib2nut_idx;
+} mib2nut_sysoid_t;
+
+static mib2nut_sysoid_t *mib2nut_sysoids = NULL;
+static size_t mib2nut_sysoids_count = 0;
+
+/* su_find_info() index: entries of the snmp_info table it was built
+ * for, sorted by info_type (case-insensitive) and then by position,
+ * so the first entry of a kind still wins like with a linear walk */
+static snmp_info_t **su_info_index = NULL;
+static size_t su_info_index_count = 0;
+static snmp_info_t *su_info_indexed = NULL;
+
+/* Prefetching of the OIDs read in update cycles: do_nut_snmp_get()
+ * remembers which OIDs were asked for and how often; at the start of
+ * the next cycle those which are due are read ahead with multi-varbind
+ * requests, several of them in flight at once, and the do_nut_snmp_get()
+ * calls of that cycle are served from the results. OIDs which fail in
+ * a batch are read alone (the classic way) from then on. */
+typedef struct {
+	char	*OID;
+	oid	*name;			/* parsed OID, NULL until batched */
+	size_t	name_len;
+	int	solo;			/* not to be batched */
+	unsigned long	last_cycle;	/* when last asked for */
+	unsigned long	period;		/* cycles between the last two asks */
+	struct snmp_pdu	*response;	/* prefetched and not yet taken */
+} su_prefetch_t;
+
+typedef struct {
+	size_t	first, count;		/* entries, in the due list */
+	int	reqid;			/* 0 if not sent */
+	int	done;
+	struct snmp_pdu	*response;
+} su_prefetch_batch_t;
+
+/* A prefetch in progress: the entries due and the requests for them */
+typedef struct su_prefetch_run_s {
+	size_t	*due, ndue;
+	su_prefetch_batch_t	*batches;
+	size_t	nbatches, sent;
+	struct su_prefetch_run_s	*next_run;
+} su_prefetch_run_t;
+
+static su_prefetch_t *su_prefetch = NULL;	/* sorted by OID */
+static size_t su_prefetch_count = 0, su_prefetch_alloc = 0;
+static unsigned long su_prefetch_cycle = 0;
+static int su_prefetch_active = 0;
+static su_prefetch_run_t *su_prefetch_run = NULL;
+/* all prefetches in progress (of all agents), for the async callback */
+static su_prefetch_run_t *su_prefetch_runs = NULL;
+/* OIDs per prefetch request, 1 disables prefetching */
+static int su_batch = DEFAULT_BATCH;
+
+/* Agents of the ups.conf sections hosted by ours (hosted_by), served
+ * by this process too: the state above which is about one device is
+ * kept per agent, and loaded into the variables while working with it */
+#define SU_AGENT_STATE(X) \
+	X(struct snmp_session, g_snmp_sess) \
+	X(struct snmp_session *, g_snmp_sess_p) \
+	X(const char *, OID_pwr_status) \
+	X(int, g_pwr_battery) \
+	X(int, pollfreq) \
+	X(int, semistaticfreq) \
+	X(int, semistatic_countdown) \
+	X(int, quirk_symmetra_threephase) \
+	X(long, devices_count) \
+	X(int, current_device_number) \
+	X(bool_t, daisychain_enabled) \
+	X(daisychain_info_t **, daisychain_info) \
+	X(snmp_info_t *, snmp_info) \
+	X(alarms_info_t *, alarms_info) \
+	X(const char *, mibname) \
+	X(const char *, mibvers) \
+	X(time_t, lastpoll) \
+	X(int, comm_status) \
+	X(int, template_index_base) \
+	X(int, device_template_index_base) \
+	X(int, outlet_template_index_base) \
+	X(int, outletgroup_template_index_base) \
+	X(int, ambient_template_index_base) \
+	X(int, device_template_offset) \
+	X(snmp_info_t **, su_info_index) \
+	X(size_t, su_info_index_count) \
+	X(snmp_info_t *, su_info_indexed) \
+	X(su_prefetch_t *, su_prefetch) \
+	X(size_t, su_prefetch_count) \
+	X(size_t, su_prefetch_alloc) \
+	X(unsigned long, su_prefetch_cycle) \
+	X(int, su_prefetch_active) \
+	X(su_prefetch_run_t *, su_prefetch_run) \
+	X(int, su_batch)
+
+typedef struct su_agent_s {
+#define SU_AGENT_FIELD(type, name)	type name;
+	SU_AGENT_STATE(SU_AGENT_FIELD)
+#undef SU_AGENT_FIELD
+	snmp_info_t	*mapping;	/* its copy of the mapping table */
+	upsdrv_hosted_t	*dev;		/* NULL for ours */
+	int	due;			/* for an update cycle now */
+	int	probed;			/* its prefetch sent requests */
+	struct su_agent_s	*next;
+} su_agent_t;
+
+/* ours first (its state is kept here while another one's is loaded),
+ * then the hosted ones; and the one whose state is loaded */
+static su_agent_t su_agent_own;
+static su_agent_t *su_agent_cur = &su_agent_own;
 
 /* Forward functions declarations */
 static void disable_transfer_oids(void);
+static void su_prefetch_start(void);
+static size_t su_prefetch_send(void);
+static int su_prefetch_wait(void);
+static size_t su_prefetch_collect(void);
+static void su_prefetch_end(void);
+static void su_prefetch_free(void);
 bool_t get_and_process_data(int mode, snmp_info_t *su_info_p);
 int extract_template_number(snmp_info_flags_t template_type, const char* varname);
 snmp_info_flags_t get_template_type(const char* varname);
 
+/* Load the state of an agent (NULL: ours) and select its device;
+ * returns the previous one */
+static su_agent_t *su_agent_select(su_agent_t *agent)
+{
+	su_agent_t	*prev = su_agent_cur;
+
+	if (agent == NULL)
+		agent = &su_agent_own;
+	if (agent == prev)
+		return prev;
+
+#define SU_AGENT_SAVE(type, name)	prev->name = name;
+	SU_AGENT_STATE(SU_AGENT_SAVE)
+#undef SU_AGENT_SAVE
+#define SU_AGENT_LOAD(type, name)	name = agent->name;
+	SU_AGENT_STATE(SU_AGENT_LOAD)
+#undef SU_AGENT_LOAD
+
+	su_agent_cur = agent;
+	upsdrv_hosted_select(agent->dev);
+
+	return prev;
+}
+
+/* A hosted agent, in the state ours starts with */
+static su_agent_t *su_agent_new(upsdrv_hosted_t *dev)
+{
+	su_agent_t	*agent = (su_agent_t *)xcalloc(1, sizeof(*agent));
+
+	agent->devices_count = 1;
+	agent->daisychain_enabled = FALSE;
+	agent->comm_status = COMM_UNKNOWN;
+	agent->template_index_base = -1;
+	agent->device_template_index_base = -1;
+	agent->outlet_template_index_base = -1;
+	agent->outletgroup_template_index_base = -1;
+	agent->ambient_template_index_base = -1;
+	agent->device_template_offset = -1;
+	agent->su_batch = DEFAULT_BATCH;
+
+	agent->dev = dev;
+	dev->priv = agent;
+
+	return agent;
+}
+
+/* The mapping table for the selected agent: while hosting several,
+ * each one gets a copy, since the flags in there adapt to its device */
+static snmp_info_t *su_agent_mapping(snmp_info_t *table)
+{
+	size_t	n;
+
+	if (su_agent_own.next == NULL || table == NULL)
+		return table;
+
+	for (n = 0; table[n].info_type != NULL; n++)
+		;
+
+	free(su_agent_cur->mapping);
+	su_agent_cur->mapping = (snmp_info_t *)xcalloc(n + 1, sizeof(*table));
+	memcpy(su_agent_cur->mapping, table, (n + 1) * sizeof(*table));
+
+	return su_agent_cur->mapping;
+}
+
+/* Set up the hosted agents, as main.c does with ours */
+static void su_agents_init(void)
+{
+	su_agent_t	*agent, *prev;
+
+	for (agent = su_agent_own.next; agent; agent = agent->next) {
+		prev = su_agent_select(agent);
+		upsdebugx(1, "%s: setting up hosted device [%s] (host %s)",
+			__func__, upsname, device_path);
+		upsdrv_initups();
+		upsdrv_initinfo();
+		su_agent_select(prev);
+	}
+}
+
+/* Commands and settings sent by the readers of a hosted device's
+ * socket are for its agent */
+static int su_agent_setvar(const char *varname, const char *val)
+{
+	upsdrv_hosted_t	*dev = upsdrv_hosted_find_ctx(dstate_ctx_get());
+	su_agent_t	*prev = su_agent_select(dev ? (su_agent_t *)dev->priv : NULL);
+	int	ret = su_setvar(varname, val);
+
+	su_agent_select(prev);
+
+	return ret;
+}
+
+static int su_agent_instcmd(const char *cmdname, const char *extradata)
+{
+	upsdrv_hosted_t	*dev = upsdrv_hosted_find_ctx(dstate_ctx_get());
+	su_agent_t	*prev = su_agent_select(dev ? (su_agent_t *)dev->priv : NULL);
+	int	ret = su_instcmd(cmdname, extradata);
+
+	su_agent_select(prev);
+
+	return ret;
+}
+
 static void analyze_mapping_usage(void) {
 	/* Check if the subdriver code (mappings) and the device report
 	 * sit together well. Note that for yet-unknown concepts, the
@@ -442,61 +671,123 @@ void upsdrv_initinfo(void)
 	}
 
 	/* setup handlers for instcmd and setvar functions */
-	upsh.setvar = su_setvar;
-	upsh.instcmd = su_instcmd;
+	upsh.setvar = su_agent_setvar;
+	upsh.instcmd = su_agent_instcmd;
+
+	/* and then the agents hosted by ours, if any */
+	if (su_agent_cur == &su_agent_own)
+		su_agents_init();
+}
+
+/* An update cycle of the selected agent, with its prefetch collected */
+static void su_agent_update(void)
+{
+	alarm_init();
+	status_init();
+
+	/* update all dynamic info fields */
+	if (snmp_ups_walk(SU_WALKMODE_UPDATE)) {
+		upsdebugx(1, "%s: pollfreq: Data OK", __func__);
+		dstate_dataok();
+		if (comm_status != COMM_OK) {
+			/* We may have missed the initial connection,
+			 * or lost one subsequently during normal work.
+			 * Help at least with the former case with info
+			 * about efficiency of the current mapping table.
+			 * And who knows how the reconnection went, maybe
+			 * a new firmware got installed or modules added?
+			 */
+			analyze_mapping_usage();
+			comm_status = COMM_OK;
+		}
+	}
+	else {
+		upsdebugx(1, "%s: pollfreq: Data STALE", __func__);
+		dstate_datastale();
+		comm_status = COMM_LOST;
+	}
+
+	su_prefetch_end();
+
+	/* Commit status first, otherwise in daisychain mode, "device.0" may
+	 * clear the alarm count since it has an empty alarm buffer and if there
+	 * is only one device that has alarms! */
+	if (daisychain_enabled == FALSE)
+		alarm_commit();
+	status_commit();
+	if (daisychain_enabled == TRUE)
+		alarm_commit();
+
+	/* store timestamp */
+	lastpoll = time(NULL);
 }
 
 void upsdrv_updateinfo(void)
 {
+	su_agent_t	*agent, *prev;
+	size_t	inflight;
+
 	upsdebugx(1,"SNMP UPS driver: entering %s()", __func__);
 
-	/* only update every pollfreq */
+	/* only update every pollfreq (of each agent, if hosting several) */
 	/* FIXME: only update status (SU_STATUS_*), à la usbhid-ups, in between */
-	if (time(NULL) > (lastpoll + pollfreq)) {
-
-		alarm_init();
-		status_init();
-
-		/* update all dynamic info fields */
-		if (snmp_ups_walk(SU_WALKMODE_UPDATE)) {
-			upsdebugx(1, "%s: pollfreq: Data OK", __func__);
-			dstate_dataok();
-			if (comm_status != COMM_OK) {
-				/* We may have missed the initial connection,
-				 * or lost one subsequently during normal work.
-				 * Help at least with the former case with info
-				 * about efficiency of the current mapping table.
-				 * And who knows how the reconnection went, maybe
-				 * a new firmware got installed or modules added?
-				 */
-				analyze_mapping_usage();
-				comm_status = COMM_OK;
+	for (agent = &su_agent_own; agent; agent = agent->next) {
+		prev = su_agent_select(agent);
+		agent->due = (time(NULL) > (lastpoll + pollfreq));
+
+		/* read ahead what this cycle will likely ask for */
+		if (agent->due)
+			su_prefetch_start();
+		agent->probed = (su_prefetch_run != NULL);
+
+		su_agent_select(prev);
+	}
+
+	/* with the requests to all agents in flight at once */
+	do {
+		inflight = 0;
+		for (agent = &su_agent_own; agent; agent = agent->next) {
+			if (!agent->due)
+				continue;
+
+			prev = su_agent_select(agent);
+			inflight += su_prefetch_send();
+			su_agent_select(prev);
+		}
+	} while (inflight > 0 && su_prefetch_wait() == 0);
+
+	for (agent = &su_agent_own; agent; agent = agent->next) {
+		prev = su_agent_select(agent);
+
+		if (agent->due) {
+			/* The reads of an update cycle not served by the
+			 * prefetch (table walks, OIDs read alone) wait on
+			 * one agent after another; an agent which answered
+			 * none of its prefetch is not read further now, so
+			 * that it does not hold up the others for all of
+			 * its timeouts. Next time it is only probed. */
+			if (su_prefetch_collect() == 0 && agent->probed
+			 && su_agent_own.next != NULL
+			) {
+				upsdebugx(1, "%s: [%s] did not answer, not reading it in this cycle",
+					__func__, upsname);
+				su_prefetch_end();
+				dstate_datastale();
+				comm_status = COMM_LOST;
+				lastpoll = time(NULL);
 			}
+			else
+				su_agent_update();
 		}
 		else {
-			upsdebugx(1, "%s: pollfreq: Data STALE", __func__);
-			dstate_datastale();
-			comm_status = COMM_LOST;
+			/* Just tell the same status to upsd */
+			if (comm_status == COMM_OK)
+				dstate_dataok();
+			else
+				dstate_datastale();
 		}
 
-		/* Commit status first, otherwise in daisychain mode, "device.0" may
-		 * clear the alarm count since it has an empty alarm buffer and if there
-		 * is only one device that has alarms! */
-		if (daisychain_enabled == FALSE)
-			alarm_commit();
-		status_commit();
-		if (daisychain_enabled == TRUE)
-			alarm_commit();
-
-		/* store timestamp */
-		lastpoll = time(NULL);
-	}
-	else {
-		/* Just tell the same status to upsd */
-		if (comm_status == COMM_OK)
-			dstate_dataok();
-		else
-			dstate_datastale();
+		su_agent_select(prev);
 	}
 }
 
@@ -587,6 +878,8 @@ void upsdrv_makevartable(void)
 	addvar(VAR_VALUE, SU_VAR_MIBS,
 		"NOTE: You can run the driver binary with '-x mibs=--list' for an up to date listing)\n"
 		"Set MIB compliance (default=ietf, allowed: mge,apcc,netvision,pw,cpqpower,...)");
+	addvar(VAR_VALUE, SU_VAR_MIBCACHE,
+		"Set the file to remember detected MIBs in, to skip probing on restarts (mibs=auto only)");
 	addvar(VAR_VALUE | VAR_SENSITIVE, SU_VAR_COMMUNITY,
 		"Set community name (default=public)");
 	addvar(VAR_VALUE, SU_VAR_VERSION,
@@ -599,6 +892,8 @@ void upsdrv_makevartable(void)
 		"Specifies the number of Net-SNMP retries to be used in the requests (default=5)");
 	addvar(VAR_VALUE, SU_VAR_TIMEOUT,
 		"Specifies the Net-SNMP timeout in seconds between retries (default=1)");
+	addvar(VAR_VALUE, SU_VAR_BATCH,
+		"Set the count of OIDs read ahead in one request in update cycles (default=10, 1 disables)");
 	addvar(VAR_FLAG, "notransferoids",
 		"Disable transfer OIDs (use on APCC Symmetras)");
 	addvar(VAR_FLAG, "symmetrathreephase",
@@ -813,6 +1108,17 @@ void upsdrv_initups(void)
 		/* fatalx(EXIT_FAILURE, "Marking the exit code as failure since the driver is not started now"); */
 	}
 
+	/* the agents of the ups.conf sections hosted by ours, if any */
+	if (su_agent_cur == &su_agent_own && su_agent_own.next == NULL) {
+		su_agent_t	**last = &su_agent_own.next;
+		upsdrv_hosted_t	*dev;
+
+		for (dev = upsdrv_hosted_load(); dev; dev = dev->next) {
+			*last = su_agent_new(dev);
+			last = &(*last)->next;
+		}
+	}
+
 	/* init SNMP library, etc... */
 	nut_snmp_init(progname, device_path);
 
@@ -845,6 +1151,14 @@ void upsdrv_initups(void)
 	}
 	semistatic_countdown = semistaticfreq;
 
+	/* init prefetch request size */
+	if (testvar(SU_VAR_BATCH))
+		su_batch = atoi(getval(SU_VAR_BATCH));
+	if (su_batch < 1) {
+		upsdebugx(1, "Bad %s value provided, disabling prefetch", SU_VAR_BATCH);
+		su_batch = 1;
+	}
+
 	/* Get UPS Model node to see if there's a MIB */
 /* FIXME: extend and use match_model_OID(char *model) */
 	su_info_p = su_find_info("ups.model");
@@ -971,16 +1285,54 @@ void upsdrv_initups(void)
 	set_delays();
 }
 
-void upsdrv_cleanup(void)
+/* Release what the selected agent holds */
+static void su_agent_cleanup(void)
 {
-	/* General cleanup */
 	if (daisychain_info)
 		free(daisychain_info);
+	daisychain_info = NULL;
+
+	free(su_info_index);
+	su_info_index = NULL;
+	su_info_index_count = 0;
+	su_info_indexed = NULL;
+
+	su_prefetch_free();
 
 	/* Net-SNMP specific cleanup */
 	nut_snmp_cleanup();
 }
 
+void upsdrv_cleanup(void)
+{
+	su_agent_t	*agent, *next;
+	size_t	i;
+
+	/* The hosted agents, then ours */
+	for (agent = su_agent_own.next; agent; agent = next) {
+		next = agent->next;
+
+		su_agent_select(agent);
+		su_agent_cleanup();
+		su_agent_select(NULL);
+
+		free(agent->mapping);
+		free(agent);
+	}
+	su_agent_own.next = NULL;
+
+	su_agent_cleanup();
+	free(su_agent_own.mapping);
+	su_agent_own.mapping = NULL;
+
+	/* General cleanup */
+	for (i = 0; i < mib2nut_sysoids_count; i++)
+		free(mib2nut_sysoids[i].sysOID);
+	free(mib2nut_sysoids);
+	mib2nut_sysoids = NULL;
+	mib2nut_sysoids_count = 0;
+}
+
 /* -----------------------------------------------------------
  * SNMP functions.
  * ----------------------------------------------------------- */
@@ -1432,6 +1784,414 @@ static struct snmp_pdu **nut_snmp_walk(const char *OID, int max_iteration, int l
 	return ret_array;
 }
 
+/* Find the prefetch entry of an OID, optionally adding it */
+static su_prefetch_t *su_prefetch_find(const char *OID, int insert)
+{
+	size_t	lo = 0, hi = su_prefetch_count;
+
+	while (lo < hi) {
+		size_t	mid = lo + (hi - lo) / 2;
+		int	c = strcmp(su_prefetch[mid].OID, OID);
+
+		if (c == 0)
+			return &su_prefetch[mid];
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!insert)
+		return NULL;
+
+	if (su_prefetch_count == su_prefetch_alloc) {
+		su_prefetch_alloc = su_prefetch_alloc ? su_prefetch_alloc * 2 : 64;
+		su_prefetch = (su_prefetch_t *)xrealloc(su_prefetch,
+			su_prefetch_alloc * sizeof(*su_prefetch));
+	}
+
+	memmove(&su_prefetch[lo + 1], &su_prefetch[lo],
+		(su_prefetch_count - lo) * sizeof(*su_prefetch));
+	memset(&su_prefetch[lo], 0, sizeof(*su_prefetch));
+	su_prefetch[lo].OID = xstrdup(OID);
+	su_prefetch_count++;
+
+	return &su_prefetch[lo];
+}
+
+/* Note that OID is read in this cycle, and hand over its prefetched
+ * value if there is one (NULL otherwise, then it is read as usual) */
+static struct snmp_pdu *su_prefetch_take(const char *OID)
+{
+	su_prefetch_t	*entry;
+	struct snmp_pdu	*ret;
+
+	if (!su_prefetch_active)
+		return NULL;
+
+	entry = su_prefetch_find(OID, 1);
+	if (entry->last_cycle != su_prefetch_cycle) {
+		if (entry->last_cycle)
+			entry->period = su_prefetch_cycle - entry->last_cycle;
+		entry->last_cycle = su_prefetch_cycle;
+	}
+
+	ret = entry->response;
+	entry->response = NULL;
+	if (ret)
+		upsdebugx(4, "%s: %s is served from prefetch", __func__, OID);
+
+	return ret;
+}
+
+static int su_prefetch_callback(int operation, struct snmp_session *sp,
+	int reqid, struct snmp_pdu *pdu, void *magic)
+{
+	su_prefetch_run_t	*run;
+	size_t	i;
+
+	NUT_UNUSED_VARIABLE(sp);
+	NUT_UNUSED_VARIABLE(magic);
+
+	/* late answers of an abandoned prefetch find nothing here */
+	for (run = su_prefetch_runs; run; run = run->next_run) {
+		for (i = 0; i < run->nbatches; i++) {
+			su_prefetch_batch_t	*batch = &run->batches[i];
+
+			if (batch->reqid != reqid || batch->done)
+				continue;
+
+			batch->done = 1;
+			if (operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE && pdu != NULL)
+				batch->response = snmp_clone_pdu(pdu);
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+/* Keep the values of a batch answer for do_nut_snmp_get(), or learn
+ * from the failure; returns the count of values kept */
+static size_t su_prefetch_store(const su_prefetch_batch_t *batch, const size_t *due)
+{
+	struct snmp_pdu	*response = batch->response;
+	netsnmp_variable_list	*vb, *next;
+	size_t	i, stored = 0;
+
+	if (response->errstat == SNMP_ERR_TOOBIG) {
+		su_batch = (su_batch > 2) ? su_batch / 2 : 1;
+		upsdebugx(1, "%s: answer too big, reading %d OIDs per request from now on",
+			__func__, su_batch);
+		return 0;
+	}
+
+	if (response->errstat != SNMP_ERR_NOERROR) {
+		/* SNMPv1 fails the whole request for one bad OID */
+		if (response->errindex > 0 && (size_t)response->errindex <= batch->count) {
+			su_prefetch_t	*entry = &su_prefetch[due[batch->first + (size_t)response->errindex - 1]];
+
+			upsdebugx(2, "%s: %s failed in a batch (error %ld), will read it alone",
+				__func__, entry->OID, response->errstat);
+			entry->solo = 1;
+		}
+		return 0;
+	}
+
+	for (i = 0, vb = response->variables; i < batch->count && vb != NULL;
+		i++, vb = vb->next_variable
+	) {
+		su_prefetch_t	*entry = &su_prefetch[due[batch->first + i]];
+
+		/* exceptions are left to the classic read, which reports them */
+		if (vb->type == SNMP_NOSUCHOBJECT
+		 || vb->type == SNMP_NOSUCHINSTANCE
+		 || vb->type == SNMP_ENDOFMIBVIEW
+		) {
+			entry->solo = 1;
+			continue;
+		}
+
+		/* one varbind per stored answer, like a single GET returns */
+		next = vb->next_variable;
+		vb->next_variable = NULL;
+		entry->response = snmp_pdu_create(SNMP_MSG_RESPONSE);
+		if (entry->response != NULL)
+			entry->response->variables = snmp_clone_varbind(vb);
+		vb->next_variable = next;
+
+		if (entry->response != NULL && entry->response->variables == NULL) {
+			snmp_free_pdu(entry->response);
+			entry->response = NULL;
+		}
+		if (entry->response != NULL)
+			stored++;
+	}
+
+	return stored;
+}
+
+/* Make the due entries the prefetch in progress, in requests of up
+ * to per_request OIDs */
+static void su_prefetch_run_new(size_t *due, size_t ndue, size_t per_request)
+{
+	su_prefetch_run_t	*run;
+	size_t	i;
+
+	run = (su_prefetch_run_t *)xcalloc(1, sizeof(*run));
+	run->due = due;
+	run->ndue = ndue;
+	run->nbatches = (ndue + per_request - 1) / per_request;
+	run->batches = (su_prefetch_batch_t *)xcalloc(run->nbatches, sizeof(*run->batches));
+	for (i = 0; i < run->nbatches; i++) {
+		run->batches[i].first = i * per_request;
+		run->batches[i].count = ndue - run->batches[i].first;
+		if (run->batches[i].count > per_request)
+			run->batches[i].count = per_request;
+	}
+
+	run->next_run = su_prefetch_runs;
+	su_prefetch_runs = run;
+	su_prefetch_run = run;
+}
+
+/* Ask a lost agent for its sysObjectID only, to learn without waiting
+ * on its other reads whether it is back */
+static void su_prefetch_probe(void)
+{
+	su_prefetch_t	*entry = su_prefetch_find(SYSOID_OID, 1);
+	size_t	*due;
+
+	if (entry->name == NULL) {
+		oid	buf[MAX_OID_LEN];
+		size_t	len = MAX_OID_LEN;
+
+		if (!snmp_parse_oid(entry->OID, buf, &len))
+			return;
+		entry->name = (oid *)xcalloc(len, sizeof(oid));
+		memcpy(entry->name, buf, len * sizeof(oid));
+		entry->name_len = len;
+	}
+
+	due = (size_t *)xcalloc(1, sizeof(*due));
+	due[0] = (size_t)(entry - su_prefetch);
+	su_prefetch_run_new(due, 1, 1);
+}
+
+/* Start an update cycle: find the OIDs due in it, to read them ahead */
+static void su_prefetch_start(void)
+{
+	size_t	*due, ndue = 0, i;
+
+	su_prefetch_cycle++;
+	su_prefetch_active = (su_batch > 1);
+
+	/* while hosting several agents, a lost one is probed along with
+	 * the others' requests, and only read further once it answers
+	 * (a lone one is simply read, else it would time out twice) */
+	if (comm_status == COMM_LOST) {
+		if (su_agent_own.next != NULL)
+			su_prefetch_probe();
+		return;
+	}
+
+	if (!su_prefetch_active || su_prefetch_count == 0)
+		return;
+
+	due = (size_t *)xcalloc(su_prefetch_count, sizeof(*due));
+	for (i = 0; i < su_prefetch_count; i++) {
+		su_prefetch_t	*entry = &su_prefetch[i];
+		unsigned long	period = entry->period ? entry->period : 1;
+
+		if (entry->solo || su_prefetch_cycle - entry->last_cycle != period)
+			continue;
+
+		if (entry->name == NULL) {
+			oid	buf[MAX_OID_LEN];
+			size_t	len = MAX_OID_LEN;
+
+			if (!snmp_parse_oid(entry->OID, buf, &len)) {
+				entry->solo = 1;
+				continue;
+			}
+			entry->name = (oid *)xcalloc(len, sizeof(oid));
+			memcpy(entry->name, buf, len * sizeof(oid));
+			entry->name_len = len;
+		}
+
+		due[ndue++] = i;
+	}
+
+	if (ndue == 0) {
+		free(due);
+		return;
+	}
+
+	su_prefetch_run_new(due, ndue, (size_t)su_batch);
+}
+
+/* Send more requests of the prefetch, up to SU_PREFETCH_INFLIGHT not
+ * answered yet; returns how many are in flight */
+static size_t su_prefetch_send(void)
+{
+	su_prefetch_run_t	*run = su_prefetch_run;
+	size_t	i, j, inflight = 0;
+
+	if (run == NULL)
+		return 0;
+
+	for (i = 0; i < run->sent; i++) {
+		if (run->batches[i].reqid != 0 && !run->batches[i].done)
+			inflight++;
+	}
+
+	while (inflight < SU_PREFETCH_INFLIGHT && run->sent < run->nbatches) {
+		su_prefetch_batch_t	*batch = &run->batches[run->sent++];
+		struct snmp_pdu	*pdu = snmp_pdu_create(SNMP_MSG_GET);
+
+		if (pdu == NULL) {
+			fatalx(EXIT_FAILURE, "Not enough memory");
+		}
+
+		for (j = 0; j < batch->count; j++) {
+			su_prefetch_t	*entry = &su_prefetch[run->due[batch->first + j]];
+
+			snmp_add_null_var(pdu, entry->name, entry->name_len);
+		}
+
+		batch->reqid = snmp_async_send(g_snmp_sess_p, pdu, su_prefetch_callback, NULL);
+		if (batch->reqid == 0) {
+			upsdebugx(2, "%s: can't send a request: %s",
+				__func__, snmp_api_errstring(snmp_errno));
+			snmp_free_pdu(pdu);
+			batch->done = 1;
+			continue;
+		}
+		inflight++;
+	}
+
+	return inflight;
+}
+
+/* Wait once for the answers to the requests in flight, of all agents'
+ * prefetches (they share the Net-SNMP session list); returns -1 if the
+ * wait failed */
+static int su_prefetch_wait(void)
+{
+	fd_set	fdset;
+	struct timeval	timeout;
+	int	numfds = 0, block = 1, ret;
+
+	/* Check if we are asked to stop (reactivity++) */
+	if (exit_flag != 0) {
+		fatalx(EXIT_FAILURE, "Aborting because exit_flag was set");
+	}
+
+	FD_ZERO(&fdset);
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	snmp_select_info(&numfds, &fdset, &timeout, &block);
+	ret = select(numfds, &fdset, NULL, NULL, block ? NULL : &timeout);
+	if (ret > 0) {
+		snmp_read(&fdset);
+	} else if (ret == 0) {
+		snmp_timeout();
+	} else if (errno != EINTR) {
+		upslog_with_errno(LOG_WARNING, "%s: select", __func__);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Keep what the prefetch read for the do_nut_snmp_get() calls of the
+ * update cycle; requests still in flight are abandoned. Returns how
+ * many requests were answered (even with an error) */
+static size_t su_prefetch_collect(void)
+{
+	su_prefetch_run_t	*run = su_prefetch_run, **runp;
+	size_t	i, stored = 0, failed = 0, answered;
+
+	if (run == NULL)
+		return 0;
+
+	for (runp = &su_prefetch_runs; *runp; runp = &(*runp)->next_run) {
+		if (*runp == run) {
+			*runp = run->next_run;
+			break;
+		}
+	}
+	su_prefetch_run = NULL;
+
+	for (i = 0; i < run->nbatches; i++) {
+		if (run->batches[i].response == NULL) {
+			failed++;
+			continue;
+		}
+		stored += su_prefetch_store(&run->batches[i], run->due);
+		snmp_free_pdu(run->batches[i].response);
+	}
+
+	upsdebugx(2, "%s: %" PRIuSIZE " of %" PRIuSIZE " OIDs prefetched with %"
+		PRIuSIZE " requests (%" PRIuSIZE " failed)",
+		__func__, stored, run->ndue, run->nbatches, failed);
+
+	answered = run->nbatches - failed;
+
+	free(run->batches);
+	free(run->due);
+	free(run);
+
+	return answered;
+}
+
+/* End an update cycle: drop the unused values and the OIDs not asked
+ * for in a while (e.g. of a removed daisy chain member) */
+static void su_prefetch_end(void)
+{
+	size_t	i, kept = 0;
+
+	su_prefetch_active = 0;
+
+	for (i = 0; i < su_prefetch_count; i++) {
+		su_prefetch_t	*entry = &su_prefetch[i];
+		unsigned long	period = entry->period ? entry->period : 1;
+
+		if (entry->response != NULL) {
+			snmp_free_pdu(entry->response);
+			entry->response = NULL;
+		}
+
+		if (su_prefetch_cycle - entry->last_cycle > 2 * period + 1) {
+			free(entry->OID);
+			free(entry->name);
+			continue;
+		}
+
+		su_prefetch[kept++] = *entry;
+	}
+
+	su_prefetch_count = kept;
+}
+
+static void su_prefetch_free(void)
+{
+	size_t	i;
+
+	su_prefetch_collect();
+
+	for (i = 0; i < su_prefetch_count; i++) {
+		if (su_prefetch[i].response != NULL)
+			snmp_free_pdu(su_prefetch[i].response);
+		free(su_prefetch[i].OID);
+		free(su_prefetch[i].name);
+	}
+
+	free(su_prefetch);
+	su_prefetch = NULL;
+	su_prefetch_count = su_prefetch_alloc = 0;
+}
+
 static struct snmp_pdu *do_nut_snmp_get(const char *OID, int log_unhandled_loudly)
 {
 	struct snmp_pdu ** pdu_array;
@@ -1442,6 +2202,9 @@ static struct snmp_pdu *do_nut_snmp_get(const char *OID, int log_unhandled_loudl
 
 	upsdebugx(3, "%s(%s)", __func__, OID);
 
+	if ((ret_pdu = su_prefetch_take(OID)) != NULL)
+		return ret_pdu;
+
 	pdu_array = nut_snmp_walk(OID, 1, log_unhandled_loudly);
 
 	if(pdu_array == NULL) {
@@ -2049,10 +2812,48 @@ void su_alarm_set(snmp_info_t *su_info_p, long value)
 	/* TODO: else */
 }
 
+static int su_info_index_cmp(const void *a, const void *b)
+{
+	const snmp_info_t	*ia = *(const snmp_info_t * const *)a;
+	const snmp_info_t	*ib = *(const snmp_info_t * const *)b;
+	int	ret = strcasecmp(ia->info_type, ib->info_type);
+
+	if (ret)
+		return ret;
+
+	return (ia < ib) ? -1 : (ia > ib);
+}
+
+/* (Re-)build the su_find_info() index if snmp_info points to another
+ * table than it was built for (e.g. while probing the MIBs) */
+static void su_info_index_build(void)
+{
+	snmp_info_t	*su_info_p;
+	size_t	count = 0;
+
+	if (su_info_indexed == snmp_info)
+		return;
+
+	for (su_info_p = snmp_info; su_info_p->info_type != NULL; su_info_p++)
+		count++;
+
+	su_info_index = (snmp_info_t **)xrealloc(su_info_index,
+		(count ? count : 1) * sizeof(*su_info_index));
+	su_info_index_count = 0;
+	for (su_info_p = snmp_info; su_info_p->info_type != NULL; su_info_p++)
+		su_info_index[su_info_index_count++] = su_info_p;
+
+	qsort(su_info_index, su_info_index_count, sizeof(*su_info_index),
+		su_info_index_cmp);
+	su_info_indexed = snmp_info;
+
+	upsdebugx(3, "%s: indexed %" PRIuSIZE " entries", __func__, su_info_index_count);
+}
+
 /* find info element definition in my info array. */
 snmp_info_t *su_find_info(const char *type)
 {
-	snmp_info_t *su_info_p;
+	size_t	lo, hi;
 
 	if (snmp_info == NULL) {
 		fatalx(EXIT_FAILURE, "%s: snmp_info is not initialized", __func__);
@@ -2062,11 +2863,26 @@ snmp_info_t *su_find_info(const char *type)
 		upsdebugx(1, "%s: WARNING: snmp_info is empty", __func__);
 	}
 
-	for (su_info_p = &snmp_info[0]; (su_info_p != NULL && su_info_p->info_type != NULL) ; su_info_p++)
-		if (!strcasecmp(su_info_p->info_type, type)) {
-			upsdebugx(3, "%s: \"%s\" found", __func__, type);
-			return su_info_p;
-		}
+	su_info_index_build();
+
+	/* lower bound: the first of the entries with this info_type */
+	lo = 0;
+	hi = su_info_index_count;
+	while (lo < hi) {
+		size_t	mid = lo + (hi - lo) / 2;
+
+		if (strcasecmp(su_info_index[mid]->info_type, type) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < su_info_index_count
+	&& !strcasecmp(su_info_index[lo]->info_type, type)
+	) {
+		upsdebugx(3, "%s: \"%s\" found", __func__, type);
+		return su_info_index[lo];
+	}
 
 	upsdebugx(3, "%s: unknown info type (%s)", __func__, type);
 	return NULL;
@@ -2122,6 +2938,78 @@ static bool_t match_model_OID(void)
 	return retCode;
 }
 
+/* Retrieve sysOID value of this device */
+static bool_t get_sysoid(char *buf, size_t buf_len)
+{
+	if (nut_snmp_get_oid(SYSOID_OID, buf, buf_len) != TRUE)
+	{
+		upsdebugx(2, "Can't get sysOID value (using nut_snmp_get_oid())");
+		/* Fallback for non-compliant device, that returns a string and not an OID */
+		if (nut_snmp_get_str(SYSOID_OID, buf, buf_len, NULL) != TRUE) {
+			upsdebugx(2, "Can't get sysOID value (using nut_snmp_get_str())");
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static int mib2nut_sysoid_cmp(const void *a, const void *b)
+{
+	const mib2nut_sysoid_t	*sa = (const mib2nut_sysoid_t *)a;
+	const mib2nut_sysoid_t	*sb = (const mib2nut_sysoid_t *)b;
+	int	ret = snmp_oid_compare(sa->sysOID, sa->sysOID_len,
+		sb->sysOID, sb->sysOID_len);
+
+	if (ret)
+		return ret;
+
+	return (sa->mib2nut_idx > sb->mib2nut_idx) - (sa->mib2nut_idx < sb->mib2nut_idx);
+}
+
+/* Parse the sysOIDs of mib2nut[] entries once and sort them, so that
+ * the device sysOID is looked up rather than compared to each of them */
+static void mib2nut_sysoid_index_build(void)
+{
+	oid	buf[MAX_OID_LEN];
+	size_t	len;
+	int	i;
+
+	if (mib2nut_sysoids != NULL)
+		return;
+
+	for (i = 0; mib2nut[i] != NULL; i++)
+		;
+	mib2nut_sysoids = (mib2nut_sysoid_t *)xcalloc((size_t)(i ? i : 1),
+		sizeof(*mib2nut_sysoids));
+
+	for (i = 0; mib2nut[i] != NULL; i++) {
+		mib2nut_sysoid_t	*entry;
+
+		if (mib2nut[i]->sysOID == NULL)
+			continue;
+
+		len = MAX_OID_LEN;
+		if (!read_objid(mib2nut[i]->sysOID, buf, &len)) {
+			upsdebugx(2, "%s: can't build OID %s for MIB '%s': %s",
+				__func__, mib2nut[i]->sysOID, mib2nut[i]->mib_name,
+				snmp_api_errstring(snmp_errno));
+			continue;
+		}
+
+		entry = &mib2nut_sysoids[mib2nut_sysoids_count++];
+		entry->sysOID = (oid *)xcalloc(len, sizeof(oid));
+		memcpy(entry->sysOID, buf, len * sizeof(oid));
+		entry->sysOID_len = len;
+		entry->mib2nut_idx = i;
+	}
+
+	qsort(mib2nut_sysoids, mib2nut_sysoids_count, sizeof(*mib2nut_sysoids),
+		mib2nut_sysoid_cmp);
+
+	upsdebugx(3, "%s: indexed %" PRIuSIZE " sysOIDs", __func__, mib2nut_sysoids_count);
+}
+
 /* Try to find the MIB using sysOID matching.
  * Return a pointer to a mib2nut definition if found, NULL otherwise */
 static mib2nut_info_t *match_sysoid(void)
@@ -2129,20 +3017,11 @@ static mib2nut_info_t *match_sysoid(void)
 	char sysOID_buf[LARGEBUF];
 	oid device_sysOID[MAX_OID_LEN];
 	size_t device_sysOID_len = MAX_OID_LEN;
-	oid mib2nut_sysOID[MAX_OID_LEN];
-	size_t mib2nut_sysOID_len = MAX_OID_LEN;
+	size_t lo, hi;
 	int i;
 
-	/* Retrieve sysOID value of this device */
-	if (nut_snmp_get_oid(SYSOID_OID, sysOID_buf, sizeof(sysOID_buf)) != TRUE)
-	{
-		upsdebugx(2, "Can't get sysOID value (using nut_snmp_get_oid())");
-		/* Fallback for non-compliant device, that returns a string and not an OID */
-		if (nut_snmp_get_str(SYSOID_OID, sysOID_buf, sizeof(sysOID_buf), NULL) != TRUE) {
-			upsdebugx(2, "Can't get sysOID value (using nut_snmp_get_str())");
-			return NULL;
-		}
-	}
+	if (get_sysoid(sysOID_buf, sizeof(sysOID_buf)) != TRUE)
+		return NULL;
 
 	upsdebugx(1, "%s: device sysOID value = %s", __func__, sysOID_buf);
 
@@ -2155,59 +3034,59 @@ static mib2nut_info_t *match_sysoid(void)
 		return NULL;
 	}
 
-	/* Now, iterate on mib2nut definitions */
-	for (i = 0; mib2nut[i] != NULL; i++)
-	{
-		upsdebugx(1, "%s: checking MIB %s", __func__, mib2nut[i]->mib_name);
+	mib2nut_sysoid_index_build();
 
-		if (mib2nut[i]->sysOID == NULL)
-			continue;
+	/* Find the first index entry for this sysOID... */
+	lo = 0;
+	hi = mib2nut_sysoids_count;
+	while (lo < hi) {
+		size_t	mid = lo + (hi - lo) / 2;
 
-		/* Clear variables */
-		memset(mib2nut_sysOID, 0, sizeof(mib2nut_sysOID));
-		mib2nut_sysOID_len = MAX_OID_LEN;
+		if (snmp_oid_compare(mib2nut_sysoids[mid].sysOID,
+			mib2nut_sysoids[mid].sysOID_len,
+			device_sysOID, device_sysOID_len) < 0
+		) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
 
-		if (!read_objid(mib2nut[i]->sysOID, mib2nut_sysOID, &mib2nut_sysOID_len))
-		{
-			upsdebugx(2, "%s: can't build OID %s: %s",
-				__func__, sysOID_buf, snmp_api_errstring(snmp_errno));
+	/* ...and try the MIBs declaring it in their mib2nut[] order */
+	for (; lo < mib2nut_sysoids_count
+		&& !snmp_oid_compare(mib2nut_sysoids[lo].sysOID,
+			mib2nut_sysoids[lo].sysOID_len,
+			device_sysOID, device_sysOID_len)
+	; lo++) {
+		i = mib2nut_sysoids[lo].mib2nut_idx;
+
+		upsdebugx(2, "%s: sysOID matches MIB '%s'!", __func__, mib2nut[i]->mib_name);
+		/* Counter verify, using {ups,device}.model */
+		snmp_info = mib2nut[i]->snmp_info;
 
-			/* Try to continue anyway! */
+		if (snmp_info == NULL) {
+			upsdebugx(0, "%s: WARNING: snmp_info is not initialized "
+				"for mapping table entry #%d \"%s\"",
+				__func__, i, mib2nut[i]->mib_name
+				);
 			continue;
 		}
+		else if (snmp_info[0].info_type == NULL) {
+			upsdebugx(1, "%s: WARNING: snmp_info is empty "
+				"for mapping table entry #%d \"%s\"",
+				__func__, i, mib2nut[i]->mib_name);
+		}
 
-		/* Now compare these */
-		upsdebugx(1, "%s: comparing %s with %s", __func__, sysOID_buf, mib2nut[i]->sysOID);
-		if (!netsnmp_oid_equals(device_sysOID, device_sysOID_len, mib2nut_sysOID, mib2nut_sysOID_len))
+		if (match_model_OID() != TRUE)
 		{
-			upsdebugx(2, "%s: sysOID matches MIB '%s'!", __func__, mib2nut[i]->mib_name);
-			/* Counter verify, using {ups,device}.model */
-			snmp_info = mib2nut[i]->snmp_info;
-
-			if (snmp_info == NULL) {
-				upsdebugx(0, "%s: WARNING: snmp_info is not initialized "
-					"for mapping table entry #%d \"%s\"",
-					__func__, i, mib2nut[i]->mib_name
-					);
-				continue;
-			}
-			else if (snmp_info[0].info_type == NULL) {
-				upsdebugx(1, "%s: WARNING: snmp_info is empty "
-					"for mapping table entry #%d \"%s\"",
-					__func__, i, mib2nut[i]->mib_name);
-			}
-
-			if (match_model_OID() != TRUE)
-			{
-				upsdebugx(2, "%s: testOID provided and doesn't match MIB '%s'!", __func__, mib2nut[i]->mib_name);
-				snmp_info = NULL;
-				continue;
-			}
-			else
-				upsdebugx(2, "%s: testOID provided and matches MIB '%s'!", __func__, mib2nut[i]->mib_name);
-
-			return mib2nut[i];
+			upsdebugx(2, "%s: testOID provided and doesn't match MIB '%s'!", __func__, mib2nut[i]->mib_name);
+			snmp_info = NULL;
+			continue;
 		}
+		else
+			upsdebugx(2, "%s: testOID provided and matches MIB '%s'!", __func__, mib2nut[i]->mib_name);
+
+		return mib2nut[i];
 	}
 
 	/* Yell all to call for user report */
@@ -2219,6 +3098,203 @@ static mib2nut_info_t *match_sysoid(void)
 	return NULL;
 }
 
+/* The "mibcache" file remembers the mapping found for a kind of device,
+ * so that restarts need not probe the candidates again. Each line holds
+ * "<sysOID> TAB <mapping name> TAB <sysDescr>"; the sysOID and sysDescr
+ * (which usually carries the firmware revision) of the device are the
+ * key. The file may be shared by several driver instances. */
+
+/* Keep the key fields on one line and free of separators */
+static void mibcache_sanitize(char *str)
+{
+	for (; *str; str++) {
+		if ((unsigned char)*str < 0x20)
+			*str = ' ';
+	}
+}
+
+/* Split a cache line; returns FALSE if it is not one */
+static bool_t mibcache_parse(char *line, char **name, char **descr)
+{
+	line[strcspn(line, "\r\n")] = '\0';
+
+	if ((*name = strchr(line, '\t')) == NULL)
+		return FALSE;
+	*(*name)++ = '\0';
+
+	if ((*descr = strchr(*name, '\t')) == NULL)
+		return FALSE;
+	*(*descr)++ = '\0';
+
+	return TRUE;
+}
+
+/* Lock "<path>.lock" while the cache is read (shared) or rewritten
+ * (exclusive), so that drivers sharing the cache do not lose each
+ * other's updates: the cache file itself is replaced with rename(), so
+ * it can not hold the lock. A stuck lock holder only delays us for a
+ * second, then the cache is used unlocked. Returns the descriptor for
+ * mibcache_unlock(), or -1 without a lock. */
+static int mibcache_lock(const char *path, int exclusive)
+{
+#ifdef HAVE_FLOCK
+	char	lock_path[NUT_PATH_MAX + 8];
+	int	fd, tries;
+
+	snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+	if ((fd = open(lock_path, O_RDWR | O_CREAT, 0644)) < 0) {
+		upsdebug_with_errno(1, "%s: can't open %s", __func__, lock_path);
+		return -1;
+	}
+
+	for (tries = 0; tries < 50; tries++) {
+		if (flock(fd, (exclusive ? LOCK_EX : LOCK_SH) | LOCK_NB) == 0)
+			return fd;
+		if (errno != EWOULDBLOCK && errno != EINTR)
+			break;
+		usleep(20000);
+	}
+
+	upsdebug_with_errno(1, "%s: can't lock %s", __func__, lock_path);
+	close(fd);
+#else	/* !HAVE_FLOCK */
+	NUT_UNUSED_VARIABLE(path);
+	NUT_UNUSED_VARIABLE(exclusive);
+#endif	/* !HAVE_FLOCK */
+
+	return -1;
+}
+
+static void mibcache_unlock(int fd)
+{
+	/* closing it releases the lock */
+	if (fd >= 0)
+		close(fd);
+}
+
+/* Return the mapping cached for this device, if it is still known;
+ * several mappings may share a name, then those are told apart with
+ * their model OID like the classic method does */
+static mib2nut_info_t *mibcache_load(const char *path, const char *sysoid, const char *sysdescr)
+{
+	FILE	*f;
+	char	line[LARGEBUF], mib[SU_BUFSIZE], *name, *descr;
+	mib2nut_info_t	*found = NULL;
+	int	i, candidates = 0, lock_fd;
+
+	lock_fd = mibcache_lock(path, 0);
+	if ((f = fopen(path, "r")) == NULL) {
+		upsdebug_with_errno(2, "%s: can't open %s", __func__, path);
+		mibcache_unlock(lock_fd);
+		return NULL;
+	}
+
+	mib[0] = '\0';
+	while (fgets(line, sizeof(line), f)) {
+		if (!mibcache_parse(line, &name, &descr))
+			continue;
+		if (!strcmp(line, sysoid) && !strcmp(descr, sysdescr))
+			snprintf(mib, sizeof(mib), "%s", name);
+	}
+	fclose(f);
+	mibcache_unlock(lock_fd);
+
+	if (!*mib) {
+		upsdebugx(2, "%s: device not found in %s", __func__, path);
+		return NULL;
+	}
+
+	for (i = 0; mib2nut[i] != NULL; i++) {
+		if (mib2nut[i]->snmp_info != NULL && !strcmp(mib, mib2nut[i]->mib_name)) {
+			candidates++;
+			if (!found)
+				found = mib2nut[i];
+		}
+	}
+
+	if (candidates > 1) {
+		found = NULL;
+		for (i = 0; found == NULL && mib2nut[i] != NULL; i++) {
+			if (mib2nut[i]->snmp_info == NULL || strcmp(mib, mib2nut[i]->mib_name))
+				continue;
+
+			snmp_info = mib2nut[i]->snmp_info;
+			if (match_model_OID() == TRUE)
+				found = mib2nut[i];
+			snmp_info = NULL;
+		}
+	}
+
+	if (found)
+		upsdebugx(1, "%s: using cached '%s' MIB from %s", __func__, mib, path);
+	else
+		upsdebugx(1, "%s: cached '%s' MIB from %s does not fit anymore",
+			__func__, mib, path);
+
+	return found;
+}
+
+/* Replace (or add) the line for this device, other lines are kept;
+ * the new cache is written to a new file next to it (not following
+ * a symlink planted there), which then replaces it */
+static void mibcache_save(const char *path, const char *sysoid, const char *sysdescr, const char *mib)
+{
+	FILE	*in, *out;
+	char	tmp_path[NUT_PATH_MAX + 8], line[LARGEBUF], copy[LARGEBUF], *name, *descr;
+	int	lock_fd;
+
+	lock_fd = mibcache_lock(path, 1);
+
+#ifndef WIN32
+	{ /* scoping */
+		int	fd;
+
+		snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+		fd = mkstemp(tmp_path);
+		if (fd < 0 || fchmod(fd, 0644) != 0 || (out = fdopen(fd, "w")) == NULL) {
+			upslog_with_errno(LOG_WARNING, "Can't write MIB cache %s", tmp_path);
+			if (fd >= 0) {
+				close(fd);
+				unlink(tmp_path);
+			}
+			mibcache_unlock(lock_fd);
+			return;
+		}
+	}
+#else	/* WIN32 */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+	if ((out = fopen(tmp_path, "w")) == NULL) {
+		upslog_with_errno(LOG_WARNING, "Can't write MIB cache %s", tmp_path);
+		mibcache_unlock(lock_fd);
+		return;
+	}
+#endif	/* WIN32 */
+
+	if ((in = fopen(path, "r")) != NULL) {
+		while (fgets(line, sizeof(line), in)) {
+			snprintf(copy, sizeof(copy), "%s", line);
+			if (!mibcache_parse(copy, &name, &descr))
+				continue;
+			if (!strcmp(copy, sysoid) && !strcmp(descr, sysdescr))
+				continue;
+			fputs(line, out);
+		}
+		fclose(in);
+	}
+
+	fprintf(out, "%s\t%s\t%s\n", sysoid, mib, sysdescr);
+
+	if (fclose(out) != 0 || rename(tmp_path, path) != 0) {
+		upslog_with_errno(LOG_WARNING, "Can't update MIB cache %s", path);
+		unlink(tmp_path);
+		mibcache_unlock(lock_fd);
+		return;
+	}
+
+	mibcache_unlock(lock_fd);
+	upsdebugx(1, "%s: stored '%s' MIB in %s", __func__, mib, path);
+}
+
 /* Load the right snmp_info_t structure matching mib parameter */
 bool_t load_mib2nut(const char *mib)
 {
@@ -2227,6 +3303,9 @@ bool_t load_mib2nut(const char *mib)
 	/* Below we have many checks for "auto"; avoid redundant string walks: */
 	bool_t mibIsAuto = (0 == strcmp(mib, "auto"));
 	bool_t mibSeen = FALSE; /* Did we see the MIB name while walking mib2nut[]? */
+	const char *mibcache = testvar(SU_VAR_MIBCACHE) ? getval(SU_VAR_MIBCACHE) : NULL;
+	char cache_sysoid[LARGEBUF], cache_sysdescr[SU_LARGEBUF];
+	bool_t cacheKey = FALSE; /* Can the result be cached (and was it not)? */
 
 	upsdebugx(1, "SNMP UPS driver: entering %s(%s) to detect "
 		"proper MIB for device [%s] (host %s)",
@@ -2235,10 +3314,26 @@ bool_t load_mib2nut(const char *mib)
 		device_path /* the "port" from config section is hostname/IP for networked drivers */
 		);
 
+	/* With a MIB cache, a device seen before needs no probing at all */
+	if (mibIsAuto && mibcache != NULL)
+	{
+		if (get_sysoid(cache_sysoid, sizeof(cache_sysoid)) == TRUE
+		&&  nut_snmp_get_str(SYSDESCR_OID, cache_sysdescr, sizeof(cache_sysdescr), NULL) == TRUE
+		) {
+			mibcache_sanitize(cache_sysoid);
+			mibcache_sanitize(cache_sysdescr);
+			m2n = mibcache_load(mibcache, cache_sysoid, cache_sysdescr);
+			cacheKey = (m2n == NULL);
+		} else {
+			upsdebugx(2, "%s: can't get sysOID and sysDescr for the MIB cache",
+				__func__);
+		}
+	}
+
 	/* First, try to match against sysOID, if no MIB was provided.
 	 * This should speed up init stage
 	 * (Note: sysOID points the device main MIB entry point) */
-	if (mibIsAuto)
+	if (mibIsAuto && m2n == NULL)
 	{
 		upsdebugx(2, "%s: trying the new match_sysoid() method with %s",
 			__func__, mib);
@@ -2324,7 +3419,7 @@ bool_t load_mib2nut(const char *mib)
 	/* Store the result, if any */
 	if (m2n != NULL)
 	{
-		snmp_info = m2n->snmp_info;
+		snmp_info = su_agent_mapping(m2n->snmp_info);
 		OID_pwr_status = m2n->oid_pwr_status;
 		mibname = m2n->mib_name;
 		mibvers = m2n->mib_version;
@@ -2333,6 +3428,9 @@ bool_t load_mib2nut(const char *mib)
 			__func__, mibname,
 			upsname ? upsname : device_name, device_path);
 
+		if (cacheKey)
+			mibcache_save(mibcache, cache_sysoid, cache_sysdescr, mibname);
+
 		/* FIXME: also "tripplite" on devices that do not identify as such */
 		if (mibIsAuto && strcasecmp(mibname, "ietf"))
 			upsdebugx(0, "Only the IETF standard mapping was found as fallback. "
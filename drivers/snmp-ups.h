@@ -139,6 +139,7 @@
 #define DEFAULT_NETSNMP_RETRIES   5
 #define DEFAULT_NETSNMP_TIMEOUT   1    /* in seconds */
 #define DEFAULT_SEMISTATICFREQ    10   /* in snmpwalk update cycles */
+#define DEFAULT_BATCH             10   /* OIDs per prefetch request */
 
 /* use explicit booleans */
 #ifndef FALSE
@@ -371,7 +372,9 @@ typedef struct {
 #define SU_VAR_TIMEOUT		"snmp_timeout"
 #define SU_VAR_SEMISTATICFREQ	"semistaticfreq"
 #define SU_VAR_MIBS			"mibs"
+#define SU_VAR_MIBCACHE		"mibcache"
 #define SU_VAR_POLLFREQ		"pollfreq"
+#define SU_VAR_BATCH		"snmp_batch"
 /* SNMP v3 related parameters */
 #define SU_VAR_SECLEVEL		"secLevel"
 #define SU_VAR_SECNAME		"secName"
@@ -398,6 +401,9 @@ typedef struct {
 #define SU_MODE_INSTCMD     1
 #define SU_MODE_SETVAR      2
 
+/* prefetch requests sent to the agent at once */
+#define SU_PREFETCH_INFLIGHT	4
+
 /* log spew limiters */
 #define SU_ERR_LIMIT 10	/* start limiting after this many errors in a row  */
 #define SU_ERR_RATE 100	/* only print every nth error once limiting starts */
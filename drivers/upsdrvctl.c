@@ -45,6 +45,7 @@ typedef struct {
 	char	*upsname;
 	char	*driver;
 	char	*port;
+	char	*hosted_by;	/* served by the driver of that section */
 	int	sdorder;
 	int	maxstartdelay;
 	int	maxretry;
@@ -208,6 +209,9 @@ void do_upsconf_args(char *arg_upsname, char *var, char *val)
 			if (!strcmp(var, "port"))
 				tmp->port = xstrdup(val);
 
+			if (!strcmp(var, "hosted_by"))
+				tmp->hosted_by = xstrdup(val);
+
 			if (!strcmp(var, "maxstartdelay"))
 				tmp->maxstartdelay = atoi(val);
 
@@ -240,6 +244,7 @@ void do_upsconf_args(char *arg_upsname, char *var, char *val)
 	tmp->upsname = xstrdup(arg_upsname);
 	tmp->driver = NULL;
 	tmp->port = NULL;
+	tmp->hosted_by = NULL;
 	tmp->pid = -1;
 	tmp->next = NULL;
 	tmp->sdorder = 0;
@@ -254,6 +259,9 @@ void do_upsconf_args(char *arg_upsname, char *var, char *val)
 	if (!strcmp(var, "port"))
 		tmp->port = xstrdup(val);
 
+	if (!strcmp(var, "hosted_by"))
+		tmp->hosted_by = xstrdup(val);
+
 	if (last)
 		last->next = tmp;
 	else
@@ -1653,6 +1661,16 @@ static void send_one_driver(void (*command_func)(const ups_t *), const char *arg
 	exec_timeout = 0;
 	while (ups) {
 		if (!strcmp(ups->upsname, arg_upsname)) {
+			/* no driver process of its own to act on */
+			if (ups->hosted_by
+			&&  command_func != &list_driver
+			&&  command_func != &status_driver
+			) {
+				upslogx(LOG_INFO, "UPS [%s] is served by the driver of [%s]",
+					ups->upsname, ups->hosted_by);
+				return;
+			}
+
 			command_func(ups);
 			return;
 		}
@@ -1710,7 +1728,12 @@ static void send_all_drivers(void (*command_func)(const ups_t *))
 		}
 
 		while (ups) {
-			command_func(ups);
+			if (ups->hosted_by) {
+				upsdebugx(1, "UPS [%s] is served by the driver of [%s], skipped",
+					ups->upsname, ups->hosted_by);
+			} else {
+				command_func(ups);
+			}
 
 			ups = (ups_t*)ups->next;
 		}
@@ -1721,7 +1744,7 @@ static void send_all_drivers(void (*command_func)(const ups_t *))
 	/* Orderly processing of shutdowns */
 	for (i = 0; i <= maxsdorder; i++) {
 		while (ups) {
-			if (ups->sdorder == i)
+			if (ups->sdorder == i && !ups->hosted_by)
 				command_func(ups);
 
 			ups = (ups_t*)ups->next;
@@ -1757,6 +1780,7 @@ static void exit_cleanup(void)
 
 		free(tmp->driver);
 		free(tmp->port);
+		free(tmp->hosted_by);
 		free(tmp->upsname);
 		free(tmp);
 
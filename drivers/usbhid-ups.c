@@ -29,7 +29,7 @@
  */
 
 #define DRIVER_NAME	"Generic HID driver"
-#define DRIVER_VERSION	"0.74"
+#define DRIVER_VERSION	"0.75"
 
 #define HU_VAR_WAITBEFORERECONNECT "waitbeforereconnect"
 
@@ -3223,7 +3223,7 @@ static int ups_infoval_set(hid_info_t *item, double value)
 
 		dstate_setinfo(item->info_type, "%s", nutvalue);
 	} else {
-		dstate_setinfo_dynamic(item->info_type, item->dfl, "%f", value);
+		dstate_setinfo_double_dynamic(item->info_type, item->dfl, value);
 	}
 
 	return 1;
@@ -608,6 +608,28 @@ void upslog_with_errno(int priority, const char *fmt, ...)
 void upslogx(int priority, const char *fmt, ...)
 	__attribute__ ((__format__ (__printf__, 2, 3)));
 
+/* Deferred logging: while enabled and not printing to stderr/stdout,
+ * upslog*() and upsdebug*() messages are kept in a preallocated ring of
+ * `slots` entries (SIZE_MAX = default size, 0 = deliver and disable),
+ * and a writer thread passes them to syslog, so callers (any thread)
+ * do not wait for it. When the ring is full, debug and informational
+ * messages are dropped and counted, notices and more important ones
+ * wait for a free slot. exit() handlers deliver what is queued. Not
+ * available (logging stays synchronous) in builds without pthreads.
+ * Can be disabled by the caller environment with NUT_LOG_ASYNC=false
+ * for troubleshooting.
+ */
+void upslog_async_enable(size_t slots);
+/* Wait until the queued messages are delivered (e.g. before fork()),
+ * returns their number */
+size_t upslog_async_flush(void);
+/* Count of messages dropped due to a full ring since start */
+uintmax_t upslog_async_dropped(void);
+/* Hand the messages meant for syslog to this callback instead (e.g. to
+ * capture them in tests), or to syslog again if NULL. Set it while no
+ * other thread logs. */
+void upslog_set_sink(void (*sink)(int priority, const char *msg));
+
 /* upsdebug*() messages are only logged if debugging
  * level is high enough. To speed up a bit (minimize
  * passing of ultimately ignored data trough the stack)
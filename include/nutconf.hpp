@@ -655,6 +655,8 @@ public:
 
 	NutParser(const char* buffer = nullptr, unsigned int options = OPTION_DEFAULT);
 	NutParser(const std::string& buffer, unsigned int options = OPTION_DEFAULT);
+	/** Parse the buffer in place (without a copy) */
+	NutParser(std::string&& buffer, unsigned int options = OPTION_DEFAULT);
 
 	virtual ~NutParser();
 
@@ -706,6 +708,19 @@ public:
 	std::string parseSTRCHARS();
 	Token parseToken();
 	std::list<Token> parseLine();
+
+	/**
+	 *  \brief  Parse tokens of the next line
+	 *
+	 *  Unlike the list-returning variant, the vector (and the capacity
+	 *  of its items) may be reused from line to line.
+	 *
+	 *  \param[out]  tokens  Tokens of the line (cleared first)
+	 *
+	 *  \retval true  if the line was parsed (it may have no tokens)
+	 *  \retval false at end of buffer or on an unexpected character
+	 */
+	bool parseLine(std::vector<Token>& tokens);
 	/** \} */
 
 #ifndef UNITEST_MODE
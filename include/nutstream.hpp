@@ -125,6 +125,29 @@ class NutStream {
 	 */
 	virtual status_t getString(std::string & str) = 0;
 
+	/**
+	 *  \brief  Read a chunk of characters from the stream
+	 *
+	 *  The method appends up to \c max_size characters from current
+	 *  position to \c data (which may contain null characters) and
+	 *  shifts the position past them.
+	 *  It allows consumers to process the stream in blocks rather
+	 *  than character by character; implementations may provide less
+	 *  characters than asked for even before the end of stream.
+	 *
+	 *  The default implementation is based on \ref getChar and
+	 *  \ref readChar (so it may block until \c max_size characters
+	 *  are read).
+	 *
+	 *  \param[out]  data      Data (read characters are appended)
+	 *  \param[in]   max_size  Maximal count of characters to read
+	 *
+	 *  \retval NUTS_OK    on success (at least one character read),
+	 *  \retval NUTS_EOF   on end of stream (nothing was read),
+	 *  \retval NUTS_ERROR on read error
+	 */
+	virtual status_t getData(std::string & data, size_t max_size);
+
 	/**
 	 *  \brief  Put one character to the stream end
 	 *
@@ -225,6 +248,7 @@ class NutMemory: public NutStream {
 	status_t getChar(char & ch) override;
 	void     readChar() override;
 	status_t getString(std::string & str) override;
+	status_t getData(std::string & data, size_t max_size) override;
 	status_t putChar(char ch) override;
 	status_t putString(const std::string & str) override;
 	status_t putData(const std::string & data) override;
@@ -662,6 +686,12 @@ class NutFile: public NutStream {
 #endif
 		override;
 
+	status_t getData(std::string & data, size_t max_size)
+#if (defined __cplusplus) && (__cplusplus < 201100)
+		throw()
+#endif
+		override;
+
 	status_t putChar(char ch)
 #if (defined __cplusplus) && (__cplusplus < 201100)
 		throw()
@@ -884,11 +914,14 @@ class NutSocket: public NutStream {
 	domain_t m_domain;
 	type_t m_type;
 
-	/** Current character cache */
-	char m_current_ch;
+	/** Read buffer (so that characters are not read one by one) */
+	char m_rbuf[512];
 
-	/** Current character cache status */
-	bool m_current_ch_valid;
+	/** Position of current character in the read buffer */
+	size_t m_rbuf_pos;
+
+	/** Count of characters in the read buffer */
+	size_t m_rbuf_len;
 
 	/**
 	 *  \brief  Accept client connection on a listen socket
@@ -1000,8 +1033,8 @@ class NutSocket: public NutStream {
 		m_impl(-1),
 		m_domain(NUTSOCKD_UNDEFINED),
 		m_type(NUTSOCKT_UNDEFINED),
-		m_current_ch('\0'),
-		m_current_ch_valid(false)
+		m_rbuf_pos(0),
+		m_rbuf_len(0)
 	{
 		accept(*this, listen_sock, err_code, err_msg);
 	}
@@ -1017,8 +1050,8 @@ class NutSocket: public NutStream {
 		m_impl(-1),
 		m_domain(NUTSOCKD_UNDEFINED),
 		m_type(NUTSOCKT_UNDEFINED),
-		m_current_ch('\0'),
-		m_current_ch_valid(false)
+		m_rbuf_pos(0),
+		m_rbuf_len(0)
 	{
 		accept(*this, listen_sock);
 	}
@@ -1315,6 +1348,12 @@ class NutSocket: public NutStream {
 #endif
 		override;
 
+	status_t getData(std::string & data, size_t max_size)
+#if (defined __cplusplus) && (__cplusplus < 201100)
+		throw()
+#endif
+		override;
+
 	status_t putChar(char ch)
 #if (defined __cplusplus) && (__cplusplus < 201100)
 		throw()
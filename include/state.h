@@ -42,11 +42,14 @@ typedef struct timeval	st_tree_timespec_t;
 /* Absorb the build-time variation */
 double difftime_st_tree_timespec(st_tree_timespec_t finish, st_tree_timespec_t start);
 
+/* Values up to this size (with the trailing NUL) are kept in the node */
+#define ST_INLINE_LEN	24
+
 typedef struct st_tree_s {
-	char	*var;
+	const char	*var;		/* interned, see state_intern() */
 	char	*val;			/* points to raw or safe */
 
-	char	*raw;			/* raw data from caller */
+	char	*raw;			/* raw data from caller, inl if short */
 	size_t	rawsize;
 
 	char	*safe;			/* safe data from pconf_encode */
@@ -55,19 +58,50 @@ typedef struct st_tree_s {
 	int	flags;
 	long	aux;
 
+	/* Numeric shadow of "raw" maintained by typed setters such as
+	 * dstate_setinfo_double(): if numfmt is not NULL, then "raw" was
+	 * last produced by formatting numval with numfmt (and numprec).
+	 * Any other change of the value resets numfmt to NULL.
+	 */
+	const char	*numfmt;
+	int	numprec;
+	union {
+		double	d;
+		long	l;
+	} numval;
+
 	/* When was this entry last written (meaning that
 	 * val/raw/safe, flags, aux, enum or range value
 	 * was added, changed or deleted)?
 	 */
 	st_tree_timespec_t	lastset;
 
+	/* Each list is one contiguous block (enum values are stored
+	 * after the array), its items are linked in order as usual */
 	struct enum_s		*enum_list;
 	struct range_s		*range_list;
 
 	struct st_tree_s	*left;
 	struct st_tree_s	*right;
+
+	/* Nodes of a tree are carved from the chunks of its arena */
+	struct st_arena_s	*arena;
+	char	inl[ST_INLINE_LEN];
 } st_tree_t;
 
+/* Variable names (and other protocol words) are interned: the whole
+ * process keeps one copy of each distinct name, matched regardless of
+ * case (the first spelling seen is kept), so interned names can be
+ * compared as pointers. Entries are never freed. Not thread-safe.
+ * state_intern() adds the name if it is new, state_intern_find()
+ * returns NULL for a name never interned. state_intern_hash() gives
+ * the case-insensitive hash stored for an interned name. */
+const char *state_intern(const char *name);
+const char *state_intern_find(const char *name);
+size_t state_intern_hash(const char *interned);
+/* count of interned names, and memory used by the table (bytes) */
+void state_intern_stats(size_t *count, size_t *bytes);
+
 int state_get_timestamp(st_tree_timespec_t *now);
 int st_tree_node_compare_timestamp(const st_tree_t *node, const st_tree_timespec_t *cutoff);
 int state_setinfo(st_tree_t **nptr, const char *var, const char *val);
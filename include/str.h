@@ -145,6 +145,10 @@ char *strsep(char **stringp, const char *delim);
  * the caller can use and must free() later on */
 char *	str_concat(size_t count, ...);
 
+/* FNV-1a hash of a string (of its lower-case form if "nocase" is set),
+ * for the hash table indexes of names in daemons and drivers */
+size_t	str_hash_fnv1a(const char *string, int nocase);
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
@@ -112,7 +112,7 @@
 %define SO_MAJOR_LIBNUTCLIENT	4
 %define SO_MAJOR_LIBNUTCLIENTSTUB	1
 %define SO_MAJOR_LIBNUTSCAN	4
-%define SO_MAJOR_LIBNUTCONF	0
+%define SO_MAJOR_LIBNUTCONF	1
 
 # If not published, nutconf is built with a statically linked library variant
 %define NUTPKG_WITH_LIBNUTCONF	0
@@ -28,10 +28,58 @@
 #include "nut_stdint.h"
 #include <ctype.h>
 #include <errno.h>
+#ifndef WIN32
+# include <fcntl.h>
+# include <sys/wait.h>
+#endif	/* !WIN32 */
 
 static ups_t	*upstable = NULL;
 int	num_ups = 0;
 
+/* set while a reload applies upsd.conf */
+static int	conf_reloading = 0;
+
+#ifndef WIN32
+/* Reloads read the configuration files in a child process, so the main
+ * loop goes on serving clients meanwhile. The child sends back what it
+ * has read as a stream of records: a type character followed by the
+ * count of arguments, then the arguments; each of these NUL-terminated.
+ * The main loop then applies the result in one go, see conf_reload().
+ */
+#define RELOAD_STATEPATH	'S'	/* STATEPATH from ups.conf */
+#define RELOAD_UPS		'U'	/* ups.conf section: name, driver[, desc] */
+#define RELOAD_UPSDCONF		'C'	/* upsd.conf directive */
+#define RELOAD_UPSDCONF_ERR	'E'	/* upsd.conf line with a parse error */
+#define RELOAD_USERS		'L'	/* upsd.users was read, its lines follow */
+#define RELOAD_USER		'A'	/* upsd.users line */
+
+/* seconds the reader process may take (e.g. a hung network filesystem)
+ * before it is killed and the current configuration is kept */
+#define RELOAD_TIMEOUT	60
+
+/* in the reader process */
+static FILE	*reload_out = NULL;
+
+/* in the main process */
+static pid_t	reload_pid = -1, reload_killed_pid = -1;
+static time_t	reload_started = 0;
+static int	reload_fd = -1;
+static char	*reload_buf = NULL;
+static size_t	reload_len = 0, reload_alloc = 0;
+
+static void reload_put(char type, size_t numargs, char **arg)
+{
+	size_t	i;
+
+	fprintf(reload_out, "%c%" PRIuSIZE "%c", type, numargs, '\0');
+
+	for (i = 0; i < numargs; i++) {
+		fputs(arg[i], reload_out);
+		fputc('\0', reload_out);
+	}
+}
+#endif	/* !WIN32 */
+
 /* Users can pass a -D[...] option to enable debugging.
  * For the service tracing purposes, also the upsd.conf
  * can define a debug_min value in the global section,
@@ -49,11 +97,9 @@ static void ups_create(const char *fn, const char *name, const char *desc)
 {
 	upstype_t	*temp;
 
-	for (temp = firstups; temp != NULL; temp = temp->next) {
-		if (!strcasecmp(temp->name, name)) {
-			upslogx(LOG_ERR, "UPS name [%s] is already in use!", name);
-			return;
-		}
+	if (get_ups_ptr(name) != NULL) {
+		upslogx(LOG_ERR, "UPS name [%s] is already in use!", name);
+		return;
 	}
 
 	/* grab some memory and add the info */
@@ -87,6 +133,7 @@ static void ups_create(const char *fn, const char *name, const char *desc)
 
 	temp->next = firstups;
 	firstups = temp;
+	ups_index_add(temp);
 	num_ups++;
 }
 
@@ -135,12 +182,14 @@ static void ups_update(const char *fn, const char *name, const char *desc)
 
 	/* update the description */
 
-	free(temp->desc);
+	if (desc == NULL || temp->desc == NULL || strcmp(temp->desc, desc)) {
+		free(temp->desc);
 
-	if (desc)
-		temp->desc = xstrdup(desc);
-	else
-		temp->desc = NULL;
+		if (desc)
+			temp->desc = xstrdup(desc);
+		else
+			temp->desc = NULL;
+	}
 
 	/* always set this on reload */
 	temp->retain = 1;
@@ -370,6 +419,10 @@ static int parse_upsd_conf_args(size_t numargs, char **arg)
 
 	/* LISTEN <address> [<port>] */
 	if (!strcmp(arg[0], "LISTEN")) {
+		/* don't change listening addresses on reload */
+		if (conf_reloading)
+			return 1;
+
 		if (numargs < 3)
 			listen_add(arg[1], string_const(NUT_PORT));
 		else
@@ -409,7 +462,57 @@ static void upsd_conf_err(const char *errmsg)
 	upslogx(LOG_ERR, "Fatal error in parseconf (upsd.conf): %s", errmsg);
 }
 
-void load_upsdconf(int reloading)
+/* apply one upsd.conf directive, returns 1 if it was not usable */
+static int upsdconf_line(size_t numargs, char **arg)
+{
+	size_t	i;
+	char	errmsg[SMALLBUF];
+
+	if (numargs < 1)
+		return 0;
+
+	if (parse_upsd_conf_args(numargs, arg))
+		return 0;
+
+	snprintf(errmsg, sizeof(errmsg),
+		"upsd.conf: invalid directive");
+
+	for (i = 0; i < numargs; i++)
+		snprintfcat(errmsg, sizeof(errmsg), " %s",
+			arg[i]);
+
+	upslogx(LOG_WARNING, "%s", errmsg);
+	return 1;
+}
+
+/* wrap up after all of upsd.conf was applied */
+static void upsdconf_done(int reloading, int numerrors)
+{
+	if (reloading) {
+		if (nut_debug_level_global > -1) {
+			upslogx(LOG_INFO,
+				"Applying DEBUG_MIN %d from upsd.conf",
+				nut_debug_level_global);
+			nut_debug_level = nut_debug_level_global;
+		} else {
+			/* DEBUG_MIN is absent or commented-away in ups.conf */
+			upslogx(LOG_INFO,
+				"Applying debug level %d from "
+				"original command line arguments",
+				nut_debug_level_args);
+			nut_debug_level = nut_debug_level_args;
+		}
+	}
+
+	/* FIXME: Per legacy behavior, we silently went on.
+	 * Maybe should abort on unusable configs?
+	 */
+	if (numerrors) {
+		upslogx(LOG_ERR, "Encountered %d config errors, those entries were ignored", numerrors);
+	}
+}
+
+int load_upsdconf(int reloading)
 {
 	char	fn[NUT_PATH_MAX];
 	PCONF_CTX_t	ctx;
@@ -433,7 +536,7 @@ retry:
 			fatalx(EXIT_FAILURE, "%s", ctx.errmsg);
 
 		upslogx(LOG_ERR, "Reload failed: %s", ctx.errmsg);
-		return;
+		return 0;
 	}
 
 	if (reloading) {
@@ -442,59 +545,43 @@ retry:
 		 * setting, detect that */
 		nut_debug_level_global = -1;
 	}
+	conf_reloading = reloading;
 
 	while (pconf_file_next(&ctx)) {
 		if (pconf_parse_error(&ctx)) {
 			upslogx(LOG_ERR, "Parse error: %s:%d: %s",
 				fn, ctx.linenum, ctx.errmsg);
+#ifndef WIN32
+			if (reload_out) {
+				reload_put(RELOAD_UPSDCONF_ERR, 0, NULL);
+				continue;
+			}
+#endif	/* !WIN32 */
 			numerrors++;
 			continue;
 		}
 
-		if (ctx.numargs < 1)
+#ifndef WIN32
+		if (reload_out) {
+			/* the main process applies it */
+			reload_put(RELOAD_UPSDCONF, ctx.numargs, ctx.arglist);
 			continue;
-
-		if (!parse_upsd_conf_args(ctx.numargs, ctx.arglist)) {
-			unsigned int	i;
-			char	errmsg[SMALLBUF];
-
-			snprintf(errmsg, sizeof(errmsg),
-				"upsd.conf: invalid directive");
-
-			for (i = 0; i < ctx.numargs; i++)
-				snprintfcat(errmsg, sizeof(errmsg), " %s",
-					ctx.arglist[i]);
-
-			numerrors++;
-			upslogx(LOG_WARNING, "%s", errmsg);
 		}
+#endif	/* !WIN32 */
 
+		numerrors += upsdconf_line(ctx.numargs, ctx.arglist);
 	}
 
-	if (reloading) {
-		if (nut_debug_level_global > -1) {
-			upslogx(LOG_INFO,
-				"Applying DEBUG_MIN %d from upsd.conf",
-				nut_debug_level_global);
-			nut_debug_level = nut_debug_level_global;
-		} else {
-			/* DEBUG_MIN is absent or commented-away in ups.conf */
-			upslogx(LOG_INFO,
-				"Applying debug level %d from "
-				"original command line arguments",
-				nut_debug_level_args);
-			nut_debug_level = nut_debug_level_args;
-		}
-	}
+	pconf_finish(&ctx);
+	conf_reloading = 0;
 
-	/* FIXME: Per legacy behavior, we silently went on.
-	 * Maybe should abort on unusable configs?
-	 */
-	if (numerrors) {
-		upslogx(LOG_ERR, "Encountered %d config errors, those entries were ignored", numerrors);
-	}
+#ifndef WIN32
+	if (reload_out)
+		return 1;
+#endif	/* !WIN32 */
 
-	pconf_finish(&ctx);
+	upsdconf_done(reloading, numerrors);
+	return 1;
 }
 
 static int load_upsconf(int reloading) {
@@ -515,6 +602,24 @@ static int load_upsconf(int reloading) {
 	return ret;
 }
 
+/* STATEPATH <dir> from ups.conf */
+static void upsconf_statepath(const char *val)
+{
+	const char *sp = getenv("NUT_STATEPATH");
+	if (sp && strcmp(sp, val)) {
+		/* Only warn if the two strings are not equal */
+		upslogx(LOG_WARNING,
+			"Ignoring STATEPATH='%s' from ups.conf configuration file, "
+			"in favor of NUT_STATEPATH='%s' environment variable",
+			NUT_STRARG(val), NUT_STRARG(sp));
+	}
+	free(statepath);
+	statepath = xstrdup(sp ? sp : val);
+	/* This setting source keeps priority
+	 * to best match up with the drivers */
+	setenv("NUT_STATEPATH", statepath, 1);
+}
+
 /* callback during parsing of ups.conf */
 void do_upsconf_args(char *upsname, char *var, char *val)
 {
@@ -525,28 +630,26 @@ void do_upsconf_args(char *upsname, char *var, char *val)
 
 		/* STATEPATH <dir> (may be lower-case) */
 		if (!strcasecmp(var, "STATEPATH")) {
-			const char *sp = getenv("NUT_STATEPATH");
-			if (sp && strcmp(sp, val)) {
-				/* Only warn if the two strings are not equal */
-				upslogx(LOG_WARNING,
-					"Ignoring STATEPATH='%s' from ups.conf configuration file, "
-					"in favor of NUT_STATEPATH='%s' environment variable",
-					NUT_STRARG(val), NUT_STRARG(sp));
+#ifndef WIN32
+			if (reload_out) {
+				reload_put(RELOAD_STATEPATH, 1, &val);
+				return;
 			}
-			free(statepath);
-			statepath = xstrdup(sp ? sp : val);
-			/* This setting source keeps priority
-			 * to best match up with the drivers */
-			setenv("NUT_STATEPATH", statepath, 1);
+#endif	/* !WIN32 */
+			upsconf_statepath(val);
 		}
 
 		return;
 	}
 
-	/* check if UPS is already listed */
-	for (temp = upstable; temp != NULL; temp = temp->next) {
-		if (!strcmp(temp->upsname, upsname)) {
-			break;
+	/* check if UPS is already listed: usually it is the section
+	 * being parsed, which was added last */
+	temp = upstable;
+	if (temp != NULL && strcmp(temp->upsname, upsname)) {
+		for (temp = temp->next; temp != NULL; temp = temp->next) {
+			if (!strcmp(temp->upsname, upsname)) {
+				break;
+			}
 		}
 	}
 
@@ -570,11 +673,24 @@ void do_upsconf_args(char *upsname, char *var, char *val)
 	}
 }
 
+/* add a UPS from ups.conf, or update the one with the same name */
+static void upsconf_ups(int reloading, const char *name, const char *driver, const char *desc)
+{
+	char	statefn[NUT_PATH_MAX];
+
+	snprintf(statefn, sizeof(statefn), "%s-%s", driver, name);
+
+	/* if a UPS exists, update it, else add it as new */
+	if ((reloading) && (get_ups_ptr(name) != NULL))
+		ups_update(statefn, name, desc);
+	else
+		ups_create(statefn, name, desc);
+}
+
 /* add valid UPSes from ups.conf to the internal structures */
 void upsconf_add(int reloading)
 {
 	ups_t	*tmp = upstable, *next;
-	char	statefn[NUT_PATH_MAX];
 
 	if (!tmp) {
 		upslogx(LOG_WARNING, "Warning: no UPS definitions in ups.conf");
@@ -596,15 +712,18 @@ void upsconf_add(int reloading)
 		if ((!tmp->driver) || (!tmp->port)) {
 			upslogx(LOG_WARNING, "Warning: ignoring incomplete configuration for UPS [%s]\n",
 				tmp->upsname);
+#ifndef WIN32
+		} else if (reload_out) {
+			/* the main process applies it */
+			char	*arg[3];
+
+			arg[0] = tmp->upsname;
+			arg[1] = tmp->driver;
+			arg[2] = tmp->desc;
+			reload_put(RELOAD_UPS, tmp->desc ? 3 : 2, arg);
+#endif	/* !WIN32 */
 		} else {
-			snprintf(statefn, sizeof(statefn), "%s-%s",
-				tmp->driver, tmp->upsname);
-
-			/* if a UPS exists, update it, else add it as new */
-			if ((reloading) && (get_ups_ptr(tmp->upsname) != NULL))
-				ups_update(statefn, tmp->upsname, tmp->desc);
-			else
-				ups_create(statefn, tmp->upsname, tmp->desc);
+			upsconf_ups(reloading, tmp->upsname, tmp->driver, tmp->desc);
 		}
 
 		/* free tmp's resources */
@@ -622,55 +741,62 @@ void upsconf_add(int reloading)
 	upstable = NULL;
 }
 
-/* remove a UPS from the linked list */
-static void delete_ups(upstype_t *target)
+/* remove a UPS from the linked list, given the pointer which links it */
+static void delete_ups(upstype_t **link)
 {
-	upstype_t	*ptr, *last;
-
-	if (!target)
-		return;
-
-	ptr = last = firstups;
+	upstype_t	*ptr = *link;
 
-	while (ptr) {
-		if (ptr == target) {
-			upslogx(LOG_NOTICE, "Deleting UPS [%s]", target->name);
+	upslogx(LOG_NOTICE, "Deleting UPS [%s]", ptr->name);
 
-			/* make sure nobody stays logged into this thing */
-			kick_login_clients(target->name);
+	/* make sure nobody stays logged into this thing */
+	kick_login_clients(ptr->name);
 
-			/* about to delete the first ups? */
-			if (ptr == last)
-				firstups = ptr->next;
-			else
-				last->next = ptr->next;
+	*link = ptr->next;
+	ups_index_del(ptr);
+	num_ups--;
 
-			if (VALID_FD(ptr->sock_fd))
+	if (VALID_FD(ptr->sock_fd))
 #ifndef WIN32
-				close(ptr->sock_fd);
+		close(ptr->sock_fd);
 #else	/* WIN32 */
-				CloseHandle(ptr->sock_fd);
+		CloseHandle(ptr->sock_fd);
 #endif	/* WIN32 */
 
-			/* release memory */
-			sstate_infofree(ptr);
-			sstate_cmdfree(ptr);
-			pconf_finish(&ptr->sock_ctx);
+	/* release memory */
+	sstate_infofree(ptr);
+	sstate_cmdfree(ptr);
+	pconf_finish(&ptr->sock_ctx);
 
-			free(ptr->fn);
-			free(ptr->name);
-			free(ptr->desc);
-			free(ptr);
+	free(ptr->fn);
+	free(ptr->name);
+	free(ptr->desc);
+	free(ptr);
+}
 
-			return;
-		}
+/* reset retain flags on all known UPS entries */
+static void ups_retain_reset(void)
+{
+	upstype_t	*upstmp;
 
-		last = ptr;
-		ptr = ptr->next;
+	for (upstmp = firstups; upstmp; upstmp = upstmp->next)
+		upstmp->retain = 0;
+}
+
+/* delete all UPS entries that didn't get reloaded */
+static void ups_retain_sweep(void)
+{
+	upstype_t	**link = &firstups;
+
+	while (*link) {
+		if ((*link)->retain == 0)
+			delete_ups(link);
+		else
+			link = &(*link)->next;
 	}
 
-	/* shouldn't happen */
-	upslogx(LOG_ERR, "delete_ups: UPS not found");
+	/* did they actually delete the last UPS? */
+	if (firstups == NULL)
+		upslogx(LOG_WARNING, "Warning: no UPSes currently defined!");
 }
 
 /* see if we can open a file */
@@ -686,7 +812,11 @@ retry:
 	f = fopen(chkfn, "r");
 
 	if (!f) {
-		if (errno == EMFILE && retries < 10) {
+		if (errno == EMFILE && retries < 10
+#ifndef WIN32
+		 && !reload_out	/* the reader process must leave clients alone */
+#endif	/* !WIN32 */
+		) {
 			close_oldest_client();
 			retries++;
 			goto retry;
@@ -699,23 +829,331 @@ retry:
 	return 1;	/* OK */
 }
 
-/* called after SIGHUP */
-void conf_reload(void)
+#ifndef WIN32
+static void reload_put_user(size_t numargs, char **arg)
+{
+	reload_put(RELOAD_USER, numargs, arg);
+}
+
+/* runs in the reader process: send all configuration files to the
+ * main process over fd, then exit */
+static void reload_child_main(int fd)
+{
+	reload_out = fdopen(fd, "w");
+	if (!reload_out)
+		_exit(EXIT_FAILURE);
+
+	/* ups.conf, see do_upsconf_args() and upsconf_add() */
+	if (read_upsconf(0) == -1)
+		_exit(EXIT_FAILURE);
+	upsconf_add(1);
+
+	/* upsd.conf, without the EMFILE retries (reloading == 2)
+	 * which would close client connections */
+	if (!load_upsdconf(1))
+		_exit(EXIT_FAILURE);
+
+	/* the users are only replaced if upsd.users can be read */
+	if (check_file("upsd.users")) {
+		reload_put(RELOAD_USERS, 0, NULL);
+		user_read(reload_put_user);
+	}
+
+	if (fclose(reload_out) != 0)
+		_exit(EXIT_FAILURE);
+
+	_exit(EXIT_SUCCESS);
+}
+
+/* start the reader process, returns 0 if that is not possible */
+static int reload_start(void)
+{
+	int	pipefd[2];
+	pid_t	pid;
+
+	if (pipe(pipefd) < 0) {
+		upslog_with_errno(LOG_WARNING, "%s: can't create a pipe", __func__);
+		return 0;
+	}
+
+	/* the reader logs synchronously, and must not repeat what we have queued */
+	upslog_async_flush();
+
+	pid = fork();
+
+	if (pid < 0) {
+		upslog_with_errno(LOG_WARNING, "%s: can't fork", __func__);
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return 0;
+	}
+
+	if (pid == 0) {
+		close(pipefd[0]);
+		upslog_async_enable(0);
+		reload_child_main(pipefd[1]);
+	}
+
+	close(pipefd[1]);
+	fcntl(pipefd[0], F_SETFL, fcntl(pipefd[0], F_GETFL) | O_NONBLOCK);
+	fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+
+	reload_pid = pid;
+	reload_fd = pipefd[0];
+	reload_len = 0;
+	time(&reload_started);
+
+	upsdebugx(1, "%s: reading the configuration in process %" PRIdMAX,
+		__func__, (intmax_t)pid);
+
+	return 1;
+}
+
+int conf_reload_fd(void)
+{
+	return reload_fd;
+}
+
+int conf_reload_expired(time_t now)
+{
+	/* reap a reader killed before, if it is gone by now */
+	if (reload_killed_pid > 0
+	 && waitpid(reload_killed_pid, NULL, WNOHANG) != 0
+	) {
+		reload_killed_pid = -1;
+	}
+
+	if (reload_pid < 0 || difftime(now, reload_started) < RELOAD_TIMEOUT)
+		return 0;
+
+	upslogx(LOG_ERR, "Reload failed: the configuration reader (process %" PRIdMAX
+		") did not finish in %d seconds, keeping the current configuration",
+		(intmax_t)reload_pid, RELOAD_TIMEOUT);
+
+	/* it may be stuck in a system call: do not wait for it here */
+	kill(reload_pid, SIGKILL);
+	if (waitpid(reload_pid, NULL, WNOHANG) == 0)
+		reload_killed_pid = reload_pid;
+	reload_pid = -1;
+
+	if (reload_fd >= 0) {
+		close(reload_fd);
+		reload_fd = -1;
+	}
+
+	free(reload_buf);
+	reload_buf = NULL;
+	reload_len = reload_alloc = 0;
+
+	return 1;
+}
+
+int conf_reload_child(void)
+{
+	return (reload_out != NULL);
+}
+
+int conf_reload_read(void)
+{
+	ssize_t	ret;
+
+	if (reload_fd < 0)
+		return 1;
+
+	for (;;) {
+		if (reload_alloc - reload_len < SMALLBUF) {
+			reload_alloc = reload_alloc ? reload_alloc * 2 : LARGEBUF;
+			reload_buf = (char *)xrealloc(reload_buf, reload_alloc);
+		}
+
+		ret = read(reload_fd, reload_buf + reload_len, reload_alloc - reload_len);
+
+		if (ret > 0) {
+			reload_len += (size_t)ret;
+			continue;
+		}
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			upslog_with_errno(LOG_ERR, "%s: read from the configuration reader failed", __func__);
+		}
+
+		/* end of data, or error */
+		close(reload_fd);
+		reload_fd = -1;
+		return 1;
+	}
+}
+
+/* take the next NUL-terminated string from the received data */
+static char *reload_next(size_t *pos)
 {
-	upstype_t	*upstmp, *upsnext;
+	char	*str = reload_buf + *pos, *end;
+
+	if (*pos >= reload_len)
+		return NULL;
+
+	end = memchr(str, '\0', reload_len - *pos);
+	if (!end)
+		return NULL;
+
+	*pos += (size_t)(end - str) + 1;
+	return str;
+}
 
+/* walk what the reader process has sent, checking that it is complete
+ * and well-formed (apply == 0), or applying it (apply == 1) */
+static int reload_parse(int apply, int *numerrors)
+{
+	char	**arg = NULL, *str;
+	size_t	pos = 0, argalloc = 0, i, records = 0;
+	unsigned long	numargs;
+	int	ok = 1;
+
+	while (ok && pos < reload_len) {
+		char	type;
+
+		if ((str = reload_next(&pos)) == NULL || !*str
+		 || !str_to_ulong_strict(str + 1, &numargs, 10)
+		) {
+			ok = 0;
+			break;
+		}
+		type = *str;
+
+		if (numargs >= argalloc) {
+			argalloc = numargs + 8;
+			arg = (char **)xrealloc(arg, argalloc * sizeof(*arg));
+		}
+
+		for (i = 0; i < numargs; i++) {
+			if ((arg[i] = reload_next(&pos)) == NULL) {
+				ok = 0;
+				break;
+			}
+		}
+		if (!ok)
+			break;
+		arg[numargs] = NULL;
+		records++;
+
+		switch (type) {
+		case RELOAD_STATEPATH:
+			if (numargs != 1)
+				ok = 0;
+			else if (apply)
+				upsconf_statepath(arg[0]);
+			break;
+		case RELOAD_UPS:
+			if (numargs < 2 || numargs > 3)
+				ok = 0;
+			else if (apply)
+				upsconf_ups(1, arg[0], arg[1], arg[2]);
+			break;
+		case RELOAD_UPSDCONF:
+			if (apply)
+				*numerrors += upsdconf_line(numargs, arg);
+			break;
+		case RELOAD_UPSDCONF_ERR:
+			if (apply)
+				(*numerrors)++;
+			break;
+		case RELOAD_USERS:
+			if (apply)
+				user_flush();
+			break;
+		case RELOAD_USER:
+			if (apply)
+				user_load_args(numargs, arg);
+			break;
+		default:
+			ok = 0;
+			break;
+		}
+	}
+
+	free(arg);
+
+	if (apply)
+		upsdebugx(1, "%s: applied %" PRIuSIZE " configuration records",
+			__func__, records);
+
+	return ok;
+}
+
+/* apply what the reader process has sent in one go: sections of ups.conf
+ * which did not change keep their driver connection and clients */
+static void reload_apply(void)
+{
+	int	numerrors = 0;
+
+	if (!reload_parse(0, NULL)) {
+		upslogx(LOG_ERR, "Reload failed: unexpected data from the configuration reader");
+		return;
+	}
+
+	ups_retain_reset();
+
+	/* if upsd.conf added or changed
+	 * (or commented away) the debug_min
+	 * setting, detect that */
+	nut_debug_level_global = -1;
+	conf_reloading = 1;
+
+	/* the data is modified by the parsers: this pass is the last one */
+	reload_parse(1, &numerrors);
+
+	conf_reloading = 0;
+
+	ups_retain_sweep();
+	upsdconf_done(1, numerrors);
+}
+
+void conf_reload_finish(void)
+{
+	int	status = 0;
+
+	if (reload_fd >= 0) {
+		close(reload_fd);
+		reload_fd = -1;
+	}
+
+	while (waitpid(reload_pid, &status, 0) < 0 && errno == EINTR)
+		;
+	reload_pid = -1;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		upslogx(LOG_ERR, "Reload failed: could not read the configuration, keeping the current one");
+	} else {
+		reload_apply();
+	}
+
+	free(reload_buf);
+	reload_buf = NULL;
+	reload_len = reload_alloc = 0;
+}
+#endif	/* !WIN32 */
+
+/* called after SIGHUP */
+int conf_reload(void)
+{
 	upslogx(LOG_INFO, "SIGHUP: reloading configuration");
 
 	/* see if we can access upsd.conf before blowing away the config */
 	if (!check_file("upsd.conf"))
-		return;
+		return 0;
 
-	/* reset retain flags on all known UPS entries */
-	upstmp = firstups;
-	while (upstmp) {
-		upstmp->retain = 0;
-		upstmp = upstmp->next;
-	}
+#ifndef WIN32
+	/* read the files without blocking the main loop, it then calls
+	 * conf_reload_read() and conf_reload_finish() */
+	if (reload_start())
+		return 1;
+#endif	/* !WIN32 */
+
+	ups_retain_reset();
 
 	/* reload from ups.conf */
 	load_upsconf(2);		/* 2 = reloading, and may retry by closing clients if EMFILE */
@@ -724,31 +1162,17 @@ void conf_reload(void)
 	/* now reread upsd.conf */
 	load_upsdconf(2);		/* 2 = reloading, and may retry by closing clients if EMFILE */
 
-	/* now delete all UPS entries that didn't get reloaded */
-
-	upstmp = firstups;
-
-	while (upstmp) {
-		/* upstmp may be deleted during this pass */
-		upsnext = upstmp->next;
-
-		if (upstmp->retain == 0)
-			delete_ups(upstmp);
-
-		upstmp = upsnext;
-	}
-
-	/* did they actually delete the last UPS? */
-	if (firstups == NULL)
-		upslogx(LOG_WARNING, "Warning: no UPSes currently defined!");
+	ups_retain_sweep();
 
 	/* and also make sure upsd.users can be read... */
 	if (!check_file("upsd.users"))
-		return;
+		return 0;
 
 	/* delete all users */
 	user_flush();
 
 	/* and finally reread from upsd.users */
 	user_load();
+
+	return 0;
 }
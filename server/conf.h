@@ -29,14 +29,30 @@ extern "C" {
 /* *INDENT-ON* */
 #endif
 
-/* read upsd.conf */
-void load_upsdconf(int reloading);
+/* read upsd.conf, returns 0 if that failed during a reload */
+int load_upsdconf(int reloading);
 
 /* add valid UPSes from ups.conf to the internal structures */
 void upsconf_add(int reloading);
 
-/* flush existing config, then reread everything */
-void conf_reload(void);
+/* reread everything and apply what changed; returns 1 if the files are
+ * being read by a child process, whose output the main loop must pass
+ * to conf_reload_read() until that returns 1, then call
+ * conf_reload_finish() where it is safe to add and delete UPSes */
+int conf_reload(void);
+
+#ifndef WIN32
+/* pipe from the configuration reader, or -1 if none is running */
+int conf_reload_fd(void);
+/* kill a configuration reader which runs for too long; returns 1 if
+ * that happened (the reload is over, the configuration is unchanged) */
+int conf_reload_expired(time_t now);
+int conf_reload_read(void);
+void conf_reload_finish(void);
+
+/* true in the configuration reader process */
+int conf_reload_child(void);
+#endif	/* !WIN32 */
 
 typedef struct ups_s {
 	char	*upsname;
@@ -34,6 +34,7 @@
 #include "netmisc.h"
 #include "netuser.h"
 #include "netinstcmd.h"
+#include "netwatch.h"
 
 #define FLAG_USER	0x0001		/* username and password must be set */
 
@@ -56,6 +57,7 @@ static struct {
 
 	{ "GET",	net_get,	0		},
 	{ "LIST",	net_list,	0		},
+	{ "WATCH",	net_watch,	0		},
 
 	{ "USERNAME",	net_username,	0		},
 	{ "PASSWORD",	net_password,	0		},
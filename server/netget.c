@@ -183,6 +183,82 @@ static void get_type(nut_ctype_t *client, const char *upsname, const char *var)
 	sendback(client, "%s NUMBER\n", buf);
 }
 
+/* read-only counters maintained in upsd.c and sstate.c */
+static const struct {
+	const char	*name;
+	const uintmax_t	*value;
+} server_stats[] = {
+	{ "server.stats.loop.count",			&upsd_stats.loop_count },
+	{ "server.stats.loop.busy.usec",		&upsd_stats.loop_busy_usec },
+	{ "server.stats.loop.busy.usec.max",		&upsd_stats.loop_busy_usec_max },
+	{ "server.stats.command.count",			&upsd_stats.command_count },
+	{ "server.stats.command.usec",			&upsd_stats.command_usec },
+	{ "server.stats.command.usec.max",		&upsd_stats.command_usec_max },
+	{ "server.stats.command.latency.lt100us",	&upsd_stats.command_latency[0] },
+	{ "server.stats.command.latency.lt1ms",		&upsd_stats.command_latency[1] },
+	{ "server.stats.command.latency.lt10ms",	&upsd_stats.command_latency[2] },
+	{ "server.stats.command.latency.lt100ms",	&upsd_stats.command_latency[3] },
+	{ "server.stats.command.latency.slower",	&upsd_stats.command_latency[4] },
+	{ "server.stats.client.accepted",		&upsd_stats.client_accepted },
+	{ "server.stats.client.bytes.in",		&upsd_stats.client_bytes_in },
+	{ "server.stats.client.bytes.out",		&upsd_stats.client_bytes_out },
+	{ "server.stats.driver.bytes.in",		&upsd_stats.driver_bytes_in },
+	{ "server.stats.driver.lines",			&upsd_stats.driver_lines },
+	{ NULL, NULL }
+};
+
+/* server.stats.command.<verb>.count, .usec and .usec.max */
+static int get_var_server_stats_command(nut_ctype_t *client, const char *upsname, const char *var)
+{
+	const	upsd_cmd_stats_t	*cs;
+	const	char	*prefix = "server.stats.command.", *dot;
+	char	verb[SMALLBUF];
+	uintmax_t	value;
+
+	if (strncasecmp(var, prefix, strlen(prefix)))
+		return 0;
+
+	var += strlen(prefix);
+	dot = strchr(var, '.');
+	if (!dot || (size_t)(dot - var) >= sizeof(verb))
+		return 0;
+
+	snprintf(verb, sizeof(verb), "%.*s", (int)(dot - var), var);
+	if ((cs = upsd_stats_command(verb)) == NULL)
+		return 0;
+
+	if (!strcasecmp(dot, ".count"))
+		value = cs->count;
+	else if (!strcasecmp(dot, ".usec"))
+		value = cs->usec;
+	else if (!strcasecmp(dot, ".usec.max"))
+		value = cs->usec_max;
+	else
+		return 0;
+
+	sendback(client, "VAR %s %s%s \"%" PRIuMAX "\"\n",
+		upsname, prefix, var, value);
+	return 1;
+}
+
+static void get_var_server_stats(nut_ctype_t *client, const char *upsname, const char *var)
+{
+	size_t	i;
+
+	for (i = 0; server_stats[i].name; i++) {
+		if (!strcasecmp(var, server_stats[i].name)) {
+			sendback(client, "VAR %s %s \"%" PRIuMAX "\"\n",
+				upsname, server_stats[i].name, *(server_stats[i].value));
+			return;
+		}
+	}
+
+	if (get_var_server_stats_command(client, upsname, var))
+		return;
+
+	send_err(client, NUT_ERR_VAR_NOT_SUPPORTED);
+}
+
 static void get_var_server(nut_ctype_t *client, const char *upsname, const char *var)
 {
 #ifdef HAVE_PRAGMAS_FOR_GCC_DIAGNOSTIC_IGNORED_UNREACHABLE_CODE
@@ -225,6 +301,11 @@ static void get_var_server(nut_ctype_t *client, const char *upsname, const char
 		return;
 	}
 
+	if (!strncasecmp(var, "server.stats.", 13)) {
+		get_var_server_stats(client, upsname, var);
+		return;
+	}
+
 	send_err(client, NUT_ERR_VAR_NOT_SUPPORTED);
 }
 
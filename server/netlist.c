@@ -35,10 +35,15 @@ static int tree_dump(st_tree_t *node, nut_ctype_t *client, const char *ups,
 	int rw, int fsd)
 {
 	int	ret;
+	static const char	*status_var = NULL;
 
 	if (!node)
 		return 1;	/* not an error */
 
+	/* variable names are interned, see state_intern() */
+	if (!status_var)
+		status_var = state_intern("ups.status");
+
 	if (node->left) {
 		ret = tree_dump(node->left, client, ups, rw, fsd);
 
@@ -62,7 +67,7 @@ static int tree_dump(st_tree_t *node, nut_ctype_t *client, const char *ups,
 		/* normal variable list only */
 
 		/* status is always a special case */
-		if ((fsd == 1) && (!strcasecmp(node->var, "ups.status"))) {
+		if ((fsd == 1) && (node->var == status_var)) {
 			ret = sendback(client, "VAR %s %s \"FSD %s\"\n",
 				ups, node->var, node->val);
 
@@ -255,10 +260,12 @@ static void list_ups(nut_ctype_t *client)
 	sendback(client, "END LIST UPS\n");
 }
 
-static void list_clients(nut_ctype_t *client, const char *upsname)
+/* LIST CLIENT, or LIST CLIENTSTATS with the traffic of each client */
+static void list_clients(nut_ctype_t *client, const char *upsname, int stats)
 {
 	const upstype_t *ups;
 	nut_ctype_t		*c, *cnext;
+	const char	*verb = stats ? "CLIENTSTATS" : "CLIENT";
 
 	ups = get_ups_ptr(upsname);
 
@@ -267,7 +274,7 @@ static void list_clients(nut_ctype_t *client, const char *upsname)
 		return;
 	}
 
-	if (!sendback(client, "BEGIN LIST CLIENT %s\n", upsname))
+	if (!sendback(client, "BEGIN LIST %s %s\n", verb, upsname))
 		return;
 
 	if (firstclient) {
@@ -275,14 +282,19 @@ static void list_clients(nut_ctype_t *client, const char *upsname)
 		/* show connected clients */
 		for (c = firstclient; c; c = cnext) {
 			if (c->loginups && (!ups || !strcasecmp(c->loginups, ups->name))) {
-				ret = sendback(client, "CLIENT %s %s\n", c->loginups, c->addr);
+				if (stats)
+					ret = sendback(client, "%s %s %s %" PRIuMAX " %" PRIuMAX " %" PRIuMAX "\n",
+						verb, c->loginups, c->addr,
+						c->bytes_in, c->bytes_out, c->commands);
+				else
+					ret = sendback(client, "%s %s %s\n", verb, c->loginups, c->addr);
 				if (!ret)
 					return;
 			}
 			cnext = c->next;
 		}
 	}
-	sendback(client, "END LIST CLIENT %s\n", upsname);
+	sendback(client, "END LIST %s %s\n", verb, upsname);
 }
 
 void net_list(nut_ctype_t *client, size_t numarg, const char **arg)
@@ -323,7 +335,13 @@ void net_list(nut_ctype_t *client, size_t numarg, const char **arg)
 
 	/* LIST CLIENT UPS */
 	if (!strcasecmp(arg[0], "CLIENT")) {
-		list_clients(client, arg[1]);
+		list_clients(client, arg[1], 0);
+		return;
+	}
+
+	/* LIST CLIENTSTATS UPS */
+	if (!strcasecmp(arg[0], "CLIENTSTATS")) {
+		list_clients(client, arg[1], 1);
 		return;
 	}
 
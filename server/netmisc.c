@@ -28,6 +28,7 @@
 #include "neterr.h"
 
 #include "netmisc.h"
+#include "netwatch.h"
 
 void net_ver(nut_ctype_t *client, size_t numarg, const char **arg)
 {
@@ -93,7 +94,7 @@ void net_help(nut_ctype_t *client, size_t numarg, const char **arg)
 	}
 
 	sendback(client, "Commands: HELP VER PROTVER GET LIST SET INSTCMD"
-		" LOGIN LOGOUT USERNAME PASSWORD STARTTLS\n");
+		" LOGIN LOGOUT USERNAME PASSWORD STARTTLS WATCH\n");
 	/* Not exposed: PRIMARY/MASTER FSD */
 }
 
@@ -124,5 +125,8 @@ void net_fsd(nut_ctype_t *client, size_t numarg, const char **arg)
 
 	ups->fsd = 1;
 	sendback(client, "OK FSD-SET\n");
+
+	/* watchers see the status as GET VAR does */
+	netwatch_setinfo(ups, "ups.status");
 }
 
@@ -0,0 +1,266 @@
+/* netwatch.c - WATCH handler and change notifications for upsd
+
+   Copyright (C) 2026  Network UPS Tools contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include "common.h"
+
+#include "upsd.h"
+#include "sstate.h"
+#include "neterr.h"
+
+#include "netssl.h"
+#include "netwatch.h"
+
+/* NOTIFY output queued for a watcher which does not read it at once;
+ * one falling further behind is disconnected, to resync when it comes
+ * back */
+#define NETWATCH_QUEUE_MAX	65536
+
+/* clients watching at least one device, so that drivers feeding upsd
+ * at a high rate do not walk the client list when nobody listens */
+static size_t	watching_clients = 0;
+
+static int client_watches(const nut_ctype_t *client, const char *upsname)
+{
+	size_t	i;
+
+	for (i = 0; i < client->watchcount; i++) {
+		if (!strcasecmp(client->watch[i], upsname))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* WATCH <upsname> */
+void net_watch(nut_ctype_t *client, size_t numarg, const char **arg)
+{
+	const	upstype_t	*ups;
+
+	if (numarg != 1) {
+		send_err(client, NUT_ERR_INVALID_ARGUMENT);
+		return;
+	}
+
+	ups = get_ups_ptr(arg[0]);
+
+	if (!ups) {
+		send_err(client, NUT_ERR_UNKNOWN_UPS);
+		return;
+	}
+
+	if (!client_watches(client, ups->name)) {
+		if (client->watchcount == 0)
+			watching_clients++;
+
+		client->watch = (char **)xrealloc(client->watch,
+			(client->watchcount + 1) * sizeof(*client->watch));
+		client->watch[client->watchcount++] = xstrdup(ups->name);
+
+		upsdebugx(2, "%s: client %s watches UPS [%s]",
+			__func__, client->addr, ups->name);
+	}
+
+	sendback(client, "OK\n");
+}
+
+#ifndef WIN32
+/* Write what the socket of <client> takes without waiting, returns the
+ * byte count (maybe 0) or -1 on error. The socket stays blocking for
+ * the replies to the requests of the client. */
+static ssize_t netwatch_write(nut_ctype_t *client, const char *buf, size_t len)
+{
+	ssize_t	ret;
+
+#ifdef WITH_SSL
+	if (client->ssl) {
+		struct pollfd	pfd;
+
+		/* records can not be written in parts: write the lines
+		 * once the socket takes data, which it mostly takes whole */
+		pfd.fd = client->sock_fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+
+		ret = poll(&pfd, 1, 0);
+		if (ret < 0)
+			return (errno == EINTR) ? 0 : -1;
+		if (ret == 0 || !(pfd.revents & POLLOUT))
+			return 0;
+
+		ret = ssl_write(client, buf, len);
+	} else
+#endif	/* WITH_SSL */
+	{
+		ret = send(client->sock_fd, buf, len, MSG_DONTWAIT);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			return 0;
+	}
+
+	if (ret > 0) {
+		upsd_stats.client_bytes_out += (uintmax_t)ret;
+		client->bytes_out += (uintmax_t)ret;
+	}
+
+	return ret;
+}
+#endif	/* !WIN32 */
+
+int netwatch_flush(nut_ctype_t *client, int wait)
+{
+	ssize_t	ret;
+
+	while (client->watch_queued > 0) {
+#ifndef WIN32
+		if (!wait) {
+			ret = netwatch_write(client, client->watch_queue, client->watch_queued);
+			if (ret == 0)
+				return 0;	/* the rest when the socket takes it */
+		} else
+#endif	/* !WIN32 */
+#ifdef WITH_SSL
+		if (client->ssl)
+			ret = ssl_write(client, client->watch_queue, client->watch_queued);
+		else
+#endif	/* WITH_SSL */
+			ret = write(client->sock_fd, client->watch_queue, client->watch_queued);
+
+		if (ret <= 0) {
+			upslog_with_errno(LOG_NOTICE, "write() failed for %s", client->addr);
+			client->last_heard = 0;
+			client->watch_queued = 0;
+			return -1;
+		}
+
+		client->watch_queued -= (size_t)ret;
+		memmove(client->watch_queue, client->watch_queue + ret, client->watch_queued);
+	}
+
+	return 0;
+}
+
+/* Queue <line> for <client> after what it did not take yet, and write
+ * what the socket takes at once: a watcher which stops reading must not
+ * block the server */
+static void netwatch_queue(nut_ctype_t *client, const char *line)
+{
+#ifndef WIN32
+	size_t	len = strlen(line);
+
+	if (client->watch_queued + len > NETWATCH_QUEUE_MAX) {
+		upslogx(LOG_NOTICE, "Client %s does not read its notifications, disconnecting",
+			client->addr);
+		client->last_heard = 0;
+		client->watch_queued = 0;
+		return;
+	}
+
+	if (!client->watch_queue)
+		client->watch_queue = (char *)xmalloc(NETWATCH_QUEUE_MAX);
+
+	memcpy(client->watch_queue + client->watch_queued, line, len);
+	client->watch_queued += len;
+
+	upsdebugx(2, "%s: [destfd=%d] [queued=%" PRIuSIZE "] ans=[%.*s]",
+		__func__, client->sock_fd, client->watch_queued,
+		(int)(len - 1), line);
+
+	netwatch_flush(client, 0);
+#else	/* WIN32 */
+	/* not on Windows yet: written as the replies are */
+	sendback(client, "%s", line);
+#endif	/* WIN32 */
+}
+
+void netwatch_free(nut_ctype_t *client)
+{
+	size_t	i;
+
+	free(client->watch_queue);
+	client->watch_queue = NULL;
+	client->watch_queued = 0;
+
+	if (client->watchcount == 0)
+		return;
+
+	for (i = 0; i < client->watchcount; i++)
+		free(client->watch[i]);
+
+	free(client->watch);
+	client->watch = NULL;
+	client->watchcount = 0;
+	watching_clients--;
+}
+
+static void netwatch_send(const upstype_t *ups, const char *fmt, ...)
+	__attribute__ ((__format__ (__printf__, 2, 3)));
+
+/* the line is formatted once, whatever the number of watchers */
+static void netwatch_send(const upstype_t *ups, const char *fmt, ...)
+{
+	nut_ctype_t	*client;
+	char	line[NUT_NET_ANSWER_MAX + 1];
+	va_list	ap;
+
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+
+	for (client = firstclient; client; client = client->next) {
+		/* skip the ones already failing, they go away shortly */
+		if (client->watchcount == 0 || client->last_heard == 0
+		 || !client_watches(client, ups->name))
+			continue;
+
+		netwatch_queue(client, line);
+	}
+}
+
+void netwatch_setinfo(const upstype_t *ups, const char *var)
+{
+	const	char	*val;
+
+	if (watching_clients == 0)
+		return;
+
+	val = sstate_getinfo(ups, var);
+	if (!val)
+		return;
+
+	/* the same special case for status as GET VAR */
+	if (ups->fsd && !strcasecmp(var, "ups.status"))
+		netwatch_send(ups, "NOTIFY VAR %s %s \"FSD %s\"\n", ups->name, var, val);
+	else
+		netwatch_send(ups, "NOTIFY VAR %s %s \"%s\"\n", ups->name, var, val);
+}
+
+void netwatch_delinfo(const upstype_t *ups, const char *var)
+{
+	if (watching_clients == 0)
+		return;
+
+	netwatch_send(ups, "NOTIFY DELVAR %s %s\n", ups->name, var);
+}
+
+void netwatch_stale(const upstype_t *ups, int stale)
+{
+	if (watching_clients == 0)
+		return;
+
+	netwatch_send(ups, "NOTIFY %s %s\n", stale ? "DATASTALE" : "DATAOK", ups->name);
+}
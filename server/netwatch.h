@@ -0,0 +1,52 @@
+/* netwatch.h - WATCH handler and change notifications for upsd
+
+   Copyright (C) 2026  Network UPS Tools contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef NUT_NETWATCH_H_SEEN
+#define NUT_NETWATCH_H_SEEN 1
+
+#include "nut_ctype.h"
+#include "upstype.h"
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+extern "C" {
+/* *INDENT-ON* */
+#endif
+
+void net_watch(nut_ctype_t *client, size_t numarg, const char **arg);
+
+/* push a change of <ups> to the clients watching it (no-op if none) */
+void netwatch_setinfo(const upstype_t *ups, const char *var);
+void netwatch_delinfo(const upstype_t *ups, const char *var);
+void netwatch_stale(const upstype_t *ups, int stale);
+
+/* write the NOTIFY lines queued for <client>: all of them if <wait>,
+ * else what the socket takes at once; returns -1 if the client failed */
+int netwatch_flush(nut_ctype_t *client, int wait);
+
+/* forget what <client> watches, when it goes away */
+void netwatch_free(nut_ctype_t *client);
+
+#ifdef __cplusplus
+/* *INDENT-OFF* */
+}
+/* *INDENT-ON* */
+#endif
+
+#endif /* NUT_NETWATCH_H_SEEN */
@@ -70,6 +70,16 @@ typedef struct nut_ctype_s {
 	/* per client status info for commands and settings
 	 * (disabled by default) */
 	int	tracking;
+	/* devices whose changes are pushed to this client (see WATCH) */
+	char	**watch;
+	size_t	watchcount;
+	/* NOTIFY output the client did not take yet */
+	char	*watch_queue;
+	size_t	watch_queued;
+	/* traffic of this client (see LIST CLIENTSTATS) */
+	uintmax_t	bytes_in;
+	uintmax_t	bytes_out;
+	uintmax_t	commands;
 
 #ifdef	WITH_OPENSSL
 	SSL	*ssl;
@@ -27,6 +27,7 @@
 #include "sstate.h"
 #include "upsd.h"
 #include "upstype.h"
+#include "netwatch.h"
 #include "nut_stdint.h"
 
 #include <fcntl.h>
@@ -39,29 +40,83 @@
 #include <sys/un.h>
 #endif	/* !WIN32 */
 
+/* Words of the driver protocol handled by parse_args() */
+enum {
+	PARSE_PONG,
+	PARSE_DUMPDONE,
+	PARSE_DATASTALE,
+	PARSE_DATAOK,
+	PARSE_ADDCMD,
+	PARSE_DELCMD,
+	PARSE_DELINFO,
+	PARSE_SETFLAGS,
+	PARSE_SETINFO,
+	PARSE_ADDENUM,
+	PARSE_DELENUM,
+	PARSE_SETAUX,
+	PARSE_TRACKING,
+	PARSE_ADDRANGE,
+	PARSE_DELRANGE,
+	PARSE_VERBS
+};
+
+static const char	*parse_verbs[PARSE_VERBS] = {
+	"PONG",
+	"DUMPDONE",
+	"DATASTALE",
+	"DATAOK",
+	"ADDCMD",
+	"DELCMD",
+	"DELINFO",
+	"SETFLAGS",
+	"SETINFO",
+	"ADDENUM",
+	"DELENUM",
+	"SETAUX",
+	"TRACKING",
+	"ADDRANGE",
+	"DELRANGE",
+};
+static int	parse_verbs_interned = 0;
+
 static int parse_args(upstype_t *ups, size_t numargs, char **arg)
 {
+	const char	*cmd;
+	size_t	i;
+
 	if (numargs < 1)
 		return 0;
 
-	if (!strcasecmp(arg[0], "PONG")) {
+	/* the protocol words are interned like the variable names,
+	 * so that they are matched by comparing the pointers */
+	if (!parse_verbs_interned) {
+		for (i = 0; i < PARSE_VERBS; i++)
+			parse_verbs[i] = state_intern(parse_verbs[i]);
+		parse_verbs_interned = 1;
+	}
+
+	cmd = state_intern_find(arg[0]);
+	if (!cmd)
+		return 0;
+
+	if (cmd == parse_verbs[PARSE_PONG]) {
 		upsdebugx(3, "%s: Got PONG from UPS [%s]", __func__, ups->name);
 		return 1;
 	}
 
-	if (!strcasecmp(arg[0], "DUMPDONE")) {
+	if (cmd == parse_verbs[PARSE_DUMPDONE]) {
 		upsdebugx(3, "%s: UPS [%s]: dump is done", __func__, ups->name);
 		ups->dumpdone = 1;
 		return 1;
 	}
 
-	if (!strcasecmp(arg[0], "DATASTALE")) {
+	if (cmd == parse_verbs[PARSE_DATASTALE]) {
 		upsdebugx(3, "%s: UPS [%s]: data is STALE now", __func__, ups->name);
 		ups->data_ok = 0;
 		return 1;
 	}
 
-	if (!strcasecmp(arg[0], "DATAOK")) {
+	if (cmd == parse_verbs[PARSE_DATAOK]) {
 		upsdebugx(3, "%s: UPS [%s]: data is NOT STALE now", __func__, ups->name);
 		ups->data_ok = 1;
 		return 1;
@@ -72,20 +127,21 @@ static int parse_args(upstype_t *ups, size_t numargs, char **arg)
 
 	/* FIXME: all these should return their state_...() value! */
 	/* ADDCMD <cmdname> */
-	if (!strcasecmp(arg[0], "ADDCMD")) {
+	if (cmd == parse_verbs[PARSE_ADDCMD]) {
 		state_addcmd(&ups->cmdlist, arg[1]);
 		return 1;
 	}
 
 	/* DELCMD <cmdname> */
-	if (!strcasecmp(arg[0], "DELCMD")) {
+	if (cmd == parse_verbs[PARSE_DELCMD]) {
 		state_delcmd(&ups->cmdlist, arg[1]);
 		return 1;
 	}
 
 	/* DELINFO <var> */
-	if (!strcasecmp(arg[0], "DELINFO")) {
-		state_delinfo(&ups->inforoot, arg[1]);
+	if (cmd == parse_verbs[PARSE_DELINFO]) {
+		if (state_delinfo(&ups->inforoot, arg[1]))
+			netwatch_delinfo(ups, arg[1]);
 		return 1;
 	}
 
@@ -93,37 +149,38 @@ static int parse_args(upstype_t *ups, size_t numargs, char **arg)
 		return 0;
 
 	/* SETFLAGS <varname> <flags>... */
-	if (!strcasecmp(arg[0], "SETFLAGS")) {
+	if (cmd == parse_verbs[PARSE_SETFLAGS]) {
 		state_setflags(ups->inforoot, arg[1], numargs - 2, &arg[2]);
 		return 1;
 	}
 
 	/* SETINFO <varname> <value> */
-	if (!strcasecmp(arg[0], "SETINFO")) {
-		state_setinfo(&ups->inforoot, arg[1], arg[2]);
+	if (cmd == parse_verbs[PARSE_SETINFO]) {
+		if (state_setinfo(&ups->inforoot, arg[1], arg[2]))
+			netwatch_setinfo(ups, arg[1]);
 		return 1;
 	}
 
 	/* ADDENUM <varname> <enumval> */
-	if (!strcasecmp(arg[0], "ADDENUM")) {
+	if (cmd == parse_verbs[PARSE_ADDENUM]) {
 		state_addenum(ups->inforoot, arg[1], arg[2]);
 		return 1;
 	}
 
 	/* DELENUM <varname> <enumval> */
-	if (!strcasecmp(arg[0], "DELENUM")) {
+	if (cmd == parse_verbs[PARSE_DELENUM]) {
 		state_delenum(ups->inforoot, arg[1], arg[2]);
 		return 1;
 	}
 
 	/* SETAUX <varname> <auxval> */
-	if (!strcasecmp(arg[0], "SETAUX")) {
+	if (cmd == parse_verbs[PARSE_SETAUX]) {
 		state_setaux(ups->inforoot, arg[1], arg[2]);
 		return 1;
 	}
 
 	/* TRACKING <id> <status> */
-	if (!strcasecmp(arg[0], "TRACKING")) {
+	if (cmd == parse_verbs[PARSE_TRACKING]) {
 		tracking_set(arg[1], arg[2]);
 		upsdebugx(1, "%s: TRACKING: ID %s status %s", __func__, arg[1], arg[2]);
 
@@ -138,13 +195,13 @@ static int parse_args(upstype_t *ups, size_t numargs, char **arg)
 		return 0;
 
 	/* ADDRANGE <varname> <minvalue> <maxvalue> */
-	if (!strcasecmp(arg[0], "ADDRANGE")) {
+	if (cmd == parse_verbs[PARSE_ADDRANGE]) {
 		state_addrange(ups->inforoot, arg[1], atoi(arg[2]), atoi(arg[3]));
 		return 1;
 	}
 
 	/* DELRANGE <varname> <minvalue> <maxvalue> */
-	if (!strcasecmp(arg[0], "DELRANGE")) {
+	if (cmd == parse_verbs[PARSE_DELRANGE]) {
 		state_delrange(ups->inforoot, arg[1], atoi(arg[2]), atoi(arg[3]));
 		return 1;
 	}
@@ -402,11 +459,15 @@ void sstate_readline(upstype_t *ups)
 	ret = bytesRead;
 #endif	/* WIN32 */
 
+	if (ret > 0)
+		upsd_stats.driver_bytes_in += (uintmax_t)ret;
+
 	for (i = 0; i < ret; i++) {
 
 		switch (pconf_char(&ups->sock_ctx, buf[i]))
 		{
 		case 1:
+			upsd_stats.driver_lines++;
 			/* set the 'last heard' time to now for later staleness checks */
 			if (parse_args(ups, ups->sock_ctx.numargs, ups->sock_ctx.arglist)) {
 				time(&ups->last_heard);
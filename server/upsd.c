@@ -69,6 +69,8 @@
 #include "desc.h"
 #include "neterr.h"
 
+#include <ctype.h>
+
 #ifdef HAVE_WRAP
 #include <tcpd.h>
 int	allow_severity = LOG_INFO;
@@ -118,6 +120,12 @@ static const char	*progname;
 nut_ctype_t	*firstclient = NULL;
 /* static nut_ctype_t	*lastclient = NULL; */
 
+/* hot path counters, see upsd.h */
+upsd_stats_t	upsd_stats;
+
+/* per command, in the order of netcmds[] */
+static upsd_cmd_stats_t	upsd_cmd_stats[sizeof(netcmds) / sizeof(netcmds[0])];
+
 /* default is to listen on all local interfaces */
 static stype_t	*firstaddr = NULL;
 
@@ -129,6 +137,8 @@ typedef enum {
 	SERVER
 #ifdef WIN32
 	,NAMED_PIPE
+#else	/* !WIN32 */
+	,RELOAD
 #endif	/* WIN32 */
 
 } handler_type_t;
@@ -175,6 +185,13 @@ static char	pidfn[NUT_PATH_MAX];
 	/* set by signal handlers */
 static int	reload_flag = 0, exit_flag = 0;
 
+#ifndef WIN32
+	/* configuration being read by a child process, or ready to apply */
+static int	reload_running = 0, reload_ready = 0;
+	/* a SIGHUP during the reload was logged */
+static int	reload_flag_noted = 0;
+#endif	/* !WIN32 */
+
 /* Minimalistic support for UUID v4 */
 /* Ref: RFC 4122 https://tools.ietf.org/html/rfc4122#section-4.1.2 */
 #define UUID4_BYTESIZE 16
@@ -183,6 +200,62 @@ static int	reload_flag = 0, exit_flag = 0;
 # define SERVICE_UNIT_NAME "nut-server.service"
 #endif
 
+/* UPS names are looked up for most client commands, and for each ups.conf
+ * section on reloads: index them by a case-insensitive FNV-1a hash */
+static upstype_t	**ups_hash = NULL;
+static size_t	ups_hash_size = 0, ups_hash_count = 0;
+
+static void ups_hash_insert(upstype_t *ups)
+{
+	size_t	bucket = str_hash_fnv1a(ups->name, 1) % ups_hash_size;
+
+	ups->hash_next = ups_hash[bucket];
+	ups_hash[bucket] = ups;
+}
+
+/* add a new UPS (linked into firstups by the caller) to the name index */
+void ups_index_add(upstype_t *ups)
+{
+	if (ups_hash_count >= ups_hash_size) {
+		upstype_t	**old = ups_hash, *tmp, *next;
+		size_t	i, old_size = ups_hash_size;
+
+		ups_hash_size = old_size ? old_size * 2 : 64;
+		ups_hash = (upstype_t **)xcalloc(ups_hash_size, sizeof(*ups_hash));
+
+		for (i = 0; i < old_size; i++) {
+			for (tmp = old[i]; tmp; tmp = next) {
+				next = tmp->hash_next;
+				ups_hash_insert(tmp);
+			}
+		}
+
+		free(old);
+	}
+
+	ups_hash_insert(ups);
+	ups_hash_count++;
+}
+
+/* forget a UPS which is about to be deleted */
+void ups_index_del(upstype_t *ups)
+{
+	upstype_t	**link;
+
+	if (!ups_hash)
+		return;
+
+	for (link = &ups_hash[str_hash_fnv1a(ups->name, 1) % ups_hash_size];
+		*link; link = &(*link)->hash_next
+	) {
+		if (*link == ups) {
+			*link = ups->hash_next;
+			ups_hash_count--;
+			return;
+		}
+	}
+}
+
 /* return a pointer to the named ups if possible */
 upstype_t *get_ups_ptr(const char *name)
 {
@@ -194,9 +267,13 @@ upstype_t *get_ups_ptr(const char *name)
 		return NULL;
 	}
 
-	for (tmp = firstups; tmp; tmp = tmp->next) {
-		if (!strcasecmp(tmp->name, name)) {
-			return tmp;
+	if (ups_hash) {
+		for (tmp = ups_hash[str_hash_fnv1a(name, 1) % ups_hash_size];
+			tmp; tmp = tmp->hash_next
+		) {
+			if (!strcasecmp(tmp->name, name)) {
+				return tmp;
+			}
 		}
 	}
 
@@ -216,6 +293,7 @@ static void ups_data_stale(upstype_t *ups)
 	ups->stale = 1;
 
 	upslogx(LOG_NOTICE, "Data for UPS [%s] is stale - check driver", ups->name);
+	netwatch_stale(ups, 1);
 }
 
 /* mark the data ok if this is new, otherwise do nothing */
@@ -228,6 +306,7 @@ static void ups_data_ok(upstype_t *ups)
 	ups->stale = 0;
 
 	upslogx(LOG_NOTICE, "UPS [%s] data is no longer stale", ups->name);
+	netwatch_stale(ups, 0);
 }
 
 /* add another listening address */
@@ -235,11 +314,6 @@ void listen_add(const char *addr, const char *port)
 {
 	stype_t	*server;
 
-	/* don't change listening addresses on reload */
-	if (reload_flag) {
-		return;
-	}
-
 	/* grab some memory and add the info */
 	server = (stype_t*)xcalloc(1, sizeof(*server));
 	server->addr = xstrdup(addr);
@@ -626,6 +700,8 @@ static void client_disconnect(nut_ctype_t *client)
 
 	pconf_finish(&client->ctx);
 
+	netwatch_free(client);
+
 	if (client->prev) {
 		client->prev->next = client->next;
 	} else {
@@ -649,6 +725,22 @@ static void client_disconnect(nut_ctype_t *client)
 	return;
 }
 
+/* microseconds elapsed since <start>, for upsd_stats accounting */
+static uintmax_t stats_usec_since(const st_tree_timespec_t *start)
+{
+	st_tree_timespec_t	now;
+	double	d;
+
+	if (state_get_timestamp(&now) != 0)
+		return 0;
+
+	d = difftime_st_tree_timespec(now, *start);
+	if (d <= 0)
+		return 0;
+
+	return (uintmax_t)(d * 1000000.0);
+}
+
 /* send the buffer <sendbuf> of length <sendlen> to host <dest>
  * returns effectively a boolean: 0 = failed, 1 = sent ok
  */
@@ -670,6 +762,11 @@ int sendback(nut_ctype_t *client, const char *fmt, ...)
 
 	len = strlen(ans);
 
+	/* NOTIFY lines still queued for a watcher go first */
+	if (client->watch_queued > 0 && netwatch_flush(client, 1) < 0) {
+		return 0;	/* failed */
+	}
+
 	/* System write() and our ssl_write() have a loophole that they write a
 	 * size_t amount of bytes and upon success return that in ssize_t value
 	 */
@@ -686,6 +783,11 @@ int sendback(nut_ctype_t *client, const char *fmt, ...)
 		res = write(client->sock_fd, ans, len);
 	}
 
+	if (res > 0) {
+		upsd_stats.client_bytes_out += (uintmax_t)res;
+		client->bytes_out += (uintmax_t)res;
+	}
+
 	{ /* scoping */
 		char	*s = str_rtrim(ans, '\n');
 
@@ -855,6 +957,18 @@ static void check_command(int cmdnum, nut_ctype_t *client, size_t numarg,
 	netcmds[cmdnum].func(client, (numarg < 2) ? 0 : (numarg - 1), (numarg > 1) ? &arg[1] : NULL);
 }
 
+const upsd_cmd_stats_t *upsd_stats_command(const char *name)
+{
+	size_t	i;
+
+	for (i = 0; netcmds[i].name; i++) {
+		if (!strcasecmp(netcmds[i].name, name))
+			return &upsd_cmd_stats[i];
+	}
+
+	return NULL;
+}
+
 /* parse requests from the network */
 static void parse_net(nut_ctype_t *client)
 {
@@ -868,7 +982,29 @@ static void parse_net(nut_ctype_t *client)
 
 	for (i = 0; netcmds[i].name; i++) {
 		if (!strcasecmp(netcmds[i].name, client->ctx.arglist[0])) {
+			st_tree_timespec_t	start;
+			uintmax_t	usec;
+			size_t	bucket;
+
+			state_get_timestamp(&start);
 			check_command(i, client, client->ctx.numargs, (const char **) client->ctx.arglist);
+			usec = stats_usec_since(&start);
+
+			upsd_stats.command_count++;
+			upsd_stats.command_usec += usec;
+			if (usec > upsd_stats.command_usec_max)
+				upsd_stats.command_usec_max = usec;
+
+			upsd_cmd_stats[i].count++;
+			upsd_cmd_stats[i].usec += usec;
+			if (usec > upsd_cmd_stats[i].usec_max)
+				upsd_cmd_stats[i].usec_max = usec;
+			client->commands++;
+
+			/* decades starting at 100us */
+			for (bucket = 0; bucket < UPSD_STATS_LATENCY_BUCKETS - 1 && usec >= 100; bucket++)
+				usec /= 10;
+			upsd_stats.command_latency[bucket]++;
 			return;
 		}
 	}
@@ -925,6 +1061,7 @@ static void client_connect(stype_t *server)
 	}
 
 	firstclient = client;
+	upsd_stats.client_accepted++;
 
 /*
 	if (lastclient) {
@@ -965,6 +1102,9 @@ static void client_readline(nut_ctype_t *client)
 		return;
 	}
 
+	upsd_stats.client_bytes_in += (uintmax_t)ret;
+	client->bytes_in += (uintmax_t)ret;
+
 	/* fragment handling code */
 	for (i = 0; i < ret; i++) {
 
@@ -1218,10 +1358,21 @@ static void driver_free(void)
 		free(ups->desc);
 		free(ups);
 	}
+
+	free(ups_hash);
+	ups_hash = NULL;
+	ups_hash_size = 0;
+	ups_hash_count = 0;
 }
 
 static void upsd_cleanup(void)
 {
+#ifndef WIN32
+	/* the configuration reader process must leave all this alone */
+	if (conf_reload_child())
+		return;
+#endif	/* !WIN32 */
+
 	upsdebugx(1, "%s: starting the end-game", __func__);
 
 	if (strlen(pidfn) > 0) {
@@ -1659,6 +1810,14 @@ static void set_reload_flag(int sig)
 	reload_flag = 1;
 }
 
+/* wrap up after the new configuration is applied */
+static void reload_done(void)
+{
+	/* Among other things, re-detect sysmaxconn after loading config, because MAXCONN might have changed */
+	poll_reload();
+	upsnotify(NOTIFY_STATE_READY, NULL);
+}
+
 /* service requests and check on new data */
 static void mainloop(void)
 {
@@ -1679,24 +1838,69 @@ static void mainloop(void)
 	nut_ctype_t	*client, *cnext;
 	stype_t		*server;
 	time_t	now;
+#ifndef WIN32
+	st_tree_timespec_t	busy_start;
+	uintmax_t	busy_usec;
+#endif	/* !WIN32 */
+
+	upsd_stats.loop_count++;
 
 	upsnotify(NOTIFY_STATE_WATCHDOG, NULL);
 
 	time(&now);
 
+#ifndef WIN32
+	if (reload_ready) {
+		/* not while walking the handlers: UPSes and clients may go away */
+		reload_ready = 0;
+		conf_reload_finish();
+		reload_done();
+	} else if (reload_running && conf_reload_expired(now)) {
+		reload_running = 0;
+		reload_done();
+	} else if (reload_flag && !reload_running) {
+		reload_flag = 0;
+		reload_flag_noted = 0;
+		upsnotify(NOTIFY_STATE_RELOADING, NULL);
+		reload_running = conf_reload();
+		if (!reload_running)
+			reload_done();
+	} else if (reload_flag && !reload_flag_noted) {
+		/* more SIGHUPs until then are folded into one */
+		upslogx(LOG_INFO, "SIGHUP: a reload is in progress, "
+			"will reload again when it is finished");
+		reload_flag_noted = 1;
+	}
+#else	/* WIN32 */
 	if (reload_flag) {
 		upsnotify(NOTIFY_STATE_RELOADING, NULL);
 		conf_reload();
-		/* Among other things, re-detect sysmaxconn after loading config, because MAXCONN might have changed */
-		poll_reload();
 		reload_flag = 0;
-		upsnotify(NOTIFY_STATE_READY, NULL);
+		reload_done();
 	}
+#endif	/* WIN32 */
 
 	/* cleanup instcmd/setvar status tracking entries if needed */
 	tracking_cleanup();
 
 #ifndef WIN32
+	/* pipe from the configuration reader goes first, so it is
+	 * never left out by the maxconn limit */
+	if (reload_running && conf_reload_fd() >= 0) {
+		nfds_considered++;
+		nfds_wanted++;
+
+		upsdebugx(4, "%s: adding FD handler #%" PRIuMAX " for RELOAD [FD %d]",
+			__func__, (uintmax_t)nfds, conf_reload_fd());
+		fds[nfds].fd = conf_reload_fd();
+		fds[nfds].events = POLLIN;
+
+		handler[nfds].type = RELOAD;
+		handler[nfds].data = NULL;
+
+		nfds++;
+	}
+
 	/* scan through driver sockets */
 	nfds_tmp_type_all = 0;
 	nfds_tmp_chosen = 0;
@@ -1792,6 +1996,8 @@ static void mainloop(void)
 			client->addr, client->loginups, client->sock_fd);
 		fds[nfds].fd = client->sock_fd;
 		fds[nfds].events = POLLIN;
+		if (client->watch_queued > 0)
+			fds[nfds].events |= POLLOUT;
 
 		handler[nfds].type = CLIENT;
 		handler[nfds].data = client;
@@ -1906,8 +2112,19 @@ static void mainloop(void)
 	}
 
 	upsdebugx(2, "%s: polling returned %d hits", __func__, ret);
+	state_get_timestamp(&busy_start);
 	for (i = 0; i < nfds; i++) {
 
+		if (handler[i].type == RELOAD) {
+			/* data or end of it (POLLHUP) from the configuration reader */
+			if (fds[i].revents && conf_reload_read()) {
+				upsdebugx(2, "%s: the new configuration is read", __func__);
+				reload_running = 0;
+				reload_ready = 1;
+			}
+			continue;
+		}
+
 		if (fds[i].revents & (POLLHUP|POLLERR|POLLNVAL)) {
 
 			upsdebug_with_errno(3, "%s: Disconnect %s [%s%sFD %ld] due to%s%s%s",
@@ -1973,6 +2190,10 @@ static void mainloop(void)
 			continue;
 		}
 
+		if ((fds[i].revents & POLLOUT) && handler[i].type == CLIENT) {
+			netwatch_flush((nut_ctype_t *)handler[i].data, 0);
+		}
+
 		if (fds[i].revents & POLLIN) {
 
 			upsdebugx(3, "%s: Incoming %s from %s [%s%sFD %ld%s]",
@@ -2037,6 +2258,11 @@ static void mainloop(void)
 		}
 	}
 
+	busy_usec = stats_usec_since(&busy_start);
+	upsd_stats.loop_busy_usec += busy_usec;
+	if (busy_usec > upsd_stats.loop_busy_usec_max)
+		upsd_stats.loop_busy_usec_max = busy_usec;
+
 #else	/* WIN32 */
 
 	/* scan through driver sockets */
@@ -2258,6 +2484,7 @@ static void mainloop(void)
 	 * https://github.com/networkupstools/nut/issues/3376
 	 */
 	chunk = 0;
+
 	if (nfds <= sysmaxconn) {
 		ret = WaitForMultipleObjects(nfds, fds, FALSE, 2000);
 	} else {
@@ -2423,7 +2650,7 @@ static void help(const char *arg_progname)
 	__attribute__((noreturn));
 
 /* For getopt loops; should match usage documented below: */
-static const char	optstring[] = "+h46p:qr:i:fu:Vc:P:DFB";
+static const char	optstring[] = "+h46p:qr:i:fu:Vc:P:DFBH";
 
 static void help(const char *arg_progname)
 {
@@ -2450,6 +2677,8 @@ static void help(const char *arg_progname)
 	printf("  -u <user>	switch to <user> (if started as root)\n");
 	printf("  -4		IPv4 only\n");
 	printf("  -6		IPv6 only\n");
+	printf("  -H		print a salted hash of the password read from standard\n");
+	printf("		input, for the 'password' setting in upsd.users\n");
 
 	nut_report_config_flags();
 	upsdebugx(1, "NUT data server was built %s", net_ssl_caps_descr());
@@ -2617,6 +2846,22 @@ int main(int argc, char **argv)
 				opt_af = AF_INET6;
 				break;
 
+			case 'H':
+				{
+					char	pw[LARGEBUF], hash[SMALLBUF];
+
+					if (!fgets(pw, sizeof(pw), stdin))
+						fatalx(EXIT_FAILURE, "No password was provided on standard input");
+					pw[strcspn(pw, "\r\n")] = '\0';
+
+					if (user_hash_password(pw, hash, sizeof(hash)) != 0)
+						fatalx(EXIT_FAILURE, "Could not hash the password with crypt(3)");
+					memset(pw, 0, sizeof(pw));
+
+					printf("%s\n", hash);
+					exit(EXIT_SUCCESS);
+				}
+
 			case 'h':
 			default:
 				help(progname);
@@ -2909,6 +3154,9 @@ int main(int argc, char **argv)
 
 	upsnotify(NOTIFY_STATE_READY_WITH_PID, NULL);
 
+	/* keep syslog writes out of client request handling */
+	upslog_async_enable(SIZE_MAX);
+
 	while (!exit_flag) {
 		/* Note: mainloop() calls upsnotify(NOTIFY_STATE_WATCHDOG, NULL); */
 		mainloop();
@@ -69,6 +69,8 @@ extern "C" {
 /* prototypes from upsd.c */
 
 upstype_t *get_ups_ptr(const char *upsname);
+void ups_index_add(upstype_t *ups);
+void ups_index_del(upstype_t *ups);
 int ups_available(const upstype_t *ups, nut_ctype_t *client);
 
 void listen_add(const char *addr, const char *port);
@@ -128,6 +130,40 @@ extern char		*statepath, *datapath;
 extern upstype_t	*firstups;
 extern nut_ctype_t	*firstclient;
 
+/* Always-on counters of the data server hot paths, served to clients
+ * as read-only "server.stats.*" variables (see netget.c). Updating them
+ * costs an increment or two per event, timing uses the monotonic clock.
+ * Command latency histogram buckets: <100us, <1ms, <10ms, <100ms, more.
+ */
+#define UPSD_STATS_LATENCY_BUCKETS	5
+
+typedef struct upsd_stats_s {
+	uintmax_t	loop_count;		/* mainloop() iterations */
+	uintmax_t	loop_busy_usec;		/* time spent handling poll() hits */
+	uintmax_t	loop_busy_usec_max;
+	uintmax_t	command_count;		/* network commands dispatched */
+	uintmax_t	command_usec;		/* time spent in command handlers */
+	uintmax_t	command_usec_max;
+	uintmax_t	command_latency[UPSD_STATS_LATENCY_BUCKETS];
+	uintmax_t	client_accepted;	/* client connections accepted */
+	uintmax_t	client_bytes_in;	/* read by client_readline() */
+	uintmax_t	client_bytes_out;	/* written by sendback() */
+	uintmax_t	driver_bytes_in;	/* read by sstate_readline() */
+	uintmax_t	driver_lines;		/* complete lines parsed from drivers */
+} upsd_stats_t;
+
+extern upsd_stats_t	upsd_stats;
+
+/* the same for each network command (verb) */
+typedef struct upsd_cmd_stats_s {
+	uintmax_t	count;
+	uintmax_t	usec;
+	uintmax_t	usec_max;
+} upsd_cmd_stats_t;
+
+/* counters of the command <name> (e.g. "LIST"), or NULL if unknown */
+const upsd_cmd_stats_t *upsd_stats_command(const char *name);
+
 /* map commands onto signals */
 #ifndef WIN32
 # define SIGCMD_STOP	SIGTERM
@@ -57,6 +57,7 @@ typedef struct upstype_s {
 	int	retain;
 
 	struct upstype_s	*next;
+	struct upstype_s	*hash_next;	/* see get_ups_ptr() */
 
 } upstype_t;
 
@@ -49,6 +49,49 @@ typedef struct {
 	void	*next;
 } ulist_t;
 
+/* The lists above are compiled into an index when first needed after
+ * upsd.users was (re-)read, so that a check costs a single lookup */
+
+/* case-insensitive set of names (open addressing), pointing into ulist_t */
+typedef struct {
+	const char	**names;
+	size_t	count;
+	size_t	size;		/* power of two, or 0 */
+} user_nameset_t;
+
+/* actions known to upsd, as bits */
+#define USER_ACTION_SET	0x01
+#define USER_ACTION_FSD	0x02
+#define USER_ACTION_LOGIN	0x04
+#define USER_ACTION_MASTER	0x08
+#define USER_ACTION_PRIMARY	0x10
+
+/* upsd.users "password" values with this prefix are crypt(3) hashes of
+ * the password (e.g. "{CRYPT}$6$<salt>$<hash>"), see "upsd -H" */
+#define USER_HASH_PREFIX	"{CRYPT}"
+
+typedef struct {
+	const char	*username;
+	size_t	hash;
+	/* the password or (if crypted) its hash, NULL if none can match */
+	const char	*password;
+	int	crypted;
+	int	allcmds;		/* instcmds = all */
+	user_nameset_t	instcmds;
+	unsigned int	actions;	/* USER_ACTION_* */
+	user_nameset_t	otheractions;	/* not known to upsd (yet) */
+} user_entry_t;
+
+typedef struct {
+	user_entry_t	*entries;
+	size_t	count;
+	size_t	*buckets;	/* entry index + 1, or 0 if free */
+	size_t	size;		/* power of two */
+	/* entry index + 1 of the user whose password unknown user names
+	 * are checked against (to take as long), or 0 if there is none */
+	size_t	dummy;
+} user_index_t;
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
@@ -32,10 +32,20 @@
 #include "user.h"
 #include "user-data.h"
 
+#include <ctype.h>
+#include <fcntl.h>
+#ifdef HAVE_CRYPT_H
+# include <crypt.h>
+#endif
+
 static ulist_t	*users = NULL;
 
 static	ulist_t	*curr_user;
 
+/* compiled from the users list, see user_compile() */
+static user_index_t	user_index;
+static int	user_index_valid = 0;
+
 /* create a new user entry */
 static void user_add(const char *un)
 {
@@ -66,6 +76,7 @@ static void user_add(const char *un)
 
 	/* remember who we're working on */
 	curr_user = tmp;
+	user_index_valid = 0;
 }
 
 /* set password */
@@ -88,6 +99,7 @@ static void user_password(const char *pw)
 	}
 
 	curr_user->password = xstrdup(pw);
+	user_index_valid = 0;
 }
 
 /* attach allowed instcmds to user */
@@ -127,6 +139,8 @@ static void user_add_instcmd(const char *cmd)
 	} else {
 		curr_user->firstcmd = tmp;
 	}
+
+	user_index_valid = 0;
 }
 
 static actionlist_t *addaction(actionlist_t *base, const char *action)
@@ -166,6 +180,7 @@ static void user_add_action(const char *act)
 				act, curr_user->username);
 
 	curr_user->firstaction = addaction(curr_user->firstaction, act);
+	user_index_valid = 0;
 }
 
 static void flushcmd(instcmdlist_t *ptr)
@@ -207,120 +222,378 @@ static void flushuser(ulist_t *ptr)
 	free(ptr);
 }
 
-/* flush all user attributes - used during reload */
-void user_flush(void)
+static void user_nameset_add(user_nameset_t *set, const char *name)
 {
-	flushuser(users);
-	users = NULL;
-}
+	size_t	i, mask;
 
-static int user_matchinstcmd(ulist_t *user, const char * cmd)
-{
-	instcmdlist_t	*tmp;
+	if (set->count * 2 >= set->size) {
+		const char	**old = set->names;
+		size_t	old_size = set->size;
 
-	for (tmp = user->firstcmd; tmp != NULL; tmp = (instcmdlist_t*)tmp->next) {
+		set->size = old_size ? old_size * 2 : 8;
+		set->names = (const char **)xcalloc(set->size, sizeof(*set->names));
+		set->count = 0;
 
-		if (!strcasecmp(tmp->cmd, cmd)) {
-			return 1;	/* good */
+		for (i = 0; i < old_size; i++) {
+			if (old[i])
+				user_nameset_add(set, old[i]);
 		}
+		free(old);
+	}
 
-		if (!strcasecmp(tmp->cmd, "all")) {
-			return 1;	/* good */
-		}
+	mask = set->size - 1;
+	for (i = str_hash_fnv1a(name, 1) & mask; set->names[i]; i = (i + 1) & mask) {
+		if (!strcasecmp(set->names[i], name))
+			return;
 	}
 
-	return 0;	/* fail */
+	set->names[i] = name;
+	set->count++;
 }
 
-int user_checkinstcmd(const char *un, const char *pw, const char *cmd)
+static int user_nameset_has(const user_nameset_t *set, const char *name)
 {
-	ulist_t	*tmp;
+	size_t	i, mask;
 
-	if ((!un) || (!pw) || (!cmd)) {
-		return 0;	/* failed */
+	if (!set->size)
+		return 0;
+
+	mask = set->size - 1;
+	for (i = str_hash_fnv1a(name, 1) & mask; set->names[i]; i = (i + 1) & mask) {
+		if (!strcasecmp(set->names[i], name))
+			return 1;
 	}
 
-	for (tmp = users; tmp != NULL; tmp = (ulist_t*)tmp->next) {
+	return 0;
+}
 
-		/* let's be paranoid before we call strcmp */
+static unsigned int user_action_bit(const char *action)
+{
+	static const struct {
+		const char	*name;
+		unsigned int	bit;
+	} actions[] = {
+		{ "SET",	USER_ACTION_SET },
+		{ "FSD",	USER_ACTION_FSD },
+		{ "LOGIN",	USER_ACTION_LOGIN },
+		{ "MASTER",	USER_ACTION_MASTER },
+		{ "PRIMARY",	USER_ACTION_PRIMARY },
+		{ NULL,	0 }
+	};
+	size_t	i;
 
-		if ((!tmp->username) || (!tmp->password)) {
-			continue;
-		}
+	for (i = 0; actions[i].name; i++) {
+		if (!strcasecmp(actions[i].name, action))
+			return actions[i].bit;
+	}
 
-		if (strcmp(tmp->username, un)) {
-			continue;
-		}
+	return 0;
+}
 
+/* compare what a client gave (or its crypt(3) hash) with the stored
+ * password (or hash), in a time which only depends on the length of
+ * the given string, and not on how much of it matched */
+static int user_secret_equal(const char *given, const char *stored)
+{
+	size_t	given_len = strlen(given), stored_len = strlen(stored), i;
+	unsigned char	diff = (given_len != stored_len);
 
-		if (strcmp(tmp->password, pw)) {
-			/* password mismatch */
-			return 0;	/* fail */
-		}
+	for (i = 0; i < given_len; i++)
+		diff |= (unsigned char)(given[i] ^ stored[i % (stored_len + 1)]);
 
-		if (!user_matchinstcmd(tmp, cmd)) {
-			return 0;		/* fail */
-		}
+	return diff == 0;
+}
 
-		/* passed all checks */
-		return 1;	/* good */
+static int user_password_ok(const user_entry_t *entry, const char *pw)
+{
+#ifdef HAVE_CRYPT
+	if (entry->crypted) {
+		const char	*crypted = crypt(pw, entry->password);
+
+		return crypted != NULL && user_secret_equal(crypted, entry->password);
 	}
+#endif	/* HAVE_CRYPT */
 
-	/* username not found */
-	return 0;	/* fail */
+	return user_secret_equal(pw, entry->password);
 }
 
-static int user_matchaction(ulist_t *user, const char *action)
+#ifdef HAVE_CRYPT
+/* fill salt with len characters out of [./0-9A-Za-z] */
+static void user_random_salt(char *salt, size_t len)
 {
-	actionlist_t	*tmp;
+	static const char	chars[] =
+		"./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	unsigned char	rnd[32];
+	size_t	i, got = 0;
+#ifndef WIN32
+	int	fd;
+#endif	/* !WIN32 */
 
-	for (tmp = user->firstaction; tmp != NULL; tmp = (actionlist_t*)tmp->next) {
+	if (len > sizeof(rnd))
+		len = sizeof(rnd);
 
-		if (!strcasecmp(tmp->action, action)) {
-			return 1;	/* good */
-		}
+#ifndef WIN32
+	fd = open("/dev/urandom", O_RDONLY);
+	if (fd >= 0) {
+		ssize_t	ret = read(fd, rnd, len);
+
+		if (ret > 0)
+			got = (size_t)ret;
+		close(fd);
 	}
+#endif	/* !WIN32 */
 
-	return 0;	/* fail */
+	if (got < len) {
+		/* no better source: at least differ between processes */
+		srand((unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16));
+		for (i = got; i < len; i++)
+			rnd[i] = (unsigned char)rand();
+	}
+
+	for (i = 0; i < len; i++)
+		salt[i] = chars[rnd[i] & 63];
+	salt[len] = '\0';
 }
+#endif	/* HAVE_CRYPT */
 
-int user_checkaction(const char *un, const char *pw, const char *action)
+/* a hash crypt(3) can check: hashing anything with it as the setting
+ * gives a hash of the same method, salt and length */
+static int user_hash_valid(const char *hash)
+{
+#ifdef HAVE_CRYPT
+	const char	*crypted = crypt("", hash);
+
+	return crypted != NULL && *crypted != '*'
+		&& strlen(crypted) == strlen(hash);
+#else	/* !HAVE_CRYPT */
+	NUT_UNUSED_VARIABLE(hash);
+	return 0;
+#endif	/* !HAVE_CRYPT */
+}
+
+static void user_index_free(void)
+{
+	size_t	i;
+
+	for (i = 0; i < user_index.count; i++) {
+		free(user_index.entries[i].instcmds.names);
+		free(user_index.entries[i].otheractions.names);
+	}
+
+	free(user_index.entries);
+	free(user_index.buckets);
+	memset(&user_index, 0, sizeof(user_index));
+	user_index_valid = 0;
+}
+
+/* build the hashed user index with the permissions of each user */
+static void user_compile(void)
 {
 	ulist_t	*tmp;
+	size_t	count = 0, mask;
 
-	if ((!un) || (!pw) || (!action))
-		return 0;	/* failed */
+	user_index_free();
 
-	for (tmp = users; tmp != NULL; tmp = (ulist_t*)tmp->next) {
+	for (tmp = users; tmp != NULL; tmp = (ulist_t*)tmp->next)
+		count++;
 
-		/* let's be paranoid before we call strcmp */
+	user_index.entries = (user_entry_t *)xcalloc(count ? count : 1, sizeof(*user_index.entries));
+	for (user_index.size = 8; user_index.size < count * 2; user_index.size *= 2)
+		;
+	user_index.buckets = (size_t *)xcalloc(user_index.size, sizeof(*user_index.buckets));
+	mask = user_index.size - 1;
 
-		if ((!tmp->username) || (!tmp->password)) {
+	for (tmp = users; tmp != NULL; tmp = (ulist_t*)tmp->next) {
+		user_entry_t	*entry = &user_index.entries[user_index.count];
+		instcmdlist_t	*cmd;
+		actionlist_t	*action;
+		size_t	i;
+
+		if (!tmp->username)
 			continue;
+
+		entry->username = tmp->username;
+		entry->hash = str_hash_fnv1a(tmp->username, 0);
+
+		if (tmp->password && !strncmp(tmp->password, USER_HASH_PREFIX, strlen(USER_HASH_PREFIX))) {
+			entry->password = tmp->password + strlen(USER_HASH_PREFIX);
+			entry->crypted = 1;
+			if (!user_hash_valid(entry->password)) {
+				upslogx(LOG_WARNING, "Password hash for user %s can not be checked "
+					"with crypt(3) here, the user can not log in", tmp->username);
+				entry->password = NULL;
+			}
+		} else {
+			entry->password = tmp->password;
 		}
 
-		if (strcmp(tmp->username, un)) {
-			continue;
+		/* prefer a hashed password: it takes the longest to check */
+		if (entry->password && (!user_index.dummy
+		 || (entry->crypted && !user_index.entries[user_index.dummy - 1].crypted))
+		) {
+			user_index.dummy = user_index.count + 1;
 		}
 
-		if (strcmp(tmp->password, pw)) {
-			upsdebugx(2, "user_checkaction: password mismatch");
-			return 0;	/* fail */
+		for (cmd = tmp->firstcmd; cmd != NULL; cmd = (instcmdlist_t*)cmd->next) {
+			if (!strcasecmp(cmd->cmd, "all"))
+				entry->allcmds = 1;
+			else
+				user_nameset_add(&entry->instcmds, cmd->cmd);
 		}
 
-		if (!user_matchaction(tmp, action)) {
-			upsdebugx(2, "user_matchaction: failed");
-			return 0;	/* fail */
+		for (action = tmp->firstaction; action != NULL; action = (actionlist_t*)action->next) {
+			unsigned int	bit = user_action_bit(action->action);
+
+			if (bit)
+				entry->actions |= bit;
+			else
+				user_nameset_add(&entry->otheractions, action->action);
 		}
 
+		for (i = entry->hash & mask; user_index.buckets[i]; i = (i + 1) & mask)
+			;
+		user_index.buckets[i] = ++user_index.count;
+	}
+
+	user_index_valid = 1;
+
+	upsdebugx(2, "%s: indexed %" PRIuSIZE " users", __func__, user_index.count);
+}
+
+/* flush all user attributes - used during reload */
+void user_flush(void)
+{
+	user_index_free();
+	flushuser(users);
+	users = NULL;
+	curr_user = NULL;
+}
+
+static const user_entry_t *user_find(const char *un)
+{
+	size_t	hash = str_hash_fnv1a(un, 0), mask = user_index.size - 1, i, n;
+
+	for (i = hash & mask; (n = user_index.buckets[i]) != 0; i = (i + 1) & mask) {
+		const user_entry_t	*entry = &user_index.entries[n - 1];
+
+		if (entry->hash == hash && !strcmp(entry->username, un))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/* return the user if the password matches; the time this takes does not
+ * depend on how much of the password matched, and hardly on the user
+ * existing (an unknown one is checked against some other user) */
+static const user_entry_t *user_authenticate(const char *un, const char *pw)
+{
+	const user_entry_t	*user;
+
+	if (!user_index_valid)
+		user_compile();
+
+	user = user_find(un);
+	if (!user || !user->password) {
+		if (user_index.dummy)
+			user_password_ok(&user_index.entries[user_index.dummy - 1], pw);
+		return NULL;
+	}
+
+	if (!user_password_ok(user, pw))
+		return NULL;
+
+	return user;
+}
+
+int user_checkinstcmd(const char *un, const char *pw, const char *cmd)
+{
+	const user_entry_t	*user;
+
+	if ((!un) || (!pw) || (!cmd)) {
+		return 0;	/* failed */
+	}
+
+	user = user_authenticate(un, pw);
+	if (!user) {
+		/* password mismatch or unknown user */
+		return 0;	/* fail */
+	}
+
+	if (user->allcmds || user_nameset_has(&user->instcmds, cmd)) {
 		/* passed all checks */
 		return 1;	/* good */
 	}
 
-	/* username not found */
 	return 0;	/* fail */
 }
 
+int user_checkaction(const char *un, const char *pw, const char *action)
+{
+	const user_entry_t	*user;
+	unsigned int	bit;
+
+	if ((!un) || (!pw) || (!action))
+		return 0;	/* failed */
+
+	user = user_authenticate(un, pw);
+	if (!user) {
+		upsdebugx(2, "user_checkaction: password mismatch or unknown user");
+		return 0;	/* fail */
+	}
+
+	bit = user_action_bit(action);
+	if (bit ? !(user->actions & bit) : !user_nameset_has(&user->otheractions, action)) {
+		upsdebugx(2, "user_matchaction: failed");
+		return 0;	/* fail */
+	}
+
+	/* passed all checks */
+	return 1;	/* good */
+}
+
+/* format a password for upsd.users which is only stored as a crypt(3)
+ * hash: with the default method of crypt_gensalt_rn() where it exists
+ * (e.g. yescrypt with libxcrypt), SHA-512 ("$6$") otherwise */
+int user_hash_password(const char *pw, char *buf, size_t buflen)
+{
+#ifdef HAVE_CRYPT
+	char	setting[SMALLBUF];
+	const char	*crypted, *method_end;
+	int	ret;
+
+# ifdef HAVE_CRYPT_GENSALT_RN
+	if (!crypt_gensalt_rn(NULL, 0, NULL, 0, setting, (int)sizeof(setting)))
+# endif	/* HAVE_CRYPT_GENSALT_RN */
+	{
+		char	salt[17];
+
+		user_random_salt(salt, sizeof(salt) - 1);
+		snprintf(setting, sizeof(setting), "$6$%s$", salt);
+	}
+
+	crypted = crypt(pw, setting);
+
+	/* a method the system does not know is refused ("*0"), or (with
+	 * some old crypt(3) versions) taken for an old DES salt */
+	method_end = strchr(setting + 1, '$');
+	if (!crypted || !method_end
+	 || strncmp(crypted, setting, (size_t)(method_end - setting) + 1)
+	) {
+		return -1;
+	}
+
+	ret = snprintf(buf, buflen, "%s%s", USER_HASH_PREFIX, crypted);
+
+	return (ret > 0 && (size_t)ret < buflen) ? 0 : -1;
+#else	/* !HAVE_CRYPT */
+	NUT_UNUSED_VARIABLE(pw);
+	NUT_UNUSED_VARIABLE(buf);
+	NUT_UNUSED_VARIABLE(buflen);
+	return -1;
+#endif	/* !HAVE_CRYPT */
+}
+
 /* handle "upsmon primary" and "upsmon secondary" for nicer configurations */
 /* FIXME: Protocol update needed to handle master/primary alias (in action and in protocol) */
 static void set_upsmon_type(char *type)
@@ -466,13 +739,13 @@ static void upsd_user_err(const char *errmsg)
 	upslogx(LOG_ERR, "Fatal error in parseconf(upsd.users): %s", errmsg);
 }
 
-void user_load(void)
+/* read upsd.users and pass each line to the handler,
+ * returns 0 if the file could not be opened */
+int user_read(void (*handler)(size_t numargs, char **arg))
 {
 	char	fn[NUT_PATH_MAX];
 	PCONF_CTX_t	ctx;
 
-	curr_user = NULL;
-
 	snprintf(fn, sizeof(fn), "%s/upsd.users", confpath());
 
 	check_perms(fn);
@@ -484,7 +757,7 @@ void user_load(void)
 		pconf_finish(&ctx);
 
 		upslogx(LOG_WARNING, "%s", ctx.errmsg);
-		return;
+		return 0;
 	}
 
 	while (pconf_file_next(&ctx)) {
@@ -495,8 +768,21 @@ void user_load(void)
 			continue;
 		}
 
-		user_parse_arg(ctx.numargs, ctx.arglist);
+		handler(ctx.numargs, ctx.arglist);
 	}
 
 	pconf_finish(&ctx);
+	return 1;
+}
+
+void user_load(void)
+{
+	curr_user = NULL;
+	user_read(user_parse_arg);
+}
+
+/* apply a line of upsd.users which was read elsewhere (see conf_reload()) */
+void user_load_args(size_t numargs, char **arg)
+{
+	user_parse_arg(numargs, arg);
 }
@@ -32,12 +32,17 @@ extern "C" {
 #endif
 
 void user_load(void);
+int user_read(void (*handler)(size_t numargs, char **arg));
+void user_load_args(size_t numargs, char **arg);
 
 int user_checkinstcmd(const char *un, const char *pw, const char *cmd);
 int user_checkaction(const char *un, const char *pw, const char *action);
 
 void user_flush(void);
 
+/* format a salted password hash for upsd.users into buf, returns 0 if OK */
+int user_hash_password(const char *pw, char *buf, size_t buflen);
+
 #ifdef __cplusplus
 /* *INDENT-OFF* */
 }
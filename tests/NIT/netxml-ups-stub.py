@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+# netxml-ups-stub.py - a minimal Eaton/MGE Network Management Card for
+# the NIT tests of the netxml-ups driver
+#
+# Serves the XML v3 pages which the mge-xml subdriver reads (product
+# information, summary, objects), with ETag validators for conditional
+# requests, and the "connected socket" alarm subscription. The pages
+# follow the layout of real NMC answers, trimmed to a few objects.
+#
+# Usage: netxml-ups-stub.py HTTP_PORT ALARM_PORT LOGFILE ALARMFILE
+#
+# Every HTTP connection and request is logged to LOGFILE, one per line:
+#   CONNECT <count>
+#   GET <path> inm=<If-None-Match or -> status=<code>
+#   SUBSCRIBE secret=<secret>
+#   ALARM <object>=<value>
+# When ALARMFILE appears, the alarm it holds ("object value", e.g.
+# "UPS.PowerSummary.PresentStatus.ACPresent 0") is sent to the
+# subscribed drivers, and the file is removed.
+#
+# Copyright (C) 2026 Network UPS Tools contributors
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+import os
+import socket
+import sys
+import threading
+import time
+
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+SECRET = 4242
+
+PAGES = {
+    "/": b"""<html><head><title>Network Management Card</title></head>
+<body><a href="mgeups/default.htm">UPS properties</a></body></html>
+""",
+
+    "/mgeups/product.xml": b"""<?xml version="1.0" encoding="ISO-8859-1"?>
+<PRODUCT_INFO name="Network Management Card" type="Mosaic M" version="BA">
+<SUMMARY>
+<HTML_PROPERTIES_PAGE url="mgeups/default.htm"/>
+<XML_SUMMARY_PAGE url="upsprop.xml"/>
+<CSV_LOGS url="logevent.csv" dateRange="no" eventFiltering="no"/>
+</SUMMARY>
+<ALARMS>
+<SUBSCRIPTION url="subscribe.cgi" security="none"/>
+<POLLING url="mgeups/lastalarms.cgi" security="none"/>
+</ALARMS>
+<UPS_DATA>
+<GET_OBJECT url="getvalue.cgi" security="none"/>
+<SET_OBJECT url="setvalue.cgi" security="none"/>
+</UPS_DATA>
+</PRODUCT_INFO>
+""",
+
+    "/upsprop.xml": b"""<?xml version="1.0" encoding="ISO-8859-1"?>
+<SUMMARY>
+<OBJECT name="UPS.PowerSummary.iProduct">NIT netxml</OBJECT>
+<OBJECT name="UPS.PowerSummary.iModel">1500</OBJECT>
+<OBJECT name="UPS.PowerSummary.RemainingCapacity">100</OBJECT>
+<OBJECT name="UPS.PowerSummary.RunTimeToEmpty">1800</OBJECT>
+<OBJECT name="UPS.PowerSummary.PresentStatus.ACPresent">1</OBJECT>
+<OBJECT name="UPS.PowerSummary.PresentStatus.Charging">0</OBJECT>
+<OBJECT name="UPS.PowerSummary.PresentStatus.Discharging">0</OBJECT>
+<OBJECT name="UPS.PowerSummary.PresentStatus.BelowRemainingCapacityLimit">0</OBJECT>
+</SUMMARY>
+""",
+
+    "/getvalue.cgi": b"""<?xml version="1.0" encoding="ISO-8859-1"?>
+<GET_OBJECT>
+<OBJECT name="UPS.PowerConverter.Input[1].Voltage" unit="V" access="RO">230</OBJECT>
+<OBJECT name="UPS.PowerConverter.Output.Voltage" unit="V" access="RO">230</OBJECT>
+<OBJECT name="UPS.PowerSummary.PercentLoad" unit="%" access="RO">20</OBJECT>
+</GET_OBJECT>
+""",
+}
+
+log_lock = threading.Lock()
+subscribers = []
+subscribers_lock = threading.Lock()
+connections = 0
+
+
+def log(line):
+    with log_lock:
+        with open(LOGFILE, "a") as f:
+            f.write(line + "\n")
+
+
+class NMCHandler(BaseHTTPRequestHandler):
+    # Keep-alive, as the cards do
+    protocol_version = "HTTP/1.1"
+    server_version = "NIT-NMC/1.0"
+
+    def setup(self):
+        global connections
+        BaseHTTPRequestHandler.setup(self)
+        with log_lock:
+            connections += 1
+            count = connections
+        log("CONNECT %d" % count)
+
+    def log_message(self, format, *args):
+        pass
+
+    def send_body(self, code, body, etag=None):
+        self.send_response(code)
+        self.send_header("Content-Type", "text/xml")
+        if etag:
+            self.send_header("ETag", etag)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        path = self.path.split("?")[0]
+        inm = self.headers.get("If-None-Match")
+        body = PAGES.get(path)
+
+        if body is None:
+            code = 404
+            self.send_body(code, b"")
+        else:
+            etag = '"%s-1"' % path.strip("/").replace("/", "-")
+            if inm == etag:
+                code = 304
+                self.send_response(code)
+                self.send_header("ETag", etag)
+                self.end_headers()
+            else:
+                code = 200
+                self.send_body(code, body, etag)
+
+        log("GET %s inm=%s status=%d" % (path, inm or "-", code))
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", "0"))
+        self.rfile.read(length)
+
+        if self.path.split("?")[0] != "/subscribe.cgi":
+            self.send_body(404, b"")
+            return
+
+        self.send_body(200, ("<?xml version=\"1.0\"?>\n<Subscription>\n"
+            "<Port>%d</Port>\n<Secret>%d</Secret>\n</Subscription>\n"
+            % (ALARM_PORT, SECRET)).encode())
+
+
+def read_until_nul(conn):
+    data = b""
+    while not data.endswith(b"\0"):
+        chunk = conn.recv(1)
+        if not chunk:
+            break
+        data += chunk
+    return data.rstrip(b"\0").decode(errors="replace")
+
+
+def serve_subscriptions(listener):
+    while True:
+        conn, _ = listener.accept()
+        request = read_until_nul(conn)
+        if request != "<Subscription Identification=\"%d\"></Subscription>" % SECRET:
+            log("SUBSCRIBE rejected: %s" % request)
+            conn.close()
+            continue
+
+        conn.sendall(b"<Subscription Answer=\"ok\"></Subscription>\0")
+        log("SUBSCRIBE secret=%d" % SECRET)
+        with subscribers_lock:
+            subscribers.append(conn)
+
+
+def watch_alarms():
+    while True:
+        time.sleep(0.2)
+        try:
+            with open(ALARMFILE) as f:
+                obj, value = f.read().split()
+            os.unlink(ALARMFILE)
+        except (OSError, ValueError):
+            continue
+
+        msg = ("<ALARM object=\"%s\" value=\"%s\"/>" % (obj, value)).encode() + b"\0"
+        with subscribers_lock:
+            for conn in subscribers:
+                try:
+                    conn.sendall(msg)
+                except OSError:
+                    pass
+        log("ALARM %s=%s" % (obj, value))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 5:
+        sys.stderr.write("Usage: %s HTTP_PORT ALARM_PORT LOGFILE ALARMFILE\n" % sys.argv[0])
+        sys.exit(2)
+
+    HTTP_PORT = int(sys.argv[1])
+    ALARM_PORT = int(sys.argv[2])
+    LOGFILE = sys.argv[3]
+    ALARMFILE = sys.argv[4]
+
+    alarm_listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    alarm_listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    alarm_listener.bind(("127.0.0.1", ALARM_PORT))
+    alarm_listener.listen(5)
+
+    threading.Thread(target=serve_subscriptions, args=(alarm_listener,), daemon=True).start()
+    threading.Thread(target=watch_alarms, daemon=True).start()
+
+    ThreadingHTTPServer.allow_reuse_address = True
+    ThreadingHTTPServer.daemon_threads = True
+    ThreadingHTTPServer(("127.0.0.1", HTTP_PORT), NMCHandler).serve_forever()
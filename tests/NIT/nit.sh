@@ -3639,6 +3639,20 @@ testcase_sandbox_upsc_query_model() {
     fi
 }
 
+testcase_sandbox_upsd_stats() {
+    # upsc itself sends GET VAR requests, so the counter of GET is not 0
+    log_info "[testcase_sandbox_upsd_stats] Query the counters of the GET command"
+    runcmd upsc dummy@localhost:$NUT_PORT server.stats.command.get.count || die "[testcase_sandbox_upsd_stats] upsd does not respond on port ${NUT_PORT} ($?): $CMDOUT"
+    if [ -n "$CMDOUT" ] && [ "$CMDOUT" -gt 0 ] 2>/dev/null ; then
+        PASSED="`expr $PASSED + 1`"
+        log_info "[testcase_sandbox_upsd_stats] PASSED: GET was handled $CMDOUT times"
+    else
+        log_error "[testcase_sandbox_upsd_stats] got this reply for the count of GET commands: $CMDOUT $CMDERR"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_upsd_stats"
+    fi
+}
+
 testcase_sandbox_upsc_query_bogus() {
     log_info "[testcase_sandbox_upsc_query_bogus] Query driver state from UPSD by UPSC for bogus info"
     runcmd upsc dummy@localhost:$NUT_PORT ups.bogus.value && {
@@ -3751,6 +3765,445 @@ testcase_sandbox_upsc_query_timer() {
     #rm -f "${NUT_STATEPATH}/upslog-dummy.log" || true
 }
 
+testcase_sandbox_snmp_hosted_agents() {
+    # One snmp-ups process polling two local snmpd agents, the second
+    # one configured in a section "hosted_by" the first: each agent
+    # should be served by upsd as a device of its own
+    log_separator
+    log_info "[testcase_sandbox_snmp_hosted_agents] Test one snmp-ups driver serving two SNMP agents"
+
+    if ! (command -v snmpd && command -v "snmp-ups${EXEEXT-}") >/dev/null 2>&1 ; then
+        log_warn "[testcase_sandbox_snmp_hosted_agents] snmpd or snmp-ups not available, skipped"
+        SKIPPED_FUNCS="${SKIPPED_FUNCS} testcase_sandbox_snmp_hosted_agents"
+        SKIPPED="`expr ${SKIPPED} + 1`"
+        return 0
+    fi
+
+    PIDS_SNMPD=""
+    for N in 1 2 ; do
+        SNMPD_PORT="`expr $NUT_PORT + 60 + $N`"
+        mkdir -p "${NUT_STATEPATH}/snmpd$N" || die "[testcase_sandbox_snmp_hosted_agents] Failed to create snmpd$N state directory"
+        cat > "${NUT_STATEPATH}/snmpd$N/snmpd.conf" << EOF
+agentAddress udp:127.0.0.1:${SNMPD_PORT}
+rocommunity public 127.0.0.1
+override .1.3.6.1.2.1.33.1.1.1.0 octet_str "NIT"
+override .1.3.6.1.2.1.33.1.1.2.0 octet_str "NIT agent $N"
+override .1.3.6.1.2.1.33.1.2.1.0 integer 2
+override .1.3.6.1.2.1.33.1.4.1.0 integer 3
+EOF
+        [ $? = 0 ] || die "[testcase_sandbox_snmp_hosted_agents] Failed to populate snmpd$N.conf"
+
+        SNMP_PERSISTENT_DIR="${NUT_STATEPATH}/snmpd$N" \
+            snmpd -f -Lf "${NUT_STATEPATH}/snmpd$N/snmpd.log" -C -c "${NUT_STATEPATH}/snmpd$N/snmpd.conf" &
+        PIDS_SNMPD="$PIDS_SNMPD $!"
+    done
+
+    cp -pf "$NUT_CONFPATH/ups.conf" "$NUT_CONFPATH/ups.conf.nosnmp" || die "[testcase_sandbox_snmp_hosted_agents] Failed to back up ups.conf"
+    cat >> "$NUT_CONFPATH/ups.conf" << EOF
+[nitsnmp1]
+    driver = snmp-ups
+    port = 127.0.0.1:`expr $NUT_PORT + 61`
+    mibs = ietf
+    pollfreq = 3
+
+[nitsnmp2]
+    driver = snmp-ups
+    port = 127.0.0.1:`expr $NUT_PORT + 62`
+    mibs = ietf
+    pollfreq = 3
+    hosted_by = nitsnmp1
+EOF
+    [ $? = 0 ] || die "[testcase_sandbox_snmp_hosted_agents] Failed to populate ups.conf"
+
+    # Let upsd know both devices
+    kill -1 $PID_UPSD
+    sleep 3
+
+    execcmd snmp-ups -a nitsnmp1 ${ARG_USER} ${ARG_FG} &
+    PID_SNMPUPS="$!"
+
+    for N in 1 2 ; do
+        COUNTDOWN=60
+        while [ "$COUNTDOWN" -gt 0 ]; do
+            runcmd upsc nitsnmp$N@localhost:$NUT_PORT ups.model && break
+            sleep 1
+            COUNTDOWN="`expr $COUNTDOWN - 1`"
+        done
+
+        if [ x"$CMDOUT" = x"NIT agent $N" ] ; then
+            log_info "[testcase_sandbox_snmp_hosted_agents] PASSED: got expected model from nitsnmp$N: $CMDOUT"
+            PASSED="`expr $PASSED + 1`"
+        else
+            log_error "[testcase_sandbox_snmp_hosted_agents] got this reply for nitsnmp$N when 'NIT agent $N' was expected: $CMDOUT $CMDERR"
+            FAILED="`expr $FAILED + 1`"
+            FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_snmp_hosted_agents"
+        fi
+    done
+
+    kill -15 $PID_SNMPUPS $PIDS_SNMPD 2>/dev/null || true
+    wait $PID_SNMPUPS $PIDS_SNMPD || true
+
+    mv -f "$NUT_CONFPATH/ups.conf.nosnmp" "$NUT_CONFPATH/ups.conf"
+    kill -1 $PID_UPSD
+}
+
+testcase_sandbox_netxml_stub() {
+    # netxml-ups against a stub Network Management Card (a python
+    # script serving MGE XML pages): pages it has seen are asked for
+    # conditionally and not sent again while unchanged (304), with a
+    # plain GET after 10 such answers in a row, over a kept-alive
+    # connection; in subscribed mode, an alarm pushed by the card
+    # wakes the driver up long before its next poll is due
+    log_separator
+    log_info "[testcase_sandbox_netxml_stub] Test netxml-ups against a stub NMC"
+
+    if [ x"${TOP_SRCDIR}" = x ] \
+    || ! command -v "netxml-ups${EXEEXT-}" >/dev/null 2>&1 \
+    || ! isTestablePython \
+    ; then
+        log_warn "[testcase_sandbox_netxml_stub] netxml-ups, python or the NMC stub not available, skipped"
+        SKIPPED_FUNCS="${SKIPPED_FUNCS} testcase_sandbox_netxml_stub"
+        SKIPPED="`expr ${SKIPPED} + 1`"
+        return 0
+    fi
+
+    NETXML_PORT="`expr $NUT_PORT + 70`"
+    NETXML_LOG="${NUT_STATEPATH}/netxml-stub.log"
+    NETXML_ALARM="${NUT_STATEPATH}/netxml-stub.alarm"
+    rm -f "${NETXML_LOG}" "${NETXML_ALARM}"
+
+    "${PYTHON}" "${TOP_SRCDIR}/tests/NIT/netxml-ups-stub.py" \
+        "${NETXML_PORT}" "`expr $NETXML_PORT + 1`" "${NETXML_LOG}" "${NETXML_ALARM}" &
+    PID_NETXML_STUB="$!"
+
+    cp -pf "$NUT_CONFPATH/ups.conf" "$NUT_CONFPATH/ups.conf.nonetxml" || die "[testcase_sandbox_netxml_stub] Failed to back up ups.conf"
+    cat >> "$NUT_CONFPATH/ups.conf" << EOF
+[nitnetxml1]
+    driver = netxml-ups
+    port = http://127.0.0.1:${NETXML_PORT}
+    pollinterval = 1
+
+[nitnetxml2]
+    driver = netxml-ups
+    port = http://127.0.0.1:${NETXML_PORT}
+    subscribe
+    pollinterval = 30
+    pollfreq = 120
+EOF
+    [ $? = 0 ] || die "[testcase_sandbox_netxml_stub] Failed to populate ups.conf"
+
+    # Let upsd know both devices
+    kill -1 $PID_UPSD
+    sleep 3
+
+    # Polled every second: collect a dozen summary page requests
+    execcmd netxml-ups -a nitnetxml1 ${ARG_USER} ${ARG_FG} &
+    PID_NETXML="$!"
+
+    COUNTDOWN=60
+    while [ "$COUNTDOWN" -gt 0 ]; do
+        [ "`${GREP} -c 'GET /upsprop.xml ' \"${NETXML_LOG}\" 2>/dev/null`" -ge 13 ] && break
+        sleep 1
+        COUNTDOWN="`expr $COUNTDOWN - 1`"
+    done
+
+    kill -15 $PID_NETXML 2>/dev/null || true
+    wait $PID_NETXML || true
+
+    # "inm" is the If-None-Match header the driver sent, if any
+    OUT="`${GREP} 'GET /upsprop.xml ' \"${NETXML_LOG}\" | head -13 | sed 's,^.* inm=\([^ ]*\) status=\([0-9]*\)$,\1:\2,' | sed 's,^[^-].*:,etag:,' | tr '\n' ' '`"
+    EXPECTED="-:200 etag:304 etag:304 etag:304 etag:304 etag:304 etag:304 etag:304 etag:304 etag:304 etag:304 -:200 etag:304 "
+    if [ x"$OUT" = x"$EXPECTED" ] ; then
+        log_info "[testcase_sandbox_netxml_stub] PASSED: summary page requested as 200, 10x 304, then a plain GET"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_netxml_stub] unexpected requests of the summary page: '$OUT' (see ${NETXML_LOG})"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_netxml_stub"
+    fi
+
+    NUM_CONNECT="`${GREP} -c '^CONNECT ' \"${NETXML_LOG}\"`"
+    NUM_GET="`${GREP} -c '^GET ' \"${NETXML_LOG}\"`"
+    if [ "$NUM_CONNECT" -lt "$NUM_GET" ] ; then
+        log_info "[testcase_sandbox_netxml_stub] PASSED: $NUM_GET requests over $NUM_CONNECT connections"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_netxml_stub] connections were not kept alive: $NUM_GET requests over $NUM_CONNECT connections"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_netxml_stub"
+    fi
+
+    # Subscribed, polled every 30 sec and the pages every 120 sec:
+    # an alarm must be seen right after the card pushes it
+    execcmd netxml-ups -a nitnetxml2 ${ARG_USER} ${ARG_FG} &
+    PID_NETXML="$!"
+
+    COUNTDOWN=60
+    while [ "$COUNTDOWN" -gt 0 ]; do
+        if ${GREP} '^SUBSCRIBE secret=' "${NETXML_LOG}" >/dev/null \
+        && runcmd upsc nitnetxml2@localhost:$NUT_PORT ups.status \
+        && [ x"$CMDOUT" = x"OL" ] \
+        ; then
+            break
+        fi
+        sleep 1
+        COUNTDOWN="`expr $COUNTDOWN - 1`"
+    done
+
+    echo "UPS.PowerSummary.PresentStatus.ACPresent 0" > "${NETXML_ALARM}"
+
+    OUTS=""
+    for I in 1 2 3 4 5 6 7 8 9 10 ; do
+        sleep 1
+        runcmd upsc nitnetxml2@localhost:$NUT_PORT ups.status && OUTS="$OUTS [$CMDOUT]"
+        [ x"$CMDOUT" = x"OB" ] && break
+    done
+
+    if ${GREP} '^ALARM ' "${NETXML_LOG}" >/dev/null \
+    && echo "$OUTS" | ${GREP} '\[OB\]' >/dev/null \
+    ; then
+        log_info "[testcase_sandbox_netxml_stub] PASSED: pushed alarm seen in ${I} sec:$OUTS"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_netxml_stub] pushed alarm was not seen within 10 sec:$OUTS (see ${NETXML_LOG})"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_netxml_stub"
+    fi
+
+    kill -15 $PID_NETXML $PID_NETXML_STUB 2>/dev/null || true
+    wait $PID_NETXML $PID_NETXML_STUB || true
+
+    mv -f "$NUT_CONFPATH/ups.conf.nonetxml" "$NUT_CONFPATH/ups.conf"
+    kill -1 $PID_UPSD
+}
+
+testcase_sandbox_cgi_daemon() {
+    # upsstats.cgi and upsimage.cgi serving requests themselves
+    # (NUT_CGI_LISTEN): each request starts from the defaults rather
+    # than the arguments of the previous one, templates are read again
+    # when they change, a client which does not send its request does
+    # not hold up the others, and a cached image is only sent again
+    # for the same device value and image arguments
+    log_separator
+    log_info "[testcase_sandbox_cgi_daemon] Test the CGI programs in daemon mode"
+
+    if ! command -v "upsstats.cgi${EXEEXT-}" >/dev/null 2>&1 \
+    || ! isTestablePython \
+    ; then
+        log_warn "[testcase_sandbox_cgi_daemon] upsstats.cgi or python not available, skipped"
+        SKIPPED_FUNCS="${SKIPPED_FUNCS} testcase_sandbox_cgi_daemon"
+        SKIPPED="`expr ${SKIPPED} + 1`"
+        return 0
+    fi
+
+    CGI_CONFPATH="${NUT_STATEPATH}/cgi"
+    CGI_PORT="`expr $NUT_PORT + 80`"
+    CGI_URL="http://127.0.0.1:${CGI_PORT}/upsstats.cgi"
+    CGI_GET='import sys, urllib.request; sys.stdout.buffer.write(urllib.request.urlopen(sys.argv[1], timeout=10).read())'
+
+    mkdir -p "${CGI_CONFPATH}" || die "[testcase_sandbox_cgi_daemon] Failed to create ${CGI_CONFPATH}"
+    cat > "${CGI_CONFPATH}/hosts.conf" << EOF2
+MONITOR dummy@localhost:${NUT_PORT} "Crash Dummy"
+MONITOR UPS1@localhost:${NUT_PORT} "Example event sequence"
+EOF2
+    [ $? = 0 ] || die "[testcase_sandbox_cgi_daemon] Failed to populate hosts.conf"
+    printf '@NUT_UPSSTATS_TEMPLATE@\nLIST-A\n@FOREACHUPS@\nUPS @HOST@\n@ENDFOR@\n' > "${CGI_CONFPATH}/upsstats.html"
+    printf '@NUT_UPSSTATS_TEMPLATE@\nSINGLE @HOST@ @STATUS@\n' > "${CGI_CONFPATH}/upsstats-single.html"
+
+    NUT_CONFPATH="${CGI_CONFPATH}" NUT_CGI_LISTEN="${CGI_PORT}" \
+        "upsstats.cgi${EXEEXT-}" 2>"${CGI_CONFPATH}/upsstats.log" &
+    PID_CGI="$!"
+
+    COUNTDOWN=10
+    while [ "$COUNTDOWN" -gt 0 ]; do
+        "${PYTHON}" -c "$CGI_GET" "${CGI_URL}" >/dev/null 2>&1 && break
+        sleep 1
+        COUNTDOWN="`expr $COUNTDOWN - 1`"
+    done
+
+    OUT1="`\"${PYTHON}\" -c \"$CGI_GET\" \"${CGI_URL}?host=dummy@localhost:${NUT_PORT}\" 2>&1`"
+    OUT2="`\"${PYTHON}\" -c \"$CGI_GET\" \"${CGI_URL}\" 2>&1`"
+    if echo "$OUT1" | ${GREP} "^SINGLE dummy@localhost" >/dev/null \
+    && echo "$OUT2" | ${GREP} "^LIST-A" >/dev/null \
+    && echo "$OUT2" | ${GREP} "^UPS UPS1@localhost" >/dev/null \
+    && ! echo "$OUT2" | ${GREP} "SINGLE" >/dev/null \
+    ; then
+        log_info "[testcase_sandbox_cgi_daemon] PASSED: the host argument of one request is not kept for the next one"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_cgi_daemon] unexpected pages for a single device then the list: '$OUT1' '$OUT2'"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_cgi_daemon"
+    fi
+
+    printf '@NUT_UPSSTATS_TEMPLATE@\nLIST-B, changed\n' > "${CGI_CONFPATH}/upsstats.html"
+    OUT="`\"${PYTHON}\" -c \"$CGI_GET\" \"${CGI_URL}\" 2>&1`"
+    if echo "$OUT" | ${GREP} "^LIST-B, changed" >/dev/null ; then
+        log_info "[testcase_sandbox_cgi_daemon] PASSED: the changed template is used"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_cgi_daemon] the changed template was not read again: '$OUT'"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_cgi_daemon"
+    fi
+
+    # Two clients connected but silent, one sending half of a request
+    OUT="`\"${PYTHON}\" -c '
+import socket, sys, time, urllib.request
+port = int(sys.argv[1])
+slow = [socket.create_connection(("127.0.0.1", port)) for i in range(3)]
+slow[0].sendall(b"GET /upsstats.cgi HTTP/1.0\r\n")
+start = time.time()
+urllib.request.urlopen("http://127.0.0.1:%d/upsstats.cgi" % port, timeout=10).read()
+print(int(time.time() - start))
+' \"${CGI_PORT}\" 2>&1`"
+    if [ x"$OUT" = x"0" ] ; then
+        log_info "[testcase_sandbox_cgi_daemon] PASSED: a request is answered while other clients stall"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_cgi_daemon] a request waited for the stalled clients: '$OUT'"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_cgi_daemon"
+    fi
+
+    kill -15 $PID_CGI 2>/dev/null || true
+    wait $PID_CGI || true
+
+    if ! command -v "upsimage.cgi${EXEEXT-}" >/dev/null 2>&1 ; then
+        log_warn "[testcase_sandbox_cgi_daemon] upsimage.cgi not available, its part skipped"
+        SKIPPED_FUNCS="${SKIPPED_FUNCS} testcase_sandbox_cgi_daemon"
+        SKIPPED="`expr ${SKIPPED} + 1`"
+        return 0
+    fi
+
+    NUT_CONFPATH="${CGI_CONFPATH}" NUT_CGI_LISTEN="`expr $CGI_PORT + 1`" \
+        "upsimage.cgi${EXEEXT-}" 2>"${CGI_CONFPATH}/upsimage.log" &
+    PID_CGI="$!"
+
+    # Width of each image, and whether it is the same as the first one
+    CGI_URL="http://127.0.0.1:`expr $CGI_PORT + 1`/upsimage.cgi?host=UPS1@localhost:${NUT_PORT}"
+    OUT="`\"${PYTHON}\" -c '
+import struct, sys, time, urllib.request
+first = None
+for n in range(10):
+    try:
+        first = urllib.request.urlopen(sys.argv[1] + "&display=battery.charge", timeout=10).read()
+        break
+    except OSError:
+        time.sleep(1)
+for args in ("&display=battery.charge", "&display=battery.charge&width=120",
+             "&display=battery.charge", "&display=ups.load"):
+    png = urllib.request.urlopen(sys.argv[1] + args, timeout=10).read()
+    print("%d:%s" % (struct.unpack(">I", png[16:20])[0], "same" if png == first else "other"))
+' \"${CGI_URL}\" 2>&1 | tr '\n' ' '`"
+    if [ x"$OUT" = x"100:same 120:other 100:same 100:other " ] ; then
+        log_info "[testcase_sandbox_cgi_daemon] PASSED: images are kept apart by arguments and displayed value"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_cgi_daemon] unexpected images (width:same as the first or other): '$OUT'"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_cgi_daemon"
+    fi
+
+    kill -15 $PID_CGI 2>/dev/null || true
+    wait $PID_CGI || true
+}
+
+testcase_sandbox_repeater_watch() {
+    # dummy-ups in repeater mode WATCHes the device it repeats: a large
+    # LIST VAR answer on the watched connection (UPS2 is a whole ePDU
+    # dump) must come through, and the changes of the "dummy" device
+    # (flipping every 5 sec) must be pushed quicker than the resync
+    # polling (every 30 sec) would bring them
+    log_separator
+    log_info "[testcase_sandbox_repeater_watch] Test dummy-ups repeaters following upsd WATCH notifications"
+
+    if [ x"${TOP_SRCDIR}" = x ]; then
+        log_warn "[testcase_sandbox_repeater_watch] Test data (UPS2) not available, skipped"
+        SKIPPED_FUNCS="${SKIPPED_FUNCS} testcase_sandbox_repeater_watch"
+        SKIPPED="`expr ${SKIPPED} + 1`"
+        return 0
+    fi
+
+    cp -pf "$NUT_CONFPATH/ups.conf" "$NUT_CONFPATH/ups.conf.nowatch" || die "[testcase_sandbox_repeater_watch] Failed to back up ups.conf"
+    cat >> "$NUT_CONFPATH/ups.conf" << EOF
+[nitwatch1]
+    driver = dummy-ups
+    port = UPS2@localhost:${NUT_PORT}
+
+[nitwatch2]
+    driver = dummy-ups
+    port = dummy@localhost:${NUT_PORT}
+EOF
+    [ $? = 0 ] || die "[testcase_sandbox_repeater_watch] Failed to populate ups.conf"
+
+    # Let upsd know both devices
+    kill -1 $PID_UPSD
+    sleep 3
+
+    PIDS_NITWATCH=""
+    for N in 1 2 ; do
+        rm -f "${NUT_STATEPATH}/nitwatch$N.log" || true
+        execcmd dummy-ups -a nitwatch$N -D ${ARG_USER} ${ARG_FG} 2>"${NUT_STATEPATH}/nitwatch$N.log" &
+        PIDS_NITWATCH="$PIDS_NITWATCH $!"
+    done
+
+    COUNTDOWN=60
+    while [ "$COUNTDOWN" -gt 0 ]; do
+        if ${GREP} "Watching UPS2@localhost" "${NUT_STATEPATH}/nitwatch1.log" >/dev/null \
+        && ${GREP} "Watching dummy@localhost" "${NUT_STATEPATH}/nitwatch2.log" >/dev/null \
+        ; then
+            break
+        fi
+        sleep 1
+        COUNTDOWN="`expr $COUNTDOWN - 1`"
+    done
+
+    # the whole dump, as seen directly and through the repeater
+    sleep 3
+    runcmd upsc UPS2@localhost:$NUT_PORT
+    OUT1="`echo \"$CMDOUT\" | ${EGREP} -v '^(driver|device\.type|ups\.status)' | sort`"
+    runcmd upsc nitwatch1@localhost:$NUT_PORT
+    OUT2="`echo \"$CMDOUT\" | ${EGREP} -v '^(driver|device\.type|ups\.status)' | sort`"
+
+    if ${GREP} "Watching UPS2@localhost" "${NUT_STATEPATH}/nitwatch1.log" >/dev/null \
+    && ! ${GREP} "Lost connection" "${NUT_STATEPATH}/nitwatch1.log" >/dev/null \
+    && [ -n "$OUT1" ] && [ x"$OUT1" = x"$OUT2" ] \
+    ; then
+        log_info "[testcase_sandbox_repeater_watch] PASSED: nitwatch1 watches UPS2 and got all of its `echo \"$OUT1\" | wc -l` values"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_repeater_watch] nitwatch1 did not follow UPS2 over a watched connection, see ${NUT_STATEPATH}/nitwatch1.log"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_repeater_watch"
+    fi
+
+    # the flips of ups.status, as pushed
+    OUTS=""
+    for I in 1 2 3 4 5 6 7 8 9 10 11 12 ; do
+        runcmd upsc nitwatch2@localhost:$NUT_PORT ups.status && OUTS="$OUTS [$CMDOUT]"
+        sleep 1
+    done
+
+    if ${GREP} "Watching dummy@localhost" "${NUT_STATEPATH}/nitwatch2.log" >/dev/null \
+    && echo "$OUTS" | ${GREP} '\[OB\]' >/dev/null \
+    && echo "$OUTS" | ${GREP} '\[OL\]' >/dev/null \
+    ; then
+        log_info "[testcase_sandbox_repeater_watch] PASSED: nitwatch2 follows the changes of dummy:$OUTS"
+        PASSED="`expr $PASSED + 1`"
+    else
+        log_error "[testcase_sandbox_repeater_watch] nitwatch2 did not follow the changes of dummy:$OUTS, see ${NUT_STATEPATH}/nitwatch2.log"
+        FAILED="`expr $FAILED + 1`"
+        FAILED_FUNCS="$FAILED_FUNCS testcase_sandbox_repeater_watch"
+    fi
+
+    kill -15 $PIDS_NITWATCH 2>/dev/null || true
+    wait $PIDS_NITWATCH || true
+
+    mv -f "$NUT_CONFPATH/ups.conf.nowatch" "$NUT_CONFPATH/ups.conf"
+    kill -1 $PID_UPSD
+}
+
 PY_SHEBANG=""
 PY_RES=127
 isTestablePython() {
@@ -4697,7 +5150,12 @@ testgroup_sandbox() {
     testcase_sandbox_start_drivers_after_upsd
     testcase_sandbox_upsc_query_model
     testcase_sandbox_upsc_query_bogus
+    testcase_sandbox_upsd_stats
     testcase_sandbox_upsc_query_timer
+    testcase_sandbox_snmp_hosted_agents
+    testcase_sandbox_netxml_stub
+    testcase_sandbox_repeater_watch
+    testcase_sandbox_cgi_daemon
     testcases_sandbox_python
     testcases_sandbox_cppnit
     testcases_sandbox_perl
@@ -27,6 +27,13 @@
 #include "attribute.h"
 #include "nut_stdint.h"
 
+#ifndef WIN32
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+# include <unistd.h>
+#endif	/* !WIN32 */
+
 /* driver version */
 #define DRIVER_NAME	"Mock driver for unit tests"
 #define DRIVER_VERSION	"0.02"
@@ -73,6 +80,112 @@ static int report_0_means_pass(int i) {
 	return i;
 }
 
+#ifndef WIN32
+/* Handler of the descriptors registered in test cases #30 and #31:
+ * counts the calls, and may unregister another descriptor */
+static int	fd_handler_calls = 0;
+static TYPE_FD	fd_handler_unregister[2] = { ERROR_FD, ERROR_FD };
+
+static int fd_handler(TYPE_FD fd, void *arg)
+{
+	char	c;
+	size_t	idx = (size_t)(uintptr_t)arg;
+
+	if (read(fd, &c, 1) < 0)
+		return 0;
+
+	fd_handler_calls++;
+	if (VALID_FD(fd_handler_unregister[idx]))
+		dstate_unregister_fd(fd_handler_unregister[idx]);
+
+	return 0;
+}
+
+/* Handler of the descriptor registered in test case #36: notes which
+ * instance was selected when it was called */
+static char	ctx_handler_model[SMALLBUF] = "";
+
+static int ctx_handler(TYPE_FD fd, void *arg)
+{
+	char	c;
+
+	NUT_UNUSED_VARIABLE(arg);
+
+	if (read(fd, &c, 1) < 0)
+		return 0;
+
+	snprintf(ctx_handler_model, sizeof(ctx_handler_model), "%s",
+		NUT_STRARG(dstate_getinfo("device.model")));
+
+	return 0;
+}
+
+/* Wait for the driver socket for a while, as the driver main loop does */
+static void poll_ms(long ms)
+{
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	tv.tv_usec += ms * 1000;
+	tv.tv_sec += tv.tv_usec / 1000000;
+	tv.tv_usec %= 1000000;
+	dstate_poll_fds(tv, ERROR_FD);
+}
+
+/* Connect a reader to the driver socket, or return -1 */
+static int reader_connect(const char *sockname)
+{
+	struct sockaddr_un	sa;
+	int	fd;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", NUT_STRARG(sockname));
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+		close(fd);
+		fd = -1;
+	}
+
+	/* let the driver accept it */
+	if (fd >= 0)
+		poll_ms(10);
+
+	return fd;
+}
+
+/* Read what the driver sends to a lagging reader until <until> shows up
+ * or the connection is closed (returns 1 then); up to <bufsize> bytes
+ * are kept in <buf> */
+static int reader_catch_up(int fd, char *buf, size_t bufsize, size_t *len, const char *until)
+{
+	ssize_t	ret;
+	int	idle = 0;
+
+	while (idle < 50) {
+		poll_ms(10);
+
+		for (;;) {
+			ret = recv(fd, buf + *len, bufsize - 1 - *len, MSG_DONTWAIT);
+			if (ret <= 0)
+				break;
+			*len += (size_t)ret;
+			idle = 0;
+		}
+		buf[*len] = '\0';
+
+		if (ret == 0)
+			return 1;
+		if (until && strstr(buf, until))
+			return 0;
+		idle++;
+	}
+
+	return 0;
+}
+#endif	/* !WIN32 */
+
 int main(int argc, char **argv) {
 	const char	*valueStr = NULL;
 	char	*s;
@@ -402,6 +515,531 @@ int main(int argc, char **argv) {
 	status_init();
 	status_commit();
 
+	/* Test cases #21 to #25 (from scratch)
+	 * Typed numeric setters format values like their printf-style
+	 * siblings, and suppress updates with the same numeric value.
+	 */
+	{
+		uintmax_t	changed1, suppressed1, changed2, suppressed2;
+		const char	*fmt = "%04.1f";
+
+		/* #21 */
+		dstate_setinfo_double("input.voltage", 1, 229.96);
+		valueStr = dstate_getinfo("input.voltage");
+		report_0_means_pass(strcmp(valueStr, "230.0"));
+		printf(" test for dstate_setinfo_double() with precision 1: '%s'; got 230.0?\n", NUT_STRARG(valueStr));
+
+		/* #22 */
+		dstate_get_setinfo_counters(&changed1, &suppressed1);
+		report_0_means_pass(dstate_setinfo_double("input.voltage", 1, 229.96) != 0);
+		dstate_get_setinfo_counters(&changed2, &suppressed2);
+		report_0_means_pass(!(changed2 == changed1 && suppressed2 == suppressed1 + 1));
+		printf(" test for dstate_setinfo_double() with same value: changed %" PRIuMAX "=>%" PRIuMAX
+			", suppressed %" PRIuMAX "=>%" PRIuMAX "; got suppressed?\n",
+			changed1, changed2, suppressed1, suppressed2);
+
+		/* #23: string setter resets the numeric shadow */
+		dstate_setinfo("input.voltage", "%s", "unknown");
+		report_0_means_pass(dstate_setinfo_double("input.voltage", 1, 229.96) != 1);
+		valueStr = dstate_getinfo("input.voltage");
+		report_0_means_pass(strcmp(valueStr, "230.0"));
+		printf(" test for dstate_setinfo_double() after dstate_setinfo(): '%s'; got 230.0?\n", NUT_STRARG(valueStr));
+
+		/* #24 */
+		dstate_setinfo_int("ups.delay.shutdown", 20L);
+		report_0_means_pass(dstate_setinfo_int("ups.delay.shutdown", 20L) != 0);
+		dstate_setinfo_double_dynamic("input.frequency", fmt, 9.95);
+		report_0_means_pass(dstate_setinfo_double_dynamic("input.frequency", fmt, 9.95) != 0);
+		report_0_means_pass(strcmp(dstate_getinfo("ups.delay.shutdown"), "20"));
+		valueStr = dstate_getinfo("input.frequency");
+		report_0_means_pass(strcmp(valueStr, "09.9") && strcmp(valueStr, "10.0"));
+		printf(" test for dstate_setinfo_int() and dstate_setinfo_double_dynamic(): '%s'; got formatted values?\n", NUT_STRARG(valueStr));
+
+		/* #25: invalid dynamic formatting is rejected */
+		report_0_means_pass(dstate_setinfo_double_dynamic("input.frequency", "%s", 1.0) != -1);
+		printf(" test for dstate_setinfo_double_dynamic() with bad format; got rejected?\n");
+	}
+
+	/* Test cases #26 to #29
+	 * Several device instances in one process: each selected dstate
+	 * context has its own data tree, status being built and socket.
+	 */
+	{
+		dstate_ctx_t	*other = dstate_ctx_new(), *prev;
+		char	dir[] = "/tmp/nut-dstate-XXXXXX", *sockname = NULL;
+
+		/* #26 */
+		dstate_setinfo("device.model", "%s", "first");
+		prev = dstate_ctx_select(other);
+		report_0_means_pass(dstate_getinfo("device.model") != NULL);
+		dstate_setinfo("device.model", "%s", "second");
+		dstate_ctx_select(prev);
+		valueStr = dstate_getinfo("device.model");
+		report_0_means_pass(strcmp(NUT_STRARG(valueStr), "first"));
+		printf(" test for separate data trees: '%s'; got first?\n", NUT_STRARG(valueStr));
+
+		/* #27: status built for one device while the other builds its own */
+		status_init();
+		status_set("OL");
+		dstate_ctx_select(other);
+		status_init();
+		status_set("OB");
+		status_set("LB");
+		dstate_ctx_select(prev);
+		status_set("CHRG");
+		status_commit();
+		dstate_ctx_select(other);
+		status_commit();
+		valueStr = dstate_getinfo("ups.status");
+		report_0_means_pass(strcmp(NUT_STRARG(valueStr), "OB LB"));
+		printf(" test for interleaved status building: '%s'; got 'OB LB'?\n", NUT_STRARG(valueStr));
+		dstate_ctx_select(prev);
+		valueStr = dstate_getinfo("ups.status");
+		report_0_means_pass(strcmp(NUT_STRARG(valueStr), "OL CHRG"));
+		printf(" test for interleaved status building: '%s'; got 'OL CHRG'?\n", NUT_STRARG(valueStr));
+
+#ifndef WIN32
+		/* #28: a socket per instance, each answering with its own data */
+		if (mkdtemp(dir)) {
+			int	fd = -1;
+			struct sockaddr_un	sa;
+			char	buf[LARGEBUF];
+			size_t	len = 0;
+			ssize_t	ret;
+			struct timeval	tv;
+
+			buf[0] = '\0';
+
+			setenv("NUT_STATEPATH", dir, 1);
+			dstate_ctx_select(other);
+			sockname = dstate_init("dstate-utest", "second");
+
+			memset(&sa, 0, sizeof(sa));
+			sa.sun_family = AF_UNIX;
+			snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", NUT_STRARG(sockname));
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd >= 0 && connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0
+			 && write(fd, "DUMPALL\n", 8) == 8
+			) {
+				for (i = 0; i < 20 && !strstr(buf, "DUMPDONE"); i++) {
+					gettimeofday(&tv, NULL);
+					tv.tv_usec += 50000;
+					dstate_poll_fds(tv, ERROR_FD);
+
+					ret = recv(fd, buf + len, sizeof(buf) - 1 - len, MSG_DONTWAIT);
+					if (ret > 0)
+						len += (size_t)ret;
+					buf[len] = '\0';
+				}
+			} else {
+				buf[0] = '\0';
+			}
+
+			report_0_means_pass(!(strstr(buf, "SETINFO device.model \"second\"")
+				&& !strstr(buf, "\"first\"")));
+			printf(" test for a socket per instance: %" PRIuSIZE " bytes dumped; got the second device?\n", len);
+
+			if (fd >= 0)
+				close(fd);
+			dstate_ctx_select(prev);
+		} else {
+			report_fail();
+			printf(" test for a socket per instance: mkdtemp() failed\n");
+		}
+#else	/* WIN32 */
+		report_pass();
+		printf(" test for a socket per instance: skipped on WIN32\n");
+#endif	/* WIN32 */
+
+		/* #29 */
+		dstate_ctx_free(other);
+		valueStr = dstate_getinfo("device.model");
+		report_0_means_pass(strcmp(NUT_STRARG(valueStr), "first"));
+		printf(" test for freeing an instance: '%s'; got first?\n", NUT_STRARG(valueStr));
+#ifndef WIN32
+		report_0_means_pass(sockname == NULL);
+		printf(" test for freeing an instance: had a socket?\n");
+		report_0_means_pass(sockname != NULL && access(sockname, F_OK) == 0);
+		printf(" test for freeing an instance: socket removed?\n");
+		free(sockname);
+		rmdir(dir);
+#endif	/* !WIN32 */
+	}
+
+	/* Test cases #30 and #31
+	 * Descriptors registered with dstate_register_fd(): all those
+	 * ready are handled by one wait, and those unregistered by the
+	 * handler of another one are not called anymore.
+	 */
+#ifndef WIN32
+	{
+		dstate_ctx_t	*other = dstate_ctx_new(), *prev = dstate_ctx_select(other);
+		char	*sockname = NULL;
+		int	pa[2] = { -1, -1 }, pb[2] = { -1, -1 }, pc[2] = { -1, -1 },
+			madedir = 0;
+		struct timeval	tv;
+
+		/* the state path is remembered, re-create the one of #28 */
+		madedir = (mkdir(dflt_statepath(), 0700) == 0);
+
+		if (madedir && pipe(pa) == 0 && pipe(pb) == 0 && pipe(pc) == 0) {
+			sockname = dstate_init("dstate-utest", "fds");
+
+			dstate_register_fd(pa[0], fd_handler, (void *)(uintptr_t)0);
+			dstate_register_fd(pb[0], fd_handler, (void *)(uintptr_t)1);
+			dstate_register_fd(pc[0], fd_handler, (void *)(uintptr_t)1);
+
+			/* #30 */
+			fd_handler_calls = 0;
+			if (write(pa[1], "a", 1) == 1 && write(pb[1], "b", 1) == 1) {
+				gettimeofday(&tv, NULL);
+				tv.tv_sec++;
+				dstate_poll_fds(tv, ERROR_FD);
+			}
+			report_0_means_pass(fd_handler_calls != 2);
+			printf(" test for registered descriptors: %d handled; got both ready ones?\n",
+				fd_handler_calls);
+
+			/* #31: each handler drops the other, both are ready */
+			fd_handler_calls = 0;
+			fd_handler_unregister[0] = pb[0];
+			fd_handler_unregister[1] = pa[0];
+			if (write(pa[1], "a", 1) == 1 && write(pb[1], "b", 1) == 1) {
+				gettimeofday(&tv, NULL);
+				tv.tv_sec++;
+				dstate_poll_fds(tv, ERROR_FD);
+			}
+			report_0_means_pass(fd_handler_calls != 1);
+			printf(" test for descriptors unregistered while handling others: %d handled; got 1?\n",
+				fd_handler_calls);
+
+			dstate_unregister_fd(pc[0]);
+		} else {
+			report_fail();
+			report_fail();
+			printf(" test for registered descriptors: setup failed\n");
+		}
+
+		for (i = 0; i < 2; i++) {
+			if (pa[i] >= 0)
+				close(pa[i]);
+			if (pb[i] >= 0)
+				close(pb[i]);
+			if (pc[i] >= 0)
+				close(pc[i]);
+		}
+
+		dstate_ctx_select(prev);
+		dstate_ctx_free(other);
+		free(sockname);
+		if (madedir)
+			rmdir(dflt_statepath());
+	}
+#else	/* WIN32 */
+	report_pass();
+	report_pass();
+	printf(" test for registered descriptors: skipped on WIN32\n");
+#endif	/* WIN32 */
+
+	/* Test cases #32 to #34
+	 * A reader which does not keep up: what the socket does not take
+	 * is queued in order, values of the same variable queued meanwhile
+	 * are coalesced into the latest one, and a reader which lets too
+	 * much other output pile up is disconnected.
+	 */
+#ifndef WIN32
+	{
+		dstate_ctx_t	*other = dstate_ctx_new(), *prev = dstate_ctx_select(other);
+		char	*sockname = NULL, *buf = NULL, *p, value[201], line[SMALLBUF];
+		size_t	bufsize = 4 * DSTATE_CONN_QUEUE_MAX, len = 0;
+		int	fd = -1, madedir = 0, ok, closed, n, last;
+
+		memset(value, 'x', sizeof(value) - 1);
+		value[sizeof(value) - 1] = '\0';
+
+		madedir = (mkdir(dflt_statepath(), 0700) == 0);
+		if (madedir) {
+			sockname = dstate_init("dstate-utest", "slow");
+			fd = reader_connect(sockname);
+		}
+
+		if (fd >= 0) {
+			buf = (char *)xcalloc(1, bufsize);
+
+			/* more than the socket takes, then a value
+			 * changing while the reader lags behind */
+			for (i = 0; i < 2000; i++) {
+				snprintf(line, sizeof(line), "test.fill.%d", i);
+				dstate_setinfo(line, "%s", value);
+			}
+			for (i = 1; i <= 100; i++)
+				dstate_setinfo("test.coalesced", "%d", i);
+			dstate_setinfo("test.last", "%s", "done");
+
+			closed = reader_catch_up(fd, buf, bufsize, &len, "SETINFO test.last \"done\"");
+
+			/* #32 */
+			ok = !closed;
+			for (i = 0, p = buf; ok && i < 2000; i++) {
+				snprintf(line, sizeof(line), "SETINFO test.fill.%d \"", i);
+				if ((p = strstr(p, line)) == NULL)
+					ok = 0;
+			}
+			report_0_means_pass(!(ok && p && strstr(p, "SETINFO test.last")));
+			printf(" test for a lagging reader: %" PRIuSIZE " bytes read; got all in order?\n", len);
+
+			/* #33 */
+			for (n = 0, last = 0, p = buf; (p = strstr(p, "SETINFO test.coalesced \"")) != NULL; n++) {
+				p += strlen("SETINFO test.coalesced \"");
+				last = atoi(p);
+			}
+			report_0_means_pass(!(n < 100 && last == 100));
+			printf(" test for a lagging reader: %d of 100 values sent, the last one %d; got coalesced?\n",
+				n, last);
+
+			/* #34: a backlog which can not be coalesced */
+			len = 0;
+			dstate_setinfo("test.enum", "%s", "0");
+			for (i = 0; i < 10000; i++)
+				dstate_addenum("test.enum", "%d%s", i, value);
+
+			closed = reader_catch_up(fd, buf, bufsize, &len, NULL);
+			report_0_means_pass(!closed);
+			printf(" test for a reader too slow for %d bytes of queued output: disconnected after %" PRIuSIZE " bytes?\n",
+				DSTATE_CONN_QUEUE_MAX, len);
+
+			free(buf);
+			close(fd);
+		} else {
+			report_fail();
+			report_fail();
+			report_fail();
+			printf(" test for a lagging reader: setup failed\n");
+		}
+
+		dstate_ctx_select(prev);
+		dstate_ctx_free(other);
+		free(sockname);
+		if (madedir)
+			rmdir(dflt_statepath());
+	}
+#else	/* WIN32 */
+	report_pass();
+	report_pass();
+	report_pass();
+	printf(" test for a lagging reader: skipped on WIN32\n");
+#endif	/* WIN32 */
+
+	/* Test cases #35 and #36
+	 * dstate_poll_all() serves the readers of all instances at once,
+	 * and calls the handlers of descriptors registered in any of them
+	 * with that instance selected.
+	 */
+#ifndef WIN32
+	{
+		dstate_ctx_t	*ca = dstate_ctx_new(), *cb = dstate_ctx_new(),
+			*prev = dstate_ctx_select(ca);
+		char	*sna = NULL, *snb = NULL, bufa[LARGEBUF], bufb[LARGEBUF];
+		size_t	lena = 0, lenb = 0;
+		int	fda = -1, fdb = -1, madedir = 0, pfd[2] = { -1, -1 };
+		ssize_t	ret;
+		struct timeval	tv;
+
+		madedir = (mkdir(dflt_statepath(), 0700) == 0);
+		if (madedir) {
+			sna = dstate_init("dstate-utest", "multi-a");
+			dstate_setinfo("device.model", "%s", "multi-a");
+			dstate_ctx_select(cb);
+			snb = dstate_init("dstate-utest", "multi-b");
+			dstate_setinfo("device.model", "%s", "multi-b");
+			dstate_ctx_select(ca);
+		}
+
+		/* connect without the help of reader_connect(), which
+		 * only waits for the selected instance */
+		if (sna && snb && pipe(pfd) == 0) {
+			struct sockaddr_un	sa;
+
+			memset(&sa, 0, sizeof(sa));
+			sa.sun_family = AF_UNIX;
+			fda = socket(AF_UNIX, SOCK_STREAM, 0);
+			fdb = socket(AF_UNIX, SOCK_STREAM, 0);
+			snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", sna);
+			if (fda >= 0 && connect(fda, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+				close(fda);
+				fda = -1;
+			}
+			snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", snb);
+			if (fdb >= 0 && connect(fdb, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+				close(fdb);
+				fdb = -1;
+			}
+		}
+
+		if (fda >= 0 && fdb >= 0) {
+			/* #35 */
+			if (write(fda, "DUMPALL\n", 8) == 8 && write(fdb, "DUMPALL\n", 8) == 8) {
+				for (i = 0; i < 50; i++) {
+					gettimeofday(&tv, NULL);
+					tv.tv_usec += 20000;
+					tv.tv_sec += tv.tv_usec / 1000000;
+					tv.tv_usec %= 1000000;
+					dstate_poll_all(tv, ERROR_FD);
+
+					while ((ret = recv(fda, bufa + lena, sizeof(bufa) - 1 - lena, MSG_DONTWAIT)) > 0)
+						lena += (size_t)ret;
+					while ((ret = recv(fdb, bufb + lenb, sizeof(bufb) - 1 - lenb, MSG_DONTWAIT)) > 0)
+						lenb += (size_t)ret;
+					bufa[lena] = '\0';
+					bufb[lenb] = '\0';
+
+					if (strstr(bufa, "DUMPDONE") && strstr(bufb, "DUMPDONE"))
+						break;
+				}
+			}
+			report_0_means_pass(!(strstr(bufa, "SETINFO device.model \"multi-a\"")
+				&& strstr(bufb, "SETINFO device.model \"multi-b\"")
+				&& strstr(bufa, "DUMPDONE") && strstr(bufb, "DUMPDONE")));
+			printf(" test for waiting on all instances: got a dump from each?\n");
+
+			/* #36: registered in the other instance than selected */
+			dstate_ctx_select(cb);
+			dstate_register_fd(pfd[0], ctx_handler, NULL);
+			dstate_ctx_select(ca);
+			if (write(pfd[1], "x", 1) == 1) {
+				gettimeofday(&tv, NULL);
+				tv.tv_sec++;
+				dstate_poll_all(tv, ERROR_FD);
+			}
+			report_0_means_pass(strcmp(ctx_handler_model, "multi-b")
+				|| strcmp(NUT_STRARG(dstate_getinfo("device.model")), "multi-a"));
+			printf(" test for waiting on all instances: handler called for '%s'; got multi-b?\n",
+				ctx_handler_model);
+
+			dstate_ctx_select(cb);
+			dstate_unregister_fd(pfd[0]);
+		} else {
+			report_fail();
+			report_fail();
+			printf(" test for waiting on all instances: setup failed\n");
+		}
+
+		if (fda >= 0)
+			close(fda);
+		if (fdb >= 0)
+			close(fdb);
+		for (i = 0; i < 2; i++) {
+			if (pfd[i] >= 0)
+				close(pfd[i]);
+		}
+
+		dstate_ctx_select(prev);
+		dstate_ctx_free(ca);
+		dstate_ctx_free(cb);
+		free(sna);
+		free(snb);
+		if (madedir)
+			rmdir(dflt_statepath());
+	}
+#else	/* WIN32 */
+	report_pass();
+	report_pass();
+	printf(" test for waiting on all instances: skipped on WIN32\n");
+#endif	/* WIN32 */
+
+	/* Test cases #37 to #39
+	 * Devices of the ups.conf sections hosted by ours: each one has its
+	 * own settings, port and instance, which are selected together.
+	 */
+#ifndef WIN32
+	{
+		char	dir[] = "/tmp/nut-hosted-XXXXXX", fn[NUT_PATH_MAX + 1], own[] = "own";
+		FILE	*f = NULL;
+		upsdrv_hosted_t	*list, *dev, *prev;
+		const char	*val;
+		int	n, ok;
+
+		if (mkdtemp(dir)) {
+			snprintf(fn, sizeof(fn), "%s/ups.conf", dir);
+			f = fopen(fn, "w");
+		}
+
+		if (f) {
+			fprintf(f,
+				"[host]\n\tdriver = dstate-utest\n\tport = 10.0.0.1\n"
+				"[agent1]\n\tdriver = dstate-utest\n\tport = 10.0.0.2\n"
+				"\thosted_by = host\n\tcommunity = one\n"
+				"[agent2]\n\tdriver = dstate-utest\n\tport = 10.0.0.3\n"
+				"\thosted_by = host\n\tcommunity = two\n\tpollinterval = 5\n"
+				"[other]\n\tdriver = dstate-utest\n\tport = 10.0.0.4\n");
+			fclose(f);
+
+			setenv("NUT_CONFPATH", dir, 1);
+			if (!prognames[0])
+				prognames[0] = "dstate-utest";
+			upsname = "host";
+			addvar(VAR_VALUE, "community", "SNMP community");
+			storeval("community", own);
+
+			list = upsdrv_hosted_load();
+
+			/* #37 */
+			for (n = 0, dev = list; dev; dev = dev->next)
+				n++;
+			report_0_means_pass(!(n == 2
+				&& !strcmp(list->name, "agent1") && !strcmp(NUT_STRARG(list->port), "10.0.0.2")
+				&& !strcmp(list->next->name, "agent2")));
+			printf(" test for hosted sections: %d found; got agent1 and agent2?\n", n);
+
+			/* #38 */
+			ok = 0;
+			if (n == 2) {
+				prev = upsdrv_hosted_select(list->next);
+				val = dstate_getinfo("driver.parameter.hosted_by");
+				ok = (!strcmp(upsname, "agent2")
+					&& !strcmp(NUT_STRARG(device_path), "10.0.0.3")
+					&& !strcmp(NUT_STRARG(getval("community")), "two")
+					&& val && !strcmp(val, "host"));
+				upsdrv_hosted_select(prev);
+				ok = (ok && !strcmp(upsname, "host")
+					&& !strcmp(NUT_STRARG(getval("community")), "own")
+					&& !dstate_getinfo("driver.parameter.hosted_by"));
+			}
+			report_0_means_pass(!ok);
+			printf(" test for selecting a hosted device: got its settings, then ours back?\n");
+
+			/* #39 */
+			ok = 0;
+			if (n == 2) {
+				prev = upsdrv_hosted_select(list);
+				ok = (upsdrv_hosted_find_ctx(dstate_ctx_get()) == list);
+				upsdrv_hosted_select(prev);
+				ok = (ok && upsdrv_hosted_find_ctx(dstate_ctx_get()) == NULL);
+			}
+			report_0_means_pass(!ok);
+			printf(" test for the hosted device of the selected instance\n");
+
+			upsdrv_hosted_free();
+			vartab_free();
+			vartab_h = NULL;
+			upsname = NULL;
+			unlink(fn);
+		} else {
+			report_fail();
+			report_fail();
+			report_fail();
+			printf(" test for hosted sections: setup failed\n");
+		}
+
+		rmdir(dir);
+	}
+#else	/* WIN32 */
+	report_pass();
+	report_pass();
+	report_pass();
+	printf(" test for hosted sections: skipped on WIN32\n");
+#endif	/* WIN32 */
+
 	/* Finish */
 	printf("test_rules completed. Total cases %d, passed %d, failed %d\n",
 		cases_passed+cases_failed, cases_passed, cases_failed);
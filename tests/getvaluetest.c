@@ -38,6 +38,8 @@
 #include "common.h"
 
 void GetValue(const unsigned char *Buf, HIDData_t *pData, long *pValue);
+void PrepareField(const HIDData_t *pData, HIDField_t *pField);
+void GetValues(const unsigned char *Buf, const HIDField_t *pField, size_t nfields, long *pValues);
 
 static void Usage(char *name) {
 	printf("%s [<buf> <offset> <size> <min> <max> <expect>]\n", name);
@@ -101,8 +103,19 @@ static int RunBuiltInTests(char *argv[]) {
 		{.buf = "16 0c 00 00 00", .Offset = 7, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue =  0},
 		{.buf = "16 0c 00 00 00", .Offset = 8, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue =  0},
 		{.buf = "16 0c 00 00 00", .Offset = 9, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue =  0},
-		{.buf = "16 0c 00 00 00", .Offset = 10, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue =  0}
+		{.buf = "16 0c 00 00 00", .Offset = 10, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue =  0},
+		{.buf = "16 0c 00 00 00", .Offset = 0, .Size = 32, .LogMin = 0, .LogMax = 65535, .expectedValue = 12},
+		{.buf = "00 f0 ff 0f", .Offset = 4, .Size = 16, .LogMin = 0, .LogMax = 65535, .expectedValue = 65535},
+		{.buf = "00 f0 ff 0f", .Offset = 4, .Size = 12, .LogMin = -2048, .LogMax = 2047, .expectedValue = -1},
+		{.buf = "00 f0 ff 0f", .Offset = 20, .Size = 4, .LogMin = 0, .LogMax = 15, .expectedValue = 0},
+		{.buf = "00 34 12 78 56", .Offset = 0, .Size = 32, .LogMin = 0, .LogMax = 2147483647, .expectedValue = 1450709556},
+		{.buf = "00 34 12 78 56", .Offset = 8, .Size = 16, .LogMin = 0, .LogMax = 65535, .expectedValue = 30738},
+		{.buf = "00 34 12 78 56", .Offset = 12, .Size = 8, .LogMin = -128, .LogMax = 127, .expectedValue = -127},
+		{.buf = "00 00 00 00 80", .Offset = 31, .Size = 1, .LogMin = 0, .LogMax = 1, .expectedValue = 1}
 	};
+	HIDField_t	fields[SIZEOF_ARRAY(testData)];
+	long	values[SIZEOF_ARRAY(testData)];
+	size_t	j, k;
 
 	/* See comments below about rdlen calculation emulation for tests */
 	usb_ctrl_char	bufC[2];
@@ -135,6 +148,42 @@ static int RunBuiltInTests(char *argv[]) {
 		}
 	}
 
+	/* Decode the items of each report (consecutive tests with the same
+	 * buffer) all at once, as libhid does when a report is refreshed,
+	 * and expect the same values as one by one */
+	printf("\nTesting batch decoding of whole reports with GetValues():\n");
+	for (i = 0; i < SIZEOF_ARRAY(testData); i = j) {
+		int	batchStatus = 0;
+
+		next = testData[i].buf;
+		for (bufSize = 0; *next != 0; bufSize++) {
+			reportBuf[bufSize] = (uint8_t) strtol(next, (char **)&next, 16);
+		}
+
+		for (j = i; j < SIZEOF_ARRAY(testData) && !strcmp(testData[j].buf, testData[i].buf); j++) {
+			memset((void *)&data, 0, sizeof(data));
+			data.Offset = testData[j].Offset;
+			data.Size = testData[j].Size;
+			data.LogMin = testData[j].LogMin;
+			data.LogMax = testData[j].LogMax;
+			PrepareField(&data, &fields[j - i]);
+		}
+
+		GetValues(reportBuf, fields, j - i, values);
+
+		printf("Tests #%" PRIuSIZE "..#%" PRIuSIZE " in one pass:", i + 1, j);
+		for (k = i; k < j; k++) {
+			printf(" %ld", values[k - i]);
+			if (values[k - i] != testData[k].expectedValue) {
+				printf(" (expected %ld)", testData[k].expectedValue);
+				batchStatus = 1;
+			}
+		}
+		printf(" %s\n", batchStatus ? "FAIL" : "PASS");
+		if (batchStatus)
+			exitStatus = 1;
+	}
+
 	/* Emulate rdlen calculations in libusb{0,1}.c or
 	 * langid calculations in nutdrv_qx.c; in these
 	 * cases we take two bytes (cast from usb_ctrl_char
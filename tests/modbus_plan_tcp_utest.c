@@ -0,0 +1,217 @@
+/* modbus_plan_tcp_utest.c - tests for the Modbus read planner against
+ * a libmodbus TCP server on the loopback interface
+ *
+ * Copyright (C) 2026 Network UPS Tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "config.h"
+#include "common.h"
+#include "modbus-plan.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <modbus.h>
+
+/* The simulated device has holding and input registers 0..99 holding
+ * "addr * 3" and "addr * 5", and coils 0..99 with "addr % 3 == 0";
+ * reads past those fail with an "illegal data address" exception */
+#define SIM_ITEMS	100
+
+static int failures = 0;
+static size_t	requests = 0;
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		fprintf(stderr, "FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static void server_run(modbus_t *ctx, int listenfd)
+{
+	modbus_mapping_t	*map;
+	uint8_t	query[MODBUS_TCP_MAX_ADU_LENGTH];
+	int	i, fd = listenfd;
+
+	map = modbus_mapping_new(SIM_ITEMS, 0, SIM_ITEMS, SIM_ITEMS);
+	if (!map)
+		fatalx(EXIT_FAILURE, "modbus_mapping_new: %s", modbus_strerror(errno));
+
+	for (i = 0; i < SIM_ITEMS; i++) {
+		map->tab_bits[i] = (uint8_t)(i % 3 == 0);
+		map->tab_registers[i] = (uint16_t)(i * 3);
+		map->tab_input_registers[i] = (uint16_t)(i * 5);
+	}
+
+	if (modbus_tcp_accept(ctx, &fd) < 0)
+		fatalx(EXIT_FAILURE, "modbus_tcp_accept: %s", modbus_strerror(errno));
+
+	for (;;) {
+		int	rc = modbus_receive(ctx, query);
+
+		if (rc > 0)
+			modbus_reply(ctx, query, rc, map);
+		else if (rc < 0)
+			break;	/* the client went away */
+	}
+
+	modbus_mapping_free(map);
+	modbus_close(ctx);
+	modbus_free(ctx);
+}
+
+static int tcp_reader(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	modbus_t	*ctx = (modbus_t *)arg;
+
+	requests++;
+
+	switch (type) {
+		case MODBUS_PLAN_COIL:
+			return modbus_read_bits(ctx, addr, nb, (uint8_t *)dest);
+		case MODBUS_PLAN_INPUT_BIT:
+			return modbus_read_input_bits(ctx, addr, nb, (uint8_t *)dest);
+		case MODBUS_PLAN_INPUT_REGISTER:
+			return modbus_read_input_registers(ctx, addr, nb, (uint16_t *)dest);
+		case MODBUS_PLAN_HOLDING_REGISTER:
+			return modbus_read_registers(ctx, addr, nb, (uint16_t *)dest);
+		case MODBUS_PLAN_NUM_TYPES:
+		default:
+			return -1;
+	}
+}
+
+static void test_tcp(modbus_t *ctx)
+{
+	modbus_plan_t	*plan = modbus_plan_new(tcp_reader, ctx);
+	uint16_t	regs[SIM_ITEMS];
+	uint8_t	bits[4];
+	int	i, ok;
+
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 10, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 12, 2);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 30, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 90, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 98, 1);
+	/* past the end of the register map, bridged by a merge at first */
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 101, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_COIL, 3, 4);
+	check(modbus_plan_blocks(plan) == 4, "ranges merged into 4 requests");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 1 && requests == 4, "merged block over the end fails");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 12, 2, regs) == 0
+		&& regs[0] == 36 && regs[1] == 39, "values from a merged block");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_COIL, 3, 4, bits) == 0
+		&& bits[0] == 1 && bits[1] == 0 && bits[2] == 0 && bits[3] == 1, "coil values");
+	check(modbus_plan_blocks(plan) == 6, "failed block split into its ranges");
+
+	check(modbus_plan_refresh(plan) == 1, "missing range fails alone");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 98, 1, regs) == 0
+		&& regs[0] == 294, "value next to a missing range");
+	check(modbus_plan_blocks(plan) == 5, "missing range dropped from the plan");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 5, "no failed reads anymore");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 101, 1, regs) == -1,
+		"missing range not served");
+
+	modbus_plan_clear(plan);
+	modbus_plan_set_limits(plan, 40, 0, -1);
+	modbus_plan_add(plan, MODBUS_PLAN_INPUT_REGISTER, 0, SIM_ITEMS);
+	check(modbus_plan_blocks(plan) == 3, "large range split by the request limit");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 3, "split range read");
+	ok = (modbus_plan_fetch(plan, MODBUS_PLAN_INPUT_REGISTER, 0, SIM_ITEMS, regs) == 0);
+	for (i = 0; ok && i < SIM_ITEMS; i++) {
+		if (regs[i] != i * 5)
+			ok = 0;
+	}
+	check(ok, "values of a split range");
+
+	modbus_plan_free(plan);
+}
+
+int main(void)
+{
+	modbus_t	*srv = NULL, *ctx;
+	int	port, listenfd = -1, status = 0;
+	pid_t	pid;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	/* find a free port */
+	for (port = 20000 + (int)(getpid() % 20000); port < 65000; port += 97) {
+		srv = modbus_new_tcp("127.0.0.1", port);
+		if (!srv)
+			fatalx(EXIT_FAILURE, "modbus_new_tcp: %s", modbus_strerror(errno));
+
+		listenfd = modbus_tcp_listen(srv, 1);
+		if (listenfd >= 0)
+			break;
+
+		modbus_free(srv);
+		srv = NULL;
+	}
+
+	if (!srv) {
+		printf("SKIP: no free TCP port for the simulator\n");
+		return 77;
+	}
+
+	pid = fork();
+	if (pid < 0)
+		fatal_with_errno(EXIT_FAILURE, "fork");
+
+	if (pid == 0) {
+		server_run(srv, listenfd);
+		close(listenfd);
+		exit(EXIT_SUCCESS);
+	}
+
+	close(listenfd);
+	modbus_free(srv);
+
+	ctx = modbus_new_tcp("127.0.0.1", port);
+	if (!ctx || modbus_connect(ctx) < 0) {
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		fatalx(EXIT_FAILURE, "Can't connect to the simulator: %s", modbus_strerror(errno));
+	}
+
+	test_tcp(ctx);
+
+	modbus_close(ctx);
+	modbus_free(ctx);
+	waitpid(pid, &status, 0);
+
+	if (failures) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
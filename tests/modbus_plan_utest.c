@@ -0,0 +1,271 @@
+/* modbus_plan_utest.c - tests for the Modbus read planner
+ *
+ * Copyright (C) 2026 Network UPS Tools contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "config.h"
+#include "common.h"
+#include "modbus-plan.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+/* Simulated device: registers hold "addr * 3 + type", bits "addr % 2";
+ * holding registers 100..109 do not exist (reads covering them fail)
+ * while <hole> is set */
+static size_t	requests = 0;
+static int	hole = 1;
+
+static int sim_reader(void *arg, modbus_plan_type_t type, int addr, int nb, void *dest)
+{
+	int	i;
+
+	NUT_UNUSED_VARIABLE(arg);
+	requests++;
+
+	if (hole && type == MODBUS_PLAN_HOLDING_REGISTER && addr < 110 && addr + nb > 100)
+		return -1;
+
+	for (i = 0; i < nb; i++) {
+		if (type == MODBUS_PLAN_COIL || type == MODBUS_PLAN_INPUT_BIT)
+			((uint8_t *)dest)[i] = (uint8_t)((addr + i) % 2);
+		else
+			((uint16_t *)dest)[i] = (uint16_t)((addr + i) * 3 + (int)type);
+	}
+
+	return nb;
+}
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		fprintf(stderr, "FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static void test_merge(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	uint16_t	regs[4];
+
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 0, 1) == 0, "add 0/1");
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 10, 1) == 0, "add 10/1");
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 2, 2) == 0, "add 2/2");
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 40, 1) == 0, "add 40/1");
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 2, 2) == 0, "re-add 2/2");
+	check(modbus_plan_add(plan, MODBUS_PLAN_INPUT_REGISTER, 0, 1) == 0, "add input 0/1");
+	check(modbus_plan_blocks(plan) == 3, "near holding ranges merged, far ones and other types not");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0, "refresh without failures");
+	check(requests == 3, "one request per block");
+
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 2, 2, regs) == 0
+		&& regs[0] == 6 + MODBUS_PLAN_HOLDING_REGISTER
+		&& regs[1] == 9 + MODBUS_PLAN_HOLDING_REGISTER, "fetch 2/2 values");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 5, 1, regs) == 0
+		&& regs[0] == 15 + MODBUS_PLAN_HOLDING_REGISTER, "fetch from a bridged gap");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_INPUT_REGISTER, 0, 1, regs) == 0
+		&& regs[0] == MODBUS_PLAN_INPUT_REGISTER, "fetch input register");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 20, 1, regs) == -1,
+		"range not covered is not served");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 10, 2, regs) == -1,
+		"range crossing the block end is not served");
+
+	modbus_plan_invalidate(plan);
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 0, 1, regs) == -1,
+		"nothing served after invalidate");
+
+	modbus_plan_set_limits(plan, 8, 0, -1);
+	check(modbus_plan_blocks(plan) == 4, "request size limit splits a block");
+
+	modbus_plan_set_limits(plan, 125, 0, 0);
+	check(modbus_plan_blocks(plan) == 5, "zero gap only merges adjacent ranges");
+
+	modbus_plan_clear(plan);
+	check(modbus_plan_blocks(plan) == 0, "no blocks after clear");
+
+	modbus_plan_free(plan);
+}
+
+static void test_hole(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	uint16_t	reg;
+
+	modbus_plan_set_limits(plan, 0, 0, 20);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 95, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 112, 1);
+	check(modbus_plan_blocks(plan) == 1, "ranges around a hole merged at first");
+	check(modbus_plan_refresh(plan) == 1, "block over a hole fails");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 95, 1, &reg) == -1,
+		"failed block is not served");
+	check(modbus_plan_blocks(plan) == 2, "ranges around a hole are not merged anymore");
+	check(modbus_plan_refresh(plan) == 0, "split blocks are read");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 112, 1, &reg) == 0
+		&& reg == 336 + MODBUS_PLAN_HOLDING_REGISTER, "value after a hole");
+
+	modbus_plan_free(plan);
+}
+
+static void test_recover(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	int	i, ok;
+
+	modbus_plan_set_limits(plan, 0, 0, 20);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 95, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 112, 1);
+	check(modbus_plan_refresh(plan) == 1, "block over a hole fails");
+
+	/* Still failing when retried: twice as long until the next try */
+	for (i = 0, ok = 1; i < 15; i++)
+		ok &= (modbus_plan_refresh(plan) == 0 && modbus_plan_blocks(plan) == 2);
+	check(ok, "ranges read apart for 15 more cycles");
+	check(modbus_plan_refresh(plan) == 1, "merged again on the 16th cycle, fails again");
+	for (i = 0, ok = 1; i < 31; i++)
+		ok &= (modbus_plan_refresh(plan) == 0 && modbus_plan_blocks(plan) == 2);
+	check(ok, "ranges read apart for 31 more cycles after the second failure");
+
+	/* The hole was transient (e.g. the device was busy) */
+	hole = 0;
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 1,
+		"merged again on the 32nd cycle, and read");
+	check(modbus_plan_blocks(plan) == 1, "ranges stay merged after a good read");
+
+	/* A reconnection forgets the failures at once */
+	hole = 1;
+	check(modbus_plan_refresh(plan) == 1 && modbus_plan_blocks(plan) == 2,
+		"block over a hole fails, ranges split");
+	hole = 0;
+	modbus_plan_retry(plan);
+	check(modbus_plan_blocks(plan) == 1, "ranges merged again after modbus_plan_retry()");
+
+	/* ...and a range which failed alone is planned again too */
+	hole = 1;
+	modbus_plan_clear(plan);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 50, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 105, 1);
+	check(modbus_plan_refresh(plan) == 1 && modbus_plan_blocks(plan) == 1,
+		"range failing alone is dropped from the plan");
+	hole = 0;
+	for (i = 0; i < 15; i++)
+		modbus_plan_refresh(plan);
+	check(modbus_plan_blocks(plan) == 1, "dropped range not planned for 15 more cycles");
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 2
+		&& modbus_plan_blocks(plan) == 2, "dropped range planned and read on the 16th cycle");
+
+	hole = 1;
+	modbus_plan_free(plan);
+}
+
+static void test_missing(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	uint16_t	reg;
+
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 105, 1);
+	check(modbus_plan_refresh(plan) == 1, "missing range fails");
+	check(modbus_plan_blocks(plan) == 1, "range kept while nothing could be read");
+
+	modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 50, 1);
+	check(modbus_plan_blocks(plan) == 2, "far ranges not merged");
+	check(modbus_plan_refresh(plan) == 1, "missing range fails next to a good one");
+	check(modbus_plan_blocks(plan) == 1, "range failing alone is dropped from the plan");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 1, "dropped range is not read anymore");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 50, 1, &reg) == 0
+		&& reg == 150 + MODBUS_PLAN_HOLDING_REGISTER, "good range still served");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_HOLDING_REGISTER, 105, 1, &reg) == -1,
+		"dropped range is not served");
+
+	modbus_plan_free(plan);
+}
+
+static void test_split(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	uint16_t	regs[20];
+	int	i, ok = 1;
+
+	check(modbus_plan_configure(plan, "8", NULL, NULL) == 0, "configure from option values");
+	modbus_plan_add(plan, MODBUS_PLAN_INPUT_REGISTER, 0, 20);
+	check(modbus_plan_blocks(plan) == 3, "range larger than a request is split");
+
+	requests = 0;
+	check(modbus_plan_refresh(plan) == 0 && requests == 3, "split blocks are read");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_INPUT_REGISTER, 0, 20, regs) == 0,
+		"range served from several blocks");
+	for (i = 0; i < 20; i++) {
+		if (regs[i] != i * 3 + MODBUS_PLAN_INPUT_REGISTER)
+			ok = 0;
+	}
+	check(ok, "values from several blocks");
+
+	check(modbus_plan_configure(plan, "126", "0", "x") == -1, "invalid option values rejected");
+	check(modbus_plan_blocks(plan) == 3, "invalid option values do not change limits");
+
+	modbus_plan_free(plan);
+}
+
+static void test_bits(void)
+{
+	modbus_plan_t	*plan = modbus_plan_new(sim_reader, NULL);
+	uint8_t	bits[2];
+
+	modbus_plan_add(plan, MODBUS_PLAN_COIL, 0, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_COIL, 1, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_COIL, 5, 1);
+	modbus_plan_add(plan, MODBUS_PLAN_INPUT_BIT, 7, 2);
+	check(modbus_plan_blocks(plan) == 2, "coils merged, discrete inputs apart");
+	check(modbus_plan_refresh(plan) == 0, "bits refreshed");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_COIL, 0, 2, bits) == 0
+		&& bits[0] == 0 && bits[1] == 1, "fetch coils");
+	check(modbus_plan_fetch(plan, MODBUS_PLAN_INPUT_BIT, 7, 2, bits) == 0
+		&& bits[0] == 1 && bits[1] == 0, "fetch discrete inputs");
+
+	check(modbus_plan_add(plan, MODBUS_PLAN_COIL, -1, 1) == -1, "reject negative address");
+	check(modbus_plan_add(plan, MODBUS_PLAN_HOLDING_REGISTER, 0, 126) == -1, "reject oversized range");
+	check(modbus_plan_add(plan, MODBUS_PLAN_COIL, 0xFFFF, 2) == -1, "reject range past the address space");
+
+	modbus_plan_free(plan);
+}
+
+int main(void)
+{
+	test_merge();
+	test_hole();
+	test_recover();
+	test_missing();
+	test_split();
+	test_bits();
+
+	if (failures) {
+		fprintf(stderr, "%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -226,6 +226,10 @@ synchronous=yes
 driver=snmp-ups
 port=172.16.1.2
 synchronous=no
+[epdu-3-snmp]
+driver=snmp-ups
+port=172.16.1.3
+hosted_by=epdu-2-snmp
 [usb_3]
 driver=usbhid-ups
 port=auto
@@ -0,0 +1,1260 @@
+/*  nutbench.c - load generator and benchmark for upsd, the driver socket
+ *               protocol and the libupsclient and libnutclient libraries
+ *
+ *  Copyright (C)
+ *	2026		Jim Klimov <jimklimov+nut@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *  This program sets up a scratch area with ups.conf, upsd.conf and
+ *  upsd.users, starts a process emulating N drivers (speaking the driver
+ *  socket protocol: DUMPALL, PING, SETINFO updates), starts the upsd
+ *  binary under test against them, and then runs M client processes
+ *  which issue a configurable mix of GET VAR and LIST VAR requests via
+ *  libupsclient or (if built with C++ support) the C API of libnutclient,
+ *  with latency reported separately for each library.  Throughput, latency percentiles and (where the OS
+ *  tells) resource use of upsd are reported as a JSON document, so
+ *  results can be compared across builds.  No hardware is needed.
+ *
+ *  With -f, the failover driver under test is also started on top of all
+ *  emulated drivers (as device "benchfo" served by upsd too), and its own
+ *  resource use is reported: this measures how it copes with the stream
+ *  of updates from its upstream driver sockets.
+ *
+ *  Typically started by "make check-perf" which passes the built upsd.
+ */
+
+#include "config.h"
+
+#include "common.h"
+#include "upsclient.h"
+#include "nut_stdint.h"
+
+#ifdef NUTBENCH_WITH_NUTCLIENT
+/* The C API of libnutclient; its nutclient.h also carries C++ default
+ * arguments so it can not be included into C sources as is */
+typedef char**	strarr;
+typedef void*	NUTCLIENT_t;
+typedef NUTCLIENT_t	NUTCLIENT_TCP_t;
+void strarr_free(strarr arr);
+void nutclient_destroy(NUTCLIENT_t client);
+strarr nutclient_get_device_variables(NUTCLIENT_t client, const char* dev);
+strarr nutclient_get_device_variable_values(NUTCLIENT_t client, const char* dev, const char* var);
+NUTCLIENT_TCP_t nutclient_tcp_create_client(const char* host, uint16_t port);
+int nutclient_tcp_is_connected(NUTCLIENT_TCP_t client);
+int nutclient_tcp_reconnect(NUTCLIENT_TCP_t client);
+#endif	/* NUTBENCH_WITH_NUTCLIENT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifndef WIN32
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <sys/wait.h>
+# include <sys/stat.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <poll.h>
+# include <pwd.h>
+#endif	/* !WIN32 */
+
+#ifndef WIN32
+
+/* Benchmark settings, see help() */
+static size_t	num_drivers = 4, num_vars = 200, num_clients = 8,
+		num_requests = 2000;
+static unsigned int	list_percent = 10, update_rate = 10;
+static uint16_t	port = 0;
+static const char	*upsd_path = "../server/upsd";
+static const char	*failover_path = NULL;
+static const char	*output_fn = NULL;
+static int	keep_workdir = 0;
+
+/* Client library used by the load generating clients */
+#define BENCH_LIB_UPSCLIENT	0
+#define BENCH_LIB_NUTCLIENT	1
+#define BENCH_LIB_BOTH	2	/* every other client uses libnutclient */
+static const char	*bench_lib_names[] = { "upsclient", "nutclient", "both" };
+#ifdef NUTBENCH_WITH_NUTCLIENT
+static int	bench_lib = BENCH_LIB_BOTH;
+#else
+static int	bench_lib = BENCH_LIB_UPSCLIENT;
+#endif
+
+/* Kept short, since UNIX socket paths are limited */
+static char	workdir[64];
+static pid_t	parent_pid = -1, drivers_pid = -1, upsd_pid = -1, failover_pid = -1;
+
+/* One measured client request */
+typedef struct {
+	uint32_t	usec;
+	uint8_t	is_list;
+	uint8_t	failed;
+	uint8_t	lib;	/* BENCH_LIB_UPSCLIENT or BENCH_LIB_NUTCLIENT */
+} bench_sample_t;
+
+/* Resource usage of a process, where known (-1 if not) */
+typedef struct {
+	double	utime, stime;
+	long	syscr, syscw;
+	long	vm_rss_kb, vm_hwm_kb;
+	long	ctxt_vol, ctxt_invol;
+} bench_procstat_t;
+
+static void help(const char *arg_progname)
+{
+	printf("NUT load generator and benchmark for upsd, driver sockets, libupsclient and libnutclient.\n\n");
+	printf("usage: %s [OPTIONS]\n\n", arg_progname);
+	printf("  -u <path>	- upsd binary to test (default: %s)\n", upsd_path);
+	printf("  -f <path>	- also run this failover driver binary over all emulated drivers\n");
+	printf("  -d <num>	- number of emulated drivers (default: %" PRIuSIZE ")\n", num_drivers);
+	printf("  -v <num>	- variables per driver (default: %" PRIuSIZE ")\n", num_vars);
+	printf("  -r <num>	- SETINFO updates per second per driver (default: %u)\n", update_rate);
+	printf("  -c <num>	- number of client processes (default: %" PRIuSIZE ")\n", num_clients);
+	printf("  -n <num>	- requests issued by each client (default: %" PRIuSIZE ")\n", num_requests);
+	printf("  -l <pct>	- percentage of LIST VAR among requests, others are GET VAR (default: %u)\n", list_percent);
+	printf("  -L <lib>	- client library: upsclient, nutclient or both (default: %s)\n", bench_lib_names[bench_lib]);
+#ifndef NUTBENCH_WITH_NUTCLIENT
+	printf("		  (libnutclient was not available when this program was built)\n");
+#endif
+	printf("  -p <port>	- TCP port for upsd (default: pick a free one)\n");
+	printf("  -o <file>	- write JSON results to file (default: stdout)\n");
+	printf("  -k		- keep the scratch directory with configs and upsd log\n");
+	printf("  -D		- raise debugging level\n");
+	printf("  -h		- display this help\n");
+}
+
+static uint64_t now_usec(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(HAVE_CLOCK_MONOTONIC) && HAVE_CLOCK_GETTIME && HAVE_CLOCK_MONOTONIC
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else
+	struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+#endif
+}
+
+static size_t parse_size_arg(const char *arg, char opt)
+{
+	long	l;
+
+	if (!str_to_long(arg, &l, 10) || l < 1)
+		fatalx(EXIT_FAILURE, "Invalid value for -%c: %s", opt, arg);
+
+	return (size_t)l;
+}
+
+static void stop_children(void)
+{
+	/* Only the orchestrating process cleans up */
+	if (getpid() != parent_pid)
+		return;
+
+	if (upsd_pid > 0) {
+		kill(upsd_pid, SIGTERM);
+		waitpid(upsd_pid, NULL, 0);
+		upsd_pid = -1;
+	}
+
+	if (failover_pid > 0) {
+		kill(failover_pid, SIGTERM);
+		waitpid(failover_pid, NULL, 0);
+		failover_pid = -1;
+	}
+
+	if (drivers_pid > 0) {
+		kill(drivers_pid, SIGTERM);
+		waitpid(drivers_pid, NULL, 0);
+		drivers_pid = -1;
+	}
+}
+
+static void remove_workdir(void)
+{
+	char	fn[NUT_PATH_MAX + 64];
+	size_t	i;
+
+	if (getpid() != parent_pid || !*workdir || keep_workdir)
+		return;
+
+	for (i = 0; i < num_drivers; i++) {
+		snprintf(fn, sizeof(fn), "%s/run/dummy-ups-bench%" PRIuSIZE, workdir, i);
+		unlink(fn);
+	}
+
+	for (i = 0; i < num_clients; i++) {
+		snprintf(fn, sizeof(fn), "%s/run/client%" PRIuSIZE ".dat", workdir, i);
+		unlink(fn);
+	}
+
+	snprintf(fn, sizeof(fn), "%s/run/upsd.pid", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/run/failover-benchfo", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/run/failover-benchfo.pid", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/run", workdir);
+	rmdir(fn);
+
+	snprintf(fn, sizeof(fn), "%s/etc/ups.conf", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/etc/upsd.conf", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/etc/upsd.users", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/etc", workdir);
+	rmdir(fn);
+
+	snprintf(fn, sizeof(fn), "%s/upsd.log", workdir);
+	unlink(fn);
+	snprintf(fn, sizeof(fn), "%s/failover.log", workdir);
+	unlink(fn);
+	rmdir(workdir);
+}
+
+static void bench_cleanup(void)
+{
+	stop_children();
+	remove_workdir();
+}
+
+static void write_file(const char *name, const char *content)
+{
+	char	fn[NUT_PATH_MAX + 64];
+	FILE	*f;
+
+	snprintf(fn, sizeof(fn), "%s/etc/%s", workdir, name);
+	f = fopen(fn, "w");
+	if (!f)
+		fatal_with_errno(EXIT_FAILURE, "Can't create %s", fn);
+
+	fputs(content, f);
+	fclose(f);
+}
+
+static void setup_workdir(void)
+{
+	const char	*tmpdir = getenv("TMPDIR");
+	char	buf[LARGEBUF];
+	size_t	i;
+	FILE	*f;
+	char	fn[NUT_PATH_MAX + 64];
+
+	snprintf(workdir, sizeof(workdir), "%s/nutbench.XXXXXX",
+		(tmpdir && *tmpdir && strlen(tmpdir) < 48) ? tmpdir : "/tmp");
+	if (!mkdtemp(workdir))
+		fatal_with_errno(EXIT_FAILURE, "Can't create scratch directory");
+
+	snprintf(fn, sizeof(fn), "%s/etc", workdir);
+	if (mkdir(fn, 0700) < 0)
+		fatal_with_errno(EXIT_FAILURE, "Can't create %s", fn);
+	snprintf(fn, sizeof(fn), "%s/run", workdir);
+	if (mkdir(fn, 0700) < 0)
+		fatal_with_errno(EXIT_FAILURE, "Can't create %s", fn);
+
+	snprintf(fn, sizeof(fn), "%s/etc/ups.conf", workdir);
+	f = fopen(fn, "w");
+	if (!f)
+		fatal_with_errno(EXIT_FAILURE, "Can't create %s", fn);
+	for (i = 0; i < num_drivers; i++) {
+		fprintf(f, "[bench%" PRIuSIZE "]\n\tdriver = dummy-ups\n\tport = bench.dev\n"
+			"\tdesc = \"Emulated driver %" PRIuSIZE "\"\n", i, i);
+	}
+	if (failover_path) {
+		fprintf(f, "[benchfo]\n\tdriver = failover\n\tport = \"");
+		for (i = 0; i < num_drivers; i++) {
+			fprintf(f, "%s%s/run/dummy-ups-bench%" PRIuSIZE,
+				i ? "," : "", workdir, i);
+		}
+		fprintf(f, "\"\n\tdesc = \"Failover over all emulated drivers\"\n");
+	}
+	fclose(f);
+
+	snprintf(buf, sizeof(buf), "STATEPATH \"%s/run\"\nLISTEN 127.0.0.1 %u\nMAXCONN %" PRIuSIZE "\n",
+		workdir, (unsigned int)port, num_clients + 64);
+	write_file("upsd.conf", buf);
+
+	write_file("upsd.users", "[bench]\n\tpassword = bench\n\tupsmon primary\n");
+}
+
+/* Pick a currently free TCP port on the loopback interface */
+static uint16_t pick_port(void)
+{
+	struct sockaddr_in	sa;
+	socklen_t	salen = sizeof(sa);
+	int	fd = socket(AF_INET, SOCK_STREAM, 0);
+	uint16_t	ret;
+
+	if (fd < 0)
+		fatal_with_errno(EXIT_FAILURE, "socket");
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sa.sin_port = 0;
+
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+	 || getsockname(fd, (struct sockaddr *)&sa, &salen) < 0)
+		fatal_with_errno(EXIT_FAILURE, "Can't pick a free TCP port");
+
+	ret = ntohs(sa.sin_port);
+	close(fd);
+
+	return ret;
+}
+
+/******************************************************************
+ * Driver emulation
+ ******************************************************************/
+
+typedef struct {
+	int	fd;
+	size_t	drv;
+	size_t	buflen;
+	char	buf[SMALLBUF];
+} bench_conn_t;
+
+static int drv_send(int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t	ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		buf += ret;
+		len -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int drv_dump(int fd, size_t drv, unsigned long counter)
+{
+	char	buf[LARGEBUF];
+	size_t	i, len;
+
+	len = (size_t)snprintf(buf, sizeof(buf),
+		"SETINFO ups.status \"OL\"\n"
+		"SETINFO device.model \"Emulated driver %" PRIuSIZE "\"\n",
+		drv);
+
+	for (i = 2; i < num_vars; i++) {
+		if (len > sizeof(buf) - 128) {
+			if (drv_send(fd, buf, len) < 0)
+				return -1;
+			len = 0;
+		}
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len,
+			"SETINFO bench.value.%" PRIuSIZE " \"%lu\"\n", i, counter + i);
+	}
+
+	len += (size_t)snprintf(buf + len, sizeof(buf) - len, "DATAOK\nDUMPDONE\n");
+
+	return drv_send(fd, buf, len);
+}
+
+static void drv_close(bench_conn_t *conn)
+{
+	close(conn->fd);
+	conn->fd = -1;
+}
+
+static void drv_read(bench_conn_t *conn, unsigned long counter)
+{
+	ssize_t	ret;
+	char	*nl;
+
+	ret = read(conn->fd, conn->buf + conn->buflen, sizeof(conn->buf) - conn->buflen - 1);
+	if (ret <= 0) {
+		drv_close(conn);
+		return;
+	}
+
+	conn->buflen += (size_t)ret;
+	conn->buf[conn->buflen] = '\0';
+
+	while ((nl = strchr(conn->buf, '\n')) != NULL) {
+		*nl = '\0';
+
+		if (!strcmp(conn->buf, "DUMPALL")) {
+			if (drv_dump(conn->fd, conn->drv, counter) < 0) {
+				drv_close(conn);
+				return;
+			}
+		} else if (!strcmp(conn->buf, "PING")) {
+			if (drv_send(conn->fd, "PONG\n", 5) < 0) {
+				drv_close(conn);
+				return;
+			}
+		}
+		/* Other commands (INSTCMD, SET, LOGOUT...) are not emulated */
+
+		conn->buflen -= (size_t)(nl + 1 - conn->buf);
+		memmove(conn->buf, nl + 1, conn->buflen + 1);
+	}
+
+	/* Line too long to be a protocol command, drop it */
+	if (conn->buflen >= sizeof(conn->buf) - 1)
+		conn->buflen = 0;
+}
+
+static void drivers_run(int readyfd)
+{
+	struct pollfd	*fds;
+	bench_conn_t	*conns;
+	size_t	i, numconns = 0, maxconns = num_drivers * 4, nfds;
+	unsigned long	counter = 0;
+	uint64_t	next_update, interval;
+
+	fds = (struct pollfd *)xcalloc(num_drivers + maxconns, sizeof(*fds));
+	conns = (bench_conn_t *)xcalloc(maxconns, sizeof(*conns));
+
+	for (i = 0; i < num_drivers; i++) {
+		struct sockaddr_un	sa;
+		char	fn[SMALLBUF];
+		int	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			fatal_with_errno(EXIT_FAILURE, "socket");
+
+		snprintf(fn, sizeof(fn), "%s/run/dummy-ups-bench%" PRIuSIZE, workdir, i);
+		if (strlen(fn) >= sizeof(sa.sun_path))
+			fatalx(EXIT_FAILURE, "Socket path too long: %s", fn);
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		memcpy(sa.sun_path, fn, strlen(fn) + 1);
+
+		if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+		 || listen(fd, 16) < 0)
+			fatal_with_errno(EXIT_FAILURE, "Can't listen on %s", fn);
+
+		fds[i].fd = fd;
+		fds[i].events = POLLIN;
+	}
+
+	/* Tell the parent we are listening */
+	if (write(readyfd, "R", 1) != 1)
+		fatal_with_errno(EXIT_FAILURE, "Can't report readiness");
+	close(readyfd);
+
+	interval = update_rate ? 1000000 / update_rate : 0;
+	next_update = now_usec() + interval;
+
+	for (;;) {
+		int	timeout = -1, ret;
+		uint64_t	now;
+
+		nfds = num_drivers;
+		for (i = 0; i < numconns; i++) {
+			fds[nfds].fd = conns[i].fd;
+			fds[nfds].events = POLLIN;
+			fds[nfds].revents = 0;
+			nfds++;
+		}
+
+		if (interval) {
+			now = now_usec();
+			timeout = (next_update > now) ? (int)((next_update - now) / 1000) : 0;
+		}
+
+		ret = poll(fds, (nfds_t)nfds, timeout);
+		if (ret < 0 && errno != EINTR)
+			fatal_with_errno(EXIT_FAILURE, "poll");
+
+		for (i = 0; ret > 0 && i < num_drivers; i++) {
+			int	fd;
+
+			if (!(fds[i].revents & POLLIN))
+				continue;
+
+			fd = accept(fds[i].fd, NULL, NULL);
+			if (fd < 0)
+				continue;
+
+			if (numconns >= maxconns) {
+				close(fd);
+				continue;
+			}
+
+			conns[numconns].fd = fd;
+			conns[numconns].drv = i;
+			conns[numconns].buflen = 0;
+			numconns++;
+		}
+
+		for (i = 0; ret > 0 && i < nfds - num_drivers; i++) {
+			if (fds[num_drivers + i].revents & (POLLIN | POLLHUP | POLLERR))
+				drv_read(&conns[i], counter);
+		}
+
+		/* Compact the list of connections */
+		for (i = 0; i < numconns; ) {
+			if (conns[i].fd < 0) {
+				conns[i] = conns[--numconns];
+				continue;
+			}
+			i++;
+		}
+
+		if (interval && now_usec() >= next_update) {
+			/* Every driver pushes one changed value to its readers */
+			counter++;
+			for (i = 0; i < numconns; i++) {
+				char	buf[SMALLBUF];
+				int	len = snprintf(buf, sizeof(buf),
+					"SETINFO bench.value.%" PRIuSIZE " \"%lu\"\n",
+					2 + (size_t)counter % (num_vars - 2), counter);
+
+				if (drv_send(conns[i].fd, buf, (size_t)len) < 0)
+					drv_close(&conns[i]);
+			}
+			next_update += interval;
+		}
+	}
+}
+
+/******************************************************************
+ * Client load generation
+ ******************************************************************/
+
+static int client_connect(UPSCONN_t *conn)
+{
+	return upscli_connect(conn, "127.0.0.1", port, UPSCLI_CONN_TRYSSL);
+}
+
+static int client_get(UPSCONN_t *conn, size_t drv, size_t var)
+{
+	char	upsname[SMALLBUF], varname[SMALLBUF];
+	const char	*query[3];
+	size_t	numa;
+	char	**answer;
+
+	snprintf(upsname, sizeof(upsname), "bench%" PRIuSIZE, drv);
+	if (var == 0)
+		snprintf(varname, sizeof(varname), "ups.status");
+	else if (var == 1)
+		snprintf(varname, sizeof(varname), "device.model");
+	else
+		snprintf(varname, sizeof(varname), "bench.value.%" PRIuSIZE, var);
+
+	query[0] = "VAR";
+	query[1] = upsname;
+	query[2] = varname;
+
+	return upscli_get(conn, 3, query, &numa, &answer);
+}
+
+static int client_list(UPSCONN_t *conn, size_t drv)
+{
+	char	upsname[SMALLBUF];
+	const char	*query[2];
+	size_t	numa;
+	char	**answer;
+	int	ret;
+
+	snprintf(upsname, sizeof(upsname), "bench%" PRIuSIZE, drv);
+	query[0] = "VAR";
+	query[1] = upsname;
+
+	if (upscli_list_start(conn, 2, query) < 0)
+		return -1;
+
+	while ((ret = upscli_list_next(conn, 2, query, &numa, &answer)) == 1)
+		;
+
+	return ret;
+}
+
+/* A load generating client, using one or the other library */
+typedef struct {
+	int	lib;
+	UPSCONN_t	ups;
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	NUTCLIENT_TCP_t	nut;
+#endif
+} bench_client_t;
+
+static int bench_client_connect(bench_client_t *cl)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT) {
+		cl->nut = nutclient_tcp_create_client("127.0.0.1", port);
+		return cl->nut ? 0 : -1;
+	}
+#endif
+
+	return client_connect(&cl->ups);
+}
+
+static void bench_client_disconnect(bench_client_t *cl)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT) {
+		if (cl->nut)
+			nutclient_destroy(cl->nut);
+		cl->nut = NULL;
+		return;
+	}
+#endif
+
+	upscli_disconnect(&cl->ups);
+}
+
+static const char *bench_client_strerror(bench_client_t *cl)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT)
+		return "libnutclient connection failed";
+#endif
+
+	return upscli_strerror(&cl->ups);
+}
+
+/* Reconnect after a failed request, unless the connection is still fine */
+static void bench_client_recover(bench_client_t *cl)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT) {
+		if (!cl->nut)
+			bench_client_connect(cl);
+		else if (!nutclient_tcp_is_connected(cl->nut))
+			nutclient_tcp_reconnect(cl->nut);
+		return;
+	}
+#endif
+
+	if (upscli_upserror(&cl->ups) != UPSCLI_ERR_VARNOTSUPP) {
+		upscli_disconnect(&cl->ups);
+		client_connect(&cl->ups);
+	}
+}
+
+#ifdef NUTBENCH_WITH_NUTCLIENT
+static int nutclient_bench_get(NUTCLIENT_TCP_t nut, size_t drv, size_t var)
+{
+	char	upsname[SMALLBUF], varname[SMALLBUF];
+	strarr	values;
+
+	if (!nut)
+		return -1;
+
+	snprintf(upsname, sizeof(upsname), "bench%" PRIuSIZE, drv);
+	if (var == 0)
+		snprintf(varname, sizeof(varname), "ups.status");
+	else if (var == 1)
+		snprintf(varname, sizeof(varname), "device.model");
+	else
+		snprintf(varname, sizeof(varname), "bench.value.%" PRIuSIZE, var);
+
+	values = nutclient_get_device_variable_values(nut, upsname, varname);
+	if (!values)
+		return -1;
+
+	strarr_free(values);
+	return 0;
+}
+
+/* The C API only returns the names, but it is the same LIST VAR
+ * exchange with upsd as the one done via libupsclient */
+static int nutclient_bench_list(NUTCLIENT_TCP_t nut, size_t drv)
+{
+	char	upsname[SMALLBUF];
+	strarr	names;
+
+	if (!nut)
+		return -1;
+
+	snprintf(upsname, sizeof(upsname), "bench%" PRIuSIZE, drv);
+
+	names = nutclient_get_device_variables(nut, upsname);
+	if (!names)
+		return -1;
+
+	strarr_free(names);
+	return 0;
+}
+#endif	/* NUTBENCH_WITH_NUTCLIENT */
+
+static int bench_client_get(bench_client_t *cl, size_t drv, size_t var)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT)
+		return nutclient_bench_get(cl->nut, drv, var);
+#endif
+
+	return client_get(&cl->ups, drv, var);
+}
+
+static int bench_client_list(bench_client_t *cl, size_t drv)
+{
+#ifdef NUTBENCH_WITH_NUTCLIENT
+	if (cl->lib == BENCH_LIB_NUTCLIENT)
+		return nutclient_bench_list(cl->nut, drv);
+#endif
+
+	return client_list(&cl->ups, drv);
+}
+
+static void client_run(size_t num, int startfd)
+{
+	bench_client_t	cl;
+	bench_sample_t	*samples;
+	size_t	i;
+	char	c, fn[NUT_PATH_MAX + 64];
+	FILE	*f;
+	unsigned int	seed = (unsigned int)(getpid() ^ (num * 7919));
+
+	samples = (bench_sample_t *)xcalloc(num_requests, sizeof(*samples));
+
+	memset(&cl, 0, sizeof(cl));
+	if (bench_lib == BENCH_LIB_BOTH)
+		cl.lib = (num % 2) ? BENCH_LIB_NUTCLIENT : BENCH_LIB_UPSCLIENT;
+	else
+		cl.lib = bench_lib;
+
+	if (bench_client_connect(&cl) < 0)
+		fatalx(EXIT_FAILURE, "Client %" PRIuSIZE ": can't connect: %s", num, bench_client_strerror(&cl));
+
+	/* Wait for everyone to be connected, the parent closes the pipe */
+	while (read(startfd, &c, 1) > 0)
+		;
+	close(startfd);
+
+	for (i = 0; i < num_requests; i++) {
+		size_t	drv = (size_t)rand_r(&seed) % num_drivers;
+		int	is_list = ((unsigned int)rand_r(&seed) % 100) < list_percent;
+		uint64_t	start = now_usec();
+		int	ret;
+
+		if (is_list)
+			ret = bench_client_list(&cl, drv);
+		else
+			ret = bench_client_get(&cl, drv, (size_t)rand_r(&seed) % num_vars);
+
+		samples[i].usec = (uint32_t)(now_usec() - start);
+		samples[i].is_list = (uint8_t)is_list;
+		samples[i].failed = (ret < 0);
+		samples[i].lib = (uint8_t)cl.lib;
+
+		if (ret < 0)
+			bench_client_recover(&cl);
+	}
+
+	bench_client_disconnect(&cl);
+
+	snprintf(fn, sizeof(fn), "%s/run/client%" PRIuSIZE ".dat", workdir, num);
+	f = fopen(fn, "wb");
+	if (!f || fwrite(samples, sizeof(*samples), num_requests, f) != num_requests)
+		fatal_with_errno(EXIT_FAILURE, "Can't save samples to %s", fn);
+	fclose(f);
+	free(samples);
+}
+
+/******************************************************************
+ * Orchestration and reporting
+ ******************************************************************/
+
+static void read_procstat(pid_t pid, bench_procstat_t *st)
+{
+	char	fn[SMALLBUF], buf[LARGEBUF], *s;
+	FILE	*f;
+	long	ticks = sysconf(_SC_CLK_TCK);
+
+	st->utime = st->stime = -1;
+	st->syscr = st->syscw = st->vm_rss_kb = st->vm_hwm_kb = -1;
+	st->ctxt_vol = st->ctxt_invol = -1;
+
+	/* These are Linux-specific; elsewhere we just report unknowns */
+	snprintf(fn, sizeof(fn), "/proc/%ld/stat", (long)pid);
+	if ((f = fopen(fn, "r")) != NULL) {
+		if (fgets(buf, sizeof(buf), f) && (s = strrchr(buf, ')')) != NULL) {
+			unsigned long	ut, stt;
+
+			/* Fields after "(comm)": state, then 10 numbers
+			 * before utime (14th) and stime (15th) */
+			if (sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &ut, &stt) == 2
+			 && ticks > 0) {
+				st->utime = (double)ut / (double)ticks;
+				st->stime = (double)stt / (double)ticks;
+			}
+		}
+		fclose(f);
+	}
+
+	snprintf(fn, sizeof(fn), "/proc/%ld/io", (long)pid);
+	if ((f = fopen(fn, "r")) != NULL) {
+		while (fgets(buf, sizeof(buf), f)) {
+			sscanf(buf, "syscr: %ld", &st->syscr);
+			sscanf(buf, "syscw: %ld", &st->syscw);
+		}
+		fclose(f);
+	}
+
+	snprintf(fn, sizeof(fn), "/proc/%ld/status", (long)pid);
+	if ((f = fopen(fn, "r")) != NULL) {
+		while (fgets(buf, sizeof(buf), f)) {
+			sscanf(buf, "VmRSS: %ld", &st->vm_rss_kb);
+			sscanf(buf, "VmHWM: %ld", &st->vm_hwm_kb);
+			sscanf(buf, "voluntary_ctxt_switches: %ld", &st->ctxt_vol);
+			sscanf(buf, "nonvoluntary_ctxt_switches: %ld", &st->ctxt_invol);
+		}
+		fclose(f);
+	}
+}
+
+/* Wait for upsd to serve every emulated device, or give up */
+static void wait_upsd_ready(void)
+{
+	uint64_t	deadline = now_usec() + 30 * 1000000;
+	size_t	i = 0;
+
+	while (i < num_drivers) {
+		UPSCONN_t	conn;
+
+		if (now_usec() > deadline)
+			fatalx(EXIT_FAILURE, "upsd did not serve all emulated devices in time, see %s/upsd.log", workdir);
+
+		if (waitpid(upsd_pid, NULL, WNOHANG) == upsd_pid) {
+			upsd_pid = -1;
+			keep_workdir = 1;
+			fatalx(EXIT_FAILURE, "upsd exited prematurely, see %s/upsd.log", workdir);
+		}
+
+		if (client_connect(&conn) < 0) {
+			usleep(100000);
+			continue;
+		}
+
+		while (i < num_drivers && client_get(&conn, i, 0) >= 0)
+			i++;
+
+		upscli_disconnect(&conn);
+		if (i < num_drivers)
+			usleep(100000);
+	}
+}
+
+/* Wait for the failover driver to elect a primary and upsd to serve it */
+static void wait_failover_ready(void)
+{
+	uint64_t	deadline = now_usec() + 60 * 1000000;
+	const char	*query[3] = { "VAR", "benchfo", "driver.primary.socketname" };
+
+	for (;;) {
+		UPSCONN_t	conn;
+		size_t	numa;
+		char	**answer;
+		int	ret = -1;
+
+		if (now_usec() > deadline)
+			fatalx(EXIT_FAILURE, "failover did not elect a primary in time, see %s/failover.log", workdir);
+
+		if (waitpid(failover_pid, NULL, WNOHANG) == failover_pid) {
+			failover_pid = -1;
+			keep_workdir = 1;
+			fatalx(EXIT_FAILURE, "failover exited prematurely, see %s/failover.log", workdir);
+		}
+
+		if (client_connect(&conn) >= 0) {
+			ret = upscli_get(&conn, 3, query, &numa, &answer);
+			upscli_disconnect(&conn);
+		}
+
+		if (ret >= 0)
+			return;
+
+		usleep(200000);
+	}
+}
+
+static int cmp_samples(const void *a, const void *b)
+{
+	const bench_sample_t	*sa = (const bench_sample_t *)a, *sb = (const bench_sample_t *)b;
+
+	if (sa->is_list != sb->is_list)
+		return (int)sa->is_list - (int)sb->is_list;
+
+	return (sa->usec > sb->usec) - (sa->usec < sb->usec);
+}
+
+static int cmp_samples_lib(const void *a, const void *b)
+{
+	const bench_sample_t	*sa = (const bench_sample_t *)a, *sb = (const bench_sample_t *)b;
+
+	if (sa->lib != sb->lib)
+		return (int)sa->lib - (int)sb->lib;
+
+	return cmp_samples(a, b);
+}
+
+static void print_latency(FILE *f, const char *indent, const char *name, const bench_sample_t *s, size_t n, int last)
+{
+	fprintf(f, "%s\"%s\": { \"count\": %" PRIuSIZE, indent, name, n);
+	if (n > 0) {
+		fprintf(f, ", \"min\": %" PRIu32 ", \"p50\": %" PRIu32
+			", \"p90\": %" PRIu32 ", \"p99\": %" PRIu32 ", \"max\": %" PRIu32,
+			s[0].usec, s[(n - 1) / 2].usec, s[(n - 1) * 9 / 10].usec,
+			s[(n - 1) * 99 / 100].usec, s[n - 1].usec);
+	}
+	fprintf(f, " }%s\n", last ? "" : ",");
+}
+
+/* Samples of one library, sorted by cmp_samples() */
+static void print_library(FILE *f, const char *name, const bench_sample_t *s, size_t n, int last)
+{
+	size_t	i, nget, errors = 0;
+
+	for (i = 0; i < n; i++) {
+		if (s[i].failed)
+			errors++;
+	}
+
+	for (nget = 0; nget < n && !s[nget].is_list; nget++)
+		;
+
+	fprintf(f, "\t\t\"%s\": {\n", name);
+	fprintf(f, "\t\t\t\"requests\": %" PRIuSIZE ",\n", n);
+	fprintf(f, "\t\t\t\"errors\": %" PRIuSIZE ",\n", errors);
+	print_latency(f, "\t\t\t", "get", s, nget, 0);
+	print_latency(f, "\t\t\t", "list", s + nget, n - nget, 1);
+	fprintf(f, "\t\t}%s\n", last ? "" : ",");
+}
+
+static void print_procstat(FILE *f, const char *name, const bench_procstat_t *before, const bench_procstat_t *after, int last)
+{
+	fprintf(f, "\t\"%s\": {\n", name);
+	fprintf(f, "\t\t\"cpu_user_sec\": %.2f,\n", (after->utime >= 0 && before->utime >= 0) ? after->utime - before->utime : -1.0);
+	fprintf(f, "\t\t\"cpu_sys_sec\": %.2f,\n", (after->stime >= 0 && before->stime >= 0) ? after->stime - before->stime : -1.0);
+	fprintf(f, "\t\t\"syscalls_read\": %ld,\n", (after->syscr >= 0 && before->syscr >= 0) ? after->syscr - before->syscr : -1L);
+	fprintf(f, "\t\t\"syscalls_write\": %ld,\n", (after->syscw >= 0 && before->syscw >= 0) ? after->syscw - before->syscw : -1L);
+	fprintf(f, "\t\t\"ctxt_switches_voluntary\": %ld,\n", (after->ctxt_vol >= 0 && before->ctxt_vol >= 0) ? after->ctxt_vol - before->ctxt_vol : -1L);
+	fprintf(f, "\t\t\"ctxt_switches_involuntary\": %ld,\n", (after->ctxt_invol >= 0 && before->ctxt_invol >= 0) ? after->ctxt_invol - before->ctxt_invol : -1L);
+	fprintf(f, "\t\t\"rss_kb\": %ld,\n", after->vm_rss_kb);
+	fprintf(f, "\t\t\"rss_peak_kb\": %ld\n", after->vm_hwm_kb);
+	fprintf(f, "\t}%s\n", last ? "" : ",");
+}
+
+static void report(FILE *f, uint64_t wall_usec, const bench_procstat_t *before, const bench_procstat_t *after,
+	const bench_procstat_t *fo_before, const bench_procstat_t *fo_after)
+{
+	bench_sample_t	*all;
+	size_t	i, n = 0, nget, nups, errors = 0, total = num_clients * num_requests;
+	double	wall = (double)wall_usec / 1000000.0;
+	char	fn[NUT_PATH_MAX + 64];
+
+	all = (bench_sample_t *)xcalloc(total, sizeof(*all));
+	for (i = 0; i < num_clients; i++) {
+		FILE	*cf;
+
+		snprintf(fn, sizeof(fn), "%s/run/client%" PRIuSIZE ".dat", workdir, i);
+		if ((cf = fopen(fn, "rb")) == NULL) {
+			upslogx(LOG_WARNING, "Client %" PRIuSIZE " did not save results", i);
+			continue;
+		}
+		n += fread(all + n, sizeof(*all), num_requests, cf);
+		fclose(cf);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (all[i].failed)
+			errors++;
+	}
+
+	/* GET samples go first, then LIST ones, each sorted by latency */
+	qsort(all, n, sizeof(*all), cmp_samples);
+	for (nget = 0; nget < n && !all[nget].is_list; nget++)
+		;
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"nutbench\": 1,\n");
+	fprintf(f, "\t\"version\": \"%s\",\n", UPS_VERSION);
+	fprintf(f, "\t\"config\": { \"drivers\": %" PRIuSIZE ", \"variables\": %" PRIuSIZE
+		", \"update_rate\": %u, \"clients\": %" PRIuSIZE ", \"requests\": %" PRIuSIZE
+		", \"list_percent\": %u, \"failover\": %s, \"library\": \"%s\" },\n",
+		num_drivers, num_vars, update_rate, num_clients, num_requests, list_percent,
+		failover_path ? "true" : "false", bench_lib_names[bench_lib]);
+	fprintf(f, "\t\"requests\": %" PRIuSIZE ",\n", n);
+	fprintf(f, "\t\"errors\": %" PRIuSIZE ",\n", errors);
+	fprintf(f, "\t\"wall_sec\": %.6f,\n", wall);
+	fprintf(f, "\t\"throughput_rps\": %.1f,\n", wall > 0 ? (double)n / wall : 0.0);
+	fprintf(f, "\t\"latency_usec\": {\n");
+	print_latency(f, "\t\t", "get", all, nget, 0);
+	print_latency(f, "\t\t", "list", all + nget, n - nget, 1);
+	fprintf(f, "\t},\n");
+
+	/* The same, per client library */
+	qsort(all, n, sizeof(*all), cmp_samples_lib);
+	for (nups = 0; nups < n && all[nups].lib == BENCH_LIB_UPSCLIENT; nups++)
+		;
+	fprintf(f, "\t\"libraries\": {\n");
+	print_library(f, "upsclient", all, nups, 0);
+	print_library(f, "nutclient", all + nups, n - nups, 1);
+	fprintf(f, "\t},\n");
+	print_procstat(f, "upsd", before, after, !failover_path);
+	if (failover_path)
+		print_procstat(f, "failover", fo_before, fo_after, 1);
+	fprintf(f, "}\n");
+
+	upslogx(LOG_INFO, "%" PRIuSIZE " requests (%" PRIuSIZE " failed) in %.3f sec: %.1f req/sec",
+		n, errors, wall, wall > 0 ? (double)n / wall : 0.0);
+
+	free(all);
+}
+
+/* Start upsd, or the failover driver if a device name is given */
+static pid_t start_daemon(const char *path, const char *name, const char *devname)
+{
+	pid_t	pid;
+	char	fn[NUT_PATH_MAX + 64];
+	struct passwd	*pw = getpwuid(geteuid());
+
+	snprintf(fn, sizeof(fn), "%s/%s.log", workdir, name);
+
+	pid = fork();
+	if (pid < 0)
+		fatal_with_errno(EXIT_FAILURE, "fork");
+
+	if (pid == 0) {
+		int	fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		char	envpath[NUT_PATH_MAX + 64];
+
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+
+		snprintf(envpath, sizeof(envpath), "%s/etc", workdir);
+		setenv("NUT_CONFPATH", envpath, 1);
+		snprintf(envpath, sizeof(envpath), "%s/run", workdir);
+		setenv("NUT_STATEPATH", envpath, 1);
+		setenv("NUT_ALTPIDPATH", envpath, 1);
+		setenv("NUT_PIDPATH", envpath, 1);
+
+		/* Do not drop privileges to a built-in RUN_AS_USER account */
+		if (devname && pw)
+			execl(path, name, "-a", devname, "-F", "-u", pw->pw_name, (char *)NULL);
+		else if (devname)
+			execl(path, name, "-a", devname, "-F", (char *)NULL);
+		else if (pw)
+			execl(path, name, "-F", "-u", pw->pw_name, (char *)NULL);
+		else
+			execl(path, name, "-F", (char *)NULL);
+
+		fatal_with_errno(EXIT_FAILURE, "Can't run %s", path);
+	}
+
+	return pid;
+}
+
+int main(int argc, char **argv)
+{
+	int	i, readypipe[2], startpipe[2];
+	char	c;
+	pid_t	*clients;
+	size_t	n;
+	uint64_t	start, wall;
+	bench_procstat_t	before, after, fo_before, fo_after;
+	FILE	*out = stdout;
+	const char	*prog = xbasename(argv[0]);
+
+	while ((i = getopt(argc, argv, "+hu:f:d:v:r:c:n:l:L:p:o:kD")) != -1) {
+		switch (i) {
+			case 'u':
+				upsd_path = optarg;
+				break;
+			case 'f':
+				failover_path = optarg;
+				break;
+			case 'd':
+				num_drivers = parse_size_arg(optarg, 'd');
+				break;
+			case 'v':
+				num_vars = parse_size_arg(optarg, 'v');
+				break;
+			case 'r':
+				if (!str_to_uint(optarg, &update_rate, 10))
+					fatalx(EXIT_FAILURE, "Invalid value for -r: %s", optarg);
+				break;
+			case 'c':
+				num_clients = parse_size_arg(optarg, 'c');
+				break;
+			case 'n':
+				num_requests = parse_size_arg(optarg, 'n');
+				break;
+			case 'l':
+				if (!str_to_uint(optarg, &list_percent, 10) || list_percent > 100)
+					fatalx(EXIT_FAILURE, "Invalid value for -l: %s", optarg);
+				break;
+			case 'L':
+				if (!strcmp(optarg, "upsclient"))
+					bench_lib = BENCH_LIB_UPSCLIENT;
+				else if (!strcmp(optarg, "nutclient"))
+					bench_lib = BENCH_LIB_NUTCLIENT;
+				else if (!strcmp(optarg, "both"))
+					bench_lib = BENCH_LIB_BOTH;
+				else
+					fatalx(EXIT_FAILURE, "Invalid value for -L: %s", optarg);
+#ifndef NUTBENCH_WITH_NUTCLIENT
+				if (bench_lib != BENCH_LIB_UPSCLIENT)
+					fatalx(EXIT_FAILURE, "This nutbench was built without libnutclient");
+#endif
+				break;
+			case 'p':
+				{
+					unsigned int	p;
+					if (!str_to_uint(optarg, &p, 10) || p < 1 || p > 65535)
+						fatalx(EXIT_FAILURE, "Invalid value for -p: %s", optarg);
+					port = (uint16_t)p;
+				}
+				break;
+			case 'o':
+				output_fn = optarg;
+				break;
+			case 'k':
+				keep_workdir = 1;
+				break;
+			case 'D':
+				nut_debug_level++;
+				break;
+			case 'h':
+			default:
+				help(prog);
+				exit((i == 'h') ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	/* ups.status, device.model and at least one changing value */
+	if (num_vars < 3)
+		num_vars = 3;
+
+	if (access(upsd_path, X_OK) < 0)
+		fatal_with_errno(EXIT_FAILURE, "Can't use upsd binary %s", upsd_path);
+
+	if (failover_path && access(failover_path, X_OK) < 0)
+		fatal_with_errno(EXIT_FAILURE, "Can't use failover binary %s", failover_path);
+
+	if (!port)
+		port = pick_port();
+
+	parent_pid = getpid();
+	signal(SIGPIPE, SIG_IGN);
+	setup_workdir();
+	atexit(bench_cleanup);
+
+	upslogx(LOG_INFO, "Benchmarking %s with %" PRIuSIZE " drivers x %" PRIuSIZE
+		" variables, %" PRIuSIZE " clients x %" PRIuSIZE " requests (%u%% LIST VAR) via %s, scratch area %s",
+		upsd_path, num_drivers, num_vars, num_clients, num_requests, list_percent,
+		bench_lib_names[bench_lib], workdir);
+
+	/* Emulated drivers must listen before upsd starts */
+	if (pipe(readypipe) < 0)
+		fatal_with_errno(EXIT_FAILURE, "pipe");
+	drivers_pid = fork();
+	if (drivers_pid < 0)
+		fatal_with_errno(EXIT_FAILURE, "fork");
+	if (drivers_pid == 0) {
+		close(readypipe[0]);
+		drivers_run(readypipe[1]);
+		exit(EXIT_SUCCESS);
+	}
+	close(readypipe[1]);
+	if (read(readypipe[0], &c, 1) != 1)
+		fatalx(EXIT_FAILURE, "Driver emulation failed to start");
+	close(readypipe[0]);
+
+	if (failover_path)
+		failover_pid = start_daemon(failover_path, "failover", "benchfo");
+
+	upsd_pid = start_daemon(upsd_path, "upsd", NULL);
+	wait_upsd_ready();
+
+	if (failover_path)
+		wait_failover_ready();
+
+	/* Start clients, let them connect, then release them all at once */
+	if (pipe(startpipe) < 0)
+		fatal_with_errno(EXIT_FAILURE, "pipe");
+
+	clients = (pid_t *)xcalloc(num_clients, sizeof(*clients));
+	for (n = 0; n < num_clients; n++) {
+		clients[n] = fork();
+		if (clients[n] < 0)
+			fatal_with_errno(EXIT_FAILURE, "fork");
+		if (clients[n] == 0) {
+			close(startpipe[1]);
+			client_run(n, startpipe[0]);
+			exit(EXIT_SUCCESS);
+		}
+	}
+	close(startpipe[0]);
+
+	/* Give the clients a moment to connect before the gun */
+	usleep(200000);
+	read_procstat(upsd_pid, &before);
+	read_procstat(failover_pid, &fo_before);
+	start = now_usec();
+	close(startpipe[1]);
+
+	for (n = 0; n < num_clients; n++) {
+		int	status;
+
+		if (waitpid(clients[n], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+			upslogx(LOG_WARNING, "Client %" PRIuSIZE " failed", n);
+	}
+	wall = now_usec() - start;
+	read_procstat(upsd_pid, &after);
+	read_procstat(failover_pid, &fo_after);
+	free(clients);
+
+	if (output_fn && (out = fopen(output_fn, "w")) == NULL)
+		fatal_with_errno(EXIT_FAILURE, "Can't write %s", output_fn);
+
+	report(out, wall, &before, &after, &fo_before, &fo_after);
+
+	if (out != stdout)
+		fclose(out);
+
+	/* atexit() handler stops upsd and driver emulation */
+	return EXIT_SUCCESS;
+}
+
+#else	/* WIN32 */
+
+int main(int argc, char **argv)
+{
+	NUT_UNUSED_VARIABLE(argc);
+	NUT_UNUSED_VARIABLE(argv);
+
+	printf("SKIP: nutbench is not implemented for WIN32 builds\n");
+	return EXIT_SUCCESS;
+}
+
+#endif	/* WIN32 */
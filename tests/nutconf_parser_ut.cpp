@@ -85,6 +85,7 @@ class NutConfTest : public CppUnit::TestFixture
 		CPPUNIT_TEST( testParseBoolIntStrict );
 		CPPUNIT_TEST( testParseToken );
 		CPPUNIT_TEST( testParseTokenWithoutColon );
+		CPPUNIT_TEST( testParseLine );
 		CPPUNIT_TEST( testGenericConfigParser );
 		CPPUNIT_TEST( testUpsmonConfigParser );
 		CPPUNIT_TEST( testNutConfConfigParser );
@@ -102,6 +103,7 @@ public:
 	void testParseBoolIntStrict();
 	void testParseToken();
 	void testParseTokenWithoutColon();
+	void testParseLine();
 
 	void testGenericConfigParser();
 	void testUpsmonConfigParser();
@@ -590,6 +592,36 @@ void NutConfTest::testParseTokenWithoutColon()
 
 }
 
+void NutConfTest::testParseLine()
+{
+	static const char* src =
+		"[ups1] # first\n"
+		"\tdriver = usbhid-ups\n"
+		"\n"
+		"desc = \"A \\\"quoted\\\" value\"";
+	NutParser parse{std::string(src)};
+	std::vector<NutParser::Token> tokens;
+
+	CPPUNIT_ASSERT_MESSAGE("Cannot parse 1st line", parse.parseLine(tokens));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("Bad token count on 1st line", static_cast<size_t>(4), tokens.size());
+	CPPUNIT_ASSERT_MESSAGE("Cannot find section name 'ups1'", tokens[1] == NutParser::Token(NutParser::Token::TOKEN_STRING, "ups1"));
+	CPPUNIT_ASSERT_MESSAGE("Cannot find comment ' first'", tokens[3] == NutParser::Token(NutParser::Token::TOKEN_COMMENT, " first"));
+
+	CPPUNIT_ASSERT_MESSAGE("Cannot parse 2nd line", parse.parseLine(tokens));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("Bad token count on 2nd line", static_cast<size_t>(3), tokens.size());
+	CPPUNIT_ASSERT_MESSAGE("Cannot find value 'usbhid-ups'", tokens[2] == NutParser::Token(NutParser::Token::TOKEN_STRING, "usbhid-ups"));
+
+	CPPUNIT_ASSERT_MESSAGE("Cannot parse empty 3rd line", parse.parseLine(tokens));
+	CPPUNIT_ASSERT_MESSAGE("Empty line has tokens", tokens.empty());
+
+	CPPUNIT_ASSERT_MESSAGE("Cannot parse last line", parse.parseLine(tokens));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("Bad token count on last line", static_cast<size_t>(3), tokens.size());
+	CPPUNIT_ASSERT_MESSAGE("Cannot find quoted value", tokens[2] == NutParser::Token(NutParser::Token::TOKEN_QUOTED_STRING, "A \"quoted\" value"));
+
+	CPPUNIT_ASSERT_MESSAGE("Parsed a line past the end", !parse.parseLine(tokens));
+	CPPUNIT_ASSERT_MESSAGE("Tokens found past the end", tokens.empty());
+}
+
 void NutConfTest::testGenericConfigParser()
 {
 	static const char* src =
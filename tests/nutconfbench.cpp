@@ -0,0 +1,209 @@
+/*
+    nutconfbench.cpp - benchmark for libnutconf streams and parser
+
+    Copyright (C)
+        2026	Jim Klimov <jimklimov+nut@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+    This program generates a large ups.conf (many sections with several
+    settings and comments each), then measures how long libnutconf takes
+    to read it from a file, to tokenise it, to load it into an
+    UpsConfiguration and to write that back into a file. Results are
+    printed as a JSON document, so they can be compared across builds.
+
+    Typically started by "make check-perf".
+*/
+
+#include "config.h"
+
+#include "nutconf.hpp"
+#include "nutstream.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <unistd.h>
+
+using nut::NutFile;
+using nut::NutParser;
+using nut::NutStream;
+
+static double elapsed_ms(const std::chrono::steady_clock::time_point & since)
+{
+	std::chrono::duration<double, std::milli> d =
+		std::chrono::steady_clock::now() - since;
+
+	return d.count();
+}
+
+/* One section per emulated device, in the style of real-life configs */
+static std::string generate(size_t sections)
+{
+	std::stringstream	ss;
+
+	ss << "# Generated by nutconfbench\n";
+	ss << "maxretry = 3\n";
+	ss << "pollinterval = 2\n\n";
+
+	for (size_t i = 0; i < sections; i++) {
+		ss << "# Device " << i << " in rack " << (i / 40) << "\n";
+		ss << "[ups" << i << "]\n";
+		ss << "\tdriver = " << ((i % 3) ? "usbhid-ups" : "snmp-ups") << "\n";
+		ss << "\tport = " << ((i % 3) ? "auto" : "10.0.0.1") << "\n";
+		ss << "\tdesc = \"UPS number " << i << " in \\\"room\\\" B\"\n";
+		ss << "\tpollinterval = " << (i % 10 + 1) << "\n";
+		ss << "\tserial = SN" << (1000000 + i) << "\t# from the label\n";
+		ss << "\toverride.battery.charge.low = 25\n";
+		if (i % 2)
+			ss << "\tnolock\n";
+		ss << "\n";
+	}
+
+	return ss.str();
+}
+
+int main(int argc, char *argv[])
+{
+	size_t	sections = 10000, rounds = 3, tokens = 0;
+	double	t_write = 0, t_read = 0, t_tokens = 0, t_load = 0, t_save = 0;
+	int	opt;
+
+	while ((opt = getopt(argc, argv, "s:r:h")) != -1) {
+		switch (opt) {
+			case 's':
+				sections = static_cast<size_t>(strtoul(optarg, nullptr, 10));
+				break;
+			case 'r':
+				rounds = static_cast<size_t>(strtoul(optarg, nullptr, 10));
+				break;
+			case 'h':
+			default:
+				printf("Benchmark for libnutconf streams and parser.\n\n");
+				printf("usage: %s [-s <sections>] [-r <rounds>]\n", argv[0]);
+				return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (sections < 1 || rounds < 1) {
+		fprintf(stderr, "Invalid arguments, see -h\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string	conf = generate(sections);
+	std::string	path_in = NutFile::tmp_dir() + "/nutconfbench-in.conf";
+	std::string	path_out = NutFile::tmp_dir() + "/nutconfbench-out.conf";
+
+	for (size_t r = 0; r < rounds; r++) {
+		std::chrono::steady_clock::time_point	start;
+
+		/* Write the generated file */
+		start = std::chrono::steady_clock::now();
+		{
+			NutFile	file(path_in);
+
+			file.openx(NutFile::WRITE_ONLY);
+			if (NutStream::NUTS_OK != file.putData(conf)) {
+				fprintf(stderr, "Failed to write %s\n", path_in.c_str());
+				return EXIT_FAILURE;
+			}
+			file.closex();
+		}
+		t_write += elapsed_ms(start);
+
+		/* Read it back as a whole */
+		std::string	data;
+
+		start = std::chrono::steady_clock::now();
+		{
+			NutFile	file(path_in);
+
+			file.openx(NutFile::READ_ONLY);
+			if (NutStream::NUTS_OK != file.getString(data) || data != conf) {
+				fprintf(stderr, "Failed to read %s\n", path_in.c_str());
+				return EXIT_FAILURE;
+			}
+		}
+		t_read += elapsed_ms(start);
+
+		/* Tokenise the buffer, a line at a time */
+		start = std::chrono::steady_clock::now();
+		{
+			NutParser	parser(std::move(data));
+			std::vector<NutParser::Token>	line;
+
+			tokens = 0;
+			while (parser.parseLine(line))
+				tokens += line.size();
+		}
+		t_tokens += elapsed_ms(start);
+
+		/* Load the file into a configuration */
+		nut::UpsConfiguration	config;
+
+		start = std::chrono::steady_clock::now();
+		{
+			NutFile	file(path_in);
+
+			file.openx(NutFile::READ_ONLY);
+			if (!config.parseFrom(file)) {
+				fprintf(stderr, "Failed to parse %s\n", path_in.c_str());
+				return EXIT_FAILURE;
+			}
+		}
+		t_load += elapsed_ms(start);
+
+		if (config.sections.size() != sections + 1) {
+			fprintf(stderr, "Loaded %zu sections instead of %zu\n",
+				config.sections.size(), sections + 1);
+			return EXIT_FAILURE;
+		}
+
+		/* And save it elsewhere */
+		start = std::chrono::steady_clock::now();
+		{
+			NutFile	file(path_out);
+
+			file.openx(NutFile::WRITE_ONLY);
+			if (!config.writeTo(file)) {
+				fprintf(stderr, "Failed to write %s\n", path_out.c_str());
+				return EXIT_FAILURE;
+			}
+			file.closex();
+		}
+		t_save += elapsed_ms(start);
+	}
+
+	::unlink(path_in.c_str());
+	::unlink(path_out.c_str());
+
+	printf("{\n");
+	printf("  \"sections\": %zu,\n", sections);
+	printf("  \"bytes\": %zu,\n", conf.size());
+	printf("  \"tokens\": %zu,\n", tokens);
+	printf("  \"rounds\": %zu,\n", rounds);
+	printf("  \"ms_write\": %.3f,\n", t_write / static_cast<double>(rounds));
+	printf("  \"ms_read\": %.3f,\n", t_read / static_cast<double>(rounds));
+	printf("  \"ms_tokenise\": %.3f,\n", t_tokens / static_cast<double>(rounds));
+	printf("  \"ms_load\": %.3f,\n", t_load / static_cast<double>(rounds));
+	printf("  \"ms_save\": %.3f\n", t_save / static_cast<double>(rounds));
+	printf("}\n");
+
+	return EXIT_SUCCESS;
+}
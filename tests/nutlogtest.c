@@ -23,6 +23,53 @@
 #include "config.h"
 #include "common.h"
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+
+/* Private in common.c, tweaked to log like a backgrounded daemon */
+extern int	upslog_flags;
+
+/* Lines which would have gone to syslog, captured by sink_capture() */
+#define SINK_LINES	1024
+static char	*sink_lines[SINK_LINES];
+static size_t	sink_count = 0;
+/* While set, sink_capture() waits, like a stalled syslog would */
+static int	sink_stalled = 0;
+static pthread_mutex_t	sink_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	sink_cond = PTHREAD_COND_INITIALIZER;
+
+static void sink_capture(int priority, const char *msg)
+{
+	NUT_UNUSED_VARIABLE(priority);
+
+	pthread_mutex_lock(&sink_lock);
+	while (sink_stalled)
+		pthread_cond_wait(&sink_cond, &sink_lock);
+	if (sink_count < SINK_LINES)
+		sink_lines[sink_count++] = xstrdup(msg);
+	pthread_mutex_unlock(&sink_lock);
+}
+
+static void sink_reset(void)
+{
+	size_t	i;
+
+	for (i = 0; i < sink_count; i++)
+		free(sink_lines[i]);
+	sink_count = 0;
+}
+
+static void *log_flood(void *arg)
+{
+	int	i;
+
+	for (i = 0; i < 100; i++)
+		upslogx(LOG_NOTICE, "nutlogtest: thread %d notice %d", *(int *)arg, i);
+
+	return NULL;
+}
+#endif	/* HAVE_PTHREAD */
+
 int main(void) {
 	const char *s1 = "!NULL";
 	const char *s2 = NULL;
@@ -192,5 +239,93 @@ int main(void) {
 		}
 	}
 
+#ifdef HAVE_PTHREAD
+	if (1) {	/* scoping */
+		/* Deferred logging from several threads at once: the ring
+		 * must survive it, and notices must never be dropped */
+		pthread_t	threads[4];
+		int	ids[4], next[4], i, t, n, saved_flags = upslog_flags, bad = 0;
+		size_t	j, overflows = 0;
+		uintmax_t	dropped;
+		const char	*s;
+
+		upslog_set_sink(sink_capture);
+		upslog_async_enable(4);
+		upslog_flags = UPSLOG_SYSLOG;
+
+		for (i = 0; i < 4; i++) {
+			ids[i] = i;
+			next[i] = 0;
+			pthread_create(&threads[i], NULL, log_flood, &ids[i]);
+		}
+		for (i = 0; i < 4; i++)
+			pthread_join(threads[i], NULL);
+
+		upslog_async_flush();
+		upslog_flags = saved_flags;
+		dropped = upslog_async_dropped();
+
+		/* All of them, and in the order each thread logged them */
+		for (j = 0; j < sink_count; j++) {
+			if (!(s = strstr(sink_lines[j], "nutlogtest: thread "))
+			|| sscanf(s, "nutlogtest: thread %d notice %d", &t, &n) != 2
+			|| t < 0 || t > 3 || n != next[t]
+			) {
+				upsdebugx(0, "E: upslog_async delivered an unexpected line: '%s'", sink_lines[j]);
+				bad++;
+				continue;
+			}
+			next[t]++;
+		}
+
+		if (dropped != 0 || bad || sink_count != 400) {
+			upsdebugx(0, "E: upslog_async delivered %" PRIuSIZE " of 400 notices from 4 threads, "
+				"dropped %" PRIuMAX, sink_count, dropped);
+			ret++;
+		} else {
+			upsdebugx(0, "D: upslog_async delivered notices from 4 threads without drops, in order");
+		}
+		sink_reset();
+
+		/* Informational noise is dropped while the writer is stuck,
+		 * then the drops are reported, and flushing waits for that */
+		pthread_mutex_lock(&sink_lock);
+		sink_stalled = 1;
+		pthread_mutex_unlock(&sink_lock);
+
+		upslog_flags = UPSLOG_SYSLOG;
+		for (i = 0; i < 20; i++)
+			upslogx(LOG_INFO, "nutlogtest: info %d", i);
+
+		pthread_mutex_lock(&sink_lock);
+		sink_stalled = 0;
+		pthread_cond_broadcast(&sink_cond);
+		pthread_mutex_unlock(&sink_lock);
+
+		upslog_async_flush();
+		upslog_flags = saved_flags;
+		dropped = upslog_async_dropped() - dropped;
+
+		for (j = 0; j < sink_count; j++) {
+			if (strstr(sink_lines[j], "Log buffer overflow: "))
+				overflows++;
+		}
+
+		if (dropped == 0 || overflows != 1 || sink_count + dropped != 21) {
+			upsdebugx(0, "E: upslog_async delivered %" PRIuSIZE " lines (%" PRIuSIZE
+				" overflow reports) and dropped %" PRIuMAX " of 20 informational messages",
+				sink_count, overflows, dropped);
+			ret++;
+		} else {
+			upsdebugx(0, "D: upslog_async dropped %" PRIuMAX " of 20 informational messages "
+				"and reported that before the flush returned", dropped);
+		}
+		sink_reset();
+
+		upslog_async_enable(0);
+		upslog_set_sink(NULL);
+	}
+#endif	/* HAVE_PTHREAD */
+
 	return ret;
 }
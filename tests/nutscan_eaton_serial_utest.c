@@ -0,0 +1,376 @@
+/*  nutscan_eaton_serial_utest.c - test the nut-scanner Eaton serial probes
+ *  against simulated devices on pseudo-terminals
+ *
+ *  Copyright (C) 2026 Network UPS Tools contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *  A child process plays one device per pseudo-terminal: a SHUT device
+ *  echoing the SYNC token, an XCP device which only answers at 9600 bauds
+ *  (when the pty reports its line speed), a Q1 device, and a silent port.
+ *  The protocols found are cached in a state file under a temporary
+ *  NUT_STATEPATH, which the re-scan should use.
+ *  Typically started by "make check".
+ */
+
+#include "config.h"
+#include "nut-scan.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+/* Skipped test, for automake */
+#define EXIT_SKIP 77
+
+typedef enum {
+	SIM_SHUT = 0,
+	SIM_XCP,
+	SIM_Q1,
+	SIM_SILENT,
+	SIM_NUM
+} sim_kind_t;
+
+typedef struct {
+	int	master, slave;
+	char	name[64];
+	unsigned char	buf[64];
+	size_t	len;
+} sim_port_t;
+
+static sim_port_t	ports[SIM_NUM];
+static int failures = 0;
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		printf("FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static long elapsed_ms(const struct timeval *since)
+{
+	struct timeval	now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - since->tv_sec) * 1000L
+		+ (now.tv_usec - since->tv_usec) / 1000L;
+}
+
+static int sim_open(sim_port_t *port)
+{
+	const char	*name;
+
+	port->master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (port->master < 0)
+		return -1;
+
+	if (grantpt(port->master) != 0 || unlockpt(port->master) != 0
+	|| (name = ptsname(port->master)) == NULL
+	) {
+		close(port->master);
+		return -1;
+	}
+
+	snprintf(port->name, sizeof(port->name), "%s", name);
+
+	/* Kept open by the simulator, so the master never sees a hang-up */
+	port->slave = open(port->name, O_RDWR | O_NOCTTY);
+	if (port->slave < 0) {
+		close(port->master);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Where the pty can tell, only answer XCP at 9600 bauds */
+static int sim_xcp_speed_ok(const sim_port_t *port)
+{
+	struct termios	tio;
+
+	if (tcgetattr(port->master, &tio) != 0 || cfgetispeed(&tio) == B0)
+		return 1;
+
+	return (cfgetispeed(&tio) == B9600);
+}
+
+static int sim_find(const sim_port_t *port, const void *what, size_t len)
+{
+	size_t	i;
+
+	for (i = 0; i + len <= port->len; i++) {
+		if (!memcmp(port->buf + i, what, len))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void sim_reply(sim_port_t *port, sim_kind_t kind)
+{
+	static const unsigned char	xcp_req[] = { 0xAB, 0x01, 0xA0 };
+	static const unsigned char	xcp_reply[] = { 0xAB, 0x01, 0xA0, 0x00, 0x00 };
+	static const char	q1_reply[] = "(226.0 195.0 226.0 014 49.0 27.5 30.0 00001000\r";
+	unsigned char	sync = 0x16;
+	ssize_t	ret = 0;
+
+	switch (kind) {
+		case SIM_SHUT:
+			if (memchr(port->buf, sync, port->len)) {
+				ret = write(port->master, &sync, 1);
+				port->len = 0;
+			}
+			break;
+
+		case SIM_XCP:
+			if (sim_find(port, xcp_req, sizeof(xcp_req))) {
+				if (sim_xcp_speed_ok(port))
+					ret = write(port->master, xcp_reply, sizeof(xcp_reply));
+				port->len = 0;
+			}
+			break;
+
+		case SIM_Q1:
+			if (sim_find(port, "Q1\r", 3)) {
+				ret = write(port->master, q1_reply, strlen(q1_reply));
+				port->len = 0;
+			}
+			break;
+
+		case SIM_SILENT:
+		case SIM_NUM:
+		default:
+			port->len = 0;
+			break;
+	}
+
+	if (ret < 0)
+		perror("simulator write");
+}
+
+static void sim_run(void)
+{
+	struct pollfd	fds[SIM_NUM];
+	size_t	i;
+
+	for (;;) {
+		for (i = 0; i < SIM_NUM; i++) {
+			fds[i].fd = ports[i].master;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+
+		if (poll(fds, SIM_NUM, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			_exit(EXIT_FAILURE);
+		}
+
+		for (i = 0; i < SIM_NUM; i++) {
+			sim_port_t	*port = &ports[i];
+			ssize_t	ret;
+
+			if (!(fds[i].revents & POLLIN))
+				continue;
+
+			/* keep the most recent bytes */
+			if (port->len == sizeof(port->buf)) {
+				memmove(port->buf, port->buf + sizeof(port->buf) / 2, sizeof(port->buf) / 2);
+				port->len = sizeof(port->buf) / 2;
+			}
+
+			ret = read(port->master, port->buf + port->len, sizeof(port->buf) - port->len);
+			if (ret <= 0)
+				continue;
+
+			port->len += (size_t)ret;
+			sim_reply(port, (sim_kind_t)i);
+		}
+	}
+}
+
+static const char *find_driver(nutscan_device_t *devs, const char *port)
+{
+	nutscan_device_t	*dev;
+
+	for (dev = devs; dev != NULL; dev = dev->next) {
+		if (dev->port && !strcmp(dev->port, port))
+			return dev->driver;
+	}
+
+	return NULL;
+}
+
+static size_t count_devices(nutscan_device_t *devs)
+{
+	size_t	count = 0;
+
+	for (; devs != NULL; devs = devs->next)
+		count++;
+
+	return count;
+}
+
+/* Does the cache state file have this line? */
+static int cache_has(const char *fn, const char *port, const char *entry)
+{
+	char	line[256], want[256];
+	FILE	*f;
+	int	found = 0;
+
+	snprintf(want, sizeof(want), "%s %s\n", port, entry);
+	f = fopen(fn, "r");
+	if (f == NULL)
+		return 0;
+	while (!found && fgets(line, sizeof(line), f) != NULL)
+		found = !strcmp(line, want);
+	fclose(f);
+
+	return found;
+}
+
+int main(void)
+{
+	nutscan_device_t	*devs;
+	struct timeval	start;
+	char	list[4 * sizeof(ports[0].name)];
+	char	statedir[] = "/tmp/nut-scan-XXXXXX", cachefile[sizeof(statedir) + 64];
+	char	otherfile[sizeof(statedir) + 64];
+	const char	*driver;
+	struct stat	st;
+	FILE	*f;
+	long	ms;
+	pid_t	pid;
+	size_t	i;
+
+	for (i = 0; i < SIM_NUM; i++) {
+		if (sim_open(&ports[i]) != 0) {
+			printf("SKIP: can not create pseudo-terminals: %s\n", strerror(errno));
+			return EXIT_SKIP;
+		}
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return EXIT_FAILURE;
+	}
+	if (pid == 0) {
+		sim_run();
+		_exit(EXIT_SUCCESS);
+	}
+
+	for (i = 0; i < SIM_NUM; i++)
+		close(ports[i].slave);
+
+	if (mkdtemp(statedir) == NULL) {
+		perror("mkdtemp");
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		return EXIT_FAILURE;
+	}
+	setenv("NUT_STATEPATH", statedir, 1);
+	snprintf(cachefile, sizeof(cachefile), "%s/nut-scanner-eaton-serial.cache", statedir);
+
+	printf("=== all protocols at once:\n");
+	snprintf(list, sizeof(list), "%s,%s,%s,%s",
+		ports[SIM_SHUT].name, ports[SIM_XCP].name,
+		ports[SIM_Q1].name, ports[SIM_SILENT].name);
+
+	gettimeofday(&start, NULL);
+	devs = nutscan_scan_eaton_serial(list);
+	ms = elapsed_ms(&start);
+	printf("scanned %d ports in %ld ms\n", SIM_NUM, ms);
+
+	check(count_devices(devs) == 3, "three devices found");
+	driver = find_driver(devs, ports[SIM_SHUT].name);
+	check(driver && !strcmp(driver, "mge-shut"), "SHUT device");
+	driver = find_driver(devs, ports[SIM_XCP].name);
+	check(driver && !strcmp(driver, "bcmxcp"), "XCP device");
+	driver = find_driver(devs, ports[SIM_Q1].name);
+	check(driver && !strcmp(driver, "blazer_ser"), "Q1 device");
+	check(find_driver(devs, ports[SIM_SILENT].name) == NULL, "nothing on the silent port");
+	/* probing a silent port takes about 17 s */
+	check(ms < 30000, "all ports are probed at once");
+	nutscan_free_device(devs);
+
+	check(cache_has(cachefile, ports[SIM_XCP].name, "bcmxcp 9600")
+		&& cache_has(cachefile, ports[SIM_Q1].name, "blazer_ser 2400"),
+		"protocols found are kept in the state file");
+
+	printf("=== re-scan with known protocols:\n");
+	snprintf(list, sizeof(list), "%s,%s", ports[SIM_XCP].name, ports[SIM_Q1].name);
+
+	gettimeofday(&start, NULL);
+	devs = nutscan_scan_eaton_serial(list);
+	ms = elapsed_ms(&start);
+	printf("scanned 2 ports in %ld ms\n", ms);
+
+	check(count_devices(devs) == 2, "both devices found again");
+	driver = find_driver(devs, ports[SIM_XCP].name);
+	check(driver && !strcmp(driver, "bcmxcp"), "XCP device again");
+	driver = find_driver(devs, ports[SIM_Q1].name);
+	check(driver && !strcmp(driver, "blazer_ser"), "Q1 device again");
+	check(ms < 3000, "known protocols are tried first");
+	nutscan_free_device(devs);
+
+	printf("=== state file replaced by a symlink:\n");
+	snprintf(otherfile, sizeof(otherfile), "%s/other", statedir);
+	f = fopen(otherfile, "w");
+	if (f) {
+		fputs("not a cache\n", f);
+		fclose(f);
+	}
+	unlink(cachefile);
+	if (symlink(otherfile, cachefile) != 0)
+		perror("symlink");
+
+	devs = nutscan_scan_eaton_serial(ports[SIM_XCP].name);
+	check(count_devices(devs) == 1, "XCP device found without the cache");
+	nutscan_free_device(devs);
+
+	check(cache_has(otherfile, "not", "a cache"),
+		"the file the symlink points to is left alone");
+	check(lstat(cachefile, &st) == 0 && S_ISREG(st.st_mode)
+		&& cache_has(cachefile, ports[SIM_XCP].name, "bcmxcp 9600"),
+		"a new state file replaces the symlink");
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	unlink(cachefile);
+	unlink(otherfile);
+	check(rmdir(statedir) == 0, "no temporary files are left behind");
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
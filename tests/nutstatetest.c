@@ -0,0 +1,225 @@
+/*  nutstatetest.c - test the common state tree and its interned names
+ *
+ *  Copyright (C) 2026 Network UPS Tools contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+#include "common.h"
+#include "state.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		printf("FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static void test_intern(void)
+{
+	const char	*a, *b;
+	char	buf[SMALLBUF];
+
+	printf("=== %s:\n", __func__);
+
+	a = state_intern("ups.status");
+	snprintf(buf, sizeof(buf), "%s", "UPS.Status");
+	b = state_intern(buf);
+
+	check(a != NULL && !strcmp(a, "ups.status"), "interned copy of a name");
+	check(a == b, "same entry regardless of case");
+	check(!strcmp(b, "ups.status"), "first spelling is kept");
+	check(state_intern_find("Ups.STATUS") == a, "find an interned name");
+	check(state_intern_find("no.such.name") == NULL, "names never interned are not found");
+	check(state_intern_hash(a) == state_intern_hash(state_intern("UPS.STATUS")),
+		"hash does not depend on case");
+}
+
+/* in-order walk, checking that names are sorted like strcasecmp() does */
+static size_t tree_walk(const st_tree_t *node, const char **prev, int *sorted)
+{
+	size_t	count;
+
+	if (!node)
+		return 0;
+
+	count = tree_walk(node->left, prev, sorted);
+
+	if (*prev && strcasecmp(*prev, node->var) >= 0)
+		*sorted = 0;
+	*prev = node->var;
+
+	return count + 1 + tree_walk(node->right, prev, sorted);
+}
+
+static void test_tree(void)
+{
+	st_tree_t	*root = NULL;
+	const char	*prev = NULL;
+	char	var[SMALLBUF];
+	size_t	i, count, before;
+	int	sorted = 1;
+
+	printf("=== %s:\n", __func__);
+
+	/* outlets in an order which is not sorted, with mixed case */
+	for (i = 0; i < 200; i++) {
+		snprintf(var, sizeof(var), "%s.%" PRIuSIZE ".realpower",
+			(i % 3) ? "outlet" : "OUTLET", (i * 37) % 200);
+		state_setinfo(&root, var, "10");
+	}
+	state_setinfo(&root, "ups.status", "OL");
+	state_setinfo(&root, "battery.charge", "100");
+
+	count = tree_walk(root, &prev, &sorted);
+	check(count == 202, "one node per name regardless of case");
+	check(sorted, "nodes are ordered case-insensitively");
+
+	check(state_getinfo(root, "Outlet.12.RealPower") != NULL, "case-insensitive lookup");
+	check(state_setinfo(&root, "UPS.STATUS", "OL") == 0, "same value is no change");
+	check(state_setinfo(&root, "ups.status", "OB") == 1, "new value is a change");
+	check(!strcmp(state_getinfo(root, "ups.status"), "OB"), "value was changed");
+
+	state_intern_stats(&before, NULL);
+	check(state_getinfo(root, "not.a.variable") == NULL, "unknown names are not found");
+	check(state_delinfo(&root, "not.a.variable") == 0, "unknown names are not deleted");
+	state_intern_stats(&count, NULL);
+	check(count == before, "lookups do not add names");
+
+	check(state_delinfo(&root, "outlet.12.realpower") == 1, "delete a variable");
+	check(state_getinfo(root, "outlet.12.realpower") == NULL, "deleted variable is gone");
+	check(state_getinfo(root, "outlet.13.realpower") != NULL, "others are still there");
+
+	prev = NULL;
+	count = tree_walk(root, &prev, &sorted);
+	check(count == 201 && sorted, "tree is still ordered after deletion");
+
+	state_infofree(root);
+}
+
+static size_t enum_count(const enum_t *list)
+{
+	size_t	count = 0;
+
+	for (; list; list = list->next)
+		count++;
+
+	return count;
+}
+
+static void test_values(void)
+{
+	st_tree_t	*root = NULL, *node;
+	const enum_t	*etmp;
+	const range_t	*rtmp;
+	char	var[SMALLBUF], longval[ST_MAX_VALUE_LEN];
+	size_t	i;
+
+	printf("=== %s:\n", __func__);
+
+	state_setinfo(&root, "ups.status", "OL");
+	node = state_tree_find(root, "ups.status");
+	check(node && node->raw == node->inl, "short value is kept in the node");
+
+	memset(longval, 'x', sizeof(longval) - 1);
+	longval[sizeof(longval) - 1] = '\0';
+	check(state_setinfo(&root, "ups.status", longval) == 1
+		&& node->raw != node->inl
+		&& !strcmp(state_getinfo(root, "ups.status"), longval), "value grows out of the node");
+	check(state_setinfo(&root, "ups.status", "OB") == 1
+		&& !strcmp(state_getinfo(root, "ups.status"), "OB"), "and shrinks back");
+	check(state_setinfo(&root, "ups.model", "a \"quoted\" name") == 1
+		&& !strcmp(state_getinfo(root, "ups.model"), "a \\\"quoted\\\" name"), "escaped value");
+
+	state_setinfo(&root, "input.transfer.low", "170");
+	for (i = 0; i < 20; i++) {
+		snprintf(var, sizeof(var), "%" PRIuSIZE, 150 + i);
+		state_addenum(root, "input.transfer.low", var);
+	}
+	check(state_addenum(root, "input.transfer.low", "155") == 0, "duplicate enum is refused");
+	check(state_delenum(root, "input.transfer.low", "150") == 1, "delete the first enum");
+	check(state_delenum(root, "input.transfer.low", "169") == 1, "delete the last enum");
+	check(state_delenum(root, "input.transfer.low", "169") == 0, "deleted enum is gone");
+
+	etmp = state_getenumlist(root, "input.transfer.low");
+	check(enum_count(etmp) == 18, "enum list is linked through");
+	for (i = 0; etmp && etmp->next; etmp = etmp->next, i++) {
+		if (etmp->next != etmp + 1 || atoi(etmp->next->val) != atoi(etmp->val) + 1)
+			break;
+	}
+	check(i == 17, "enums are contiguous and in order");
+
+	state_addrange(root, "input.transfer.low", 150, 160);
+	state_addrange(root, "input.transfer.low", 170, 180);
+	check(state_addrange(root, "input.transfer.low", 170, 190) == 0, "duplicate range is refused");
+	rtmp = state_getrangelist(root, "input.transfer.low");
+	check(rtmp && rtmp->min == 150 && rtmp->next == rtmp + 1
+		&& rtmp->next->max == 180 && !rtmp->next->next, "ranges are contiguous and in order");
+	check(state_delrange(root, "input.transfer.low", 150, 160) == 1
+		&& (rtmp = state_getrangelist(root, "input.transfer.low")) != NULL
+		&& rtmp->min == 170 && !rtmp->next, "delete a range");
+
+	/* released nodes are reused */
+	node = state_tree_find(root, "ups.model");
+	state_delinfo(&root, "ups.model");
+	state_setinfo(&root, "ups.mfr", "Maker");
+	check(state_tree_find(root, "ups.mfr") == node, "released node is reused");
+
+	/* many nodes, several chunks */
+	for (i = 0; i < 1000; i++) {
+		snprintf(var, sizeof(var), "outlet.%" PRIuSIZE ".desc", i);
+		state_setinfo(&root, var, var);
+	}
+	check(state_getinfo(root, "outlet.999.desc") != NULL
+		&& !strcmp(state_getinfo(root, "outlet.500.desc"), "outlet.500.desc"), "large tree");
+
+	for (i = 0; i < 1000; i += 2) {
+		snprintf(var, sizeof(var), "outlet.%" PRIuSIZE ".desc", i);
+		state_delinfo(&root, var);
+	}
+	check(state_getinfo(root, "outlet.500.desc") == NULL
+		&& state_getinfo(root, "outlet.501.desc") != NULL, "delete half of it");
+
+	state_infofree(root);
+}
+
+int main(void)
+{
+	size_t	count, bytes;
+
+	test_intern();
+	test_tree();
+	test_values();
+
+	state_intern_stats(&count, &bytes);
+	printf("%" PRIuSIZE " names interned in %" PRIuSIZE " bytes\n", count, bytes);
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -155,6 +155,44 @@ static bool readTestData(nut::NutStream * stream) {
 }
 
 
+/**
+ *  \brief  Read and check test data from a stream in chunks
+ *
+ *  \param  stream  Input stream
+ *
+ *  \retval true  in case of success
+ *  \retval false in case of failure
+ */
+static bool readTestDataChunks(nut::NutStream * stream) {
+	assert(nullptr != stream);
+
+	std::string data;
+
+	for (;;) {
+		// Odd chunk size, so that the last one is incomplete
+		nut::NutStream::status_t status = stream->getData(data, 7);
+
+		if (nut::NutStream::NUTS_EOF == status)
+			break;
+
+		if (nut::NutStream::NUTS_OK != status) {
+			if (verbose)
+				std::cerr << "readTestDataChunks(): status!=nut::NutStream::NUTS_OK: " << status << std::endl;
+			return false;
+		}
+	}
+
+	if (data != test_data) {
+		if (verbose)
+			std::cerr << "readTestDataChunks(): unexpected data: '"
+					<< data << "'" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
 /**
  *  \brief  Write test data to a stream
  *
@@ -220,6 +258,17 @@ class NutStreamUnitTest: public CppUnit::TestFixture {
 		CPPUNIT_ASSERT(writeTestData(stream));
 	}
 
+	/**
+	 *  \brief  Read test data from stream in chunks
+	 *
+	 *  \c CPPUNIT_ASSERT macro is used to resolve error.
+	 *
+	 *  \param  stream  Input stream
+	 */
+	inline void readChunksx(nut::NutStream * stream) {
+		CPPUNIT_ASSERT(readTestDataChunks(stream));
+	}
+
 	virtual ~NutStreamUnitTest() override;
 };  // end of class NutStreamUnitTest
 
@@ -251,6 +300,10 @@ void NutMemoryUnitTest::test() {
 	readx(&input_mstream);
 	writex(&output_mstream);
 	readx(&output_mstream);
+
+	nut::NutMemory chunks_mstream(test_data);
+
+	readChunksx(&chunks_mstream);
 }
 
 
@@ -280,6 +333,17 @@ void NutFileUnitTest::test() {
 	writex(&fstream);
 	fstream.flushx();
 	readx(&fstream);
+
+	// Named file, so that it is read from the beginning
+	nut::NutFile chunks_fstream(nut::NutFile::tmp_dir() + "/nutstream_ut.chunks");
+
+	chunks_fstream.openx(nut::NutFile::WRITE_ONLY);
+	writex(&chunks_fstream);
+	chunks_fstream.closex();
+	chunks_fstream.openx(nut::NutFile::READ_ONLY);
+	readChunksx(&chunks_fstream);
+	chunks_fstream.closex();
+	chunks_fstream.removex();
 }
 
 
@@ -0,0 +1,380 @@
+/*  upsclient_pool_utest.c - test the pooled connections of libupsclient
+ *  against a small emulated data server
+ *
+ *  Copyright (C) 2026 Network UPS Tools contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *  A child process listens on a local TCP port and answers USERNAME,
+ *  PASSWORD, GET VAR, LIST VAR and LOGOUT much like upsd would, for any
+ *  device name. A few special variables of device "server" report how
+ *  many connections it accepted, which user the connection logged in as,
+ *  or make it drop the connection after replying, or push a line after
+ *  the reply like upsd does for WATCH.
+ *  Typically started by "make check".
+ */
+
+#include "config.h"
+#include "common.h"
+#include "upsclient.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Skipped test, for automake */
+#define EXIT_SKIP 77
+
+#define SIM_MAX_CONN	16
+#define NUM_HANDLES	500
+
+typedef struct {
+	int	fd;
+	char	user[64];
+	char	buf[512];
+	size_t	len;
+} sim_conn_t;
+
+static int failures = 0;
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		printf("FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static void sim_send(sim_conn_t *conn, const char *line)
+{
+	if (write(conn->fd, line, strlen(line)) < 0)
+		perror("simulator write");
+}
+
+/* handle one request line, return 0 to keep the connection */
+static int sim_line(sim_conn_t *conn, char *line, unsigned long accepts)
+{
+	char	reply[512], *arg[4];
+	size_t	numargs = 0;
+	char	*p;
+
+	for (p = strtok(line, " \r"); p && numargs < 4; p = strtok(NULL, " \r"))
+		arg[numargs++] = p;
+
+	if (numargs == 1 && !strcmp(arg[0], "LOGOUT")) {
+		sim_send(conn, "OK Goodbye\n");
+		return 1;
+	}
+
+	if (numargs == 2 && !strcmp(arg[0], "USERNAME")) {
+		snprintf(conn->user, sizeof(conn->user), "%s", arg[1]);
+		sim_send(conn, "OK\n");
+		return 0;
+	}
+
+	if (numargs == 2 && !strcmp(arg[0], "PASSWORD")) {
+		sim_send(conn, "OK\n");
+		return 0;
+	}
+
+	if (numargs == 4 && !strcmp(arg[0], "GET") && !strcmp(arg[1], "VAR")) {
+		if (!strcmp(arg[2], "server") && !strcmp(arg[3], "accepts")) {
+			snprintf(reply, sizeof(reply), "VAR %s %s \"%lu\"\n", arg[2], arg[3], accepts);
+		} else if (!strcmp(arg[2], "server") && !strcmp(arg[3], "user")) {
+			snprintf(reply, sizeof(reply), "VAR %s %s \"%s\"\n", arg[2], arg[3],
+				*conn->user ? conn->user : "none");
+		} else {
+			snprintf(reply, sizeof(reply), "VAR %s %s \"%s\"\n", arg[2], arg[3], arg[2]);
+		}
+
+		sim_send(conn, reply);
+		if (!strcmp(arg[2], "server") && !strcmp(arg[3], "push"))
+			sim_send(conn, "NOTIFY VAR server pushed \"1\"\n");
+		return (!strcmp(arg[2], "server") && !strcmp(arg[3], "drop"));
+	}
+
+	if (numargs == 3 && !strcmp(arg[0], "LIST") && !strcmp(arg[1], "VAR")) {
+		snprintf(reply, sizeof(reply),
+			"BEGIN LIST VAR %s\n"
+			"VAR %s ups.status \"OL\"\n"
+			"VAR %s battery.charge \"100\"\n"
+			"END LIST VAR %s\n",
+			arg[2], arg[2], arg[2], arg[2]);
+		sim_send(conn, reply);
+		return 0;
+	}
+
+	sim_send(conn, "ERR UNKNOWN-COMMAND\n");
+	return 0;
+}
+
+static void sim_run(int listen_fd)
+{
+	sim_conn_t	conns[SIM_MAX_CONN];
+	struct pollfd	fds[SIM_MAX_CONN + 1];
+	unsigned long	accepts = 0;
+	size_t	i;
+
+	for (i = 0; i < SIM_MAX_CONN; i++)
+		conns[i].fd = -1;
+
+	for (;;) {
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		for (i = 0; i < SIM_MAX_CONN; i++) {
+			fds[i + 1].fd = conns[i].fd;
+			fds[i + 1].events = POLLIN;
+			fds[i + 1].revents = 0;
+		}
+
+		if (poll(fds, SIM_MAX_CONN + 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			_exit(EXIT_FAILURE);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int	fd = accept(listen_fd, NULL, NULL);
+
+			for (i = 0; fd >= 0 && i < SIM_MAX_CONN && conns[i].fd >= 0; i++)
+				;
+
+			if (fd >= 0 && i < SIM_MAX_CONN) {
+				memset(&conns[i], 0, sizeof(conns[i]));
+				conns[i].fd = fd;
+				accepts++;
+			} else if (fd >= 0) {
+				close(fd);
+			}
+		}
+
+		for (i = 0; i < SIM_MAX_CONN; i++) {
+			sim_conn_t	*conn = &conns[i];
+			char	*nl;
+			ssize_t	ret;
+			int	drop = 0;
+
+			if (conn->fd < 0 || !(fds[i + 1].revents & (POLLIN | POLLHUP)))
+				continue;
+
+			ret = read(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - 1 - conn->len);
+			if (ret <= 0) {
+				close(conn->fd);
+				conn->fd = -1;
+				continue;
+			}
+
+			conn->len += (size_t)ret;
+			conn->buf[conn->len] = '\0';
+
+			while (!drop && (nl = strchr(conn->buf, '\n')) != NULL) {
+				*nl = '\0';
+				drop = sim_line(conn, conn->buf, accepts);
+				conn->len -= (size_t)(nl + 1 - conn->buf);
+				memmove(conn->buf, nl + 1, conn->len + 1);
+			}
+
+			if (drop) {
+				close(conn->fd);
+				conn->fd = -1;
+			}
+		}
+	}
+}
+
+static const char *get_var(UPSCONN_t *ups, const char *upsname, const char *var)
+{
+	const char	*query[3];
+	size_t	numa;
+	char	**answer;
+
+	query[0] = "VAR";
+	query[1] = upsname;
+	query[2] = var;
+
+	if (upscli_get(ups, 3, query, &numa, &answer) < 0 || numa < 4)
+		return NULL;
+
+	return answer[3];
+}
+
+static int var_is(UPSCONN_t *ups, const char *upsname, const char *var, const char *val)
+{
+	const char	*ret = get_var(ups, upsname, var);
+
+	return (ret && !strcmp(ret, val));
+}
+
+int main(void)
+{
+	UPSCONN_t	*handles[NUM_HANDLES], *other;
+	struct sockaddr_in	addr;
+	socklen_t	addrlen = sizeof(addr);
+	struct timeval	tv;
+	const char	*query[2];
+	char	upsname[32], **answer, line[256], line2[256];
+	size_t	i, numa, count;
+	uint16_t	port;
+	int	listen_fd, same = 1, all_ok = 1, reuse = 1;
+	pid_t	pid;
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	/* the port is listened on again once the server is gone */
+	if (listen_fd < 0
+	 || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+	 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+	 || listen(listen_fd, 8) != 0
+	 || getsockname(listen_fd, (struct sockaddr *)&addr, &addrlen) != 0
+	) {
+		printf("SKIP: can not listen on a local TCP port: %s\n", strerror(errno));
+		return EXIT_SKIP;
+	}
+	port = ntohs(addr.sin_port);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return EXIT_FAILURE;
+	}
+	if (pid == 0) {
+		sim_run(listen_fd);
+		_exit(EXIT_SUCCESS);
+	}
+	close(listen_fd);
+
+	printf("=== many handles, one connection:\n");
+	for (i = 0; i < NUM_HANDLES; i++) {
+		handles[i] = upscli_pool_connect("127.0.0.1", port, 0, "monuser", "secret");
+		if (!handles[i] || handles[i] != handles[0])
+			same = 0;
+	}
+	check(upscli_fd(handles[0]) >= 0, "connected");
+	check(same, "handles share the connection");
+
+	for (i = 0; i < NUM_HANDLES; i++) {
+		snprintf(upsname, sizeof(upsname), "ups%" PRIuSIZE, i);
+		if (!var_is(handles[i], upsname, "device.model", upsname))
+			all_ok = 0;
+	}
+	check(all_ok, "GET VAR through every handle");
+	check(var_is(handles[1], "server", "accepts", "1"), "one connection accepted");
+	check(var_is(handles[2], "server", "user", "monuser"), "authenticated once");
+
+	query[0] = "VAR";
+	query[1] = "ups7";
+	count = 0;
+	if (upscli_list_start(handles[7], 2, query) == 0) {
+		while (upscli_list_next(handles[7], 2, query, &numa, &answer) == 1)
+			count++;
+	}
+	check(count == 2, "LIST VAR through a handle");
+	check(var_is(handles[8], "ups8", "ups.status", "ups8"), "next request after a list");
+
+	printf("=== other credentials:\n");
+	other = upscli_pool_connect("127.0.0.1", port, 0, NULL, NULL);
+	check(other != NULL && other != handles[0], "separate connection");
+	check(var_is(other, "server", "user", "none"), "anonymous connection");
+	check(var_is(other, "server", "accepts", "2"), "second connection accepted");
+
+	printf("=== reconnect:\n");
+	check(var_is(handles[3], "server", "drop", "server"), "server drops the connection");
+	/* let it close the socket, like an idle timeout would */
+	usleep(100000);
+	check(var_is(handles[4], "server", "accepts", "3"), "next request reconnects");
+	check(var_is(handles[5], "server", "user", "monuser"), "and authenticates again");
+
+	upscli_disconnect(handles[6]);
+	check(upscli_fd(handles[9]) < 0, "disconnecting a handle closes the connection");
+	check(var_is(handles[9], "ups9", "ups.status", "ups9"), "which is re-opened on demand");
+	check(var_is(handles[9], "server", "accepts", "4"), "as a new connection");
+
+	/* like lines pushed after WATCH: pending data is not a lost connection */
+	check(var_is(handles[10], "server", "push", "server"), "server pushes a line after the reply");
+	usleep(100000);
+	*line = *line2 = '\0';
+	if (upscli_sendline(handles[10], "GET VAR server accepts\n", 23) == 0
+	 && upscli_readline(handles[10], line, sizeof(line)) == 0
+	) {
+		upscli_readline(handles[10], line2, sizeof(line2));
+	}
+	check(!strcmp(line, "NOTIFY VAR server pushed \"1\""), "pushed line is left to the reader");
+	check(!strcmp(line2, "VAR server accepts \"4\""), "on the same connection");
+
+	tv.tv_sec = 5;
+	tv.tv_usec = 0;
+	other = upscli_pool_tryconnect("127.0.0.1", port, 0, "monuser", "secret", &tv);
+	check(other == handles[0], "a handle with a connect timeout shares the connection too");
+	upscli_pool_release(other);
+
+	printf("=== release:\n");
+	for (i = 0; i + 1 < NUM_HANDLES; i++)
+		upscli_pool_release(handles[i]);
+	check(var_is(handles[NUM_HANDLES - 1], "server", "accepts", "4"), "last handle is still connected");
+	check(upscli_pool_release(handles[NUM_HANDLES - 1]) == 0, "release the last handle");
+
+	other = upscli_pool_connect("127.0.0.1", port, 0, "monuser", "secret");
+	check(var_is(other, "server", "accepts", "5"), "a new handle opens a new connection");
+	check(upscli_pool_release(other) == 0, "release it");
+	check(upscli_pool_release(other) == -1, "released handles are not known any more");
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	printf("=== unreachable server:\n");
+	other = upscli_pool_connect("127.0.0.1", port, 0, NULL, NULL);
+	check(other != NULL && upscli_fd(other) < 0, "the handle is returned, not connected");
+
+	/* listen there again: it is not retried for each request at once */
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	addr.sin_port = htons(port);
+	if (listen_fd >= 0
+	 && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0
+	 && bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+	 && listen(listen_fd, 8) == 0
+	) {
+		check(get_var(other, "server", "accepts") == NULL && upscli_fd(other) < 0,
+			"not retried right away");
+	} else {
+		printf("SKIP: can not listen on port %" PRIu16 " again: %s\n", port, strerror(errno));
+	}
+	if (listen_fd >= 0)
+		close(listen_fd);
+	upscli_pool_release(other);
+
+	upscli_cleanup();
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
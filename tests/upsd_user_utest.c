@@ -0,0 +1,154 @@
+/*  upsd_user_utest.c - test the upsd user index and password checks
+ *
+ *  Copyright (C) 2026 Network UPS Tools contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+#include "common.h"
+#include "user.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		printf("FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+/* feed a line of upsd.users, like the parser would split it */
+static void load(const char *line)
+{
+	char	buf[LARGEBUF], *arg[16], *p;
+	size_t	numargs = 0;
+
+	snprintf(buf, sizeof(buf), "%s", line);
+	for (p = strtok(buf, " "); p && numargs < 16; p = strtok(NULL, " "))
+		arg[numargs++] = p;
+
+	user_load_args(numargs, arg);
+}
+
+static void test_users(void)
+{
+	char	hash[SMALLBUF], line[LARGEBUF];
+
+	printf("=== %s:\n", __func__);
+
+#ifdef HAVE_CRYPT
+	check(user_hash_password("monpass", hash, sizeof(hash)) == 0
+		&& !strncmp(hash, "{CRYPT}$", 8) && strlen(hash) > 30,
+		"format a password hash");
+#else	/* !HAVE_CRYPT */
+	check(user_hash_password("monpass", hash, sizeof(hash)) != 0,
+		"no password hashes without crypt(3)");
+#endif	/* !HAVE_CRYPT */
+
+	load("[admin]");
+	load("password = secret");
+	load("actions = SET FSD");
+	load("instcmds = all");
+
+	load("[mon]");
+	snprintf(line, sizeof(line), "password = %s", hash);
+	load(line);
+	load("upsmon primary");
+
+	load("[op]");
+	load("password = pw");
+	load("instcmds = test.battery.start");
+	load("instcmds = Beeper.Toggle");
+	load("actions = custom");
+
+	load("[known]");
+	/* made with: openssl passwd -6 -salt saltsalt pw */
+	load("password = {CRYPT}$6$saltsalt$pauPrmdmG4BTE9h2HPmywiw152IFch6BJCEsaY6D.PLTfpV8sqvXwWdyfsgVgozkYH9B80bAip/08R2BPH2xk/");
+	load("actions = login");
+
+	load("[broken]");
+	load("password = {CRYPT}$6$saltsalt$pauPrmdmG4BTE9h2");
+	load("actions = login");
+
+	load("[empty]");
+	load("password = {CRYPT}");
+	load("actions = login");
+
+	check(user_checkaction("admin", "secret", "SET"), "admin may SET");
+	check(user_checkaction("admin", "secret", "fsd"), "action names are not case-sensitive");
+	check(!user_checkaction("admin", "secret", "LOGIN"), "admin may not LOGIN");
+	check(!user_checkaction("admin", "secre", "SET"), "a prefix of the password is refused");
+	check(!user_checkaction("admin", "secrets", "SET"), "a longer password is refused");
+	check(!user_checkaction("Admin", "secret", "SET"), "user names are case-sensitive");
+	check(!user_checkaction("nobody", "secret", "SET"), "unknown users are refused");
+	check(user_checkinstcmd("admin", "secret", "load.off"), "instcmds = all");
+
+#ifdef HAVE_CRYPT
+	check(user_checkaction("mon", "monpass", "LOGIN")
+		&& user_checkaction("mon", "monpass", "MASTER")
+		&& user_checkaction("mon", "monpass", "FSD"), "upsmon primary with a hashed password");
+	check(!user_checkaction("mon", "monpass", "SET"), "upsmon may not SET");
+	check(!user_checkaction("mon", hash, "LOGIN"), "the hash is not the password");
+	check(!user_checkinstcmd("mon", "monpass", "load.off"), "upsmon has no instcmds");
+#endif	/* HAVE_CRYPT */
+
+	check(user_checkinstcmd("op", "pw", "test.battery.start"), "listed instcmd");
+	check(user_checkinstcmd("op", "pw", "beeper.toggle"), "instcmd names are not case-sensitive");
+	check(!user_checkinstcmd("op", "pw", "load.off"), "instcmd not listed");
+	check(!user_checkinstcmd("op", "wrong", "test.battery.start"), "wrong password for an instcmd");
+	check(user_checkaction("op", "pw", "CUSTOM"), "actions unknown to upsd are kept");
+
+#ifdef HAVE_CRYPT
+	check(user_checkaction("known", "pw", "LOGIN"), "hash made with another tool");
+	check(!user_checkaction("known", "pW", "LOGIN"), "wrong password for a hash");
+#else	/* !HAVE_CRYPT */
+	check(!user_checkaction("known", "pw", "LOGIN"), "hashes never match without crypt(3)");
+#endif	/* !HAVE_CRYPT */
+	check(!user_checkaction("broken", "pw", "LOGIN"), "malformed hashes never match");
+	check(!user_checkaction("empty", "", "LOGIN"), "an empty hash never matches");
+	check(!user_checkaction("nobody", "pw", "LOGIN"), "unknown users are refused with hashes around");
+
+	/* reload with other users */
+	user_flush();
+	load("[admin]");
+	load("password = other");
+	load("actions = SET");
+
+	check(!user_checkaction("admin", "secret", "SET"), "old password is gone after reload");
+	check(user_checkaction("admin", "other", "SET"), "new password after reload");
+	check(!user_checkaction("op", "pw", "CUSTOM"), "removed user is gone");
+
+	user_flush();
+}
+
+int main(void)
+{
+	test_users();
+
+	if (failures) {
+		printf("%d test(s) failed\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,466 @@
+/*  upsmon_notifier_utest.c - test the upsmon notification worker: event
+ *  framing, the coalescing queue, and deliveries by a running worker to
+ *  a NOTIFYCMD and to an emulated upssched daemon
+ *
+ *  Copyright (C) 2026 Network UPS Tools contributors
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#include "config.h"
+#include "common.h"
+#include "upsmon-notifier.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+static int failures = 0;
+static char	tmpdir[] = "/tmp/nut-notifier-XXXXXX";
+static char	outfn[NUT_PATH_MAX + 1], conffn[NUT_PATH_MAX + 1];
+static char	pipefn[64];	/* must fit in sun_path */
+
+static void check(int condition, const char *description)
+{
+	if (!condition) {
+		printf("FAIL: %s\n", description);
+		failures++;
+	} else {
+		printf("PASS: %s\n", description);
+	}
+}
+
+static void test_framing(void)
+{
+	unsigned char	buf[NOTIFIER_FRAME_MAX];
+	char	longmsg[2 * NOTIFIER_FRAME_MAX];
+	const	char	*ntype, *upsname, *notice;
+	unsigned int	flags = 0;
+	size_t	len, i;
+	int	ret, partial = 0;
+
+	printf("=== %s:\n", __func__);
+
+	len = notifier_frame(buf, sizeof(buf), NOTIFIER_EXEC,
+		"ONBATT", "ups1@localhost", "UPS ups1@localhost on battery");
+	check(len == NOTIFIER_FRAME_HDR + 7 + 15 + 30, "frame size");
+
+	ret = notifier_unframe(buf, len, &flags, &ntype, &upsname, &notice);
+	check(ret == (int)len && flags == NOTIFIER_EXEC
+		&& !strcmp(ntype, "ONBATT") && !strcmp(upsname, "ups1@localhost")
+		&& !strcmp(notice, "UPS ups1@localhost on battery"),
+		"frame round trip");
+
+	for (i = 0; i < len; i++) {
+		if (notifier_unframe(buf, i, &flags, &ntype, &upsname, &notice) != 0)
+			partial++;
+	}
+	check(partial == 0, "incomplete frames ask for more data");
+
+	len = notifier_frame(buf, sizeof(buf), NOTIFIER_WALL, "SHUTDOWN", NULL, "Auto logout");
+	ret = notifier_unframe(buf, len, &flags, &ntype, &upsname, &notice);
+	check(ret == (int)len && flags == NOTIFIER_WALL && !strcmp(upsname, ""),
+		"no UPS name is sent as an empty string");
+
+	memset(longmsg, 'x', sizeof(longmsg) - 1);
+	longmsg[sizeof(longmsg) - 1] = '\0';
+	len = notifier_frame(buf, sizeof(buf), NOTIFIER_EXEC, "ALARM", "ups1", longmsg);
+	ret = notifier_unframe(buf, len, &flags, &ntype, &upsname, &notice);
+	check(len == NOTIFIER_FRAME_MAX && ret == (int)len
+		&& strlen(notice) == NOTIFIER_FRAME_MAX - NOTIFIER_FRAME_HDR - 6 - 5 - 1,
+		"long message is truncated to fit a frame");
+
+	check(notifier_frame(buf, NOTIFIER_FRAME_HDR + 2, 0, "A", "B", "C") == 0,
+		"no frame without room for the header");
+
+	len = notifier_frame(buf, sizeof(buf), 0, "A", "B", "C");
+	buf[len - 1] = 'C';
+	check(notifier_unframe(buf, len, &flags, &ntype, &upsname, &notice) < 0,
+		"frame without the final NUL is rejected");
+
+	buf[0] = buf[1] = buf[2] = buf[3] = 0xff;
+	check(notifier_unframe(buf, len, &flags, &ntype, &upsname, &notice) < 0,
+		"frame with a bogus size is rejected");
+}
+
+static void test_queue(void)
+{
+	notifier_queue_t	q;
+	notifier_batch_t	*b;
+	int	i, ok;
+
+	printf("=== %s:\n", __func__);
+
+	memset(&q, 0, sizeof(q));
+	q.max = 16;
+	q.coalesce = 100;
+
+	check(notifier_queue_add(&q, 0, NOTIFIER_EXEC, "ONBATT", "ups1", "ups1 on battery") == 1,
+		"first event opens a batch");
+	check(notifier_queue_add(&q, 50, NOTIFIER_EXEC, "ONBATT", "ups2", "ups2 on battery") == 2,
+		"same type within the window is merged");
+	check(notifier_queue_add(&q, 60, NOTIFIER_EXEC, "ONLINE", "ups1", "ups1 on line") == 1,
+		"another type opens a batch");
+	check(notifier_queue_add(&q, 70, NOTIFIER_EXEC, "ONBATT", "ups3", "ups3 on battery") == 1,
+		"older batches take no more events");
+	check(notifier_queue_add(&q, 80, NOTIFIER_WALL, "ONBATT", "ups4", "ups4 on battery") == 1,
+		"other flags open a batch");
+	check(q.events == 5, "pending events are counted");
+
+	check(notifier_queue_due(&q, 99, 0) == NULL && notifier_queue_wait(&q, 99) == 1,
+		"nothing is due before the window ends");
+
+	b = notifier_queue_due(&q, 100, 0);
+	check(b && b->count == 2 && !strcmp(b->ntype, "ONBATT")
+		&& !strcmp(b->first->upsname, "ups1") && !strcmp(b->last->upsname, "ups2"),
+		"batch is due when the window ends, events in order");
+	notifier_batch_free(b);
+
+	check(notifier_queue_due(&q, 100, 0) == NULL && notifier_queue_wait(&q, 100) == 60,
+		"the next batch has its own window");
+
+	b = notifier_queue_due(&q, 100, 1);
+	check(b && b->count == 1 && !strcmp(b->ntype, "ONLINE"), "flushing ignores the window");
+	notifier_batch_free(b);
+
+	b = notifier_queue_due(&q, 1000, 0);
+	check(b && !strcmp(b->first->upsname, "ups3"), "delivery order is arrival order");
+	notifier_batch_free(b);
+	notifier_batch_free(notifier_queue_due(&q, 1000, 0));
+
+	check(q.events == 0 && !q.head && !q.tail && notifier_queue_wait(&q, 1000) == -1,
+		"queue is empty");
+
+	q.max = 3;
+	q.coalesce = 0;
+	for (i = 0; i < 4; i++)
+		ok = notifier_queue_add(&q, 2000, NOTIFIER_EXEC, "COMMBAD", "ups1", "lost");
+	check(ok == 0 && q.events == 3 && q.dropped == 1, "full queue drops and counts new events");
+	check(q.head && q.head->count == 1 && q.head->next, "no coalescing without a window");
+	while ((b = notifier_queue_due(&q, 2000, 0)) != NULL)
+		notifier_batch_free(b);
+
+	q.max = 256;
+	q.coalesce = 1000;
+	for (i = 0; i < 70; i++)
+		notifier_queue_add(&q, 3000, NOTIFIER_EXEC, "NOCOMM", "ups1", "unavailable");
+	check(q.head && q.head->count == 64 && q.head->next && q.head->next->count == 6,
+		"batches are limited in size");
+	while ((b = notifier_queue_due(&q, 5000, 0)) != NULL)
+		notifier_batch_free(b);
+
+	for (i = 0; i < 3; i++)
+		notifier_queue_add(&q, 6000, NOTIFIER_EXEC | NOTIFIER_ALONE, "ONBATT", "ups1", "ups1 on battery");
+	check(q.head && q.head->count == 1 && q.head->next && q.head->next->count == 1
+		&& q.head->next->next && q.head->next->next->count == 1,
+		"events queued alone are not merged");
+	check(notifier_queue_wait(&q, 6000) == 0, "events queued alone are due at once");
+	while ((b = notifier_queue_due(&q, 6000, 0)) != NULL)
+		notifier_batch_free(b);
+}
+
+static void write_file(const char *fn, const char *text)
+{
+	FILE	*f = fopen(fn, "w");
+
+	if (!f) {
+		perror(fn);
+		exit(EXIT_FAILURE);
+	}
+	fputs(text, f);
+	fclose(f);
+}
+
+/* what NOTIFYCMD calls wrote, once <expect> of them have finished */
+static const char *wait_output(int expect)
+{
+	static	char	buf[4096];
+	FILE	*f;
+	size_t	len;
+	int	i, n;
+	char	*p;
+
+	for (i = 0; i < 100; i++) {
+		buf[0] = '\0';
+		if ((f = fopen(outfn, "r")) != NULL) {
+			len = fread(buf, 1, sizeof(buf) - 1, f);
+			buf[len] = '\0';
+			fclose(f);
+		}
+
+		for (n = 0, p = buf; (p = strstr(p, "<end>")) != NULL; p++)
+			n++;
+		if (n >= expect)
+			break;
+
+		usleep(50000);
+	}
+
+	return buf;
+}
+
+/* stop the worker and wait for it to deliver everything */
+static void stop_worker(void)
+{
+	int	status;
+
+	notifier_stop();
+	check(waitpid(-1, &status, 0) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+		"worker exits after the pipe is closed");
+}
+
+static void test_worker(void)
+{
+	static	char	script[NUT_PATH_MAX + 256], slowscript[2 * NUT_PATH_MAX + 256];
+	char	*argv[5];
+	notifier_conf_t	conf;
+	const	char	*out, *end;
+	int	i, started;
+
+	printf("=== %s:\n", __func__);
+
+	snprintf(script, sizeof(script),
+		"printf '%%s|%%s|%%s|%%s<end>\\n' \"$NOTIFYTYPE\" \"$UPSNAME\" \"$NOTIFYCOUNT\" \"$1\" >> '%s'",
+		outfn);
+	argv[0] = "/bin/sh";
+	argv[1] = "-c";
+	argv[2] = script;
+	argv[3] = "notifycmd";
+	argv[4] = NULL;
+
+	memset(&conf, 0, sizeof(conf));
+	conf.coalesce = 300;
+	conf.queuemax = 16;
+	conf.cmd_argv = argv;
+	conf.cmd_argc = 4;
+	conf.cmd_concat = "notifycmd";
+
+	unlink(outfn);
+	check(notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "lost") == -1,
+		"no worker: the caller delivers");
+
+	check(notifier_start(&conf) > 0 && notifier_running(), "worker started");
+
+	check(notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "UPS ups1 on battery") == 1
+		&& notifier_send(NOTIFIER_EXEC, "ONBATT", "ups2", "UPS ups2 on battery") == 1
+		&& notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "UPS ups1 on battery again") == 1
+		&& notifier_send(NOTIFIER_EXEC, "ONLINE", "ups1", "UPS ups1 on line power") == 1
+		&& notifier_send(0, "COMMOK", "ups1", "nothing to deliver") == 1,
+		"events passed to the worker");
+
+	stop_worker();
+	check(notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "lost") == -1,
+		"stopped worker: the caller delivers");
+
+	out = wait_output(2);
+	check(strstr(out, "ONBATT|ups1 ups2|3|UPS ups1 on battery\nUPS ups2 on battery\n"
+		"UPS ups1 on battery again<end>\n") != NULL,
+		"coalesced events are delivered with one call");
+	check(strstr(out, "ONLINE|ups1|1|UPS ups1 on line power<end>\n") != NULL,
+		"single event is delivered as before");
+	check(strstr(out, "COMMOK") == NULL, "events without WALL or EXEC are not delivered");
+
+	/* upssched as NOTIFYCMD takes one event per call */
+	conf.cmd_upssched = 1;
+	unlink(outfn);
+	check(notifier_start(&conf) > 0, "worker started for upssched");
+
+	notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "UPS ups1 on battery");
+	notifier_send(NOTIFIER_EXEC, "ONBATT", "ups2", "UPS ups2 on battery");
+
+	stop_worker();
+
+	out = wait_output(2);
+	check(strstr(out, "ONBATT|ups1|1|UPS ups1 on battery<end>\n") != NULL
+		&& strstr(out, "ONBATT|ups2|1|UPS ups2 on battery<end>\n") != NULL,
+		"events for upssched are not coalesced");
+
+	/* ... and in a storm, still no more than NOTIFIER_CHILDREN_MAX at once */
+	snprintf(slowscript, sizeof(slowscript),
+		"echo '<start>' >> '%s'; sleep 1; "
+		"printf '%%s|%%s|%%s|%%s<end>\\n' \"$NOTIFYTYPE\" \"$UPSNAME\" \"$NOTIFYCOUNT\" \"$1\" >> '%s'",
+		outfn, outfn);
+	argv[2] = slowscript;
+	unlink(outfn);
+	check(notifier_start(&conf) > 0, "worker started for an upssched storm");
+
+	for (i = 0; i < 12; i++)
+		notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "UPS ups1 on battery");
+
+	stop_worker();
+
+	/* calls which started before the first one ended ran at once */
+	out = wait_output(12);
+	end = strstr(out, "<end>");
+	for (started = 0; end && (out = strstr(out, "<start>")) != NULL && out < end; out++)
+		started++;
+	check(end != NULL && started > 0 && started <= 8,
+		"upssched calls run no more than NOTIFIER_CHILDREN_MAX (8) at once");
+	argv[2] = script;
+}
+
+/* accept one upssched client, answer OK to its request and return it */
+static int fake_upssched(int lfd, char *line, size_t linesize)
+{
+	struct	pollfd	pfd;
+	size_t	len = 0;
+	ssize_t	ret;
+	int	fd;
+
+	line[0] = '\0';
+
+	pfd.fd = lfd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 5000) != 1 || (fd = accept(lfd, NULL, NULL)) < 0)
+		return -1;
+
+	while (len < linesize - 1 && !memchr(line, '\n', len)) {
+		pfd.fd = fd;
+		if (poll(&pfd, 1, 5000) != 1 || (ret = read(fd, line + len, linesize - 1 - len)) <= 0)
+			break;
+		len += (size_t)ret;
+		line[len] = '\0';
+	}
+
+	if (write(fd, "OK\n", 3) != 3)
+		len = 0;
+	close(fd);
+
+	return (int)len;
+}
+
+static void test_upssched(void)
+{
+	static	char	script[NUT_PATH_MAX + 256], conf_text[3 * NUT_PATH_MAX + 256];
+	char	*argv[5], line[LARGEBUF];
+	notifier_conf_t	conf;
+	struct	sockaddr_un	saddr;
+	const	char	*out;
+	int	lfd;
+
+	printf("=== %s:\n", __func__);
+
+	snprintf(conf_text, sizeof(conf_text),
+		"CMDSCRIPT /bin/true\n"
+		"PIPEFN %s\n"
+		"LOCKFN %s/upssched.lock\n"
+		"AT ONBATT * START-TIMER onbatt 30\n"
+		"AT ONLINE * CANCEL-TIMER onbatt\n"
+		"AT COMMBAD ups1 EXECUTE commbad\n",
+		pipefn, tmpdir);
+	write_file(conffn, conf_text);
+	setenv("NUT_CONFPATH", tmpdir, 1);
+
+	/* stands for upssched, called when the daemon can not be used */
+	snprintf(script, sizeof(script),
+		"printf 'upssched|%%s|%%s<end>\\n' \"$NOTIFYTYPE\" \"$UPSNAME\" >> '%s'",
+		outfn);
+	argv[0] = "/bin/sh";
+	argv[1] = "-c";
+	argv[2] = script;
+	argv[3] = "upssched";
+	argv[4] = NULL;
+
+	memset(&conf, 0, sizeof(conf));
+	conf.coalesce = 300;
+	conf.cmd_upssched = 1;
+	conf.upssched = 1;
+	conf.cmd_argv = argv;
+	conf.cmd_argc = 4;
+	conf.cmd_concat = "upssched";
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sun_family = AF_UNIX;
+	snprintf(saddr.sun_path, sizeof(saddr.sun_path), "%s", pipefn);
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (lfd < 0 || bind(lfd, (const struct sockaddr *)&saddr, sizeof(saddr)) < 0
+	 || listen(lfd, 4) < 0) {
+		perror("upssched socket");
+		failures++;
+		return;
+	}
+
+	unlink(outfn);
+	check(notifier_start(&conf) > 0, "worker started");
+
+	notifier_send(NOTIFIER_EXEC, "ONBATT", "ups1", "UPS ups1 on battery");
+	check(fake_upssched(lfd, line, sizeof(line)) > 0
+		&& !strcmp(line, "START \"onbatt\" \"30\" \"ONBATT\" \"ups1\" \"UPS ups1 on battery\"\n"),
+		"timer started without calling upssched");
+
+	notifier_send(NOTIFIER_EXEC, "ONLINE", "ups1", "UPS ups1 on line power");
+	check(fake_upssched(lfd, line, sizeof(line)) > 0
+		&& !strcmp(line, "CANCEL \"onbatt\" \"\" \"ONLINE\" \"ups1\" \"UPS ups1 on line power\"\n"),
+		"timer cancelled without calling upssched");
+
+	notifier_send(NOTIFIER_EXEC, "COMMBAD", "ups1", "Communications with UPS ups1 lost");
+
+	/* the daemon goes away when it has no timers */
+	close(lfd);
+	unlink(pipefn);
+
+	notifier_send(NOTIFIER_EXEC, "ONBATT", "ups2", "UPS ups2 on battery");
+	notifier_send(NOTIFIER_EXEC, "ONLINE", "ups2", "UPS ups2 on line power");
+
+	stop_worker();
+
+	out = wait_output(2);
+	check(strstr(out, "upssched|COMMBAD|ups1<end>") != NULL,
+		"EXECUTE is left to upssched");
+	check(strstr(out, "upssched|ONBATT|ups2<end>") != NULL,
+		"upssched is called to start its daemon");
+	check(strstr(out, "ONLINE") == NULL,
+		"nothing to cancel without the daemon");
+}
+
+int main(void)
+{
+	/* a stuck worker or socket must not hang "make check" */
+	alarm(60);
+
+	if (!mkdtemp(tmpdir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(outfn, sizeof(outfn), "%s/notifycmd.out", tmpdir);
+	snprintf(pipefn, sizeof(pipefn), "%s/upssched.pipe", tmpdir);
+	snprintf(conffn, sizeof(conffn), "%s/upssched.conf", tmpdir);
+
+	test_framing();
+	test_queue();
+	test_worker();
+	test_upssched();
+
+	unlink(outfn);
+	unlink(pipefn);
+	unlink(conffn);
+	rmdir(tmpdir);
+
+	if (failures) {
+		printf("%d test(s) FAILED\n", failures);
+		return 1;
+	}
+
+	printf("All tests PASSED\n");
+	return 0;
+}
@@ -38,8 +38,9 @@
 /* Windows: all serial port names start with "COM" */
 #define SERIAL_PORT_PREFIX "COM"
 #else	/* !WIN32 */
-/* Unix: all serial port names start with "/dev/tty" */
-#define SERIAL_PORT_PREFIX "/dev/tty"
+/* Unix: all serial port names start with "/dev/" (ttyS0, cua0, or pts/0
+ * for pseudo-terminals e.g. of serial-over-network or simulated devices) */
+#define SERIAL_PORT_PREFIX "/dev/"
 #endif	/* !WIN32 */
 
 #define ERR_OUT_OF_BOUND "Serial port range out of bound (must be 0 to 9 or a to z depending on your system)"
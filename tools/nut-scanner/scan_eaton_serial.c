@@ -30,6 +30,7 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #if (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_PUSH_POP) && (defined HAVE_PRAGMA_GCC_DIAGNOSTIC_IGNORED_STRICT_PROTOTYPES)
 # pragma GCC diagnostic push
 # pragma GCC diagnostic ignored "-Wstrict-prototypes"
@@ -46,6 +47,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#ifndef WIN32
+# include <poll.h>
+#endif	/* !WIN32 */
 #include "serial.h"
 #include "bcmxcp_io.h"
 #include "bcmxcp_ser.h"
@@ -56,6 +61,9 @@
 #define SHUT_SYNC 0x16
 #define MAX_TRY   4
 
+/* Q1 tries */
+#define MAXTRIES  3
+
 /* BCMXCP header defines these externs now: */
 /*
 extern unsigned char BCMXCP_AUTHCMD[4];
@@ -65,9 +73,6 @@ extern struct pw_baud_rate {
 } pw_baud_rates[];
 */
 
-/* Local list of found devices */
-static nutscan_device_t * dev_ret = NULL;
-
 /* Remap some functions to avoid undesired behavior (drivers/main.c) */
 char *getval(const char *var)
 {
@@ -75,10 +80,6 @@ char *getval(const char *var)
 	return NULL;
 }
 
-#ifdef HAVE_PTHREAD
-static pthread_mutex_t dev_mutex;
-#endif
-
 /* Drivers name */
 #define SHUT_DRIVER_NAME  "mge-shut"
 #define XCP_DRIVER_NAME   "bcmxcp"
@@ -123,122 +124,569 @@ unsigned char calc_checksum(const unsigned char *buf)
 }
 
 /*******************************************************************************
- * SHUT functions (MGE legacy, but Eaton path forward)
+ * Probe engine: all ports are opened at once and each runs its own sequence
+ * of protocol probes (SHUT, XCP at each of pw_baud_rates[], then Q1), driven
+ * by a single poll() loop with per-port deadlines instead of sleeps and
+ * blocking reads. The first protocol which answers on a port ends its probes.
  ******************************************************************************/
 
-/* Light version of of drivers/libshut.c->shut_synchronise()
- * return 1 if OK, 0 otherwise */
-static int shut_synchronise(TYPE_FD_SER arg_upsfd)
+/* Timings of the probes, in milliseconds */
+#define PROBE_GAP_MS      100   /* between two probes on a port */
+#define SHUT_WAIT_MS      1000  /* for the SYNC token echo */
+#define XCP_ESC_WAIT_MS   90    /* after ESC, before the auth command */
+#define XCP_AUTH_WAIT_MS  500   /* after the auth command (or less?) */
+#define XCP_PACE_MS       1     /* between bytes of PW_SET_REQ_ONLY_MODE */
+#define XCP_WAIT_MS       1000  /* for the PW_COMMAND_START_BYTE reply */
+#define Q1_SETTLE_MS      100   /* for the cablepower to settle */
+#define Q1_WAIT_MS        1000  /* for the status line (3 seconds for Best UPS) */
+
+typedef enum {
+	EATON_PROTO_SHUT = 0,
+	EATON_PROTO_XCP,
+	EATON_PROTO_Q1
+} eaton_proto_t;
+
+static const char *eaton_driver_names[] = {
+	SHUT_DRIVER_NAME,
+	XCP_DRIVER_NAME,
+	Q1_DRIVER_NAME
+};
+
+/* One protocol probe at a given line speed */
+typedef struct {
+	eaton_proto_t	proto;
+	speed_t	speed;
+	int	baud;	/* for messages */
+} eaton_probe_t;
+
+/* Cached protocol, SHUT, each XCP speed and Q1 */
+#define EATON_MAX_PROBES  16
+
+typedef enum {
+	STEP_GAP = 0,	/* waiting to start the next probe */
+	STEP_SHUT_WAIT,	/* SYNC token sent */
+	STEP_XCP_ESC,	/* ESC sent */
+	STEP_XCP_AUTH,	/* auth command sent */
+	STEP_XCP_WAIT,	/* PW_SET_REQ_ONLY_MODE sent */
+	STEP_Q1_SETTLE,	/* cablepower set */
+	STEP_Q1_WAIT,	/* Q1 query sent */
+	STEP_DONE	/* port closed */
+} eaton_step_t;
+
+typedef struct {
+	const char	*name;
+	TYPE_FD_SER	fd;
+
+	eaton_probe_t	probes[EATON_MAX_PROBES];
+	size_t	num_probes, cur;	/* cur: the running probe */
+	eaton_step_t	step;
+	int	tries;
+	int64_t	deadline;
+
+	/* pending output, written a byte per pace_ms if that is not zero */
+	unsigned char	out[16];
+	size_t	out_len, out_pos;
+	int64_t	pace_ms, out_next;
+
+	/* Q1 status line */
+	unsigned char	in[128];
+	size_t	in_len;
+} eaton_port_t;
+
+/* Protocol which answered on a port, tried first when that port is
+ * scanned again. The cache is kept in a state file, so later runs of
+ * nut-scanner benefit too, one "<port> <driver> <bauds>" line per port */
+typedef struct {
+	char	port[64];
+	eaton_probe_t	probe;
+	unsigned long	used;	/* to replace the oldest entry */
+} eaton_cache_t;
+
+#define EATON_CACHE_SIZE  64
+#define EATON_CACHE_FILE  "nut-scanner-eaton-serial.cache"
+
+static eaton_cache_t	eaton_cache[EATON_CACHE_SIZE];
+static unsigned long	eaton_cache_clock = 0;
+static int	eaton_cache_changed = 0;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t	eaton_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static int eaton_cache_get(const char *port_name, eaton_probe_t *probe)
 {
-	int try_num;
-	unsigned char reply = '\0';
-	/* FIXME? Should we save "arg_upsfd" into global "upsfd" variable?
-	 * This was previously shadowed by function argument named "upsfd"...
-	 */
-	/* upsfd = arg_upsfd; */
-
-	/* Sync with the UPS according to notification */
-	for (try_num = 0; try_num < MAX_TRY; try_num++) {
-		if ((ser_send_char(arg_upsfd, SHUT_SYNC)) == -1) {
-			continue;
-		}
+	size_t	i;
+	int	found = 0;
 
-		ser_get_char(arg_upsfd, &reply, 1, 0);
-		if (reply == SHUT_SYNC) {
-			return 1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&eaton_cache_mutex);
+#endif
+	for (i = 0; i < EATON_CACHE_SIZE; i++) {
+		if (eaton_cache[i].used && !strcmp(eaton_cache[i].port, port_name)) {
+			*probe = eaton_cache[i].probe;
+			eaton_cache[i].used = ++eaton_cache_clock;
+			found = 1;
+			break;
 		}
 	}
-	return 0;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&eaton_cache_mutex);
+#endif
+
+	return found;
 }
 
-/* SHUT scan:
- *   send SYNC token (0x16) and receive the SYNC token back
- *   FIXME: maybe try to get device descriptor?!
- */
-static nutscan_device_t * nutscan_scan_eaton_serial_shut(const char* port_name)
+/* Remember the probe (or forget the port if probe is NULL) */
+static void eaton_cache_set(const char *port_name, const eaton_probe_t *probe)
 {
-	nutscan_device_t * dev = NULL;
-	TYPE_FD_SER devfd = ser_open_nf(port_name);
+	size_t	i, slot = EATON_CACHE_SIZE;
 
-	if (VALID_FD_SER(devfd)) {
-		/* set RTS to off and DTR to on to allow correct behavior
-		 * with UPS using PnP feature */
-		if (ser_set_dtr(devfd, 1) != -1) {
+	if (strlen(port_name) >= sizeof(eaton_cache[0].port))
+		return;
 
-			ser_set_rts(devfd, 0);
-			ser_set_speed_nf(devfd, port_name, B2400);
-
-			if (shut_synchronise(devfd)) {
-
-				/* Communication established successfully! */
-				dev = nutscan_new_device();
-				dev->type = TYPE_EATON_SERIAL;
-				dev->driver = strdup(SHUT_DRIVER_NAME);
-				dev->port = strdup(port_name);
 #ifdef HAVE_PTHREAD
-				pthread_mutex_lock(&dev_mutex);
+	pthread_mutex_lock(&eaton_cache_mutex);
 #endif
-				dev_ret = nutscan_add_device_to_device(dev_ret, dev);
+	for (i = 0; i < EATON_CACHE_SIZE; i++) {
+		if (eaton_cache[i].used && !strcmp(eaton_cache[i].port, port_name)) {
+			slot = i;
+			break;
+		}
+		if (slot == EATON_CACHE_SIZE
+		|| eaton_cache[i].used < eaton_cache[slot].used
+		) {
+			slot = i;
+		}
+	}
+
+	if (probe) {
+		if (!eaton_cache[slot].used
+		|| strcmp(eaton_cache[slot].port, port_name)
+		|| eaton_cache[slot].probe.proto != probe->proto
+		|| eaton_cache[slot].probe.speed != probe->speed
+		) {
+			eaton_cache_changed = 1;
+		}
+		snprintf(eaton_cache[slot].port, sizeof(eaton_cache[slot].port), "%s", port_name);
+		eaton_cache[slot].probe = *probe;
+		eaton_cache[slot].used = ++eaton_cache_clock;
+	} else if (eaton_cache[slot].used && !strcmp(eaton_cache[slot].port, port_name)) {
+		eaton_cache[slot].used = 0;
+		eaton_cache_changed = 1;
+	}
 #ifdef HAVE_PTHREAD
-				pthread_mutex_unlock(&dev_mutex);
+	pthread_mutex_unlock(&eaton_cache_mutex);
 #endif
+}
+
+/* Merge the entries of the state file into the cache */
+static void eaton_cache_load(void)
+{
+	char	fn[NUT_PATH_MAX + 1], line[SMALLBUF], driver[32];
+	char	port_name[sizeof(eaton_cache[0].port)];
+	eaton_probe_t	probe;
+	FILE	*f;
+	size_t	i;
+	int	baud;
+
+	snprintf(fn, sizeof(fn), "%s/%s", dflt_statepath(), EATON_CACHE_FILE);
+#ifndef WIN32
+	{ /* scoping */
+		/* only trust a cache file which we wrote ourselves */
+		struct stat	st;
+		int	fd = open(fn, O_RDONLY | O_NOFOLLOW);
+
+		/* ELOOP: a symlink */
+		if (fd < 0 && errno != ELOOP) {
+			upsdebug_with_errno(3, "%s: can not read %s", __func__, fn);
+			return;
+		}
+
+		if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+			upsdebugx(1, "%s: ignoring %s: not a regular file owned by us", __func__, fn);
+			if (fd >= 0)
+				close(fd);
+			/* have eaton_cache_save() put ours in its place */
+			eaton_cache_changed = 1;
+			return;
+		}
+
+		f = fdopen(fd, "r");
+		if (f == NULL) {
+			upsdebug_with_errno(3, "%s: can not read %s", __func__, fn);
+			close(fd);
+			return;
+		}
+	}
+#else	/* WIN32 */
+	f = fopen(fn, "r");
+	if (f == NULL) {
+		upsdebug_with_errno(3, "%s: can not read %s", __func__, fn);
+		return;
+	}
+#endif	/* WIN32 */
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "%63s %31s %d", port_name, driver, &baud) != 3)
+			continue;
+
+		for (i = 0; i < SIZEOF_ARRAY(eaton_driver_names); i++) {
+			if (!strcmp(driver, eaton_driver_names[i]))
+				break;
+		}
+		if (i >= SIZEOF_ARRAY(eaton_driver_names))
+			continue;
+
+		probe.proto = (eaton_proto_t)i;
+		probe.speed = B2400;
+		probe.baud = 2400;
+		if (probe.proto == EATON_PROTO_XCP) {
+			for (i = 0; pw_baud_rates[i].rate != 0; i++) {
+				if (baud > 0 && pw_baud_rates[i].name == (size_t)baud)
+					break;
 			}
+			if (pw_baud_rates[i].rate == 0)
+				continue;
+			probe.speed = (speed_t)pw_baud_rates[i].rate;
+			probe.baud = baud;
+		} else if (baud != probe.baud) {
+			continue;
 		}
-		/* Close the device */
-		ser_close(devfd, NULL);
+
+		eaton_cache_set(port_name, &probe);
 	}
 
-	return dev;
+	fclose(f);
+	eaton_cache_changed = 0;
 }
 
-/*******************************************************************************
- * XCP functions (Eaton Powerware legacy)
- ******************************************************************************/
-
-/* XCP scan:
- *   baudrate nego (...)
- *   Send ESC to take it out of menu
- *   Wait 90ms
- *   Send auth command (AUTHOR[4] = {0xCF, 0x69, 0xE8, 0xD5};)
- *   Wait 500ms (or less?)
- *   Send PW_SET_REQ_ONLY_MODE command (0xA0) and wait for response
- *   [Get ID Block (PW_ID_BLOCK_REQ) (0x31)]
- */
-static nutscan_device_t * nutscan_scan_eaton_serial_xcp(const char* port_name)
+/* Write the cache back to the state file, if this scan changed it.
+ * Users without write access to the state path just go without. */
+/* Write the cache to a new file next to it, which then replaces it:
+ * neither a symlink planted there nor an interrupted run can make us
+ * write (or read later) anything but a complete cache file */
+static void eaton_cache_save(void)
 {
-	nutscan_device_t * dev = NULL;
-	int i;
-	ssize_t ret;
-	unsigned char	answer[256];
-	unsigned char	sbuf[128];
-	TYPE_FD_SER devfd = ser_open_nf(port_name);
+	char	fn[NUT_PATH_MAX + 1], tmp_fn[NUT_PATH_MAX + 8];
+	FILE	*f;
+	size_t	i;
+
+	if (!eaton_cache_changed)
+		return;
+
+	snprintf(fn, sizeof(fn), "%s/%s", dflt_statepath(), EATON_CACHE_FILE);
+#ifndef WIN32
+	{ /* scoping */
+		int	fd;
+
+		snprintf(tmp_fn, sizeof(tmp_fn), "%s.XXXXXX", fn);
+		fd = mkstemp(tmp_fn);
+		if (fd < 0) {
+			upsdebug_with_errno(3, "%s: can not write %s", __func__, tmp_fn);
+			return;
+		}
 
-	memset(sbuf, 0, 128);
+		if (fchmod(fd, 0644) != 0 || (f = fdopen(fd, "w")) == NULL) {
+			upsdebug_with_errno(3, "%s: can not write %s", __func__, tmp_fn);
+			close(fd);
+			unlink(tmp_fn);
+			return;
+		}
+	}
+#else	/* WIN32 */
+	snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", fn);
+	f = fopen(tmp_fn, "w");
+	if (f == NULL) {
+		upsdebug_with_errno(3, "%s: can not write %s", __func__, tmp_fn);
+		return;
+	}
+#endif	/* WIN32 */
 
-	if (VALID_FD_SER(devfd)) {
 #ifdef HAVE_PTHREAD
-		pthread_mutex_lock(&dev_mutex);
+	pthread_mutex_lock(&eaton_cache_mutex);
 #endif
-		upsfd = devfd;
+	for (i = 0; i < EATON_CACHE_SIZE; i++) {
+		if (!eaton_cache[i].used || strpbrk(eaton_cache[i].port, " \t\r\n"))
+			continue;
+		fprintf(f, "%s %s %d\n", eaton_cache[i].port,
+			eaton_driver_names[eaton_cache[i].probe.proto],
+			eaton_cache[i].probe.baud);
+	}
+	eaton_cache_changed = 0;
 #ifdef HAVE_PTHREAD
-		pthread_mutex_unlock(&dev_mutex);
+	pthread_mutex_unlock(&eaton_cache_mutex);
 #endif
 
-		for (i = 0; (pw_baud_rates[i].rate != 0) && (dev == NULL); i++)
-		{
-			memset(answer, 0, 256);
+	if (fclose(f) != 0) {
+		upsdebug_with_errno(3, "%s: can not write %s", __func__, tmp_fn);
+		unlink(tmp_fn);
+		return;
+	}
+
+#ifdef WIN32
+	/* rename() does not replace an existing file there */
+	unlink(fn);
+#endif	/* WIN32 */
 
-			if (ser_set_speed_nf(devfd, port_name, pw_baud_rates[i].rate) == -1)
-				break;
+	if (rename(tmp_fn, fn) != 0) {
+		upsdebug_with_errno(3, "%s: can not replace %s", __func__, fn);
+		unlink(tmp_fn);
+	}
+}
+
+static int64_t eaton_clock_ms(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(HAVE_CLOCK_MONOTONIC) && HAVE_CLOCK_GETTIME && HAVE_CLOCK_MONOTONIC
+	struct timespec	ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+	{
+		struct timeval	tv;
+
+		gettimeofday(&tv, NULL);
+		return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	}
+}
+
+static void port_add_probe(eaton_port_t *port, eaton_proto_t proto, speed_t speed, int baud)
+{
+	size_t	i;
+
+	for (i = 0; i < port->num_probes; i++) {
+		if (port->probes[i].proto == proto && port->probes[i].speed == speed)
+			return;
+	}
+
+	if (port->num_probes < EATON_MAX_PROBES) {
+		port->probes[port->num_probes].proto = proto;
+		port->probes[port->num_probes].speed = speed;
+		port->probes[port->num_probes].baud = baud;
+		port->num_probes++;
+	}
+}
+
+/* Last known protocol first, then SHUT, XCP (with baud hunting) and Q1 */
+static void port_plan(eaton_port_t *port)
+{
+	eaton_probe_t	cached;
+	size_t	i;
+
+	port->num_probes = 0;
+	port->cur = 0;
+
+	if (eaton_cache_get(port->name, &cached)) {
+		upsdebugx(2, "%s: trying %s at %d bauds first on %s", __func__,
+			eaton_driver_names[cached.proto], cached.baud, port->name);
+		port_add_probe(port, cached.proto, cached.speed, cached.baud);
+	}
+
+	port_add_probe(port, EATON_PROTO_SHUT, B2400, 2400);
+	for (i = 0; pw_baud_rates[i].rate != 0; i++) {
+		port_add_probe(port, EATON_PROTO_XCP,
+			(speed_t)pw_baud_rates[i].rate, pw_baud_rates[i].name);
+	}
+	port_add_probe(port, EATON_PROTO_Q1, B2400, 2400);
+}
+
+static void port_close(eaton_port_t *port)
+{
+	ser_close(port->fd, NULL);
+	port->fd = ERROR_FD_SER;
+	port->step = STEP_DONE;
+}
+
+/* Write out what is due, return -1 on errors */
+static int port_flush(eaton_port_t *port, int64_t now)
+{
+	while (port->out_pos < port->out_len && now >= port->out_next) {
+		size_t	len = port->pace_ms ? 1 : port->out_len - port->out_pos;
+		ssize_t	ret = ser_send_buf(port->fd, port->out + port->out_pos, len);
+
+		if (ret < 1)
+			return -1;
+
+		port->out_pos += (size_t)ret;
+		port->out_next = now + port->pace_ms;
+	}
+
+	return 0;
+}
+
+static int port_send(eaton_port_t *port, const void *buf, size_t len, int64_t pace_ms, int64_t now)
+{
+	if (len > sizeof(port->out))
+		return -1;
+
+	memcpy(port->out, buf, len);
+	port->out_len = len;
+	port->out_pos = 0;
+	port->pace_ms = pace_ms;
+	port->out_next = now;
+
+	return port_flush(port, now);
+}
+
+/* The running probe got no (valid) answer: move on to the next one */
+static void probe_failed(eaton_port_t *port, int64_t now)
+{
+	upsdebugx(4, "%s: no %s answer at %d bauds on %s", __func__,
+		eaton_driver_names[port->probes[port->cur].proto],
+		port->probes[port->cur].baud, port->name);
+
+	port->out_len = port->out_pos = 0;
+	port->cur++;
+
+	if (port->cur >= port->num_probes) {
+		upsdebugx(2, "%s: nothing found on %s", __func__, port->name);
+		eaton_cache_set(port->name, NULL);
+		port_close(port);
+		return;
+	}
+
+	port->step = STEP_GAP;
+	port->deadline = now + PROBE_GAP_MS;
+}
+
+/* Communication established successfully! */
+static void probe_found(eaton_port_t *port, nutscan_device_t **devs)
+{
+	const eaton_probe_t	*probe = &port->probes[port->cur];
+	nutscan_device_t	*dev;
+
+	upsdebugx(1, "%s: found %s device at %d bauds on %s", __func__,
+		eaton_driver_names[probe->proto], probe->baud, port->name);
+
+	dev = nutscan_new_device();
+	dev->type = TYPE_EATON_SERIAL;
+	dev->driver = strdup(eaton_driver_names[probe->proto]);
+	dev->port = strdup(port->name);
+	*devs = nutscan_add_device_to_device(*devs, dev);
+
+	eaton_cache_set(port->name, probe);
+	port_close(port);
+}
 
-			ret = ser_send_char(devfd, 0x1d);	/* send ESC to take it out of menu */
-			if (ret <= 0)
+/* SHUT: send SYNC token (0x16) and receive the SYNC token back
+ * FIXME: maybe try to get device descriptor?! */
+static void shut_sync(eaton_port_t *port, int64_t now)
+{
+	unsigned char	sync = SHUT_SYNC;
+
+	if (port_send(port, &sync, 1, 0, now) < 0) {
+		probe_failed(port, now);
+		return;
+	}
+
+	port->step = STEP_SHUT_WAIT;
+	port->deadline = now + SHUT_WAIT_MS;
+}
+
+/* Q1: only try pure 'Q1', not older ones like 'D' or 'QS'
+ * > [Q1\r]
+ * < [(226.0 195.0 226.0 014 49.0 27.5 30.0 00001000\r]
+ */
+static void q1_query(eaton_port_t *port, int64_t now)
+{
+	ser_flush_io(port->fd);
+	port->in_len = 0;
+
+	if (port_send(port, "Q1\r", 3, 0, now) < 0) {
+		probe_failed(port, now);
+		return;
+	}
+
+	port->step = STEP_Q1_WAIT;
+	port->deadline = now + Q1_WAIT_MS;
+}
+
+static void q1_retry(eaton_port_t *port, int64_t now)
+{
+	if (++port->tries < MAXTRIES)
+		q1_query(port, now);
+	else
+		probe_failed(port, now);
+}
+
+static void probe_start(eaton_port_t *port, int64_t now)
+{
+	const eaton_probe_t	*probe = &port->probes[port->cur];
+	unsigned char	esc = 0x1d;
+
+	upsdebugx(3, "%s: trying %s at %d bauds on %s", __func__,
+		eaton_driver_names[probe->proto], probe->baud, port->name);
+
+	port->tries = 0;
+	port->in_len = 0;
+
+	if (ser_set_speed_nf(port->fd, port->name, probe->speed) == -1) {
+		probe_failed(port, now);
+		return;
+	}
+
+	switch (probe->proto) {
+		case EATON_PROTO_SHUT:
+			/* set RTS to off and DTR to on to allow correct behavior
+			 * with UPS using PnP feature (not all lines have them) */
+			if (ser_set_dtr(port->fd, 1) == -1)
+				upsdebugx(4, "%s: could not set DTR on %s", __func__, port->name);
+			ser_set_rts(port->fd, 0);
+			shut_sync(port, now);
+			break;
+
+		case EATON_PROTO_XCP:
+			/* XCP: baudrate nego, send ESC to take it out of menu,
+			 * wait 90ms, send auth command, wait 500ms, then send
+			 * PW_SET_REQ_ONLY_MODE and wait for response */
+			if (port_send(port, &esc, 1, 0, now) < 0) {
+				probe_failed(port, now);
 				break;
+			}
+			port->step = STEP_XCP_ESC;
+			port->deadline = now + XCP_ESC_WAIT_MS;
+			break;
+
+		case EATON_PROTO_Q1:
+		default:
+			/* Set the default (normal) cablepower */
+			ser_set_dtr(port->fd, 1);
+			ser_set_rts(port->fd, 0);
+			port->step = STEP_Q1_SETTLE;
+			port->deadline = now + Q1_SETTLE_MS;
+			break;
+	}
+}
+
+static void probe_timeout(eaton_port_t *port, int64_t now)
+{
+	unsigned char	sbuf[8];
+
+	switch (port->step) {
+		case STEP_GAP:
+			probe_start(port, now);
+			break;
 
-			usleep(90000);
-			send_write_command(BCMXCP_AUTHCMD, 4);
-			usleep(500000);
+		case STEP_SHUT_WAIT:
+			if (++port->tries < MAX_TRY)
+				shut_sync(port, now);
+			else
+				probe_failed(port, now);
+			break;
 
+		case STEP_XCP_ESC:
+			sbuf[0] = PW_COMMAND_START_BYTE;
+			sbuf[1] = (unsigned char)sizeof(BCMXCP_AUTHCMD);
+			memcpy(sbuf + 2, BCMXCP_AUTHCMD, sizeof(BCMXCP_AUTHCMD));
+			sbuf[2 + sizeof(BCMXCP_AUTHCMD)] = calc_checksum(sbuf);
+			if (port_send(port, sbuf, 3 + sizeof(BCMXCP_AUTHCMD), 0, now) < 0) {
+				probe_failed(port, now);
+				break;
+			}
+			port->step = STEP_XCP_AUTH;
+			port->deadline = now + XCP_AUTH_WAIT_MS;
+			break;
+
+		case STEP_XCP_AUTH:
 			/* Discovery with Baud Hunting (XCP protocol spec. §4.1.2)
 			 * sending PW_SET_REQ_ONLY_MODE should be enough, since
 			 * the unit should send back Identification block */
@@ -246,189 +694,252 @@ static nutscan_device_t * nutscan_scan_eaton_serial_xcp(const char* port_name)
 			sbuf[1] = (unsigned char)1;
 			sbuf[2] = PW_SET_REQ_ONLY_MODE;
 			sbuf[3] = calc_checksum(sbuf);
-			ret = ser_send_buf_pace(devfd, 1000, sbuf, 4);
-
-			/* Read PW_COMMAND_START_BYTE byte */
-			ret = ser_get_char(devfd, answer, 1, 0);
-
-#if 0
-			/* FIXME: seems not needed, but requires testing with more devices! */
-			if (ret <= 0) {
-				usleep(250000); /* 500000? */
-				memset(answer, 0, 256);
-				ret = command_sequence(&id_command, 1, answer);
+			if (port_send(port, sbuf, 4, XCP_PACE_MS, now) < 0) {
+				probe_failed(port, now);
+				break;
 			}
-#endif
+			port->step = STEP_XCP_WAIT;
+			port->deadline = now + 4 * XCP_PACE_MS + XCP_WAIT_MS;
+			break;
+
+		case STEP_Q1_SETTLE:
+			q1_query(port, now);
+			break;
+
+		case STEP_Q1_WAIT:
+			q1_retry(port, now);
+			break;
+
+		case STEP_XCP_WAIT:
+		case STEP_DONE:
+		default:
+			probe_failed(port, now);
+			break;
+	}
+}
 
-			if ((ret > 0) && (answer[0] == PW_COMMAND_START_BYTE)) {
-				dev = nutscan_new_device();
-				dev->type = TYPE_EATON_SERIAL;
-				dev->driver = strdup(XCP_DRIVER_NAME);
-				dev->port = strdup(port_name);
-#ifdef HAVE_PTHREAD
-				pthread_mutex_lock(&dev_mutex);
-#endif
-				dev_ret = nutscan_add_device_to_device(dev_ret, dev);
-#ifdef HAVE_PTHREAD
-				pthread_mutex_unlock(&dev_mutex);
-#endif
+static void probe_input(eaton_port_t *port, const unsigned char *buf, size_t len,
+	int64_t now, nutscan_device_t **devs)
+{
+	size_t	i;
+
+	switch (port->step) {
+		case STEP_SHUT_WAIT:
+			if (memchr(buf, SHUT_SYNC, len))
+				probe_found(port, devs);
+			break;
+
+		case STEP_XCP_WAIT:
+			/* Read PW_COMMAND_START_BYTE byte */
+			if (buf[0] == PW_COMMAND_START_BYTE)
+				probe_found(port, devs);
+			else
+				probe_failed(port, now);
+			break;
+
+		case STEP_Q1_WAIT:
+			for (i = 0; i < len; i++) {
+				port->in[port->in_len++] = buf[i];
+				if (buf[i] != '\r' && port->in_len < sizeof(port->in))
+					continue;
+
+				/* Check answer: should at least (and most) be 46 chars */
+				if (port->in_len >= 46 && port->in[0] == '(')
+					probe_found(port, devs);
+				else
+					q1_retry(port, now);
 				break;
 			}
-			usleep(100000);
+			break;
+
+		case STEP_GAP:
+		case STEP_XCP_ESC:
+		case STEP_XCP_AUTH:
+		case STEP_Q1_SETTLE:
+		case STEP_DONE:
+		default:
+			/* Not waiting for an answer, e.g. menu output: ignore */
+			break;
+	}
+}
+
+static nutscan_device_t * nutscan_scan_eaton_serial_ports(char **port_names)
+{
+	nutscan_device_t	*devs = NULL;
+	eaton_port_t	*ports;
+	unsigned char	buf[128];
+	size_t	i, count = 0, active = 0;
+	int64_t	now;
+#ifndef WIN32
+	struct pollfd	*fds;
+	size_t	*fds_port;
+#endif	/* !WIN32 */
+
+	while (port_names[count] != NULL)
+		count++;
+	if (count == 0)
+		return NULL;
+
+	ports = (eaton_port_t *)calloc(count, sizeof(*ports));
+#ifndef WIN32
+	fds = (struct pollfd *)calloc(count, sizeof(*fds));
+	fds_port = (size_t *)calloc(count, sizeof(*fds_port));
+	if (ports == NULL || fds == NULL || fds_port == NULL) {
+		upsdebugx(0, "%s: Failed to allocate the ports table", __func__);
+		free(ports);
+		free(fds);
+		free(fds_port);
+		return NULL;
+	}
+#else	/* WIN32 */
+	if (ports == NULL) {
+		upsdebugx(0, "%s: Failed to allocate the ports table", __func__);
+		return NULL;
+	}
+#endif	/* WIN32 */
+
+	now = eaton_clock_ms();
+	for (i = 0; i < count; i++) {
+		eaton_port_t	*port = &ports[i];
+
+		port->name = port_names[i];
+		port->step = STEP_DONE;
+		port->fd = ser_open_nf(port->name);
+		if (INVALID_FD_SER(port->fd)) {
+			upsdebugx(3, "%s: could not open %s", __func__, port->name);
+			continue;
 		}
-		/* Close the device */
-		ser_close(devfd, NULL);
+
+		port_plan(port);
+		port->step = STEP_GAP;
+		port->deadline = now;
+		active++;
 	}
 
-	return dev;
-}
+	upsdebugx(2, "%s: probing %" PRIuSIZE " of %" PRIuSIZE " serial ports",
+		__func__, active, count);
 
-/*******************************************************************************
- * Q1 functions (Phoenixtec/Centralion/Santak, still Eaton path forward)
- ******************************************************************************/
+	while (active > 0) {
+		int64_t	wake = -1, timeout;
+#ifndef WIN32
+		size_t	nfds = 0;
+		int	ret;
+#endif	/* !WIN32 */
 
-#define SER_WAIT_SEC  1  /* 3 seconds for Best UPS */
-#define MAXTRIES      3
+		for (i = 0; i < count; i++) {
+			eaton_port_t	*port = &ports[i];
+			int64_t	when;
 
-/* Q1 scan:
- *   - open the serial port and set the speed to 2400 baud
- *   - simply try to get Q1 (status) string
- *   - check its size and first char. which should be '('
- */
-static nutscan_device_t * nutscan_scan_eaton_serial_q1(const char* port_name)
-{
-	nutscan_device_t * dev = NULL;
-	struct termios tio;
-	ssize_t ret = 0;
-	int retry;
-	char buf[128];
-	TYPE_FD_SER devfd = ser_open_nf(port_name);
-
-	if (VALID_FD_SER(devfd)) {
-		if (ser_set_speed_nf(devfd, port_name, B2400) != -1) {
-
-			if (!tcgetattr(devfd, &tio)) {
-
-				/* Use canonical mode input processing (to read reply line) */
-				tio.c_lflag |= ICANON;	/* Canonical input (erase and kill processing) */
-
-				tio.c_cc[VEOF]   = _POSIX_VDISABLE;
-				tio.c_cc[VEOL]   = '\r';
-				tio.c_cc[VERASE] = _POSIX_VDISABLE;
-				tio.c_cc[VINTR]  = _POSIX_VDISABLE;
-				tio.c_cc[VKILL]  = _POSIX_VDISABLE;
-				tio.c_cc[VQUIT]  = _POSIX_VDISABLE;
-				tio.c_cc[VSUSP]  = _POSIX_VDISABLE;
-				tio.c_cc[VSTART] = _POSIX_VDISABLE;
-				tio.c_cc[VSTOP]  = _POSIX_VDISABLE;
-
-				if (!tcsetattr(devfd, TCSANOW, &tio)) {
-
-					/* Set the default (normal) cablepower */
-					ser_set_dtr(devfd, 1);
-					ser_set_rts(devfd, 0);
-
-					/* Allow some time to settle for the cablepower */
-					usleep(100000);
-
-					/* Only try pure 'Q1', not older ones like 'D' or 'QS'
-					 * > [Q1\r]
-					 * < [(226.0 195.0 226.0 014 49.0 27.5 30.0 00001000\r]
-					 */
-					for (retry = 1; retry <= MAXTRIES; retry++) {
-
-						/* simplified code */
-						ser_flush_io(devfd);
-						if ((ret = ser_send(devfd, "Q1\r")) > 0) {
-
-							/* Get Q1 reply */
-							if ((ret = ser_get_buf(devfd, buf, sizeof(buf), SER_WAIT_SEC, 0)) > 0) {
-
-								/* Check answer */
-								/* should at least (and most) be 46 chars */
-								if (ret >= 46) {
-									if (buf[0] == '(') {
-
-										dev = nutscan_new_device();
-										dev->type = TYPE_EATON_SERIAL;
-										dev->driver = strdup(Q1_DRIVER_NAME);
-										dev->port = strdup(port_name);
-#ifdef HAVE_PTHREAD
-										pthread_mutex_lock(&dev_mutex);
-#endif
-										dev_ret = nutscan_add_device_to_device(dev_ret, dev);
-#ifdef HAVE_PTHREAD
-										pthread_mutex_unlock(&dev_mutex);
-#endif
-										break;
-									}
-								}
-							}
-						}
-					}
-				}
+			if (port->step == STEP_DONE)
+				continue;
+
+			when = port->deadline;
+			if (port->out_pos < port->out_len && port->out_next < when)
+				when = port->out_next;
+			if (wake < 0 || when < wake)
+				wake = when;
+
+#ifndef WIN32
+			fds[nfds].fd = port->fd;
+			fds[nfds].events = POLLIN;
+			fds[nfds].revents = 0;
+			fds_port[nfds] = i;
+			nfds++;
+#endif	/* !WIN32 */
+		}
+
+		timeout = wake - now;
+		if (timeout < 0)
+			timeout = 0;
+
+#ifndef WIN32
+		ret = poll(fds, (nfds_t)nfds, (int)timeout);
+		if (ret < 0 && errno != EINTR) {
+			upsdebug_with_errno(1, "%s: poll", __func__);
+			break;
+		}
+
+		now = eaton_clock_ms();
+		for (i = 0; ret > 0 && i < nfds; i++) {
+			eaton_port_t	*port = &ports[fds_port[i]];
+			ssize_t	len;
+
+			if (!fds[i].revents)
+				continue;
+
+			len = read(port->fd, buf, sizeof(buf));
+			if (len > 0) {
+				probe_input(port, buf, (size_t)len, now, &devs);
+			} else if (len == 0 || (errno != EAGAIN && errno != EINTR)) {
+				upsdebugx(3, "%s: lost %s", __func__, port->name);
+				eaton_cache_set(port->name, NULL);
+				port_close(port);
 			}
 		}
-		/* Close the device */
-		ser_close(devfd, NULL);
-	}
-	return dev;
-}
+#else	/* WIN32 */
+		/* Serial handles can not be polled: peek at all ports
+		 * at least every 10 ms instead */
+		if (timeout > 10)
+			timeout = 10;
+		if (timeout > 0)
+			usleep((useconds_t)(timeout * 1000));
+
+		now = eaton_clock_ms();
+		for (i = 0; i < count; i++) {
+			eaton_port_t	*port = &ports[i];
+			ssize_t	len;
+
+			if (port->step == STEP_DONE)
+				continue;
+
+			len = ser_get_buf(port->fd, buf, sizeof(buf), 0, 0);
+			if (len > 0)
+				probe_input(port, buf, (size_t)len, now, &devs);
+		}
+#endif	/* WIN32 */
 
-/* Wrap calls to actual implementations of nutscan_scan_eaton_serial_shut(),
- * nutscan_scan_eaton_serial_xcp() and/or nutscan_scan_eaton_serial_q1()
- * which implement the semantics of parallel-able scanning.
- * Returns the device entry, updates global dev_ret when a scan is successful.
- * DOES NOT FREE the caller's copy of "port_arg", unlike many similar methods
- * in other scanners.
- */
-static void * nutscan_scan_eaton_serial_device_thready(void * port_arg)
-{
-	nutscan_device_t * dev = NULL;
-	char* port_name = (char*) port_arg;
-
-	/* Try SHUT first */
-	if ((dev = nutscan_scan_eaton_serial_shut(port_name)) == NULL) {
-		usleep(100000);
-		/* Else, try XCP */
-		if ((dev = nutscan_scan_eaton_serial_xcp(port_name)) == NULL) {
-			/* Else, try Q1 */
-			usleep(100000);
-			dev = nutscan_scan_eaton_serial_q1(port_name);
+		active = 0;
+		for (i = 0; i < count; i++) {
+			eaton_port_t	*port = &ports[i];
+
+			if (port->step == STEP_DONE)
+				continue;
+
+			if (port_flush(port, now) < 0)
+				probe_failed(port, now);
+			else if (now >= port->deadline)
+				probe_timeout(port, now);
+
+			if (port->step != STEP_DONE)
+				active++;
 		}
-		/* Else try UTalk? */
 	}
 
-	return dev;
+	/* Only after poll() errors */
+	for (i = 0; i < count; i++) {
+		if (ports[i].step != STEP_DONE)
+			port_close(&ports[i]);
+	}
+
+	free(ports);
+#ifndef WIN32
+	free(fds);
+	free(fds_port);
+#endif	/* !WIN32 */
+
+	return devs;
 }
 
 nutscan_device_t * nutscan_scan_eaton_serial(const char* ports_range)
 {
-	bool_t pass = TRUE; /* Track that we may spawn a scanning thread */
 #ifndef WIN32
 	struct sigaction oldact;
 	int change_action_handler = 0;
 #endif	/* !WIN32 */
-	char *current_port_name = NULL;
 	char **serial_ports_list;
-	int  current_port_nb;
+	nutscan_device_t *dev_ret;
 	size_t	i;
 
-#ifdef HAVE_PTHREAD
-# if (defined HAVE_SEMAPHORE_UNNAMED) || (defined HAVE_SEMAPHORE_NAMED)
-	sem_t * semaphore = nutscan_semaphore();
-	/* TODO? Port semaphore_scantype / max_threads_scantype
-	 *  from sibling sources? We do not have that many serial
-	 *  ports to care much, usually... right?
-	 */
-# endif /* HAVE_SEMAPHORE_UNNAMED || HAVE_SEMAPHORE_NAMED */
-	pthread_t thread;
-	nutscan_thread_t * thread_array = NULL;
-	size_t thread_count = 0;
-
-	pthread_mutex_init(&dev_mutex, NULL);
-#endif /* HAVE_PTHREAD */
-
 	/* 1) Get ports_list */
 	serial_ports_list = nutscan_get_serial_ports_list(ports_range);
 	if (serial_ports_list == NULL) {
@@ -452,213 +963,10 @@ nutscan_device_t * nutscan_scan_eaton_serial(const char* ports_range)
 	}
 #endif	/* !WIN32 */
 
-	/* port(s) iterator */
-	current_port_nb = 0;
-	while (serial_ports_list[current_port_nb] != NULL) {
-#ifdef HAVE_PTHREAD
-		/* NOTE: With many enough targets to scan, this can crash
-		 * by spawning too many children; add a limit and loop to
-		 * "reap" some already done with their work. And probably
-		 * account them in thread_array[] as something to not wait
-		 * for below in pthread_join()...
-		 */
-
-# if (defined HAVE_SEMAPHORE_UNNAMED) || (defined HAVE_SEMAPHORE_NAMED)
-		/* Just wait for someone to free a semaphored slot,
-		 * if none are available, and then/otherwise grab one
-		 */
-		if (thread_array == NULL) {
-			/* Starting point, or after a wait to complete
-			 * all earlier runners */
-			sem_wait(semaphore);
-			pass = TRUE;
-		} else {
-			pass = (sem_trywait(semaphore) == 0) ? TRUE : FALSE;
-		}
-# else
-#  ifdef HAVE_PTHREAD_TRYJOIN
-		/* A somewhat naive and brute-force solution for
-		 * systems without a semaphore.h. This may suffer
-		 * some off-by-one errors, using a few more threads
-		 * than intended (if we race a bit at the wrong time,
-		 * probably up to one per enabled scanner routine).
-		 */
-
-		/* TOTHINK: Should there be a threadcount_mutex when
-		 * we just read the value in if() and while() below?
-		 * At worst we would overflow the limit a bit due to
-		 * other protocol scanners...
-		 */
-		if (curr_threads >= max_threads) {
-			upsdebugx(2, "%s: already running %" PRIuSIZE " scanning threads "
-				"(launched overall: %" PRIuSIZE "), "
-				"waiting until some would finish",
-				__func__, curr_threads, thread_count);
-
-			while (curr_threads >= max_threads) {
-				for (i = 0; i < thread_count ; i++) {
-					int ret;
-
-					if (!thread_array[i].active) continue;
-
-					pthread_mutex_lock(&threadcount_mutex);
-					upsdebugx(3, "%s: Trying to join thread #%" PRIuSIZE "...", __func__, i);
-					ret = pthread_tryjoin_np(thread_array[i].thread, NULL);
-					switch (ret) {
-						case ESRCH:     /* No thread with the ID thread could be found - already "joined"? */
-							upsdebugx(5, "%s: Was thread #%" PRIuSIZE " joined earlier?", __func__, i);
-							break;
-						case 0:         /* thread exited */
-							if (curr_threads > 0) {
-								curr_threads --;
-								upsdebugx(4, "%s: Joined a finished thread #%" PRIuSIZE, __func__, i);
-							} else {
-								/* threadcount_mutex fault? */
-								upsdebugx(0, "WARNING: %s: Accounting of thread count "
-									"says we are already at 0", __func__);
-							}
-							thread_array[i].active = FALSE;
-							break;
-						case EBUSY:     /* actively running */
-							upsdebugx(6, "%s: thread #%" PRIuSIZE " still busy (%i)",
-								__func__, i, ret);
-							break;
-						case EDEADLK:   /* Errors with thread interactions... bail out? */
-						case EINVAL:    /* Errors with thread interactions... bail out? */
-						default:        /* new pthreads abilities? */
-							upsdebugx(5, "%s: thread #%" PRIuSIZE " reported code %i",
-								__func__, i, ret);
-							break;
-					}
-					pthread_mutex_unlock(&threadcount_mutex);
-				}
-
-				if (curr_threads >= max_threads) {
-					usleep (10000); /* microSec's, so 0.01s here */
-				}
-			}
-			upsdebugx(2, "%s: proceeding with scan", __func__);
-		}
-
-		/* NOTE: No change to default "pass" in this ifdef:
-		 * if we got to this line, we have a slot to use */
-#  endif /* HAVE_PTHREAD_TRYJOIN */
-# endif  /* HAVE_SEMAPHORE_UNNAMED || HAVE_SEMAPHORE_NAMED */
-#endif   /* HAVE_PTHREAD */
-
-		if (pass) {
-			current_port_name = serial_ports_list[current_port_nb];
-
-#ifdef HAVE_PTHREAD
-			if (pthread_create(&thread, NULL, nutscan_scan_eaton_serial_device_thready, (void*)current_port_name) == 0) {
-				nutscan_thread_t	*new_thread_array;
-# ifdef HAVE_PTHREAD_TRYJOIN
-				pthread_mutex_lock(&threadcount_mutex);
-				curr_threads++;
-# endif /* HAVE_PTHREAD_TRYJOIN */
-
-				thread_count++;
-				new_thread_array = (nutscan_thread_t*)realloc(thread_array,
-					thread_count * sizeof(nutscan_thread_t));
-				if (new_thread_array == NULL) {
-					upsdebugx(1, "%s: Failed to realloc thread array", __func__);
-# ifdef HAVE_PTHREAD_TRYJOIN
-					pthread_mutex_unlock(&threadcount_mutex);
-# endif /* HAVE_PTHREAD_TRYJOIN */
-					break;
-				}
-				else {
-					thread_array = new_thread_array;
-				}
-				thread_array[thread_count - 1].thread = thread;
-				thread_array[thread_count - 1].active = TRUE;
-
-# ifdef HAVE_PTHREAD_TRYJOIN
-				pthread_mutex_unlock(&threadcount_mutex);
-# endif /* HAVE_PTHREAD_TRYJOIN */
-			}
-#else   /* if not HAVE_PTHREAD */
-			nutscan_scan_eaton_serial_device_thready(current_port_name);
-#endif  /* if HAVE_PTHREAD */
-
-			/* Prepare the next iteration */
-			current_port_nb++;
-		} else { /* if not pass -- all slots busy */
-#ifdef HAVE_PTHREAD
-# if (defined HAVE_SEMAPHORE_UNNAMED) || (defined HAVE_SEMAPHORE_NAMED)
-			/* Wait for all current scans to complete */
-			if (thread_array != NULL) {
-				upsdebugx (2, "%s: Running too many scanning threads (%"
-					PRIuSIZE "), "
-					"waiting until older ones would finish",
-					__func__, thread_count);
-				for (i = 0; i < thread_count ; i++) {
-					int ret;
-					if (!thread_array[i].active) {
-						/* Probably should not get here,
-						 * but handle it just in case */
-						upsdebugx(0, "WARNING: %s: Midway clean-up: did not expect thread %" PRIuSIZE " to be not active",
-							__func__, i);
-						sem_post(semaphore);
-						continue;
-					}
-					thread_array[i].active = FALSE;
-					ret = pthread_join(thread_array[i].thread, NULL);
-					if (ret != 0) {
-						upsdebugx(0, "WARNING: %s: Midway clean-up: pthread_join() returned code %i",
-							__func__, ret);
-					}
-					sem_post(semaphore);
-				}
-				thread_count = 0;
-				free(thread_array);
-				thread_array = NULL;
-			}
-# else
-#  ifdef HAVE_PTHREAD_TRYJOIN
-			/* TODO: Move the wait-loop for TRYJOIN here? */
-#  endif /* HAVE_PTHREAD_TRYJOIN */
-# endif  /* HAVE_SEMAPHORE_UNNAMED || HAVE_SEMAPHORE_NAMED */
-#endif   /* HAVE_PTHREAD */
-		} /* if: could we "pass" or not? */
-	} /* while */
-
-#ifdef HAVE_PTHREAD
-	if (thread_array != NULL) {
-		upsdebugx(2, "%s: all planned scans launched, waiting for threads to complete", __func__);
-		for (i = 0; i < thread_count; i++) {
-			int ret;
-
-			if (!thread_array[i].active) continue;
-
-			ret = pthread_join(thread_array[i].thread, NULL);
-			if (ret != 0) {
-				upsdebugx(0, "WARNING: %s: Clean-up: pthread_join() returned code %i",
-					__func__, ret);
-			}
-			thread_array[i].active = FALSE;
-# if (defined HAVE_SEMAPHORE_UNNAMED) || (defined HAVE_SEMAPHORE_NAMED)
-			sem_post(semaphore);
-# else
-#  ifdef HAVE_PTHREAD_TRYJOIN
-			pthread_mutex_lock(&threadcount_mutex);
-			if (curr_threads > 0) {
-				curr_threads --;
-				upsdebugx(5, "%s: Clean-up: Joined a finished thread #%" PRIuSIZE,
-					__func__, i);
-			} else {
-				upsdebugx(0, "WARNING: %s: Clean-up: Accounting of thread count "
-					"says we are already at 0", __func__);
-			}
-			pthread_mutex_unlock(&threadcount_mutex);
-#  endif /* HAVE_PTHREAD_TRYJOIN */
-# endif /* HAVE_SEMAPHORE_UNNAMED || HAVE_SEMAPHORE_NAMED */
-		}
-		free(thread_array);
-		upsdebugx(2, "%s: all threads freed", __func__);
-	}
-	pthread_mutex_destroy(&dev_mutex);
-#endif /* HAVE_PTHREAD */
+	/* 2) Probe all ports at once, known protocols first */
+	eaton_cache_load();
+	dev_ret = nutscan_scan_eaton_serial_ports(serial_ports_list);
+	eaton_cache_save();
 
 #ifndef WIN32
 	if (change_action_handler) {
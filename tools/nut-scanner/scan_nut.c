@@ -76,6 +76,9 @@ static void (*nut_upscli_get_default_connect_timeout)(struct timeval *ptv);
 static void (*nut_upscli_free_host_cert)(const char *hostname, const char *certname);
 static void (*nut_upscli_free_host_port_cert)(const char *hostname, uint16_t port, const char *certname);
 static void (*nut_upscli_authconf_update_conn_flags)(const upscli_authconf_t *ac, int *flags);
+static UPSCONN_t *(*nut_upscli_pool_tryconnect)(const char *host, uint16_t port, int flags,
+	const char *username, const char *password, struct timeval *timeout);
+static int (*nut_upscli_pool_release)(UPSCONN_t *ups);
 
 /* This variable collects device(s) from a sequential or parallel scan,
  * is returned to caller, and cleared to allow subsequent independent scans */
@@ -365,6 +368,21 @@ int nutscan_load_upsclient_library(const char *libname_path)
 			__func__, symbol);
 	}
 
+	/* Pooled connections are used together, or not at all */
+	*(void **) (&nut_upscli_pool_tryconnect) = lt_dlsym(dl_handle,
+		symbol = "upscli_pool_tryconnect");
+	if ((dl_error = lt_dlerror()) == NULL) {
+		*(void **) (&nut_upscli_pool_release) = lt_dlsym(dl_handle,
+			symbol = "upscli_pool_release");
+		dl_error = lt_dlerror();
+	}
+	if (dl_error != NULL) {
+		nut_upscli_pool_tryconnect = NULL;
+		nut_upscli_pool_release = NULL;
+		upsdebugx(1, "%s: %s() not found, using older libupsclient build?",
+			__func__, symbol);
+	}
+
 	/* Passed final lt_dlsym() */
 	symbol = NULL;
 
@@ -407,7 +425,7 @@ static void * list_nut_devices_thready(void * arg)
 	const char *query[4];
 	char **answer = NULL;
 	char *hostname = NULL;
-	UPSCONN_t *ups = (UPSCONN_t*)xcalloc(1, sizeof(*ups));
+	UPSCONN_t *ups = NULL;
 	nutscan_device_t * dev = NULL;
 	size_t buf_size;
 
@@ -420,29 +438,35 @@ static void * list_nut_devices_thready(void * arg)
 	upsdebugx(2, "Entering %s for %s", __func__, target_hostname);
 
 	if ((*nut_upscli_splitaddr)(target_hostname, &hostname, &port) != 0) {
-		/* Avoid disconnect from not connected ups */
 		upsdebugx(4, "%s: upscli_splitaddr() failed", __func__);
-		if (ups) {
-			if (ups->host)
-				free(ups->host);
-			free(ups);
-		}
-		ups = NULL;
 		goto end;
 	}
 
-	if ((*nut_upscli_tryconnect)(ups, hostname, port, nut_arg->flags_ssl, &tv) < 0) {
-		/* Avoid disconnect from not connected ups */
-		upsdebugx(4, "%s: upscli_tryconnect() failed", __func__);
-		if (ups) {
+	if (nut_upscli_pool_tryconnect) {
+		/* A pooled connection, like other NUT clients use */
+		ups = (*nut_upscli_pool_tryconnect)(hostname, port, nut_arg->flags_ssl, NULL, NULL, &tv);
+		if (ups && ups->fd < 0) {
+			upsdebugx(4, "%s: upscli_pool_tryconnect() failed", __func__);
+			(*nut_upscli_pool_release)(ups);
+			ups = NULL;
+			goto end;
+		}
+	} else {
+		ups = (UPSCONN_t*)xcalloc(1, sizeof(*ups));
+		if ((*nut_upscli_tryconnect)(ups, hostname, port, nut_arg->flags_ssl, &tv) < 0) {
+			/* Avoid disconnect from not connected ups */
+			upsdebugx(4, "%s: upscli_tryconnect() failed", __func__);
 			if (ups->host)
 				free(ups->host);
 			free(ups);
+			ups = NULL;
+			goto end;
 		}
-		ups = NULL;
-		goto end;
 	}
 
+	if (!ups)
+		goto end;
+
 	/* Best-effort login (if present in the file for that host, or default) */
 	if (nut_upscli_authenticate_authconf != NULL && nut_arg->ac_current != NULL
 	 && nut_arg->ac_current->user && nut_arg->ac_current->pass
@@ -523,7 +547,9 @@ static void * list_nut_devices_thready(void * arg)
 	}
 
 end:
-	if (ups) {
+	if (ups && nut_upscli_pool_release) {
+		(*nut_upscli_pool_release)(ups);
+	} else if (ups) {
 		(*nut_upscli_disconnect)(ups);
 		if (ups->host)
 			free(ups->host);